@@ -4,6 +4,7 @@ const Builder = std.build.Builder;
 const builtin = @import("builtin");
 
 const zforge = @import("external/The-Forge/build.zig");
+const model_converter = @import("tools/model_converter/build.zig");
 // const wwise_zig = @import("wwise-zig");
 
 pub fn build(b: *std.Build) void {
@@ -50,10 +51,11 @@ pub fn build(b: *std.Build) void {
     }
 
     // websocket.zig
-    exe.root_module.addImport("websocket", b.createModule(.{
+    const websocket = b.createModule(.{
         .root_source_file = b.path("external/websocket.zig/src/websocket.zig"),
         .imports = &.{},
-    }));
+    });
+    exe.root_module.addImport("websocket", websocket);
 
     // zflecs
     const zflecs = b.dependency("zflecs", .{
@@ -79,6 +81,13 @@ pub fn build(b: *std.Build) void {
         .imports = &.{},
     }));
 
+    // File mapping for the patch archives and meshes, shared with the test roots and the simulator.
+    const mapped_file = b.createModule(.{
+        .root_source_file = b.path("src/core/mapped_file.zig"),
+        .imports = &.{},
+    });
+    exe.root_module.addImport("mapped_file", mapped_file);
+
     // ZIG GAMEDEV
 
     // zaudio
@@ -263,4 +272,76 @@ pub fn build(b: *std.Build) void {
 
     const run_step = b.step("run", "Run the app");
     run_step.dependOn(&run_cmd.step);
+
+    // ██████╗ ███████╗███╗   ██╗ ██████╗██╗  ██╗
+    // ██╔══██╗██╔════╝████╗  ██║██╔════╝██║  ██║
+    // ██████╔╝█████╗  ██╔██╗ ██║██║     ███████║
+    // ██╔══██╗██╔══╝  ██║╚██╗██║██║     ██╔══██║
+    // ██████╔╝███████╗██║ ╚████║╚██████╗██║  ██║
+    // ╚═════╝ ╚══════╝╚═╝  ╚═══╝ ╚═════╝╚═╝  ╚═╝
+
+    // Headless benchmarks, no window or GPU needed.
+    const bench_exe = b.addExecutable(.{
+        .name = "TidesBenchmarks",
+        .root_source_file = b.path("src/benchmarks.zig"),
+        .target = target,
+        .optimize = optimize,
+    });
+    bench_exe.linkLibC();
+    if (abi != .msvc) {
+        bench_exe.linkLibCpp();
+    }
+    bench_exe.root_module.addImport("websocket", websocket);
+    bench_exe.root_module.addImport("mapped_file", mapped_file);
+    bench_exe.root_module.addImport("zmath", zmath.module("root"));
+    bench_exe.root_module.addImport("zphysics", zphysics.module("root"));
+    bench_exe.linkLibrary(zphysics.artifact("joltc"));
+    bench_exe.root_module.addImport("zpool", zpool.module("root"));
+    bench_exe.root_module.addImport("zstbi", zstbi.module("root"));
+    bench_exe.root_module.addImport("ztracy", ztracy.module("root"));
+    bench_exe.linkLibrary(ztracy.artifact("tracy"));
+    // The model converter's zstd compressor, the mesh loading benchmark writes compressed v2 files with it.
+    bench_exe.addCSourceFiles(.{
+        .root = b.path("external/The-Forge/Common_3/Utilities/ThirdParty/OpenSource/zstd"),
+        .files = &model_converter.zstd_sources,
+        .flags = &.{},
+    });
+
+    const bench_install = b.addInstallArtifact(bench_exe, .{});
+    const bench_cmd = b.addRunArtifact(bench_exe);
+    bench_cmd.step.dependOn(&bench_install.step);
+    if (b.args) |args| {
+        bench_cmd.addArgs(args);
+    }
+
+    const bench_step = b.step("bench", "Run the headless benchmarks");
+    bench_step.dependOn(&bench_cmd.step);
+
+    // Unit tests living next to the code in src/core
+    const test_step = b.step("test", "Run unit tests");
+    inline for (.{
+        "src/core/bucket_queue.zig",
+        "src/core/id.zig",
+        "src/core/job_system.zig",
+        "src/core/lru_cache.zig",
+        "src/core/mpsc_queue.zig",
+        "src/core/range_allocator.zig",
+        "src/core/spatial_hash_grid.zig",
+        "src/core/timer_wheel.zig",
+        "src/renderer/dynamic_visibility.zig",
+        "src/renderer/light_clustering.zig",
+        "src/renderer/mesh_format.zig",
+        "src/renderer/static_geometry_culling.zig",
+        "src/renderer/terrain_quad_tree.zig",
+        "src/worldpatch/patch_archive.zig",
+        "src/worldpatch/props_format.zig",
+    }) |test_file| {
+        const unit_tests = b.addTest(.{
+            .root_source_file = b.path(test_file),
+            .target = target,
+            .optimize = optimize,
+        });
+        unit_tests.root_module.addImport("mapped_file", mapped_file);
+        test_step.dependOn(&b.addRunArtifact(unit_tests).step);
+    }
 }
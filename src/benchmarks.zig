@@ -0,0 +1,53 @@
+const std = @import("std");
+
+// Headless benchmarks. Run with `zig build bench -- [name...]`, no names runs all of them.
+// Each benchmark module exposes `pub fn run(allocator: std.mem.Allocator) !void`.
+const benchmarks = .{
+    .{ "world_patch_loading", @import("benchmarks/world_patch_loading.zig") },
+    .{ "patch_archive_loading", @import("benchmarks/patch_archive_loading.zig") },
+    .{ "props_decoding", @import("benchmarks/props_decoding.zig") },
+    .{ "id_interning", @import("benchmarks/id_interning.zig") },
+    .{ "lru_cache", @import("benchmarks/lru_cache.zig") },
+    .{ "asset_streaming", @import("benchmarks/asset_streaming.zig") },
+    .{ "task_scheduling", @import("benchmarks/task_scheduling.zig") },
+    .{ "bucket_queue", @import("benchmarks/bucket_queue.zig") },
+    .{ "physics_heightfield_streaming", @import("benchmarks/physics_heightfield_streaming.zig") },
+    .{ "terrain_height_query", @import("benchmarks/terrain_height_query.zig") },
+    .{ "settlement_proximity", @import("benchmarks/settlement_proximity.zig") },
+    .{ "static_geometry_culling", @import("benchmarks/static_geometry_culling.zig") },
+    .{ "instance_range_allocation", @import("benchmarks/instance_range_allocation.zig") },
+    .{ "terrain_quad_culling", @import("benchmarks/terrain_quad_culling.zig") },
+    .{ "light_clustering", @import("benchmarks/light_clustering.zig") },
+    .{ "dynamic_visibility", @import("benchmarks/dynamic_visibility.zig") },
+    .{ "mesh_loading", @import("benchmarks/mesh_loading.zig") },
+};
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const args = try std.process.argsAlloc(allocator);
+    defer std.process.argsFree(allocator, args);
+    const filters = args[1..];
+
+    inline for (benchmarks) |benchmark| {
+        const name = benchmark[0];
+        const selected = blk: {
+            if (filters.len == 0) {
+                break :blk true;
+            }
+            for (filters) |filter| {
+                if (std.mem.eql(u8, filter, name)) {
+                    break :blk true;
+                }
+            }
+            break :blk false;
+        };
+
+        if (selected) {
+            std.debug.print("== {s} ==\n", .{name});
+            try benchmark[1].run(allocator);
+        }
+    }
+}
@@ -0,0 +1,103 @@
+const std = @import("std");
+
+const AssetManager = @import("../core/asset_manager.zig").AssetManager;
+const IdLocal = @import("../core/core.zig").IdLocal;
+
+// Streams a window of synthetic patch files back and forth across a grid with a budgeted
+// AssetManager and reports hit rate, evictions and resident bytes, plus the cost of
+// doesAssetExist with and without the startup scan.
+
+const bench_dir = ".bench_tmp/asset_streaming";
+const patches_per_side = 64;
+const patch_bytes = 16 * 1024;
+const window_radius = 4;
+const budget_bytes = 4 * 1024 * 1024;
+
+fn patchPath(buf: []u8, patch_x: usize, patch_z: usize) []const u8 {
+    return std.fmt.bufPrint(buf, bench_dir ++ "/patch_x{}_z{}.bin", .{ patch_x, patch_z }) catch unreachable;
+}
+
+fn writeContent() !void {
+    try std.fs.cwd().makePath(bench_dir);
+    var payload: [patch_bytes]u8 = undefined;
+    @memset(&payload, 0xab);
+    var path_buf: [256]u8 = undefined;
+    for (0..patches_per_side) |patch_z| {
+        for (0..patches_per_side) |patch_x| {
+            try std.fs.cwd().writeFile(.{ .sub_path = patchPath(&path_buf, patch_x, patch_z), .data = &payload });
+        }
+    }
+}
+
+fn benchExists(asset_mgr: *AssetManager, name: []const u8) !void {
+    var path_buf: [256]u8 = undefined;
+    var found: u32 = 0;
+    var timer = try std.time.Timer.start();
+    for (0..patches_per_side * 2) |patch_z| {
+        for (0..patches_per_side) |patch_x| {
+            // Half of these don't exist.
+            if (asset_mgr.doesAssetExist(IdLocal.init(patchPath(&path_buf, patch_x, patch_z)))) {
+                found += 1;
+            }
+        }
+    }
+    const checks = patches_per_side * patches_per_side * 2;
+    std.debug.print("{s: <24} {d: >8.2} us/check  ({} found)\n", .{
+        name,
+        @as(f64, @floatFromInt(timer.read())) / std.time.ns_per_us / checks,
+        found,
+    });
+}
+
+pub fn run(allocator: std.mem.Allocator) !void {
+    try writeContent();
+    defer std.fs.cwd().deleteTree(".bench_tmp") catch {};
+
+    {
+        // NOTE: The first pass also fills the existence cache, so only it hits the file system.
+        var asset_mgr = AssetManager.create(allocator);
+        defer asset_mgr.destroy();
+        try benchExists(&asset_mgr, "exists, file system");
+        try benchExists(&asset_mgr, "exists, cached");
+    }
+    {
+        var asset_mgr = AssetManager.create(allocator);
+        defer asset_mgr.destroy();
+        var timer = try std.time.Timer.start();
+        asset_mgr.scanContent(bench_dir);
+        std.debug.print("{s: <24} {d: >8.2} ms\n", .{ "scan", @as(f64, @floatFromInt(timer.read())) / std.time.ns_per_ms });
+        try benchExists(&asset_mgr, "exists, scanned");
+    }
+
+    var asset_mgr = AssetManager.create(allocator);
+    defer asset_mgr.destroy();
+    asset_mgr.setBudget(budget_bytes);
+
+    // Walk the window along z and back again, the way back revisits recently loaded patches.
+    var path_buf: [256]u8 = undefined;
+    const center_x = patches_per_side / 2;
+    var timer = try std.time.Timer.start();
+    for (0..2) |pass| {
+        for (window_radius..patches_per_side - window_radius) |step| {
+            const center_z = if (pass == 0) step else patches_per_side - 1 - step;
+            for (center_z - window_radius..center_z + window_radius + 1) |patch_z| {
+                for (center_x - window_radius..center_x + window_radius + 1) |patch_x| {
+                    const asset_id = IdLocal.init(patchPath(&path_buf, patch_x, patch_z));
+                    std.mem.doNotOptimizeAway(asset_mgr.loadAssetBlocking(asset_id, .soft_within_frames).ptr);
+                    asset_mgr.releaseAsset(asset_id);
+                }
+            }
+        }
+    }
+
+    const stats = asset_mgr.getStats();
+    const requests = stats.hits + stats.misses;
+    std.debug.print("streaming {d: >8.2} ms  {d: >5.1}% hits  {} evictions  resident {} KiB (peak {} KiB, budget {} KiB)\n", .{
+        @as(f64, @floatFromInt(timer.read())) / std.time.ns_per_ms,
+        @as(f64, @floatFromInt(stats.hits)) * 100 / @as(f64, @floatFromInt(requests)),
+        stats.evictions,
+        stats.resident_bytes / 1024,
+        stats.resident_bytes_peak / 1024,
+        budget_bytes / 1024,
+    });
+}
@@ -0,0 +1,109 @@
+const std = @import("std");
+
+const AssetManager = @import("../core/asset_manager.zig").AssetManager;
+const config = @import("../config/config.zig");
+const IdLocal = @import("../core/core.zig").IdLocal;
+const patch_types = @import("../worldpatch/patch_types.zig");
+const world_patch_manager = @import("../worldpatch/world_patch_manager.zig");
+
+// Per-frame timing helper shared by the benchmarks.
+pub const FrameTimes = struct {
+    total_ns: u64 = 0,
+    worst_ns: u64 = 0,
+    count: u64 = 0,
+
+    pub fn add(self: *FrameTimes, ns: u64) void {
+        self.total_ns += ns;
+        self.worst_ns = @max(self.worst_ns, ns);
+        self.count += 1;
+    }
+
+    pub fn averageMs(self: FrameTimes) f64 {
+        if (self.count == 0) {
+            return 0;
+        }
+        return @as(f64, @floatFromInt(self.total_ns / self.count)) / std.time.ns_per_ms;
+    }
+
+    pub fn worstMs(self: FrameTimes) f64 {
+        return @as(f64, @floatFromInt(self.worst_ns)) / std.time.ns_per_ms;
+    }
+};
+
+fn syntheticHeightmap(heightmap: *patch_types.Heightmap, lookup: world_patch_manager.PatchLookup) void {
+    const world_pos = lookup.getWorldPos();
+    const sample_spacing = std.math.pow(u32, 2, lookup.lod);
+    heightmap.min = std.math.floatMax(f32);
+    heightmap.max = -std.math.floatMax(f32);
+    for (0..config.patch_resolution) |z| {
+        for (0..config.patch_resolution) |x| {
+            const world_x: f32 = @floatFromInt(world_pos.world_x + @as(u32, @intCast(x)) * sample_spacing);
+            const world_z: f32 = @floatFromInt(world_pos.world_z + @as(u32, @intCast(z)) * sample_spacing);
+            const height = 100 + 20 * @sin(world_x * 0.02) * @cos(world_z * 0.03);
+            heightmap.heightmap[x + z * config.patch_resolution] = height;
+            heightmap.min = @min(heightmap.min, height);
+            heightmap.max = @max(heightmap.max, height);
+        }
+    }
+}
+
+// Fills heightmaps with a side x side block of patches starting at first_patch_x/z, row by row.
+// Uses the shipped heightmaps when they have been generated (content/patch/heightmap) and
+// synthetic hills otherwise. Returns how many came from content.
+pub fn loadHeightmapGrid(
+    allocator: std.mem.Allocator,
+    first_patch_x: u16,
+    first_patch_z: u16,
+    side: u16,
+    lod: world_patch_manager.LoD,
+    heightmaps: []patch_types.Heightmap,
+) !u32 {
+    std.debug.assert(heightmaps.len == @as(usize, side) * side);
+    var asset_mgr = AssetManager.create(allocator);
+    defer asset_mgr.destroy();
+    var world_patch_mgr = world_patch_manager.WorldPatchManager.create(allocator, &asset_mgr);
+    defer allocator.destroy(world_patch_mgr);
+    defer world_patch_mgr.destroy();
+    patch_types.registerPatchTypes(world_patch_mgr);
+    defer patch_types.closePatchArchives();
+
+    const patch_type_id = world_patch_mgr.getPatchTypeId(config.patch_type_heightmap);
+    const requester_id = world_patch_mgr.registerRequester(IdLocal.init("bench"));
+    var lookups = std.ArrayList(world_patch_manager.PatchLookup).init(allocator);
+    defer lookups.deinit();
+    for (0..side) |z| {
+        for (0..side) |x| {
+            try lookups.append(.{
+                .patch_x = @intCast(first_patch_x + x),
+                .patch_z = @intCast(first_patch_z + z),
+                .lod = lod,
+                .patch_type_id = patch_type_id,
+            });
+        }
+    }
+
+    // Loose files that don't exist would trip the asset manager, only ask for what's there.
+    var shipped = std.ArrayList(world_patch_manager.PatchLookup).init(allocator);
+    defer shipped.deinit();
+    for (lookups.items) |lookup| {
+        var path_buf: [256]u8 = undefined;
+        const path = try std.fmt.bufPrint(&path_buf, "content/patch/heightmap/lod{}/heightmap_x{}_z{}.heightmap", .{ lod, lookup.patch_x, lookup.patch_z });
+        if (asset_mgr.doesAssetExist(IdLocal.init(path))) {
+            try shipped.append(lookup);
+        }
+    }
+    world_patch_mgr.addLoadRequestFromLookups(requester_id, shipped.items, .high);
+    world_patch_mgr.tickAll();
+
+    var shipped_count: u32 = 0;
+    for (lookups.items, heightmaps) |lookup, *heightmap| {
+        if (world_patch_mgr.tryGetPatch(lookup, patch_types.Heightmap).data_opt) |data| {
+            heightmap.* = data.*;
+            shipped_count += 1;
+        } else {
+            syntheticHeightmap(heightmap, lookup);
+        }
+    }
+    world_patch_mgr.removeLoadRequestFromLookups(requester_id, shipped.items);
+    return shipped_count;
+}
@@ -0,0 +1,286 @@
+const std = @import("std");
+
+const bench_util = @import("bench_util.zig");
+const BucketQueue = @import("../core/bucket_queue.zig").BucketQueue;
+const Priority = @import("../worldpatch/world_patch_manager.zig").Priority;
+
+// Records the load request trace WorldPatchManager would send its queue while a player walks
+// across the world, then replays it against the indexed BucketQueue and the old linear scan
+// version. Every frame the requested window moves: patches that fall out of it are removed,
+// patches that changed distance ring are reprioritized, new ones are pushed, and a few are
+// popped for loading with some of them put back at the bottom (waiting on a dependency).
+
+const grid_side = 1024;
+const request_radius = 40;
+const frame_count = 600;
+const loads_per_frame = 16;
+
+const Handle = u32;
+const PatchQueue = BucketQueue(Handle, Priority);
+
+const TraceOp = union(enum) {
+    push: struct { handle: Handle, prio: Priority },
+    push_bottom: struct { handle: Handle, prio: Priority },
+    remove: Handle,
+    update: struct { handle: Handle, prio_old: Priority, prio_new: Priority },
+    pop: u32,
+};
+
+const Trace = struct {
+    ops: std.ArrayList(TraceOp),
+    frame_ends: std.ArrayList(usize),
+
+    fn deinit(self: *Trace) void {
+        self.ops.deinit();
+        self.frame_ends.deinit();
+    }
+};
+
+// The previous implementation, kept here for comparison.
+const LinearBucketQueue = struct {
+    const bucket_count = @typeInfo(Priority).@"enum".fields.len;
+
+    buckets: [bucket_count]std.ArrayList(Handle),
+    current_highest_prio: u32 = bucket_count - 1,
+
+    fn create(allocator: std.mem.Allocator) LinearBucketQueue {
+        var result = LinearBucketQueue{ .buckets = undefined };
+        for (&result.buckets) |*bucket| {
+            bucket.* = std.ArrayList(Handle).init(allocator);
+        }
+        return result;
+    }
+
+    fn destroy(self: *LinearBucketQueue) void {
+        for (&self.buckets) |*bucket| {
+            bucket.deinit();
+        }
+    }
+
+    fn peek(self: LinearBucketQueue) bool {
+        return self.buckets[self.current_highest_prio].items.len > 0;
+    }
+
+    fn pushElems(self: *LinearBucketQueue, elems: []const Handle, prio: Priority) void {
+        self.buckets[@intFromEnum(prio)].appendSlice(elems) catch unreachable;
+        self.current_highest_prio = @min(self.current_highest_prio, @intFromEnum(prio));
+    }
+
+    fn pushElemsToBottomOfBucket(self: *LinearBucketQueue, elems: []const Handle, prio: Priority) void {
+        self.buckets[@intFromEnum(prio)].insertSlice(0, elems) catch unreachable;
+        self.current_highest_prio = @min(self.current_highest_prio, @intFromEnum(prio));
+    }
+
+    fn popElems(self: *LinearBucketQueue, elems_out: []Handle) u32 {
+        var popped: u32 = 0;
+        for (elems_out) |*elem| {
+            if (!self.peek()) {
+                break;
+            }
+            elem.* = self.buckets[self.current_highest_prio].pop().?;
+            popped += 1;
+            self.skipEmpty();
+        }
+        return popped;
+    }
+
+    fn removeElems(self: *LinearBucketQueue, elems: []const Handle) void {
+        for (elems) |elem| {
+            for (&self.buckets) |*bucket| {
+                if (std.mem.indexOfScalar(Handle, bucket.items, elem)) |i| {
+                    _ = bucket.orderedRemove(i);
+                    break;
+                }
+            } else unreachable;
+        }
+        self.skipEmpty();
+    }
+
+    fn updateElems(self: *LinearBucketQueue, elems: []const Handle, prio_old: Priority, prio_new: Priority) void {
+        const bucket_old = &self.buckets[@intFromEnum(prio_old)];
+        for (elems) |elem| {
+            _ = bucket_old.orderedRemove(std.mem.indexOfScalar(Handle, bucket_old.items, elem).?);
+        }
+        self.pushElems(elems, prio_new);
+        self.skipEmpty();
+    }
+
+    fn skipEmpty(self: *LinearBucketQueue) void {
+        while (!self.peek() and self.current_highest_prio < bucket_count - 1) {
+            self.current_highest_prio += 1;
+        }
+    }
+};
+
+fn ringPriority(dx: i32, dz: i32) ?Priority {
+    const distance_sq = dx * dx + dz * dz;
+    if (distance_sq > request_radius * request_radius) {
+        return null;
+    }
+    if (distance_sq <= 4 * 4) {
+        return .come_on_do_it_do_it_come_on_do_it_now;
+    }
+    if (distance_sq <= 12 * 12) {
+        return .high;
+    }
+    if (distance_sq <= 24 * 24) {
+        return .medium;
+    }
+    return .low;
+}
+
+fn recordTrace(allocator: std.mem.Allocator) !Trace {
+    var trace = Trace{
+        .ops = std.ArrayList(TraceOp).init(allocator),
+        .frame_ends = std.ArrayList(usize).init(allocator),
+    };
+
+    // Drives a real queue while recording so that pops see the same state as the replays.
+    var queue = PatchQueue.create(allocator, .{ 4096, 4096, 4096, 4096 });
+    defer queue.destroy();
+    var requested = std.AutoHashMap(Handle, Priority).init(allocator);
+    defer requested.deinit();
+    var queued = std.AutoHashMap(Handle, void).init(allocator);
+    defer queued.deinit();
+    var next_requested = std.AutoHashMap(Handle, Priority).init(allocator);
+    defer next_requested.deinit();
+
+    var rng = std.Random.DefaultPrng.init(1234);
+    const rand = rng.random();
+    var pos_x: f32 = grid_side / 2;
+    var pos_z: f32 = grid_side / 2;
+    var heading: f32 = 0;
+
+    for (0..frame_count) |_| {
+        // Mostly running in one direction with the odd turn, roughly one patch every few frames.
+        heading += (rand.float(f32) - 0.5) * 0.2;
+        pos_x += @cos(heading) * 0.4;
+        pos_z += @sin(heading) * 0.4;
+        const center_x: i32 = @intFromFloat(pos_x);
+        const center_z: i32 = @intFromFloat(pos_z);
+
+        next_requested.clearRetainingCapacity();
+        var dz: i32 = -request_radius;
+        while (dz <= request_radius) : (dz += 1) {
+            var dx: i32 = -request_radius;
+            while (dx <= request_radius) : (dx += 1) {
+                const prio = ringPriority(dx, dz) orelse continue;
+                const handle: Handle = @intCast((center_x + dx) + (center_z + dz) * grid_side);
+                try next_requested.put(handle, prio);
+            }
+        }
+
+        var it_old = requested.iterator();
+        while (it_old.next()) |entry| {
+            const handle = entry.key_ptr.*;
+            const prio_old = entry.value_ptr.*;
+            const is_queued = queued.contains(handle);
+            if (next_requested.get(handle)) |prio_new| {
+                if (prio_new != prio_old and is_queued) {
+                    queue.updateElems(&.{handle}, prio_old, prio_new);
+                    try trace.ops.append(.{ .update = .{ .handle = handle, .prio_old = prio_old, .prio_new = prio_new } });
+                }
+            } else if (is_queued) {
+                queue.removeElems(&.{handle});
+                _ = queued.remove(handle);
+                try trace.ops.append(.{ .remove = handle });
+            }
+        }
+
+        var it_new = next_requested.iterator();
+        while (it_new.next()) |entry| {
+            if (!requested.contains(entry.key_ptr.*)) {
+                queue.pushElems(&.{entry.key_ptr.*}, entry.value_ptr.*);
+                try queued.put(entry.key_ptr.*, {});
+                try trace.ops.append(.{ .push = .{ .handle = entry.key_ptr.*, .prio = entry.value_ptr.* } });
+            }
+        }
+
+        std.mem.swap(std.AutoHashMap(Handle, Priority), &requested, &next_requested);
+
+        var loads: [loads_per_frame]Handle = undefined;
+        const popped = queue.popElems(&loads);
+        try trace.ops.append(.{ .pop = popped });
+        for (loads[0..popped]) |handle| {
+            if (handle % 8 == 0) {
+                // Dependency not ready yet, try again later.
+                const prio = requested.get(handle).?;
+                queue.pushElemsToBottomOfBucket(&.{handle}, prio);
+                try trace.ops.append(.{ .push_bottom = .{ .handle = handle, .prio = prio } });
+            } else {
+                _ = queued.remove(handle);
+            }
+        }
+
+        try trace.frame_ends.append(trace.ops.items.len);
+    }
+
+    return trace;
+}
+
+fn replay(comptime Queue: type, queue: *Queue, trace: Trace, name: []const u8) !u64 {
+    var frame_times = bench_util.FrameTimes{};
+    var checksum: u64 = 0;
+    var op_index: usize = 0;
+    for (trace.frame_ends.items) |frame_end| {
+        var timer = try std.time.Timer.start();
+        for (trace.ops.items[op_index..frame_end]) |op| {
+            switch (op) {
+                .push => |push| queue.pushElems(&.{push.handle}, push.prio),
+                .push_bottom => |push| queue.pushElemsToBottomOfBucket(&.{push.handle}, push.prio),
+                .remove => |handle| queue.removeElems(&.{handle}),
+                .update => |update| queue.updateElems(&.{update.handle}, update.prio_old, update.prio_new),
+                .pop => |pop_count| {
+                    var loads: [loads_per_frame]Handle = undefined;
+                    const popped = queue.popElems(loads[0..pop_count]);
+                    for (loads[0..popped]) |handle| {
+                        checksum = checksum *% 31 +% handle;
+                    }
+                },
+            }
+        }
+        frame_times.add(timer.read());
+        op_index = frame_end;
+    }
+
+    std.debug.print("{s: <24} avg {d: >7.3} ms  worst {d: >7.3} ms\n", .{
+        name,
+        frame_times.averageMs(),
+        frame_times.worstMs(),
+    });
+    return checksum;
+}
+
+pub fn run(allocator: std.mem.Allocator) !void {
+    var trace = try recordTrace(allocator);
+    defer trace.deinit();
+
+    var counts: struct { push: usize = 0, push_bottom: usize = 0, remove: usize = 0, update: usize = 0 } = .{};
+    for (trace.ops.items) |op| {
+        switch (op) {
+            .push => counts.push += 1,
+            .push_bottom => counts.push_bottom += 1,
+            .remove => counts.remove += 1,
+            .update => counts.update += 1,
+            .pop => {},
+        }
+    }
+    std.debug.print("trace: {} frames, {} pushes, {} bottom pushes, {} removes, {} updates\n", .{
+        frame_count,
+        counts.push,
+        counts.push_bottom,
+        counts.remove,
+        counts.update,
+    });
+
+    var indexed = PatchQueue.create(allocator, .{ 16 * 8192, 16 * 8192, 16 * 8192, 16 * 8192 });
+    defer indexed.destroy();
+    const checksum_indexed = try replay(PatchQueue, &indexed, trace, "indexed");
+
+    var linear = LinearBucketQueue.create(allocator);
+    defer linear.destroy();
+    const checksum_linear = try replay(LinearBucketQueue, &linear, trace, "linear scan");
+
+    // Both must hand out loads in the same order.
+    std.debug.assert(checksum_indexed == checksum_linear);
+}
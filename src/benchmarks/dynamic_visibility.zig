@@ -0,0 +1,267 @@
+const std = @import("std");
+const zm = @import("zmath");
+
+const bench_util = @import("bench_util.zig");
+const dynamic_visibility = @import("../renderer/dynamic_visibility.zig");
+const terrain_quad_tree = @import("../renderer/terrain_quad_tree.zig");
+const DrawList = dynamic_visibility.DrawList;
+const DynamicVisibility = dynamic_visibility.DynamicVisibility;
+
+// 100k dynamic entities wandering around a 2 km square, like animals and NPCs, seen by a camera
+// walking through them. Every frame the moved entities get new world matrices and the camera's
+// draw list is built. Compares the dynamic geometry pass's old way (copy every entity, cull and
+// pick a LoD one at a time, bucket into a hashmap) against the SoA visibility stage, with every
+// entity or a tenth of them moving, and with a still camera where temporal coherence reuses
+// what nothing moved in. No meshes or GPU work, models only have bounds.
+
+const entity_count = 100_000;
+const model_count = 24;
+const area_size = 2000.0;
+const frame_count = 100;
+const near_plane = 0.1;
+const far_plane = 5000.0;
+const max_draw_distance = 20000.0;
+const speed = 0.05; // Meters per frame
+
+const Model = struct {
+    bounds_center: [3]f32,
+    bounds_radius: f32,
+    lod_count: u32,
+};
+
+const Scene = struct {
+    models: []Model,
+    entity_models: []u32,
+    positions: [][3]f32,
+    headings: []f32,
+    scales: []f32,
+    worlds: []zm.Mat,
+
+    fn create(allocator: std.mem.Allocator) !Scene {
+        var rng = std.Random.DefaultPrng.init(2024);
+        const rand = rng.random();
+        const scene = Scene{
+            .models = try allocator.alloc(Model, model_count),
+            .entity_models = try allocator.alloc(u32, entity_count),
+            .positions = try allocator.alloc([3]f32, entity_count),
+            .headings = try allocator.alloc(f32, entity_count),
+            .scales = try allocator.alloc(f32, entity_count),
+            .worlds = try allocator.alloc(zm.Mat, entity_count),
+        };
+        for (scene.models) |*model| {
+            const radius = 0.5 + rand.float(f32) * 2.5;
+            model.* = .{ .bounds_center = .{ 0, radius, 0 }, .bounds_radius = radius, .lod_count = rand.intRangeAtMost(u32, 1, dynamic_visibility.lods_max_count) };
+        }
+        for (0..entity_count) |i| {
+            scene.entity_models[i] = rand.uintLessThan(u32, model_count);
+            scene.positions[i] = .{ rand.float(f32) * area_size - area_size / 2, rand.float(f32) * 20, rand.float(f32) * area_size - area_size / 2 };
+            scene.headings[i] = rand.float(f32) * std.math.tau;
+            scene.scales[i] = 0.8 + rand.float(f32) * 0.4;
+            scene.updateWorld(i);
+        }
+        return scene;
+    }
+
+    fn destroy(self: Scene, allocator: std.mem.Allocator) void {
+        allocator.free(self.models);
+        allocator.free(self.entity_models);
+        allocator.free(self.positions);
+        allocator.free(self.headings);
+        allocator.free(self.scales);
+        allocator.free(self.worlds);
+    }
+
+    fn updateWorld(self: Scene, i: usize) void {
+        const scale = self.scales[i];
+        self.worlds[i] = zm.mul(zm.mul(zm.scaling(scale, scale, scale), zm.rotationY(self.headings[i])), zm.translationV(zm.loadArr3(self.positions[i])));
+    }
+
+    // Stands in for the transform systems and isn't timed.
+    fn moveEntities(self: Scene, frame: usize, moving_divisor: usize) void {
+        for (0..entity_count) |i| {
+            if ((i + frame) % moving_divisor != 0) {
+                continue;
+            }
+            self.headings[i] += 0.01;
+            self.positions[i][0] += @sin(self.headings[i]) * speed * @as(f32, @floatFromInt(moving_divisor));
+            self.positions[i][2] += @cos(self.headings[i]) * speed * @as(f32, @floatFromInt(moving_divisor));
+            self.updateWorld(i);
+        }
+    }
+};
+
+// Reversed Z like the renderer.
+fn cameraView(frame: usize, camera_moving: bool) dynamic_visibility.VisibilityView {
+    const t: f32 = if (camera_moving) @floatFromInt(frame) else 0;
+    const camera_position = [3]f32{ -300 + t * 1.5, 2, -200 };
+    const direction = zm.f32x4(@sin(0.3 + t * 0.004), 0, @cos(0.3 + t * 0.004), 0);
+    const view_matrix = zm.lookToLh(zm.loadArr3w(camera_position, 1), direction, zm.f32x4(0, 1, 0, 0));
+    const projection = zm.perspectiveFovLh(1.0, 16.0 / 9.0, far_plane, near_plane);
+    var view_projection: [16]f32 = undefined;
+    zm.storeMat(&view_projection, zm.mul(view_matrix, projection));
+
+    return .{
+        .frustum_planes = terrain_quad_tree.frustumPlanes(view_projection),
+        .camera_position = camera_position,
+        .projection_scale = projection[1][1],
+        .max_draw_distance = max_draw_distance,
+    };
+}
+
+fn boundsCenter(model: Model, world: zm.Mat) [3]f32 {
+    var center: [3]f32 = undefined;
+    zm.storeArr3(&center, zm.mul(zm.loadArr3w(model.bounds_center, 1.0), world));
+    return center;
+}
+
+const Options = struct {
+    moving_divisor: usize = 1, // Every nth entity moves each frame
+    camera_moving: bool = true,
+    temporal_coherence: bool = true,
+};
+
+// DynamicGeometryPass.batchEntities before the visibility stage, minus the mesh lookups.
+const OldEntity = struct {
+    world: zm.Mat,
+    position: [3]f32,
+    scale: f32,
+    model: u32,
+};
+
+fn runPerEntity(allocator: std.mem.Allocator, scene: Scene, options: Options) !void {
+    var entities = std.ArrayList(OldEntity).init(allocator);
+    defer entities.deinit();
+    var batches = std.AutoHashMap(u64, std.ArrayList(u32)).init(allocator);
+    defer {
+        var batch_iterator = batches.valueIterator();
+        while (batch_iterator.next()) |batch| {
+            batch.deinit();
+        }
+        batches.deinit();
+    }
+
+    var frame_times = bench_util.FrameTimes{};
+    var instances_visible: u64 = 0;
+    for (0..frame_count) |frame| {
+        scene.moveEntities(frame, options.moving_divisor);
+        const view = cameraView(frame, options.camera_moving);
+
+        var timer = try std.time.Timer.start();
+        entities.clearRetainingCapacity();
+        for (scene.worlds, scene.positions, scene.scales, scene.entity_models) |world, position, scale, model| {
+            try entities.append(.{ .world = world, .position = position, .scale = scale, .model = model });
+        }
+
+        var batch_iterator = batches.valueIterator();
+        while (batch_iterator.next()) |batch| {
+            batch.clearRetainingCapacity();
+        }
+
+        const camera_position = zm.loadArr3(view.camera_position);
+        for (entities.items, 0..) |entity, i| {
+            const distance_squared = zm.lengthSq3(camera_position - zm.loadArr3(entity.position))[0];
+            if (distance_squared > max_draw_distance * max_draw_distance) {
+                continue;
+            }
+
+            const model = scene.models[entity.model];
+            const center = boundsCenter(model, entity.world);
+            const radius = model.bounds_radius * entity.scale;
+            var visible = true;
+            for (view.frustum_planes) |plane| {
+                if (plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3] < -radius) {
+                    visible = false;
+                    break;
+                }
+            }
+            if (!visible) {
+                continue;
+            }
+
+            var lod: u32 = 0;
+            if (distance_squared >= 200.0 * 200.0) {
+                lod = 3;
+            } else if (distance_squared >= 100.0 * 100.0) {
+                lod = 2;
+            } else if (distance_squared >= 50.0 * 50.0) {
+                lod = 1;
+            }
+            lod = @min(lod, model.lod_count - 1);
+
+            const result = try batches.getOrPut(@as(u64, entity.model) * dynamic_visibility.lods_max_count + lod);
+            if (!result.found_existing) {
+                result.value_ptr.* = std.ArrayList(u32).init(allocator);
+            }
+            try result.value_ptr.append(@intCast(i));
+            instances_visible += 1;
+        }
+        frame_times.add(timer.read());
+    }
+
+    printResult("per entity", options, frame_times, instances_visible / frame_count, null);
+}
+
+fn runVisibility(allocator: std.mem.Allocator, scene: Scene, options: Options) !void {
+    const visibility = DynamicVisibility.create(allocator);
+    defer visibility.destroy();
+    var draw_list = DrawList{};
+    defer draw_list.deinit(allocator);
+
+    for (0..entity_count) |i| {
+        const slot = visibility.allocateSlot();
+        const model = scene.models[scene.entity_models[i]];
+        visibility.setModel(slot, scene.entity_models[i], model.lod_count);
+        visibility.setBounds(slot, boundsCenter(model, scene.worlds[i]), model.bounds_radius * scene.scales[i]);
+    }
+
+    var frame_times = bench_util.FrameTimes{};
+    var instances_visible: u64 = 0;
+    var groups_reused: u64 = 0;
+    for (0..frame_count) |frame| {
+        scene.moveEntities(frame, options.moving_divisor);
+        var view = cameraView(frame, options.camera_moving);
+        view.temporal_coherence = options.temporal_coherence;
+
+        // Only the moved entities are sent, like the renderer system's change detection would.
+        var timer = try std.time.Timer.start();
+        var i = (options.moving_divisor - frame % options.moving_divisor) % options.moving_divisor;
+        while (i < entity_count) : (i += options.moving_divisor) {
+            const model = scene.models[scene.entity_models[i]];
+            visibility.setBounds(@intCast(i), boundsCenter(model, scene.worlds[i]), model.bounds_radius * scene.scales[i]);
+        }
+        visibility.cull(&draw_list, view);
+        frame_times.add(timer.read());
+        instances_visible += draw_list.instances_visible;
+        groups_reused += draw_list.groups_reused;
+    }
+
+    const name = if (options.temporal_coherence) "soa" else "soa, no coherence";
+    printResult(name, options, frame_times, instances_visible / frame_count, groups_reused / frame_count);
+}
+
+fn printResult(name: []const u8, options: Options, frame_times: bench_util.FrameTimes, instances_visible: u64, groups_reused: ?u64) void {
+    std.debug.print("{s: <18} {s: <12} 1/{: <3} moving  avg {d: >7.3} ms  worst {d: >7.3} ms  {} visible", .{
+        name,
+        if (options.camera_moving) "camera walks" else "camera still",
+        options.moving_divisor,
+        frame_times.averageMs(),
+        frame_times.worstMs(),
+        instances_visible,
+    });
+    if (groups_reused) |reused| {
+        std.debug.print(", {} of {} groups reused", .{ reused, entity_count / dynamic_visibility.group_size });
+    }
+    std.debug.print("\n", .{});
+}
+
+pub fn run(allocator: std.mem.Allocator) !void {
+    const scene = try Scene.create(allocator);
+    defer scene.destroy(allocator);
+
+    try runPerEntity(allocator, scene, .{});
+    try runVisibility(allocator, scene, .{});
+    try runPerEntity(allocator, scene, .{ .moving_divisor = 10 });
+    try runVisibility(allocator, scene, .{ .moving_divisor = 10 });
+    try runVisibility(allocator, scene, .{ .moving_divisor = 10, .camera_moving = false });
+    try runVisibility(allocator, scene, .{ .moving_divisor = 10, .camera_moving = false, .temporal_coherence = false });
+}
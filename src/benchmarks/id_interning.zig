@@ -0,0 +1,76 @@
+const std = @import("std");
+
+const core = @import("../core/core.zig");
+const IdHandle = core.IdHandle;
+const IdLocal = core.IdLocal;
+
+// IdLocal vs interned IdHandle: struct sizes, hash map lookups and bulk copies.
+
+const key_count = 256;
+const lookup_count = 1 << 20;
+
+fn report(name: []const u8, ns: u64, count: usize) void {
+    std.debug.print("{s: <28} {d: >8.2} ns/op\n", .{
+        name,
+        @as(f64, @floatFromInt(ns)) / @as(f64, @floatFromInt(count)),
+    });
+}
+
+fn benchLookups(comptime Map: type, allocator: std.mem.Allocator, keys: anytype, name: []const u8) !void {
+    var map = Map.init(allocator);
+    defer map.deinit();
+    for (keys, 0..) |key, index| {
+        try map.put(key, @intCast(index));
+    }
+
+    var rng = std.Random.DefaultPrng.init(1234);
+    const rand = rng.random();
+    var sum: u64 = 0;
+    var timer = try std.time.Timer.start();
+    for (0..lookup_count) |_| {
+        sum +%= map.get(keys[rand.uintLessThan(usize, keys.len)]).?;
+    }
+    report(name, timer.read(), lookup_count);
+    std.mem.doNotOptimizeAway(sum);
+}
+
+fn benchCopy(comptime T: type, allocator: std.mem.Allocator, keys: []const T, name: []const u8) !void {
+    const copies = 1024;
+    const dst = try allocator.alloc(T, keys.len);
+    defer allocator.free(dst);
+
+    var timer = try std.time.Timer.start();
+    for (0..copies) |_| {
+        @memcpy(dst, keys);
+        std.mem.doNotOptimizeAway(dst.ptr);
+    }
+    report(name, timer.read(), copies * keys.len);
+}
+
+pub fn run(allocator: std.mem.Allocator) !void {
+    std.debug.print("@sizeOf IdLocal {}  IdHandle {}\n", .{ @sizeOf(IdLocal), @sizeOf(IdHandle) });
+    // ProfileData used to carry both a [256]u8 name and an IdLocal, the renderer isn't linked in here.
+    std.debug.print("ProfileData name + id: {} -> {} bytes\n", .{ 256 + @sizeOf(IdLocal), @sizeOf(IdHandle) });
+
+    var local_keys: [key_count]IdLocal = undefined;
+    var handle_keys: [key_count]IdHandle = undefined;
+    var name_buf: [64]u8 = undefined;
+    for (0..key_count) |index| {
+        const name = std.fmt.bufPrint(&name_buf, "bench_target_{}", .{index}) catch unreachable;
+        local_keys[index] = IdLocal.init(name);
+        handle_keys[index] = IdHandle.init(name);
+    }
+
+    var timer = try std.time.Timer.start();
+    for (0..lookup_count) |index| {
+        std.mem.doNotOptimizeAway(IdHandle.fromId(local_keys[index % key_count]));
+    }
+    report("intern existing", timer.read(), lookup_count);
+
+    try benchLookups(std.AutoHashMap(IdLocal, u32), allocator, &local_keys, "AutoHashMap(IdLocal)");
+    try benchLookups(core.IdLocalHashMap(u32), allocator, &local_keys, "IdLocalHashMap");
+    try benchLookups(std.AutoHashMap(IdHandle, u32), allocator, &handle_keys, "AutoHashMap(IdHandle)");
+
+    try benchCopy(IdLocal, allocator, &local_keys, "copy IdLocal");
+    try benchCopy(IdHandle, allocator, &handle_keys, "copy IdHandle");
+}
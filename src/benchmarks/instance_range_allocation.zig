@@ -0,0 +1,296 @@
+const std = @import("std");
+
+const bench_util = @import("bench_util.zig");
+const RangeAllocator = @import("../core/range_allocator.zig").RangeAllocator;
+
+// Replays the instance buffer bookkeeping of the static geometry pass while the player walks
+// across the world and patches of props stream in and out around them. Compares the old way
+// (an entity hashmap plus a sorted list of free ranges that's re-compacted on every unload and
+// popped from the front as it fills up) against the RangeAllocator, handing out one slot per
+// prop like the pass does and one range per patch. Only the CPU side is timed, no GPU uploads.
+
+const patches_per_side = 64;
+const load_radius = 4;
+const props_min = 50;
+const props_max = 1500;
+const frames_per_patch = 30;
+const capacity = 1 << 20;
+
+const Range = struct {
+    index: u32,
+    count: u32,
+};
+
+const FrameEvents = struct {
+    loaded: []const u32,
+    unloaded: []const u32,
+};
+
+const Trace = struct {
+    props_per_patch: []u32,
+    frames: []FrameEvents,
+
+    // Walks a loop around the middle of the world, a patch every frames_per_patch frames.
+    fn create(allocator: std.mem.Allocator) !Trace {
+        var rng = std.Random.DefaultPrng.init(4321);
+        const rand = rng.random();
+        const props_per_patch = try allocator.alloc(u32, patches_per_side * patches_per_side);
+        for (props_per_patch) |*count| {
+            count.* = rand.intRangeAtMost(u32, props_min, props_max);
+        }
+
+        var path = std.ArrayList([2]i32).init(allocator);
+        defer path.deinit();
+        const side = 40;
+        const start = (patches_per_side - side) / 2;
+        for (0..side) |i| {
+            const step: i32 = @intCast(i);
+            try path.append(.{ start + step, start });
+        }
+        for (0..side) |i| {
+            const step: i32 = @intCast(i);
+            try path.append(.{ start + side, start + step });
+        }
+        for (0..side) |i| {
+            const step: i32 = @intCast(i);
+            try path.append(.{ start + side - step, start + side });
+        }
+        for (0..side) |i| {
+            const step: i32 = @intCast(i);
+            try path.append(.{ start, start + side - step });
+        }
+
+        var frames = std.ArrayList(FrameEvents).init(allocator);
+        const loaded = try allocator.alloc(bool, props_per_patch.len);
+        defer allocator.free(loaded);
+        @memset(loaded, false);
+        for (path.items) |position| {
+            var loaded_now = std.ArrayList(u32).init(allocator);
+            var unloaded_now = std.ArrayList(u32).init(allocator);
+            for (0..patches_per_side) |z| {
+                for (0..patches_per_side) |x| {
+                    const patch: u32 = @intCast(z * patches_per_side + x);
+                    const dx = @as(i32, @intCast(x)) - position[0];
+                    const dz = @as(i32, @intCast(z)) - position[1];
+                    const in_range = dx * dx + dz * dz <= load_radius * load_radius;
+                    if (in_range and !loaded[patch]) {
+                        try loaded_now.append(patch);
+                    } else if (!in_range and loaded[patch]) {
+                        try unloaded_now.append(patch);
+                    }
+                    loaded[patch] = in_range;
+                }
+            }
+            try frames.append(.{ .loaded = try loaded_now.toOwnedSlice(), .unloaded = try unloaded_now.toOwnedSlice() });
+            for (1..frames_per_patch) |_| {
+                try frames.append(.{ .loaded = &.{}, .unloaded = &.{} });
+            }
+        }
+
+        return .{ .props_per_patch = props_per_patch, .frames = try frames.toOwnedSlice() };
+    }
+
+    fn destroy(self: Trace, allocator: std.mem.Allocator) void {
+        for (self.frames) |frame| {
+            allocator.free(frame.loaded);
+            allocator.free(frame.unloaded);
+        }
+        allocator.free(self.frames);
+        allocator.free(self.props_per_patch);
+    }
+};
+
+fn entityId(patch: u32, prop: u32) u64 {
+    return @as(u64, patch) << 32 | prop;
+}
+
+// StaticGeometryPass.update before it used the RangeAllocator, minus the GPU work.
+const FreeRangeSlots = struct {
+    free_ranges: std.ArrayList(Range),
+    instances_to_destroy: std.ArrayList(Range),
+    entity_map: std.AutoHashMap(u64, Range),
+    element_count: u32 = 0,
+
+    fn create(allocator: std.mem.Allocator) FreeRangeSlots {
+        return .{
+            .free_ranges = std.ArrayList(Range).init(allocator),
+            .instances_to_destroy = std.ArrayList(Range).init(allocator),
+            .entity_map = std.AutoHashMap(u64, Range).init(allocator),
+        };
+    }
+
+    fn destroy(self: *FreeRangeSlots) void {
+        self.free_ranges.deinit();
+        self.instances_to_destroy.deinit();
+        self.entity_map.deinit();
+    }
+
+    fn update(self: *FreeRangeSlots, allocator: std.mem.Allocator, added: []const u64, removed: []const u64) void {
+        self.instances_to_destroy.clearRetainingCapacity();
+        for (removed) |entity_id| {
+            if (self.entity_map.fetchRemove(entity_id)) |kv| {
+                self.instances_to_destroy.append(kv.value) catch unreachable;
+            }
+        }
+
+        if (self.instances_to_destroy.items.len > 0) {
+            var compacted_list = std.ArrayList(Range).init(allocator);
+            defer compacted_list.deinit();
+            calculatePrefixSum(&self.instances_to_destroy, &compacted_list);
+            compacted_list.appendSlice(self.free_ranges.items) catch unreachable;
+            self.free_ranges.clearRetainingCapacity();
+            calculatePrefixSum(&compacted_list, &self.free_ranges);
+        }
+
+        var processed: usize = 0;
+        var filled_up_ranges: usize = 0;
+        for (self.free_ranges.items) |*free_range| {
+            const count: u32 = @intCast(@min(free_range.count, added.len - processed));
+            for (0..count) |i| {
+                self.entity_map.put(added[processed + i], .{ .index = free_range.index + @as(u32, @intCast(i)), .count = 1 }) catch unreachable;
+            }
+            processed += count;
+            free_range.count -= count;
+            free_range.index += count;
+            if (free_range.count == 0) {
+                filled_up_ranges += 1;
+            }
+            if (processed == added.len) {
+                break;
+            }
+        }
+        for (0..filled_up_ranges) |_| {
+            _ = self.free_ranges.orderedRemove(0);
+        }
+        for (added[processed..]) |entity_id| {
+            self.entity_map.put(entity_id, .{ .index = self.element_count, .count = 1 }) catch unreachable;
+            self.element_count += 1;
+        }
+    }
+
+    fn calculatePrefixSum(source: *std.ArrayList(Range), destination: *std.ArrayList(Range)) void {
+        std.mem.sort(Range, source.items, {}, rangesSorter);
+        var current_range = source.items[0];
+        for (source.items[1..]) |range| {
+            if (current_range.index + current_range.count == range.index) {
+                current_range.count += range.count;
+            } else {
+                destination.append(current_range) catch unreachable;
+                current_range = range;
+            }
+        }
+        destination.append(current_range) catch unreachable;
+    }
+
+    fn rangesSorter(_: void, a: Range, b: Range) bool {
+        return a.index < b.index;
+    }
+
+    fn fragmentation(self: FreeRangeSlots) f32 {
+        var free_total: u32 = capacity - self.element_count;
+        var largest: u32 = free_total;
+        for (self.free_ranges.items) |range| {
+            free_total += range.count;
+            largest = @max(largest, range.count);
+        }
+        return 1 - @as(f32, @floatFromInt(largest)) / @as(f32, @floatFromInt(free_total));
+    }
+};
+
+const Result = struct {
+    frame_times: bench_util.FrameTimes = .{},
+    fragmentation_worst: f32 = 0,
+    high_water_mark: u32 = 0,
+};
+
+fn runFreeRanges(allocator: std.mem.Allocator, trace: Trace) !Result {
+    var slots = FreeRangeSlots.create(allocator);
+    defer slots.destroy();
+    var added = std.ArrayList(u64).init(allocator);
+    defer added.deinit();
+    var removed = std.ArrayList(u64).init(allocator);
+    defer removed.deinit();
+
+    var result = Result{};
+    for (trace.frames) |frame| {
+        // Building the event lists stands in for the ecs observer and isn't timed.
+        added.clearRetainingCapacity();
+        removed.clearRetainingCapacity();
+        for (frame.unloaded) |patch| {
+            for (0..trace.props_per_patch[patch]) |prop| {
+                try removed.append(entityId(patch, @intCast(prop)));
+            }
+        }
+        for (frame.loaded) |patch| {
+            for (0..trace.props_per_patch[patch]) |prop| {
+                try added.append(entityId(patch, @intCast(prop)));
+            }
+        }
+
+        var timer = try std.time.Timer.start();
+        slots.update(allocator, added.items, removed.items);
+        result.frame_times.add(timer.read());
+        result.fragmentation_worst = @max(result.fragmentation_worst, slots.fragmentation());
+    }
+    result.high_water_mark = slots.element_count;
+    return result;
+}
+
+// The slots live with the props, like the StaticInstance component.
+fn runRangeAllocator(allocator: std.mem.Allocator, trace: Trace, per_patch: bool) !Result {
+    var slots = RangeAllocator.create(allocator, capacity);
+    defer slots.destroy();
+    const patch_slots = try allocator.alloc(std.ArrayListUnmanaged(RangeAllocator.Allocation), trace.props_per_patch.len);
+    defer {
+        for (patch_slots) |*patch_slot| {
+            patch_slot.deinit(allocator);
+        }
+        allocator.free(patch_slots);
+    }
+    @memset(patch_slots, .{});
+
+    var result = Result{};
+    for (trace.frames) |frame| {
+        var timer = try std.time.Timer.start();
+        for (frame.unloaded) |patch| {
+            for (patch_slots[patch].items) |slot| {
+                slots.free(slot);
+            }
+            patch_slots[patch].clearRetainingCapacity();
+        }
+        for (frame.loaded) |patch| {
+            const prop_count = trace.props_per_patch[patch];
+            if (per_patch) {
+                try patch_slots[patch].append(allocator, slots.alloc(prop_count).?);
+            } else {
+                const patch_slot = try patch_slots[patch].addManyAsSlice(allocator, prop_count);
+                for (patch_slot) |*slot| {
+                    slot.* = slots.alloc(1).?;
+                }
+            }
+        }
+        result.frame_times.add(timer.read());
+        result.fragmentation_worst = @max(result.fragmentation_worst, slots.fragmentation());
+    }
+    result.high_water_mark = slots.high_water_mark;
+    return result;
+}
+
+fn printResult(name: []const u8, result: Result) void {
+    std.debug.print("{s: <28} avg {d: >7.3} ms  worst {d: >7.3} ms  worst fragmentation {d: >5.3}  high water mark {}\n", .{
+        name,
+        result.frame_times.averageMs(),
+        result.frame_times.worstMs(),
+        result.fragmentation_worst,
+        result.high_water_mark,
+    });
+}
+
+pub fn run(allocator: std.mem.Allocator) !void {
+    const trace = try Trace.create(allocator);
+    defer trace.destroy(allocator);
+
+    printResult("free ranges + hashmap", try runFreeRanges(allocator, trace));
+    printResult("range allocator, per prop", try runRangeAllocator(allocator, trace, false));
+    printResult("range allocator, per patch", try runRangeAllocator(allocator, trace, true));
+}
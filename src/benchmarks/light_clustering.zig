@@ -0,0 +1,112 @@
+const std = @import("std");
+const zm = @import("zmath");
+
+const bench_util = @import("bench_util.zig");
+const light_clustering = @import("../renderer/light_clustering.zig");
+const LightClusterer = light_clustering.LightClusterer;
+
+// Point lights scattered over a 1 km square around a camera standing in a settlement, like torches
+// and fires, bucketed into the deferred shading pass's clusters on one thread and on workers.
+// Reports how many lights the average cluster ends up with, which is what shading walks per
+// pixel instead of every light. The brute force assignment the tests check against is timed for
+// the smallest count.
+
+const light_counts = [_]usize{ 1_000, 5_000, 10_000, 50_000 };
+const area_size = 1000.0;
+const frame_count = 20;
+const near_plane = 0.1;
+const far_plane = 5000.0;
+
+fn createLights(allocator: std.mem.Allocator, count: usize) ![]light_clustering.LightSphere {
+    var rng = std.Random.DefaultPrng.init(777);
+    const rand = rng.random();
+    const lights = try allocator.alloc(light_clustering.LightSphere, count);
+    for (lights) |*light| {
+        light.* = .{
+            .center = .{ rand.float(f32) * area_size - area_size / 2, rand.float(f32) * 10, rand.float(f32) * area_size - area_size / 2 },
+            .radius = 2 + rand.float(f32) * 10,
+        };
+    }
+    return lights;
+}
+
+fn clusterView() light_clustering.ClusterView {
+    // Reversed Z like the renderer.
+    const view_matrix = zm.lookToLh(zm.f32x4(0, 2, 0, 1), zm.f32x4(0, 0, 1, 0), zm.f32x4(0, 1, 0, 0));
+    const projection = zm.perspectiveFovLh(1.0, 16.0 / 9.0, far_plane, near_plane);
+    var view = light_clustering.ClusterView{
+        .view = undefined,
+        .projection = undefined,
+        .near_plane = near_plane,
+        .far_plane = far_plane,
+    };
+    zm.storeMat(&view.view, view_matrix);
+    zm.storeMat(&view.projection, projection);
+    return view;
+}
+
+fn runClustering(allocator: std.mem.Allocator, name: []const u8, worker_count: u32, lights: []const light_clustering.LightSphere) !void {
+    var pool: std.Thread.Pool = undefined;
+    try pool.init(.{ .allocator = allocator, .n_jobs = @max(worker_count, 1) });
+    defer pool.deinit();
+    const clusterer = LightClusterer.create(allocator, if (worker_count > 0) &pool else null);
+    defer clusterer.destroy();
+
+    var frame_times = bench_util.FrameTimes{};
+    for (0..frame_count) |_| {
+        var timer = try std.time.Timer.start();
+        clusterer.assign(lights, clusterView());
+        frame_times.add(timer.read());
+    }
+
+    var occupied_clusters: usize = 0;
+    var max_cluster_lights: u32 = 0;
+    for (clusterer.cluster_lights) |cluster| {
+        occupied_clusters += @intFromBool(cluster.count > 0);
+        max_cluster_lights = @max(max_cluster_lights, cluster.count);
+    }
+    const average_cluster_lights = @as(f64, @floatFromInt(clusterer.light_indices.items.len)) / @as(f64, @floatFromInt(@max(occupied_clusters, 1)));
+
+    std.debug.print("{:>6} lights, {s: <12} avg {d: >7.3} ms  worst {d: >7.3} ms  {} visible, {d:.1} per occupied cluster, {} at most\n", .{
+        lights.len,
+        name,
+        frame_times.averageMs(),
+        frame_times.worstMs(),
+        clusterer.lights_visible,
+        average_cluster_lights,
+        max_cluster_lights,
+    });
+}
+
+fn runBruteForce(allocator: std.mem.Allocator, lights: []const light_clustering.LightSphere) !void {
+    var cluster_lights = std.ArrayList(std.ArrayListUnmanaged(u32)).init(allocator);
+    defer {
+        for (cluster_lights.items) |*list| {
+            list.deinit(allocator);
+        }
+        cluster_lights.deinit();
+    }
+
+    var timer = try std.time.Timer.start();
+    light_clustering.assignBruteForce(allocator, clusterView(), lights, 0, &cluster_lights);
+    const elapsed_ms = @as(f64, @floatFromInt(timer.read())) / std.time.ns_per_ms;
+    std.debug.print("{:>6} lights, {s: <12} {d: >7.3} ms\n", .{ lights.len, "brute force", elapsed_ms });
+}
+
+pub fn run(allocator: std.mem.Allocator) !void {
+    const cpu_count: u32 = @intCast(std.Thread.getCpuCount() catch 4);
+    var name_buf: [32]u8 = undefined;
+    const all_threads_name = try std.fmt.bufPrint(&name_buf, "{} threads", .{cpu_count});
+
+    for (light_counts) |light_count| {
+        const lights = try createLights(allocator, light_count);
+        defer allocator.free(lights);
+
+        try runClustering(allocator, "1 thread", 0, lights);
+        try runClustering(allocator, "4 threads", 3, lights);
+        try runClustering(allocator, all_threads_name, cpu_count - 1, lights);
+        if (light_count == light_counts[0]) {
+            try runBruteForce(allocator, lights);
+        }
+    }
+}
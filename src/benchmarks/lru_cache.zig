@@ -0,0 +1,56 @@
+const std = @import("std");
+
+const lru = @import("../core/lru_cache.zig");
+
+// Cost per operation should stay flat as the cache grows.
+// Each run does a mix of hits and misses, every miss evicts the least recently used entry.
+
+const op_count = 1 << 20;
+const cache_sizes = [_]u64{ 1_000, 10_000, 100_000 };
+
+fn onEvict(ctx: ?*anyopaque, key: lru.LRUKey, value: lru.LRUValue) void {
+    _ = key;
+    _ = value;
+    const evictions: *u64 = @ptrCast(@alignCast(ctx.?));
+    evictions.* += 1;
+}
+
+pub fn run(allocator: std.mem.Allocator) !void {
+    var dummy_value: u32 = 0;
+    for (cache_sizes) |cache_size| {
+        var evictions: u64 = 0;
+        var cache: lru.LRUCache = undefined;
+        cache.initWithOptions(allocator, .{
+            .max_entries = cache_size,
+            .on_evict = onEvict,
+            .on_evict_ctx = &evictions,
+        });
+        defer cache.deinit();
+
+        for (0..cache_size) |key| {
+            cache.put(key, &dummy_value);
+        }
+
+        // Keys drawn from twice the cache size so roughly half the lookups miss.
+        var rng = std.Random.DefaultPrng.init(1234);
+        const rand = rng.random();
+        var hits: u64 = 0;
+        var timer = try std.time.Timer.start();
+        for (0..op_count) |_| {
+            const key = rand.uintLessThan(u64, cache_size * 2);
+            if (cache.get(key) != null) {
+                hits += 1;
+            } else {
+                cache.put(key, &dummy_value);
+            }
+        }
+        const ns = timer.read();
+
+        std.debug.print("{d: >7} entries  {d: >6.1} ns/op  {d: >5.1}% hits  {} evictions\n", .{
+            cache_size,
+            @as(f64, @floatFromInt(ns)) / op_count,
+            @as(f64, @floatFromInt(hits)) * 100 / op_count,
+            evictions,
+        });
+    }
+}
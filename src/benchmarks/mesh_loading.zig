@@ -0,0 +1,363 @@
+const std = @import("std");
+const builtin = @import("builtin");
+
+const bench_util = @import("bench_util.zig");
+const geometry = @import("../renderer/geometry.zig");
+const JobSystem = @import("../core/job_system.zig").JobSystem;
+const mesh_format = @import("../renderer/mesh_format.zig");
+const MeshData = geometry.MeshData;
+
+// Loads every shipped TidesMesh rewritten as v1, as uncompressed v2 and as zstd compressed v2,
+// the v2 streams decoded on one thread and on workers. Meshes are picked up from content/
+// whatever version they are in. Without any, a set of rolling grids with meshlets stands in so
+// it runs on a fresh checkout. The compressed files keep a zstd stream only where it is smaller,
+// like the model converter. Cold numbers drop the page cache first, Linux only.
+
+const bench_dir = ".bench_tmp/mesh_loading";
+const content_dir = "content";
+const repeat_count = 10;
+
+const synthetic_file_count = 16;
+const synthetic_grid_sizes = [_]u32{ 255, 127, 63 }; // One file's sub-meshes, 64k vertices at most
+const meshlet_max_vertices = 64;
+const meshlet_max_triangles = 124;
+const zstd_level = 19; // The model converter's MESH_ZSTD_LEVEL
+
+// Linked from the model converter's zstd sources, see build.zig.
+extern fn ZSTD_compressBound(src_size: usize) usize;
+extern fn ZSTD_compress(dst: [*]u8, dst_capacity: usize, src: [*]const u8, src_size: usize, compression_level: c_int) usize;
+extern fn ZSTD_isError(code: usize) c_uint;
+
+fn dropFromPageCache(path: []const u8) void {
+    if (builtin.os.tag != .linux) {
+        return;
+    }
+    const file = std.fs.cwd().openFile(path, .{}) catch return;
+    defer file.close();
+    const POSIX_FADV_DONTNEED = 4;
+    _ = std.os.linux.fadvise(file.handle, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+fn findShippedMeshes(allocator: std.mem.Allocator, files: *std.ArrayList(std.ArrayList(MeshData))) !void {
+    var dir = std.fs.cwd().openDir(content_dir, .{ .iterate = true }) catch return;
+    defer dir.close();
+    var walker = try dir.walk(allocator);
+    defer walker.deinit();
+
+    var path_buf: [std.fs.max_path_bytes]u8 = undefined;
+    while (try walker.next()) |entry| {
+        if (entry.kind != .file or !std.mem.endsWith(u8, entry.basename, ".mesh")) {
+            continue;
+        }
+        var meshes = std.ArrayList(MeshData).init(allocator);
+        var load_desc = geometry.MeshLoadDesc{
+            .mesh_path = try std.fmt.bufPrint(&path_buf, content_dir ++ "/{s}", .{entry.path}),
+            .allocator = allocator,
+            .mesh_data = &meshes,
+        };
+        geometry.loadMesh(&load_desc);
+        try files.append(meshes);
+    }
+}
+
+fn normalize(vector: [3]f32) [3]f32 {
+    const length = @sqrt(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+    return .{ vector[0] / length, vector[1] / length, vector[2] / length };
+}
+
+fn finishMeshlet(mesh: *MeshData, meshlet: geometry.Meshlet) void {
+    var positions: [meshlet_max_vertices][3]f32 = undefined;
+    for (mesh.meshlet_vertices.items[meshlet.vertex_offset..][0..meshlet.vertex_count], 0..) |vertex, i| {
+        positions[i] = mesh.positions_stream.items[vertex];
+    }
+    const bounds = geometry.computeBounds(positions[0..meshlet.vertex_count]);
+    mesh.meshlets.append(meshlet) catch unreachable;
+    mesh.meshlet_bounds.append(.{ .local_center = bounds.center, .local_extents = bounds.extents }) catch unreachable;
+}
+
+fn newVertexCount(mesh: *const MeshData, meshlet: geometry.Meshlet, corners: []const u32) u32 {
+    var count: u32 = 0;
+    for (corners) |corner| {
+        count += @intFromBool(std.mem.indexOfScalar(u32, mesh.meshlet_vertices.items[meshlet.vertex_offset..], corner) == null);
+    }
+    return count;
+}
+
+fn localIndex(mesh: *MeshData, meshlet: *geometry.Meshlet, vertex: u32) u10 {
+    const vertices = mesh.meshlet_vertices.items[meshlet.vertex_offset..];
+    if (std.mem.indexOfScalar(u32, vertices, vertex)) |i| {
+        return @intCast(i);
+    }
+    mesh.meshlet_vertices.append(vertex) catch unreachable;
+    meshlet.vertex_count += 1;
+    return @intCast(vertices.len);
+}
+
+// Greedy, in index order. Good enough to give the streams their real sizes.
+fn buildMeshlets(mesh: *MeshData) void {
+    var meshlet = std.mem.zeroes(geometry.Meshlet);
+    for (0..mesh.indices.items.len / 3) |triangle| {
+        const corners = mesh.indices.items[triangle * 3 ..][0..3];
+        if (meshlet.triangle_count == meshlet_max_triangles or meshlet.vertex_count + newVertexCount(mesh, meshlet, corners) > meshlet_max_vertices) {
+            finishMeshlet(mesh, meshlet);
+            meshlet = .{
+                .vertex_offset = @intCast(mesh.meshlet_vertices.items.len),
+                .triangle_offset = @intCast(mesh.meshlet_triangles.items.len),
+                .vertex_count = 0,
+                .triangle_count = 0,
+            };
+        }
+
+        const v0 = localIndex(mesh, &meshlet, corners[0]);
+        const v1 = localIndex(mesh, &meshlet, corners[1]);
+        const v2 = localIndex(mesh, &meshlet, corners[2]);
+        mesh.meshlet_triangles.append(.{ .v0 = v0, .v1 = v1, .v2 = v2, ._padding = 0 }) catch unreachable;
+        meshlet.triangle_count += 1;
+    }
+    if (meshlet.triangle_count > 0) {
+        finishMeshlet(mesh, meshlet);
+    }
+}
+
+// A rolling 10 m patch, the normals and tangents follow the slopes.
+fn syntheticMesh(allocator: std.mem.Allocator, grid_size: u32, phase: f32) MeshData {
+    var mesh = MeshData{
+        .positions_stream = std.ArrayList([3]f32).init(allocator),
+        .texcoords_stream = std.ArrayList([2]f32).init(allocator),
+        .normals_stream = std.ArrayList([3]f32).init(allocator),
+        .tangents_stream = std.ArrayList([4]f32).init(allocator),
+        .indices = std.ArrayList(u32).init(allocator),
+        .bounds = undefined,
+        .meshlets = std.ArrayList(geometry.Meshlet).init(allocator),
+        .meshlet_vertices = std.ArrayList(u32).init(allocator),
+        .meshlet_triangles = std.ArrayList(geometry.MeshletTriangle).init(allocator),
+        .meshlet_bounds = std.ArrayList(geometry.MeshletBounds).init(allocator),
+    };
+
+    const vertex_side = grid_size + 1;
+    const cell_size = 10.0 / @as(f32, @floatFromInt(grid_size));
+    for (0..vertex_side) |z| {
+        for (0..vertex_side) |x| {
+            const position_x = @as(f32, @floatFromInt(x)) * cell_size - 5;
+            const position_z = @as(f32, @floatFromInt(z)) * cell_size - 5;
+            const height = 0.5 * @sin(position_x * 1.3 + phase) * @cos(position_z * 0.7 - phase);
+            const slope_x = 0.65 * @cos(position_x * 1.3 + phase) * @cos(position_z * 0.7 - phase);
+            const slope_z = -0.35 * @sin(position_x * 1.3 + phase) * @sin(position_z * 0.7 - phase);
+            const tangent = normalize(.{ 1, slope_x, 0 });
+
+            mesh.positions_stream.append(.{ position_x, height, position_z }) catch unreachable;
+            mesh.texcoords_stream.append(.{ @as(f32, @floatFromInt(x)) / @as(f32, @floatFromInt(grid_size)), @as(f32, @floatFromInt(z)) / @as(f32, @floatFromInt(grid_size)) }) catch unreachable;
+            mesh.normals_stream.append(normalize(.{ -slope_x, 1, -slope_z })) catch unreachable;
+            mesh.tangents_stream.append(.{ tangent[0], tangent[1], tangent[2], 1 }) catch unreachable;
+        }
+    }
+
+    for (0..grid_size) |z| {
+        for (0..grid_size) |x| {
+            const corner: u32 = @intCast(z * vertex_side + x);
+            mesh.indices.appendSlice(&.{ corner, corner + vertex_side, corner + 1, corner + 1, corner + vertex_side, corner + vertex_side + 1 }) catch unreachable;
+        }
+    }
+
+    buildMeshlets(&mesh);
+    mesh.bounds = geometry.computeBounds(mesh.positions_stream.items);
+    return mesh;
+}
+
+fn writeVersion1(path: []const u8, meshes: []const MeshData) !void {
+    const file = try std.fs.cwd().createFile(path, .{});
+    defer file.close();
+    var buffered_writer = std.io.bufferedWriter(file.writer());
+    const writer = buffered_writer.writer();
+
+    try writer.writeAll("TidesMesh");
+    try writer.writeInt(u64, meshes.len, .little);
+    for (meshes) |mesh| {
+        const streams = .{
+            mesh.indices.items,
+            mesh.positions_stream.items,
+            mesh.texcoords_stream.items,
+            mesh.normals_stream.items,
+            mesh.tangents_stream.items,
+            mesh.meshlets.items,
+            mesh.meshlet_bounds.items,
+            mesh.meshlet_triangles.items,
+            mesh.meshlet_vertices.items,
+        };
+        inline for (streams) |items| {
+            try writer.writeInt(u64, items.len, .little);
+        }
+        inline for (streams) |items| {
+            try writer.writeAll(std.mem.sliceAsBytes(items));
+        }
+    }
+    try buffered_writer.flush();
+}
+
+// Re-lays out an uncompressed v2 file with its streams zstd compressed where that is smaller.
+fn compressStreams(allocator: std.mem.Allocator, file: []const u8, output: *std.ArrayList(u8)) !void {
+    const file_header = std.mem.bytesToValue(mesh_format.FileHeader, file[0..@sizeOf(mesh_format.FileHeader)]);
+    output.clearRetainingCapacity();
+    try output.appendSlice(file[0..file_header.data_offset]);
+
+    var compressed = std.ArrayList(u8).init(allocator);
+    defer compressed.deinit();
+    for (0..file_header.mesh_count) |mesh_index| {
+        const header_offset = @sizeOf(mesh_format.FileHeader) + mesh_index * @sizeOf(mesh_format.MeshHeader);
+        var header = std.mem.bytesToValue(mesh_format.MeshHeader, output.items[header_offset..][0..@sizeOf(mesh_format.MeshHeader)]);
+        for (&header.streams) |*desc| {
+            const stream = file[desc.offset..][0..desc.size];
+            try output.appendNTimes(0, std.mem.alignForward(usize, output.items.len, mesh_format.stream_alignment) - output.items.len);
+            desc.offset = output.items.len;
+            if (stream.len > 0) {
+                try compressed.resize(ZSTD_compressBound(stream.len));
+                const compressed_size = ZSTD_compress(compressed.items.ptr, compressed.items.len, stream.ptr, stream.len, zstd_level);
+                if (ZSTD_isError(compressed_size) == 0 and compressed_size < stream.len) {
+                    try output.appendSlice(compressed.items[0..compressed_size]);
+                    desc.size = @intCast(compressed_size);
+                    desc.codec = .zstd;
+                    continue;
+                }
+            }
+            try output.appendSlice(stream);
+        }
+        @memcpy(output.items[header_offset..][0..@sizeOf(mesh_format.MeshHeader)], std.mem.asBytes(&header));
+    }
+}
+
+fn runLoads(allocator: std.mem.Allocator, name: []const u8, paths: []const []const u8, workers: ?*std.Thread.Pool, cold: bool) !void {
+    var frame_times = bench_util.FrameTimes{};
+    var meshes = std.ArrayList(MeshData).init(allocator);
+    defer meshes.deinit();
+
+    for (0..repeat_count) |_| {
+        if (cold) {
+            for (paths) |path| {
+                dropFromPageCache(path);
+            }
+        }
+
+        var timer = try std.time.Timer.start();
+        for (paths) |path| {
+            var load_desc = geometry.MeshLoadDesc{ .mesh_path = path, .allocator = allocator, .mesh_data = &meshes, .workers = workers };
+            geometry.loadMesh(&load_desc);
+        }
+        frame_times.add(timer.read());
+
+        for (meshes.items) |*mesh| {
+            mesh.deinit();
+        }
+        meshes.clearRetainingCapacity();
+    }
+
+    std.debug.print("{s: <20} {s: <5} avg {d: >8.3} ms  worst {d: >8.3} ms\n", .{
+        name,
+        if (cold) "cold" else "warm",
+        frame_times.averageMs(),
+        frame_times.worstMs(),
+    });
+}
+
+fn fileSize(path: []const u8) !u64 {
+    const file = try std.fs.cwd().openFile(path, .{});
+    defer file.close();
+    return file.getEndPos();
+}
+
+pub fn run(allocator: std.mem.Allocator) !void {
+    var sources = std.ArrayList(std.ArrayList(MeshData)).init(allocator);
+    defer {
+        for (sources.items) |*meshes| {
+            for (meshes.items) |*mesh| {
+                mesh.deinit();
+            }
+            meshes.deinit();
+        }
+        sources.deinit();
+    }
+
+    try findShippedMeshes(allocator, &sources);
+    const shipped = sources.items.len > 0;
+    if (!shipped) {
+        for (0..synthetic_file_count) |i| {
+            var meshes = std.ArrayList(MeshData).init(allocator);
+            for (synthetic_grid_sizes) |grid_size| {
+                try meshes.append(syntheticMesh(allocator, grid_size, @floatFromInt(i)));
+            }
+            try sources.append(meshes);
+        }
+    }
+
+    try std.fs.cwd().makePath(bench_dir);
+    defer std.fs.cwd().deleteTree(".bench_tmp") catch {};
+
+    var v1_paths = std.ArrayList([]const u8).init(allocator);
+    var v2_paths = std.ArrayList([]const u8).init(allocator);
+    var v2_zstd_paths = std.ArrayList([]const u8).init(allocator);
+    defer {
+        for ([_]*std.ArrayList([]const u8){ &v1_paths, &v2_paths, &v2_zstd_paths }) |paths| {
+            for (paths.items) |path| {
+                allocator.free(path);
+            }
+            paths.deinit();
+        }
+    }
+
+    var encoded = std.ArrayList(u8).init(allocator);
+    defer encoded.deinit();
+    var compressed = std.ArrayList(u8).init(allocator);
+    defer compressed.deinit();
+    var vertex_count: usize = 0;
+    var v1_bytes: u64 = 0;
+    var v2_bytes: u64 = 0;
+    var v2_zstd_bytes: u64 = 0;
+    for (sources.items, 0..) |meshes, i| {
+        const v1_path = try std.fmt.allocPrint(allocator, bench_dir ++ "/{}.v1.mesh", .{i});
+        try v1_paths.append(v1_path);
+        try writeVersion1(v1_path, meshes.items);
+        v1_bytes += try fileSize(v1_path);
+
+        const v2_path = try std.fmt.allocPrint(allocator, bench_dir ++ "/{}.v2.mesh", .{i});
+        try v2_paths.append(v2_path);
+        mesh_format.encode(allocator, meshes.items, &encoded);
+        try std.fs.cwd().writeFile(.{ .sub_path = v2_path, .data = encoded.items });
+        v2_bytes += encoded.items.len;
+
+        const v2_zstd_path = try std.fmt.allocPrint(allocator, bench_dir ++ "/{}.v2.zstd.mesh", .{i});
+        try v2_zstd_paths.append(v2_zstd_path);
+        try compressStreams(allocator, encoded.items, &compressed);
+        try std.fs.cwd().writeFile(.{ .sub_path = v2_zstd_path, .data = compressed.items });
+        v2_zstd_bytes += compressed.items.len;
+
+        for (meshes.items) |mesh| {
+            vertex_count += mesh.positions_stream.items.len;
+        }
+    }
+
+    std.debug.print("{} {s} files, {} vertices, v1 {d:.1} MB, v2 {d:.1} MB, v2 zstd {d:.1} MB\n", .{
+        sources.items.len,
+        if (shipped) "shipped" else "synthetic",
+        vertex_count,
+        @as(f64, @floatFromInt(v1_bytes)) / (1024 * 1024),
+        @as(f64, @floatFromInt(v2_bytes)) / (1024 * 1024),
+        @as(f64, @floatFromInt(v2_zstd_bytes)) / (1024 * 1024),
+    });
+
+    // Sized like the game's frame pool, which the renderer decodes on.
+    const worker_count = JobSystem.workerCounts(@intCast(std.Thread.getCpuCount() catch 4)).frame;
+    var workers: std.Thread.Pool = undefined;
+    try workers.init(.{ .allocator = allocator, .n_jobs = worker_count });
+    defer workers.deinit();
+    var name_buf: [32]u8 = undefined;
+    const workers_name = try std.fmt.bufPrint(&name_buf, "v2, {} threads", .{worker_count + 1});
+    var zstd_name_buf: [32]u8 = undefined;
+    const zstd_workers_name = try std.fmt.bufPrint(&zstd_name_buf, "v2 zstd, {} threads", .{worker_count + 1});
+
+    for ([_]bool{ false, true }) |cold| {
+        try runLoads(allocator, "v1", v1_paths.items, null, cold);
+        try runLoads(allocator, "v2, 1 thread", v2_paths.items, null, cold);
+        try runLoads(allocator, workers_name, v2_paths.items, &workers, cold);
+        try runLoads(allocator, "v2 zstd, 1 thread", v2_zstd_paths.items, null, cold);
+        try runLoads(allocator, zstd_workers_name, v2_zstd_paths.items, &workers, cold);
+    }
+}
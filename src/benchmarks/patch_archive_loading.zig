@@ -0,0 +1,134 @@
+const std = @import("std");
+const builtin = @import("builtin");
+
+const AssetManager = @import("../core/asset_manager.zig").AssetManager;
+const IdLocal = @import("../core/core.zig").IdLocal;
+const patch_archive = @import("../worldpatch/patch_archive.zig");
+
+// Loose heightmap files through AssetManager vs one memory mapped archive.
+// Writes a synthetic LoD0 sized set of patches (same payload size as the simulator output)
+// so it runs without generated content. Cold numbers drop the page cache first, Linux only.
+
+const bench_dir = ".bench_tmp/patch_archive";
+const patches_per_side = 64;
+const patch_bytes = 16 + 4 * 65 * @sizeOf(u32) + 63 * 63 * @sizeOf(u16); // header + edges + 16 bit insides
+
+fn loosePath(buf: []u8, patch_x: usize, patch_z: usize) []const u8 {
+    return std.fmt.bufPrint(buf, bench_dir ++ "/heightmap_x{}_z{}.heightmap", .{ patch_x, patch_z }) catch unreachable;
+}
+
+fn dropFromPageCache(path: []const u8) void {
+    if (builtin.os.tag != .linux) {
+        return;
+    }
+    const file = std.fs.cwd().openFile(path, .{}) catch return;
+    defer file.close();
+    const POSIX_FADV_DONTNEED = 4;
+    _ = std.os.linux.fadvise(file.handle, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+fn writeContent(allocator: std.mem.Allocator) !void {
+    try std.fs.cwd().makePath(bench_dir);
+
+    var archive_writer = patch_archive.PatchArchiveWriter.create(allocator);
+    defer archive_writer.destroy();
+
+    var rng = std.Random.DefaultPrng.init(1234);
+    var payload: [patch_bytes]u8 = undefined;
+    var path_buf: [256]u8 = undefined;
+    for (0..patches_per_side) |patch_z| {
+        for (0..patches_per_side) |patch_x| {
+            rng.random().bytes(&payload);
+            try std.fs.cwd().writeFile(.{ .sub_path = loosePath(&path_buf, patch_x, patch_z), .data = &payload });
+            archive_writer.addPatch(@intCast(patch_x), @intCast(patch_z), &payload);
+        }
+    }
+
+    try archive_writer.write(bench_dir ++ "/heightmap.patchpack");
+}
+
+fn checksum(bytes: []const u8) u64 {
+    var sum: u64 = 0;
+    for (bytes) |byte| {
+        sum +%= byte;
+    }
+    return sum;
+}
+
+fn loadLoose(allocator: std.mem.Allocator, cold: bool) !u64 {
+    var path_buf: [256]u8 = undefined;
+    if (cold) {
+        for (0..patches_per_side) |patch_z| {
+            for (0..patches_per_side) |patch_x| {
+                dropFromPageCache(loosePath(&path_buf, patch_x, patch_z));
+            }
+        }
+    }
+
+    // Fresh manager so its cache doesn't hide the file reads.
+    var asset_mgr = AssetManager.create(allocator);
+    defer asset_mgr.destroy();
+
+    var sum: u64 = 0;
+    for (0..patches_per_side) |patch_z| {
+        for (0..patches_per_side) |patch_x| {
+            const asset_id = IdLocal.init(loosePath(&path_buf, patch_x, patch_z));
+            const data = asset_mgr.loadAssetBlocking(asset_id, .instant_blocking);
+            sum +%= checksum(data);
+            asset_mgr.releaseAsset(asset_id);
+        }
+    }
+    return sum;
+}
+
+fn loadArchive(cold: bool) !u64 {
+    const archive_path = bench_dir ++ "/heightmap.patchpack";
+    if (cold) {
+        dropFromPageCache(archive_path);
+    }
+
+    var archive = patch_archive.PatchArchive.open(archive_path) orelse return error.ArchiveMissing;
+    defer archive.close();
+
+    var sum: u64 = 0;
+    for (0..patches_per_side) |patch_z| {
+        for (0..patches_per_side) |patch_x| {
+            sum +%= checksum(archive.find(@intCast(patch_x), @intCast(patch_z)).?);
+        }
+    }
+    return sum;
+}
+
+fn report(name: []const u8, ns: u64) void {
+    const patch_count = patches_per_side * patches_per_side;
+    const ms = @as(f64, @floatFromInt(ns)) / std.time.ns_per_ms;
+    std.debug.print("{s: <16} {d: >9.2} ms  {d: >7.2} us/patch\n", .{
+        name,
+        ms,
+        ms * 1000 / @as(f64, @floatFromInt(patch_count)),
+    });
+}
+
+pub fn run(allocator: std.mem.Allocator) !void {
+    try writeContent(allocator);
+    defer std.fs.cwd().deleteTree(".bench_tmp") catch {};
+
+    var timer = try std.time.Timer.start();
+    inline for (.{ true, false }) |cold| {
+        const suffix = if (cold) "cold" else "warm";
+
+        timer.reset();
+        const sum_loose = try loadLoose(allocator, cold);
+        report("loose " ++ suffix, timer.read());
+
+        timer.reset();
+        const sum_archive = try loadArchive(cold);
+        report("archive " ++ suffix, timer.read());
+
+        std.debug.assert(sum_loose == sum_archive);
+    }
+
+    if (builtin.os.tag != .linux) {
+        std.debug.print("NOTE: page cache isn't dropped on this platform, cold == warm\n", .{});
+    }
+}
@@ -0,0 +1,171 @@
+const std = @import("std");
+const zphy = @import("zphysics");
+
+const bench_util = @import("bench_util.zig");
+const config = @import("../config/config.zig");
+const patch_types = @import("../worldpatch/patch_types.zig");
+const physics_manager = @import("../managers/physics_manager.zig");
+const world_patch_manager = @import("../worldpatch/world_patch_manager.zig");
+const physics_heightfield_builder = @import("../systems/physics_heightfield_builder.zig");
+const HeightfieldShapeBuilder = physics_heightfield_builder.HeightfieldShapeBuilder;
+const BroadPhaseOptimizePolicy = physics_heightfield_builder.BroadPhaseOptimizePolicy;
+
+// Streams a block of LoD0 heightmap patches into a physics world the way physics_system does
+// when the player arrives somewhere, a few patches becoming available every frame.
+// Compares building the shapes on the main thread and optimizing the broadphase after every
+// body (the old way) against building them on workers, adding finished bodies in batches and
+// optimizing once streaming settles. Reports main thread cost per frame and how many frames
+// it took until every patch had collision.
+
+const grid_side = 16;
+const patch_count = grid_side * grid_side;
+const arrivals_per_frame = 8;
+
+fn lookupAt(first_patch: u16, index: usize) world_patch_manager.PatchLookup {
+    return .{
+        .patch_x = @intCast(first_patch + index % grid_side),
+        .patch_z = @intCast(first_patch + index / grid_side),
+        .lod = 0,
+        .patch_type_id = 0,
+    };
+}
+
+fn checkCollision(physics_world: *zphy.PhysicsSystem, first_patch: u16) void {
+    // A ray down the middle of the block has to hit the terrain.
+    const center: f32 = @floatFromInt((@as(u32, first_patch) + grid_side / 2) * config.patch_size);
+    const query = physics_world.getNarrowPhaseQuery();
+    const result = query.castRay(.{
+        .origin = .{ center + 0.5, 1000, center + 0.5, 0 },
+        .direction = .{ 0, -2000, 0, 0 },
+    }, .{});
+    std.debug.assert(result.has_hit);
+}
+
+fn releaseAll(physics_world: *zphy.PhysicsSystem, body_ids: []const zphy.BodyId, shapes: []const *zphy.Shape) void {
+    const body_interface = physics_world.getBodyInterfaceMut();
+    for (body_ids) |body_id| {
+        body_interface.removeAndDestroyBody(body_id);
+    }
+    for (shapes) |shape| {
+        shape.release();
+    }
+}
+
+fn runMainThread(heightmaps: []const patch_types.Heightmap, first_patch: u16) !void {
+    var arena_state = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer arena_state.deinit();
+    var physics_mgr = physics_manager.create(arena_state.allocator(), std.heap.c_allocator);
+    defer physics_manager.destroy(&physics_mgr);
+    const physics_world = physics_mgr.physics_world;
+    const body_interface = physics_world.getBodyInterfaceMut();
+
+    var body_ids: [patch_count]zphy.BodyId = undefined;
+    var shapes: [patch_count]*zphy.Shape = undefined;
+    var frame_times = bench_util.FrameTimes{};
+    var added: usize = 0;
+    while (added < patch_count) {
+        var timer = try std.time.Timer.start();
+        const arrived = @min(added + arrivals_per_frame, patch_count);
+        while (added < arrived) : (added += 1) {
+            const lookup = lookupAt(first_patch, added);
+            const world_pos = lookup.getWorldPos();
+            var shape_settings = try zphy.HeightFieldShapeSettings.create(&heightmaps[added].heightmap, config.patch_resolution);
+            defer shape_settings.release();
+            const shape = try shape_settings.createShape();
+            body_ids[added] = try body_interface.createAndAddBody(.{
+                .position = .{ @as(f32, @floatFromInt(world_pos.world_x)), 0, @as(f32, @floatFromInt(world_pos.world_z)), 1.0 },
+                .rotation = .{ 0.0, 0.0, 0.0, 1.0 },
+                .shape = shape,
+                .motion_type = .static,
+                .object_layer = config.physics.object_layers.non_moving,
+                .user_data = 0,
+            }, .activate);
+            shapes[added] = shape;
+            physics_world.optimizeBroadPhase();
+        }
+        frame_times.add(timer.read());
+    }
+
+    checkCollision(physics_world, first_patch);
+    report("main thread", frame_times, patch_count);
+    releaseAll(physics_world, &body_ids, &shapes);
+}
+
+fn runStreamed(allocator: std.mem.Allocator, heightmaps: []const patch_types.Heightmap, first_patch: u16, worker_count: u32) !void {
+    var arena_state = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer arena_state.deinit();
+    var physics_mgr = physics_manager.create(arena_state.allocator(), std.heap.c_allocator);
+    defer physics_manager.destroy(&physics_mgr);
+    const physics_world = physics_mgr.physics_world;
+
+    var workers: std.Thread.Pool = undefined;
+    try workers.init(.{ .allocator = allocator, .n_jobs = worker_count });
+    defer workers.deinit();
+    const shape_builder = HeightfieldShapeBuilder.create(allocator, &workers);
+    defer shape_builder.destroy();
+    var broad_phase_policy = BroadPhaseOptimizePolicy{ .max_bodies_between_optimizes = 16 };
+
+    var body_ids: [patch_count]zphy.BodyId = undefined;
+    var shapes: [patch_count]*zphy.Shape = undefined;
+    var frame_times = bench_util.FrameTimes{};
+    var arrived: usize = 0;
+    var enqueued: usize = 0;
+    var added: usize = 0;
+    while (added < patch_count or broad_phase_policy.bodies_since_optimize > 0) {
+        var timer = try std.time.Timer.start();
+        arrived = @min(arrived + arrivals_per_frame, patch_count);
+
+        var finished: [HeightfieldShapeBuilder.max_shapes_in_flight]physics_heightfield_builder.ShapeBuildResult = undefined;
+        var finished_count: u32 = 0;
+        while (shape_builder.popResult()) |result| {
+            finished[finished_count] = result;
+            finished_count += 1;
+        }
+        physics_heightfield_builder.addBodies(physics_world, finished[0..finished_count], body_ids[added..]);
+        for (finished[0..finished_count], shapes[added .. added + finished_count]) |result, *shape| {
+            shape.* = result.shape;
+        }
+        added += finished_count;
+        broad_phase_policy.onBodiesAdded(finished_count);
+
+        while (enqueued < arrived and !shape_builder.isFull()) : (enqueued += 1) {
+            const enqueued_ok = shape_builder.enqueue(lookupAt(first_patch, enqueued), &heightmaps[enqueued], 1);
+            std.debug.assert(enqueued_ok);
+        }
+
+        broad_phase_policy.update(physics_world, enqueued < patch_count or shape_builder.shapes_in_flight > 0);
+        frame_times.add(timer.read());
+        // Leave the workers some time, like a frame would.
+        std.Thread.sleep(std.time.ns_per_ms);
+    }
+
+    checkCollision(physics_world, first_patch);
+    var name_buf: [64]u8 = undefined;
+    const name = try std.fmt.bufPrint(&name_buf, "{} workers, {} optimizes", .{ worker_count, broad_phase_policy.optimizes_total });
+    report(name, frame_times, patch_count);
+    releaseAll(physics_world, &body_ids, &shapes);
+}
+
+fn report(name: []const u8, frame_times: bench_util.FrameTimes, patches: usize) void {
+    std.debug.print("{s: <28} avg {d: >7.3} ms  worst {d: >7.3} ms  {} frames for {} patches\n", .{
+        name,
+        frame_times.averageMs(),
+        frame_times.worstMs(),
+        frame_times.count,
+        patches,
+    });
+}
+
+pub fn run(allocator: std.mem.Allocator) !void {
+    const first_patch: u16 = config.world_size_x / config.patch_size / 2 - grid_side / 2;
+    const heightmaps = try allocator.alloc(patch_types.Heightmap, patch_count);
+    defer allocator.free(heightmaps);
+    // NOTE: WorldPatchManager doesn't free its bookkeeping on destroy, so keep it off the leak-checking allocator.
+    const shipped_count = try bench_util.loadHeightmapGrid(std.heap.page_allocator, first_patch, first_patch, grid_side, 0, heightmaps);
+    std.debug.print("{} of {} heightmaps from content, the rest synthetic\n", .{ shipped_count, heightmaps.len });
+
+    try runMainThread(heightmaps, first_patch);
+    const cpu_count = std.Thread.getCpuCount() catch 4;
+    try runStreamed(allocator, heightmaps, first_patch, 1);
+    try runStreamed(allocator, heightmaps, first_patch, @intCast(std.math.clamp(cpu_count, 3, 6) - 2));
+}
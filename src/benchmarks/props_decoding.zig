@@ -0,0 +1,88 @@
+const std = @import("std");
+
+const IdLocal = @import("../core/core.zig").IdLocal;
+const props_format = @import("../worldpatch/props_format.zig");
+
+// CSV vs binary (raw and quantized) props patch decoding: props per second, bytes on disk
+// and resident bytes per prop. Uses a synthetic, forest-like patch.
+
+const props_per_patch = 4096;
+const iterations = 64;
+
+// What propsLoad used to keep per prop.
+const LegacyProp = struct {
+    id: IdLocal,
+    pos: [3]f32,
+    rot: f32,
+};
+
+fn report(name: []const u8, ns: u64, file_bytes: usize, resident_bytes: usize) void {
+    const prop_count: f64 = props_per_patch * iterations;
+    const seconds = @as(f64, @floatFromInt(ns)) / std.time.ns_per_s;
+    std.debug.print("{s: <16} {d: >12.0} props/s  {d: >6.2} file bytes/prop  {d: >6.2} resident bytes/prop\n", .{
+        name,
+        prop_count / seconds,
+        @as(f64, @floatFromInt(file_bytes)) / props_per_patch,
+        @as(f64, @floatFromInt(resident_bytes)) / props_per_patch,
+    });
+}
+
+pub fn run(allocator: std.mem.Allocator) !void {
+    var rng = std.Random.DefaultPrng.init(1234);
+    const rand = rng.random();
+
+    const type_names = [_][]const u8{ "tree", "tree", "tree", "tree", "city", "wall" };
+    const props = try allocator.alloc(props_format.PropInput, props_per_patch);
+    defer allocator.free(props);
+    for (props) |*prop| {
+        prop.* = .{
+            .type_name = type_names[rand.uintLessThan(usize, type_names.len)],
+            .pos = .{ 4096 + rand.float(f32) * 128, 100 + rand.float(f32) * 400, 8192 + rand.float(f32) * 128 },
+            .rot = rand.float(f32) * std.math.tau,
+            .scale = 0.15 + rand.float(f32) * 1.25,
+        };
+    }
+
+    var csv = std.ArrayList(u8).init(allocator);
+    defer csv.deinit();
+    for (props) |prop| {
+        try csv.writer().print("{s},{d:.3},{d:.3},{d:.3},{d:.3}\n", .{ prop.type_name, prop.pos[0], prop.pos[1], prop.pos[2], prop.rot });
+    }
+
+    var binary = std.ArrayList(u8).init(allocator);
+    defer binary.deinit();
+    try props_format.encode(props, false, binary.writer());
+
+    var quantized = std.ArrayList(u8).init(allocator);
+    defer quantized.deinit();
+    try props_format.encode(props, true, quantized.writer());
+
+    const resident_bytes = props_format.residentSize(props_per_patch, 3);
+    var timer = try std.time.Timer.start();
+
+    timer.reset();
+    for (0..iterations) |_| {
+        const decoded = props_format.decodeCsv(allocator, csv.items);
+        std.mem.doNotOptimizeAway(decoded.pos_x[props_per_patch - 1]);
+        props_format.freeProps(allocator, decoded);
+    }
+    report("csv", timer.read(), csv.items.len, resident_bytes);
+
+    timer.reset();
+    for (0..iterations) |_| {
+        const decoded = try props_format.decodeBinary(allocator, binary.items);
+        std.mem.doNotOptimizeAway(decoded.pos_x[props_per_patch - 1]);
+        props_format.freeProps(allocator, decoded);
+    }
+    report("binary f32", timer.read(), binary.items.len, resident_bytes);
+
+    timer.reset();
+    for (0..iterations) |_| {
+        const decoded = try props_format.decodeBinary(allocator, quantized.items);
+        std.mem.doNotOptimizeAway(decoded.pos_x[props_per_patch - 1]);
+        props_format.freeProps(allocator, decoded);
+    }
+    report("binary u16", timer.read(), quantized.items.len, resident_bytes);
+
+    std.debug.print("legacy resident: {} bytes/prop (IdLocal per prop)\n", .{@sizeOf(LegacyProp)});
+}
@@ -0,0 +1,147 @@
+const std = @import("std");
+
+const bench_util = @import("bench_util.zig");
+const SpatialHashGrid = @import("../core/spatial_hash_grid.zig").SpatialHashGrid;
+
+// The question settlementGrowth asks every frame: is any enemy within 15 km of this settlement.
+// Enemies roam in herds and move every frame. Compares scanning all enemies per settlement (the
+// old way, minus the ecs lookups) against keeping them in a SpatialHashGrid and querying it,
+// from 10 up to 10k of each. Also times a short range perception query per enemy, which is
+// the other thing the grid is for.
+
+const world_size = 16384 * 4;
+const enemy_radius = 15000;
+const perception_radius = 500;
+const frame_count = 60;
+const herd_size = 16;
+const cell_size = 256;
+
+const Position = struct {
+    x: f32,
+    z: f32,
+};
+
+fn scatter(rand: std.Random, positions: []Position, clustered: bool) void {
+    var herd_center = Position{ .x = 0, .z = 0 };
+    for (positions, 0..) |*position, i| {
+        if (!clustered or i % herd_size == 0) {
+            herd_center = .{ .x = rand.float(f32) * world_size, .z = rand.float(f32) * world_size };
+        }
+        const spread: f32 = if (clustered) 200 else 0;
+        position.* = .{
+            .x = herd_center.x + (rand.float(f32) - 0.5) * spread,
+            .z = herd_center.z + (rand.float(f32) - 0.5) * spread,
+        };
+    }
+}
+
+fn moveEnemies(rand: std.Random, enemies: []Position) void {
+    for (enemies) |*enemy| {
+        enemy.x = std.math.clamp(enemy.x + (rand.float(f32) - 0.5) * 20, 0, world_size);
+        enemy.z = std.math.clamp(enemy.z + (rand.float(f32) - 0.5) * 20, 0, world_size);
+    }
+}
+
+fn runLinear(settlements: []const Position, enemies: []Position, threatened_out: []bool) !bench_util.FrameTimes {
+    var rng = std.Random.DefaultPrng.init(42);
+    var frame_times = bench_util.FrameTimes{};
+    for (0..frame_count) |_| {
+        moveEnemies(rng.random(), enemies);
+        var timer = try std.time.Timer.start();
+        for (settlements, threatened_out) |settlement, *threatened| {
+            threatened.* = blk: {
+                for (enemies) |enemy| {
+                    const dx = enemy.x - settlement.x;
+                    const dz = enemy.z - settlement.z;
+                    if (dx * dx + dz * dz <= enemy_radius * enemy_radius) {
+                        break :blk true;
+                    }
+                }
+                break :blk false;
+            };
+        }
+        frame_times.add(timer.read());
+    }
+    return frame_times;
+}
+
+fn runGrid(allocator: std.mem.Allocator, settlements: []const Position, enemies: []Position, threatened_out: []bool) !bench_util.FrameTimes {
+    var grid = SpatialHashGrid(u32).create(allocator, cell_size);
+    defer grid.destroy();
+
+    var rng = std.Random.DefaultPrng.init(42);
+    var frame_times = bench_util.FrameTimes{};
+    for (0..frame_count) |_| {
+        moveEnemies(rng.random(), enemies);
+        var timer = try std.time.Timer.start();
+        // Timed together, the game pays for keeping the grid up to date every frame too.
+        for (enemies, 0..) |enemy, i| {
+            grid.insertOrUpdate(@intCast(i), enemy.x, enemy.z);
+        }
+        for (settlements, threatened_out) |settlement, *threatened| {
+            threatened.* = grid.anyWithinRadius(settlement.x, settlement.z, enemy_radius);
+        }
+        frame_times.add(timer.read());
+    }
+    return frame_times;
+}
+
+fn runPerception(allocator: std.mem.Allocator, enemies: []const Position) !bench_util.FrameTimes {
+    var grid = SpatialHashGrid(u32).create(allocator, cell_size);
+    defer grid.destroy();
+    for (enemies, 0..) |enemy, i| {
+        grid.insertOrUpdate(@intCast(i), enemy.x, enemy.z);
+    }
+
+    var neighbors = std.ArrayList(u32).init(allocator);
+    defer neighbors.deinit();
+    var nearest: [4]u32 = undefined;
+    var frame_times = bench_util.FrameTimes{};
+    var found_total: u64 = 0;
+    for (0..frame_count) |_| {
+        var timer = try std.time.Timer.start();
+        for (enemies) |enemy| {
+            neighbors.clearRetainingCapacity();
+            grid.queryRadius(enemy.x, enemy.z, perception_radius, &neighbors);
+            found_total += neighbors.items.len;
+            found_total += grid.queryNearest(enemy.x, enemy.z, perception_radius, &nearest);
+        }
+        frame_times.add(timer.read());
+    }
+    std.mem.doNotOptimizeAway(found_total);
+    return frame_times;
+}
+
+pub fn run(allocator: std.mem.Allocator) !void {
+    std.debug.print("{s: >6} {s: >18} {s: >18} {s: >18}\n", .{ "count", "linear scan ms", "grid ms", "perception ms" });
+    const counts = [_]u32{ 10, 100, 1_000, 10_000 };
+    for (counts) |count| {
+        var rng = std.Random.DefaultPrng.init(count);
+        const settlements = try allocator.alloc(Position, count);
+        defer allocator.free(settlements);
+        const enemies_linear = try allocator.alloc(Position, count);
+        defer allocator.free(enemies_linear);
+        const enemies_grid = try allocator.alloc(Position, count);
+        defer allocator.free(enemies_grid);
+        scatter(rng.random(), settlements, false);
+        scatter(rng.random(), enemies_linear, true);
+        @memcpy(enemies_grid, enemies_linear);
+
+        const threatened_linear = try allocator.alloc(bool, count);
+        defer allocator.free(threatened_linear);
+        const threatened_grid = try allocator.alloc(bool, count);
+        defer allocator.free(threatened_grid);
+
+        const linear_times = try runLinear(settlements, enemies_linear, threatened_linear);
+        const grid_times = try runGrid(allocator, settlements, enemies_grid, threatened_grid);
+        std.debug.assert(std.mem.eql(bool, threatened_linear, threatened_grid));
+        const perception_times = try runPerception(allocator, enemies_grid);
+
+        std.debug.print("{: >6} {d: >18.3} {d: >18.3} {d: >18.3}\n", .{
+            count,
+            linear_times.averageMs(),
+            grid_times.averageMs(),
+            perception_times.averageMs(),
+        });
+    }
+}
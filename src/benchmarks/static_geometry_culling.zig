@@ -0,0 +1,204 @@
+const std = @import("std");
+const zm = @import("zmath");
+
+const bench_util = @import("bench_util.zig");
+const geometry = @import("../renderer/geometry.zig");
+const static_geometry_culling = @import("../renderer/static_geometry_culling.zig");
+const StaticGeometryCuller = static_geometry_culling.StaticGeometryCuller;
+
+// A million static instances scattered over a 10 km square, culled from a camera standing in the
+// middle of it with the CPU version of the static geometry pass's culling. Every renderable has a
+// detailed LoD up close and a coarse one further out. Runs frustum culling on one thread and on
+// workers, then adds Hi-Z occlusion with a wall blocking the lower part of the view.
+
+const instance_count = static_geometry_culling.instances_max_count;
+const world_size = 10_000;
+const renderable_count = 64;
+const lod0_meshlet_count = 32;
+const lod1_meshlet_count = 4;
+const lod0_distance = 150;
+const lod1_distance = 2000;
+const material_count = 4;
+const bins_count = 2;
+const frame_count = 20;
+
+const near_plane = 0.1;
+const far_plane = 5000.0;
+const hi_z_width = 256;
+const hi_z_height = 144;
+const wall_distance = 100.0;
+
+const Scene = struct {
+    instances: []static_geometry_culling.GpuInstance,
+    renderable_items: []static_geometry_culling.GpuRenderableItem,
+    meshlet_bounds: []geometry.MeshletBounds,
+    meshes: []static_geometry_culling.CullingMesh,
+
+    fn create(allocator: std.mem.Allocator) !Scene {
+        var rng = std.Random.DefaultPrng.init(1234);
+        const rand = rng.random();
+
+        // Meshlets tile a 2x2x2 box, the coarse LoD has fewer of them.
+        const meshlet_bounds = try allocator.alloc(geometry.MeshletBounds, lod0_meshlet_count + lod1_meshlet_count);
+        for (meshlet_bounds[0..lod0_meshlet_count], 0..) |*bounds, i| {
+            const x: f32 = @floatFromInt(i % 4);
+            const z: f32 = @floatFromInt(i / 4 % 4);
+            const y: f32 = @floatFromInt(i / 16);
+            bounds.* = .{ .local_center = .{ -0.75 + x * 0.5, 0.5 + y, -0.75 + z * 0.5 }, .local_extents = .{ 0.25, 0.5, 0.25 } };
+        }
+        for (meshlet_bounds[lod0_meshlet_count..], 0..) |*bounds, i| {
+            const x: f32 = @floatFromInt(i % 2);
+            const z: f32 = @floatFromInt(i / 2);
+            bounds.* = .{ .local_center = .{ -0.5 + x, 1, -0.5 + z }, .local_extents = .{ 0.5, 1, 0.5 } };
+        }
+        const meshes = try allocator.alloc(static_geometry_culling.CullingMesh, 2);
+        meshes[0] = .{ .meshlet_bounds = meshlet_bounds[0..lod0_meshlet_count] };
+        meshes[1] = .{ .meshlet_bounds = meshlet_bounds[lod0_meshlet_count..] };
+
+        const renderable_items = try allocator.alloc(static_geometry_culling.GpuRenderableItem, renderable_count * 2);
+        for (0..renderable_count) |i| {
+            const material_index: u32 = @intCast(i % material_count);
+            for (0..2) |lod| {
+                renderable_items[i * 2 + lod] = .{
+                    .local_bounds_origin = .{ 0, 1, 0 },
+                    .screen_percentage_min = if (lod == 0) 0 else lod0_distance,
+                    .local_bounds_extents = .{ 1, 1, 1 },
+                    .screen_percentage_max = if (lod == 0) lod0_distance else lod1_distance,
+                    .mesh_index = @intCast(lod),
+                    .material_index = material_index,
+                    ._pad = .{ 0, 0 },
+                };
+            }
+        }
+
+        const instances = try allocator.alloc(static_geometry_culling.GpuInstance, instance_count);
+        for (instances) |*instance| {
+            const scale = 1 + rand.float(f32) * 4;
+            const world = zm.mul(
+                zm.mul(zm.scaling(scale, scale, scale), zm.rotationY(rand.float(f32) * std.math.tau)),
+                zm.translation(rand.float(f32) * world_size, 0, rand.float(f32) * world_size),
+            );
+            instance.* = std.mem.zeroes(static_geometry_culling.GpuInstance);
+            zm.storeMat(&instance.world, zm.transpose(world));
+            instance.bounds_origin = .{ 0, 1, 0 };
+            instance.bounds_extents = .{ 1, 1, 1 };
+            instance.renderable_item_id = rand.uintLessThan(u32, renderable_count) * 2;
+            instance.renderable_item_count = 2;
+        }
+
+        return .{
+            .instances = instances,
+            .renderable_items = renderable_items,
+            .meshlet_bounds = meshlet_bounds,
+            .meshes = meshes,
+        };
+    }
+
+    fn destroy(self: Scene, allocator: std.mem.Allocator) void {
+        allocator.free(self.instances);
+        allocator.free(self.renderable_items);
+        allocator.free(self.meshlet_bounds);
+        allocator.free(self.meshes);
+    }
+};
+
+// A wall wall_distance ahead covering the lower 60% of the screen, sky above it.
+fn createHiZ(allocator: std.mem.Allocator, projection: zm.Mat) ![]static_geometry_culling.HiZMip {
+    const wall = zm.mul(zm.f32x4(0, 0, wall_distance, 1), projection);
+    const wall_depth = wall[2] / wall[3];
+
+    var mips = std.ArrayList(static_geometry_culling.HiZMip).init(allocator);
+    const base = try allocator.alloc(f32, hi_z_width * hi_z_height);
+    for (base, 0..) |*depth, i| {
+        const row = i / hi_z_width;
+        depth.* = if (row >= hi_z_height * 4 / 10) wall_depth else 0;
+    }
+    try mips.append(.{ .width = hi_z_width, .height = hi_z_height, .depths = base });
+
+    while (mips.getLast().width > 1 or mips.getLast().height > 1) {
+        const parent = mips.getLast();
+        const width = @max(parent.width / 2, 1);
+        const height = @max(parent.height / 2, 1);
+        const depths = try allocator.alloc(f32, width * height);
+        for (0..height) |y| {
+            for (0..width) |x| {
+                var farthest: f32 = 1;
+                for (y * 2..@min(y * 2 + 2, parent.height)) |parent_y| {
+                    for (x * 2..@min(x * 2 + 2, parent.width)) |parent_x| {
+                        farthest = @min(farthest, parent.depths[parent_y * parent.width + parent_x]);
+                    }
+                }
+                depths[y * width + x] = farthest;
+            }
+        }
+        try mips.append(.{ .width = width, .height = height, .depths = depths });
+    }
+    return mips.toOwnedSlice();
+}
+
+fn runCulling(allocator: std.mem.Allocator, name: []const u8, worker_count: u32, scene: static_geometry_culling.CullingScene, view: static_geometry_culling.CullingView) !void {
+    var pool: std.Thread.Pool = undefined;
+    try pool.init(.{ .allocator = allocator, .n_jobs = @max(worker_count, 1) });
+    defer pool.deinit();
+    const culler = StaticGeometryCuller.create(allocator, if (worker_count > 0) &pool else null);
+    defer culler.destroy();
+
+    var frame_times = bench_util.FrameTimes{};
+    for (0..frame_count) |_| {
+        var timer = try std.time.Timer.start();
+        culler.cull(scene, view);
+        frame_times.add(timer.read());
+    }
+
+    std.debug.print("{s: <24} avg {d: >7.3} ms  worst {d: >7.3} ms  {} instances, {} of {} meshlets visible, {} boxes occluded\n", .{
+        name,
+        frame_times.averageMs(),
+        frame_times.worstMs(),
+        culler.instances_visible,
+        culler.visible_meshlets.items.len,
+        culler.candidate_meshlets_count,
+        culler.boxes_occluded,
+    });
+}
+
+pub fn run(allocator: std.mem.Allocator) !void {
+    const scene_data = try Scene.create(allocator);
+    defer scene_data.destroy(allocator);
+    const material_bins = [material_count]u32{ 0, 1, 0, 0 };
+    const scene = static_geometry_culling.CullingScene{
+        .instances = scene_data.instances,
+        .renderable_items = scene_data.renderable_items,
+        .meshes = scene_data.meshes,
+        .material_bins = &material_bins,
+        .bins_count = bins_count,
+    };
+
+    // Standing in the middle of the field looking down +z, reversed Z like the renderer.
+    const camera_position = [3]f32{ world_size / 2, 2, world_size / 2 };
+    const view_matrix = zm.lookToLh(zm.loadArr3w(camera_position, 1), zm.f32x4(0, 0, 1, 0), zm.f32x4(0, 1, 0, 0));
+    const projection = zm.perspectiveFovLh(1.0, 16.0 / 9.0, far_plane, near_plane);
+    var view = static_geometry_culling.CullingView{
+        .view_projection = undefined,
+        .camera_position = camera_position,
+    };
+    zm.storeMat(&view.view_projection, zm.mul(view_matrix, projection));
+
+    const cpu_count: u32 = @intCast(std.Thread.getCpuCount() catch 4);
+    try runCulling(allocator, "frustum, 1 thread", 0, scene, view);
+    try runCulling(allocator, "frustum, 4 threads", 3, scene, view);
+    var name_buf: [64]u8 = undefined;
+    const all_threads_name = try std.fmt.bufPrint(&name_buf, "frustum, {} threads", .{cpu_count});
+    try runCulling(allocator, all_threads_name, cpu_count - 1, scene, view);
+
+    // The wall moves with the camera, so the pyramid only depends on the projection.
+    const hi_z_mips = try createHiZ(allocator, projection);
+    defer {
+        for (hi_z_mips) |mip| {
+            allocator.free(mip.depths);
+        }
+        allocator.free(hi_z_mips);
+    }
+    view.hi_z_mips = hi_z_mips;
+    const hi_z_name = try std.fmt.bufPrint(&name_buf, "hi-z, {} threads", .{cpu_count});
+    try runCulling(allocator, hi_z_name, cpu_count - 1, scene, view);
+}
@@ -0,0 +1,187 @@
+const std = @import("std");
+
+const bench_util = @import("bench_util.zig");
+const TimerWheel = @import("../core/timer_wheel.zig").TimerWheel;
+
+// 100k looping creature tasks with SplitIfNearPlayer/SlimeDropTask like intervals.
+// Measures per frame dispatch cost (find due tasks + reschedule) for the timer wheel
+// against a binary heap, and the calculate phase serial vs batched over a thread pool.
+// TaskQueue itself pulls in the ECS and physics, so this drives its building blocks directly.
+
+const task_count = 100_000;
+const frame_count = 600;
+const frame_seconds = 1.0 / 60.0;
+const tick_seconds = 1.0 / 16.0;
+const calculate_batch_size = 64;
+
+const BenchTask = struct {
+    time: f64,
+    loop: f64,
+    pos: [3]f32,
+    result: f32 = 0,
+};
+
+fn initialTask(rand: std.Random) BenchTask {
+    // Mostly short SplitIfNearPlayer style loops, some long SlimeDropTask style ones.
+    const is_slow = rand.float(f32) < 0.1;
+    return .{
+        .time = 1 + rand.float(f64) * 3,
+        .loop = if (is_slow) 120 else 1 + rand.float(f64) * 1.5,
+        .pos = .{ rand.float(f32) * 1000, 0, rand.float(f32) * 1000 },
+    };
+}
+
+// Stand-in for a calculate step: distance to a "player".
+fn calculate(task: *BenchTask) void {
+    var sum: f32 = 0;
+    for (0..32) |i| {
+        const offset: f32 = @floatFromInt(i);
+        const dx = task.pos[0] - 500 + offset;
+        const dz = task.pos[2] - 500 - offset;
+        sum += @sqrt(dx * dx + dz * dz);
+    }
+    task.result = sum;
+}
+
+fn compareTime(_: void, lhs: u32, rhs: u32) std.math.Order {
+    return std.math.order(heap_tasks[lhs].time, heap_tasks[rhs].time);
+}
+var heap_tasks: []BenchTask = undefined;
+
+fn runWheel(allocator: std.mem.Allocator, tasks: []BenchTask) !void {
+    var wheel = TimerWheel(u32).init(allocator, tick_seconds);
+    defer wheel.deinit();
+    var due = std.ArrayListUnmanaged(u32){};
+    defer due.deinit(allocator);
+
+    for (tasks, 0..) |task, index| {
+        wheel.insert(task.time, @intCast(index));
+    }
+
+    var frame_times = bench_util.FrameTimes{};
+    var dispatched: usize = 0;
+    var time: f64 = 0;
+    for (0..frame_count) |_| {
+        time += frame_seconds;
+        var timer = try std.time.Timer.start();
+        due.clearRetainingCapacity();
+        wheel.advance(time, &due);
+        for (due.items) |index| {
+            tasks[index].time += tasks[index].loop;
+            wheel.insert(tasks[index].time, index);
+        }
+        frame_times.add(timer.read());
+        dispatched += due.items.len;
+    }
+    report("timer wheel", frame_times, dispatched);
+}
+
+fn runHeap(allocator: std.mem.Allocator, tasks: []BenchTask) !void {
+    heap_tasks = tasks;
+    var heap = std.PriorityQueue(u32, void, compareTime).init(allocator, {});
+    defer heap.deinit();
+    for (0..tasks.len) |index| {
+        try heap.add(@intCast(index));
+    }
+
+    var due = std.ArrayList(u32).init(allocator);
+    defer due.deinit();
+
+    var frame_times = bench_util.FrameTimes{};
+    var dispatched: usize = 0;
+    var time: f64 = 0;
+    for (0..frame_count) |_| {
+        time += frame_seconds;
+        var timer = try std.time.Timer.start();
+        due.clearRetainingCapacity();
+        while (heap.peek()) |index| {
+            if (tasks[index].time > time) {
+                break;
+            }
+            try due.append(heap.remove());
+        }
+        for (due.items) |index| {
+            tasks[index].time += tasks[index].loop;
+            try heap.add(index);
+        }
+        frame_times.add(timer.read());
+        dispatched += due.items.len;
+    }
+    report("binary heap", frame_times, dispatched);
+}
+
+const CalculateJob = struct {
+    tasks: []BenchTask,
+    next: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+
+    fn run(self: *CalculateJob) void {
+        while (true) {
+            const batch_start = self.next.fetchAdd(calculate_batch_size, .monotonic);
+            if (batch_start >= self.tasks.len) {
+                return;
+            }
+            for (self.tasks[batch_start..@min(batch_start + calculate_batch_size, self.tasks.len)]) |*task| {
+                calculate(task);
+            }
+        }
+    }
+};
+
+fn runCalculate(allocator: std.mem.Allocator, tasks: []BenchTask, worker_count: u32) !void {
+    var workers: std.Thread.Pool = undefined;
+    try workers.init(.{ .allocator = allocator, .n_jobs = @max(worker_count, 1) });
+    defer workers.deinit();
+
+    // Roughly one frame's worth of due tasks.
+    const due_per_frame = 2048;
+    var frame_times = bench_util.FrameTimes{};
+    for (0..frame_count) |frame_index| {
+        const start = (frame_index * due_per_frame) % (tasks.len - due_per_frame);
+        var job = CalculateJob{ .tasks = tasks[start .. start + due_per_frame] };
+        var timer = try std.time.Timer.start();
+        if (worker_count == 0) {
+            job.run();
+        } else {
+            var wait_group: std.Thread.WaitGroup = .{};
+            for (0..worker_count) |_| {
+                workers.spawnWg(&wait_group, CalculateJob.run, .{&job});
+            }
+            job.run();
+            workers.waitAndWork(&wait_group);
+        }
+        frame_times.add(timer.read());
+    }
+
+    var name_buf: [64]u8 = undefined;
+    const name = try std.fmt.bufPrint(&name_buf, "calculate, {} workers", .{worker_count});
+    report(name, frame_times, due_per_frame * frame_count);
+}
+
+fn report(name: []const u8, frame_times: bench_util.FrameTimes, dispatched: usize) void {
+    std.debug.print("{s: <24} avg {d: >7.3} ms  worst {d: >7.3} ms  ({} tasks)\n", .{
+        name,
+        frame_times.averageMs(),
+        frame_times.worstMs(),
+        dispatched,
+    });
+}
+
+pub fn run(allocator: std.mem.Allocator) !void {
+    const tasks = try allocator.alloc(BenchTask, task_count);
+    defer allocator.free(tasks);
+
+    var rng = std.Random.DefaultPrng.init(1234);
+    for (tasks) |*task| {
+        task.* = initialTask(rng.random());
+    }
+    const initial_tasks = try allocator.dupe(BenchTask, tasks);
+    defer allocator.free(initial_tasks);
+
+    try runWheel(allocator, tasks);
+    @memcpy(tasks, initial_tasks);
+    try runHeap(allocator, tasks);
+
+    const cpu_count = std.Thread.getCpuCount() catch 4;
+    try runCalculate(allocator, tasks, 0);
+    try runCalculate(allocator, tasks, @intCast(std.math.clamp(cpu_count, 3, 6) - 2));
+}
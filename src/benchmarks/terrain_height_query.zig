@@ -0,0 +1,173 @@
+const std = @import("std");
+const zphy = @import("zphysics");
+
+const AssetManager = @import("../core/asset_manager.zig").AssetManager;
+const bench_util = @import("bench_util.zig");
+const config = @import("../config/config.zig");
+const IdLocal = @import("../core/core.zig").IdLocal;
+const patch_types = @import("../worldpatch/patch_types.zig");
+const physics_manager = @import("../managers/physics_manager.zig");
+const world_patch_manager = @import("../worldpatch/world_patch_manager.zig");
+const terrain_height_query = @import("../worldpatch/terrain_height_query.zig");
+const TerrainHeightQuery = terrain_height_query.TerrainHeightQuery;
+
+// 10k creatures snapping to the ground every frame, scattered over a block of LoD0 patches.
+// Compares one raycast per creature against the physics heightfields (what snapToTerrain
+// used to do) with batched TerrainHeightQuery lookups into the same heightmaps, and checks
+// that both agree on the height.
+
+const grid_side = 16;
+const patch_count = grid_side * grid_side;
+const queries_per_frame = 10_000;
+const frame_count = 60;
+
+// The WorldPatchManager in this benchmark serves the preloaded heightmaps instead of reading content.
+var preloaded_heightmaps: []const patch_types.Heightmap = &.{};
+var preloaded_first_patch: u16 = 0;
+
+fn preloadedHeightmapLoad(patch: *world_patch_manager.Patch, ctx: world_patch_manager.PatchTypeContext) void {
+    const index = (patch.patch_x - preloaded_first_patch) + (patch.patch_z - preloaded_first_patch) * grid_side;
+    const heightmap = ctx.allocator.create(patch_types.Heightmap) catch unreachable;
+    heightmap.* = preloaded_heightmaps[index];
+    patch.data = std.mem.asBytes(heightmap);
+}
+
+fn createPhysicsTerrain(physics_world: *zphy.PhysicsSystem, heightmaps: []const patch_types.Heightmap, first_patch: u16, shapes: []*zphy.Shape) !void {
+    const body_interface = physics_world.getBodyInterfaceMut();
+    for (heightmaps, shapes, 0..) |*heightmap, *shape, i| {
+        const world_x: f32 = @floatFromInt((first_patch + i % grid_side) * config.patch_size);
+        const world_z: f32 = @floatFromInt((first_patch + i / grid_side) * config.patch_size);
+        var shape_settings = try zphy.HeightFieldShapeSettings.create(&heightmap.heightmap, config.patch_resolution);
+        defer shape_settings.release();
+        shape.* = try shape_settings.createShape();
+        _ = try body_interface.createAndAddBody(.{
+            .position = .{ world_x, 0, world_z, 1.0 },
+            .rotation = .{ 0.0, 0.0, 0.0, 1.0 },
+            .shape = shape.*,
+            .motion_type = .static,
+            .object_layer = config.physics.object_layers.non_moving,
+            .user_data = 0,
+        }, .dont_activate);
+    }
+    physics_world.optimizeBroadPhase();
+}
+
+fn runRaycasts(physics_world: *zphy.PhysicsSystem, positions: []const [2]f32, heights: []f32) !void {
+    const cast_ray_args: zphy.NarrowPhaseQuery.CastRayArgs = .{
+        .broad_phase_layer_filter = @ptrCast(&config.physics.NonMovingBroadPhaseLayerFilter{}),
+    };
+    const ray_dir = [_]f32{ 0, -1000, 0, 0 };
+    const start_height = config.terrain_max + 100;
+
+    var frame_times = bench_util.FrameTimes{};
+    for (0..frame_count) |_| {
+        var timer = try std.time.Timer.start();
+        const query = physics_world.getNarrowPhaseQuery();
+        for (positions, heights) |position, *height| {
+            const ray_origin = [_]f32{ position[0], start_height, position[1], 0 };
+            const result = query.castRay(.{ .origin = ray_origin, .direction = ray_dir }, cast_ray_args);
+            height.* = if (result.has_hit) ray_origin[1] + ray_dir[1] * result.hit.fraction else std.math.nan(f32);
+        }
+        frame_times.add(timer.read());
+    }
+    report("raycast", frame_times);
+}
+
+fn runTerrainQuery(terrain_query: *TerrainHeightQuery, positions: []const [2]f32, results: []terrain_height_query.TerrainHeightResult) !void {
+    var frame_times = bench_util.FrameTimes{};
+    for (0..frame_count) |_| {
+        var timer = try std.time.Timer.start();
+        terrain_query.queryBatch(positions, results);
+        frame_times.add(timer.read());
+    }
+    report("terrain height query", frame_times);
+}
+
+fn report(name: []const u8, frame_times: bench_util.FrameTimes) void {
+    std.debug.print("{s: <24} avg {d: >7.3} ms  worst {d: >7.3} ms  ({} queries per frame)\n", .{
+        name,
+        frame_times.averageMs(),
+        frame_times.worstMs(),
+        queries_per_frame,
+    });
+}
+
+pub fn run(allocator: std.mem.Allocator) !void {
+    const first_patch: u16 = config.world_size_x / config.patch_size / 2 - grid_side / 2;
+    const heightmaps = try allocator.alloc(patch_types.Heightmap, patch_count);
+    defer allocator.free(heightmaps);
+    // NOTE: WorldPatchManager doesn't free its bookkeeping on destroy, so keep it off the leak-checking allocator.
+    const shipped_count = try bench_util.loadHeightmapGrid(std.heap.page_allocator, first_patch, first_patch, grid_side, 0, heightmaps);
+    std.debug.print("{} of {} heightmaps from content, the rest synthetic\n", .{ shipped_count, heightmaps.len });
+
+    // Make the heightmaps resident the way the game has them.
+    preloaded_heightmaps = heightmaps;
+    preloaded_first_patch = first_patch;
+    var asset_mgr = AssetManager.create(std.heap.page_allocator);
+    defer asset_mgr.destroy();
+    var world_patch_mgr = world_patch_manager.WorldPatchManager.create(std.heap.page_allocator, &asset_mgr);
+    defer std.heap.page_allocator.destroy(world_patch_mgr);
+    defer world_patch_mgr.destroy();
+    _ = world_patch_mgr.registerPatchType(.{
+        .id = config.patch_type_heightmap,
+        .loadFn = preloadedHeightmapLoad,
+    });
+    const requester_id = world_patch_mgr.registerRequester(IdLocal.init("bench"));
+    const patch_type_id = world_patch_mgr.getPatchTypeId(config.patch_type_heightmap);
+    var lookups: [patch_count]world_patch_manager.PatchLookup = undefined;
+    for (&lookups, 0..) |*lookup, i| {
+        lookup.* = .{
+            .patch_x = @intCast(first_patch + i % grid_side),
+            .patch_z = @intCast(first_patch + i / grid_side),
+            .lod = 0,
+            .patch_type_id = patch_type_id,
+        };
+    }
+    world_patch_mgr.addLoadRequestFromLookups(requester_id, &lookups, .high);
+    world_patch_mgr.tickAll();
+
+    var arena_state = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer arena_state.deinit();
+    var physics_mgr = physics_manager.create(arena_state.allocator(), std.heap.c_allocator);
+    defer physics_manager.destroy(&physics_mgr);
+    var shapes: [patch_count]*zphy.Shape = undefined;
+    try createPhysicsTerrain(physics_mgr.physics_world, heightmaps, first_patch, &shapes);
+    defer for (shapes) |shape| shape.release();
+
+    // Creatures come in herds, so queries cluster a bit like they would in game.
+    const positions = try allocator.alloc([2]f32, queries_per_frame);
+    defer allocator.free(positions);
+    var rng = std.Random.DefaultPrng.init(1234);
+    const rand = rng.random();
+    const block_min: f32 = @floatFromInt(@as(u32, first_patch) * config.patch_size);
+    const block_size: f32 = grid_side * config.patch_size;
+    var herd_center = [2]f32{ 0, 0 };
+    for (positions, 0..) |*position, i| {
+        if (i % 32 == 0) {
+            herd_center = .{ block_min + 32 + rand.float(f32) * (block_size - 64), block_min + 32 + rand.float(f32) * (block_size - 64) };
+        }
+        position.* = .{ herd_center[0] + (rand.float(f32) - 0.5) * 60, herd_center[1] + (rand.float(f32) - 0.5) * 60 };
+    }
+
+    const ray_heights = try allocator.alloc(f32, queries_per_frame);
+    defer allocator.free(ray_heights);
+    try runRaycasts(physics_mgr.physics_world, positions, ray_heights);
+
+    var terrain_query = TerrainHeightQuery.create(world_patch_mgr);
+    const results = try allocator.alloc(terrain_height_query.TerrainHeightResult, queries_per_frame);
+    defer allocator.free(results);
+    try runTerrainQuery(&terrain_query, positions, results);
+
+    // Jolt quantizes heightfield samples, so allow a little slack.
+    var max_error: f32 = 0;
+    var misses: u32 = 0;
+    for (ray_heights, results) |ray_height, result| {
+        if (!result.hit or std.math.isNan(ray_height)) {
+            misses += 1;
+            continue;
+        }
+        max_error = @max(max_error, @abs(ray_height - result.height));
+    }
+    std.debug.print("max height difference {d:.3} m, {} misses\n", .{ max_error, misses });
+    std.debug.assert(misses == 0);
+}
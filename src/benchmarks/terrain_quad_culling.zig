@@ -0,0 +1,157 @@
+const std = @import("std");
+const zm = @import("zmath");
+
+const bench_util = @import("bench_util.zig");
+const config = @import("../config/config.zig");
+const terrain_quad_tree = @import("../renderer/terrain_quad_tree.zig");
+const QuadTreeNode = terrain_quad_tree.QuadTreeNode;
+const TerrainQuadSelector = terrain_quad_tree.TerrainQuadSelector;
+
+// Picks the terrain quads to draw for every frame of two camera paths over the whole world, built
+// like the terrain pass builds it and with every heightmap loaded: a walk through a valley between
+// hills and a flyover high above them. Compares LoD selection alone against adding frustum
+// culling and then the horizon, on one thread and on workers, and how many quads are left to draw.
+
+const sectors_side = config.world_size_x / config.largest_patch_width;
+const sectors_count = sectors_side * sectors_side;
+const lod_load_range = 4300;
+const frame_count = 300;
+const height_samples_side = 9;
+
+const near_plane = 0.1;
+const far_plane = 20000.0;
+
+// Rolling hills with a valley running through the middle of the world along z.
+fn terrainHeight(x: f32, z: f32) f32 {
+    const valley_distance = @abs(x - config.world_size_x / 2) / 3000;
+    const hills = 250 * @sin(x / 1700) * @cos(z / 1300) + 90 * @sin((x + z) / 450) + 300;
+    return hills * @min(valley_distance, 1) + 20;
+}
+
+fn createNodes(allocator: std.mem.Allocator) !std.ArrayList(QuadTreeNode) {
+    var nodes = try std.ArrayList(QuadTreeNode).initCapacity(allocator, sectors_count * terrain_quad_tree.nodes_per_sector);
+    const patch_half_size = @as(f32, @floatFromInt(config.largest_patch_width)) / 2.0;
+    for (0..sectors_side) |patch_y| {
+        for (0..sectors_side) |patch_x| {
+            nodes.appendAssumeCapacity(.{
+                .center = .{
+                    @as(f32, @floatFromInt(patch_x * config.largest_patch_width)) + patch_half_size,
+                    @as(f32, @floatFromInt(patch_y * config.largest_patch_width)) + patch_half_size,
+                },
+                .size = .{ patch_half_size, patch_half_size },
+                .child_indices = .{ terrain_quad_tree.invalid_index, terrain_quad_tree.invalid_index, terrain_quad_tree.invalid_index, terrain_quad_tree.invalid_index },
+                .mesh_lod = 3,
+                .patch_index = .{ @intCast(patch_x), @intCast(patch_y) },
+            });
+        }
+    }
+    for (0..sectors_count) |sector_index| {
+        terrain_quad_tree.divideQuadTreeNode(&nodes, &nodes.items[sector_index]);
+    }
+
+    // Stands in for the heightmaps' min and max.
+    for (nodes.items) |*node| {
+        node.height_min = std.math.floatMax(f32);
+        node.height_max = -std.math.floatMax(f32);
+        for (0..height_samples_side) |z| {
+            for (0..height_samples_side) |x| {
+                const u = @as(f32, @floatFromInt(x)) / (height_samples_side - 1) * 2 - 1;
+                const v = @as(f32, @floatFromInt(z)) / (height_samples_side - 1) * 2 - 1;
+                const height = terrainHeight(node.center[0] + u * node.size[0], node.center[1] + v * node.size[1]);
+                node.height_min = @min(node.height_min, height);
+                node.height_max = @max(node.height_max, height);
+            }
+        }
+        node.loaded = true;
+    }
+    return nodes;
+}
+
+const CameraPath = struct {
+    name: []const u8,
+    start: [2]f32,
+    end: [2]f32,
+    height_above_ground: f32,
+    pitch: f32,
+};
+
+// Reversed Z like the renderer.
+fn cameraView(path: CameraPath, frame: usize) terrain_quad_tree.CullingView {
+    const t = @as(f32, @floatFromInt(frame)) / (frame_count - 1);
+    const x = path.start[0] + (path.end[0] - path.start[0]) * t;
+    const z = path.start[1] + (path.end[1] - path.start[1]) * t;
+    const camera_position = [3]f32{ x, terrainHeight(x, z) + path.height_above_ground, z };
+
+    const heading = zm.normalize2(zm.f32x4(path.end[0] - path.start[0], path.end[1] - path.start[1], 0, 0));
+    const direction = zm.f32x4(heading[0] * @cos(path.pitch), @sin(path.pitch), heading[1] * @cos(path.pitch), 0);
+    const view_matrix = zm.lookToLh(zm.loadArr3w(camera_position, 1), direction, zm.f32x4(0, 1, 0, 0));
+    const projection = zm.perspectiveFovLh(1.0, 16.0 / 9.0, far_plane, near_plane);
+    var view_projection: [16]f32 = undefined;
+    zm.storeMat(&view_projection, zm.mul(view_matrix, projection));
+
+    return .{
+        .frustum_planes = terrain_quad_tree.frustumPlanes(view_projection),
+        .camera_position = camera_position,
+    };
+}
+
+fn runSelection(
+    allocator: std.mem.Allocator,
+    name: []const u8,
+    nodes: []const QuadTreeNode,
+    path: CameraPath,
+    worker_count: u32,
+    frustum_culling: bool,
+    horizon_culling: bool,
+) !void {
+    var pool: std.Thread.Pool = undefined;
+    try pool.init(.{ .allocator = allocator, .n_jobs = @max(worker_count, 1) });
+    defer pool.deinit();
+    const selector = TerrainQuadSelector.create(allocator, if (worker_count > 0) &pool else null);
+    defer selector.destroy();
+
+    var frame_times = bench_util.FrameTimes{};
+    var quads_to_render: u64 = 0;
+    var quads_visible: u64 = 0;
+    for (0..frame_count) |frame| {
+        var view = cameraView(path, frame);
+        view.frustum_culling = frustum_culling;
+        view.horizon_culling = horizon_culling;
+
+        var timer = try std.time.Timer.start();
+        selector.select(nodes, sectors_count, view, lod_load_range);
+        frame_times.add(timer.read());
+        quads_to_render += selector.quads_to_render.items.len;
+        quads_visible += selector.quads_visible.items.len;
+    }
+
+    std.debug.print("{s: <8} {s: <28} avg {d: >7.3} ms  worst {d: >7.3} ms  {} quads selected, {} drawn per frame\n", .{
+        path.name,
+        name,
+        frame_times.averageMs(),
+        frame_times.worstMs(),
+        quads_to_render / frame_count,
+        quads_visible / frame_count,
+    });
+}
+
+pub fn run(allocator: std.mem.Allocator) !void {
+    var nodes = try createNodes(allocator);
+    defer nodes.deinit();
+
+    const world_size: f32 = config.world_size_x;
+    const paths = [_]CameraPath{
+        .{ .name = "walk", .start = .{ world_size / 2, 2000 }, .end = .{ world_size / 2, 3500 }, .height_above_ground = 2, .pitch = 0 },
+        .{ .name = "flyover", .start = .{ 2000, 2000 }, .end = .{ world_size - 2000, world_size - 2000 }, .height_above_ground = 600, .pitch = -0.3 },
+    };
+
+    const cpu_count: u32 = @intCast(std.Thread.getCpuCount() catch 4);
+    var name_buf: [64]u8 = undefined;
+    for (paths) |path| {
+        try runSelection(allocator, "lod only, 1 thread", nodes.items, path, 0, false, false);
+        try runSelection(allocator, "frustum, 1 thread", nodes.items, path, 0, true, false);
+        try runSelection(allocator, "frustum + horizon, 1 thread", nodes.items, path, 0, true, true);
+        const threads_name = try std.fmt.bufPrint(&name_buf, "frustum + horizon, {} threads", .{cpu_count});
+        try runSelection(allocator, threads_name, nodes.items, path, cpu_count - 1, true, true);
+    }
+}
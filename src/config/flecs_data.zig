@@ -7,6 +7,7 @@ const config = @import("../config/config.zig");
 const window = @import("../renderer/window.zig");
 const ecsu = @import("../flecs_util/flecs_util.zig");
 const IdLocal = @import("../core/core.zig").IdLocal;
+const RangeAllocator = @import("../core/range_allocator.zig").RangeAllocator;
 const renderer = @import("../renderer/renderer.zig");
 const renderer_types = @import("../renderer/types.zig");
 const geometry = @import("../renderer/geometry.zig");
@@ -35,6 +36,8 @@ pub fn registerComponents(ecsu_world: ecsu.World) void {
     ecs.COMPONENT(ecs_world, Velocity);
     ecs.COMPONENT(ecs_world, LodGroup);
     ecs.COMPONENT(ecs_world, Renderable);
+    ecs.COMPONENT(ecs_world, StaticInstance);
+    ecs.COMPONENT(ecs_world, DynamicInstance);
     ecs.COMPONENT(ecs_world, Water);
     ecs.COMPONENT(ecs_world, HeightFog);
     ecs.COMPONENT(ecs_world, UIImage);
@@ -485,6 +488,16 @@ pub const Renderable = struct {
     draw_bounds: bool = false,
 };
 
+// Added by the renderer system, the renderable's slot in the static geometry instance buffer.
+pub const StaticInstance = struct {
+    slot: RangeAllocator.Allocation,
+};
+
+// Added by the renderer system, the LodGroup entity's slot in the dynamic geometry pass.
+pub const DynamicInstance = struct {
+    slot: u32,
+};
+
 // ███████╗ ██████╗  ██████╗
 // ██╔════╝██╔═══██╗██╔════╝
 // █████╗  ██║   ██║██║  ███╗
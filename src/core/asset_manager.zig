@@ -1,8 +1,10 @@
 const std = @import("std");
 const img = @import("zigimg");
 const Pool = @import("zpool").Pool;
+const ztracy = @import("ztracy");
 const IdLocal = @import("../core/core.zig").IdLocal;
 const BucketQueue = @import("../core/bucket_queue.zig").BucketQueue;
+const LRUCache = @import("../core/lru_cache.zig").LRUCache;
 
 pub const Urgency = enum {
     instant_blocking,
@@ -15,67 +17,279 @@ pub const Urgency = enum {
 
 const Asset = struct {
     status: enum { not_found, exists, loading, loaded },
-    data: ?[]u8,
-    timestamp: i64,
+    data: ?[]u8 = null,
+    refcount: u32 = 0,
 };
 
+pub const AssetStats = struct {
+    hits: u64 = 0,
+    misses: u64 = 0,
+    evictions: u64 = 0,
+    exists_cached: u64 = 0,
+    exists_fs: u64 = 0,
+    resident_bytes: u64 = 0,
+    resident_bytes_peak: u64 = 0,
+};
+
+// Limits how many reads hit the disk at once, and lets the more urgent ones go first.
+// instant_blocking skips the line, someone is waiting on it right now.
+// NOTE: Urgency only orders anything while readers queue up, so the limit has to stay below the
+// number of threads loading, see AssetManager.setReadWorkerCount.
+const ReadGate = struct {
+    const urgency_count = @typeInfo(Urgency).@"enum".fields.len;
+
+    mutex: std.Thread.Mutex = .{},
+    cond: std.Thread.Condition = .{},
+    max_concurrent_reads: u32 = 1,
+    reads_in_flight: u32 = 0,
+    waiting: [urgency_count]u32 = .{0} ** urgency_count,
+
+    fn enter(self: *ReadGate, urgency: Urgency) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        if (urgency != .instant_blocking) {
+            const level = @intFromEnum(urgency);
+            self.waiting[level] += 1;
+            while (self.reads_in_flight >= self.max_concurrent_reads or self.isMoreUrgentWaiting(level)) {
+                self.cond.wait(&self.mutex);
+            }
+            self.waiting[level] -= 1;
+        }
+        self.reads_in_flight += 1;
+    }
+
+    fn leave(self: *ReadGate) void {
+        self.mutex.lock();
+        self.reads_in_flight -= 1;
+        self.mutex.unlock();
+        self.cond.broadcast();
+    }
+
+    fn isMoreUrgentWaiting(self: *ReadGate, level: usize) bool {
+        for (self.waiting[0..level]) |count| {
+            if (count > 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Loaded assets are refcounted. Once nothing holds an asset it stays cached and is evicted
+// least recently used first whenever the resident bytes go over budget.
+// Every loadAssetBlocking needs a matching releaseAsset once the caller is done with the data.
 pub const AssetManager = struct {
+    pub const default_budget_bytes = 256 * 1024 * 1024;
+    const idle_assets_max_count = 1 << 16;
+
     allocator: std.mem.Allocator,
     assets: std.AutoHashMap(u64, Asset),
+    idle_assets: LRUCache,
+    budget_bytes: u64 = default_budget_bytes,
+    // Everything under this path was found by scanContent, so anything missing there doesn't exist.
+    scanned_root: ?[]const u8 = null,
+    stats: AssetStats = .{},
+    read_gate: ReadGate = .{},
+    // NOTE: Patches may be loaded from worker threads, see WorldPatchManager.useWorkers
+    mutex: std.Thread.Mutex = .{},
 
     pub fn create(allocator: std.mem.Allocator) AssetManager {
         var res = AssetManager{
             .allocator = allocator,
             .assets = std.AutoHashMap(u64, Asset).init(allocator),
+            .idle_assets = undefined,
         };
-        res.assets.ensureTotalCapacity(8192 * 16) catch unreachable;
+        res.idle_assets.init(allocator, idle_assets_max_count);
         return res;
     }
 
     pub fn destroy(self: *AssetManager) void {
+        var it = self.assets.valueIterator();
+        while (it.next()) |asset| {
+            if (asset.data) |data| {
+                self.allocator.free(data);
+            }
+        }
+        self.idle_assets.deinit();
         self.assets.deinit();
     }
 
-    pub fn doesAssetExist(self: AssetManager, id: IdLocal) bool {
-        _ = self;
+    // Builds the existence cache from a single directory walk. root_path must outlive the manager.
+    pub fn scanContent(self: *AssetManager, root_path: []const u8) void {
+        var dir = std.fs.cwd().openDir(root_path, .{ .iterate = true }) catch {
+            std.log.warn("AssetManager: couldn't scan {s}, falling back to file system checks", .{root_path});
+            return;
+        };
+        defer dir.close();
+        var walker = dir.walk(self.allocator) catch unreachable;
+        defer walker.deinit();
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        var path_buf: [256]u8 = undefined;
+        while (walker.next() catch null) |entry| {
+            if (entry.kind != .file) {
+                continue;
+            }
+            const path = std.fmt.bufPrint(&path_buf, "{s}/{s}", .{ root_path, entry.path }) catch continue;
+            // Asset ids always use forward slashes.
+            std.mem.replaceScalar(u8, path, '\\', '/');
+            const result = self.assets.getOrPut(IdLocal.id64(path)) catch unreachable;
+            if (!result.found_existing) {
+                result.value_ptr.* = .{ .status = .exists };
+            }
+        }
+        self.scanned_root = root_path;
+    }
+
+    pub fn setBudget(self: *AssetManager, budget_bytes: u64) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.budget_bytes = budget_bytes;
+        self.evictOverBudget();
+    }
+
+    // Reads come from worker_count loading threads. One of them is always left waiting at the
+    // gate, so the next read to start is the most urgent one.
+    pub fn setReadWorkerCount(self: *AssetManager, worker_count: u32) void {
+        self.read_gate.mutex.lock();
+        defer self.read_gate.mutex.unlock();
+        self.read_gate.max_concurrent_reads = @max(worker_count, 2) - 1;
+    }
+
+    pub fn doesAssetExist(self: *AssetManager, id: IdLocal) bool {
+        self.mutex.lock();
+        if (self.assets.get(id.hash)) |asset| {
+            self.stats.exists_cached += 1;
+            self.mutex.unlock();
+            return asset.status != .not_found;
+        }
+        if (self.scanned_root) |root| {
+            if (std.mem.startsWith(u8, id.toString(), root)) {
+                self.stats.exists_cached += 1;
+                self.mutex.unlock();
+                return false;
+            }
+        }
+        self.stats.exists_fs += 1;
+        self.mutex.unlock();
+
+        var exists = true;
         std.fs.cwd().access(id.toString(), .{ .mode = .read_only }) catch {
-            return false;
+            exists = false;
         };
-        return true;
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        const result = self.assets.getOrPut(id.hash) catch unreachable;
+        if (!result.found_existing) {
+            result.value_ptr.* = .{ .status = if (exists) .exists else .not_found };
+        }
+        return exists;
     }
 
     pub fn loadAssetBlocking(self: *AssetManager, id: IdLocal, urgency: Urgency) []u8 {
-        _ = urgency;
-        const asset_opt = self.assets.getPtr(id.hash);
-        if (asset_opt) |asset| {
-            asset.timestamp = std.time.timestamp();
-            if (asset.data) |data| {
-                return data;
-            }
+        self.mutex.lock();
+        if (self.acquireLoaded(id.hash)) |data| {
+            self.stats.hits += 1;
+            self.mutex.unlock();
+            return data;
+        }
+        self.stats.misses += 1;
+        self.mutex.unlock();
 
+        // Read outside the lock so that concurrent loads don't serialize on disk access.
+        const contents = blk: {
+            self.read_gate.enter(urgency);
+            defer self.read_gate.leave();
             const file = std.fs.cwd().openFile(id.toString(), .{ .mode = .read_only }) catch unreachable;
             defer file.close();
-            const contents = file.reader().readAllAlloc(self.allocator, 256 * 1024) catch unreachable;
-            const contents_snug = self.allocator.alignedAlloc(u8, 32, contents.len) catch unreachable;
-            @memcpy(contents_snug, contents);
+            const size = file.getEndPos() catch unreachable;
+            const buffer = self.allocator.alloc(u8, size) catch unreachable;
+            const read = file.readAll(buffer) catch unreachable;
+            std.debug.assert(read == buffer.len);
+            break :blk buffer;
+        };
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.acquireLoaded(id.hash)) |data| {
+            // Someone else loaded it while we were reading.
             self.allocator.free(contents);
-            asset.data = contents_snug;
-            asset.status = .loaded;
-            return contents_snug;
+            return data;
         }
 
-        const file = std.fs.cwd().openFile(id.toString(), .{ .mode = .read_only }) catch unreachable;
-        defer file.close();
-        const contents = file.reader().readAllAlloc(self.allocator, 5 * 1024 * 1024) catch unreachable;
-        const contents_snug = self.allocator.alloc(u8, contents.len) catch unreachable;
-        @memcpy(contents_snug, contents);
-        self.allocator.free(contents);
-        const asset = Asset{
+        self.assets.put(id.hash, .{
             .status = .loaded,
-            .data = contents_snug,
-            .timestamp = std.time.timestamp(),
-        };
-        self.assets.putAssumeCapacity(id.hash, asset);
-        return contents_snug;
+            .data = contents,
+            .refcount = 1,
+        }) catch unreachable;
+        self.stats.resident_bytes += contents.len;
+        self.stats.resident_bytes_peak = @max(self.stats.resident_bytes_peak, self.stats.resident_bytes);
+        self.evictOverBudget();
+        return contents;
+    }
+
+    pub fn releaseAsset(self: *AssetManager, id: IdLocal) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        const asset = self.assets.getPtr(id.hash).?;
+        std.debug.assert(asset.refcount > 0);
+        asset.refcount -= 1;
+        if (asset.refcount > 0) {
+            return;
+        }
+
+        if (self.idle_assets.count() == idle_assets_max_count) {
+            self.evictAsset(self.idle_assets.oldestKey().?);
+        }
+        const data = asset.data.?;
+        self.idle_assets.putSized(id.hash, @ptrCast(data.ptr), data.len);
+        self.evictOverBudget();
+    }
+
+    pub fn getStats(self: *AssetManager) AssetStats {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        return self.stats;
+    }
+
+    pub fn plotStats(self: *AssetManager) void {
+        const stats = self.getStats();
+        ztracy.PlotU("Asset Resident Bytes", stats.resident_bytes);
+        ztracy.PlotU("Asset Cache Hits", stats.hits);
+        ztracy.PlotU("Asset Cache Misses", stats.misses);
+        ztracy.PlotU("Asset Evictions", stats.evictions);
+    }
+
+    fn acquireLoaded(self: *AssetManager, hash: u64) ?[]u8 {
+        const asset = self.assets.getPtr(hash) orelse return null;
+        const data = asset.data orelse return null;
+        if (asset.refcount == 0) {
+            _ = self.idle_assets.remove(hash);
+        }
+        asset.refcount += 1;
+        return data;
+    }
+
+    fn evictOverBudget(self: *AssetManager) void {
+        while (self.stats.resident_bytes > self.budget_bytes) {
+            // Whatever is left over budget is still in use.
+            const key = self.idle_assets.oldestKey() orelse break;
+            self.evictAsset(key);
+        }
+    }
+
+    fn evictAsset(self: *AssetManager, hash: u64) void {
+        _ = self.idle_assets.remove(hash);
+        const asset = self.assets.getPtr(hash).?;
+        self.stats.resident_bytes -= asset.data.?.len;
+        self.stats.evictions += 1;
+        self.allocator.free(asset.data.?);
+        // Still known to exist, no need to ask the file system again.
+        asset.* = .{ .status = .exists };
     }
 };
@@ -1,129 +1,251 @@
 const std = @import("std");
 const expect = std.testing.expect;
 
+// LIFO within a bucket, buckets are drained from the highest priority (lowest enum value) down.
+//
+// Each bucket is a ring buffer addressed by ever increasing positions, so pushing to either
+// end is O(1). A side table maps every queued element to its bucket and position, which makes
+// remove and moving between buckets O(1) too: the old slot is just marked dead and skipped when
+// popping. A bucket is compacted once its dead slots outnumber the live ones.
+//
+// Elements must be unique within the queue.
 pub fn BucketQueue(comptime QueueElement: type, comptime BucketEnum: type) type {
     return struct {
         const Self = @This();
-        const Bucket = std.ArrayList(QueueElement);
         const bucket_count: u32 = @typeInfo(BucketEnum).@"enum".fields.len;
         const lowest_prio: u32 = bucket_count - 1;
+        // Positions start in the middle of the range so pushing to the bottom never underflows.
+        const base_position: u64 = 1 << 62;
+        const min_bucket_capacity = 16;
+        const min_dead_for_compaction = 64;
+
+        pub const Bucket = struct {
+            items: []QueueElement,
+            live: []bool,
+            bottom: u64 = base_position,
+            top: u64 = base_position, // One past the topmost element
+            live_count: u32 = 0,
+
+            fn slot(self: Bucket, position: u64) usize {
+                return @intCast(position & (self.items.len - 1));
+            }
+
+            fn span(self: Bucket) u64 {
+                return self.top - self.bottom;
+            }
+        };
+
+        const Location = struct {
+            bucket: u32,
+            position: u64,
+        };
 
         allocator: std.mem.Allocator,
         buckets: [bucket_count]Bucket = undefined,
+        locations: std.AutoHashMapUnmanaged(QueueElement, Location) = .{},
         current_highest_prio: u32 = lowest_prio,
 
         pub fn create(allocator: std.mem.Allocator, bucket_sizes: [bucket_count]u32) Self {
             var result = Self{
                 .allocator = allocator,
             };
+            var total_size: u32 = 0;
             for (&result.buckets, 0..) |*bucket, i| {
-                bucket.* = Bucket.init(allocator);
-                bucket.*.ensureTotalCapacity(bucket_sizes[i]) catch unreachable;
+                const capacity = std.math.ceilPowerOfTwoAssert(usize, @max(bucket_sizes[i], min_bucket_capacity));
+                bucket.* = .{
+                    .items = allocator.alloc(QueueElement, capacity) catch unreachable,
+                    .live = allocator.alloc(bool, capacity) catch unreachable,
+                };
+                @memset(bucket.live, false);
+                total_size += bucket_sizes[i];
             }
+            result.locations.ensureTotalCapacity(allocator, total_size) catch unreachable;
             return result;
         }
 
         pub fn destroy(self: *Self) void {
-            for (self.buckets) |*bucket| {
-                bucket.deinit();
+            for (&self.buckets) |*bucket| {
+                self.allocator.free(bucket.items);
+                self.allocator.free(bucket.live);
             }
+            self.locations.deinit(self.allocator);
         }
 
         pub fn peek(self: Self) bool {
-            if (self.buckets[self.current_highest_prio].items.len == 0) {
-                return false;
-            }
-            return true;
+            return self.buckets[self.current_highest_prio].live_count > 0;
+        }
+
+        pub fn count(self: Self) u32 {
+            return self.locations.count();
+        }
+
+        pub fn bucketCount(self: Self, prio: BucketEnum) u32 {
+            return self.buckets[@intFromEnum(prio)].live_count;
         }
 
         pub fn pushElems(self: *Self, elems: []const QueueElement, prio: BucketEnum) void {
             const prio_index = @intFromEnum(prio);
-            self.buckets[prio_index].appendSliceAssumeCapacity(elems);
+            for (elems) |elem| {
+                self.pushTop(elem, prio_index);
+            }
             if (prio_index < self.current_highest_prio) {
                 self.current_highest_prio = prio_index;
             }
         }
 
+        // elems ends up at the bottom in the given order, so elems[0] is popped last.
         pub fn pushElemsToBottomOfBucket(self: *Self, elems: []const QueueElement, prio: BucketEnum) void {
             const prio_index = @intFromEnum(prio);
-            self.buckets[prio_index].insertSlice(0, elems) catch unreachable;
+            var i = elems.len;
+            while (i > 0) {
+                i -= 1;
+                self.pushBottom(elems[i], prio_index);
+            }
             if (prio_index < self.current_highest_prio) {
                 self.current_highest_prio = prio_index;
             }
         }
 
         pub fn popElems(self: *Self, elems_out: []QueueElement) u32 {
-            if (self.buckets[self.current_highest_prio].items.len == 0) {
-                return 0;
-            }
-
-            // TODO: Possibly inverting the two loops may be smarter (faster)
-            var count: u32 = 0;
-            var bucket_index = self.current_highest_prio;
+            var popped: u32 = 0;
             for (elems_out) |*elem| {
-                var bucket = &self.buckets[bucket_index];
-                elem.* = bucket.pop().?;
-                count += 1;
-                while (bucket.items.len == 0) {
-                    if (bucket_index == lowest_prio) {
-                        // No more elements in the queue
-                        return count;
-                    }
-                    bucket_index += 1;
-                    bucket = &self.buckets[bucket_index];
-                    self.current_highest_prio = bucket_index;
+                if (!self.peek()) {
+                    break;
                 }
+                const bucket = &self.buckets[self.current_highest_prio];
+                // The topmost slot is always live, see trim.
+                bucket.top -= 1;
+                const slot = bucket.slot(bucket.top);
+                elem.* = bucket.items[slot];
+                _ = self.locations.remove(elem.*);
+                self.killSlot(self.current_highest_prio, slot);
+                popped += 1;
             }
-            return count;
+            return popped;
         }
 
         pub fn removeElems(self: *Self, elems: []const QueueElement) void {
-            elem_loop: for (elems) |elem| {
-                for (&self.buckets, 0..) |*bucket, prio| {
-                    for (bucket.items, 0..) |bucket_elem, i| {
-                        if (std.meta.eql(bucket_elem, elem)) {
-                            _ = bucket.orderedRemove(i);
-
-                            if (prio == self.current_highest_prio) {
-                                while (self.buckets[self.current_highest_prio].items.len == 0) {
-                                    if (self.current_highest_prio == lowest_prio) {
-                                        continue :elem_loop;
-                                    }
-                                    self.current_highest_prio += 1;
-                                }
-                            }
-
-                            continue :elem_loop;
-                        }
-                    }
-                }
-
-                unreachable;
+            for (elems) |elem| {
+                const location = self.locations.fetchRemove(elem).?.value;
+                const bucket = &self.buckets[location.bucket];
+                self.killSlot(location.bucket, bucket.slot(location.position));
             }
         }
 
+        // Moves elems to the top of the prio_new bucket, also when it's the same bucket.
         pub fn updateElems(self: *Self, elems: []const QueueElement, prio_old: BucketEnum, prio_new: BucketEnum) void {
-            const prio_index_old = @intFromEnum(prio_old);
             const prio_index_new = @intFromEnum(prio_new);
-            var bucket_old = &self.buckets[prio_index_old];
-            var bucket_new = &self.buckets[prio_index_new];
             for (elems) |elem| {
-                const bucket_old_elem_index = blk: {
-                    for (bucket_old.items, 0..) |bucket_old_elem, i| {
-                        if (std.meta.eql(elem, bucket_old_elem)) {
-                            break :blk i;
-                        }
-                    }
-                    unreachable;
-                };
-                _ = bucket_old.orderedRemove(bucket_old_elem_index);
-                bucket_new.appendAssumeCapacity(elem);
+                const location = self.locations.fetchRemove(elem).?.value;
+                std.debug.assert(location.bucket == @intFromEnum(prio_old));
+                const bucket = &self.buckets[location.bucket];
+                self.killSlot(location.bucket, bucket.slot(location.position));
+                self.pushTop(elem, prio_index_new);
             }
 
             if (prio_index_new < self.current_highest_prio) {
                 self.current_highest_prio = prio_index_new;
             }
         }
+
+        fn pushTop(self: *Self, elem: QueueElement, prio_index: u32) void {
+            self.reserve(prio_index);
+            const bucket = &self.buckets[prio_index];
+            const position = bucket.top;
+            bucket.top += 1;
+            self.fillSlot(prio_index, position, elem);
+        }
+
+        fn pushBottom(self: *Self, elem: QueueElement, prio_index: u32) void {
+            self.reserve(prio_index);
+            const bucket = &self.buckets[prio_index];
+            bucket.bottom -= 1;
+            self.fillSlot(prio_index, bucket.bottom, elem);
+        }
+
+        fn fillSlot(self: *Self, prio_index: u32, position: u64, elem: QueueElement) void {
+            const bucket = &self.buckets[prio_index];
+            const slot = bucket.slot(position);
+            bucket.items[slot] = elem;
+            bucket.live[slot] = true;
+            bucket.live_count += 1;
+            const result = self.locations.getOrPut(self.allocator, elem) catch unreachable;
+            std.debug.assert(!result.found_existing);
+            result.value_ptr.* = .{ .bucket = prio_index, .position = position };
+        }
+
+        fn killSlot(self: *Self, prio_index: u32, slot: usize) void {
+            const bucket = &self.buckets[prio_index];
+            std.debug.assert(bucket.live[slot]);
+            bucket.live[slot] = false;
+            bucket.live_count -= 1;
+            self.trim(prio_index);
+
+            while (self.buckets[self.current_highest_prio].live_count == 0 and self.current_highest_prio < lowest_prio) {
+                self.current_highest_prio += 1;
+            }
+        }
+
+        // Drops dead slots off both ends so the top and bottom slots are always live,
+        // and compacts the bucket if too many dead ones are left in the middle.
+        fn trim(self: *Self, prio_index: u32) void {
+            const bucket = &self.buckets[prio_index];
+            if (bucket.live_count == 0) {
+                bucket.bottom = base_position;
+                bucket.top = base_position;
+                return;
+            }
+            while (!bucket.live[bucket.slot(bucket.top - 1)]) {
+                bucket.top -= 1;
+            }
+            while (!bucket.live[bucket.slot(bucket.bottom)]) {
+                bucket.bottom += 1;
+            }
+
+            const dead_count = bucket.span() - bucket.live_count;
+            if (dead_count >= min_dead_for_compaction and dead_count > bucket.live_count) {
+                self.rebuild(prio_index, bucket.items.len);
+            }
+        }
+
+        fn reserve(self: *Self, prio_index: u32) void {
+            const bucket = &self.buckets[prio_index];
+            if (bucket.span() < bucket.items.len) {
+                return;
+            }
+            // Full of live elements grows, otherwise compacting frees up room.
+            const capacity = if (bucket.live_count * 2 > bucket.items.len) bucket.items.len * 2 else bucket.items.len;
+            self.rebuild(prio_index, capacity);
+        }
+
+        // Packs the live elements of a bucket into fresh storage, keeping their order.
+        fn rebuild(self: *Self, prio_index: u32, capacity: usize) void {
+            const old = self.buckets[prio_index];
+            var bucket = Bucket{
+                .items = self.allocator.alloc(QueueElement, capacity) catch unreachable,
+                .live = self.allocator.alloc(bool, capacity) catch unreachable,
+                .live_count = old.live_count,
+            };
+            @memset(bucket.live, false);
+
+            var position = old.bottom;
+            while (position < old.top) : (position += 1) {
+                const old_slot = old.slot(position);
+                if (!old.live[old_slot]) {
+                    continue;
+                }
+                const elem = old.items[old_slot];
+                const slot = bucket.slot(bucket.top);
+                bucket.items[slot] = elem;
+                bucket.live[slot] = true;
+                self.locations.getPtr(elem).?.position = bucket.top;
+                bucket.top += 1;
+            }
+
+            self.allocator.free(old.items);
+            self.allocator.free(old.live);
+            self.buckets[prio_index] = bucket;
+        }
     };
 }
 
@@ -166,3 +288,44 @@ test "priority_bucket_queue" {
     // var ids_highlol = [_]MyHandle{ 50, 40 };
     // try expect(out_ids[0..2] == ids_highlol[0..2]);
 }
+
+test "priority_bucket_queue_remove_update" {
+    const MyPrio = enum {
+        high,
+        med,
+        low,
+    };
+    const MyQueue = BucketQueue(u32, MyPrio);
+    var queue = MyQueue.create(std.testing.allocator, [_]u32{ 4, 4, 4 });
+    defer queue.destroy();
+
+    // Enough to grow the buckets and trigger compaction along the way.
+    for (0..1000) |i| {
+        const elem: u32 = @intCast(i);
+        queue.pushElems(&.{elem}, .low);
+    }
+    for (0..1000) |i| {
+        const elem: u32 = @intCast(i);
+        if (i % 10 != 0) {
+            queue.removeElems(&.{elem});
+        }
+    }
+    try expect(queue.count() == 100);
+    try expect(queue.bucketCount(.low) == 100);
+
+    queue.pushElemsToBottomOfBucket(&.{ 2000, 2001 }, .med);
+    queue.pushElems(&.{3000}, .med);
+    queue.updateElems(&.{990}, .low, .high);
+    queue.updateElems(&.{2000}, .med, .med);
+    try expect(queue.current_highest_prio == 0);
+
+    var out_ids: [6]u32 = undefined;
+    try expect(queue.popElems(&out_ids) == 6);
+    try expect(std.mem.eql(u32, &out_ids, &.{ 990, 2000, 3000, 2001, 980, 970 }));
+
+    queue.removeElems(&.{0});
+    var rest: [128]u32 = undefined;
+    try expect(queue.popElems(&rest) == 96);
+    try expect(rest[95] == 10);
+    try expect(!queue.peek());
+}
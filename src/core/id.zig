@@ -87,3 +87,127 @@ pub const IdLocalHashMapContext = struct {
         return a.eql(b);
     }
 };
+
+// Hashes the precomputed hash instead of the whole 200 byte struct like AutoHashMap would.
+pub fn IdLocalHashMap(comptime V: type) type {
+    return std.HashMap(IdLocal, V, IdLocalHashMapContext, std.hash_map.default_max_load_percentage);
+}
+
+// Interned 4 byte id. The string is hashed and copied once when interned, after that
+// equality is an integer compare and the handle can be used directly as a hash map key.
+// Use it instead of IdLocal in structs that are stored in bulk or copied around a lot.
+// Handles can't be created at comptime, keep IdLocal for comptime constants.
+pub const IdHandle = enum(u32) {
+    none = 0,
+    _,
+
+    pub fn init(str: []const u8) IdHandle {
+        return intern_table.intern(str, IdLocal.id64(str));
+    }
+
+    pub fn fromId(id: IdLocal) IdHandle {
+        return intern_table.intern(id.toString(), id.hash);
+    }
+
+    pub fn toString(self: IdHandle) []const u8 {
+        return intern_table.entry(self).str;
+    }
+
+    pub fn hash(self: IdHandle) IdLocal.HashType {
+        return intern_table.entry(self).hash;
+    }
+
+    pub fn isUnset(self: IdHandle) bool {
+        return self == .none;
+    }
+};
+
+// Process wide and never shrinks, interned strings live until exit.
+// Only interning takes the mutex. Entries live in fixed size chunks that are never moved or
+// freed, so toString() and hash() read them without locking. A handle is only ever seen after
+// the intern() that wrote its entry, which orders the read after the write.
+const InternTable = struct {
+    const Entry = struct {
+        str: []const u8,
+        hash: IdLocal.HashType,
+    };
+
+    const chunk_shift = 12;
+    const chunk_size = 1 << chunk_shift;
+    const max_chunks = 1024; // 4M handles
+    const Chunk = [chunk_size]Entry;
+
+    mutex: std.Thread.Mutex = .{},
+    string_arena: std.heap.ArenaAllocator = std.heap.ArenaAllocator.init(std.heap.page_allocator),
+    chunks: [max_chunks]?*Chunk = .{null} ** max_chunks,
+    count: u32 = 1, // Handle 0 is none
+    handles: std.AutoHashMapUnmanaged(IdLocal.HashType, IdHandle) = .{},
+
+    fn intern(self: *InternTable, str: []const u8, str_hash: IdLocal.HashType) IdHandle {
+        if (str.len == 0) {
+            return .none;
+        }
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        const result = self.handles.getOrPut(std.heap.page_allocator, str_hash) catch unreachable;
+        if (result.found_existing) {
+            // Same assumption as IdLocal.eql, a 64 bit hash collision is treated as the same id.
+            std.debug.assert(std.mem.eql(u8, self.entry(result.value_ptr.*).str, str));
+            return result.value_ptr.*;
+        }
+
+        const index = self.count;
+        std.debug.assert(index < max_chunks * chunk_size);
+        const chunk_slot = &self.chunks[index >> chunk_shift];
+        if (chunk_slot.* == null) {
+            const chunk = std.heap.page_allocator.create(Chunk) catch unreachable;
+            @atomicStore(?*Chunk, chunk_slot, chunk, .release);
+        }
+        const str_copy = self.string_arena.allocator().dupe(u8, str) catch unreachable;
+        chunk_slot.*.?[index & (chunk_size - 1)] = .{ .str = str_copy, .hash = str_hash };
+        self.count += 1;
+
+        const handle: IdHandle = @enumFromInt(index);
+        result.value_ptr.* = handle;
+        return handle;
+    }
+
+    fn entry(self: *const InternTable, handle: IdHandle) Entry {
+        if (handle == .none) {
+            return .{ .str = "", .hash = 0 };
+        }
+
+        const index = @intFromEnum(handle);
+        const chunk = @atomicLoad(?*Chunk, &self.chunks[index >> chunk_shift], .acquire).?;
+        return chunk[index & (chunk_size - 1)];
+    }
+};
+
+var intern_table: InternTable = .{};
+
+test "id_handle" {
+    const a = IdHandle.init("tree");
+    const b = IdHandle.fromId(IdLocal.init("tree"));
+    const c = IdHandle.init("house");
+    try std.testing.expect(a == b);
+    try std.testing.expect(a != c);
+    try std.testing.expectEqualStrings("house", c.toString());
+    try std.testing.expectEqual(IdLocal.id64("tree"), a.hash());
+    try std.testing.expect(IdHandle.init("").isUnset());
+    try std.testing.expectEqual(4, @sizeOf(IdHandle));
+}
+
+test "id_handle lookups across chunks" {
+    var buf: [32]u8 = undefined;
+    var handles: [InternTable.chunk_size + 16]IdHandle = undefined;
+    for (&handles, 0..) |*handle, i| {
+        handle.* = IdHandle.init(std.fmt.bufPrint(&buf, "chunk_test_{d}", .{i}) catch unreachable);
+    }
+    for (handles, 0..) |handle, i| {
+        const str = std.fmt.bufPrint(&buf, "chunk_test_{d}", .{i}) catch unreachable;
+        try std.testing.expectEqualStrings(str, handle.toString());
+        try std.testing.expectEqual(IdLocal.id64(str), handle.hash());
+    }
+}
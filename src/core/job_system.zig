@@ -0,0 +1,79 @@
+const std = @import("std");
+
+// The game's worker threads. Subsystems borrow these pools instead of spawning their own,
+// so the thread count follows the core count rather than adding up per subsystem.
+//
+// frame: short parallel-for work the calling thread waits on within the frame, like task
+// calculation, light clustering, quad selection and mesh decoding. The caller works along
+// in waitAndWork.
+// background: long jobs that are polled for on later frames, like patch loads and
+// heightfield shapes. Kept apart so a frame never waits behind them.
+//
+// NOTE: The pools outlive everything that borrows them, so a borrower must wait for its own
+// jobs before it is destroyed. Nothing is joined on its behalf.
+pub const JobSystem = struct {
+    pub const WorkerCounts = struct {
+        frame: u32,
+        background: u32,
+    };
+
+    allocator: std.mem.Allocator,
+    frame: *std.Thread.Pool,
+    background: *std.Thread.Pool,
+    worker_counts: WorkerCounts,
+
+    pub fn create(allocator: std.mem.Allocator, cpu_count: u32) *JobSystem {
+        const worker_counts = workerCounts(cpu_count);
+        const self = allocator.create(JobSystem) catch unreachable;
+        self.* = .{
+            .allocator = allocator,
+            .frame = allocator.create(std.Thread.Pool) catch unreachable,
+            .background = allocator.create(std.Thread.Pool) catch unreachable,
+            .worker_counts = worker_counts,
+        };
+        self.frame.init(.{ .allocator = allocator, .n_jobs = worker_counts.frame }) catch unreachable;
+        self.background.init(.{ .allocator = allocator, .n_jobs = worker_counts.background }) catch unreachable;
+        return self;
+    }
+
+    pub fn destroy(self: *JobSystem) void {
+        self.frame.deinit();
+        self.background.deinit();
+        self.allocator.destroy(self.frame);
+        self.allocator.destroy(self.background);
+        self.allocator.destroy(self);
+    }
+
+    // Leaves the main thread and one core for the OS/driver alone and splits the rest.
+    // The background pool gets a quarter, it mostly waits on IO and decompression.
+    pub fn workerCounts(cpu_count: u32) WorkerCounts {
+        const background = std.math.clamp(cpu_count / 4, 1, 4);
+        const frame = @max(cpu_count -| (2 + background), 1);
+        return .{ .frame = frame, .background = background };
+    }
+};
+
+test "job_system worker counts" {
+    for (1..65) |cpu_count| {
+        const counts = JobSystem.workerCounts(@intCast(cpu_count));
+        try std.testing.expect(counts.frame >= 1);
+        try std.testing.expect(counts.background >= 1);
+        if (cpu_count >= 4) {
+            try std.testing.expect(counts.frame + counts.background + 2 <= cpu_count);
+        }
+    }
+
+    const jobs = JobSystem.create(std.testing.allocator, 8);
+    defer jobs.destroy();
+    var counter = std.atomic.Value(u32).init(0);
+    var wait_group: std.Thread.WaitGroup = .{};
+    for (0..16) |_| {
+        jobs.frame.spawnWg(&wait_group, struct {
+            fn run(value: *std.atomic.Value(u32)) void {
+                _ = value.fetchAdd(1, .monotonic);
+            }
+        }.run, .{&counter});
+    }
+    jobs.frame.waitAndWork(&wait_group);
+    try std.testing.expectEqual(@as(u32, 16), counter.load(.monotonic));
+}
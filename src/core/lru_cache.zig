@@ -1,124 +1,278 @@
 const std = @import("std");
-const time = std.time;
 
 pub const LRUKey = u64;
 pub const LRUValue = *anyopaque;
 
-pub const LRUCacheEntry = struct {
-    key: LRUKey,
-    value: LRUValue,
-    timestamp: i128,
-};
+pub const LRUEvictFn = *const fn (ctx: ?*anyopaque, key: LRUKey, value: LRUValue) void;
 
+// Hash index into a slot array plus an intrusive doubly linked list in recency order,
+// so every operation is O(1). Recency is the position in that list, no timestamps are kept.
+//
+// Capacity is an entry count and optionally a byte budget. put() evicts from the cold
+// end until the new entry fits and hands evicted entries to on_evict, if set.
+// try_get() + replace() still work for callers that want to recycle the evicted value.
+//
+// NOTE: Pointers returned by try_get/get are valid until that entry is evicted or removed.
 pub const LRUCache = struct {
+    const invalid_slot = std.math.maxInt(u32);
+
+    const Node = struct {
+        key: LRUKey,
+        value: LRUValue,
+        size_bytes: u64,
+        prev: u32, // towards the most recently used end
+        next: u32, // towards the least recently used end
+    };
+
+    pub const Options = struct {
+        max_entries: u64,
+        max_bytes: u64 = 0, // 0 = no byte budget
+        on_evict: ?LRUEvictFn = null,
+        on_evict_ctx: ?*anyopaque = null,
+    };
+
     allocator: std.mem.Allocator,
-    entries: std.MultiArrayList(LRUCacheEntry),
-    max_entries: u64,
+    options: Options,
+    index: std.AutoHashMapUnmanaged(LRUKey, u32),
+    nodes: std.ArrayListUnmanaged(Node),
+    free_slot: u32,
+    head: u32, // most recently used
+    tail: u32, // least recently used
+    entry_count: u64,
+    bytes_used: u64,
 
     pub fn init(self: *LRUCache, allocator: std.mem.Allocator, max_entries: u64) void {
-        self.allocator = allocator;
-        self.entries = .{};
-        self.max_entries = max_entries;
-        self.entries.ensureTotalCapacity(allocator, max_entries) catch unreachable; // HACK
+        self.initWithOptions(allocator, .{ .max_entries = max_entries });
+    }
+
+    pub fn initWithOptions(self: *LRUCache, allocator: std.mem.Allocator, options: Options) void {
+        std.debug.assert(options.max_entries > 0);
+        self.* = .{
+            .allocator = allocator,
+            .options = options,
+            .index = .{},
+            .nodes = .{},
+            .free_slot = invalid_slot,
+            .head = invalid_slot,
+            .tail = invalid_slot,
+            .entry_count = 0,
+            .bytes_used = 0,
+        };
+        self.index.ensureTotalCapacity(allocator, @intCast(options.max_entries)) catch unreachable;
+        self.nodes.ensureTotalCapacity(allocator, options.max_entries) catch unreachable;
     }
 
     pub fn deinit(self: *LRUCache) void {
-        self.entries.deinit(self.allocator);
+        self.index.deinit(self.allocator);
+        self.nodes.deinit(self.allocator);
+    }
+
+    pub fn count(self: *const LRUCache) u64 {
+        return self.entry_count;
     }
 
     pub fn has(self: *LRUCache, key: LRUKey) bool {
-        const keys = self.entries.items(.key);
-        for (keys) |entry_key| {
-            if (entry_key == key) {
-                return true;
-            }
-        }
-        return false;
+        return self.index.contains(key);
     }
 
+    // Returns the value and marks it as most recently used.
+    pub fn get(self: *LRUCache, key: LRUKey) ?*LRUValue {
+        const slot = self.index.get(key) orelse return null;
+        self.moveToFront(slot);
+        return &self.nodes.items[slot].value;
+    }
+
+    // Like get(), but on a miss with a full cache it also reports which entry
+    // would be evicted so the caller can recycle it with replace().
     pub fn try_get(self: *LRUCache, key: LRUKey, evict_key: *?LRUKey, evict_value: *?LRUValue) ?*LRUValue {
-        const keys = self.entries.items(.key);
-        const values = self.entries.items(.value);
-        const timestamps = self.entries.items(.timestamp);
-
-        for (keys, 0..) |entry_key, i| {
-            if (entry_key == key) {
-                timestamps[i] = time.nanoTimestamp();
-                return &values[i];
-            }
+        if (self.get(key)) |value| {
+            return value;
         }
 
-        if (keys.len < self.max_entries) {
+        if (self.entry_count < self.options.max_entries) {
             return null;
         }
 
-        var last_timestamp: i128 = std.math.maxInt(i128);
-        for (timestamps, 0..) |entry_timestamp, i| {
-            if (entry_timestamp < last_timestamp) {
-                last_timestamp = timestamps[i];
-                evict_key.* = keys[i];
-                evict_value.* = values[i];
-            }
-        }
-
+        const oldest = &self.nodes.items[self.tail];
+        evict_key.* = oldest.key;
+        evict_value.* = oldest.value;
         return null;
     }
 
     pub fn put(self: *LRUCache, key: LRUKey, value: LRUValue) void {
+        self.putSized(key, value, 0);
+    }
+
+    pub fn putSized(self: *LRUCache, key: LRUKey, value: LRUValue, size_bytes: u64) void {
         std.debug.assert(!self.has(key));
-        std.debug.assert(self.entries.len < self.max_entries);
-        const entry: LRUCacheEntry = .{
+
+        while (self.entry_count > 0 and self.isOverBudget(size_bytes)) {
+            self.evictOldest();
+        }
+
+        const slot = self.allocSlot();
+        self.nodes.items[slot] = .{
             .key = key,
             .value = value,
-            .timestamp = time.nanoTimestamp(),
+            .size_bytes = size_bytes,
+            .prev = invalid_slot,
+            .next = invalid_slot,
         };
-        self.entries.append(self.allocator, entry) catch unreachable;
-    }
-
-    pub fn remove(self: *LRUCache, key: LRUKey) *LRUValue {
-        const keys = self.entries.items(.key);
-        const values = self.entries.items(.value);
-        for (keys, 0..) |entry_key, i| {
-            if (entry_key == key) {
-                const value_ptr = values[i];
-                self.entries.swapRemove(i);
-                return value_ptr;
-            }
-        }
+        self.linkFront(slot);
+        self.index.put(self.allocator, key, slot) catch unreachable;
+        self.entry_count += 1;
+        self.bytes_used += size_bytes;
+    }
 
-        unreachable;
+    pub fn remove(self: *LRUCache, key: LRUKey) LRUValue {
+        const kv = self.index.fetchRemove(key) orelse unreachable;
+        const value = self.nodes.items[kv.value].value;
+        self.releaseSlot(kv.value);
+        return value;
     }
 
-    // pub fn replace(self: *LRUCache, old_entry: LRUCacheEntry, new_key: LRUKey, new_value: LRUValue) void {
     pub fn replace(self: *LRUCache, old_key: LRUKey, new_key: LRUKey, new_value: LRUValue) void {
         std.debug.assert(!self.has(new_key));
 
-        const keys = self.entries.items(.key);
-        const values = self.entries.items(.value);
-        const timestamps = self.entries.items(.timestamp);
-
-        for (keys, 0..) |entry_key, i| {
-            if (entry_key == old_key) {
-                keys[i] = new_key;
-                values[i] = new_value;
-                timestamps[i] = time.nanoTimestamp();
-                return;
-            }
-        }
+        const kv = self.index.fetchRemove(old_key) orelse unreachable;
+        const node = &self.nodes.items[kv.value];
+        node.key = new_key;
+        node.value = new_value;
+        self.index.put(self.allocator, new_key, kv.value) catch unreachable;
+        self.moveToFront(kv.value);
+    }
 
-        unreachable;
+    // Next in line for eviction, if any.
+    pub fn oldestKey(self: *const LRUCache) ?LRUKey {
+        if (self.tail == invalid_slot) {
+            return null;
+        }
+        return self.nodes.items[self.tail].key;
     }
 
     pub fn touch(self: *LRUCache, key: LRUKey) void {
-        const keys = self.entries.items(.key);
-        const timestamps = self.entries.items(.timestamp);
-        for (keys, 0..) |entry_key, i| {
-            if (entry_key == key) {
-                timestamps[i] = time.nanoTimestamp();
-                return;
-            }
+        const slot = self.index.get(key) orelse unreachable;
+        self.moveToFront(slot);
+    }
+
+    fn isOverBudget(self: *const LRUCache, incoming_bytes: u64) bool {
+        if (self.entry_count + 1 > self.options.max_entries) {
+            return true;
         }
+        return self.options.max_bytes != 0 and self.bytes_used + incoming_bytes > self.options.max_bytes;
+    }
+
+    fn evictOldest(self: *LRUCache) void {
+        const slot = self.tail;
+        const node = self.nodes.items[slot];
+        _ = self.index.remove(node.key);
+        self.releaseSlot(slot);
+        if (self.options.on_evict) |on_evict| {
+            on_evict(self.options.on_evict_ctx, node.key, node.value);
+        }
+    }
+
+    fn allocSlot(self: *LRUCache) u32 {
+        if (self.free_slot != invalid_slot) {
+            const slot = self.free_slot;
+            self.free_slot = self.nodes.items[slot].next;
+            return slot;
+        }
+
+        // max_entries slots are reserved in init, so this never reallocates.
+        self.nodes.append(self.allocator, undefined) catch unreachable;
+        return @intCast(self.nodes.items.len - 1);
+    }
+
+    fn releaseSlot(self: *LRUCache, slot: u32) void {
+        self.unlink(slot);
+        self.entry_count -= 1;
+        self.bytes_used -= self.nodes.items[slot].size_bytes;
+        self.nodes.items[slot].next = self.free_slot;
+        self.free_slot = slot;
+    }
 
-        unreachable;
+    fn moveToFront(self: *LRUCache, slot: u32) void {
+        if (self.head == slot) {
+            return;
+        }
+        self.unlink(slot);
+        self.linkFront(slot);
+    }
+
+    fn linkFront(self: *LRUCache, slot: u32) void {
+        const node = &self.nodes.items[slot];
+        node.prev = invalid_slot;
+        node.next = self.head;
+        if (self.head != invalid_slot) {
+            self.nodes.items[self.head].prev = slot;
+        }
+        self.head = slot;
+        if (self.tail == invalid_slot) {
+            self.tail = slot;
+        }
+    }
+
+    fn unlink(self: *LRUCache, slot: u32) void {
+        const node = &self.nodes.items[slot];
+        if (node.prev != invalid_slot) {
+            self.nodes.items[node.prev].next = node.next;
+        } else {
+            self.head = node.next;
+        }
+        if (node.next != invalid_slot) {
+            self.nodes.items[node.next].prev = node.prev;
+        } else {
+            self.tail = node.prev;
+        }
+        node.prev = invalid_slot;
+        node.next = invalid_slot;
     }
 };
+
+test "lru_cache" {
+    const EvictLog = struct {
+        keys: std.BoundedArray(LRUKey, 8) = .{},
+
+        fn onEvict(ctx: ?*anyopaque, key: LRUKey, value: LRUValue) void {
+            _ = value;
+            const self: *@This() = @ptrCast(@alignCast(ctx.?));
+            self.keys.append(key) catch unreachable;
+        }
+    };
+
+    var values: [8]u32 = .{ 0, 1, 2, 3, 4, 5, 6, 7 };
+    var evict_log = EvictLog{};
+    var cache: LRUCache = undefined;
+    cache.initWithOptions(std.testing.allocator, .{
+        .max_entries = 3,
+        .max_bytes = 100,
+        .on_evict = EvictLog.onEvict,
+        .on_evict_ctx = &evict_log,
+    });
+    defer cache.deinit();
+
+    cache.putSized(1, &values[1], 10);
+    cache.putSized(2, &values[2], 10);
+    cache.putSized(3, &values[3], 10);
+    cache.touch(1);
+
+    // Entry count limit, 2 is the least recently used.
+    cache.putSized(4, &values[4], 10);
+    try std.testing.expectEqualSlices(LRUKey, &.{2}, evict_log.keys.slice());
+    try std.testing.expect(!cache.has(2));
+
+    // Byte budget, needs to drop both 3 and 1.
+    _ = cache.get(4);
+    cache.putSized(5, &values[5], 85);
+    try std.testing.expectEqualSlices(LRUKey, &.{ 2, 3, 1 }, evict_log.keys.slice());
+    try std.testing.expectEqual(2, cache.count());
+    try std.testing.expectEqual(95, cache.bytes_used);
+
+    var evict_key: ?LRUKey = null;
+    var evict_value: ?LRUValue = null;
+    try std.testing.expect(cache.try_get(6, &evict_key, &evict_value) == null);
+    try std.testing.expect(evict_key == null);
+    _ = cache.remove(4);
+    try std.testing.expectEqual(1, cache.count());
+}
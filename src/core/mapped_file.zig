@@ -0,0 +1,48 @@
+const std = @import("std");
+const builtin = @import("builtin");
+
+// Read-only memory mapping of a whole file, for the patch archives and TidesMesh v2 files.
+// NOTE: Only imports std, it's built as the "mapped_file" module so that the renderer's and
+// worldpatch's test roots and the simulator can share it. Import it by that name, never by path.
+
+const windows = std.os.windows;
+const PAGE_READONLY = 0x02;
+const FILE_MAP_READ = 0x04;
+extern "kernel32" fn CreateFileMappingW(
+    file: windows.HANDLE,
+    attributes: ?*anyopaque,
+    protect: windows.DWORD,
+    maximum_size_high: windows.DWORD,
+    maximum_size_low: windows.DWORD,
+    name: ?windows.LPCWSTR,
+) callconv(windows.WINAPI) ?windows.HANDLE;
+extern "kernel32" fn MapViewOfFile(
+    mapping: windows.HANDLE,
+    desired_access: windows.DWORD,
+    offset_high: windows.DWORD,
+    offset_low: windows.DWORD,
+    bytes_to_map: windows.SIZE_T,
+) callconv(windows.WINAPI) ?*anyopaque;
+extern "kernel32" fn UnmapViewOfFile(base_address: *const anyopaque) callconv(windows.WINAPI) windows.BOOL;
+
+pub fn mapFile(file: std.fs.File, size: u64) ?[]align(std.heap.page_size_min) const u8 {
+    if (builtin.os.tag == .windows) {
+        // The view keeps the mapping object alive, so the handle can be closed right away.
+        const mapping_handle = CreateFileMappingW(file.handle, null, PAGE_READONLY, 0, 0, null) orelse return null;
+        defer windows.CloseHandle(mapping_handle);
+        const view = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0) orelse return null;
+        const bytes: [*]align(std.heap.page_size_min) const u8 = @ptrCast(@alignCast(view));
+        return bytes[0..size];
+    }
+
+    return std.posix.mmap(null, size, std.posix.PROT.READ, .{ .TYPE = .PRIVATE }, file.handle, 0) catch null;
+}
+
+pub fn unmapFile(mapping: []align(std.heap.page_size_min) const u8) void {
+    if (builtin.os.tag == .windows) {
+        _ = UnmapViewOfFile(mapping.ptr);
+        return;
+    }
+
+    std.posix.munmap(mapping);
+}
@@ -0,0 +1,138 @@
+const std = @import("std");
+const expect = std.testing.expect;
+
+// Bounded lock-free multi-producer, single-consumer ring.
+// Each cell carries a sequence number so producers only contend on the tail CAS,
+// and the consumer never touches shared state other than the cell it reads.
+pub fn MpscQueue(comptime QueueElement: type) type {
+    return struct {
+        const Self = @This();
+        const Cell = struct {
+            sequence: std.atomic.Value(usize),
+            value: QueueElement,
+        };
+
+        allocator: std.mem.Allocator,
+        cells: []Cell,
+        mask: usize,
+        tail: std.atomic.Value(usize) align(std.atomic.cache_line) = std.atomic.Value(usize).init(0),
+        head: usize align(std.atomic.cache_line) = 0,
+
+        pub fn create(allocator: std.mem.Allocator, capacity: u32) Self {
+            std.debug.assert(std.math.isPowerOfTwo(capacity));
+            const cells = allocator.alloc(Cell, capacity) catch unreachable;
+            for (cells, 0..) |*cell, i| {
+                cell.sequence = std.atomic.Value(usize).init(i);
+            }
+
+            return Self{
+                .allocator = allocator,
+                .cells = cells,
+                .mask = capacity - 1,
+            };
+        }
+
+        pub fn destroy(self: *Self) void {
+            self.allocator.free(self.cells);
+        }
+
+        // Returns false if the queue is full. Safe to call from any thread.
+        pub fn push(self: *Self, elem: QueueElement) bool {
+            var pos = self.tail.load(.monotonic);
+            while (true) {
+                const cell = &self.cells[pos & self.mask];
+                const sequence = cell.sequence.load(.acquire);
+                const diff: isize = @bitCast(sequence -% pos);
+                if (diff == 0) {
+                    if (self.tail.cmpxchgWeak(pos, pos + 1, .monotonic, .monotonic)) |actual| {
+                        pos = actual;
+                        continue;
+                    }
+
+                    cell.value = elem;
+                    cell.sequence.store(pos + 1, .release);
+                    return true;
+                }
+
+                if (diff < 0) {
+                    return false;
+                }
+
+                pos = self.tail.load(.monotonic);
+            }
+        }
+
+        // Must only be called from the consuming thread.
+        pub fn pop(self: *Self) ?QueueElement {
+            const cell = &self.cells[self.head & self.mask];
+            const sequence = cell.sequence.load(.acquire);
+            if (sequence != self.head + 1) {
+                return null;
+            }
+
+            const elem = cell.value;
+            cell.sequence.store(self.head + self.cells.len, .release);
+            self.head += 1;
+            return elem;
+        }
+    };
+}
+
+test "mpsc_queue" {
+    const MyQueue = MpscQueue(u32);
+    var queue = MyQueue.create(std.testing.allocator, 4);
+    defer queue.destroy();
+
+    try expect(queue.pop() == null);
+    try expect(queue.push(1));
+    try expect(queue.push(2));
+    try expect(queue.push(3));
+    try expect(queue.push(4));
+    try expect(!queue.push(5));
+
+    try expect(queue.pop().? == 1);
+    try expect(queue.pop().? == 2);
+    try expect(queue.push(5));
+    try expect(queue.pop().? == 3);
+    try expect(queue.pop().? == 4);
+    try expect(queue.pop().? == 5);
+    try expect(queue.pop() == null);
+}
+
+test "mpsc_queue_threads" {
+    const MyQueue = MpscQueue(u32);
+    var queue = MyQueue.create(std.testing.allocator, 1024);
+    defer queue.destroy();
+
+    const producer_count = 4;
+    const elems_per_producer = 10000;
+    const Producer = struct {
+        fn run(q: *MyQueue) void {
+            for (0..elems_per_producer) |i| {
+                while (!q.push(@intCast(i))) {
+                    std.Thread.yield() catch {};
+                }
+            }
+        }
+    };
+
+    var threads: [producer_count]std.Thread = undefined;
+    for (&threads) |*thread| {
+        thread.* = try std.Thread.spawn(.{}, Producer.run, .{&queue});
+    }
+
+    var sum: u64 = 0;
+    var received: u32 = 0;
+    while (received < producer_count * elems_per_producer) {
+        if (queue.pop()) |elem| {
+            sum += elem;
+            received += 1;
+        }
+    }
+
+    for (threads) |thread| {
+        thread.join();
+    }
+
+    try expect(sum == producer_count * (elems_per_producer * (elems_per_producer - 1) / 2));
+}
@@ -0,0 +1,340 @@
+const std = @import("std");
+const expect = std.testing.expect;
+
+// Two level segregated fit (TLSF) allocator for ranges of an index space, like the slots of a
+// GPU buffer. It only does the bookkeeping, the storage itself lives somewhere else.
+//
+// Free ranges are kept in 256 bins sized like tiny floats with 3 mantissa bits, so the ranges in
+// a bin are within 12.5% of each other. A bitmask of non-empty bins per level finds the first bin
+// that is large enough, which makes alloc and free O(1). Freed ranges merge with free neighbors
+// right away.
+//
+// Every range is a node linked to its neighbors in the index space and, while free, to the
+// other ranges in its bin.
+pub const RangeAllocator = struct {
+    pub const Allocation = struct {
+        offset: u32,
+        node: u32,
+    };
+
+    const mantissa_bits = 3;
+    const mantissa_value = 1 << mantissa_bits;
+    const mantissa_mask = mantissa_value - 1;
+    const top_bins_count = 32;
+    const leaf_bins_count = 8;
+    const bins_count = top_bins_count * leaf_bins_count;
+    const unused = std.math.maxInt(u32);
+
+    const Node = struct {
+        offset: u32,
+        size: u32,
+        used: bool = false,
+        bin_prev: u32 = unused,
+        bin_next: u32 = unused,
+        neighbor_prev: u32 = unused,
+        neighbor_next: u32 = unused,
+    };
+
+    allocator: std.mem.Allocator,
+    capacity: u32,
+    free_storage: u32 = 0,
+    allocation_count: u32 = 0,
+    high_water_mark: u32 = 0, // End of the highest range that was ever handed out
+    used_end: u32 = 0, // End of the highest range in use, shrinks again when the tail is freed
+    used_top_bins: u32 = 0,
+    used_leaf_bins: [top_bins_count]u8 = [_]u8{0} ** top_bins_count,
+    bin_heads: [bins_count]u32 = [_]u32{unused} ** bins_count,
+    nodes: std.ArrayListUnmanaged(Node) = .{},
+    free_nodes: std.ArrayListUnmanaged(u32) = .{},
+
+    pub fn create(allocator: std.mem.Allocator, capacity: u32) RangeAllocator {
+        var self = RangeAllocator{
+            .allocator = allocator,
+            .capacity = capacity,
+        };
+        if (capacity > 0) {
+            const node_index = self.newNode(.{ .offset = 0, .size = capacity });
+            self.addToBin(node_index);
+        }
+        return self;
+    }
+
+    pub fn destroy(self: *RangeAllocator) void {
+        self.nodes.deinit(self.allocator);
+        self.free_nodes.deinit(self.allocator);
+    }
+
+    // Returns null when there's no free range of size left.
+    pub fn alloc(self: *RangeAllocator, size: u32) ?Allocation {
+        std.debug.assert(size > 0);
+        const node_index = if (self.findFreeBin(binRoundUp(size))) |bin|
+            self.bin_heads[bin]
+        else
+            self.findInBin(binRoundDown(size), size) orelse return null;
+        self.removeFromBin(node_index);
+
+        const node = &self.nodes.items[node_index];
+        node.used = true;
+        const remainder = node.size - size;
+        if (remainder > 0) {
+            node.size = size;
+            const neighbor_next = node.neighbor_next;
+            const remainder_index = self.newNode(.{
+                .offset = node.offset + size,
+                .size = remainder,
+                .neighbor_prev = node_index,
+                .neighbor_next = neighbor_next,
+            });
+            if (neighbor_next != unused) {
+                self.nodes.items[neighbor_next].neighbor_prev = remainder_index;
+            }
+            self.nodes.items[node_index].neighbor_next = remainder_index;
+            self.addToBin(remainder_index);
+        }
+
+        const offset = self.nodes.items[node_index].offset;
+        self.allocation_count += 1;
+        self.high_water_mark = @max(self.high_water_mark, offset + size);
+        self.used_end = @max(self.used_end, offset + size);
+        return .{ .offset = offset, .node = node_index };
+    }
+
+    pub fn free(self: *RangeAllocator, allocation: Allocation) void {
+        const node = self.nodes.items[allocation.node];
+        std.debug.assert(node.used and node.offset == allocation.offset);
+        var offset = node.offset;
+        var size = node.size;
+        var neighbor_prev = node.neighbor_prev;
+        var neighbor_next = node.neighbor_next;
+
+        if (neighbor_prev != unused and !self.nodes.items[neighbor_prev].used) {
+            const prev_node = self.nodes.items[neighbor_prev];
+            self.removeFromBin(neighbor_prev);
+            self.releaseNode(neighbor_prev);
+            offset = prev_node.offset;
+            size += prev_node.size;
+            neighbor_prev = prev_node.neighbor_prev;
+        }
+        if (neighbor_next != unused and !self.nodes.items[neighbor_next].used) {
+            const next_node = self.nodes.items[neighbor_next];
+            self.removeFromBin(neighbor_next);
+            self.releaseNode(neighbor_next);
+            size += next_node.size;
+            neighbor_next = next_node.neighbor_next;
+        }
+
+        // The freed node becomes the merged range.
+        self.nodes.items[allocation.node] = .{
+            .offset = offset,
+            .size = size,
+            .neighbor_prev = neighbor_prev,
+            .neighbor_next = neighbor_next,
+        };
+        if (neighbor_prev != unused) {
+            self.nodes.items[neighbor_prev].neighbor_next = allocation.node;
+        }
+        if (neighbor_next != unused) {
+            self.nodes.items[neighbor_next].neighbor_prev = allocation.node;
+        }
+        self.addToBin(allocation.node);
+        self.allocation_count -= 1;
+
+        // The ranges cover the whole capacity, so a free range without a next neighbor is the
+        // tail and everything in use ends where it starts.
+        if (neighbor_next == unused) {
+            self.used_end = offset;
+        }
+    }
+
+    pub fn allocationSize(self: RangeAllocator, allocation: Allocation) u32 {
+        return self.nodes.items[allocation.node].size;
+    }
+
+    // Walks the ranges of the largest non-empty bin, meant for stats.
+    pub fn largestFreeRange(self: RangeAllocator) u32 {
+        if (self.used_top_bins == 0) {
+            return 0;
+        }
+        const top: u32 = 31 - @clz(self.used_top_bins);
+        const leaf: u32 = 7 - @clz(self.used_leaf_bins[top]);
+        var largest: u32 = 0;
+        var node_index = self.bin_heads[top * leaf_bins_count + leaf];
+        while (node_index != unused) : (node_index = self.nodes.items[node_index].bin_next) {
+            largest = @max(largest, self.nodes.items[node_index].size);
+        }
+        return largest;
+    }
+
+    // 0 when all the free space is one range, towards 1 the more it's split up.
+    pub fn fragmentation(self: RangeAllocator) f32 {
+        if (self.free_storage == 0) {
+            return 0;
+        }
+        const largest: f32 = @floatFromInt(self.largestFreeRange());
+        return 1 - largest / @as(f32, @floatFromInt(self.free_storage));
+    }
+
+    fn findFreeBin(self: RangeAllocator, min_bin: u32) ?u32 {
+        const top = min_bin / leaf_bins_count;
+        if (top >= top_bins_count) {
+            return null;
+        }
+
+        // A large enough range in the same top bin.
+        const leaf: u3 = @intCast(min_bin % leaf_bins_count);
+        const leaf_mask = self.used_leaf_bins[top] & (@as(u8, 0xff) << leaf);
+        if (leaf_mask != 0) {
+            return top * leaf_bins_count + @ctz(leaf_mask);
+        }
+
+        // Otherwise the smallest range of a larger top bin.
+        if (top + 1 == top_bins_count) {
+            return null;
+        }
+        const top_mask = self.used_top_bins & (@as(u32, 0xffffffff) << @intCast(top + 1));
+        if (top_mask == 0) {
+            return null;
+        }
+        const larger_top: u32 = @ctz(top_mask);
+        return larger_top * leaf_bins_count + @ctz(self.used_leaf_bins[larger_top]);
+    }
+
+    // The ranges in the bin size rounds down to can still be large enough, this finds those
+    // when every larger bin is empty. Only happens close to full.
+    fn findInBin(self: RangeAllocator, bin: u32, size: u32) ?u32 {
+        var node_index = self.bin_heads[bin];
+        while (node_index != unused) : (node_index = self.nodes.items[node_index].bin_next) {
+            if (self.nodes.items[node_index].size >= size) {
+                return node_index;
+            }
+        }
+        return null;
+    }
+
+    fn addToBin(self: *RangeAllocator, node_index: u32) void {
+        const node = &self.nodes.items[node_index];
+        const bin = binRoundDown(node.size);
+        const top = bin / leaf_bins_count;
+        const leaf: u3 = @intCast(bin % leaf_bins_count);
+
+        node.bin_prev = unused;
+        node.bin_next = self.bin_heads[bin];
+        if (node.bin_next != unused) {
+            self.nodes.items[node.bin_next].bin_prev = node_index;
+        }
+        self.bin_heads[bin] = node_index;
+        self.used_leaf_bins[top] |= @as(u8, 1) << leaf;
+        self.used_top_bins |= @as(u32, 1) << @intCast(top);
+        self.free_storage += node.size;
+    }
+
+    fn removeFromBin(self: *RangeAllocator, node_index: u32) void {
+        const node = self.nodes.items[node_index];
+        const bin = binRoundDown(node.size);
+        if (node.bin_prev != unused) {
+            self.nodes.items[node.bin_prev].bin_next = node.bin_next;
+        } else {
+            self.bin_heads[bin] = node.bin_next;
+        }
+        if (node.bin_next != unused) {
+            self.nodes.items[node.bin_next].bin_prev = node.bin_prev;
+        }
+
+        if (self.bin_heads[bin] == unused) {
+            const top = bin / leaf_bins_count;
+            const leaf: u3 = @intCast(bin % leaf_bins_count);
+            self.used_leaf_bins[top] &= ~(@as(u8, 1) << leaf);
+            if (self.used_leaf_bins[top] == 0) {
+                self.used_top_bins &= ~(@as(u32, 1) << @intCast(top));
+            }
+        }
+        self.free_storage -= node.size;
+    }
+
+    fn newNode(self: *RangeAllocator, node: Node) u32 {
+        if (self.free_nodes.pop()) |node_index| {
+            self.nodes.items[node_index] = node;
+            return node_index;
+        }
+        self.nodes.append(self.allocator, node) catch unreachable;
+        return @intCast(self.nodes.items.len - 1);
+    }
+
+    fn releaseNode(self: *RangeAllocator, node_index: u32) void {
+        self.free_nodes.append(self.allocator, node_index) catch unreachable;
+    }
+
+    // Bin of the smallest ranges that are all at least size long.
+    fn binRoundUp(size: u32) u32 {
+        if (size < mantissa_value) {
+            return size;
+        }
+        const mantissa_start_bit: u5 = @intCast(31 - @clz(size) - mantissa_bits);
+        const exponent = @as(u32, mantissa_start_bit) + 1;
+        var mantissa = (size >> mantissa_start_bit) & mantissa_mask;
+        const low_bits_mask = (@as(u32, 1) << mantissa_start_bit) - 1;
+        if (size & low_bits_mask != 0) {
+            mantissa += 1; // Carries over into the exponent when the mantissa overflows
+        }
+        return (exponent << mantissa_bits) + mantissa;
+    }
+
+    // Bin a range of size is stored in.
+    fn binRoundDown(size: u32) u32 {
+        if (size < mantissa_value) {
+            return size;
+        }
+        const mantissa_start_bit: u5 = @intCast(31 - @clz(size) - mantissa_bits);
+        const exponent = @as(u32, mantissa_start_bit) + 1;
+        const mantissa = (size >> mantissa_start_bit) & mantissa_mask;
+        return (exponent << mantissa_bits) + mantissa;
+    }
+};
+
+test "range_allocator" {
+    var ranges = RangeAllocator.create(std.testing.allocator, 100);
+    defer ranges.destroy();
+
+    const a = ranges.alloc(10).?;
+    const b = ranges.alloc(10).?;
+    const c = ranges.alloc(10).?;
+    try expect(a.offset == 0 and b.offset == 10 and c.offset == 20);
+    try expect(ranges.free_storage == 70);
+    try expect(ranges.high_water_mark == 30);
+    try expect(ranges.used_end == 30);
+
+    // The hole in the middle is the best fit.
+    ranges.free(b);
+    try expect(ranges.largestFreeRange() == 70);
+    try expect(ranges.fragmentation() > 0);
+    const d = ranges.alloc(5).?;
+    try expect(d.offset == 10);
+    try expect(ranges.alloc(71) == null);
+
+    // Freeing the last range pulls the used end back to the one below it.
+    ranges.free(c);
+    try expect(ranges.used_end == 15);
+    try expect(ranges.high_water_mark == 30);
+
+    // Freeing merges with both neighbors.
+    ranges.free(a);
+    try expect(ranges.used_end == 15);
+    ranges.free(d);
+    try expect(ranges.allocation_count == 0);
+    try expect(ranges.used_end == 0);
+    try expect(ranges.free_storage == 100);
+    try expect(ranges.largestFreeRange() == 100);
+    try expect(ranges.fragmentation() == 0);
+
+    const all = ranges.alloc(100).?;
+    try expect(all.offset == 0);
+    try expect(ranges.alloc(1) == null);
+    ranges.free(all);
+
+    // Every size lands in a bin that fits it.
+    var size: u32 = 1;
+    while (size < 1 << 30) : (size = size * 3 / 2 + 1) {
+        try expect(RangeAllocator.binRoundUp(size) >= RangeAllocator.binRoundDown(size));
+        try expect(RangeAllocator.binRoundUp(size) < RangeAllocator.bins_count);
+    }
+}
@@ -0,0 +1,318 @@
+const std = @import("std");
+const expect = std.testing.expect;
+
+// Uniform grid over the xz plane, only cells that hold something are allocated.
+//
+// Meant to be kept up to date incrementally: call insertOrUpdate with an element's current
+// position whenever it may have moved, which only touches the cell lists when it crossed into
+// another cell. A side table maps every element to its cell and slot, so update and remove
+// are O(1).
+//
+// Radius queries visit the cells overlapping the circle, or when the circle covers more cells
+// than are occupied, just the occupied ones. Elements must be unique within the grid.
+pub fn SpatialHashGrid(comptime Element: type) type {
+    return struct {
+        const Self = @This();
+        pub const max_nearest = 32;
+
+        pub const CellKey = struct {
+            x: i32,
+            z: i32,
+        };
+
+        const Entry = struct {
+            elem: Element,
+            x: f32,
+            z: f32,
+        };
+
+        const Cell = std.ArrayListUnmanaged(Entry);
+
+        const Location = struct {
+            cell: CellKey,
+            index: u32,
+        };
+
+        allocator: std.mem.Allocator,
+        cell_size: f32,
+        inv_cell_size: f32,
+        cells: std.AutoHashMapUnmanaged(CellKey, Cell) = .{},
+        locations: std.AutoHashMapUnmanaged(Element, Location) = .{},
+
+        pub fn create(allocator: std.mem.Allocator, cell_size: f32) Self {
+            std.debug.assert(cell_size > 0);
+            return .{
+                .allocator = allocator,
+                .cell_size = cell_size,
+                .inv_cell_size = 1 / cell_size,
+            };
+        }
+
+        pub fn destroy(self: *Self) void {
+            var cell_it = self.cells.valueIterator();
+            while (cell_it.next()) |cell| {
+                cell.deinit(self.allocator);
+            }
+            self.cells.deinit(self.allocator);
+            self.locations.deinit(self.allocator);
+        }
+
+        pub fn count(self: Self) u32 {
+            return self.locations.count();
+        }
+
+        pub fn occupiedCellCount(self: Self) u32 {
+            return self.cells.count();
+        }
+
+        pub fn cellKey(self: Self, x: f32, z: f32) CellKey {
+            return .{
+                .x = @intFromFloat(@floor(x * self.inv_cell_size)),
+                .z = @intFromFloat(@floor(z * self.inv_cell_size)),
+            };
+        }
+
+        // Number of elements in the cell containing x, z.
+        pub fn cellCount(self: Self, x: f32, z: f32) u32 {
+            const cell = self.cells.getPtr(self.cellKey(x, z)) orelse return 0;
+            return @intCast(cell.items.len);
+        }
+
+        pub fn contains(self: Self, elem: Element) bool {
+            return self.locations.contains(elem);
+        }
+
+        pub fn insertOrUpdate(self: *Self, elem: Element, x: f32, z: f32) void {
+            const key = self.cellKey(x, z);
+            const location_result = self.locations.getOrPut(self.allocator, elem) catch unreachable;
+            if (location_result.found_existing) {
+                const location = location_result.value_ptr.*;
+                if (location.cell.x == key.x and location.cell.z == key.z) {
+                    const entry = &self.cells.getPtr(key).?.items[location.index];
+                    entry.x = x;
+                    entry.z = z;
+                    return;
+                }
+                self.removeFromCell(location);
+            }
+
+            const cell_result = self.cells.getOrPut(self.allocator, key) catch unreachable;
+            if (!cell_result.found_existing) {
+                cell_result.value_ptr.* = .{};
+            }
+            const cell = cell_result.value_ptr;
+            location_result.value_ptr.* = .{ .cell = key, .index = @intCast(cell.items.len) };
+            cell.append(self.allocator, .{ .elem = elem, .x = x, .z = z }) catch unreachable;
+        }
+
+        pub fn remove(self: *Self, elem: Element) bool {
+            const location = (self.locations.fetchRemove(elem) orelse return false).value;
+            self.removeFromCell(location);
+            return true;
+        }
+
+        // Appends every element within radius of x, z to out, in no particular order.
+        pub fn queryRadius(self: Self, x: f32, z: f32, radius: f32, out: *std.ArrayList(Element)) void {
+            const Collector = struct {
+                out: *std.ArrayList(Element),
+                fn visit(collector: @This(), elem: Element) bool {
+                    collector.out.append(elem) catch unreachable;
+                    return true;
+                }
+            };
+            self.visitRadius(x, z, radius, Collector{ .out = out });
+        }
+
+        pub fn anyWithinRadius(self: Self, x: f32, z: f32, radius: f32) bool {
+            const Finder = struct {
+                found: *bool,
+                fn visit(finder: @This(), elem: Element) bool {
+                    _ = elem;
+                    finder.found.* = true;
+                    return false;
+                }
+            };
+            var found = false;
+            self.visitRadius(x, z, radius, Finder{ .found = &found });
+            return found;
+        }
+
+        // Fills out with up to out.len elements within max_radius, nearest first.
+        pub fn queryNearest(self: Self, x: f32, z: f32, max_radius: f32, out: []Element) u32 {
+            std.debug.assert(out.len <= max_nearest);
+            if (out.len == 0) {
+                return 0;
+            }
+            var dists_sq: [max_nearest]f32 = undefined;
+            var found: u32 = 0;
+            const max_radius_sq = max_radius * max_radius;
+            const center = self.cellKey(x, z);
+
+            // Rings of cells around the center, anything in ring r is at least r - 1 cells away.
+            var ring: i32 = 0;
+            var rings_without_cells: u32 = 0;
+            while (true) : (ring += 1) {
+                const ring_min_dist = @as(f32, @floatFromInt(@max(ring - 1, 0))) * self.cell_size;
+                if (ring_min_dist > max_radius) {
+                    break;
+                }
+                if (found == out.len and ring_min_dist * ring_min_dist > dists_sq[found - 1]) {
+                    break;
+                }
+                // Past this point all the occupied cells have been looked at.
+                if (rings_without_cells > 0 and @as(u64, @intCast(ring)) * @as(u64, @intCast(ring)) > self.cells.count() * 4) {
+                    if (self.ringsCoverAllCells(center, ring - 1)) {
+                        break;
+                    }
+                }
+
+                var any_cell = false;
+                var cell_z = center.z - ring;
+                while (cell_z <= center.z + ring) : (cell_z += 1) {
+                    const is_edge_row = cell_z == center.z - ring or cell_z == center.z + ring;
+                    const step: i32 = if (is_edge_row or ring == 0) 1 else ring * 2;
+                    var cell_x = center.x - ring;
+                    while (cell_x <= center.x + ring) : (cell_x += step) {
+                        const cell = self.cells.getPtr(.{ .x = cell_x, .z = cell_z }) orelse continue;
+                        any_cell = true;
+                        for (cell.items) |entry| {
+                            const dx = entry.x - x;
+                            const dz = entry.z - z;
+                            const dist_sq = dx * dx + dz * dz;
+                            if (dist_sq > max_radius_sq) {
+                                continue;
+                            }
+                            if (found == out.len and dist_sq >= dists_sq[found - 1]) {
+                                continue;
+                            }
+                            // Insertion sort, out is tiny.
+                            var i: u32 = if (found == out.len) found - 1 else found;
+                            while (i > 0 and dists_sq[i - 1] > dist_sq) : (i -= 1) {
+                                dists_sq[i] = dists_sq[i - 1];
+                                out[i] = out[i - 1];
+                            }
+                            dists_sq[i] = dist_sq;
+                            out[i] = entry.elem;
+                            found = @min(found + 1, @as(u32, @intCast(out.len)));
+                        }
+                    }
+                }
+                rings_without_cells = if (any_cell) 0 else rings_without_cells + 1;
+            }
+            return found;
+        }
+
+        fn ringsCoverAllCells(self: Self, center: CellKey, ring: i32) bool {
+            var cell_it = self.cells.keyIterator();
+            while (cell_it.next()) |key| {
+                if (@abs(key.x - center.x) > ring or @abs(key.z - center.z) > ring) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // visitor.visit(elem) returns false to stop early.
+        fn visitRadius(self: Self, x: f32, z: f32, radius: f32, visitor: anytype) void {
+            const radius_sq = radius * radius;
+            const min = self.cellKey(x - radius, z - radius);
+            const max = self.cellKey(x + radius, z + radius);
+            const range_cell_count = @as(u64, @intCast(max.x - min.x + 1)) * @as(u64, @intCast(max.z - min.z + 1));
+
+            if (range_cell_count > self.cells.count()) {
+                var cell_it = self.cells.iterator();
+                while (cell_it.next()) |kv| {
+                    const key = kv.key_ptr.*;
+                    if (key.x < min.x or key.x > max.x or key.z < min.z or key.z > max.z) {
+                        continue;
+                    }
+                    if (!visitEntries(kv.value_ptr.items, x, z, radius_sq, visitor)) {
+                        return;
+                    }
+                }
+                return;
+            }
+
+            var cell_z = min.z;
+            while (cell_z <= max.z) : (cell_z += 1) {
+                var cell_x = min.x;
+                while (cell_x <= max.x) : (cell_x += 1) {
+                    const cell = self.cells.getPtr(.{ .x = cell_x, .z = cell_z }) orelse continue;
+                    if (!visitEntries(cell.items, x, z, radius_sq, visitor)) {
+                        return;
+                    }
+                }
+            }
+        }
+
+        fn visitEntries(entries: []const Entry, x: f32, z: f32, radius_sq: f32, visitor: anytype) bool {
+            for (entries) |entry| {
+                const dx = entry.x - x;
+                const dz = entry.z - z;
+                if (dx * dx + dz * dz <= radius_sq and !visitor.visit(entry.elem)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        fn removeFromCell(self: *Self, location: Location) void {
+            const cell = self.cells.getPtr(location.cell).?;
+            _ = cell.swapRemove(location.index);
+            if (location.index < cell.items.len) {
+                self.locations.getPtr(cell.items[location.index].elem).?.index = location.index;
+            }
+            if (cell.items.len == 0) {
+                cell.deinit(self.allocator);
+                _ = self.cells.remove(location.cell);
+            }
+        }
+    };
+}
+
+test "spatial_hash_grid" {
+    var grid = SpatialHashGrid(u32).create(std.testing.allocator, 10);
+    defer grid.destroy();
+
+    grid.insertOrUpdate(1, 1, 1);
+    grid.insertOrUpdate(2, 5, 5);
+    grid.insertOrUpdate(3, 25, 5);
+    grid.insertOrUpdate(4, -15, -15);
+    try expect(grid.count() == 4);
+    try expect(grid.occupiedCellCount() == 3);
+    try expect(grid.cellCount(0, 0) == 2);
+    try expect(grid.cellCount(-11, -11) == 1);
+
+    var found = std.ArrayList(u32).init(std.testing.allocator);
+    defer found.deinit();
+    grid.queryRadius(0, 0, 8, &found);
+    std.mem.sort(u32, found.items, {}, std.sort.asc(u32));
+    try expect(std.mem.eql(u32, found.items, &.{ 1, 2 }));
+
+    // Moving within a cell and across cells.
+    grid.insertOrUpdate(1, 2, 2);
+    try expect(grid.cellCount(0, 0) == 2);
+    grid.insertOrUpdate(1, 22, 2);
+    try expect(grid.cellCount(0, 0) == 1);
+    try expect(grid.cellCount(20, 0) == 2);
+    try expect(grid.anyWithinRadius(24, 4, 2));
+    try expect(!grid.anyWithinRadius(100, 100, 50));
+
+    // A radius covering many more cells than are occupied takes the other path.
+    found.clearRetainingCapacity();
+    grid.queryRadius(0, 0, 1000, &found);
+    try expect(found.items.len == 4);
+
+    var nearest: [3]u32 = undefined;
+    try expect(grid.queryNearest(0, 0, 1000, &nearest) == 3);
+    try expect(std.mem.eql(u32, &nearest, &.{ 2, 4, 1 }));
+    try expect(grid.queryNearest(0, 0, 10, &nearest) == 1);
+    try expect(nearest[0] == 2);
+
+    try expect(grid.remove(2));
+    try expect(!grid.remove(2));
+    try expect(grid.cellCount(0, 0) == 0);
+    try expect(grid.occupiedCellCount() == 2);
+    try expect(grid.queryNearest(0, 0, 1000, &nearest) == 3);
+    try expect(std.mem.eql(u32, &nearest, &.{ 4, 1, 3 }));
+}
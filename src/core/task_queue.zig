@@ -1,6 +1,7 @@
 const std = @import("std");
 const zpool = @import("zpool");
 const IdLocal = @import("core.zig").IdLocal;
+const TimerWheel = @import("timer_wheel.zig").TimerWheel;
 
 const context = @import("context.zig");
 const ecsu = @import("../flecs_util/flecs_util.zig");
@@ -57,176 +58,164 @@ pub const TaskType = struct {
     apply: *const TaskFunc,
 };
 
+pub const TaskTypeIndex = u16;
+
 const Task = struct {
-    id: IdLocal,
+    type_index: TaskTypeIndex,
     data: []u8,
-
-    time_info: TaskTimeInfo, // TODO: Move to parallell array(s) / pool
+    time_info: TaskTimeInfo,
 };
 
-pub const TaskQueue = struct {
-    const ArrayChunk = struct {
-        start_time: f64 = undefined,
-        tasks: [chunk_size]Task = undefined,
-        count: u8 = 0,
+// Free lists per power of two size class carved out of an arena, so task payloads don't
+// hit the heap allocator on every enqueue. Memory is only returned on destroy.
+// Main thread only, like setup and apply.
+const TaskDataPool = struct {
+    const min_size_log2 = 3;
+    const max_size_log2 = 8;
+    pub const max_size = 1 << max_size_log2;
+    pub const alignment = 16;
+
+    const FreeBlock = struct {
+        next: ?*FreeBlock,
     };
 
-    const chunk_size = 256;
+    arena: std.heap.ArenaAllocator,
+    free_lists: [max_size_log2 - min_size_log2 + 1]?*FreeBlock = .{null} ** (max_size_log2 - min_size_log2 + 1),
+
+    fn sizeClass(size: usize) usize {
+        const size_log2 = std.math.log2_int_ceil(usize, @max(size, 1 << min_size_log2));
+        return size_log2 - min_size_log2;
+    }
+
+    fn alloc(self: *TaskDataPool, size: usize) []u8 {
+        std.debug.assert(size <= max_size);
+        const class = sizeClass(size);
+        if (self.free_lists[class]) |block| {
+            self.free_lists[class] = block.next;
+            const bytes: [*]u8 = @ptrCast(block);
+            return bytes[0..size];
+        }
+
+        const block_size = @as(usize, 1) << @intCast(class + min_size_log2);
+        const bytes = self.arena.allocator().alignedAlloc(u8, alignment, block_size) catch unreachable;
+        return bytes[0..size];
+    }
+
+    fn free(self: *TaskDataPool, data: []u8) void {
+        const class = sizeClass(data.len);
+        const block: *FreeBlock = @ptrCast(@alignCast(data.ptr));
+        block.next = self.free_lists[class];
+        self.free_lists[class] = block;
+    }
+};
+
+// Delayed tasks wait in a timer wheel. Each frame the due ones go through
+// setup (main thread), calculate (spread over the workers, if any) and validate + apply (main thread).
+//
+// NOTE: calculate must not touch the ECS world, enqueue or allocate task data since it may run on a worker.
+pub const TaskQueue = struct {
+    const tick_seconds = 1.0 / 16.0;
+    const calculate_batch_size = 64;
 
-    // TODO: Poolify
     allocator: std.mem.Allocator,
     ctx: TaskContext,
 
-    queued_chunks: std.ArrayListUnmanaged(*ArrayChunk),
-    free_chunks: std.ArrayListUnmanaged(*ArrayChunk),
+    wheel: TimerWheel(Task),
+    data_pool: TaskDataPool,
     tasks_to_setup: std.ArrayListUnmanaged(Task),
     tasks_to_calculate: std.ArrayListUnmanaged(Task),
     tasks_to_apply: std.ArrayListUnmanaged(Task),
 
-    task_types: std.AutoArrayHashMapUnmanaged(IdLocal.HashType, TaskType),
+    task_types: std.ArrayListUnmanaged(TaskType),
+    task_type_indices: std.AutoHashMapUnmanaged(IdLocal.HashType, TaskTypeIndex),
+
+    workers: ?*std.Thread.Pool,
+    worker_count: u32,
+    calculate_next: std.atomic.Value(usize),
 
     pub fn init(self: *TaskQueue, allocator: std.mem.Allocator, ctx: anytype) void {
-        self.allocator = allocator;
-        self.queued_chunks = .{};
-        self.free_chunks = .{};
-        self.ctx = TaskContext.view(ctx);
-
-        self.queued_chunks = std.ArrayListUnmanaged(*ArrayChunk).initCapacity(allocator, 8) catch unreachable; // low for now
-        self.free_chunks = std.ArrayListUnmanaged(*ArrayChunk).initCapacity(allocator, 8) catch unreachable; // low for now
-        self.tasks_to_setup = std.ArrayListUnmanaged(Task).initCapacity(allocator, 8) catch unreachable; // low for now
-        self.tasks_to_calculate = std.ArrayListUnmanaged(Task).initCapacity(allocator, 8) catch unreachable; // low for now
-        self.tasks_to_apply = std.ArrayListUnmanaged(Task).initCapacity(allocator, 8) catch unreachable; // low for now
-        self.task_types = std.AutoArrayHashMapUnmanaged(IdLocal.HashType, TaskType).init(allocator, &.{}, &.{}) catch unreachable; // low for now
+        self.* = .{
+            .allocator = allocator,
+            .ctx = TaskContext.view(ctx),
+            .wheel = TimerWheel(Task).init(allocator, tick_seconds),
+            .data_pool = .{ .arena = std.heap.ArenaAllocator.init(allocator) },
+            .tasks_to_setup = .{},
+            .tasks_to_calculate = .{},
+            .tasks_to_apply = .{},
+            .task_types = .{},
+            .task_type_indices = .{},
+            .workers = null,
+            .worker_count = 0,
+            .calculate_next = std.atomic.Value(usize).init(0),
+        };
     }
 
     pub fn destroy(self: *TaskQueue) void {
-        for (self.queued_chunks.items) |chunk| {
-            for (chunk.tasks[0..chunk.count]) |task| {
-                self.allocator.free(@as([]align(8) u8, @alignCast(task.data)));
-            }
-            self.allocator.destroy(chunk);
-        }
-        for (self.free_chunks.items) |chunk| {
-            for (chunk.tasks[0..chunk.count]) |task| {
-                self.allocator.free(@as([]align(8) u8, @alignCast(task.data)));
-            }
-            self.allocator.destroy(chunk);
-        }
-        for (self.tasks_to_setup.items) |task| {
-            self.allocator.free(@as([]align(8) u8, @alignCast(task.data)));
-        }
-        for (self.tasks_to_calculate.items) |task| {
-            self.allocator.free(@as([]align(8) u8, @alignCast(task.data)));
-        }
-        for (self.tasks_to_apply.items) |task| {
-            self.allocator.free(@as([]align(8) u8, @alignCast(task.data)));
-        }
-        self.queued_chunks.deinit(self.allocator);
-        self.free_chunks.deinit(self.allocator);
+        // All task data lives in the pool's arena.
+        self.data_pool.arena.deinit();
+        self.wheel.deinit();
         self.tasks_to_setup.deinit(self.allocator);
         self.tasks_to_calculate.deinit(self.allocator);
         self.tasks_to_apply.deinit(self.allocator);
         self.task_types.deinit(self.allocator);
+        self.task_type_indices.deinit(self.allocator);
+    }
+
+    // Spreads calculate over a borrowed pool, the job system's frame pool in the game.
+    // calculateTasks waits for its batches, so the pool only has to outlive the queue's use of it.
+    pub fn useWorkers(self: *TaskQueue, workers: *std.Thread.Pool) void {
+        std.debug.assert(self.workers == null);
+        if (workers.threads.len == 0) {
+            return;
+        }
+
+        self.workers = workers;
+        self.worker_count = @intCast(workers.threads.len);
     }
 
     pub fn registerTaskType(self: *TaskQueue, task_type: TaskType) void {
-        self.task_types.put(self.allocator, task_type.id.hash, task_type) catch unreachable;
+        const result = self.task_type_indices.getOrPut(self.allocator, task_type.id.hash) catch unreachable;
+        if (result.found_existing) {
+            self.task_types.items[result.value_ptr.*] = task_type;
+            return;
+        }
+
+        result.value_ptr.* = @intCast(self.task_types.items.len);
+        self.task_types.append(self.allocator, task_type) catch unreachable;
     }
 
     pub fn allocateTaskData(self: *TaskQueue, time: f64, comptime TaskDataType: type) *TaskDataType {
         _ = time; // autofix
+        if (@sizeOf(TaskDataType) > TaskDataPool.max_size or @alignOf(TaskDataType) > TaskDataPool.alignment) {
+            @compileError("Task data too big for the task data pool: " ++ @typeName(TaskDataType));
+        }
 
-        const task_data = self.allocator.create(TaskDataType) catch unreachable;
-        return task_data;
+        const task_data = self.data_pool.alloc(@sizeOf(TaskDataType));
+        return @ptrCast(@alignCast(task_data.ptr));
     }
 
     pub fn enqueue(self: *TaskQueue, id: IdLocal, time_info: TaskTimeInfo, task_data: []u8) void {
-        const chunk = blk: {
-            for (self.queued_chunks.items) |chunk| {
-                if (chunk.start_time < time_info.time) {
-                    break :blk chunk;
-                }
-            } else {
-                const chunk = self.grabFreeChunk();
-                self.queued_chunks.append(self.allocator, chunk) catch unreachable;
-                break :blk chunk;
-            }
-        };
-
-        var insert_chunk = chunk;
-        if (chunk.count == chunk_size) {
-            // split chunk into two chunks, lc and rc, down middle
-            const lc = chunk; // left chunk
-            const rc = self.grabFreeChunk(); // right chunk
-            for (chunk_size / 2..chunk_size, 0..chunk_size / 2) |i_lc, i_rc| {
-                // TODO: memcpy
-                rc[i_rc] = lc[i_lc];
-            }
-
-            lc.count = chunk_size / 2;
-            rc.count = chunk_size / 2;
-            rc.start_time = rc.tasks[0].time;
-
-            // TODO: Insert at right place
-            std.debug.assert(false);
-
-            insert_chunk = if (rc.start_time < time_info.time) rc else lc;
-        }
-
-        var task_index = insert_chunk.count;
-        for (0..insert_chunk.count) |i_c| {
-            const task = &insert_chunk.tasks[i_c];
-            if (task.time_info.time > time_info.time) {
-                std.mem.copyBackwards(Task, insert_chunk.tasks[i_c + 1 .. insert_chunk.count + 1], insert_chunk.tasks[i_c..insert_chunk.count]);
-                task_index = @intCast(i_c);
-                break;
-            }
-        }
+        const type_index = self.task_type_indices.get(id.hash).?;
+        self.enqueueIndexed(type_index, time_info, task_data);
+    }
 
-        const task = &insert_chunk.tasks[task_index];
-        task.* = .{
-            .time_info = time_info,
+    fn enqueueIndexed(self: *TaskQueue, type_index: TaskTypeIndex, time_info: TaskTimeInfo, task_data: []u8) void {
+        self.wheel.insert(time_info.time, .{
+            .type_index = type_index,
             .data = task_data,
-            .id = id,
-        };
-
-        insert_chunk.count += 1;
+            .time_info = time_info,
+        });
     }
 
     pub fn findTasksToSetup(self: *TaskQueue, time: f64) void {
-        for (self.queued_chunks.items) |chunk| {
-            var found_tasks_to_setup: u8 = 0;
-            for (chunk.tasks[0..chunk.count]) |task| {
-                if (task.time_info.time > time) {
-                    break;
-                }
-
-                found_tasks_to_setup += 1;
-                self.tasks_to_setup.append(self.allocator, task) catch unreachable;
-            }
-
-            if (found_tasks_to_setup == 0) {
-                break;
-            }
-
-            const new_count = chunk.count - found_tasks_to_setup;
-            if (new_count != 0) {
-                std.mem.copyForwards(Task, chunk.tasks[0..new_count], chunk.tasks[found_tasks_to_setup..chunk.count]);
-            }
-            chunk.count = new_count;
-        }
-
-        while (self.queued_chunks.items.len > 0 and self.queued_chunks.items[0].count == 0) {
-            self.free_chunks.append(self.allocator, self.queued_chunks.items[0]) catch unreachable;
-            _ = self.queued_chunks.orderedRemove(0);
-        }
+        self.wheel.advance(time, &self.tasks_to_setup);
     }
 
     pub fn setupTasks(self: *TaskQueue) void {
         self.tasks_to_calculate.appendSlice(self.allocator, self.tasks_to_setup.items) catch unreachable;
 
         for (self.tasks_to_setup.items) |*task| {
-            const task_type = self.task_types.get(task.id.hash).?;
+            const task_type = &self.task_types.items[task.type_index];
             const allocator = self.ctx.heap_allocator; // temp
             task_type.setup(self.ctx, task.data, allocator);
         }
@@ -234,19 +223,51 @@ pub const TaskQueue = struct {
     }
 
     pub fn calculateTasks(self: *TaskQueue) void {
-        for (self.tasks_to_calculate.items) |*task| {
-            const task_type = self.task_types.get(task.id.hash).?;
-            const allocator = self.ctx.heap_allocator; // temp
-            task_type.calculate(self.ctx, task.data, allocator);
+        const task_count = self.tasks_to_calculate.items.len;
+        const batch_count = std.math.divCeil(usize, task_count, calculate_batch_size) catch unreachable;
+        if (self.workers != null and batch_count > 1) {
+            // The main thread works through batches too, so one batch fewer helpers is enough.
+            self.calculate_next.store(0, .monotonic);
+            var wait_group: std.Thread.WaitGroup = .{};
+            for (0..@min(self.worker_count, batch_count - 1)) |_| {
+                self.workers.?.spawnWg(&wait_group, calculateBatches, .{self});
+            }
+            self.calculateBatches();
+            self.workers.?.waitAndWork(&wait_group);
+        } else {
+            for (self.tasks_to_calculate.items) |*task| {
+                const task_type = &self.task_types.items[task.type_index];
+                const allocator = self.ctx.heap_allocator; // temp
+                task_type.calculate(self.ctx, task.data, allocator);
+            }
         }
 
         self.tasks_to_apply.appendSlice(self.allocator, self.tasks_to_calculate.items) catch unreachable;
         self.tasks_to_calculate.clearRetainingCapacity();
     }
 
+    // Threads grab batches off a shared counter until there are none left, so a thread
+    // that finishes early keeps taking work from the slower ones.
+    fn calculateBatches(self: *TaskQueue) void {
+        const tasks = self.tasks_to_calculate.items;
+        while (true) {
+            const batch_start = self.calculate_next.fetchAdd(calculate_batch_size, .monotonic);
+            if (batch_start >= tasks.len) {
+                return;
+            }
+
+            const batch_end = @min(batch_start + calculate_batch_size, tasks.len);
+            for (tasks[batch_start..batch_end]) |*task| {
+                const task_type = &self.task_types.items[task.type_index];
+                const allocator = self.ctx.heap_allocator; // temp
+                task_type.calculate(self.ctx, task.data, allocator);
+            }
+        }
+    }
+
     pub fn applyTasks(self: *TaskQueue) void {
         for (self.tasks_to_apply.items) |*task| {
-            const task_type = self.task_types.get(task.id.hash).?;
+            const task_type = &self.task_types.items[task.type_index];
             const allocator = self.ctx.heap_allocator; // temp
 
             const validity = task_type.validate(self.ctx, task.data, allocator);
@@ -262,35 +283,22 @@ pub const TaskQueue = struct {
 
             switch (task.time_info.loop_type) {
                 .once => {
-                    // _ = self.tasks_to_setup.swapRemove(i_task);
-                    self.allocator.free(@as([]align(8) u8, @alignCast(task.data)));
+                    self.data_pool.free(task.data);
                 },
                 .loop => {
                     const next_time = task.time_info.time + task.time_info.loop_type.loop;
-                    self.enqueue(
-                        task.id,
+                    self.enqueueIndexed(
+                        task.type_index,
                         .{
                             .time = next_time,
                             .loop_type = task.time_info.loop_type,
                         },
-                        task.data, // LOL FIX
+                        task.data,
                     );
-                    // _ = self.tasks_to_setup.swapRemove(i_task);
                 },
             }
         }
 
         self.tasks_to_apply.clearRetainingCapacity();
     }
-
-    fn grabFreeChunk(self: *TaskQueue) *ArrayChunk {
-        if (self.free_chunks.items.len == 0) {
-            const chunk = self.allocator.create(ArrayChunk) catch unreachable;
-            chunk.* = .{};
-            self.free_chunks.append(self.allocator, chunk) catch unreachable;
-        }
-        const chunk = self.free_chunks.pop().?;
-        chunk.count = 0;
-        return chunk;
-    }
 };
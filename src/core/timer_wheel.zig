@@ -0,0 +1,170 @@
+const std = @import("std");
+
+// Hierarchical timer wheel, O(1) insert and O(1) amortized per expired item.
+//
+// Time is quantized into ticks. Level 0 has one slot per tick for the next 64 ticks, each
+// level above covers 64 times the range of the one below. Items further out than the top
+// level wait in an overflow list. Whenever the wheel crosses a slot boundary of a higher
+// level, that slot is cascaded down to the lower levels. Advancing skips empty level 0
+// slots with the occupancy mask, so a big jump in time (journeying) costs one step per
+// 64 ticks rather than one per tick.
+pub fn TimerWheel(comptime T: type) type {
+    return struct {
+        const Self = @This();
+
+        const slot_bits = 6;
+        const slot_count = 1 << slot_bits;
+        const slot_mask = slot_count - 1;
+        pub const level_count = 4;
+
+        const Entry = struct {
+            due_tick: u64,
+            item: T,
+        };
+        const Slot = std.ArrayListUnmanaged(Entry);
+
+        allocator: std.mem.Allocator,
+        tick_seconds: f64,
+        current_tick: u64 = 0,
+        slots: [level_count][slot_count]Slot = [_][slot_count]Slot{[_]Slot{.{}} ** slot_count} ** level_count,
+        occupied: [level_count]u64 = .{0} ** level_count,
+        overflow: Slot = .{},
+        count: usize = 0,
+
+        pub fn init(allocator: std.mem.Allocator, tick_seconds: f64) Self {
+            return .{
+                .allocator = allocator,
+                .tick_seconds = tick_seconds,
+            };
+        }
+
+        pub fn deinit(self: *Self) void {
+            for (&self.slots) |*level_slots| {
+                for (level_slots) |*slot| {
+                    slot.deinit(self.allocator);
+                }
+            }
+            self.overflow.deinit(self.allocator);
+        }
+
+        // Rounds up, so the item never fires before its time.
+        pub fn insert(self: *Self, time: f64, item: T) void {
+            const due_tick: u64 = @intFromFloat(@ceil(@max(time, 0) / self.tick_seconds));
+            self.place(.{ .due_tick = @max(due_tick, self.current_tick + 1), .item = item }, self.current_tick);
+            self.count += 1;
+        }
+
+        // Appends every item due at or before time to expired, which must use the wheel's allocator.
+        pub fn advance(self: *Self, time: f64, expired: *std.ArrayListUnmanaged(T)) void {
+            const target_tick: u64 = @intFromFloat(@floor(@max(time, 0) / self.tick_seconds));
+            while (self.current_tick < target_tick) {
+                const next_tick = self.current_tick + 1;
+                if (next_tick & slot_mask == 0) {
+                    self.cascade(next_tick);
+                    self.expireSlot(0, expired);
+                    self.current_tick = next_tick;
+                    continue;
+                }
+
+                // No cascades until the next boundary, only level 0 slots to expire.
+                const end_tick = @min(target_tick, next_tick | slot_mask);
+                const first: u6 = @intCast(next_tick & slot_mask);
+                const last: u6 = @intCast(end_tick & slot_mask);
+                const range_mask = (~@as(u64, 0) >> (63 - (last - first))) << first;
+                var bits = self.occupied[0] & range_mask;
+                while (bits != 0) : (bits &= bits - 1) {
+                    self.expireSlot(@ctz(bits), expired);
+                }
+                self.current_tick = end_tick;
+            }
+        }
+
+        fn place(self: *Self, entry: Entry, now_tick: u64) void {
+            const delta = entry.due_tick - now_tick;
+            inline for (0..level_count) |level| {
+                if (delta < 1 << (slot_bits * (level + 1))) {
+                    const slot_index: u6 = @intCast((entry.due_tick >> (slot_bits * level)) & slot_mask);
+                    self.slots[level][slot_index].append(self.allocator, entry) catch unreachable;
+                    self.occupied[level] |= @as(u64, 1) << slot_index;
+                    return;
+                }
+            }
+            self.overflow.append(self.allocator, entry) catch unreachable;
+        }
+
+        // Highest level first so items cascaded from above can still land in
+        // a lower level slot that is about to be cascaded on this same tick.
+        fn cascade(self: *Self, tick: u64) void {
+            var top_level: usize = 1;
+            while (top_level + 1 < level_count and tick & ((@as(u64, 1) << @intCast(slot_bits * (top_level + 1))) - 1) == 0) {
+                top_level += 1;
+            }
+
+            if (top_level == level_count - 1 and self.overflow.items.len > 0) {
+                var overflow = self.overflow;
+                self.overflow = .{};
+                defer overflow.deinit(self.allocator);
+                for (overflow.items) |entry| {
+                    self.place(entry, tick);
+                }
+            }
+
+            var level = top_level;
+            while (level >= 1) : (level -= 1) {
+                const slot_index: u6 = @intCast((tick >> @intCast(slot_bits * level)) & slot_mask);
+                if (self.occupied[level] & (@as(u64, 1) << slot_index) != 0) {
+                    // Swap the slot out since place() may append to this level again.
+                    var slot = self.slots[level][slot_index];
+                    self.slots[level][slot_index] = .{};
+                    self.occupied[level] &= ~(@as(u64, 1) << slot_index);
+                    for (slot.items) |entry| {
+                        self.place(entry, tick);
+                    }
+                    slot.clearRetainingCapacity();
+                    if (self.slots[level][slot_index].capacity == 0) {
+                        self.slots[level][slot_index] = slot;
+                    } else {
+                        slot.deinit(self.allocator);
+                    }
+                }
+            }
+        }
+
+        fn expireSlot(self: *Self, slot_index: usize, expired: *std.ArrayListUnmanaged(T)) void {
+            const slot = &self.slots[0][slot_index];
+            for (slot.items) |entry| {
+                expired.append(self.allocator, entry.item) catch unreachable;
+            }
+            self.count -= slot.items.len;
+            slot.clearRetainingCapacity();
+            self.occupied[0] &= ~(@as(u64, 1) << @intCast(slot_index));
+        }
+    };
+}
+
+test "timer_wheel" {
+    var wheel = TimerWheel(u32).init(std.testing.allocator, 1.0);
+    defer wheel.deinit();
+    var expired = std.ArrayListUnmanaged(u32){};
+    defer expired.deinit(std.testing.allocator);
+
+    // One per level plus one in the overflow list.
+    const times = [_]f64{ 3, 70, 5000, 300000, 20000000 };
+    for (times, 0..) |time, index| {
+        wheel.insert(time, @intCast(index));
+    }
+
+    for (times, 0..) |time, index| {
+        wheel.advance(time - 1, &expired);
+        try std.testing.expectEqual(index, expired.items.len);
+        wheel.advance(time, &expired);
+        try std.testing.expectEqual(index + 1, expired.items.len);
+        try std.testing.expectEqual(index, expired.items[index]);
+    }
+    try std.testing.expectEqual(0, wheel.count);
+
+    // Inserting in the past fires on the next advance.
+    wheel.insert(1, 42);
+    wheel.advance(20000001, &expired);
+    try std.testing.expectEqual(42, expired.getLast());
+}
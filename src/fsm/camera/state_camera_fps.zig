@@ -14,6 +14,7 @@ const zphy = @import("zphysics");
 const PrefabManager = @import("../../prefab_manager.zig").PrefabManager;
 const util = @import("../../util.zig");
 const context = @import("../../core/context.zig");
+const SpatialHashGrid = @import("../../core/spatial_hash_grid.zig").SpatialHashGrid;
 const renderer = @import("../../renderer/renderer.zig");
 const im3d = @import("im3d");
 const zaudio = @import("zaudio");
@@ -30,6 +31,7 @@ pub const StateContext = struct {
     physics_world_low: *zphy.PhysicsSystem,
     prefab_mgr: *PrefabManager,
     renderer: *renderer.Renderer,
+    enemy_grid: *SpatialHashGrid(ecs.entity_t),
 };
 
 pub fn create(create_ctx: StateContext) void {
@@ -805,11 +807,7 @@ fn updateRest(it: *ecs.iter_t) callconv(.C) void {
         const can_burst = slime_burst or (!has_nearby_light and is_night);
         // if (!is_day and !has_nearby_light and slime_cooldown < 0) {
         if (can_burst and slime_cooldown < 0) {
-            var it_slimes = ecs.each(ctx.ecsu_world.world, fd.SettlementEnemy);
-            var slime_count: usize = 0;
-            while (ecs.each_next(&it_slimes)) {
-                slime_count += it_slimes.entities().len;
-            }
+            const slime_count = ctx.enemy_grid.count();
 
             if (slime_count > 15) {
                 slime_burst = false;
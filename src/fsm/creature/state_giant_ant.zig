@@ -14,6 +14,8 @@ const config = @import("../../config/config.zig");
 const zphy = @import("zphysics");
 const egl_math = @import("../../core/math.zig");
 const context = @import("../../core/context.zig");
+const world_patch_manager = @import("../../worldpatch/world_patch_manager.zig");
+const TerrainHeightQuery = @import("../../worldpatch/terrain_height_query.zig").TerrainHeightQuery;
 
 pub const NonMovingBroadPhaseLayerFilter = extern struct {
     usingnamespace zphy.BroadPhaseLayerFilter.Methods(@This());
@@ -39,11 +41,18 @@ pub const StateContext = struct {
     input_frame_data: *input.FrameData,
     physics_world: *zphy.PhysicsSystem,
     physics_world_low: *zphy.PhysicsSystem,
+    world_patch_mgr: *world_patch_manager.WorldPatchManager,
+    state: struct {
+        terrain_height_query: TerrainHeightQuery,
+    },
 };
 
 pub fn create(create_ctx: StateContext) void {
     const update_ctx = create_ctx.arena_system_lifetime.create(StateContext) catch unreachable;
     update_ctx.* = StateContext.view(create_ctx);
+    update_ctx.state = .{
+        .terrain_height_query = TerrainHeightQuery.create(create_ctx.world_patch_mgr),
+    };
 
     {
         var system_desc = ecs.system_desc_t{};
@@ -78,13 +87,19 @@ fn updateMovement(pos: *fd.Position, rot: *fd.Rotation, fwd: *fd.Forward, dt: zm
     zm.store(pos.elems()[0..], self_pos_z, 3);
 }
 
-fn updateSnapToTerrain(
+// Resident terrain first, raycasts only where there's none. Like snapToTerrain this relies on
+// the terrain heightfields being the only static bodies.
+fn findGround(
     physics_world: *zphy.PhysicsSystem,
     physics_world_low: *zphy.PhysicsSystem,
-    pos: *fd.Position,
-    body: *fd.PhysicsBody,
-    player_pos: *const fd.Position,
-) void {
+    terrain_height_query: *TerrainHeightQuery,
+    pos: *const fd.Position,
+) ?struct { height: f32, normal: [3]f32 } {
+    const terrain = terrain_height_query.query(pos.x, pos.z);
+    if (terrain.hit and terrain.height < pos.y + 200 and terrain.height > pos.y - 800) {
+        return .{ .height = terrain.height, .normal = terrain.normal };
+    }
+
     const ray_origin = [_]f32{ pos.x, pos.y + 200, pos.z, 0 };
     const ray_dir = [_]f32{ 0, -1000, 0, 0 };
     const ray = zphy.RRayCast{
@@ -110,9 +125,28 @@ fn updateSnapToTerrain(
             },
         );
     }
+    if (!result.has_hit) {
+        return null;
+    }
 
-    if (result.has_hit) {
-        pos.y = ray_origin[1] + ray_dir[1] * result.hit.fraction + 0.1;
+    const bodies = ray_physics_world.getBodiesUnsafe();
+    const body_hit = zphy.tryGetBody(bodies, result.hit.body_id).?;
+    return .{
+        .height = ray_origin[1] + ray_dir[1] * result.hit.fraction,
+        .normal = body_hit.getWorldSpaceSurfaceNormal(result.hit.sub_shape_id, ray.getPointOnRay(result.hit.fraction)),
+    };
+}
+
+fn updateSnapToTerrain(
+    physics_world: *zphy.PhysicsSystem,
+    physics_world_low: *zphy.PhysicsSystem,
+    terrain_height_query: *TerrainHeightQuery,
+    pos: *fd.Position,
+    body: *fd.PhysicsBody,
+    player_pos: *const fd.Position,
+) void {
+    if (findGround(physics_world, physics_world_low, terrain_height_query, pos)) |ground| {
+        pos.y = ground.height + 0.1;
 
         const handedness_offset = std.math.pi;
         const up_z = zm.f32x4(0, 1, 0, 0);
@@ -123,10 +157,8 @@ fn updateSnapToTerrain(
         defer read_lock_self.unlock();
         const body_self = read_lock_self.body.?;
 
-        const bodies = ray_physics_world.getBodiesUnsafe();
-        const body_hit = zphy.tryGetBody(bodies, result.hit.body_id).?;
         const rot_slope_z = blk: {
-            const hit_normal = body_hit.getWorldSpaceSurfaceNormal(result.hit.sub_shape_id, ray.getPointOnRay(result.hit.fraction));
+            const hit_normal = ground.normal;
             const hit_normal_z = zm.loadArr3(hit_normal);
             if (hit_normal[1] < 0.99) { // TODO: Find a good value, this was just arbitrarily picked :)
                 const rot_axis_z = zm.cross3(up_z, hit_normal_z);
@@ -200,7 +232,7 @@ fn fsm_enemy_idle(it: *ecs.iter_t) callconv(.C) void {
 
             updateMovement(pos, rot, fwd, zm.f32x4s(it.delta_time), player_pos);
             // updateSnapToTerrain(ctx.physics_world, pos, body, player_pos, ctx.gfx);
-            updateSnapToTerrain(ctx.physics_world, ctx.physics_world_low, pos, body, player_pos);
+            updateSnapToTerrain(ctx.physics_world, ctx.physics_world_low, &ctx.state.terrain_height_query, pos, body, player_pos);
         }
     }
 }
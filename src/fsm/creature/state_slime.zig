@@ -15,6 +15,9 @@ const zphy = @import("zphysics");
 const egl_math = @import("../../core/math.zig");
 const renderer = @import("../../renderer/renderer.zig");
 const context = @import("../../core/context.zig");
+const world_patch_manager = @import("../../worldpatch/world_patch_manager.zig");
+const terrain_height_query = @import("../../worldpatch/terrain_height_query.zig");
+const TerrainHeightQuery = terrain_height_query.TerrainHeightQuery;
 const task_queue = @import("../../core/task_queue.zig");
 const im3d = @import("im3d");
 const zaudio = @import("zaudio");
@@ -30,11 +33,18 @@ pub const StateContext = struct {
     physics_world_low: *zphy.PhysicsSystem,
     renderer: *renderer.Renderer,
     task_queue: *task_queue.TaskQueue,
+    world_patch_mgr: *world_patch_manager.WorldPatchManager,
+    state: struct {
+        terrain_height_query: TerrainHeightQuery,
+    },
 };
 
 pub fn create(create_ctx: StateContext) void {
     const update_ctx = create_ctx.arena_system_lifetime.create(StateContext) catch unreachable;
     update_ctx.* = StateContext.view(create_ctx);
+    update_ctx.state = .{
+        .terrain_height_query = TerrainHeightQuery.create(create_ctx.world_patch_mgr),
+    };
 
     {
         var system_desc = ecs.system_desc_t{};
@@ -105,6 +115,7 @@ fn updateTargetPosition(
     fwd: *fd.Forward,
     locomotion: *fd.Locomotion,
     physics_world_low: *zphy.PhysicsSystem,
+    terrain_query: *TerrainHeightQuery,
     is_day: bool,
 ) void {
     if (locomotion.target_position == null) {
@@ -160,40 +171,45 @@ fn updateTargetPosition(
     const self_height = self_pos_z[1];
     const lookahead = 250 + @abs(wanted_height - self_height) * 3;
     const angles = 15;
-    for (0..angles) |i_angle| {
+    var sample_positions: [angles][2]f32 = undefined;
+    for (&sample_positions, 0..) |*sample_pos, i_angle| {
         const i_angle_f: f32 = @as(f32, @floatFromInt(i_angle)) - @as(f32, angles / 2);
         const angle_offset = i_angle_f * math.degreesToRadians(angle_increment);
         const angle = angle_curr + angle_offset;
-
-        const pos_offset = [_]f32{
-            std.math.cos(angle) * lookahead,
-            0,
-            std.math.sin(angle) * lookahead,
+        sample_pos.* = .{
+            pos.x + std.math.cos(angle) * lookahead,
+            pos.z + std.math.sin(angle) * lookahead,
         };
+    }
 
-        const sample_pos = [_]f32{
-            pos.x + pos_offset[0],
-            pos.y + pos_offset[1],
-            pos.z + pos_offset[2],
-        };
+    var terrain_results: [angles]terrain_height_query.TerrainHeightResult = undefined;
+    terrain_query.queryBatch(&sample_positions, &terrain_results);
 
+    for (sample_positions, terrain_results) |sample_pos, terrain_result| {
         const ray_origin = [_]f32{
             sample_pos[0],
-            sample_pos[1] + 500,
-            sample_pos[2],
+            pos.y + 500,
+            sample_pos[1],
             0,
         };
-        const ray = zphy.RRayCast{
-            .origin = ray_origin,
-            .direction = ray_dir,
-        };
 
-        var query = physics_world_low.getNarrowPhaseQuery();
-        const result = query.castRay(ray, cast_ray_args);
-        if (!result.has_hit) {
-            continue;
-        }
-        const height_at = ray_origin[1] + ray_dir[1] * result.hit.fraction;
+        const height_at = blk: {
+            if (terrain_result.hit) {
+                break :blk terrain_result.height;
+            }
+
+            // Not resident, the low physics world reaches further.
+            const ray = zphy.RRayCast{
+                .origin = ray_origin,
+                .direction = ray_dir,
+            };
+            var query = physics_world_low.getNarrowPhaseQuery();
+            const result = query.castRay(ray, cast_ray_args);
+            if (!result.has_hit) {
+                continue;
+            }
+            break :blk ray_origin[1] + ray_dir[1] * result.hit.fraction;
+        };
         const random_score = -5 + 10 * std.crypto.random.float(f32);
         const height = height_at + random_score;
 
@@ -201,7 +217,7 @@ fn updateTargetPosition(
         //     &.{
         //         .x = sample_pos[0],
         //         .y = height_at,
-        //         .z = sample_pos[2],
+        //         .z = sample_pos[1],
         //     },
         //     &.{ .x = 0, .y = 1, .z = 0 },
         //     50,
@@ -377,7 +393,7 @@ fn fsm_enemy_slime(it: *ecs.iter_t) callconv(.C) void {
             if (enemy.aggressive) {
                 locomotion.target_position = player_pos.elemsConst().*;
             } else {
-                updateTargetPosition(pos, fwd, locomotion, ctx.physics_world_low, is_day);
+                updateTargetPosition(pos, fwd, locomotion, ctx.physics_world_low, &ctx.state.terrain_height_query, is_day);
             }
 
             if (!locomotion.affected_by_gravity) {
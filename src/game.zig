@@ -19,6 +19,7 @@ const fd = @import("config/flecs_data.zig");
 const fr = @import("config/flecs_relation.zig");
 const fsm = @import("fsm/fsm.zig");
 const IdLocal = @import("core/core.zig").IdLocal;
+const JobSystem = @import("core/job_system.zig").JobSystem;
 const task_queue = @import("core/task_queue.zig");
 const input = @import("input.zig");
 const prefab_manager = @import("prefab_manager.zig");
@@ -34,6 +35,7 @@ const window = @import("renderer/window.zig");
 const patch_types = @import("worldpatch/patch_types.zig");
 const world_patch_manager = @import("worldpatch/world_patch_manager.zig");
 const utility_scoring = @import("core/utility_scoring.zig");
+const SpatialHashGrid = @import("core/spatial_hash_grid.zig").SpatialHashGrid;
 
 const ui = @import("ui.zig");
 
@@ -45,8 +47,10 @@ const GameloopContext = struct {
     asset_mgr: *AssetManager,
     audio: *zaudio.Engine,
     ecsu_world: ecsu.World,
+    enemy_grid: *SpatialHashGrid(ecs.entity_t),
     event_mgr: *EventManager,
     input_frame_data: *input.FrameData,
+    jobs: *JobSystem,
     main_window: *window.Window,
     physics_world: *zphy.PhysicsSystem,
     physics_world_low: *zphy.PhysicsSystem,
@@ -80,6 +84,15 @@ pub fn run() void {
     zstbi.init(root_allocator);
     defer zstbi.deinit();
 
+    // Worker threads for every subsystem. Created first so it outlives all of them.
+    const jobs = JobSystem.create(root_allocator, @intCast(std.Thread.getCpuCount() catch 4));
+    defer jobs.destroy();
+
+    // Where all the SettlementEnemy entities are, kept up to date by the worldsim systems.
+    // NOTE: Created before the world, its OnRemove observer still fires while the world is torn down.
+    var enemy_grid = SpatialHashGrid(ecs.entity_t).create(root_allocator, 256);
+    defer enemy_grid.destroy();
+
     // Flecs
     var ecsu_world = ecsu.World.init();
     defer ecsu_world.deinit();
@@ -120,15 +133,19 @@ pub fn run() void {
 
     var asset_mgr = AssetManager.create(root_allocator);
     defer asset_mgr.destroy();
+    asset_mgr.scanContent("content");
 
+    defer patch_types.closePatchArchives();
     var world_patch_mgr = world_patch_manager.WorldPatchManager.create(root_allocator, &asset_mgr);
     world_patch_mgr.debug_server.run();
     defer world_patch_mgr.destroy();
     patch_types.registerPatchTypes(world_patch_mgr);
+    world_patch_mgr.useWorkers(jobs.background);
+    asset_mgr.setReadWorkerCount(jobs.worker_counts.background);
 
     // Initialize Renderer
     var renderer_ctx = renderer.Renderer{};
-    renderer_ctx.init(main_window, ecsu_world, world_patch_mgr, root_allocator) catch unreachable;
+    renderer_ctx.init(main_window, ecsu_world, world_patch_mgr, jobs, root_allocator) catch unreachable;
     defer renderer_ctx.exit();
     const reload_desc = renderer.ReloadDesc{ .mType = .{ .SHADER = true, .RESIZE = true, .RENDERTARGET = true } };
     renderer_ctx.onLoad(reload_desc) catch unreachable;
@@ -219,8 +236,10 @@ pub fn run() void {
         .heap_allocator = root_system_allocator.allocator(),
         .asset_mgr = &asset_mgr,
         .ecsu_world = ecsu_world,
+        .enemy_grid = &enemy_grid,
         .event_mgr = &event_mgr,
         .input_frame_data = &input_frame_data,
+        .jobs = jobs,
         .main_window = main_window,
         .physics_world = physics_mgr.physics_world,
         .physics_world_low = physics_mgr.physics_world_low,
@@ -235,6 +254,7 @@ pub fn run() void {
 
     task_queue1.init(root_system_allocator.allocator(), gameloop_context);
     defer task_queue1.destroy();
+    task_queue1.useWorkers(jobs.frame);
 
     config.system.createSystems(&gameloop_context);
     config.system.setupSystems(&gameloop_context);
@@ -507,10 +527,10 @@ fn update_full(gameloop_context: GameloopContext) bool {
     const environment_info = ecsu_world.getSingletonMut(fd.EnvironmentInfo).?;
     const is_journeying = environment_info.journey_state != .not;
 
-    const ticks: u32 = if (is_journeying) 1 else if (has_initial_sim) 16 else 10000;
-    for (0..ticks) |_| {
-        world_patch_mgr.tickOne();
-    }
+    // Milliseconds of main thread time spent integrating streamed patches.
+    const patch_budget_ms: f64 = if (is_journeying) 1 else if (has_initial_sim) 2 else 50;
+    world_patch_mgr.tickBudgeted(patch_budget_ms);
+    gameloop_context.asset_mgr.plotStats();
     stats.delta_time = @min(1.0 / 30.0, stats.delta_time); // anti hitch
     update(gameloop_context, stats.delta_time);
 
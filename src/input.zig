@@ -1,8 +1,9 @@
 const std = @import("std");
 const zglfw = @import("zglfw");
 const IdLocal = @import("core/core.zig").IdLocal;
+const IdLocalHashMap = @import("core/core.zig").IdLocalHashMap;
 
-pub const TargetMap = std.AutoHashMap(IdLocal, TargetValue);
+pub const TargetMap = IdLocalHashMap(TargetValue);
 
 pub const FrameData = struct {
     index_curr: u32 = 0,
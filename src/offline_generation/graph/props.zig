@@ -7,6 +7,7 @@ const v = @import("../../core/core.zig").variant;
 const config = @import("../../config/config.zig");
 const IdLocal = @import("../../core/core.zig").IdLocal;
 const tides_math = @import("../../core/math.zig");
+const props_format = @import("../../worldpatch/props_format.zig");
 
 const graph_util = @import("util.zig");
 const getInputResult = graph_util.getInputResult;
@@ -66,6 +67,14 @@ pub fn funcTemplateProps(node: *g.Node, output: *g.NodeOutput, context: *g.Graph
     const PROPS_LOD = 1;
     const PROPS_PATCH_SIZE = config.patch_size * std.math.pow(u32, 2, PROPS_LOD);
     const PATCH_COUNT = world_width / PROPS_PATCH_SIZE;
+
+    // Scale used to be randomized by the game at spawn time, now it's baked into the patch.
+    var rand_state = std.Random.DefaultPrng.init(1234);
+    const rand = rand_state.random();
+    var patch_props = std.ArrayList(props_format.PropInput).init(std.heap.c_allocator);
+    defer patch_props.deinit();
+    var patch_file_data = std.ArrayList(u8).init(std.heap.c_allocator);
+    defer patch_file_data.deinit();
     for (0..PATCH_COUNT) |patch_z| {
         for (0..PATCH_COUNT) |patch_x| {
             const patch_x_world = patch_x * PROPS_PATCH_SIZE;
@@ -114,7 +123,7 @@ pub fn funcTemplateProps(node: *g.Node, output: *g.NodeOutput, context: *g.Graph
 
                 const namebufslice = std.fmt.bufPrintZ(
                     namebuf[0..namebuf.len],
-                    "{s}/props_x{}_z{}.txt",
+                    "{s}/props_x{}_z{}.props",
                     .{
                         folderbufslice,
                         patch_x,
@@ -127,11 +136,7 @@ pub fn funcTemplateProps(node: *g.Node, output: *g.NodeOutput, context: *g.Graph
                     continue;
                 }
 
-                const remap_file = std.fs.cwd().createFile(
-                    namebufslice,
-                    .{ .read = true },
-                ) catch unreachable;
-                defer remap_file.close();
+                patch_props.clearRetainingCapacity();
 
                 blk_tree: for (props_forest) |prop_tree| {
                     const patch_x_world_f: f32 = @floatFromInt(patch_x_world);
@@ -146,22 +151,19 @@ pub fn funcTemplateProps(node: *g.Node, output: *g.NodeOutput, context: *g.Graph
                         }
                     }
 
-                    const prop_slice = std.fmt.bufPrintZ(
-                        namebuf[0..namebuf.len],
-                        "tree,{d:.3},{d:.3},{d:.3},{d:.3}\n",
-                        .{
-                            prop_tree.pos[0], prop_tree.pos[1], prop_tree.pos[2], prop_tree.rot,
-                        },
-                    ) catch unreachable;
-                    const bytes_written = remap_file.writeAll(prop_slice) catch unreachable;
-                    _ = bytes_written;
+                    patch_props.append(.{
+                        .type_name = "tree",
+                        .pos = prop_tree.pos,
+                        .rot = prop_tree.rot,
+                        .scale = 0.15 + rand.float(f32) * 1.25,
+                    }) catch unreachable;
                 }
 
                 const patch_x_world_f = @as(f32, @floatFromInt(patch_x_world));
                 const patch_z_world_f = @as(f32, @floatFromInt(patch_z_world));
                 const patch_x_world_end_f = patch_x_world_f + @as(f32, @floatFromInt(PROPS_PATCH_SIZE));
                 const patch_z_world_end_f = patch_z_world_f + @as(f32, @floatFromInt(PROPS_PATCH_SIZE));
-                for (props_city) |prop| {
+                for (props_city) |*prop| {
                     if (prop.pos[0] < patch_x_world_f or prop.pos[0] >= patch_x_world_end_f) {
                         continue;
                     }
@@ -169,16 +171,17 @@ pub fn funcTemplateProps(node: *g.Node, output: *g.NodeOutput, context: *g.Graph
                         continue;
                     }
 
-                    const prop_slice = std.fmt.bufPrintZ(
-                        namebuf[0..namebuf.len],
-                        "{s},{d:.3},{d:.3},{d:.3},{d:.3}\n",
-                        .{
-                            prop.id.toString(), prop.pos[0], prop.pos[1], prop.pos[2], prop.rot,
-                        },
-                    ) catch unreachable;
-                    const bytes_written = remap_file.writeAll(prop_slice) catch unreachable;
-                    _ = bytes_written;
+                    patch_props.append(.{
+                        .type_name = prop.id.toString(),
+                        .pos = prop.pos,
+                        .rot = prop.rot,
+                        .scale = 0.15 + rand.float(f32) * 1.25,
+                    }) catch unreachable;
                 }
+
+                patch_file_data.clearRetainingCapacity();
+                props_format.encode(patch_props.items, true, patch_file_data.writer()) catch unreachable;
+                std.fs.cwd().writeFile(.{ .sub_path = namebufslice, .data = patch_file_data.items }) catch unreachable;
             }
         }
     }
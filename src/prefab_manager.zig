@@ -11,12 +11,13 @@ const renderer = @import("renderer/renderer.zig");
 const geometry = @import("renderer/geometry.zig");
 const util = @import("util.zig");
 const IdLocal = @import("core/core.zig").IdLocal;
+const IdLocalHashMap = @import("core/core.zig").IdLocalHashMap;
 const ID = @import("core/core.zig").ID;
 
 const assert = std.debug.assert;
 
-const PrefabHashMap = std.AutoHashMap(IdLocal, ecsu.Entity);
-const MaterialHashmap = std.AutoHashMap(IdLocal, renderer.UberShaderMaterialData);
+const PrefabHashMap = IdLocalHashMap(ecsu.Entity);
+const MaterialHashmap = IdLocalHashMap(renderer.UberShaderMaterialData);
 
 const InvalidID = ID("_invalid_id_");
 
@@ -0,0 +1,511 @@
+const std = @import("std");
+const expect = std.testing.expect;
+
+const geometry = @import("geometry.zig");
+
+// Visibility and LoD selection for the dynamic geometry pass.
+//
+// Every instance owns a slot with a bounding sphere kept in SoA columns. Spheres are only written
+// when an instance moves, so culling a view is a straight run over packed floats, a group of
+// eight slots at a time: the four side planes, the draw distance and the screen size LoD in a
+// handful of vector ops. Visible slots come out sorted by model (a set of LoD meshes and their
+// materials, as the pass registers them) and LoD, so every run of equal keys is one batch.
+//
+// Each draw list remembers its last view and the version of the slots it saw. When the view
+// hasn't changed, groups nothing was written to since keep last cull's visibility and LoDs, and
+// LoD switches get some hysteresis so instances hovering around a threshold don't flicker.
+//
+// Slots are handed out from a free list and columns are padded to whole groups. Free slots get
+// a radius of -inf, which no plane test passes.
+
+pub const lods_max_count = geometry.mesh_lod_max_count;
+pub const group_size = 8;
+
+// Screen size (the sphere's diameter over the screen height) under which the next LoD is used.
+// Roughly the old 50, 100 and 200 meter distances for a character sized mesh.
+pub const lod_screen_sizes = [lods_max_count - 1]f32{ 0.05, 0.025, 0.0125 };
+
+const FloatGroup = @Vector(group_size, f32);
+const LodGroup = @Vector(group_size, u8);
+const BoolGroup = @Vector(group_size, bool);
+const GroupMask = std.meta.Int(.unsigned, group_size);
+
+pub const VisibilityView = struct {
+    // Left, right, top and bottom, normalized, like renderer_types.Frustum.
+    frustum_planes: [4][4]f32,
+    camera_position: [3]f32,
+    projection_scale: f32, // projection[1][1], the cotangent of half the vertical fov
+    max_draw_distance: f32,
+    temporal_coherence: bool = true,
+    lod_hysteresis: f32 = 0.1, // Only with temporal coherence
+    // Takes the LoDs from another list instead of selecting them, so shadows match the camera.
+    lod_source: ?*const DrawList = null,
+};
+
+// Whatever a cull's results depend on, besides the slots.
+const ViewKey = struct {
+    frustum_planes: [4][4]f32,
+    camera_position: [3]f32,
+    projection_scale: f32,
+    max_draw_distance: f32,
+    lod_hysteresis: f32,
+};
+
+pub const DrawBatch = struct {
+    model: u32,
+    lod: u32,
+    first: u32, // Into DrawList.slots
+    count: u32,
+};
+
+pub const DrawList = struct {
+    // Visible slots sorted by model and LoD, and the runs of them that share both.
+    slots: std.ArrayListUnmanaged(u32) = .{},
+    batches: std.ArrayListUnmanaged(DrawBatch) = .{},
+
+    // Last cull's LoD of every slot and visibility of every group, reused by the next one.
+    lods: std.ArrayListUnmanaged(u8) = .{},
+    group_masks: std.ArrayListUnmanaged(GroupMask) = .{},
+    version: u64 = 0,
+    last_view: ?ViewKey = null,
+    view_unchanged: bool = false,
+
+    // Stats of the last cull.
+    instances_visible: u32 = 0,
+    groups_culled: u32 = 0,
+    groups_reused: u32 = 0,
+
+    pub fn deinit(self: *DrawList, allocator: std.mem.Allocator) void {
+        self.slots.deinit(allocator);
+        self.batches.deinit(allocator);
+        self.lods.deinit(allocator);
+        self.group_masks.deinit(allocator);
+    }
+
+    pub fn batchSlots(self: DrawList, batch: DrawBatch) []const u32 {
+        return self.slots.items[batch.first .. batch.first + batch.count];
+    }
+};
+
+pub const DynamicVisibility = struct {
+    allocator: std.mem.Allocator,
+
+    center_x: std.ArrayListUnmanaged(f32) = .{},
+    center_y: std.ArrayListUnmanaged(f32) = .{},
+    center_z: std.ArrayListUnmanaged(f32) = .{},
+    radius: std.ArrayListUnmanaged(f32) = .{},
+    models: std.ArrayListUnmanaged(u32) = .{},
+    lod_counts: std.ArrayListUnmanaged(u8) = .{},
+    group_versions: std.ArrayListUnmanaged(u64) = .{},
+    free_slots: std.ArrayListUnmanaged(u32) = .{},
+    slots_count: u32 = 0, // High water mark
+    models_count: u32 = 0,
+    version: u64 = 0,
+    key_offsets: std.ArrayListUnmanaged(u32) = .{},
+
+    pub fn create(allocator: std.mem.Allocator) *DynamicVisibility {
+        const self = allocator.create(DynamicVisibility) catch unreachable;
+        self.* = .{ .allocator = allocator };
+        return self;
+    }
+
+    pub fn destroy(self: *DynamicVisibility) void {
+        self.center_x.deinit(self.allocator);
+        self.center_y.deinit(self.allocator);
+        self.center_z.deinit(self.allocator);
+        self.radius.deinit(self.allocator);
+        self.models.deinit(self.allocator);
+        self.lod_counts.deinit(self.allocator);
+        self.group_versions.deinit(self.allocator);
+        self.free_slots.deinit(self.allocator);
+        self.key_offsets.deinit(self.allocator);
+        self.allocator.destroy(self);
+    }
+
+    // The slot isn't drawn until it gets a model and bounds.
+    pub fn allocateSlot(self: *DynamicVisibility) u32 {
+        if (self.free_slots.pop()) |slot| {
+            return slot;
+        }
+
+        const slot = self.slots_count;
+        self.slots_count += 1;
+        if (slot == self.radius.items.len) {
+            self.center_x.appendNTimes(self.allocator, 0, group_size) catch unreachable;
+            self.center_y.appendNTimes(self.allocator, 0, group_size) catch unreachable;
+            self.center_z.appendNTimes(self.allocator, 0, group_size) catch unreachable;
+            self.radius.appendNTimes(self.allocator, -std.math.inf(f32), group_size) catch unreachable;
+            self.models.appendNTimes(self.allocator, 0, group_size) catch unreachable;
+            self.lod_counts.appendNTimes(self.allocator, 1, group_size) catch unreachable;
+            self.version += 1;
+            self.group_versions.append(self.allocator, self.version) catch unreachable;
+        }
+        return slot;
+    }
+
+    pub fn freeSlot(self: *DynamicVisibility, slot: u32) void {
+        self.radius.items[slot] = -std.math.inf(f32);
+        self.lod_counts.items[slot] = 1;
+        self.touch(slot);
+        self.free_slots.append(self.allocator, slot) catch unreachable;
+    }
+
+    pub fn setModel(self: *DynamicVisibility, slot: u32, model: u32, lod_count: u32) void {
+        std.debug.assert(lod_count > 0 and lod_count <= lods_max_count);
+        self.models.items[slot] = model;
+        self.lod_counts.items[slot] = @intCast(lod_count);
+        self.models_count = @max(self.models_count, model + 1);
+        self.touch(slot);
+    }
+
+    // Writing the bounds it already has doesn't make the slot's group cull again.
+    pub fn setBounds(self: *DynamicVisibility, slot: u32, center: [3]f32, radius: f32) void {
+        if (self.center_x.items[slot] == center[0] and
+            self.center_y.items[slot] == center[1] and
+            self.center_z.items[slot] == center[2] and
+            self.radius.items[slot] == radius)
+        {
+            return;
+        }
+
+        self.center_x.items[slot] = center[0];
+        self.center_y.items[slot] = center[1];
+        self.center_z.items[slot] = center[2];
+        self.radius.items[slot] = radius;
+        self.touch(slot);
+    }
+
+    fn touch(self: *DynamicVisibility, slot: u32) void {
+        self.version += 1;
+        self.group_versions.items[slot / group_size] = self.version;
+    }
+
+    pub fn cull(self: *DynamicVisibility, list: *DrawList, view: VisibilityView) void {
+        const slots_capacity = self.radius.items.len;
+        const groups_count = slots_capacity / group_size;
+        if (list.lods.items.len < slots_capacity) {
+            const old_len = list.lods.items.len;
+            list.lods.resize(self.allocator, slots_capacity) catch unreachable;
+            @memset(list.lods.items[old_len..], 0);
+            list.group_masks.resize(self.allocator, groups_count) catch unreachable;
+            @memset(list.group_masks.items[old_len / group_size ..], 0);
+        }
+        if (view.lod_source) |lod_source| {
+            std.debug.assert(lod_source.lods.items.len >= slots_capacity);
+        }
+
+        const hysteresis = if (view.temporal_coherence) view.lod_hysteresis else 0;
+        const view_key = ViewKey{
+            .frustum_planes = view.frustum_planes,
+            .camera_position = view.camera_position,
+            .projection_scale = view.projection_scale,
+            .max_draw_distance = view.max_draw_distance,
+            .lod_hysteresis = hysteresis,
+        };
+        // A list that borrows LoDs can only keep them if its source did.
+        const lods_unchanged = if (view.lod_source) |lod_source| lod_source.view_unchanged else true;
+        const view_unchanged = view.temporal_coherence and lods_unchanged and
+            list.last_view != null and std.meta.eql(list.last_view.?, view_key);
+
+        const key_count = self.models_count * lods_max_count;
+        self.key_offsets.resize(self.allocator, key_count) catch unreachable;
+        const key_offsets = self.key_offsets.items;
+        @memset(key_offsets, 0);
+
+        list.groups_culled = 0;
+        list.groups_reused = 0;
+        for (0..groups_count) |group| {
+            if (view_unchanged and self.group_versions.items[group] <= list.version) {
+                list.groups_reused += 1;
+            } else {
+                list.group_masks.items[group] = self.cullGroup(list, view, hysteresis, group * group_size);
+                list.groups_culled += 1;
+            }
+
+            var mask = list.group_masks.items[group];
+            while (mask != 0) : (mask &= mask - 1) {
+                key_offsets[self.sortKey(list, group * group_size + @ctz(mask))] += 1;
+            }
+        }
+
+        // Counting sort by key, keeping slot order within a batch.
+        list.batches.clearRetainingCapacity();
+        var visible_count: u32 = 0;
+        for (key_offsets, 0..) |*key_offset, key| {
+            const count = key_offset.*;
+            key_offset.* = visible_count;
+            if (count == 0) {
+                continue;
+            }
+
+            list.batches.append(self.allocator, .{
+                .model = @intCast(key / lods_max_count),
+                .lod = @intCast(key % lods_max_count),
+                .first = visible_count,
+                .count = count,
+            }) catch unreachable;
+            visible_count += count;
+        }
+
+        list.slots.resize(self.allocator, visible_count) catch unreachable;
+        for (list.group_masks.items[0..groups_count], 0..) |group_mask, group| {
+            var mask = group_mask;
+            while (mask != 0) : (mask &= mask - 1) {
+                const slot: u32 = @intCast(group * group_size + @ctz(mask));
+                const key = self.sortKey(list, slot);
+                list.slots.items[key_offsets[key]] = slot;
+                key_offsets[key] += 1;
+            }
+        }
+
+        list.instances_visible = visible_count;
+        list.version = self.version;
+        list.last_view = view_key;
+        list.view_unchanged = view_unchanged;
+    }
+
+    fn sortKey(self: *const DynamicVisibility, list: *const DrawList, slot: usize) usize {
+        return self.models.items[slot] * lods_max_count + list.lods.items[slot];
+    }
+
+    fn cullGroup(self: *const DynamicVisibility, list: *DrawList, view: VisibilityView, hysteresis: f32, first: usize) GroupMask {
+        const center_x: FloatGroup = self.center_x.items[first..][0..group_size].*;
+        const center_y: FloatGroup = self.center_y.items[first..][0..group_size].*;
+        const center_z: FloatGroup = self.center_z.items[first..][0..group_size].*;
+        const radius: FloatGroup = self.radius.items[first..][0..group_size].*;
+        const none: BoolGroup = @splat(false);
+
+        var visible: BoolGroup = @splat(true);
+        for (view.frustum_planes) |plane| {
+            const distance = @as(FloatGroup, @splat(plane[0])) * center_x +
+                @as(FloatGroup, @splat(plane[1])) * center_y +
+                @as(FloatGroup, @splat(plane[2])) * center_z +
+                @as(FloatGroup, @splat(plane[3]));
+            visible = @select(bool, visible, distance >= -radius, none);
+        }
+
+        const to_camera_x = center_x - @as(FloatGroup, @splat(view.camera_position[0]));
+        const to_camera_y = center_y - @as(FloatGroup, @splat(view.camera_position[1]));
+        const to_camera_z = center_z - @as(FloatGroup, @splat(view.camera_position[2]));
+        const distance_squared = to_camera_x * to_camera_x + to_camera_y * to_camera_y + to_camera_z * to_camera_z;
+        const max_distance_squared: FloatGroup = @splat(view.max_draw_distance * view.max_draw_distance);
+        visible = @select(bool, visible, distance_squared <= max_distance_squared, none);
+
+        const lods = list.lods.items[first..][0..group_size];
+        if (view.lod_source) |lod_source| {
+            lods.* = lod_source.lods.items[first..][0..group_size].*;
+        } else {
+            const distance = @sqrt(@max(distance_squared, @as(FloatGroup, @splat(1e-6))));
+            const screen_size = radius * @as(FloatGroup, @splat(view.projection_scale)) / distance;
+            const previous_lods: LodGroup = lods.*;
+            const ones: LodGroup = @splat(1);
+            const zeros: LodGroup = @splat(0);
+
+            // Past a threshold towards the side the instance was on last time has to go a bit further.
+            var selected_lods: LodGroup = zeros;
+            inline for (lod_screen_sizes, 0..) |screen_size_min, lod| {
+                const was_coarser = previous_lods > @as(LodGroup, @splat(lod));
+                const scale = @select(f32, was_coarser, @as(FloatGroup, @splat(1 + hysteresis)), @as(FloatGroup, @splat(1 - hysteresis)));
+                const coarser = screen_size < @as(FloatGroup, @splat(screen_size_min)) * scale;
+                selected_lods += @select(u8, coarser, ones, zeros);
+            }
+            const lod_counts: LodGroup = self.lod_counts.items[first..][0..group_size].*;
+            lods.* = @min(selected_lods, lod_counts - ones);
+        }
+
+        return @bitCast(visible);
+    }
+};
+
+// Scalar version of cullGroup for a single slot, without hysteresis.
+fn referenceCull(visibility: *const DynamicVisibility, view: VisibilityView, slot: u32) ?u8 {
+    const center = [3]f32{ visibility.center_x.items[slot], visibility.center_y.items[slot], visibility.center_z.items[slot] };
+    const radius = visibility.radius.items[slot];
+    for (view.frustum_planes) |plane| {
+        if (plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3] < -radius) {
+            return null;
+        }
+    }
+    var distance_squared: f32 = 0;
+    for (center, view.camera_position) |c, p| {
+        distance_squared += (c - p) * (c - p);
+    }
+    if (distance_squared > view.max_draw_distance * view.max_draw_distance) {
+        return null;
+    }
+
+    const screen_size = radius * view.projection_scale / @sqrt(@max(distance_squared, 1e-6));
+    var lod: u8 = 0;
+    for (lod_screen_sizes) |screen_size_min| {
+        lod += @intFromBool(screen_size < screen_size_min);
+    }
+    return @min(lod, visibility.lod_counts.items[slot] - 1);
+}
+
+fn expectMatchesReference(visibility: *const DynamicVisibility, list: *const DrawList, view: VisibilityView) !void {
+    var drawn = try std.DynamicBitSet.initEmpty(std.testing.allocator, visibility.radius.items.len);
+    defer drawn.deinit();
+
+    var previous_key: ?u32 = null;
+    for (list.batches.items) |batch| {
+        const key = batch.model * lods_max_count + batch.lod;
+        try expect(previous_key == null or previous_key.? < key);
+        previous_key = key;
+
+        const slots = list.batchSlots(batch);
+        try expect(slots.len > 0);
+        for (slots, 0..) |slot, i| {
+            try expect(i == 0 or slots[i - 1] < slot);
+            try expect(visibility.models.items[slot] == batch.model);
+            try expect(referenceCull(visibility, view, slot).? == batch.lod);
+            drawn.set(slot);
+        }
+    }
+
+    var visible_count: u32 = 0;
+    for (0..visibility.slots_count) |slot| {
+        const visible = referenceCull(visibility, view, @intCast(slot)) != null;
+        try expect(visible == drawn.isSet(slot));
+        visible_count += @intFromBool(visible);
+    }
+    try expect(list.instances_visible == visible_count);
+}
+
+// Looking down +z with a 90 degree fov.
+fn testView(camera_position: [3]f32) VisibilityView {
+    const s = std.math.sqrt1_2;
+    var view = VisibilityView{
+        .frustum_planes = .{
+            .{ s, 0, s, 0 },
+            .{ -s, 0, s, 0 },
+            .{ 0, -s, s, 0 },
+            .{ 0, s, s, 0 },
+        },
+        .camera_position = camera_position,
+        .projection_scale = 1,
+        .max_draw_distance = 300,
+        .lod_hysteresis = 0,
+    };
+    for (&view.frustum_planes) |*plane| {
+        plane[3] = -(plane[0] * camera_position[0] + plane[1] * camera_position[1] + plane[2] * camera_position[2]);
+    }
+    return view;
+}
+
+test "dynamic_visibility" {
+    const allocator = std.testing.allocator;
+    const visibility = DynamicVisibility.create(allocator);
+    defer visibility.destroy();
+
+    var rng = std.Random.DefaultPrng.init(1234);
+    const rand = rng.random();
+    const instance_count = 3000;
+    for (0..instance_count) |_| {
+        const slot = visibility.allocateSlot();
+        visibility.setModel(slot, rand.uintLessThan(u32, 5), rand.intRangeAtMost(u32, 1, lods_max_count));
+        visibility.setBounds(slot, .{
+            rand.float(f32) * 800 - 400,
+            rand.float(f32) * 40 - 20,
+            rand.float(f32) * 800 - 400,
+        }, 0.5 + rand.float(f32) * 4);
+    }
+    for (0..300) |i| {
+        visibility.freeSlot(@intCast(i * 7));
+    }
+    const groups_count: u32 = @intCast(visibility.radius.items.len / group_size);
+
+    // Without temporal coherence everything matches the reference.
+    var list = DrawList{};
+    defer list.deinit(allocator);
+    var view = testView(.{ 10, 2, -50 });
+    view.temporal_coherence = false;
+    visibility.cull(&list, view);
+    try expect(list.instances_visible > 0 and list.instances_visible < instance_count);
+    try expect(list.groups_reused == 0);
+    try expectMatchesReference(visibility, &list, view);
+
+    // Same view and nothing moved, every group is reused.
+    view.temporal_coherence = true;
+    var coherent_list = DrawList{};
+    defer coherent_list.deinit(allocator);
+    visibility.cull(&coherent_list, view);
+    try expect(coherent_list.groups_culled == groups_count);
+    visibility.cull(&coherent_list, view);
+    try expect(coherent_list.groups_reused == groups_count);
+    try expectMatchesReference(visibility, &coherent_list, view);
+
+    // Only the groups of what moved, came or went are culled again.
+    for (0..100) |_| {
+        const slot = rand.uintLessThan(u32, instance_count);
+        if (visibility.radius.items[slot] > 0) {
+            visibility.setBounds(slot, .{ rand.float(f32) * 100 - 50, 0, rand.float(f32) * 200 }, 1);
+        }
+    }
+    for (0..50) |_| {
+        const slot = rand.uintLessThan(u32, instance_count);
+        visibility.setBounds(slot, .{ visibility.center_x.items[slot], visibility.center_y.items[slot], visibility.center_z.items[slot] }, visibility.radius.items[slot]);
+    }
+    for (0..20) |i| {
+        visibility.freeSlot(@intCast(i * 7 + 1));
+    }
+    for (0..10) |_| {
+        const slot = visibility.allocateSlot();
+        visibility.setModel(slot, 2, 3);
+        visibility.setBounds(slot, .{ 0, 0, 40 }, 2);
+    }
+    visibility.cull(&coherent_list, view);
+    try expect(coherent_list.groups_reused > 0 and coherent_list.groups_culled < 150);
+    try expectMatchesReference(visibility, &coherent_list, view);
+
+    // A new view culls everything again.
+    view = testView(.{ -30, 5, 20 });
+    visibility.cull(&coherent_list, view);
+    try expect(coherent_list.groups_reused == 0);
+    try expectMatchesReference(visibility, &coherent_list, view);
+
+    // Borrowed LoDs are the source's, whatever the distance to the other view.
+    var shadow_list = DrawList{};
+    defer shadow_list.deinit(allocator);
+    var shadow_view = testView(.{ 0, 0, -1000 });
+    shadow_view.max_draw_distance = 2000;
+    shadow_view.lod_source = &coherent_list;
+    visibility.cull(&shadow_list, shadow_view);
+    try expect(shadow_list.instances_visible > 0);
+    for (shadow_list.batches.items) |batch| {
+        for (shadow_list.batchSlots(batch)) |slot| {
+            try expect(batch.lod == coherent_list.lods.items[slot]);
+        }
+    }
+}
+
+test "dynamic_visibility lod hysteresis" {
+    const allocator = std.testing.allocator;
+    const visibility = DynamicVisibility.create(allocator);
+    defer visibility.destroy();
+
+    const slot = visibility.allocateSlot();
+    visibility.setModel(slot, 0, lods_max_count);
+    var list = DrawList{};
+    defer list.deinit(allocator);
+    var view = testView(.{ 0, 0, 0 });
+    view.lod_hysteresis = 0.1;
+
+    // A screen size of 0.0476 is under the first threshold, but not by enough to leave LoD 0.
+    visibility.setBounds(slot, .{ 0, 0, 21 }, 1);
+    visibility.cull(&list, view);
+    try expect(list.batches.items.len == 1 and list.batches.items[0].lod == 0);
+
+    visibility.setBounds(slot, .{ 0, 0, 23 }, 1);
+    visibility.cull(&list, view);
+    try expect(list.batches.items[0].lod == 1);
+
+    // Coming back doesn't switch back either.
+    visibility.setBounds(slot, .{ 0, 0, 21 }, 1);
+    visibility.cull(&list, view);
+    try expect(list.batches.items[0].lod == 1);
+
+    view.temporal_coherence = false;
+    visibility.setBounds(slot, .{ 0, 0, 19 }, 1);
+    visibility.cull(&list, view);
+    try expect(list.batches.items[0].lod == 0);
+}
@@ -1,4 +1,6 @@
 const std = @import("std");
+const mapped_file = @import("mapped_file");
+const mesh_format = @import("mesh_format.zig");
 
 pub const sub_mesh_max_count: u32 = 16;
 pub const mesh_lod_max_count: u32 = 4;
@@ -39,17 +41,40 @@ pub const MeshData = struct {
     meshlet_vertices: std.ArrayList(u32),
     meshlet_triangles: std.ArrayList(MeshletTriangle),
     meshlet_bounds: std.ArrayList(MeshletBounds),
+
+    pub fn deinit(self: *MeshData) void {
+        self.positions_stream.deinit();
+        self.texcoords_stream.deinit();
+        self.normals_stream.deinit();
+        self.tangents_stream.deinit();
+        self.indices.deinit();
+        self.meshlets.deinit();
+        self.meshlet_vertices.deinit();
+        self.meshlet_triangles.deinit();
+        self.meshlet_bounds.deinit();
+    }
 };
 
 pub const MeshLoadDesc = struct {
     mesh_path: []const u8,
     allocator: std.mem.Allocator,
     mesh_data: *std.ArrayList(MeshData),
+    workers: ?*std.Thread.Pool = null, // Decodes v2 streams in parallel
 };
 
 pub fn loadMesh(load_desc: *MeshLoadDesc) void {
     var file = std.fs.cwd().openFile(load_desc.mesh_path, .{}) catch unreachable;
     defer file.close();
+
+    var file_magic: [mesh_format.file_magic.len]u8 = undefined;
+    const magic_length = file.preadAll(&file_magic, 0) catch unreachable;
+    if (mesh_format.isVersion2(file_magic[0..magic_length])) {
+        const mapping = mapped_file.mapFile(file, file.getEndPos() catch unreachable) orelse unreachable;
+        defer mapped_file.unmapFile(mapping);
+        mesh_format.decode(load_desc.allocator, mapping, load_desc.workers, load_desc.mesh_data) catch unreachable;
+        return;
+    }
+
     const reader = file.reader();
 
     var magic: [9]u8 = undefined;
@@ -125,45 +150,33 @@ pub fn loadMesh(load_desc: *MeshLoadDesc) void {
         read_length = reader.readAtLeast(std.mem.sliceAsBytes(mesh_data.meshlet_vertices.items), mesh_data.meshlet_vertices.items.len * @sizeOf(u32)) catch unreachable;
         std.debug.assert(read_length == mesh_data.meshlet_vertices.items.len * @sizeOf(u32));
 
-        var position_min = mesh_data.positions_stream.items[0];
-        var position_max = mesh_data.positions_stream.items[0];
-
-        for (1..mesh_data.positions_stream.items.len) |i| {
-            if (mesh_data.positions_stream.items[i][0] < position_min[0]) {
-                position_min[0] = mesh_data.positions_stream.items[i][0];
-            }
-
-            if (mesh_data.positions_stream.items[i][1] < position_min[1]) {
-                position_min[1] = mesh_data.positions_stream.items[i][1];
-            }
-
-            if (mesh_data.positions_stream.items[i][2] < position_min[2]) {
-                position_min[2] = mesh_data.positions_stream.items[i][2];
-            }
+        // NOTE: v2 files store the bounds, v1 meshes have to go through their positions.
+        mesh_data.bounds = computeBounds(mesh_data.positions_stream.items);
 
-            if (mesh_data.positions_stream.items[i][0] > position_max[0]) {
-                position_max[0] = mesh_data.positions_stream.items[i][0];
-            }
+        load_desc.mesh_data.append(mesh_data) catch unreachable;
+    }
+}
 
-            if (mesh_data.positions_stream.items[i][1] > position_max[1]) {
-                position_max[1] = mesh_data.positions_stream.items[i][1];
-            }
+pub fn computeBounds(positions: []const [3]f32) BoundingBox {
+    if (positions.len == 0) {
+        return .{ .center = .{ 0, 0, 0 }, .extents = .{ 0, 0, 0 } };
+    }
 
-            if (mesh_data.positions_stream.items[i][2] > position_max[2]) {
-                position_max[2] = mesh_data.positions_stream.items[i][2];
-            }
+    var position_min = positions[0];
+    var position_max = positions[0];
+    for (positions[1..]) |position| {
+        for (0..3) |i| {
+            position_min[i] = @min(position_min[i], position[i]);
+            position_max[i] = @max(position_max[i], position[i]);
         }
+    }
 
-        mesh_data.bounds.center[0] = (position_min[0] + position_max[0]) * 0.5;
-        mesh_data.bounds.center[1] = (position_min[1] + position_max[1]) * 0.5;
-        mesh_data.bounds.center[2] = (position_min[2] + position_max[2]) * 0.5;
-
-        mesh_data.bounds.extents[0] = (position_max[0] - position_min[0]) * 0.5;
-        mesh_data.bounds.extents[1] = (position_max[1] - position_min[1]) * 0.5;
-        mesh_data.bounds.extents[2] = (position_max[2] - position_min[2]) * 0.5;
-
-        load_desc.mesh_data.append(mesh_data) catch unreachable;
+    var bounds: BoundingBox = undefined;
+    for (0..3) |i| {
+        bounds.center[i] = (position_min[i] + position_max[i]) * 0.5;
+        bounds.extents[i] = (position_max[i] - position_min[i]) * 0.5;
     }
+    return bounds;
 }
 
 pub fn mergeBoundingBoxes(a: BoundingBox, b: BoundingBox) BoundingBox {
@@ -0,0 +1,553 @@
+const std = @import("std");
+const expect = std.testing.expect;
+
+// Assigns point lights to the clusters of the view frustum, so shading only walks the lights
+// that can reach a pixel.
+//
+// The frustum is cut into cluster_tiles_x by cluster_tiles_y screen tiles and cluster_slices
+// depth slices. The first slice goes out to first_slice_depth, the others split the rest up to
+// the far plane exponentially, so clusters stay roughly cube shaped. A light is in every cluster
+// whose tile planes and depth range its bounding sphere touches, which is conservative around
+// the corners of the clusters.
+//
+// Lights are bounded on threads in chunks, testing each against all the tile planes of a row or
+// column at once, then each depth slice gathers its lights on its own. The index lists are put
+// together in cluster order, the same on any number of threads.
+//
+// NOTE: The cluster layout is mirrored in deferred_shading.frag.hlsl.
+
+pub const cluster_tiles_x = 16;
+pub const cluster_tiles_y = 9;
+pub const cluster_slices = 24;
+pub const clusters_count = cluster_tiles_x * cluster_tiles_y * cluster_slices;
+pub const first_slice_depth = 5.0;
+pub const light_indices_max_count = 2 * 1024 * 1024;
+
+pub const LightSphere = struct {
+    center: [3]f32,
+    radius: f32,
+};
+
+// Offset and count of a cluster's lights in light_indices, read as a uint2 by the shader.
+pub const ClusterLights = extern struct {
+    offset: u32,
+    count: u32,
+};
+
+pub const ClusterView = struct {
+    // Row-major, transforms row vectors, like zm.storeMat of the renderer's matrices.
+    view: [16]f32,
+    projection: [16]f32,
+    near_plane: f32,
+    far_plane: f32,
+    // Where the point lights start in the light buffer.
+    light_index_offset: u32 = 0,
+};
+
+// Slice of a view space depth is floor(log2(depth) * scale + bias), clamped.
+pub fn depthSliceParams(far_plane: f32) [2]f32 {
+    const scale = (cluster_slices - 1) / std.math.log2(far_plane / first_slice_depth);
+    const bias = 1 - std.math.log2(@as(f32, first_slice_depth)) * scale;
+    return .{ scale, bias };
+}
+
+// Planes through the eye bounding a row or column of tiles. A plane's distance is
+// along * (x or y) + depth * z in view space, positive past it towards the end of the row.
+fn TilePlanes(comptime count: usize) type {
+    return struct {
+        const V = @Vector(count, f32);
+
+        start_along: V,
+        start_depth: V,
+        end_along: V,
+        end_depth: V,
+
+        // boundaries are in NDC, from the first tile's start to the last tile's end.
+        fn init(boundaries: [count + 1]f32, along_sign: f32, projection_scale: f32) @This() {
+            var along: [count + 1]f32 = undefined;
+            var depth: [count + 1]f32 = undefined;
+            for (boundaries, 0..) |boundary, i| {
+                const slope = boundary / projection_scale;
+                const length = @sqrt(1 + slope * slope);
+                along[i] = along_sign / length;
+                depth[i] = -along_sign * slope / length;
+            }
+            return .{
+                .start_along = along[0..count].*,
+                .start_depth = depth[0..count].*,
+                .end_along = along[1..].*,
+                .end_depth = depth[1..].*,
+            };
+        }
+
+        // First and last tile the sphere touches.
+        fn range(self: @This(), along: f32, depth: f32, radius: f32) ?[2]u8 {
+            const Mask = std.meta.Int(.unsigned, count);
+            const start_distance = self.start_along * @as(V, @splat(along)) + self.start_depth * @as(V, @splat(depth));
+            const end_distance = self.end_along * @as(V, @splat(along)) + self.end_depth * @as(V, @splat(depth));
+            const after_start: Mask = @bitCast(start_distance >= @as(V, @splat(-radius)));
+            const before_end: Mask = @bitCast(end_distance <= @as(V, @splat(radius)));
+            const mask = after_start & before_end;
+            if (mask == 0) {
+                return null;
+            }
+            return .{ @ctz(mask), @intCast(count - 1 - @clz(mask)) };
+        }
+    };
+}
+
+const ColumnPlanes = TilePlanes(cluster_tiles_x);
+const RowPlanes = TilePlanes(cluster_tiles_y);
+
+pub const LightClusterer = struct {
+    const lights_per_chunk = 1024;
+
+    // Clusters a light touches, inclusive. Lights outside the view have visible false.
+    const LightBounds = struct {
+        x: [2]u8 = .{ 0, 0 },
+        y: [2]u8 = .{ 0, 0 },
+        z: [2]u8 = .{ 0, 0 },
+        visible: bool = false,
+    };
+
+    const SliceLights = struct {
+        clusters: [cluster_tiles_x * cluster_tiles_y]ClusterLights = undefined,
+        indices: std.ArrayListUnmanaged(u32) = .{},
+        lights: std.ArrayListUnmanaged(u32) = .{},
+    };
+
+    allocator: std.mem.Allocator,
+    workers: ?*std.Thread.Pool = null,
+    worker_count: u32 = 0,
+    next_chunk: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+    next_slice: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+    lights: []const LightSphere = &.{},
+    view: ClusterView = undefined,
+    column_planes: ColumnPlanes = undefined,
+    row_planes: RowPlanes = undefined,
+    depth_slice_params: [2]f32 = .{ 0, 0 },
+    light_bounds: std.ArrayListUnmanaged(LightBounds) = .{},
+    slices: [cluster_slices]SliceLights = [_]SliceLights{.{}} ** cluster_slices,
+
+    // Results of the last assign, ready to upload.
+    cluster_lights: [clusters_count]ClusterLights = undefined,
+    light_indices: std.ArrayListUnmanaged(u32) = .{},
+    lights_visible: u32 = 0,
+    dropped_indices_count: u32 = 0, // Past light_indices_max_count
+
+    // Borrows workers, the job system's frame pool in the game. Without workers everything
+    // runs on the calling thread.
+    pub fn create(allocator: std.mem.Allocator, workers: ?*std.Thread.Pool) *LightClusterer {
+        const self = allocator.create(LightClusterer) catch unreachable;
+        self.* = .{ .allocator = allocator, .workers = workers };
+        if (workers) |pool| {
+            self.worker_count = @intCast(pool.threads.len);
+        }
+        return self;
+    }
+
+    pub fn destroy(self: *LightClusterer) void {
+        for (&self.slices) |*slice| {
+            slice.indices.deinit(self.allocator);
+            slice.lights.deinit(self.allocator);
+        }
+        self.light_bounds.deinit(self.allocator);
+        self.light_indices.deinit(self.allocator);
+        self.allocator.destroy(self);
+    }
+
+    pub fn assign(self: *LightClusterer, lights: []const LightSphere, view: ClusterView) void {
+        self.lights = lights;
+        self.view = view;
+        self.depth_slice_params = depthSliceParams(view.far_plane);
+
+        var column_boundaries: [cluster_tiles_x + 1]f32 = undefined;
+        for (&column_boundaries, 0..) |*boundary, i| {
+            boundary.* = -1 + 2 * @as(f32, @floatFromInt(i)) / cluster_tiles_x;
+        }
+        // Rows go down the screen like pixels do.
+        var row_boundaries: [cluster_tiles_y + 1]f32 = undefined;
+        for (&row_boundaries, 0..) |*boundary, i| {
+            boundary.* = 1 - 2 * @as(f32, @floatFromInt(i)) / cluster_tiles_y;
+        }
+        self.column_planes = ColumnPlanes.init(column_boundaries, 1, view.projection[0]);
+        self.row_planes = RowPlanes.init(row_boundaries, -1, view.projection[5]);
+
+        self.light_bounds.resize(self.allocator, lights.len) catch unreachable;
+        const chunk_count = std.math.divCeil(usize, lights.len, lights_per_chunk) catch unreachable;
+        self.next_chunk.store(0, .monotonic);
+        self.runParallel(chunk_count, boundLights);
+        self.next_slice.store(0, .monotonic);
+        self.runParallel(cluster_slices, gatherSlices);
+
+        self.light_indices.clearRetainingCapacity();
+        self.dropped_indices_count = 0;
+        for (&self.slices, 0..) |*slice, slice_index| {
+            const slice_offset: u32 = @intCast(self.light_indices.items.len);
+            const indices_left = light_indices_max_count - slice_offset;
+            const indices = slice.indices.items[0..@min(slice.indices.items.len, indices_left)];
+            self.light_indices.appendSlice(self.allocator, indices) catch unreachable;
+            self.dropped_indices_count += @intCast(slice.indices.items.len - indices.len);
+
+            const clusters = self.cluster_lights[slice_index * slice.clusters.len ..][0..slice.clusters.len];
+            for (clusters, slice.clusters) |*cluster, slice_cluster| {
+                const offset = @min(slice_cluster.offset, indices.len);
+                const count = @min(slice_cluster.count, indices.len - offset);
+                cluster.* = .{ .offset = slice_offset + @as(u32, @intCast(offset)), .count = @intCast(count) };
+            }
+        }
+
+        self.lights_visible = 0;
+        for (self.light_bounds.items) |bounds| {
+            self.lights_visible += @intFromBool(bounds.visible);
+        }
+    }
+
+    pub fn clusterIndex(x: usize, y: usize, slice: usize) usize {
+        return (slice * cluster_tiles_y + y) * cluster_tiles_x + x;
+    }
+
+    pub fn depthSlice(self: *const LightClusterer, depth: f32) u8 {
+        const slice = @floor(std.math.log2(@max(depth, self.view.near_plane)) * self.depth_slice_params[0] + self.depth_slice_params[1]);
+        return @intFromFloat(std.math.clamp(slice, 0, cluster_slices - 1));
+    }
+
+    fn runParallel(self: *LightClusterer, job_count: usize, comptime work: fn (*LightClusterer) void) void {
+        if (self.workers != null and job_count > 1) {
+            // The calling thread works too, so one helper fewer is enough.
+            var wait_group: std.Thread.WaitGroup = .{};
+            for (0..@min(self.worker_count, job_count - 1)) |_| {
+                self.workers.?.spawnWg(&wait_group, work, .{self});
+            }
+            work(self);
+            self.workers.?.waitAndWork(&wait_group);
+        } else {
+            work(self);
+        }
+    }
+
+    fn boundLights(self: *LightClusterer) void {
+        while (true) {
+            const first_light = self.next_chunk.fetchAdd(1, .monotonic) * lights_per_chunk;
+            if (first_light >= self.lights.len) {
+                return;
+            }
+            const last_light = @min(first_light + lights_per_chunk, self.lights.len);
+            for (self.lights[first_light..last_light], self.light_bounds.items[first_light..last_light]) |light, *bounds| {
+                bounds.* = self.boundLight(light);
+            }
+        }
+    }
+
+    fn boundLight(self: *const LightClusterer, light: LightSphere) LightBounds {
+        const m = self.view.view;
+        const c = light.center;
+        const view_x = c[0] * m[0] + c[1] * m[4] + c[2] * m[8] + m[12];
+        const view_y = c[0] * m[1] + c[1] * m[5] + c[2] * m[9] + m[13];
+        const view_z = c[0] * m[2] + c[1] * m[6] + c[2] * m[10] + m[14];
+        if (view_z + light.radius < self.view.near_plane or view_z - light.radius > self.view.far_plane) {
+            return .{};
+        }
+
+        const x = self.column_planes.range(view_x, view_z, light.radius) orelse return .{};
+        const y = self.row_planes.range(view_y, view_z, light.radius) orelse return .{};
+        return .{
+            .x = x,
+            .y = y,
+            .z = .{ self.depthSlice(view_z - light.radius), self.depthSlice(view_z + light.radius) },
+            .visible = true,
+        };
+    }
+
+    // Counts the lights of every cluster in a slice first, then writes their indices.
+    fn gatherSlices(self: *LightClusterer) void {
+        while (true) {
+            const slice_index = self.next_slice.fetchAdd(1, .monotonic);
+            if (slice_index >= cluster_slices) {
+                return;
+            }
+            const slice = &self.slices[slice_index];
+            slice.lights.clearRetainingCapacity();
+            for (self.light_bounds.items, 0..) |bounds, light_index| {
+                if (bounds.visible and bounds.z[0] <= slice_index and slice_index <= bounds.z[1]) {
+                    slice.lights.append(self.allocator, @intCast(light_index)) catch unreachable;
+                }
+            }
+
+            for (&slice.clusters) |*cluster| {
+                cluster.* = .{ .offset = 0, .count = 0 };
+            }
+            for (slice.lights.items) |light_index| {
+                const bounds = self.light_bounds.items[light_index];
+                for (bounds.y[0]..@as(usize, bounds.y[1]) + 1) |y| {
+                    for (bounds.x[0]..@as(usize, bounds.x[1]) + 1) |x| {
+                        slice.clusters[y * cluster_tiles_x + x].count += 1;
+                    }
+                }
+            }
+
+            var offset: u32 = 0;
+            for (&slice.clusters) |*cluster| {
+                cluster.offset = offset;
+                offset += cluster.count;
+                cluster.count = 0;
+            }
+            slice.indices.resize(self.allocator, offset) catch unreachable;
+            for (slice.lights.items) |light_index| {
+                const bounds = self.light_bounds.items[light_index];
+                for (bounds.y[0]..@as(usize, bounds.y[1]) + 1) |y| {
+                    for (bounds.x[0]..@as(usize, bounds.x[1]) + 1) |x| {
+                        const cluster = &slice.clusters[y * cluster_tiles_x + x];
+                        slice.indices.items[cluster.offset + cluster.count] = light_index + self.view.light_index_offset;
+                        cluster.count += 1;
+                    }
+                }
+            }
+        }
+    }
+};
+
+// Reference for the clusterer, tests every light against every cluster one at a time. The
+// clusters are built from the view frustum itself: the corners of a cluster's screen tile are
+// unprojected with the inverse projection and its depth range follows the slice layout above,
+// without the clusterer's tile planes or depth slice math. radius_margin is added to every
+// light's radius, so a test can allow for rounding on either side of a plane.
+pub fn assignBruteForce(
+    allocator: std.mem.Allocator,
+    view: ClusterView,
+    lights: []const LightSphere,
+    radius_margin: f32,
+    cluster_lights: *std.ArrayList(std.ArrayListUnmanaged(u32)),
+) void {
+    const inverse_projection = invertMatrix(view.projection);
+    const m = view.view;
+    for (0..clusters_count) |cluster_index| {
+        const x = cluster_index % cluster_tiles_x;
+        const y = cluster_index / cluster_tiles_x % cluster_tiles_y;
+        const slice = cluster_index / (cluster_tiles_x * cluster_tiles_y);
+
+        // Tile corners in NDC, rows go down the screen.
+        const left = -1 + 2 * @as(f32, @floatFromInt(x)) / cluster_tiles_x;
+        const right = -1 + 2 * @as(f32, @floatFromInt(x + 1)) / cluster_tiles_x;
+        const top = 1 - 2 * @as(f32, @floatFromInt(y)) / cluster_tiles_y;
+        const bottom = 1 - 2 * @as(f32, @floatFromInt(y + 1)) / cluster_tiles_y;
+        const top_left = unprojectRay(inverse_projection, left, top);
+        const top_right = unprojectRay(inverse_projection, right, top);
+        const bottom_right = unprojectRay(inverse_projection, right, bottom);
+        const bottom_left = unprojectRay(inverse_projection, left, bottom);
+        const center = unprojectRay(inverse_projection, (left + right) / 2, (top + bottom) / 2);
+        const side_planes = [_][3]f32{
+            sidePlane(top_left, bottom_left, center),
+            sidePlane(top_right, bottom_right, center),
+            sidePlane(top_left, top_right, center),
+            sidePlane(bottom_left, bottom_right, center),
+        };
+        const depth_range = sliceDepthRange(view, slice);
+
+        var list = std.ArrayListUnmanaged(u32){};
+        light_loop: for (lights, 0..) |light, light_index| {
+            const c = light.center;
+            const view_position = [3]f32{
+                c[0] * m[0] + c[1] * m[4] + c[2] * m[8] + m[12],
+                c[0] * m[1] + c[1] * m[5] + c[2] * m[9] + m[13],
+                c[0] * m[2] + c[1] * m[6] + c[2] * m[10] + m[14],
+            };
+            const r = light.radius + radius_margin;
+            if (view_position[2] + r < view.near_plane or view_position[2] - r > view.far_plane) {
+                continue;
+            }
+            if (view_position[2] + r < depth_range[0] or view_position[2] - r > depth_range[1]) {
+                continue;
+            }
+            for (side_planes) |plane| {
+                if (dot(plane, view_position) < -r) {
+                    continue :light_loop;
+                }
+            }
+            list.append(allocator, @as(u32, @intCast(light_index)) + view.light_index_offset) catch unreachable;
+        }
+        cluster_lights.append(list) catch unreachable;
+    }
+}
+
+// Slice 0 runs from the near plane to first_slice_depth, the others split the rest up to the
+// far plane exponentially.
+fn sliceDepthRange(view: ClusterView, slice: usize) [2]f32 {
+    if (slice == 0) {
+        return .{ view.near_plane, first_slice_depth };
+    }
+    const ratio = view.far_plane / first_slice_depth;
+    const start: f32 = @floatFromInt(slice - 1);
+    const end: f32 = @floatFromInt(slice);
+    return .{
+        first_slice_depth * std.math.pow(f32, ratio, start / (cluster_slices - 1)),
+        first_slice_depth * std.math.pow(f32, ratio, end / (cluster_slices - 1)),
+    };
+}
+
+// View space direction through an NDC position, scaled to a depth of 1.
+fn unprojectRay(inverse_projection: [16]f32, ndc_x: f32, ndc_y: f32) [3]f32 {
+    const clip = [4]f32{ ndc_x, ndc_y, 0.5, 1 };
+    var position: [4]f32 = .{ 0, 0, 0, 0 };
+    for (0..4) |column| {
+        for (0..4) |row| {
+            position[column] += clip[row] * inverse_projection[row * 4 + column];
+        }
+    }
+    return .{ position[0] / position[2], position[1] / position[2], 1 };
+}
+
+// Unit normal of the plane through the eye and two tile corners, facing the tile's center.
+fn sidePlane(a: [3]f32, b: [3]f32, center: [3]f32) [3]f32 {
+    var normal = [3]f32{
+        a[1] * b[2] - a[2] * b[1],
+        a[2] * b[0] - a[0] * b[2],
+        a[0] * b[1] - a[1] * b[0],
+    };
+    const sign: f32 = if (dot(normal, center) < 0) -1 else 1;
+    const length = @sqrt(dot(normal, normal));
+    for (&normal) |*value| {
+        value.* *= sign / length;
+    }
+    return normal;
+}
+
+fn dot(a: [3]f32, b: [3]f32) f32 {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Gauss-Jordan elimination with partial pivoting, the matrix has to be invertible.
+fn invertMatrix(matrix: [16]f32) [16]f32 {
+    var a: [4][8]f64 = undefined;
+    for (0..4) |row| {
+        for (0..4) |column| {
+            a[row][column] = matrix[row * 4 + column];
+            a[row][column + 4] = if (row == column) 1 else 0;
+        }
+    }
+    for (0..4) |column| {
+        var pivot = column;
+        for (column + 1..4) |row| {
+            if (@abs(a[row][column]) > @abs(a[pivot][column])) {
+                pivot = row;
+            }
+        }
+        std.mem.swap([8]f64, &a[column], &a[pivot]);
+        const pivot_value = a[column][column];
+        for (&a[column]) |*value| {
+            value.* /= pivot_value;
+        }
+        for (0..4) |row| {
+            if (row == column) {
+                continue;
+            }
+            const factor = a[row][column];
+            for (0..8) |i| {
+                a[row][i] -= factor * a[column][i];
+            }
+        }
+    }
+    var inverse: [16]f32 = undefined;
+    for (0..4) |row| {
+        for (0..4) |column| {
+            inverse[row * 4 + column] = @floatCast(a[row][column + 4]);
+        }
+    }
+    return inverse;
+}
+
+test "light_clustering" {
+    const allocator = std.testing.allocator;
+    var rng = std.Random.DefaultPrng.init(99);
+    const rand = rng.random();
+
+    // Camera at the origin looking down +z, reversed Z perspective with a 90 degree vertical fov.
+    const aspect = 16.0 / 9.0;
+    const near = 0.1;
+    const far = 1000.0;
+    const r = near / (near - far);
+    var view = ClusterView{
+        .view = .{ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 },
+        .projection = .{ 1 / aspect, 0, 0, 0, 0, 1, 0, 0, 0, 0, r, 1, 0, 0, -r * far, 0 },
+        .near_plane = near,
+        .far_plane = far,
+        .light_index_offset = 2,
+    };
+
+    var lights: [3000]LightSphere = undefined;
+    for (&lights) |*light| {
+        light.* = .{
+            .center = .{ rand.float(f32) * 400 - 200, rand.float(f32) * 40 - 20, rand.float(f32) * 300 - 20 },
+            .radius = 0.5 + rand.float(f32) * 15,
+        };
+    }
+    // Far to the left, behind the camera and past the far plane.
+    lights[0] = .{ .center = .{ -500, 0, 10 }, .radius = 5 };
+    lights[1] = .{ .center = .{ 0, 0, -50 }, .radius = 5 };
+    lights[2] = .{ .center = .{ 0, 0, 2000 }, .radius = 5 };
+
+    // The clusterer has to find every light that touches a cluster by a bit more than rounding,
+    // and nothing that misses it by more than that.
+    const radius_margin = 0.01;
+    var required = std.ArrayList(std.ArrayListUnmanaged(u32)).init(allocator);
+    var allowed = std.ArrayList(std.ArrayListUnmanaged(u32)).init(allocator);
+    defer {
+        for (required.items, allowed.items) |*required_list, *allowed_list| {
+            required_list.deinit(allocator);
+            allowed_list.deinit(allocator);
+        }
+        required.deinit();
+        allowed.deinit();
+    }
+    assignBruteForce(allocator, view, &lights, -radius_margin, &required);
+    assignBruteForce(allocator, view, &lights, radius_margin, &allowed);
+
+    var required_total: usize = 0;
+    var allowed_total: usize = 0;
+    for (required.items, allowed.items) |required_list, allowed_list| {
+        required_total += required_list.items.len;
+        allowed_total += allowed_list.items.len;
+    }
+    try expect(required_total > 0);
+    try expect(allowed_total - required_total < required_total / 100);
+
+    var pool: std.Thread.Pool = undefined;
+    try pool.init(.{ .allocator = allocator, .n_jobs = 3 });
+    defer pool.deinit();
+    for ([_]?*std.Thread.Pool{ null, &pool }) |workers| {
+        const clusterer = LightClusterer.create(allocator, workers);
+        defer clusterer.destroy();
+        clusterer.assign(&lights, view);
+        try expect(clusterer.dropped_indices_count == 0);
+
+        for (required.items, allowed.items, clusterer.cluster_lights) |required_list, allowed_list, cluster| {
+            const indices = clusterer.light_indices.items[cluster.offset..][0..cluster.count];
+            try expect(std.sort.isSorted(u32, indices, {}, std.sort.asc(u32)));
+            for (required_list.items) |light_index| {
+                try expect(std.mem.indexOfScalar(u32, indices, light_index) != null);
+            }
+            for (indices) |light_index| {
+                try expect(std.mem.indexOfScalar(u32, allowed_list.items, light_index) != null);
+            }
+        }
+        try expect(std.mem.indexOfScalar(u32, clusterer.light_indices.items, 0 + 2) == null);
+        try expect(std.mem.indexOfScalar(u32, clusterer.light_indices.items, 1 + 2) == null);
+        try expect(std.mem.indexOfScalar(u32, clusterer.light_indices.items, 2 + 2) == null);
+        try expect(clusterer.lights_visible < lights.len - 3);
+    }
+
+    // A small light straight ahead only lands in the middle tiles at its depth.
+    view.light_index_offset = 0;
+    const clusterer = LightClusterer.create(allocator, null);
+    defer clusterer.destroy();
+    // In the middle of a depth slice, so it doesn't spill into the next one.
+    const ahead = [_]LightSphere{.{ .center = .{ 0, 0, 44.6 }, .radius = 0.5 }};
+    clusterer.assign(&ahead, view);
+    const slice = clusterer.depthSlice(44.6);
+    try expect(slice == clusterer.depthSlice(44.1) and slice == clusterer.depthSlice(45.1));
+    try expect(clusterer.light_indices.items.len == 2);
+    for ([_]usize{ 7, 8 }) |x| {
+        try expect(clusterer.cluster_lights[LightClusterer.clusterIndex(x, 4, slice)].count == 1);
+    }
+    try expect(clusterer.cluster_lights[LightClusterer.clusterIndex(6, 4, slice)].count == 0);
+}
@@ -0,0 +1,656 @@
+const std = @import("std");
+const geometry = @import("geometry.zig");
+
+const BoundingBox = geometry.BoundingBox;
+const MeshData = geometry.MeshData;
+
+// TidesMesh v2. The file is memory mapped and every stream decoded on its own, so the meshes of
+// a file decode in parallel and nothing is read through a stream reader. Streams are quantized
+// (16 bit positions in the mesh's bounds, octahedral normals and tangents, half texcoords, 16 bit
+// indices when they fit) and can be zstd compressed, the renderer dequantizes them back into the
+// f32 streams the shaders read.
+//
+//   FileHeader
+//   MeshHeader * mesh_count
+//   padding up to data_offset, a page boundary
+//   streams, each starting on a stream_alignment boundary
+
+pub const version: u32 = 2;
+pub const data_alignment = 4096;
+pub const stream_alignment = 16;
+
+// v1 files follow "TidesMesh" with their mesh count as a u64, which is never zero.
+pub const file_magic = [16]u8{ 'T', 'i', 'd', 'e', 's', 'M', 'e', 's', 'h', 0, 0, 0, 0, 0, 0, 0 };
+
+pub const FileHeader = extern struct {
+    magic: [16]u8,
+    version: u32,
+    mesh_count: u32,
+    data_offset: u64,
+};
+
+pub const Stream = enum(u32) {
+    indices,
+    positions,
+    texcoords,
+    normals,
+    tangents,
+    meshlets,
+    meshlet_bounds,
+    meshlet_triangles,
+    meshlet_vertices,
+};
+pub const stream_count = @typeInfo(Stream).@"enum".fields.len;
+
+pub const Codec = enum(u32) {
+    none,
+    zstd,
+    _,
+};
+
+pub const StreamDesc = extern struct {
+    offset: u64, // From the start of the file
+    size: u32, // Bytes in the file
+    decoded_size: u32, // Bytes once decompressed, still quantized
+    codec: Codec,
+    _padding: u32 = 0,
+};
+
+pub const MeshHeader = extern struct {
+    bounds_center: [3]f32,
+    bounds_extents: [3]f32,
+    index_count: u32,
+    positions_count: u32,
+    texcoords_count: u32,
+    normals_count: u32,
+    tangents_count: u32,
+    meshlets_count: u32, // Also the meshlet bounds count
+    meshlet_triangles_count: u32,
+    meshlet_vertices_count: u32,
+    index_size: u32, // 2 or 4 bytes, for the indices and the meshlet vertices
+    _padding: u32 = 0,
+    streams: [stream_count]StreamDesc,
+
+    pub fn boundingBox(self: MeshHeader) BoundingBox {
+        return .{ .center = self.bounds_center, .extents = self.bounds_extents };
+    }
+
+    fn elementCount(self: MeshHeader, stream: Stream) u32 {
+        return switch (stream) {
+            .indices => self.index_count,
+            .positions => self.positions_count,
+            .texcoords => self.texcoords_count,
+            .normals => self.normals_count,
+            .tangents => self.tangents_count,
+            .meshlets, .meshlet_bounds => self.meshlets_count,
+            .meshlet_triangles => self.meshlet_triangles_count,
+            .meshlet_vertices => self.meshlet_vertices_count,
+        };
+    }
+
+    fn elementSize(self: MeshHeader, stream: Stream) u32 {
+        return switch (stream) {
+            .indices, .meshlet_vertices => self.index_size,
+            .positions => @sizeOf(QuantizedPosition),
+            .texcoords => @sizeOf(QuantizedTexcoord),
+            .normals => @sizeOf(QuantizedNormal),
+            .tangents => @sizeOf(QuantizedTangent),
+            .meshlets => @sizeOf(geometry.Meshlet),
+            .meshlet_bounds => @sizeOf(geometry.MeshletBounds),
+            .meshlet_triangles => @sizeOf(geometry.MeshletTriangle),
+        };
+    }
+
+    // Streams the renderer uses as they are stored, decompressed straight into the mesh data.
+    fn isStoredRaw(self: MeshHeader, stream: Stream) bool {
+        return switch (stream) {
+            .indices, .meshlet_vertices => self.index_size == @sizeOf(u32),
+            .meshlets, .meshlet_bounds, .meshlet_triangles => true,
+            .positions, .texcoords, .normals, .tangents => false,
+        };
+    }
+};
+
+pub const QuantizedPosition = [3]u16;
+pub const QuantizedTexcoord = [2]f16;
+pub const QuantizedNormal = [2]i16;
+pub const QuantizedTangent = packed struct(u32) {
+    x: i16,
+    y: i15,
+    bitangent_negative: bool,
+};
+
+pub fn isVersion2(bytes: []const u8) bool {
+    return bytes.len >= file_magic.len and std.mem.eql(u8, bytes[0..file_magic.len], &file_magic);
+}
+
+// ██████╗ ██╗   ██╗ █████╗ ███╗   ██╗████████╗██╗███████╗███████╗
+// ██╔═══██╗██║   ██║██╔══██╗████╗  ██║╚══██╔══╝██║╚══███╔╝██╔════╝
+// ██║   ██║██║   ██║███████║██╔██╗ ██║   ██║   ██║  ███╔╝ █████╗
+// ██║▄▄ ██║██║   ██║██╔══██║██║╚██╗██║   ██║   ██║ ███╔╝  ██╔══╝
+// ╚██████╔╝╚██████╔╝██║  ██║██║ ╚████║   ██║   ██║███████╗███████╗
+//  ╚══▀▀═╝  ╚═════╝ ╚═╝  ╚═╝╚═╝  ╚═══╝   ╚═╝   ╚═╝╚══════╝╚══════╝
+
+pub fn quantizePosition(position: [3]f32, bounds: BoundingBox) QuantizedPosition {
+    var result: QuantizedPosition = undefined;
+    for (0..3) |i| {
+        const range = bounds.extents[i] * 2;
+        const t = if (range > 0) (position[i] - (bounds.center[i] - bounds.extents[i])) / range else 0;
+        result[i] = @intFromFloat(@round(std.math.clamp(t, 0, 1) * std.math.maxInt(u16)));
+    }
+    return result;
+}
+
+pub fn dequantizePosition(position: QuantizedPosition, bounds: BoundingBox) [3]f32 {
+    var result: [3]f32 = undefined;
+    for (0..3) |i| {
+        const scale = bounds.extents[i] * 2 / std.math.maxInt(u16);
+        result[i] = bounds.center[i] - bounds.extents[i] + @as(f32, @floatFromInt(position[i])) * scale;
+    }
+    return result;
+}
+
+fn signNotZero(value: f32) f32 {
+    return if (value >= 0) 1 else -1;
+}
+
+// Maps a unit vector onto the octahedron and folds the lower half over the upper one.
+pub fn octahedralEncode(vector: [3]f32) [2]f32 {
+    const length = @abs(vector[0]) + @abs(vector[1]) + @abs(vector[2]);
+    if (length == 0) {
+        return .{ 0, 0 };
+    }
+
+    const x = vector[0] / length;
+    const y = vector[1] / length;
+    if (vector[2] >= 0) {
+        return .{ x, y };
+    }
+    return .{ (1 - @abs(y)) * signNotZero(x), (1 - @abs(x)) * signNotZero(y) };
+}
+
+pub fn octahedralDecode(encoded: [2]f32) [3]f32 {
+    var vector = [3]f32{ encoded[0], encoded[1], 1 - @abs(encoded[0]) - @abs(encoded[1]) };
+    if (vector[2] < 0) {
+        const x = (1 - @abs(vector[1])) * signNotZero(vector[0]);
+        vector[1] = (1 - @abs(vector[0])) * signNotZero(vector[1]);
+        vector[0] = x;
+    }
+    const length = @sqrt(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+    return .{ vector[0] / length, vector[1] / length, vector[2] / length };
+}
+
+fn snorm(comptime T: type, value: f32) T {
+    return @intFromFloat(@round(std.math.clamp(value, -1, 1) * std.math.maxInt(T)));
+}
+
+fn unsnorm(value: anytype) f32 {
+    return @max(@as(f32, @floatFromInt(value)) / std.math.maxInt(@TypeOf(value)), -1);
+}
+
+pub fn quantizeNormal(normal: [3]f32) QuantizedNormal {
+    const encoded = octahedralEncode(normal);
+    return .{ snorm(i16, encoded[0]), snorm(i16, encoded[1]) };
+}
+
+pub fn dequantizeNormal(normal: QuantizedNormal) [3]f32 {
+    return octahedralDecode(.{ unsnorm(normal[0]), unsnorm(normal[1]) });
+}
+
+pub fn quantizeTangent(tangent: [4]f32) QuantizedTangent {
+    const encoded = octahedralEncode(tangent[0..3].*);
+    return .{ .x = snorm(i16, encoded[0]), .y = snorm(i15, encoded[1]), .bitangent_negative = tangent[3] < 0 };
+}
+
+pub fn dequantizeTangent(tangent: QuantizedTangent) [4]f32 {
+    const decoded = octahedralDecode(.{ unsnorm(tangent.x), unsnorm(tangent.y) });
+    return .{ decoded[0], decoded[1], decoded[2], if (tangent.bitangent_negative) -1 else 1 };
+}
+
+// ███████╗███╗   ██╗ ██████╗ ██████╗ ██████╗ ███████╗
+// ██╔════╝████╗  ██║██╔════╝██╔═══██╗██╔══██╗██╔════╝
+// █████╗  ██╔██╗ ██║██║     ██║   ██║██║  ██║█████╗
+// ██╔══╝  ██║╚██╗██║██║     ██║   ██║██║  ██║██╔══╝
+// ███████╗██║ ╚████║╚██████╗╚██████╔╝██████╔╝███████╗
+// ╚══════╝╚═╝  ╚═══╝ ╚═════╝ ╚═════╝ ╚═════╝ ╚══════╝
+
+// Lays meshes out as a v2 file with every stream uncompressed. The model converter writes the
+// same layout and zstd compresses the streams that get smaller.
+pub fn encode(allocator: std.mem.Allocator, meshes: []const MeshData, output: *std.ArrayList(u8)) void {
+    const headers = allocator.alloc(MeshHeader, meshes.len) catch unreachable;
+    defer allocator.free(headers);
+
+    const data_offset = std.mem.alignForward(usize, @sizeOf(FileHeader) + meshes.len * @sizeOf(MeshHeader), data_alignment);
+    output.clearRetainingCapacity();
+    output.appendNTimes(0, data_offset) catch unreachable;
+
+    for (meshes, headers) |mesh, *header| {
+        const bounds = geometry.computeBounds(mesh.positions_stream.items);
+        header.* = .{
+            .bounds_center = bounds.center,
+            .bounds_extents = bounds.extents,
+            .index_count = @intCast(mesh.indices.items.len),
+            .positions_count = @intCast(mesh.positions_stream.items.len),
+            .texcoords_count = @intCast(mesh.texcoords_stream.items.len),
+            .normals_count = @intCast(mesh.normals_stream.items.len),
+            .tangents_count = @intCast(mesh.tangents_stream.items.len),
+            .meshlets_count = @intCast(mesh.meshlets.items.len),
+            .meshlet_triangles_count = @intCast(mesh.meshlet_triangles.items.len),
+            .meshlet_vertices_count = @intCast(mesh.meshlet_vertices.items.len),
+            .index_size = if (mesh.positions_stream.items.len <= std.math.maxInt(u16) + 1) @sizeOf(u16) else @sizeOf(u32),
+            .streams = undefined,
+        };
+
+        for (&header.streams, 0..) |*desc, i| {
+            output.appendNTimes(0, std.mem.alignForward(usize, output.items.len, stream_alignment) - output.items.len) catch unreachable;
+            const stream_start = output.items.len;
+            encodeStream(output, mesh, header.*, @enumFromInt(i));
+            const size: u32 = @intCast(output.items.len - stream_start);
+            desc.* = .{ .offset = stream_start, .size = size, .decoded_size = size, .codec = .none };
+        }
+    }
+
+    const file_header = FileHeader{
+        .magic = file_magic,
+        .version = version,
+        .mesh_count = @intCast(meshes.len),
+        .data_offset = data_offset,
+    };
+    @memcpy(output.items[0..@sizeOf(FileHeader)], std.mem.asBytes(&file_header));
+    @memcpy(output.items[@sizeOf(FileHeader)..][0 .. meshes.len * @sizeOf(MeshHeader)], std.mem.sliceAsBytes(headers));
+}
+
+fn appendValue(output: *std.ArrayList(u8), value: anytype) void {
+    output.appendSlice(std.mem.asBytes(&value)) catch unreachable;
+}
+
+fn encodeIndices(output: *std.ArrayList(u8), indices: []const u32, index_size: u32) void {
+    if (index_size == @sizeOf(u32)) {
+        output.appendSlice(std.mem.sliceAsBytes(indices)) catch unreachable;
+        return;
+    }
+    for (indices) |index| {
+        appendValue(output, @as(u16, @intCast(index)));
+    }
+}
+
+fn encodeStream(output: *std.ArrayList(u8), mesh: MeshData, header: MeshHeader, stream: Stream) void {
+    switch (stream) {
+        .indices => encodeIndices(output, mesh.indices.items, header.index_size),
+        .positions => for (mesh.positions_stream.items) |position| {
+            appendValue(output, quantizePosition(position, header.boundingBox()));
+        },
+        .texcoords => for (mesh.texcoords_stream.items) |texcoord| {
+            appendValue(output, QuantizedTexcoord{ @floatCast(texcoord[0]), @floatCast(texcoord[1]) });
+        },
+        .normals => for (mesh.normals_stream.items) |normal| {
+            appendValue(output, quantizeNormal(normal));
+        },
+        .tangents => for (mesh.tangents_stream.items) |tangent| {
+            appendValue(output, quantizeTangent(tangent));
+        },
+        .meshlets => output.appendSlice(std.mem.sliceAsBytes(mesh.meshlets.items)) catch unreachable,
+        .meshlet_bounds => output.appendSlice(std.mem.sliceAsBytes(mesh.meshlet_bounds.items)) catch unreachable,
+        .meshlet_triangles => output.appendSlice(std.mem.sliceAsBytes(mesh.meshlet_triangles.items)) catch unreachable,
+        .meshlet_vertices => encodeIndices(output, mesh.meshlet_vertices.items, header.index_size),
+    }
+}
+
+// ██████╗ ███████╗ ██████╗ ██████╗ ██████╗ ███████╗
+// ██╔══██╗██╔════╝██╔════╝██╔═══██╗██╔══██╗██╔════╝
+// ██║  ██║█████╗  ██║     ██║   ██║██║  ██║█████╗
+// ██║  ██║██╔══╝  ██║     ██║   ██║██║  ██║██╔══╝
+// ██████╔╝███████╗╚██████╗╚██████╔╝██████╔╝███████╗
+// ╚═════╝ ╚══════╝ ╚═════╝ ╚═════╝ ╚═════╝ ╚══════╝
+
+const MeshJob = struct {
+    allocator: std.mem.Allocator,
+    bytes: []const u8,
+    header: *const MeshHeader,
+    mesh: *MeshData,
+    failed: *std.atomic.Value(bool),
+};
+
+// Appends every mesh of a v2 file to mesh_data. bytes is usually the file's mapping, streams
+// stored uncompressed are dequantized straight out of it. With workers every mesh is a job,
+// otherwise they decode on the calling thread. Most streams are a few KiB, a job per stream
+// cost more in scheduling than the decoding it spread out.
+pub fn decode(allocator: std.mem.Allocator, bytes: []const u8, workers: ?*std.Thread.Pool, mesh_data: *std.ArrayList(MeshData)) error{InvalidMesh}!void {
+    if (!isVersion2(bytes) or bytes.len < @sizeOf(FileHeader)) {
+        return error.InvalidMesh;
+    }
+    const file_header = std.mem.bytesToValue(FileHeader, bytes[0..@sizeOf(FileHeader)]);
+    const headers_end = @sizeOf(FileHeader) + @as(usize, file_header.mesh_count) * @sizeOf(MeshHeader);
+    if (file_header.version != version or headers_end > bytes.len) {
+        return error.InvalidMesh;
+    }
+
+    const headers = allocator.alloc(MeshHeader, file_header.mesh_count) catch unreachable;
+    defer allocator.free(headers);
+    for (headers, 0..) |*header, i| {
+        header.* = std.mem.bytesToValue(MeshHeader, bytes[@sizeOf(FileHeader) + i * @sizeOf(MeshHeader) ..][0..@sizeOf(MeshHeader)]);
+        if (!isValid(header.*, bytes.len)) {
+            return error.InvalidMesh;
+        }
+    }
+
+    // Everything is allocated up front so the jobs only write into their own stream.
+    const first_mesh = mesh_data.items.len;
+    mesh_data.ensureUnusedCapacity(headers.len) catch unreachable;
+    for (headers) |header| {
+        mesh_data.appendAssumeCapacity(allocateMeshData(allocator, header));
+    }
+
+    var failed = std.atomic.Value(bool).init(false);
+    var wait_group: std.Thread.WaitGroup = .{};
+    for (headers, mesh_data.items[first_mesh..]) |*header, *mesh| {
+        const job = MeshJob{
+            .allocator = allocator,
+            .bytes = bytes,
+            .header = header,
+            .mesh = mesh,
+            .failed = &failed,
+        };
+        if (workers != null and headers.len > 1) {
+            workers.?.spawnWg(&wait_group, decodeMesh, .{job});
+        } else {
+            decodeMesh(job);
+        }
+    }
+    if (workers) |pool| {
+        pool.waitAndWork(&wait_group);
+    }
+
+    if (failed.load(.acquire)) {
+        for (mesh_data.items[first_mesh..]) |*mesh| {
+            mesh.deinit();
+        }
+        mesh_data.shrinkRetainingCapacity(first_mesh);
+        return error.InvalidMesh;
+    }
+}
+
+fn isValid(header: MeshHeader, file_size: usize) bool {
+    if (header.index_size != @sizeOf(u16) and header.index_size != @sizeOf(u32)) {
+        return false;
+    }
+
+    for (header.streams, 0..) |desc, i| {
+        const stream: Stream = @enumFromInt(i);
+        const decoded_size = @as(u64, header.elementCount(stream)) * header.elementSize(stream);
+        if (desc.decoded_size != decoded_size or desc.offset > file_size or desc.size > file_size - desc.offset) {
+            return false;
+        }
+        switch (desc.codec) {
+            .none => if (desc.size != desc.decoded_size) {
+                return false;
+            },
+            .zstd => {},
+            _ => return false,
+        }
+    }
+    return true;
+}
+
+fn initStream(comptime T: type, allocator: std.mem.Allocator, count: usize) std.ArrayList(T) {
+    var list = std.ArrayList(T).init(allocator);
+    list.resize(count) catch unreachable;
+    return list;
+}
+
+fn allocateMeshData(allocator: std.mem.Allocator, header: MeshHeader) MeshData {
+    return .{
+        .indices = initStream(u32, allocator, header.index_count),
+        .positions_stream = initStream([3]f32, allocator, header.positions_count),
+        .texcoords_stream = initStream([2]f32, allocator, header.texcoords_count),
+        .normals_stream = initStream([3]f32, allocator, header.normals_count),
+        .tangents_stream = initStream([4]f32, allocator, header.tangents_count),
+        .bounds = header.boundingBox(),
+        .meshlets = initStream(geometry.Meshlet, allocator, header.meshlets_count),
+        .meshlet_vertices = initStream(u32, allocator, header.meshlet_vertices_count),
+        .meshlet_triangles = initStream(geometry.MeshletTriangle, allocator, header.meshlet_triangles_count),
+        .meshlet_bounds = initStream(geometry.MeshletBounds, allocator, header.meshlets_count),
+    };
+}
+
+fn streamBytes(mesh: *MeshData, stream: Stream) []u8 {
+    return switch (stream) {
+        .indices => std.mem.sliceAsBytes(mesh.indices.items),
+        .positions => std.mem.sliceAsBytes(mesh.positions_stream.items),
+        .texcoords => std.mem.sliceAsBytes(mesh.texcoords_stream.items),
+        .normals => std.mem.sliceAsBytes(mesh.normals_stream.items),
+        .tangents => std.mem.sliceAsBytes(mesh.tangents_stream.items),
+        .meshlets => std.mem.sliceAsBytes(mesh.meshlets.items),
+        .meshlet_bounds => std.mem.sliceAsBytes(mesh.meshlet_bounds.items),
+        .meshlet_triangles => std.mem.sliceAsBytes(mesh.meshlet_triangles.items),
+        .meshlet_vertices => std.mem.sliceAsBytes(mesh.meshlet_vertices.items),
+    };
+}
+
+fn decodeMesh(job: MeshJob) void {
+    for (0..stream_count) |i| {
+        if (!decodeStream(job, @enumFromInt(i))) {
+            job.failed.store(true, .release);
+            return;
+        }
+    }
+}
+
+fn decodeStream(job: MeshJob, stream: Stream) bool {
+    const desc = job.header.streams[@intFromEnum(stream)];
+    const stored = job.bytes[desc.offset..][0..desc.size];
+    const stored_raw = job.header.isStoredRaw(stream);
+
+    var scratch: ?[]u8 = null;
+    defer if (scratch) |buffer| {
+        job.allocator.free(buffer);
+    };
+    var quantized = stored;
+    if (desc.codec == .zstd) {
+        if (!stored_raw) {
+            scratch = job.allocator.alloc(u8, desc.decoded_size) catch unreachable;
+        }
+        const decompressed = if (stored_raw) streamBytes(job.mesh, stream) else scratch.?;
+        const decompressed_size = std.compress.zstd.decompress.decode(decompressed, stored, false) catch 0;
+        if (decompressed_size != desc.decoded_size) {
+            return false;
+        }
+        if (stored_raw) {
+            return true;
+        }
+        quantized = decompressed;
+    }
+
+    dequantizeStream(job.header.*, stream, quantized, job.mesh);
+    return true;
+}
+
+fn widenIndices(indices: []u32, quantized: []const u8, index_size: u32) void {
+    if (index_size == @sizeOf(u32)) {
+        @memcpy(std.mem.sliceAsBytes(indices), quantized);
+        return;
+    }
+    for (indices, std.mem.bytesAsSlice(u16, quantized)) |*index, small_index| {
+        index.* = small_index;
+    }
+}
+
+fn dequantizeStream(header: MeshHeader, stream: Stream, quantized: []const u8, mesh: *MeshData) void {
+    switch (stream) {
+        .indices => widenIndices(mesh.indices.items, quantized, header.index_size),
+        .positions => {
+            const bounds = header.boundingBox();
+            for (mesh.positions_stream.items, std.mem.bytesAsSlice(QuantizedPosition, quantized)) |*position, quantized_position| {
+                position.* = dequantizePosition(quantized_position, bounds);
+            }
+        },
+        .texcoords => for (mesh.texcoords_stream.items, std.mem.bytesAsSlice(QuantizedTexcoord, quantized)) |*texcoord, quantized_texcoord| {
+            texcoord.* = .{ quantized_texcoord[0], quantized_texcoord[1] };
+        },
+        .normals => for (mesh.normals_stream.items, std.mem.bytesAsSlice(QuantizedNormal, quantized)) |*normal, quantized_normal| {
+            normal.* = dequantizeNormal(quantized_normal);
+        },
+        .tangents => for (mesh.tangents_stream.items, std.mem.bytesAsSlice(QuantizedTangent, quantized)) |*tangent, quantized_tangent| {
+            tangent.* = dequantizeTangent(quantized_tangent);
+        },
+        .meshlets, .meshlet_bounds, .meshlet_triangles => @memcpy(streamBytes(mesh, stream), quantized),
+        .meshlet_vertices => widenIndices(mesh.meshlet_vertices.items, quantized, header.index_size),
+    }
+}
+
+// ████████╗███████╗███████╗████████╗███████╗
+// ╚══██╔══╝██╔════╝██╔════╝╚══██╔══╝██╔════╝
+//    ██║   █████╗  ███████╗   ██║   ███████╗
+//    ██║   ██╔══╝  ╚════██║   ██║   ╚════██║
+//    ██║   ███████╗███████║   ██║   ███████║
+//    ╚═╝   ╚══════╝╚══════╝   ╚═╝   ╚══════╝
+
+fn testMesh(allocator: std.mem.Allocator) MeshData {
+    var mesh = allocateMeshData(allocator, std.mem.zeroInit(MeshHeader, .{
+        .index_count = 6,
+        .positions_count = 4,
+        .texcoords_count = 4,
+        .normals_count = 4,
+        .tangents_count = 4,
+        .meshlets_count = 1,
+        .meshlet_triangles_count = 2,
+        .meshlet_vertices_count = 4,
+    }));
+    @memcpy(mesh.indices.items, &[_]u32{ 0, 1, 2, 2, 1, 3 });
+    @memcpy(mesh.positions_stream.items, &[_][3]f32{ .{ -2, 0, -1 }, .{ 2, 0.5, -1 }, .{ -2, 3, 1 }, .{ 2, 3, 1 } });
+    @memcpy(mesh.texcoords_stream.items, &[_][2]f32{ .{ 0, 0 }, .{ 1, 0 }, .{ 0, 1 }, .{ 0.25, 0.75 } });
+    @memcpy(mesh.normals_stream.items, &[_][3]f32{ .{ 0, 1, 0 }, .{ 0, 0, -1 }, .{ 0.6, 0, -0.8 }, .{ -0.48, 0.6, -0.64 } });
+    @memcpy(mesh.tangents_stream.items, &[_][4]f32{ .{ 1, 0, 0, 1 }, .{ 0, -1, 0, -1 }, .{ 0, 0.8, -0.6, 1 }, .{ -0.36, -0.48, -0.8, -1 } });
+    mesh.meshlets.items[0] = .{ .vertex_offset = 0, .triangle_offset = 0, .vertex_count = 4, .triangle_count = 2 };
+    mesh.meshlet_bounds.items[0] = .{ .local_center = .{ 0, 1.5, 0 }, .local_extents = .{ 2, 1.5, 1 } };
+    @memcpy(mesh.meshlet_triangles.items, &[_]geometry.MeshletTriangle{ .{ .v0 = 0, .v1 = 1, .v2 = 2, ._padding = 0 }, .{ .v0 = 2, .v1 = 1, .v2 = 3, ._padding = 0 } });
+    @memcpy(mesh.meshlet_vertices.items, &[_]u32{ 0, 1, 2, 3 });
+    return mesh;
+}
+
+fn expectApproxSlices(comptime N: usize, expected: []const [N]f32, actual: []const [N]f32, tolerance: f32) !void {
+    try std.testing.expectEqual(expected.len, actual.len);
+    for (expected, actual) |expected_value, actual_value| {
+        for (0..N) |i| {
+            try std.testing.expectApproxEqAbs(expected_value[i], actual_value[i], tolerance);
+        }
+    }
+}
+
+fn expectDecodedMatches(expected: MeshData, actual: MeshData) !void {
+    try std.testing.expectEqualSlices(u32, expected.indices.items, actual.indices.items);
+    try expectApproxSlices(3, expected.positions_stream.items, actual.positions_stream.items, 1e-4);
+    try expectApproxSlices(2, expected.texcoords_stream.items, actual.texcoords_stream.items, 1e-3);
+    try expectApproxSlices(3, expected.normals_stream.items, actual.normals_stream.items, 1e-3);
+    try expectApproxSlices(4, expected.tangents_stream.items, actual.tangents_stream.items, 1e-3);
+    try std.testing.expectEqualSlices(u8, std.mem.sliceAsBytes(expected.meshlets.items), std.mem.sliceAsBytes(actual.meshlets.items));
+    try std.testing.expectEqualSlices(u8, std.mem.sliceAsBytes(expected.meshlet_bounds.items), std.mem.sliceAsBytes(actual.meshlet_bounds.items));
+    try std.testing.expectEqualSlices(u8, std.mem.sliceAsBytes(expected.meshlet_triangles.items), std.mem.sliceAsBytes(actual.meshlet_triangles.items));
+    try std.testing.expectEqualSlices(u32, expected.meshlet_vertices.items, actual.meshlet_vertices.items);
+}
+
+// Moves a stream to the end of the file as a zstd frame holding one raw block, what the model
+// converter's compressor falls back to for data it can't shrink.
+fn storeAsZstdFrame(file: *std.ArrayList(u8), mesh_index: usize, stream: Stream) !void {
+    const header_offset = @sizeOf(FileHeader) + mesh_index * @sizeOf(MeshHeader);
+    var header = std.mem.bytesToValue(MeshHeader, file.items[header_offset..][0..@sizeOf(MeshHeader)]);
+    const desc = &header.streams[@intFromEnum(stream)];
+    const data = try std.testing.allocator.dupe(u8, file.items[desc.offset..][0..desc.size]);
+    defer std.testing.allocator.free(data);
+    try std.testing.expect(data.len > 0 and data.len <= std.math.maxInt(u8));
+
+    const frame_offset = file.items.len;
+    // Magic, single segment descriptor, one byte content size, then a last raw block.
+    try file.appendSlice(&[_]u8{ 0x28, 0xB5, 0x2F, 0xFD, 0x20, @intCast(data.len) });
+    const block_header: u24 = 1 | (@as(u24, @intCast(data.len)) << 3);
+    try file.appendSlice(&[_]u8{ @truncate(block_header), @truncate(block_header >> 8), @truncate(block_header >> 16) });
+    try file.appendSlice(data);
+
+    desc.offset = frame_offset;
+    desc.size = @intCast(file.items.len - frame_offset);
+    desc.codec = .zstd;
+    @memcpy(file.items[header_offset..][0..@sizeOf(MeshHeader)], std.mem.asBytes(&header));
+}
+
+test "mesh_format quantization" {
+    const bounds = BoundingBox{ .center = .{ 1, -2, 0 }, .extents = .{ 10, 0, 0.5 } };
+    const position = dequantizePosition(quantizePosition(.{ 4.2, -2, -0.3 }, bounds), bounds);
+    try std.testing.expectApproxEqAbs(@as(f32, 4.2), position[0], 20.0 / std.math.maxInt(u16));
+    try std.testing.expectEqual(@as(f32, -2), position[1]);
+    try std.testing.expectApproxEqAbs(@as(f32, -0.3), position[2], 1.0 / std.math.maxInt(u16));
+
+    // Every octant, both poles and the folded edges.
+    const directions = [_][3]f32{ .{ 0, 0, 1 }, .{ 0, 0, -1 }, .{ 1, 0, 0 }, .{ -0.6, -0.8, 0 }, .{ 0.48, -0.6, -0.64 }, .{ -0.36, 0.48, -0.8 } };
+    for (directions) |direction| {
+        const normal = dequantizeNormal(quantizeNormal(direction));
+        for (0..3) |i| {
+            try std.testing.expectApproxEqAbs(direction[i], normal[i], 1e-3);
+        }
+        const tangent = dequantizeTangent(quantizeTangent(.{ direction[0], direction[1], direction[2], -1 }));
+        for (0..3) |i| {
+            try std.testing.expectApproxEqAbs(direction[i], tangent[i], 1e-3);
+        }
+        try std.testing.expectEqual(@as(f32, -1), tangent[3]);
+    }
+}
+
+test "mesh_format round trip" {
+    const allocator = std.testing.allocator;
+    var meshes = [_]MeshData{ testMesh(allocator), testMesh(allocator) };
+    defer {
+        for (&meshes) |*mesh| {
+            mesh.deinit();
+        }
+    }
+    for (meshes[1].positions_stream.items) |*position| {
+        position[1] += 100;
+    }
+
+    var file = std.ArrayList(u8).init(allocator);
+    defer file.deinit();
+    encode(allocator, &meshes, &file);
+    try std.testing.expect(isVersion2(file.items));
+    try std.testing.expect(!isVersion2("TidesMesh\x02\x00\x00\x00\x00\x00\x00\x00"));
+
+    const file_header = std.mem.bytesToValue(FileHeader, file.items[0..@sizeOf(FileHeader)]);
+    try std.testing.expectEqual(@as(u64, 0), file_header.data_offset % data_alignment);
+    const header = std.mem.bytesToValue(MeshHeader, file.items[@sizeOf(FileHeader)..][0..@sizeOf(MeshHeader)]);
+    try std.testing.expectEqual(@as(u32, @sizeOf(u16)), header.index_size);
+    try std.testing.expectEqual([3]f32{ 0, 1.5, 0 }, header.bounds_center);
+    for (header.streams) |desc| {
+        try std.testing.expectEqual(@as(u64, 0), desc.offset % stream_alignment);
+    }
+
+    try storeAsZstdFrame(&file, 1, .positions);
+    try storeAsZstdFrame(&file, 1, .meshlets);
+
+    var workers: std.Thread.Pool = undefined;
+    try workers.init(.{ .allocator = allocator, .n_jobs = 2 });
+    defer workers.deinit();
+
+    for ([_]?*std.Thread.Pool{ null, &workers }) |pool| {
+        var decoded = std.ArrayList(MeshData).init(allocator);
+        defer {
+            for (decoded.items) |*mesh| {
+                mesh.deinit();
+            }
+            decoded.deinit();
+        }
+        try decode(allocator, file.items, pool, &decoded);
+        try std.testing.expectEqual(@as(usize, 2), decoded.items.len);
+        for (meshes, decoded.items) |mesh, decoded_mesh| {
+            try expectDecodedMatches(mesh, decoded_mesh);
+        }
+        try std.testing.expectEqual([3]f32{ 0, 101.5, 0 }, decoded.items[1].bounds.center);
+    }
+
+    // A stream running past the end of the file.
+    var corrupt = try file.clone();
+    defer corrupt.deinit();
+    const corrupt_header = std.mem.bytesAsValue(MeshHeader, corrupt.items[@sizeOf(FileHeader)..][0..@sizeOf(MeshHeader)]);
+    corrupt_header.streams[@intFromEnum(Stream.normals)].offset = corrupt.items.len;
+    var rejected = std.ArrayList(MeshData).init(allocator);
+    defer rejected.deinit();
+    try std.testing.expectError(error.InvalidMesh, decode(allocator, corrupt.items, null, &rejected));
+    try std.testing.expectEqual(@as(usize, 0), rejected.items.len);
+}
@@ -3,6 +3,8 @@ const std = @import("std");
 const fd = @import("../../config/flecs_data.zig");
 const graphics = zforge.graphics;
 const IdLocal = @import("../../core/core.zig").IdLocal;
+const light_clustering = @import("../light_clustering.zig");
+const LightClusterer = light_clustering.LightClusterer;
 const OpaqueSlice = util.OpaqueSlice;
 const renderer = @import("../../renderer/renderer.zig");
 const renderer_types = @import("../../renderer/types.zig");
@@ -29,6 +31,10 @@ const UniformFrameData = struct {
     _pad0: u32,
     fog_color: [3]f32,
     fog_density: f32,
+    cluster_depth_scale: f32,
+    cluster_depth_bias: f32,
+    gpu_tiled_light_culling: u32,
+    _pad1: f32,
 };
 
 pub const LightCullingParams = struct {
@@ -49,11 +55,17 @@ pub const DeferredShadingPass = struct {
     uniform_frame_buffers: [renderer.Renderer.data_buffer_count]renderer.BufferHandle,
     deferred_descriptor_sets: [2][*c]graphics.DescriptorSet,
 
+    light_clusterer: *LightClusterer,
+    light_grid_buffers: [renderer.Renderer.data_buffer_count]renderer.BufferHandle,
+    light_index_list_buffers: [renderer.Renderer.data_buffer_count]renderer.BufferHandle,
+
+    // NOTE: The previous screen tiled culling compute pass, kept to benchmark the CPU clusters against.
+    gpu_tiled_light_culling: bool,
     light_culling_frame_buffers: [renderer.Renderer.data_buffer_count]renderer.BufferHandle,
     light_culling_descriptor_sets: [*c]graphics.DescriptorSet,
     light_culling_clear_descriptor_sets: [*c]graphics.DescriptorSet,
     light_index_counter_buffers: [renderer.Renderer.data_buffer_count]renderer.BufferHandle,
-    light_index_list_buffers: [renderer.Renderer.data_buffer_count]renderer.BufferHandle,
+    tiled_light_index_list_buffers: [renderer.Renderer.data_buffer_count]renderer.BufferHandle,
 
     pub fn init(self: *@This(), rctx: *renderer.Renderer, allocator: std.mem.Allocator) void {
         self.allocator = allocator;
@@ -68,6 +80,35 @@ pub const DeferredShadingPass = struct {
             break :blk buffers;
         };
 
+        self.light_clusterer = LightClusterer.create(allocator, rctx.jobs.frame);
+
+        for (0..renderer.Renderer.data_buffer_count) |frame_index| {
+            const buffer_creation_desc = renderer.BufferCreationDesc{
+                .bindless = false,
+                .descriptors = .{ .bits = graphics.DescriptorType.DESCRIPTOR_TYPE_BUFFER.bits },
+                .start_state = .RESOURCE_STATE_COMMON,
+                .size = @sizeOf(light_clustering.ClusterLights) * light_clustering.clusters_count,
+                .element_size = @sizeOf(light_clustering.ClusterLights),
+                .debug_name = "Light Grid",
+            };
+
+            self.light_grid_buffers[frame_index] = rctx.createBuffer(buffer_creation_desc);
+        }
+
+        for (0..renderer.Renderer.data_buffer_count) |frame_index| {
+            const buffer_creation_desc = renderer.BufferCreationDesc{
+                .bindless = false,
+                .descriptors = .{ .bits = graphics.DescriptorType.DESCRIPTOR_TYPE_BUFFER.bits },
+                .start_state = .RESOURCE_STATE_COMMON,
+                .size = @sizeOf(u32) * light_clustering.light_indices_max_count,
+                .element_size = @sizeOf(u32),
+                .debug_name = "Light Index List",
+            };
+
+            self.light_index_list_buffers[frame_index] = rctx.createBuffer(buffer_creation_desc);
+        }
+
+        self.gpu_tiled_light_culling = false;
         self.light_culling_frame_buffers = blk: {
             var buffers: [renderer.Renderer.data_buffer_count]renderer.BufferHandle = undefined;
             for (buffers, 0..) |_, buffer_index| {
@@ -97,20 +138,63 @@ pub const DeferredShadingPass = struct {
                 .start_state = .RESOURCE_STATE_COMMON,
                 .size = @sizeOf(u32) * 2 * 1024 * 1024,
                 .element_size = @sizeOf(u32),
-                .debug_name = "Light Index List",
+                .debug_name = "Tiled Light Index List",
             };
 
-            self.light_index_list_buffers[frame_index] = rctx.createBuffer(buffer_creation_desc);
+            self.tiled_light_index_list_buffers[frame_index] = rctx.createBuffer(buffer_creation_desc);
         }
     }
 
     pub fn destroy(self: *@This()) void {
-        _ = self;
+        self.light_clusterer.destroy();
     }
 
     pub fn renderImGui(self: *@This()) void {
-        _ = self;
-        if (zgui.collapsingHeader("Deferred Shading", .{})) {}
+        if (zgui.collapsingHeader("Deferred Shading", .{})) {
+            _ = zgui.checkbox("GPU Tiled Light Culling", .{ .v = &self.gpu_tiled_light_culling });
+            zgui.text("Point lights: {} ({} visible)", .{ self.renderer.light_spheres.items.len, self.light_clusterer.lights_visible });
+            zgui.text("Light indices: {}", .{self.light_clusterer.light_indices.items.len});
+            if (self.light_clusterer.dropped_indices_count > 0) {
+                zgui.text("Dropped light indices: {}", .{self.light_clusterer.dropped_indices_count});
+            }
+        }
+    }
+
+    // Buckets the point lights into the view's clusters and uploads the lists for shading.
+    pub fn update(self: *@This(), render_view: renderer.RenderView) void {
+        if (self.gpu_tiled_light_culling) {
+            return;
+        }
+
+        const trazy_zone = ztracy.ZoneNC(@src(), "Light Clustering", 0x00_ff_ff_00);
+        defer trazy_zone.End();
+
+        var view = light_clustering.ClusterView{
+            .view = undefined,
+            .projection = undefined,
+            .near_plane = render_view.near_plane,
+            .far_plane = render_view.far_plane,
+            .light_index_offset = renderer.Renderer.first_point_light_index,
+        };
+        zm.storeMat(&view.view, render_view.view);
+        zm.storeMat(&view.projection, render_view.projection);
+        self.light_clusterer.assign(self.renderer.light_spheres.items, view);
+
+        const frame_index = self.renderer.frame_index;
+        const grid_data = OpaqueSlice{
+            .data = @ptrCast(&self.light_clusterer.cluster_lights),
+            .size = @sizeOf(@TypeOf(self.light_clusterer.cluster_lights)),
+        };
+        self.renderer.updateBuffer(grid_data, 0, light_clustering.ClusterLights, self.light_grid_buffers[frame_index]);
+
+        const light_indices = self.light_clusterer.light_indices.items;
+        if (light_indices.len > 0) {
+            const indices_data = OpaqueSlice{
+                .data = @ptrCast(light_indices),
+                .size = @sizeOf(u32) * light_indices.len,
+            };
+            self.renderer.updateBuffer(indices_data, 0, u32, self.light_index_list_buffers[frame_index]);
+        }
     }
 
     pub fn render(self: *@This(), cmd_list: [*c]graphics.Cmd, render_view: renderer.RenderView) void {
@@ -121,7 +205,7 @@ pub const DeferredShadingPass = struct {
         const camera_position = render_view.position;
 
         // Light culling
-        {
+        if (self.gpu_tiled_light_culling) {
             const trazy_zone2 = ztracy.ZoneNC(@src(), "Light Culling", 0x00_ff_ff_00);
             defer trazy_zone2.End();
 
@@ -144,7 +228,7 @@ pub const DeferredShadingPass = struct {
             self.renderer.updateBuffer(data, 0, LightCullingParams, self.light_culling_frame_buffers[frame_index]);
 
             const light_index_counter_buffer = self.renderer.getBuffer(self.light_index_counter_buffers[frame_index]);
-            const light_index_list_buffer = self.renderer.getBuffer(self.light_index_list_buffers[frame_index]);
+            const light_index_list_buffer = self.renderer.getBuffer(self.tiled_light_index_list_buffers[frame_index]);
             const light_grid = self.renderer.getTexture(self.renderer.light_grid[frame_index]);
             {
                 const buffer_barriers = [_]graphics.BufferBarrier{
@@ -203,6 +287,10 @@ pub const DeferredShadingPass = struct {
             frame_data.sh9_buffer_index = self.renderer.getSH9BufferIndex();
             frame_data.fog_color = self.renderer.height_fog_settings.color;
             frame_data.fog_density = self.renderer.height_fog_settings.density;
+            const depth_slice_params = light_clustering.depthSliceParams(render_view.far_plane);
+            frame_data.cluster_depth_scale = depth_slice_params[0];
+            frame_data.cluster_depth_bias = depth_slice_params[1];
+            frame_data.gpu_tiled_light_culling = @intFromBool(self.gpu_tiled_light_culling);
             frame_data.near_plane = render_view.far_plane;
             frame_data.far_plane = render_view.near_plane;
             frame_data.shadow_resolution_inverse = [2]f32{ 1.0 / 2048.0, 1.0 / 2048.0 };
@@ -256,7 +344,9 @@ pub const DeferredShadingPass = struct {
 
             for (0..renderer.Renderer.data_buffer_count) |i| {
                 var light_index_list_buffer = self.renderer.getBuffer(self.light_index_list_buffers[i]);
-                var light_grid = self.renderer.getTexture(self.renderer.light_grid[i]);
+                var light_grid_buffer = self.renderer.getBuffer(self.light_grid_buffers[i]);
+                var tiled_light_index_list_buffer = self.renderer.getBuffer(self.tiled_light_index_list_buffers[i]);
+                var tiled_light_grid = self.renderer.getTexture(self.renderer.light_grid[i]);
                 var lights_buffer = self.renderer.getBuffer(self.renderer.light_buffer.buffer);
 
                 params[0] = std.mem.zeroes(graphics.DescriptorData);
@@ -294,12 +384,18 @@ pub const DeferredShadingPass = struct {
                 params[1].__union_field3.ppBuffers = @ptrCast(&light_index_list_buffer);
                 params[2] = std.mem.zeroes(graphics.DescriptorData);
                 params[2].pName = "lightGrid";
-                params[2].__union_field3.ppTextures = @ptrCast(&light_grid);
+                params[2].__union_field3.ppBuffers = @ptrCast(&light_grid_buffer);
                 params[3] = std.mem.zeroes(graphics.DescriptorData);
                 params[3].pName = "lights";
                 params[3].__union_field3.ppBuffers = @ptrCast(&lights_buffer);
+                params[4] = std.mem.zeroes(graphics.DescriptorData);
+                params[4].pName = "tiledLightIndexList";
+                params[4].__union_field3.ppBuffers = @ptrCast(&tiled_light_index_list_buffer);
+                params[5] = std.mem.zeroes(graphics.DescriptorData);
+                params[5].pName = "tiledLightGrid";
+                params[5].__union_field3.ppTextures = @ptrCast(&tiled_light_grid);
 
-                graphics.updateDescriptorSet(self.renderer.renderer, @intCast(i), self.deferred_descriptor_sets[1], 4, @ptrCast(&params));
+                graphics.updateDescriptorSet(self.renderer.renderer, @intCast(i), self.deferred_descriptor_sets[1], 6, @ptrCast(&params));
             }
         }
 
@@ -309,7 +405,7 @@ pub const DeferredShadingPass = struct {
             for (0..renderer.Renderer.data_buffer_count) |i| {
                 var uniform_buffer = self.renderer.getBuffer(self.light_culling_frame_buffers[i]);
                 var light_index_counter_buffer = self.renderer.getBuffer(self.light_index_counter_buffers[i]);
-                var light_index_list_buffer = self.renderer.getBuffer(self.light_index_list_buffers[i]);
+                var light_index_list_buffer = self.renderer.getBuffer(self.tiled_light_index_list_buffers[i]);
                 var light_grid = self.renderer.getTexture(self.renderer.light_grid[i]);
                 var lights_buffer = self.renderer.getBuffer(self.renderer.light_buffer.buffer);
 
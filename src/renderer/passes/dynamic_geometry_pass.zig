@@ -5,6 +5,7 @@ const IdLocal = @import("../../core/core.zig").IdLocal;
 const geometry = @import("../geometry.zig");
 const renderer = @import("../renderer.zig");
 const renderer_types = @import("../types.zig");
+const dynamic_visibility = @import("../dynamic_visibility.zig");
 const zforge = @import("zforge");
 const ztracy = @import("ztracy");
 const util = @import("../../util.zig");
@@ -16,6 +17,8 @@ const graphics = zforge.graphics;
 const resource_loader = zforge.resource_loader;
 const InstanceData = renderer_types.InstanceData;
 const InstanceRootConstants = renderer_types.InstanceRootConstants;
+const DrawList = dynamic_visibility.DrawList;
+const DynamicVisibility = dynamic_visibility.DynamicVisibility;
 
 pub const UniformFrameData = struct {
     projection_view: [16]f32,
@@ -30,8 +33,9 @@ pub const ShadowsUniformFrameData = struct {
 };
 
 const Batch = struct {
-    instances: std.ArrayList(InstanceData),
+    key: BatchKey,
     start_instance_location: u32,
+    instance_count: u32,
 };
 
 const BatchKey = struct {
@@ -41,7 +45,24 @@ const BatchKey = struct {
     surface_type: renderer.SurfaceType,
 };
 
-const BatchMap = std.AutoHashMap(BatchKey, Batch);
+// The LoD meshes and materials of a LodGroup, shared by every entity that has the same ones.
+const Model = struct {
+    lod_count: u32,
+    lods: [geometry.mesh_lod_max_count]renderer_types.Lod,
+    material_indices: [geometry.mesh_lod_max_count][geometry.sub_mesh_max_count]u32,
+    surface_types: [geometry.mesh_lod_max_count][geometry.sub_mesh_max_count]renderer.SurfaceType,
+    // LOD0's bounding sphere in object space
+    bounds_center: [3]f32,
+    bounds_radius: f32,
+};
+
+// Per slot of the visibility stage.
+const Instance = struct {
+    world: [16]f32,
+    model: u32,
+};
+
+const invalid_model = std.math.maxInt(u32);
 
 const max_instances = 100000;
 const max_draw_distance: f32 = 20000.0;
@@ -62,8 +83,19 @@ pub const DynamicGeometryPass = struct {
     // TODO(gmodarelli): Descriptor Set should be associated to materials
     descriptor_sets_shadow_caster: [renderer.Renderer.cascades_max_count][max_entity_types][*c]graphics.DescriptorSet,
 
-    gbuffer_batches: BatchMap,
-    shadow_map_batches: [renderer.Renderer.cascades_max_count]BatchMap,
+    visibility: *DynamicVisibility,
+    models: std.ArrayList(Model),
+    model_ids: std.AutoHashMap(u64, u32),
+    instances: std.ArrayList(Instance),
+    temporal_coherence: bool,
+    camera_position: [3]f32,
+    projection_scale: f32,
+
+    gbuffer_draw_list: DrawList,
+    shadow_map_draw_lists: [renderer.Renderer.cascades_max_count]DrawList,
+
+    gbuffer_batches: std.ArrayList(Batch),
+    shadow_map_batches: [renderer.Renderer.cascades_max_count]std.ArrayList(Batch),
 
     gbuffer_instances: std.ArrayList(InstanceData),
     gbuffer_instance_buffers: [renderer.Renderer.data_buffer_count]renderer.BufferHandle,
@@ -117,33 +149,142 @@ pub const DynamicGeometryPass = struct {
             };
         }
 
-        self.gbuffer_batches = BatchMap.init(allocator);
-        self.gbuffer_batches.ensureTotalCapacity(32) catch unreachable;
+        self.visibility = DynamicVisibility.create(allocator);
+        self.models = std.ArrayList(Model).init(allocator);
+        self.model_ids = std.AutoHashMap(u64, u32).init(allocator);
+        self.instances = std.ArrayList(Instance).init(allocator);
+        self.temporal_coherence = true;
+        self.camera_position = .{ 0, 0, 0 };
+        self.projection_scale = 1;
+
+        self.gbuffer_draw_list = .{};
+        self.gbuffer_batches = std.ArrayList(Batch).init(allocator);
         for (0..renderer.Renderer.cascades_max_count) |i| {
-            self.shadow_map_batches[i] = BatchMap.init(allocator);
-            self.shadow_map_batches[i].ensureTotalCapacity(32) catch unreachable;
+            self.shadow_map_draw_lists[i] = .{};
+            self.shadow_map_batches[i] = std.ArrayList(Batch).init(allocator);
         }
     }
 
     pub fn destroy(self: *@This()) void {
-        {
-            var batch_keys_iterator = self.gbuffer_batches.keyIterator();
-            while (batch_keys_iterator.next()) |batch_key| {
-                const batch = self.gbuffer_batches.getPtr(batch_key.*).?;
-                batch.start_instance_location = 0;
-                batch.instances.deinit();
+        self.gbuffer_instances.deinit();
+        self.gbuffer_draw_list.deinit(self.allocator);
+        self.gbuffer_batches.deinit();
+        for (0..renderer.Renderer.cascades_max_count) |i| {
+            self.shadow_map_instances[i].deinit();
+            self.shadow_map_draw_lists[i].deinit(self.allocator);
+            self.shadow_map_batches[i].deinit();
+        }
+
+        self.visibility.destroy();
+        self.models.deinit();
+        self.model_ids.deinit();
+        self.instances.deinit();
+    }
+
+    // Slots are handed out right away, like the static geometry pass does, so the entity can keep
+    // its own. The instance is drawn once it's been added in update().
+    pub fn allocateInstance(self: *@This()) u32 {
+        return self.visibility.allocateSlot();
+    }
+
+    pub fn update(self: *@This(), render_view: renderer.RenderView) void {
+        const trazy_zone = ztracy.ZoneNC(@src(), "Dynamic Geometry: Update", 0x00_ff_ff_00);
+        defer trazy_zone.End();
+
+        // NOTE: Added first, an entity can be added and removed in the same frame.
+        for (self.renderer.added_dynamic_entities.items) |dynamic_entity| {
+            const slot = dynamic_entity.instance_slot;
+            if (slot >= self.instances.items.len) {
+                self.instances.appendNTimes(.{ .world = undefined, .model = invalid_model }, slot + 1 - self.instances.items.len) catch unreachable;
             }
-            self.gbuffer_batches.deinit();
+
+            const lods = dynamic_entity.lods[0..dynamic_entity.lod_count];
+            if (lods.len == 0 or lods[0].materials_count == 0) {
+                continue;
+            }
+
+            const model = self.registerModel(lods);
+            self.instances.items[slot].model = model;
+            self.visibility.setModel(slot, model, dynamic_entity.lod_count);
+            self.setInstanceTransform(slot, dynamic_entity.world);
         }
 
-        for (0..renderer.Renderer.cascades_max_count) |i| {
-            var batch_keys_iterator = self.shadow_map_batches[i].keyIterator();
-            while (batch_keys_iterator.next()) |batch_key| {
-                const batch = self.shadow_map_batches[i].getPtr(batch_key.*).?;
-                batch.start_instance_location = 0;
-                batch.instances.deinit();
+        for (self.renderer.moved_dynamic_instances.items) |moved_instance| {
+            self.setInstanceTransform(moved_instance.instance_slot, moved_instance.world);
+        }
+
+        for (self.renderer.removed_dynamic_instances.items) |slot| {
+            if (slot < self.instances.items.len) {
+                self.instances.items[slot].model = invalid_model;
             }
+            self.visibility.freeSlot(slot);
         }
+
+        self.camera_position = render_view.position;
+        self.projection_scale = render_view.projection[1][1];
+
+        self.visibility.cull(&self.gbuffer_draw_list, .{
+            .frustum_planes = render_view.frustum.planes,
+            .camera_position = self.camera_position,
+            .projection_scale = self.projection_scale,
+            .max_draw_distance = max_draw_distance,
+            .temporal_coherence = self.temporal_coherence,
+        });
+    }
+
+    fn setInstanceTransform(self: *@This(), slot: u32, world: zm.Mat) void {
+        if (slot >= self.instances.items.len) {
+            return;
+        }
+
+        const instance = &self.instances.items[slot];
+        zm.storeMat(&instance.world, world);
+        if (instance.model == invalid_model) {
+            return;
+        }
+
+        const model = &self.models.items[instance.model];
+        var center: [3]f32 = undefined;
+        zm.storeArr3(&center, zm.mul(zm.loadArr3w(model.bounds_center, 1.0), world));
+        const scale = @max(zm.length3(world[0])[0], @max(zm.length3(world[1])[0], zm.length3(world[2])[0]));
+        self.visibility.setBounds(slot, center, model.bounds_radius * scale);
+    }
+
+    fn registerModel(self: *@This(), lods: []const renderer_types.Lod) u32 {
+        var hasher = std.hash.Wyhash.init(0);
+        for (lods) |lod| {
+            std.hash.autoHash(&hasher, lod.mesh_handle.id);
+            std.hash.autoHash(&hasher, lod.materials_count);
+            for (lod.materials[0..lod.materials_count]) |material_id| {
+                std.hash.autoHash(&hasher, material_id);
+            }
+        }
+
+        const result = self.model_ids.getOrPut(hasher.final()) catch unreachable;
+        if (result.found_existing) {
+            return result.value_ptr.*;
+        }
+
+        const mesh = self.renderer.getLegacyMesh(lods[0].mesh_handle);
+        var model = Model{
+            .lod_count = @intCast(lods.len),
+            .lods = undefined,
+            .material_indices = undefined,
+            .surface_types = undefined,
+            .bounds_center = mesh.geometry.*.mAabbCenter,
+            .bounds_radius = mesh.geometry.*.mRadius,
+        };
+        @memcpy(model.lods[0..lods.len], lods);
+        for (lods, 0..) |lod, lod_index| {
+            for (lod.materials[0..lod.materials_count], 0..) |material_id, sub_mesh_index| {
+                model.material_indices[lod_index][sub_mesh_index] = @intCast(self.renderer.getMaterialIndex(material_id));
+                model.surface_types[lod_index][sub_mesh_index] = if (self.renderer.getMaterialAlphaTest(material_id)) .cutout else .@"opaque";
+            }
+        }
+
+        result.value_ptr.* = @intCast(self.models.items.len);
+        self.models.append(model) catch unreachable;
+        return result.value_ptr.*;
     }
 
     fn bindMeshBuffers(self: *@This(), mesh: renderer.LegacyMesh, cmd_list: [*c]graphics.Cmd) void {
@@ -162,13 +303,13 @@ pub const DynamicGeometryPass = struct {
 
     pub fn renderImGui(self: *@This()) void {
         if (zgui.collapsingHeader("Dynamic Renderer", .{})) {
-            var batch_keys_iterator = self.gbuffer_batches.keyIterator();
-            _ = zgui.text("Batches: {}", .{batch_keys_iterator.len});
-            var batch_index: u32 = 0;
-            while (batch_keys_iterator.next()) |batch_key| {
-                const batch = self.gbuffer_batches.getPtr(batch_key.*).?;
-                _ = zgui.text("Batch {} | {} | {} instance count: {}", .{ batch_key.*.mesh_handle.id, batch_key.*.sub_mesh_index, batch_key.*.material_id, batch.instances.items.len });
-                batch_index += 1;
+            _ = zgui.checkbox("Temporal Coherence", .{ .v = &self.temporal_coherence });
+            const draw_list = &self.gbuffer_draw_list;
+            _ = zgui.text("Instances: {} ({} visible), models: {}", .{ self.visibility.slots_count - self.visibility.free_slots.items.len, draw_list.instances_visible, self.models.items.len });
+            _ = zgui.text("Groups culled: {}, reused: {}", .{ draw_list.groups_culled, draw_list.groups_reused });
+            _ = zgui.text("Batches: {}", .{self.gbuffer_batches.items.len});
+            for (self.gbuffer_batches.items) |batch| {
+                _ = zgui.text("Batch {} | {} | {} instance count: {}", .{ batch.key.mesh_handle.id, batch.key.sub_mesh_index, batch.key.material_id, batch.instance_count });
             }
         }
     }
@@ -189,19 +330,7 @@ pub const DynamicGeometryPass = struct {
         uniform_frame_data_gbuffer.time = @floatCast(self.renderer.time);
 
         {
-            batchEntities(self, render_view, &self.gbuffer_batches);
-            self.gbuffer_instances.clearRetainingCapacity();
-
-            var batch_keys_iterator = self.gbuffer_batches.keyIterator();
-            var start_instance_location: u32 = 0;
-            while (batch_keys_iterator.next()) |batch_key| {
-                const batch = self.gbuffer_batches.getPtr(batch_key.*).?;
-                batch.start_instance_location = start_instance_location;
-                start_instance_location += @intCast(batch.instances.items.len);
-
-                const index = self.gbuffer_instances.items.len;
-                self.gbuffer_instances.insertSlice(index, batch.instances.items) catch unreachable;
-            }
+            self.buildBatches(&self.gbuffer_draw_list, &self.gbuffer_batches, &self.gbuffer_instances);
 
             {
                 const trazy_zone2 = ztracy.ZoneNC(@src(), "Upload instance data", 0x00_ff_ff_00);
@@ -236,17 +365,12 @@ pub const DynamicGeometryPass = struct {
                 const instance_data_buffer_index = self.renderer.getBufferBindlessIndex(self.gbuffer_instance_buffers[frame_index]);
                 const material_buffer_index = self.renderer.getBufferBindlessIndex(self.renderer.material_buffer.buffer);
 
-                var batch_keys_iterator = self.gbuffer_batches.keyIterator();
-                while (batch_keys_iterator.next()) |batch_key| {
+                for (self.gbuffer_batches.items) |batch| {
+                    const batch_key = batch.key;
                     if (batch_key.surface_type != .cutout) {
                         continue;
                     }
 
-                    const batch = self.gbuffer_batches.getPtr(batch_key.*).?;
-                    if (batch.instances.items.len == 0) {
-                        continue;
-                    }
-
                     const pipeline_ids = self.renderer.getMaterialPipelineIds(batch_key.material_id);
                     const pipeline_id = pipeline_ids.gbuffer_pipeline_id.?;
                     const pipeline = self.renderer.getPSO(pipeline_id);
@@ -273,7 +397,7 @@ pub const DynamicGeometryPass = struct {
                             cmd_list,
                             mesh.geometry.*.pDrawArgs[sub_mesh_index].mIndexCount,
                             mesh.geometry.*.pDrawArgs[sub_mesh_index].mStartIndex,
-                            mesh.geometry.*.pDrawArgs[sub_mesh_index].mInstanceCount * @as(u32, @intCast(batch.instances.items.len)),
+                            mesh.geometry.*.pDrawArgs[sub_mesh_index].mInstanceCount * batch.instance_count,
                             mesh.geometry.*.pDrawArgs[sub_mesh_index].mVertexOffset,
                             mesh.geometry.*.pDrawArgs[sub_mesh_index].mStartInstance + batch.start_instance_location,
                         );
@@ -294,17 +418,12 @@ pub const DynamicGeometryPass = struct {
                 const instance_data_buffer_index = self.renderer.getBufferBindlessIndex(self.gbuffer_instance_buffers[frame_index]);
                 const material_buffer_index = self.renderer.getBufferBindlessIndex(self.renderer.material_buffer.buffer);
 
-                var batch_keys_iterator = self.gbuffer_batches.keyIterator();
-                while (batch_keys_iterator.next()) |batch_key| {
+                for (self.gbuffer_batches.items) |batch| {
+                    const batch_key = batch.key;
                     if (batch_key.surface_type != .@"opaque") {
                         continue;
                     }
 
-                    const batch = self.gbuffer_batches.getPtr(batch_key.*).?;
-                    if (batch.instances.items.len == 0) {
-                        continue;
-                    }
-
                     const pipeline_ids = self.renderer.getMaterialPipelineIds(batch_key.material_id);
                     const pipeline_id = pipeline_ids.gbuffer_pipeline_id.?;
                     const pipeline = self.renderer.getPSO(pipeline_id);
@@ -331,7 +450,7 @@ pub const DynamicGeometryPass = struct {
                             cmd_list,
                             mesh.geometry.*.pDrawArgs[sub_mesh_index].mIndexCount,
                             mesh.geometry.*.pDrawArgs[sub_mesh_index].mStartIndex,
-                            mesh.geometry.*.pDrawArgs[sub_mesh_index].mInstanceCount * @as(u32, @intCast(batch.instances.items.len)),
+                            mesh.geometry.*.pDrawArgs[sub_mesh_index].mInstanceCount * batch.instance_count,
                             mesh.geometry.*.pDrawArgs[sub_mesh_index].mVertexOffset,
                             mesh.geometry.*.pDrawArgs[sub_mesh_index].mStartInstance + batch.start_instance_location,
                         );
@@ -355,19 +474,16 @@ pub const DynamicGeometryPass = struct {
         uniform_frame_data.time = @floatCast(self.renderer.time);
 
         {
-            batchEntities(self, render_view, &self.shadow_map_batches[cascade_index]);
-            self.shadow_map_instances[cascade_index].clearRetainingCapacity();
-
-            var batch_keys_iterator = self.shadow_map_batches[cascade_index].keyIterator();
-            var start_instance_location: u32 = 0;
-            while (batch_keys_iterator.next()) |batch_key| {
-                const batch = self.shadow_map_batches[cascade_index].getPtr(batch_key.*).?;
-                batch.start_instance_location = start_instance_location;
-                start_instance_location += @intCast(batch.instances.items.len);
-
-                const index = self.shadow_map_instances[cascade_index].items.len;
-                self.shadow_map_instances[cascade_index].insertSlice(index, batch.instances.items) catch unreachable;
-            }
+            // Casters are culled against the cascade, but keep the LoDs the camera sees them with.
+            self.visibility.cull(&self.shadow_map_draw_lists[cascade_index], .{
+                .frustum_planes = render_view.frustum.planes,
+                .camera_position = self.camera_position,
+                .projection_scale = self.projection_scale,
+                .max_draw_distance = max_draw_distance,
+                .temporal_coherence = self.temporal_coherence,
+                .lod_source = &self.gbuffer_draw_list,
+            });
+            self.buildBatches(&self.shadow_map_draw_lists[cascade_index], &self.shadow_map_batches[cascade_index], &self.shadow_map_instances[cascade_index]);
 
             {
                 const trazy_zone2 = ztracy.ZoneNC(@src(), "Upload instance data", 0x00_ff_ff_00);
@@ -414,17 +530,12 @@ pub const DynamicGeometryPass = struct {
                 const instance_data_buffer_index = self.renderer.getBufferBindlessIndex(self.shadow_map_instance_buffers[cascade_index][frame_index]);
                 const material_buffer_index = self.renderer.getBufferBindlessIndex(self.renderer.material_buffer.buffer);
 
-                var batch_keys_iterator = self.shadow_map_batches[cascade_index].keyIterator();
-                while (batch_keys_iterator.next()) |batch_key| {
+                for (self.shadow_map_batches[cascade_index].items) |batch| {
+                    const batch_key = batch.key;
                     if (batch_key.surface_type != .cutout) {
                         continue;
                     }
 
-                    const batch = self.shadow_map_batches[cascade_index].getPtr(batch_key.*).?;
-                    if (batch.instances.items.len == 0) {
-                        continue;
-                    }
-
                     const pipeline_ids = self.renderer.getMaterialPipelineIds(batch_key.material_id);
                     const pipeline_id = pipeline_ids.shadow_caster_pipeline_id.?;
                     const pipeline = self.renderer.getPSO(pipeline_id);
@@ -451,7 +562,7 @@ pub const DynamicGeometryPass = struct {
                             cmd_list,
                             mesh.geometry.*.pDrawArgs[sub_mesh_index].mIndexCount,
                             mesh.geometry.*.pDrawArgs[sub_mesh_index].mStartIndex,
-                            mesh.geometry.*.pDrawArgs[sub_mesh_index].mInstanceCount * @as(u32, @intCast(batch.instances.items.len)),
+                            mesh.geometry.*.pDrawArgs[sub_mesh_index].mInstanceCount * batch.instance_count,
                             mesh.geometry.*.pDrawArgs[sub_mesh_index].mVertexOffset,
                             mesh.geometry.*.pDrawArgs[sub_mesh_index].mStartInstance + batch.start_instance_location,
                         );
@@ -472,17 +583,12 @@ pub const DynamicGeometryPass = struct {
                 const instance_data_buffer_index = self.renderer.getBufferBindlessIndex(self.shadow_map_instance_buffers[cascade_index][frame_index]);
                 const material_buffer_index = self.renderer.getBufferBindlessIndex(self.renderer.material_buffer.buffer);
 
-                var batch_keys_iterator = self.shadow_map_batches[cascade_index].keyIterator();
-                while (batch_keys_iterator.next()) |batch_key| {
+                for (self.shadow_map_batches[cascade_index].items) |batch| {
+                    const batch_key = batch.key;
                     if (batch_key.surface_type != .@"opaque") {
                         continue;
                     }
 
-                    const batch = self.shadow_map_batches[cascade_index].getPtr(batch_key.*).?;
-                    if (batch.instances.items.len == 0) {
-                        continue;
-                    }
-
                     const pipeline_ids = self.renderer.getMaterialPipelineIds(batch_key.material_id);
                     const pipeline_id = pipeline_ids.shadow_caster_pipeline_id.?;
                     const pipeline = self.renderer.getPSO(pipeline_id);
@@ -509,7 +615,7 @@ pub const DynamicGeometryPass = struct {
                             cmd_list,
                             mesh.geometry.*.pDrawArgs[sub_mesh_index].mIndexCount,
                             mesh.geometry.*.pDrawArgs[sub_mesh_index].mStartIndex,
-                            mesh.geometry.*.pDrawArgs[sub_mesh_index].mInstanceCount * @as(u32, @intCast(batch.instances.items.len)),
+                            mesh.geometry.*.pDrawArgs[sub_mesh_index].mInstanceCount * batch.instance_count,
                             mesh.geometry.*.pDrawArgs[sub_mesh_index].mVertexOffset,
                             mesh.geometry.*.pDrawArgs[sub_mesh_index].mStartInstance + batch.start_instance_location,
                         );
@@ -586,130 +692,57 @@ pub const DynamicGeometryPass = struct {
         }
     }
 
-    fn batchEntities(self: *@This(), render_view: renderer.RenderView, batch_map: *BatchMap) void {
-        const trazy_zone = ztracy.ZoneNC(@src(), "Batch Entities", 0x00_ff_ff_00);
+    // One batch per sub mesh of every model and LoD in the draw list, with its instances back to
+    // back. Batches are sorted by material and mesh.
+    fn buildBatches(self: *@This(), draw_list: *const DrawList, batches: *std.ArrayList(Batch), instances: *std.ArrayList(InstanceData)) void {
+        const trazy_zone = ztracy.ZoneNC(@src(), "Build Batches", 0x00_ff_ff_00);
         defer trazy_zone.End();
 
-        const camera_position = render_view.position;
+        batches.clearRetainingCapacity();
+        instances.clearRetainingCapacity();
 
-        // Clear existing batches' instances
-        {
-            const trazy_zone2 = ztracy.ZoneNC(@src(), "Clear", 0x00_ff_ff_00);
-            defer trazy_zone2.End();
-            var batch_keys_iterator = batch_map.keyIterator();
-            while (batch_keys_iterator.next()) |batch_key| {
-                const batch = batch_map.getPtr(batch_key.*).?;
-                batch.start_instance_location = 0;
-                batch.instances.clearRetainingCapacity();
-            }
-        }
+        for (draw_list.batches.items) |draw_batch| {
+            const model = &self.models.items[draw_batch.model];
+            const lod = &model.lods[draw_batch.lod];
+            const slots = draw_list.batchSlots(draw_batch);
 
-        const max_draw_distance_squared = max_draw_distance * max_draw_distance;
-
-        for (self.renderer.dynamic_entities.items) |dynamic_entity| {
-            var lod: *const renderer_types.Lod = &dynamic_entity.lods[0];
-            var sub_mesh_count = lod.materials_count;
-            if (sub_mesh_count == 0) {
-                continue;
-            }
-
-            {
-                const trazy_zone2 = ztracy.ZoneNC(@src(), "culling", 0x00_ff_ff_00);
-                defer trazy_zone2.End();
-                // Distance culling
-                if (!isWithinCameraDrawDistance(camera_position, dynamic_entity.position, max_draw_distance_squared)) {
-                    continue;
-                }
-
-                const mesh = self.renderer.getLegacyMesh(lod.mesh_handle);
-                const z_aabbcenter = zm.loadArr3w(mesh.geometry.*.mAabbCenter, 1.0);
-                var bounding_sphere_center: [3]f32 = .{ 0.0, 0.0, 0.0 };
-                zm.storeArr3(&bounding_sphere_center, zm.mul(z_aabbcenter, dynamic_entity.world));
-                const bounding_sphere_radius = mesh.geometry.*.mRadius * dynamic_entity.scale;
-                if (!render_view.frustum.isVisible(bounding_sphere_center, bounding_sphere_radius)) {
-                    continue;
+            for (0..lod.materials_count) |sub_mesh_index| {
+                // NOTE: Whatever doesn't fit in the instance buffer isn't drawn.
+                const instance_count: u32 = @intCast(@min(slots.len, max_instances - instances.items.len));
+                if (instance_count == 0) {
+                    break;
                 }
-            }
-
-            // LOD Selection
-            const trazy_zone2 = ztracy.ZoneNC(@src(), "selectlod", 0x00_ff_ff_00);
-            lod = selectLOD(dynamic_entity.lods[0..dynamic_entity.lod_count], camera_position, dynamic_entity.position);
-            sub_mesh_count = lod.materials_count;
-            trazy_zone2.End();
-
-            {
-                const trazy_zone3 = ztracy.ZoneNC(@src(), "batch", 0x00_ff_ff_00);
-                defer trazy_zone3.End();
-                for (0..sub_mesh_count) |sub_mesh_index| {
-                    const material_id = lod.materials[sub_mesh_index];
-
-                    var batch_key: BatchKey = undefined;
-                    batch_key.material_id = material_id;
-                    batch_key.mesh_handle = lod.mesh_handle;
-                    batch_key.sub_mesh_index = @intCast(sub_mesh_index);
-                    batch_key.surface_type = .@"opaque";
-
-                    const material_index = self.renderer.getMaterialIndex(material_id);
-                    const alpha_test = self.renderer.getMaterialAlphaTest(material_id);
-                    if (alpha_test) {
-                        batch_key.surface_type = .cutout;
-                    }
-
-                    var instance_data: InstanceData = undefined;
-                    zm.storeMat(&instance_data.object_to_world, dynamic_entity.world);
-                    instance_data.material_index = @intCast(material_index);
-
-                    if (!batch_map.contains(batch_key)) {
-                        const batch = Batch{
-                            .instances = std.ArrayList(InstanceData).initCapacity(self.allocator, 10000) catch unreachable,
-                            .start_instance_location = 0,
-                        };
-                        batch_map.putAssumeCapacity(batch_key, batch);
-                    }
 
-                    const batch = batch_map.getPtr(batch_key).?;
-                    batch.*.instances.appendAssumeCapacity(instance_data);
+                batches.append(.{
+                    .key = .{
+                        .material_id = lod.materials[sub_mesh_index],
+                        .mesh_handle = lod.mesh_handle,
+                        .sub_mesh_index = @intCast(sub_mesh_index),
+                        .surface_type = model.surface_types[draw_batch.lod][sub_mesh_index],
+                    },
+                    .start_instance_location = @intCast(instances.items.len),
+                    .instance_count = instance_count,
+                }) catch unreachable;
+
+                const material_index = model.material_indices[draw_batch.lod][sub_mesh_index];
+                const batch_instances = instances.addManyAsSlice(instance_count) catch unreachable;
+                for (batch_instances, slots[0..instance_count]) |*instance_data, slot| {
+                    instance_data.object_to_world = self.instances.items[slot].world;
+                    instance_data.material_index = material_index;
                 }
             }
         }
-    }
-};
 
-inline fn isWithinCameraDrawDistance(camera_position: [3]f32, entity_position: [3]f32, max_draw_distance_squared: f32) bool {
-    const z_camera_position = zm.loadArr3(camera_position);
-    const z_entity_position = zm.loadArr3(entity_position);
-    if (zm.lengthSq3(z_camera_position - z_entity_position)[0] <= (max_draw_distance_squared)) {
-        return true;
+        std.mem.sort(Batch, batches.items, {}, batchLessThan);
     }
+};
 
-    return false;
-}
-
-fn selectLOD(lods: []const renderer_types.Lod, camera_position: [3]f32, entity_position: [3]f32) *const renderer_types.Lod {
-    if (lods.len == 1) {
-        return &lods[0];
+fn batchLessThan(_: void, a: Batch, b: Batch) bool {
+    if (a.key.material_id != b.key.material_id) {
+        return a.key.material_id < b.key.material_id;
     }
-
-    const z_camera_position = zm.loadArr3(camera_position);
-    const z_entity_position = zm.loadArr3(entity_position);
-    const distance_squared = zm.lengthSq3(z_camera_position - z_entity_position)[0];
-
-    const lod1_distance_squared = 50.0 * 50.0;
-    const lod2_distance_squared = 100.0 * 100.0;
-    const lod3_distance_squared = 200.0 * 200.0;
-
-    var lod: u32 = 0;
-
-    if (distance_squared >= lod3_distance_squared) {
-        lod = 3;
-    } else if (distance_squared >= lod2_distance_squared) {
-        lod = 2;
-    } else if (distance_squared >= lod1_distance_squared) {
-        lod = 1;
-    } else {
-        lod = 0;
+    if (a.key.mesh_handle.id != b.key.mesh_handle.id) {
+        return a.key.mesh_handle.id < b.key.mesh_handle.id;
     }
-
-    lod = @min(lod, lods.len - 1);
-    return &lods[lod];
+    return a.key.sub_mesh_index < b.key.sub_mesh_index;
 }
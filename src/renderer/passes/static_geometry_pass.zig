@@ -12,41 +12,24 @@ const im3d = @import("im3d");
 const OpaqueSlice = util.OpaqueSlice;
 const PrefabManager = @import("../../prefab_manager.zig").PrefabManager;
 const pso = @import("../../renderer/pso.zig");
+const RangeAllocator = @import("../../core/range_allocator.zig").RangeAllocator;
 const renderer = @import("../../renderer/renderer.zig");
 const Renderer = renderer.Renderer;
 const renderer_types = @import("../../renderer/types.zig");
+const static_geometry_culling = @import("../../renderer/static_geometry_culling.zig");
 const util = @import("../../util.zig");
 const zforge = @import("zforge");
 const zgui = @import("zgui");
 const zm = @import("zmath");
 const ztracy = @import("ztracy");
 
-const instances_max_count = 1000000;
-const meshlets_max_count = 1 << 20;
-const EntityMap = std.AutoHashMap(u64, struct { index: usize, count: u32 });
+const instances_max_count = static_geometry_culling.instances_max_count;
+const meshlets_max_count = static_geometry_culling.meshlets_max_count;
 
-const GpuInstanceFlags = packed struct(u32) {
-    destroyed: u1,
-    draw_bounds: u1,
-    _padding: u30,
-};
-
-const GpuInstance = struct {
-    world: [16]f32,
-    bounds_origin: [3]f32,
-    renderable_item_id: u32,
-    bounds_extents: [3]f32,
-    renderable_item_count: u32,
-    flags: GpuInstanceFlags,
-    _pad: [3]u32,
-};
-
-const GpuMeshletCandidate = struct {
-    instance_id: u32,
-    mesh_index: u32,
-    material_index: u32,
-    meshlet_index: u32,
-};
+// Shared with the CPU culling reference, which reads the same buffers.
+const GpuInstanceFlags = static_geometry_culling.GpuInstanceFlags;
+const GpuInstance = static_geometry_culling.GpuInstance;
+const GpuMeshletCandidate = static_geometry_culling.GpuMeshletCandidate;
 
 const GpuInstanceRange = struct {
     index: u32,
@@ -134,9 +117,12 @@ pub const StaticGeometryPass = struct {
     render_settings: RenderSettings,
 
     instances: std.ArrayList(GpuInstance),
-    free_ranges: std.ArrayList(GpuInstanceRange),
     instances_to_destroy: std.ArrayList(GpuInstanceRange),
-    entity_map: EntityMap,
+    // Slots are handed out when a renderable is added, but only go back to the allocator the frame
+    // after the GPU destroyed them, so a new instance never lands in a slot that's being cleared.
+    instance_slots: RangeAllocator,
+    instance_slots_to_free: std.ArrayList(RangeAllocator.Allocation),
+    added_instances: std.ArrayList(renderer_types.RenderableEntity),
 
     // Global Buffers
     instance_buffer: renderer.ElementBindlessBuffer,
@@ -211,27 +197,38 @@ pub const StaticGeometryPass = struct {
         }
 
         self.instances = std.ArrayList(GpuInstance).init(self.allocator);
-        self.free_ranges = std.ArrayList(GpuInstanceRange).init(self.allocator);
         self.instances_to_destroy = std.ArrayList(GpuInstanceRange).init(self.allocator);
-        self.entity_map = EntityMap.init(self.allocator);
+        self.instance_slots = RangeAllocator.create(self.allocator, instances_max_count);
+        self.instance_slots_to_free = std.ArrayList(RangeAllocator.Allocation).init(self.allocator);
+        self.added_instances = std.ArrayList(renderer_types.RenderableEntity).init(self.allocator);
     }
 
     pub fn destroy(self: *@This()) void {
-        self.free_ranges.deinit();
         self.instances_to_destroy.deinit();
         self.instances.deinit();
-        self.entity_map.deinit();
+        self.instance_slots.destroy();
+        self.instance_slots_to_free.deinit();
+        self.added_instances.deinit();
+    }
+
+    // Called by the renderer system when a renderable shows up, the slot is stored on the entity.
+    pub fn allocateInstance(self: *@This()) RangeAllocator.Allocation {
+        return self.instance_slots.alloc(1).?;
     }
 
     pub fn update(self: *@This(), cmd_list: [*c]graphics.Cmd) void {
+        // Last frame's destroy dispatch has run by now.
+        for (self.instance_slots_to_free.items) |slot| {
+            self.instance_slots.free(slot);
+        }
+        self.instance_slots_to_free.clearRetainingCapacity();
+
         self.instances_to_destroy.clearRetainingCapacity();
 
-        for (self.renderer.removed_static_entities.items) |static_entity_id| {
-            if (self.entity_map.get(static_entity_id)) |entity_info| {
-                self.instances_to_destroy.append(.{ .index = @intCast(entity_info.index), .count = 1 }) catch unreachable;
-                _ = self.entity_map.remove(static_entity_id);
-            }
+        for (self.renderer.removed_static_instances.items) |slot| {
+            self.instances_to_destroy.append(.{ .index = slot.offset, .count = 1 }) catch unreachable;
         }
+        self.instance_slots_to_free.appendSlice(self.renderer.removed_static_instances.items) catch unreachable;
 
         if (self.instances_to_destroy.items.len > 0) {
             var compacted_list = std.ArrayList(GpuInstanceRange).init(self.allocator);
@@ -278,94 +275,63 @@ pub const StaticGeometryPass = struct {
             graphics.cmdBindPipeline(cmd_list, pipeline);
             graphics.cmdBindDescriptorSet(cmd_list, self.renderer.frame_index, self.destroy_instances_descriptor_set);
             graphics.cmdDispatch(cmd_list, 1, 1, 1);
-
-            // Add the newly freed ranges to the free ranges list
-            compacted_list.appendSlice(self.free_ranges.items) catch unreachable;
-            self.free_ranges.clearRetainingCapacity();
-            calculatePrefixSum(&compacted_list, &self.free_ranges);
         }
 
         if (self.renderer.added_static_entities.items.len > 0) {
-            self.instances.clearRetainingCapacity();
+            // Sorted by slot so neighboring slots go up in one copy. The sort is stable, when an
+            // entity was set more than once this frame its last set is uploaded last.
+            self.added_instances.clearRetainingCapacity();
+            self.added_instances.appendSlice(self.renderer.added_static_entities.items) catch unreachable;
+            std.mem.sort(renderer_types.RenderableEntity, self.added_instances.items, {}, renderableEntitiesSorter);
 
-            const total_static_entities = self.renderer.added_static_entities.items.len;
-            var processed_static_entities: usize = 0;
-            var filled_up_ranges: usize = 0;
-
-            for (self.free_ranges.items) |*free_range| {
-                const count = @min(free_range.count, total_static_entities - processed_static_entities);
-
-                for (0..count) |static_entity_index| {
-                    const static_entity = self.renderer.added_static_entities.items[processed_static_entities];
-                    processed_static_entities += 1;
-                    const gpu_instance = self.convertEntityToGpuInstance(static_entity);
-
-                    self.instances.append(gpu_instance) catch unreachable;
-                    self.entity_map.put(static_entity.entity_id, .{ .index = free_range.index + static_entity_index, .count = 1 }) catch unreachable;
-
-                    if (static_entity_index + 1 == free_range.count) {
-                        // We filled up this range, push it
-                        filled_up_ranges += 1;
-
-                        // Upload to the GPU
-                        {
-                            const instance_data = OpaqueSlice{
-                                .data = @ptrCast(self.instances.items.ptr),
-                                .size = self.instances.items.len * @sizeOf(GpuInstance),
-                            };
-
-                            self.renderer.updateBuffer(instance_data, free_range.index * @sizeOf(GpuInstance), GpuInstance, self.instance_buffer.buffer);
-                        }
-
-                        self.instances.clearRetainingCapacity();
-                        break;
-                    } else if (total_static_entities == processed_static_entities) {
-                        // We processed all of the entities
-                        // Upload to the GPU
-                        {
-                            const instance_data = OpaqueSlice{
-                                .data = @ptrCast(self.instances.items),
-                                .size = self.instances.items.len * @sizeOf(GpuInstance),
-                            };
-
-                            self.renderer.updateBuffer(instance_data, free_range.index * @sizeOf(GpuInstance), GpuInstance, self.instance_buffer.buffer);
-                        }
-
-                        self.instances.clearRetainingCapacity();
-                        break;
-                    }
-                }
+            // calculatePrefixSum left the slots to destroy sorted too.
+            const destroyed = self.instances_to_destroy.items;
+            var destroyed_index: usize = 0;
 
-                free_range.count -= count;
-                free_range.index += count;
-            }
+            var run_start: u32 = self.added_instances.items[0].instance_index;
+            self.instances.clearRetainingCapacity();
+            for (self.added_instances.items) |static_entity| {
+                while (destroyed_index < destroyed.len and destroyed[destroyed_index].index < static_entity.instance_index) {
+                    destroyed_index += 1;
+                }
+                if (destroyed_index < destroyed.len and destroyed[destroyed_index].index == static_entity.instance_index) {
+                    // Added and removed in the same frame.
+                    continue;
+                }
 
-            for (0..filled_up_ranges) |_| {
-                _ = self.free_ranges.orderedRemove(0);
+                const run_end = run_start + @as(u32, @intCast(self.instances.items.len));
+                if (static_entity.instance_index + 1 == run_end) {
+                    self.instances.items[self.instances.items.len - 1] = self.convertEntityToGpuInstance(static_entity);
+                    continue;
+                }
+                if (static_entity.instance_index != run_end) {
+                    self.uploadInstances(run_start);
+                    run_start = static_entity.instance_index;
+                }
+                self.instances.append(self.convertEntityToGpuInstance(static_entity)) catch unreachable;
             }
+            self.uploadInstances(run_start);
+        }
 
-            if (processed_static_entities < total_static_entities) {
-                var instance_buffer_index = self.instance_buffer.element_count;
-                for (self.renderer.added_static_entities.items[processed_static_entities..]) |static_entity| {
-                    const gpu_instance = self.convertEntityToGpuInstance(static_entity);
-
-                    self.instances.append(gpu_instance) catch unreachable;
-                    self.entity_map.put(static_entity.entity_id, .{ .index = instance_buffer_index, .count = 1 }) catch unreachable;
-                    instance_buffer_index += 1;
-                }
+        // The GPU walks every slot up to the highest one in use, freed slots in between are
+        // flagged as destroyed.
+        self.instance_buffer.element_count = self.instance_slots.used_end;
+        self.instance_buffer.offset = self.instance_slots.used_end * @sizeOf(GpuInstance);
+    }
 
-                self.instance_buffer.element_count += @intCast(self.instances.items.len);
+    fn uploadInstances(self: *@This(), first_slot: u32) void {
+        if (self.instances.items.len == 0) {
+            return;
+        }
 
-                const instance_data = OpaqueSlice{
-                    .data = @ptrCast(self.instances.items),
-                    .size = self.instances.items.len * @sizeOf(GpuInstance),
-                };
+        const instance_data = OpaqueSlice{
+            .data = @ptrCast(self.instances.items),
+            .size = self.instances.items.len * @sizeOf(GpuInstance),
+        };
 
-                std.debug.assert(self.instance_buffer.size > instance_data.size + self.instance_buffer.offset);
-                self.renderer.updateBuffer(instance_data, self.instance_buffer.offset, GpuInstance, self.instance_buffer.buffer);
-                self.instance_buffer.offset += instance_data.size;
-            }
-        }
+        std.debug.assert(self.instance_buffer.size >= instance_data.size + first_slot * @sizeOf(GpuInstance));
+        self.renderer.updateBuffer(instance_data, first_slot * @sizeOf(GpuInstance), GpuInstance, self.instance_buffer.buffer);
+        self.instances.clearRetainingCapacity();
     }
 
     fn convertEntityToGpuInstance(self: *@This(), static_entity: renderer_types.RenderableEntity) GpuInstance {
@@ -411,9 +377,15 @@ pub const StaticGeometryPass = struct {
         return a.index < b.index;
     }
 
+    fn renderableEntitiesSorter(_: void, a: renderer_types.RenderableEntity, b: renderer_types.RenderableEntity) bool {
+        return a.instance_index < b.instance_index;
+    }
+
     pub fn renderImGui(self: *@This()) void {
         if (zgui.collapsingHeader("Static Geometry Renderer", .{})) {
-            zgui.text("Total loaded instances: {d}", .{self.instance_buffer.element_count});
+            zgui.text("Total loaded instances: {d}", .{self.instance_slots.allocation_count});
+            zgui.text("Instance slots in use: {d}, free below: {d}", .{ self.instance_buffer.element_count, self.instance_buffer.element_count - self.instance_slots.allocation_count });
+            zgui.text("Largest free slot range: {d}, fragmentation: {d:.2}", .{ self.instance_slots.largestFreeRange(), self.instance_slots.fragmentation() });
             _ = zgui.checkbox("Freeze Culling", .{ .v = &self.render_settings.freeze_culling });
         }
     }
@@ -8,6 +8,7 @@ const fd = @import("../../config/flecs_data.zig");
 const IdLocal = @import("../../core/core.zig").IdLocal;
 const renderer = @import("../../renderer/renderer.zig");
 const renderer_types = @import("../../renderer/types.zig");
+const terrain_quad_tree = @import("../../renderer/terrain_quad_tree.zig");
 const tides_math = @import("../../core/math.zig");
 const zforge = @import("zforge");
 const zgui = @import("zgui");
@@ -23,6 +24,8 @@ const graphics = zforge.graphics;
 const resource_loader = zforge.resource_loader;
 const TerrainInstanceData = renderer_types.TerrainInstanceData;
 const InstanceRootConstants = renderer_types.InstanceRootConstants;
+const QuadTreeNode = terrain_quad_tree.QuadTreeNode;
+const TerrainQuadSelector = terrain_quad_tree.TerrainQuadSelector;
 
 const lod_load_range = 4300;
 const max_instances = 16384;
@@ -34,6 +37,8 @@ const TerrainRenderSettings = struct {
     black_point: f32,
     white_point: f32,
     tiling_distance_max: f32,
+    frustum_culling: bool,
+    horizon_culling: bool,
 };
 
 const TerrainLayer = struct {
@@ -80,17 +85,23 @@ pub const TerrainPass = struct {
     frame_instance_count: u32,
     instance_data_buffers: [frames_count]renderer.BufferHandle,
     instance_data: std.ArrayList(TerrainInstanceData),
+    // The camera draws what's left after culling, shadows everything that was selected. Both
+    // go into the same buffer, camera instances first.
     instance_data_by_lod: [4]std.ArrayList(TerrainInstanceData),
+    shadow_instance_data_by_lod: [4]std.ArrayList(TerrainInstanceData),
+    dropped_instance_count: usize, // That didn't fit in max_instances last frame
 
     gbuffer_bindings: PassBindings = undefined,
     shadows_bindings: [renderer.Renderer.cascades_max_count]PassBindings = undefined,
 
     terrain_quad_tree_nodes: std.ArrayList(QuadTreeNode),
+    // TODO(gmodarelli): Do not store these here when we implement streaming
+    heightmap_handles: std.ArrayList(renderer.TextureHandle), // One per quad tree node
     terrain_lod_meshes: std.ArrayList(renderer.LegacyMeshHandle),
-    quads_to_render: std.ArrayList(u32),
-    quads_to_load: std.ArrayList(u32),
+    quad_selector: *TerrainQuadSelector,
 
     heightmap_patch_type_id: world_patch_manager.PatchTypeId,
+    region_subscription: world_patch_manager.RegionSubscriptionId = undefined,
 
     cam_pos_old: [3]f32 = .{ -100000, 0, -100000 }, // NOTE(Anders): Assumes only one camera
 
@@ -103,15 +114,17 @@ pub const TerrainPass = struct {
             .black_point = 0.45,
             .white_point = 1.0,
             .tiling_distance_max = 200.0,
+            .frustum_culling = true,
+            .horizon_culling = true,
         };
         self.frame_instance_count = 0;
+        self.dropped_instance_count = 0;
         self.cam_pos_old = .{ -100000, 0, -100000 }; // NOTE(Anders): Assumes only one camera
 
         // TODO(gmodarelli): This is just enough for a single sector, but it's good for testing
         const max_quad_tree_nodes: usize = 85 * lod_3_patches_total;
         self.terrain_quad_tree_nodes = std.ArrayList(QuadTreeNode).initCapacity(self.allocator, max_quad_tree_nodes) catch unreachable;
-        self.quads_to_render = std.ArrayList(u32).init(self.allocator);
-        self.quads_to_load = std.ArrayList(u32).init(self.allocator);
+        self.quad_selector = TerrainQuadSelector.create(self.allocator, rctx.jobs.frame);
 
         // Create initial sectors
         {
@@ -129,9 +142,6 @@ pub const TerrainPass = struct {
                         .child_indices = [4]u32{ invalid_index, invalid_index, invalid_index, invalid_index },
                         .mesh_lod = 3,
                         .patch_index = [2]u32{ patch_x, patch_y },
-                        .bounding_sphere_center = undefined,
-                        .bounding_sphere_radius = 0.0,
-                        .heightmap_handle = renderer.TextureHandle.nil,
                     });
                 }
             }
@@ -141,8 +151,11 @@ pub const TerrainPass = struct {
             var sector_index: u32 = 0;
             while (sector_index < lod_3_patches_total) : (sector_index += 1) {
                 const node = &self.terrain_quad_tree_nodes.items[sector_index];
-                divideQuadTreeNode(&self.terrain_quad_tree_nodes, node);
+                terrain_quad_tree.divideQuadTreeNode(&self.terrain_quad_tree_nodes, node);
             }
+
+            self.heightmap_handles = std.ArrayList(renderer.TextureHandle).initCapacity(self.allocator, self.terrain_quad_tree_nodes.items.len) catch unreachable;
+            self.heightmap_handles.appendNTimesAssumeCapacity(renderer.TextureHandle.nil, self.terrain_quad_tree_nodes.items.len);
         }
 
         self.heightmap_patch_type_id = world_patch_mgr.getPatchTypeId(config.patch_type_heightmap);
@@ -151,6 +164,7 @@ pub const TerrainPass = struct {
         // Create instance buffers.
         for (0..4) |lod_index| {
             self.instance_data_by_lod[lod_index] = std.ArrayList(TerrainInstanceData).init(allocator);
+            self.shadow_instance_data_by_lod[lod_index] = std.ArrayList(TerrainInstanceData).init(allocator);
         }
         self.instance_data = std.ArrayList(TerrainInstanceData).initCapacity(allocator, max_instances) catch unreachable;
         self.instance_data_buffers = blk: {
@@ -183,11 +197,12 @@ pub const TerrainPass = struct {
     pub fn destroy(self: *TerrainPass) void {
         self.terrain_lod_meshes.deinit();
         self.terrain_quad_tree_nodes.deinit();
-        self.quads_to_render.deinit();
-        self.quads_to_load.deinit();
+        self.heightmap_handles.deinit();
+        self.quad_selector.destroy();
         self.instance_data.deinit();
         for (0..4) |lod_index| {
             self.instance_data_by_lod[lod_index].deinit();
+            self.shadow_instance_data_by_lod[lod_index].deinit();
         }
     }
 
@@ -197,86 +212,51 @@ pub const TerrainPass = struct {
 
         const frame_index = self.renderer.frame_index;
 
-        var arena_state = std.heap.ArenaAllocator.init(self.allocator);
-        defer arena_state.deinit();
-        const arena = arena_state.allocator();
-
-        // Reset transforms, materials and draw calls array list
-        self.quads_to_render.clearRetainingCapacity();
-        self.quads_to_load.clearRetainingCapacity();
-
         {
-            const trazy_zone_2 = ztracy.ZoneNC(@src(), "collectQuadsToRenderForSector", 0x00_ff_ff_00);
+            const trazy_zone_2 = ztracy.ZoneNC(@src(), "Select Quads", 0x00_ff_ff_00);
             defer trazy_zone_2.End();
-            const camera_point = [2]f32{ render_view.position[0], render_view.position[2] };
 
-            var sector_index: u32 = 0;
-            while (sector_index < lod_3_patches_total) : (sector_index += 1) {
-                const lod3_node = &self.terrain_quad_tree_nodes.items[sector_index];
-
-                collectQuadsToRenderForSector(
-                    self,
-                    camera_point,
-                    lod_load_range,
-                    lod3_node,
-                    sector_index,
-                    arena,
-                ) catch unreachable;
-            }
+            self.quad_selector.select(self.terrain_quad_tree_nodes.items, lod_3_patches_total, .{
+                .frustum_planes = render_view.frustum.planes,
+                .camera_position = render_view.position,
+                .frustum_culling = self.terrain_render_settings.frustum_culling,
+                .horizon_culling = self.terrain_render_settings.horizon_culling,
+            }, lod_load_range);
         }
 
-        // var camera_entity = util.getActiveCameraEnt(self.ecsu_world);
-        // const camera_comps = camera_entity.getComps(struct { camera: *const fd.Camera });
-
         self.frame_instance_count = 0;
         {
-            // const trazy_zone_2 = ztracy.ZoneNC(@src(), "Culling", 0x00_ff_ff_00);
-            // defer trazy_zone_2.End();
-            // const nodes_count: i32 = @intCast(self.quads_to_render.items.len);
-            // var node_index: i32 = nodes_count - 1;
-
-            // // CPU Frustum culling
-            // while (node_index >= 0) : (node_index -= 1) {
-            //     const quad_index = self.quads_to_render.items[@intCast(node_index)];
-            //     const quad = &self.terrain_quad_tree_nodes.items[@intCast(quad_index)];
-
-            //     if (!camera_comps.camera.isVisible(quad.bounding_sphere_center, quad.bounding_sphere_radius)) {
-            //         _ = self.quads_to_render.orderedRemove(@intCast(node_index));
-            //         continue;
-            //     }
-            // }
-
             self.instance_data.clearRetainingCapacity();
             for (0..4) |lod_index| {
                 self.instance_data_by_lod[lod_index].clearRetainingCapacity();
+                self.shadow_instance_data_by_lod[lod_index].clearRetainingCapacity();
             }
 
-            // TODO: Batch quads together by mesh lod
-            for (self.quads_to_render.items) |quad_index| {
+            for (self.quad_selector.quads_visible.items) |quad_index| {
                 const quad = &self.terrain_quad_tree_nodes.items[quad_index];
-
-                // Add instance data
-                {
-                    var terrain_instance_data: TerrainInstanceData = undefined;
-
-                    const z_world = zm.translation(quad.center[0], 0.0, quad.center[1]);
-                    zm.storeMat(&terrain_instance_data.object_to_world, z_world);
-
-                    // TODO: Generate from quad.patch_index
-                    terrain_instance_data.heightmap_index = self.renderer.getTextureBindlessIndex(quad.heightmap_handle);
-                    terrain_instance_data.lod = quad.mesh_lod;
-                    terrain_instance_data.padding1 = [2]u32{ 42, 42 };
-
-                    self.instance_data_by_lod[quad.mesh_lod].append(terrain_instance_data) catch unreachable;
-                }
+                self.instance_data_by_lod[quad.mesh_lod].append(self.getInstanceData(quad_index)) catch unreachable;
+            }
+            for (self.quad_selector.quads_to_render.items) |quad_index| {
+                const quad = &self.terrain_quad_tree_nodes.items[quad_index];
+                self.shadow_instance_data_by_lod[quad.mesh_lod].append(self.getInstanceData(quad_index)) catch unreachable;
             }
 
-            self.instance_data.appendSliceAssumeCapacity(self.instance_data_by_lod[0].items);
-            self.instance_data.appendSliceAssumeCapacity(self.instance_data_by_lod[1].items);
-            self.instance_data.appendSliceAssumeCapacity(self.instance_data_by_lod[2].items);
-            self.instance_data.appendSliceAssumeCapacity(self.instance_data_by_lod[3].items);
-
-            std.debug.assert(self.instance_data.items.len < max_instances);
+            // NOTE: Whatever doesn't fit in the instance buffer isn't drawn, the camera's quads
+            // and the lower LODs are kept first.
+            var instance_budget: usize = max_instances;
+            var dropped_instance_count: usize = 0;
+            for (&self.instance_data_by_lod) |*lod_instance_data| {
+                dropped_instance_count += clampToBudget(lod_instance_data, &instance_budget);
+                self.instance_data.appendSliceAssumeCapacity(lod_instance_data.items);
+            }
+            for (&self.shadow_instance_data_by_lod) |*lod_instance_data| {
+                dropped_instance_count += clampToBudget(lod_instance_data, &instance_budget);
+                self.instance_data.appendSliceAssumeCapacity(lod_instance_data.items);
+            }
+            if (dropped_instance_count > 0 and self.dropped_instance_count == 0) {
+                std.log.warn("Terrain: {d} quads don't fit in the {d} instances buffer and aren't drawn", .{ dropped_instance_count, max_instances });
+            }
+            self.dropped_instance_count = dropped_instance_count;
 
             if (self.instance_data.items.len > 0) {
                 const data_slice = OpaqueSlice{
@@ -288,9 +268,8 @@ pub const TerrainPass = struct {
         }
 
         const trazy_zone_loadNodeHeightmap = ztracy.ZoneNC(@src(), "loadNodeHeightmap", 0x00_ff_ff_00);
-        for (self.quads_to_load.items) |quad_index| {
-            const node = &self.terrain_quad_tree_nodes.items[quad_index];
-            self.loadNodeHeightmap(node) catch unreachable;
+        for (self.quad_selector.quads_to_load.items) |quad_index| {
+            self.loadNodeHeightmap(quad_index) catch unreachable;
         }
         trazy_zone_loadNodeHeightmap.End();
 
@@ -298,55 +277,7 @@ pub const TerrainPass = struct {
         if (tides_math.dist3_xz(self.cam_pos_old, render_view.position) > 32) {
             const trazy_zone_2 = ztracy.ZoneNC(@src(), "refresh patches", 0x00_ff_ff_00);
             defer trazy_zone_2.End();
-            var lookups_old = std.ArrayList(world_patch_manager.PatchLookup).initCapacity(arena, 1024 * 16) catch unreachable;
-            var lookups_new = std.ArrayList(world_patch_manager.PatchLookup).initCapacity(arena, 1024 * 16) catch unreachable;
-            for (0..3) |lod| {
-                lookups_old.clearRetainingCapacity();
-                lookups_new.clearRetainingCapacity();
-
-                const area_width = 8 * config.patch_size * @as(f32, @floatFromInt(std.math.pow(usize, 2, lod)));
-
-                const area_old = world_patch_manager.RequestRectangle{
-                    .x = self.cam_pos_old[0] - area_width,
-                    .z = self.cam_pos_old[2] - area_width,
-                    .width = area_width * 2,
-                    .height = area_width * 2,
-                };
-
-                const area_new = world_patch_manager.RequestRectangle{
-                    .x = render_view.position[0] - area_width,
-                    .z = render_view.position[2] - area_width,
-                    .width = area_width * 2,
-                    .height = area_width * 2,
-                };
-
-                const lod_u4 = @as(u4, @intCast(lod));
-                world_patch_manager.WorldPatchManager.getLookupsFromRectangle(self.heightmap_patch_type_id, area_old, lod_u4, &lookups_old);
-                world_patch_manager.WorldPatchManager.getLookupsFromRectangle(self.heightmap_patch_type_id, area_new, lod_u4, &lookups_new);
-
-                var i_old: u32 = 0;
-                blk: while (i_old < lookups_old.items.len) {
-                    var i_new: u32 = 0;
-                    while (i_new < lookups_new.items.len) {
-                        if (lookups_old.items[i_old].eql(lookups_new.items[i_new])) {
-                            _ = lookups_old.swapRemove(i_old);
-                            _ = lookups_new.swapRemove(i_new);
-                            continue :blk;
-                        }
-                        i_new += 1;
-                    }
-                    i_old += 1;
-                }
-
-                const rid = self.world_patch_mgr.getRequester(IdLocal.init("terrain_quad_tree")); // HACK(Anders)
-                // NOTE(Anders): HACK
-                if (self.cam_pos_old[0] != -100000) {
-                    self.world_patch_mgr.removeLoadRequestFromLookups(rid, lookups_old.items);
-                }
-
-                self.world_patch_mgr.addLoadRequestFromLookups(rid, lookups_new.items, .medium);
-            }
-
+            _ = self.world_patch_mgr.updateRegionSubscription(self.region_subscription, render_view.position[0], render_view.position[2]);
             self.cam_pos_old = render_view.position;
         }
     }
@@ -410,9 +341,13 @@ pub const TerrainPass = struct {
 
             const instance_data_buffer_index = self.renderer.getBufferBindlessIndex(self.instance_data_buffers[frame_index]);
 
+            // Shadow instances come after the camera ones.
             var start_instance_location: u32 = 0;
+            for (self.instance_data_by_lod) |lod_instance_data| {
+                start_instance_location += @intCast(lod_instance_data.items.len);
+            }
             for (0..4) |lod_index| {
-                if (self.instance_data_by_lod[lod_index].items.len == 0) {
+                if (self.shadow_instance_data_by_lod[lod_index].items.len == 0) {
                     continue;
                 }
 
@@ -439,13 +374,13 @@ pub const TerrainPass = struct {
                         cmd_list,
                         mesh.geometry.*.pDrawArgs[0].mIndexCount,
                         mesh.geometry.*.pDrawArgs[0].mStartIndex,
-                        mesh.geometry.*.pDrawArgs[0].mInstanceCount * @as(u32, @intCast(self.instance_data_by_lod[lod_index].items.len)),
+                        mesh.geometry.*.pDrawArgs[0].mInstanceCount * @as(u32, @intCast(self.shadow_instance_data_by_lod[lod_index].items.len)),
                         mesh.geometry.*.pDrawArgs[0].mVertexOffset,
                         mesh.geometry.*.pDrawArgs[0].mStartInstance + start_instance_location,
                     );
                 }
 
-                start_instance_location += @as(u32, @intCast(self.instance_data_by_lod[lod_index].items.len));
+                start_instance_location += @as(u32, @intCast(self.shadow_instance_data_by_lod[lod_index].items.len));
             }
         }
     }
@@ -453,6 +388,11 @@ pub const TerrainPass = struct {
     pub fn renderImGui(self: *@This()) void {
         if (zgui.collapsingHeader("Terrain Renderer", .{})) {
             _ = zgui.dragFloat("Tiling Distance Max", .{ .v = &self.terrain_render_settings.tiling_distance_max, .cfmt = "%.0f", .min = 10.0, .max = 1000.0, .speed = 10.0 });
+            _ = zgui.checkbox("Frustum Culling", .{ .v = &self.terrain_render_settings.frustum_culling });
+            _ = zgui.checkbox("Horizon Culling", .{ .v = &self.terrain_render_settings.horizon_culling });
+            zgui.text("Quads selected: {d}, visible: {d}", .{ self.quad_selector.quads_to_render.items.len, self.quad_selector.quads_visible.items.len });
+            zgui.text("Culled by frustum: {d}, by horizon: {d}", .{ self.quad_selector.frustum_culled_count, self.quad_selector.horizon_culled_count });
+            zgui.text("Dropped, over {d} instances: {d}", .{ max_instances, self.dropped_instance_count });
         }
     }
 
@@ -616,6 +556,14 @@ pub const TerrainPass = struct {
         var lookups = std.ArrayList(world_patch_manager.PatchLookup).initCapacity(arena, 1024) catch unreachable;
         world_patch_manager.WorldPatchManager.getLookupsFromRectangle(self.heightmap_patch_type_id, area, 3, &lookups);
         self.world_patch_mgr.addLoadRequestFromLookups(rid, lookups.items, .high);
+        // LOD 0-2 follow the camera, see update
+        self.region_subscription = self.world_patch_mgr.subscribeRegion(.{
+            .requester_id = rid,
+            .patch_type_id = self.heightmap_patch_type_id,
+            .radius = 8 * config.patch_size,
+            .lod_mask = 0b111,
+            .scale_radius_by_lod = true,
+        });
         // Make sure all LOD3 are resident
         self.world_patch_mgr.tickAll();
 
@@ -629,8 +577,7 @@ pub const TerrainPass = struct {
         {
             var i: u32 = 0;
             while (i < self.terrain_quad_tree_nodes.items.len) : (i += 1) {
-                const node = &self.terrain_quad_tree_nodes.items[i];
-                self.loadNodeHeightmap(node) catch unreachable;
+                self.loadNodeHeightmap(i) catch unreachable;
             }
         }
     }
@@ -701,8 +648,24 @@ pub const TerrainPass = struct {
         };
     }
 
-    fn loadNodeHeightmap(self: *@This(), node: *QuadTreeNode) !void {
-        if (node.heightmap_handle.id != renderer.TextureHandle.nil.id) {
+    fn getInstanceData(self: *@This(), quad_index: u32) TerrainInstanceData {
+        const quad = &self.terrain_quad_tree_nodes.items[quad_index];
+
+        var terrain_instance_data: TerrainInstanceData = undefined;
+        const z_world = zm.translation(quad.center[0], 0.0, quad.center[1]);
+        zm.storeMat(&terrain_instance_data.object_to_world, z_world);
+
+        // TODO: Generate from quad.patch_index
+        terrain_instance_data.heightmap_index = self.renderer.getTextureBindlessIndex(self.heightmap_handles.items[quad_index]);
+        terrain_instance_data.lod = quad.mesh_lod;
+        terrain_instance_data.padding1 = [2]u32{ 42, 42 };
+
+        return terrain_instance_data;
+    }
+
+    fn loadNodeHeightmap(self: *@This(), node_index: u32) !void {
+        const node = &self.terrain_quad_tree_nodes.items[node_index];
+        if (node.isLoaded()) {
             return;
         }
 
@@ -715,16 +678,8 @@ pub const TerrainPass = struct {
 
         const patch_info = self.world_patch_mgr.tryGetPatch(lookup, patch_types.Heightmap);
         if (patch_info.data_opt) |data| {
-            // Node Bounding Sphere
-            {
-                node.bounding_sphere_center[0] = node.center[0];
-                node.bounding_sphere_center[1] = (data.min + data.max) * 0.5;
-                node.bounding_sphere_center[2] = node.center[1];
-
-                // NOTE: This should be divided by 2, but we leave it like this to have a bit of margin
-                const node_diagonal = node.size[0] * std.math.sqrt2;
-                node.bounding_sphere_radius = @max(node_diagonal, (data.max - data.min));
-            }
+            node.height_min = data.min;
+            node.height_max = data.max;
 
             const data_slice = OpaqueSlice{
                 .data = @as(*anyopaque, @ptrCast(data.heightmap[0..].ptr)),
@@ -739,7 +694,8 @@ pub const TerrainPass = struct {
             ) catch unreachable;
 
             const trazy_zone = ztracy.ZoneNC(@src(), "loadTextureFromMemory", 0x00_ff_ff_00);
-            node.heightmap_handle = self.renderer.loadTextureFromMemory(65, 65, .R32_SFLOAT, data_slice, debug_name);
+            self.heightmap_handles.items[node_index] = self.renderer.loadTextureFromMemory(65, 65, .R32_SFLOAT, data_slice, debug_name);
+            node.loaded = true;
             defer trazy_zone.End();
         }
     }
@@ -781,169 +737,11 @@ const PassBindings = struct {
     }
 };
 
-const QuadTreeNode = struct {
-    center: [2]f32,
-    size: [2]f32,
-    child_indices: [4]u32,
-    mesh_lod: u32,
-    patch_index: [2]u32,
-    // Bounding Sphere
-    bounding_sphere_center: [3]f32,
-    bounding_sphere_radius: f32,
-    // TODO(gmodarelli): Do not store this here when we implement streaming
-    heightmap_handle: renderer.TextureHandle,
-
-    pub inline fn containsPoint(self: *QuadTreeNode, point: [2]f32) bool {
-        return (point[0] > (self.center[0] - self.size[0]) and
-            point[0] < (self.center[0] + self.size[0]) and
-            point[1] > (self.center[1] - self.size[1]) and
-            point[1] < (self.center[1] + self.size[1]));
-    }
-
-    pub inline fn nearPoint(self: *QuadTreeNode, point: [2]f32, range: f32) bool {
-        const half_size = self.size[0] / 2;
-        const circle_distance_x = @abs(point[0] - self.center[0]);
-        const circle_distance_y = @abs(point[1] - self.center[1]);
-
-        if (circle_distance_x > (half_size + range)) {
-            return false;
-        }
-        if (circle_distance_y > (half_size + range)) {
-            return false;
-        }
-
-        if (circle_distance_x <= (half_size)) {
-            return true;
-        }
-        if (circle_distance_y <= (half_size)) {
-            return true;
-        }
-
-        const corner_distance_sq = (circle_distance_x - half_size) * (circle_distance_x - half_size) +
-            (circle_distance_y - half_size) * (circle_distance_y - half_size);
-
-        return (corner_distance_sq <= (range * range));
-    }
-
-    pub inline fn isLoaded(self: *QuadTreeNode) bool {
-        return self.heightmap_handle.id != renderer.TextureHandle.nil.id;
-    }
-
-    pub fn containedInsideChildren(self: *QuadTreeNode, point: [2]f32, range: f32, nodes: *std.ArrayList(QuadTreeNode)) bool {
-        if (!self.nearPoint(point, range)) {
-            return false;
-        }
-
-        for (self.child_indices) |child_index| {
-            if (child_index == renderer_types.InvalidResourceIndex) {
-                return false;
-            }
-
-            var node = nodes.items[child_index];
-            if (node.nearPoint(point, range)) {
-                return true;
-            }
-        }
-
-        return false;
-    }
-
-    pub fn areChildrenLoaded(self: *QuadTreeNode, nodes: *std.ArrayList(QuadTreeNode)) bool {
-        if (!self.isLoaded()) {
-            return false;
-        }
-
-        for (self.child_indices) |child_index| {
-            if (child_index == renderer_types.InvalidResourceIndex) {
-                return false;
-            }
-
-            var node = nodes.items[child_index];
-            if (!node.isLoaded()) {
-                return false;
-            }
-        }
-
-        return true;
-    }
-};
-
-fn divideQuadTreeNode(
-    nodes: *std.ArrayList(QuadTreeNode),
-    node: *QuadTreeNode,
-) void {
-    if (node.mesh_lod == 0) {
-        return;
-    }
-
-    var child_index: u32 = 0;
-    while (child_index < 4) : (child_index += 1) {
-        const center_x = if (child_index % 2 == 0) node.center[0] - node.size[0] * 0.5 else node.center[0] + node.size[0] * 0.5;
-        const center_y = if (child_index < 2) node.center[1] + node.size[1] * 0.5 else node.center[1] - node.size[1] * 0.5;
-        const patch_index_x: u32 = if (child_index % 2 == 0) 0 else 1;
-        const patch_index_y: u32 = if (child_index < 2) 1 else 0;
-
-        const child_node = QuadTreeNode{
-            .center = [2]f32{ center_x, center_y },
-            .size = [2]f32{ node.size[0] * 0.5, node.size[1] * 0.5 },
-            .child_indices = [4]u32{ invalid_index, invalid_index, invalid_index, invalid_index },
-            .mesh_lod = node.mesh_lod - 1,
-            .patch_index = [2]u32{ node.patch_index[0] * 2 + patch_index_x, node.patch_index[1] * 2 + patch_index_y },
-            .bounding_sphere_center = undefined,
-            .bounding_sphere_radius = 0.0,
-            .heightmap_handle = renderer.TextureHandle.nil,
-        };
-
-        node.child_indices[child_index] = @as(u32, @intCast(nodes.items.len));
-        nodes.appendAssumeCapacity(child_node);
-
-        std.debug.assert(node.child_indices[child_index] < nodes.items.len);
-        divideQuadTreeNode(nodes, &nodes.items[node.child_indices[child_index]]);
-    }
-}
-
-// Algorithm that walks a quad tree and generates a list of quad tree nodes to render
-fn collectQuadsToRenderForSector(self: *TerrainPass, position: [2]f32, range: f32, node: *QuadTreeNode, node_index: u32, allocator: std.mem.Allocator) !void {
-    std.debug.assert(node_index != invalid_index);
-
-    if (node.mesh_lod == 0) {
-        return;
-    }
-
-    if (node.containedInsideChildren(position, range, &self.terrain_quad_tree_nodes) and node.areChildrenLoaded(&self.terrain_quad_tree_nodes)) {
-        var higher_lod_node_indices: [4]u32 = .{ invalid_index, invalid_index, invalid_index, invalid_index };
-        for (node.child_indices, 0..) |node_child_index, i| {
-            var child_node = &self.terrain_quad_tree_nodes.items[node_child_index];
-            if (child_node.nearPoint(position, range)) {
-                if (child_node.mesh_lod == 1 and child_node.areChildrenLoaded(&self.terrain_quad_tree_nodes)) {
-                    self.quads_to_render.appendSlice(child_node.child_indices[0..4]) catch unreachable;
-                } else if (child_node.mesh_lod == 1 and !child_node.areChildrenLoaded(&self.terrain_quad_tree_nodes)) {
-                    self.quads_to_render.append(node_child_index) catch unreachable;
-                    self.quads_to_load.appendSlice(child_node.child_indices[0..4]) catch unreachable;
-                } else if (child_node.mesh_lod > 1) {
-                    higher_lod_node_indices[i] = node_child_index;
-                }
-            } else {
-                self.quads_to_render.append(node_child_index) catch unreachable;
-            }
-        }
-
-        for (higher_lod_node_indices) |higher_lod_node_index| {
-            if (higher_lod_node_index != invalid_index) {
-                const child_node = &self.terrain_quad_tree_nodes.items[higher_lod_node_index];
-                collectQuadsToRenderForSector(self, position, range, child_node, higher_lod_node_index, allocator) catch unreachable;
-            } else {
-                // self.quads_to_render.append(node.child_indices[i]) catch unreachable;
-            }
-        }
-    } else if (node.containedInsideChildren(position, range, &self.terrain_quad_tree_nodes) and !node.areChildrenLoaded(&self.terrain_quad_tree_nodes)) {
-        self.quads_to_render.append(node_index) catch unreachable;
-        self.quads_to_load.appendSlice(node.child_indices[0..4]) catch unreachable;
-    } else {
-        if (node.isLoaded()) {
-            self.quads_to_render.append(node_index) catch unreachable;
-        } else {
-            self.quads_to_load.append(node_index) catch unreachable;
-        }
-    }
+// Shortens list to what's left of the instance budget, returns how many instances it dropped.
+fn clampToBudget(list: *std.ArrayList(TerrainInstanceData), budget: *usize) usize {
+    const kept = @min(list.items.len, budget.*);
+    const dropped = list.items.len - kept;
+    list.shrinkRetainingCapacity(kept);
+    budget.* -= kept;
+    return dropped;
 }
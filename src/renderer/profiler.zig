@@ -1,9 +1,8 @@
 const std = @import("std");
 
 const graphics = @import("zforge").graphics;
-const IdLocal = @import("../core/core.zig").IdLocal;
+const IdHandle = @import("../core/core.zig").IdHandle;
 const Renderer = @import("renderer.zig").Renderer;
-const util = @import("../util.zig");
 
 // Ported from: https://github.com/TheRealMJP/DXRPathTracer/blob/master/SampleFramework12/v1.02/Graphics/Profiler.h
 
@@ -44,11 +43,11 @@ pub const Profiler = struct {
     }
 
     pub fn startProfile(self: *Profiler, cmd_list: [*c]graphics.Cmd, name: []const u8) usize {
-        const id = IdLocal.init(name);
+        const id = IdHandle.init(name);
 
         var profile_index: usize = invalid_profile_index;
         for (self.profiles.items, 0..) |profile, index| {
-            if (profile.id.hash == id.hash) {
+            if (profile.id == id) {
                 profile_index = index;
                 break;
             }
@@ -60,7 +59,6 @@ pub const Profiler = struct {
 
             var profile = std.mem.zeroes(ProfileData);
             profile.id = id;
-            util.memcpy(&profile.name, @ptrCast(&name.ptr), name.len, .{});
             @memset(profile.time_samples[0..], 0);
             self.profiles.append(profile) catch unreachable;
         }
@@ -104,11 +102,11 @@ pub const Profiler = struct {
     }
 
     pub fn startCpuProfile(self: *Profiler, name: []const u8) usize {
-        const id = IdLocal.init(name);
+        const id = IdHandle.init(name);
 
         var profile_index: usize = invalid_profile_index;
         for (self.cpu_profiles.items, 0..) |profile, index| {
-            if (profile.id.hash == id.hash) {
+            if (profile.id == id) {
                 profile_index = index;
                 break;
             }
@@ -120,7 +118,6 @@ pub const Profiler = struct {
 
             var profile = std.mem.zeroes(ProfileData);
             profile.id = id;
-            util.memcpy(&profile.name, @ptrCast(&name.ptr), name.len, .{});
             @memset(profile.time_samples[0..], 0);
             self.cpu_profiles.append(profile) catch unreachable;
         }
@@ -187,8 +184,7 @@ pub const Profiler = struct {
 pub const ProfileData = struct {
     pub const filter_size: usize = 64;
 
-    name: [256]u8,
-    id: IdLocal,
+    id: IdHandle, // id.toString() for the name
     query_started: bool,
     query_finished: bool,
     active: bool,
@@ -1,6 +1,7 @@
 const std = @import("std");
 
 const IdLocal = @import("../core/core.zig").IdLocal;
+const IdLocalHashMap = @import("../core/core.zig").IdLocalHashMap;
 const Renderer = @import("renderer.zig").Renderer;
 const zforge = @import("zforge");
 
@@ -21,8 +22,8 @@ pub const cutout_pipelines = [_]IdLocal{
 
 const PSOPool = Pool(16, 16, graphics.Shader, struct { shader: [*c]graphics.Shader, root_signature: [*c]graphics.RootSignature, pipeline: [*c]graphics.Pipeline });
 const PSOHandle = PSOPool.Handle;
-const PSOMap = std.AutoHashMap(IdLocal, PSOHandle);
-const BlendStates = std.AutoHashMap(IdLocal, graphics.BlendStateDesc);
+const PSOMap = IdLocalHashMap(PSOHandle);
+const BlendStates = IdLocalHashMap(graphics.BlendStateDesc);
 
 const GraphicsPipelineDesc = struct {
     id: IdLocal = undefined,
@@ -956,7 +957,7 @@ const StaticSamplers = struct {
         name: []const u8,
     };
 
-    const SamplersMap = std.AutoHashMap(IdLocal, StaticSampler);
+    const SamplersMap = IdLocalHashMap(StaticSampler);
 
     pub const linear_repeat = IdLocal.init("linear_repeat");
     pub const linear_clamp_edge = IdLocal.init("linear_clamp_edge");
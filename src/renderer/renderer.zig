@@ -8,10 +8,14 @@ const font = zforge.font;
 const geometry = @import("geometry.zig");
 const graphics = zforge.graphics;
 const IdLocal = @import("../core/core.zig").IdLocal;
+const IdLocalHashMap = @import("../core/core.zig").IdLocalHashMap;
 const input = @import("../input.zig");
+const JobSystem = @import("../core/job_system.zig").JobSystem;
+const LightSphere = @import("light_clustering.zig").LightSphere;
 const memory = zforge.memory;
 const OpaqueSlice = util.OpaqueSlice;
 const Pool = @import("zpool").Pool;
+const RangeAllocator = @import("../core/range_allocator.zig").RangeAllocator;
 const profiler = @import("profiler.zig");
 const pso = @import("pso.zig");
 const renderer_types = @import("types.zig");
@@ -42,7 +46,7 @@ pub const opaque_pipelines = pso.opaque_pipelines;
 pub const cutout_pipelines = pso.cutout_pipelines;
 const hdr_format = graphics.TinyImageFormat.R16G16B16A16_SFLOAT; // B10G11R11_UFLOAT
 
-const VertexLayoutHashMap = std.AutoHashMap(IdLocal, graphics.VertexLayout);
+const VertexLayoutHashMap = IdLocalHashMap(graphics.VertexLayout);
 
 const BuffersVisualizationPushConstants = struct {
     buffer_visualization_mode: u32,
@@ -62,11 +66,13 @@ const visualization_modes = [_][:0]const u8{
 pub const Renderer = struct {
     pub const data_buffer_count: u32 = 2;
     pub const cascades_max_count: u32 = 4;
+    pub const first_point_light_index: u32 = 2; // After the sun and the moon
     pub const debug_line_point_count_max = 200000;
 
     allocator: std.mem.Allocator = undefined,
     ecsu_world: ecsu.World = undefined,
     world_patch_mgr: *world_patch_manager.WorldPatchManager = undefined,
+    jobs: *JobSystem = undefined,
     renderer: [*c]graphics.Renderer = null,
     window: *window.Window = undefined,
     window_width: i32 = 0,
@@ -112,12 +118,16 @@ pub const Renderer = struct {
     moon_light: renderer_types.DirectionalLight = undefined,
     height_fog_settings: renderer_types.HeightFogSettings = undefined,
     ocean_tiles: std.ArrayList(renderer_types.OceanTile) = undefined,
-    dynamic_entities: std.ArrayList(renderer_types.DynamicEntity) = undefined,
+    light_spheres: std.ArrayList(LightSphere) = undefined, // Bounds of the point lights, for clustering
+    added_dynamic_entities: std.ArrayList(renderer_types.DynamicEntity) = undefined,
+    moved_dynamic_instances: std.ArrayList(renderer_types.DynamicInstanceTransform) = undefined,
+    removed_dynamic_instances: std.ArrayList(u32) = undefined,
     added_static_entities: std.ArrayList(renderer_types.RenderableEntity) = undefined,
-    removed_static_entities: std.ArrayList(renderer_types.RenderableEntityId) = undefined,
+    removed_static_instances: std.ArrayList(RangeAllocator.Allocation) = undefined,
     ui_images: std.ArrayList(renderer_types.UiImage) = undefined,
     ui_texts: std.ArrayList(renderer_types.UiText) = undefined,
 
+
     // GPU Bindless Buffers
     // ====================
     // These buffers are accessible to all shaders
@@ -176,7 +186,7 @@ pub const Renderer = struct {
     // Lighting
     scene_color: [*c]graphics.RenderTarget = null,
     scene_color_copy: [*c]graphics.RenderTarget = null,
-    light_grid: [data_buffer_count]TextureHandle = .{ undefined, undefined },
+    light_grid: [data_buffer_count]TextureHandle = .{ undefined, undefined }, // For the GPU tiled light culling
 
     // Bloom Render Targets
     bloom_width: u32 = 0,
@@ -217,10 +227,11 @@ pub const Renderer = struct {
         FileSystemNotInitialized,
     };
 
-    pub fn init(self: *Renderer, wnd: *window.Window, ecsu_world: ecsu.World, world_patch_mgr: *world_patch_manager.WorldPatchManager, allocator: std.mem.Allocator) Error!void {
+    pub fn init(self: *Renderer, wnd: *window.Window, ecsu_world: ecsu.World, world_patch_mgr: *world_patch_manager.WorldPatchManager, jobs: *JobSystem, allocator: std.mem.Allocator) Error!void {
         self.allocator = allocator;
         self.ecsu_world = ecsu_world;
         self.world_patch_mgr = world_patch_mgr;
+        self.jobs = jobs;
         self.window = wnd;
         self.window_width = wnd.frame_buffer_size[0];
         self.window_height = wnd.frame_buffer_size[1];
@@ -496,9 +507,12 @@ pub const Renderer = struct {
 
         // Scene Data
         self.ocean_tiles = std.ArrayList(renderer_types.OceanTile).init(self.allocator);
-        self.dynamic_entities = std.ArrayList(renderer_types.DynamicEntity).init(self.allocator);
+        self.light_spheres = std.ArrayList(LightSphere).init(self.allocator);
+        self.added_dynamic_entities = std.ArrayList(renderer_types.DynamicEntity).init(self.allocator);
+        self.moved_dynamic_instances = std.ArrayList(renderer_types.DynamicInstanceTransform).init(self.allocator);
+        self.removed_dynamic_instances = std.ArrayList(u32).init(self.allocator);
         self.added_static_entities = std.ArrayList(renderer_types.RenderableEntity).init(self.allocator);
-        self.removed_static_entities = std.ArrayList(renderer_types.RenderableEntityId).init(self.allocator);
+        self.removed_static_instances = std.ArrayList(RangeAllocator.Allocation).init(self.allocator);
         self.ui_images = std.ArrayList(renderer_types.UiImage).init(self.allocator);
         self.ui_texts = std.ArrayList(renderer_types.UiText).init(self.allocator);
     }
@@ -506,9 +520,12 @@ pub const Renderer = struct {
     pub fn exit(self: *Renderer) void {
         // Scene Data
         self.ocean_tiles.deinit();
+        self.light_spheres.deinit();
         self.added_static_entities.deinit();
-        self.removed_static_entities.deinit();
-        self.dynamic_entities.deinit();
+        self.removed_static_instances.deinit();
+        self.added_dynamic_entities.deinit();
+        self.moved_dynamic_instances.deinit();
+        self.removed_dynamic_instances.deinit();
         self.ui_images.deinit();
         self.ui_texts.deinit();
 
@@ -782,7 +799,9 @@ pub const Renderer = struct {
             .shadow_intensity = update_desc.moon_light.shadow_intensity,
         }) catch unreachable;
 
+        self.light_spheres.clearRetainingCapacity();
         for (update_desc.point_lights.items) |point_light| {
+            self.light_spheres.append(.{ .center = point_light.position, .radius = point_light.radius }) catch unreachable;
             lights.append(.{
                 .light_type = 1,
                 .position = point_light.position,
@@ -804,14 +823,19 @@ pub const Renderer = struct {
         self.ocean_tiles.clearRetainingCapacity();
         self.ocean_tiles.appendSlice(update_desc.ocean_tiles.items) catch unreachable;
 
-        self.dynamic_entities.clearRetainingCapacity();
-        self.dynamic_entities.appendSlice(update_desc.dynamic_entities.items) catch unreachable;
+        self.added_dynamic_entities.clearRetainingCapacity();
+        self.moved_dynamic_instances.clearRetainingCapacity();
+        self.removed_dynamic_instances.clearRetainingCapacity();
+
+        self.added_dynamic_entities.appendSlice(update_desc.added_dynamic_entities.items) catch unreachable;
+        self.moved_dynamic_instances.appendSlice(update_desc.moved_dynamic_instances.items) catch unreachable;
+        self.removed_dynamic_instances.appendSlice(update_desc.removed_dynamic_instances.items) catch unreachable;
 
         self.added_static_entities.clearRetainingCapacity();
-        self.removed_static_entities.clearRetainingCapacity();
+        self.removed_static_instances.clearRetainingCapacity();
 
         self.added_static_entities.appendSlice(update_desc.added_static_entities.items) catch unreachable;
-        self.removed_static_entities.appendSlice(update_desc.removed_static_entities.items) catch unreachable;
+        self.removed_static_instances.appendSlice(update_desc.removed_static_instances.items) catch unreachable;
 
         self.ui_images.clearRetainingCapacity();
         self.ui_images.appendSlice(update_desc.ui_images.items) catch unreachable;
@@ -1345,6 +1369,8 @@ pub const Renderer = struct {
 
         self.terrain_pass.update(render_view);
         self.static_geometry_pass.update(cmd_list);
+        self.dynamic_geometry_pass.update(render_view);
+        self.deferred_shading_pass.update(render_view);
         self.ui_pass.update();
     }
 
@@ -1567,6 +1593,7 @@ pub const Renderer = struct {
             self.shadow_views[i].view_projection = proj_view;
             self.shadow_views[i].view_projection_inverse = zm.inverse(self.shadow_views[i].view_projection);
             self.shadow_views[i].viewport = [2]f32{ @floatFromInt(cascaded_shadow_resolution), @floatFromInt(cascaded_shadow_resolution) };
+            self.shadow_views[i].frustum.init(proj_view);
 
             self.shadow_cascade_depths[i] = near_plane + current_cascade_split * (far_plane - near_plane);
         }
@@ -1756,12 +1783,18 @@ pub const Renderer = struct {
 
     pub fn loadMesh(self: *Renderer, path: []const u8, mesh_id: IdLocal) !void {
         var meshes_data = std.ArrayList(geometry.MeshData).init(self.allocator);
-        defer meshes_data.deinit();
+        defer {
+            for (meshes_data.items) |*mesh_data| {
+                mesh_data.deinit();
+            }
+            meshes_data.deinit();
+        }
 
         var load_desc: geometry.MeshLoadDesc = undefined;
         load_desc.mesh_path = path;
         load_desc.allocator = self.allocator;
         load_desc.mesh_data = &meshes_data;
+        load_desc.workers = self.jobs.frame;
         geometry.loadMesh(&load_desc);
 
         const mesh_index: u32 = @intCast(self.meshes.items.len);
@@ -2764,15 +2797,7 @@ const Renderable = struct {
 
 const RenderableHashMap = std.AutoHashMap(u64, Renderable);
 
-const GpuRenderableItem = struct {
-    local_bounds_origin: [3]f32,
-    screen_percentage_min: f32,
-    local_bounds_extents: [3]f32,
-    screen_percentage_max: f32,
-    mesh_index: u32,
-    material_index: u32,
-    _pad: [2]u32,
-};
+const GpuRenderableItem = @import("static_geometry_culling.zig").GpuRenderableItem;
 
 const RenderableToRenderableItems = std.AutoHashMap(u64, struct { index: usize, count: u32 });
 
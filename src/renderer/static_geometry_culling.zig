@@ -0,0 +1,543 @@
+const std = @import("std");
+const expect = std.testing.expect;
+
+const geometry = @import("geometry.zig");
+
+// CPU version of the static geometry culling pipeline in passes/static_geometry_pass.zig:
+// instance culling with LoD selection (meshlet_cull_instances), meshlet culling
+// (meshlet_cull_meshlets) and binning the visible meshlets per PSO bin (meshlet_binning_*).
+// It reads the same instance, renderable item and meshlet bounds data the shaders do and ends
+// up with the same lists, so it can check the GPU path and measure culling throughput without
+// a GPU.
+//
+// The shaders append with atomics, so the order within their lists changes from frame to frame.
+// Here everything comes out in a fixed order: visible meshlets by instance, renderable item and
+// meshlet, and each bin in visible meshlet order.
+//
+// Work is split in chunks of instances that threads grab off a shared counter. Every chunk goes
+// through all three steps writing to its own lists, the main thread only adds up counts between
+// steps. Optionally boxes are also tested against a Hi-Z pyramid, which the GPU path doesn't do.
+//
+// NOTE: Worker threads allocate from the culler's allocator, it has to be thread safe.
+
+pub const instances_max_count = 1000000;
+pub const meshlets_max_count = 1 << 20;
+pub const bins_max_count = 16; // Size of the meshlet counts buffer the binning shaders use
+
+pub const GpuInstanceFlags = packed struct(u32) {
+    destroyed: u1,
+    draw_bounds: u1,
+    _padding: u30,
+};
+
+pub const GpuInstance = struct {
+    world: [16]f32,
+    bounds_origin: [3]f32,
+    renderable_item_id: u32,
+    bounds_extents: [3]f32,
+    renderable_item_count: u32,
+    flags: GpuInstanceFlags,
+    _pad: [3]u32,
+};
+
+pub const GpuMeshletCandidate = struct {
+    instance_id: u32,
+    mesh_index: u32,
+    material_index: u32,
+    meshlet_index: u32,
+};
+
+// The renderer uploads these into renderable_buffer.
+pub const GpuRenderableItem = struct {
+    local_bounds_origin: [3]f32,
+    screen_percentage_min: f32,
+    local_bounds_extents: [3]f32,
+    screen_percentage_max: f32,
+    mesh_index: u32,
+    material_index: u32,
+    _pad: [2]u32,
+};
+
+pub const CullingMesh = struct {
+    meshlet_bounds: []const geometry.MeshletBounds,
+};
+
+pub const CullingScene = struct {
+    instances: []const GpuInstance,
+    renderable_items: []const GpuRenderableItem,
+    meshes: []const CullingMesh, // Indexed by GpuRenderableItem.mesh_index
+    material_bins: []const u32, // The rasterizer bin of each material, indexed by material_index
+    bins_count: u32,
+};
+
+// One level of a reversed Z depth pyramid, each texel holds the farthest (smallest) depth of the
+// texels it covers in the level below.
+pub const HiZMip = struct {
+    width: u32,
+    height: u32,
+    depths: []const f32,
+};
+
+pub const CullingView = struct {
+    view_projection: [16]f32, // As stored by zm.storeMat, not transposed like the GPU copy
+    camera_position: [3]f32,
+    hi_z_mips: []const HiZMip = &.{}, // No occlusion culling when empty
+};
+
+pub const BinRange = struct {
+    offset: u32,
+    count: u32,
+};
+
+const Vec4 = @Vector(4, f32);
+const Mat = [4]Vec4; // Rows, transforms row vectors like zmath
+
+const ClipBounds = struct {
+    visible: bool,
+    rect_min: [3]f32,
+    rect_max: [3]f32,
+};
+
+pub const StaticGeometryCuller = struct {
+    const instances_per_chunk = 1024;
+
+    const Phase = enum {
+        cull_instances,
+        cull_meshlets,
+        write_bins,
+    };
+
+    const Chunk = struct {
+        candidates: std.ArrayListUnmanaged(GpuMeshletCandidate) = .{},
+        candidates_used: u32 = 0, // What's left after clamping to meshlets_max_count
+        visible: std.ArrayListUnmanaged(GpuMeshletCandidate) = .{},
+        visible_offset: u32 = 0,
+        bin_counts: [bins_max_count]u32 = [_]u32{0} ** bins_max_count,
+        bin_cursors: [bins_max_count]u32 = [_]u32{0} ** bins_max_count,
+        instances_visible: u32 = 0,
+        boxes_occluded: u32 = 0,
+    };
+
+    allocator: std.mem.Allocator,
+    workers: ?*std.Thread.Pool = null,
+    worker_count: u32 = 0,
+    next_chunk: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+    phase: Phase = .cull_instances,
+    chunks: std.ArrayListUnmanaged(Chunk) = .{},
+    scene: CullingScene = undefined,
+    view: CullingView = undefined,
+    view_projection: Mat = undefined,
+
+    // Results of the last cull.
+    visible_meshlets: std.ArrayListUnmanaged(GpuMeshletCandidate) = .{},
+    binned_meshlets: std.ArrayListUnmanaged(u32) = .{}, // Indices into visible_meshlets, grouped by bin
+    bins: [bins_max_count]BinRange = [_]BinRange{.{ .offset = 0, .count = 0 }} ** bins_max_count,
+    instances_visible: u32 = 0,
+    candidate_meshlets_total: u32 = 0, // Before clamping, like COUNTER_TOTAL_CANDIDATE_MESHLETS
+    candidate_meshlets_count: u32 = 0,
+    boxes_occluded: u32 = 0,
+
+    // Borrows workers, the job system's frame pool in the game. Without workers everything
+    // runs on the calling thread.
+    pub fn create(allocator: std.mem.Allocator, workers: ?*std.Thread.Pool) *StaticGeometryCuller {
+        const self = allocator.create(StaticGeometryCuller) catch unreachable;
+        self.* = .{ .allocator = allocator, .workers = workers };
+        if (workers) |pool| {
+            self.worker_count = @intCast(pool.threads.len);
+        }
+        return self;
+    }
+
+    pub fn destroy(self: *StaticGeometryCuller) void {
+        for (self.chunks.items) |*chunk| {
+            chunk.candidates.deinit(self.allocator);
+            chunk.visible.deinit(self.allocator);
+        }
+        self.chunks.deinit(self.allocator);
+        self.visible_meshlets.deinit(self.allocator);
+        self.binned_meshlets.deinit(self.allocator);
+        self.allocator.destroy(self);
+    }
+
+    // The meshlets of a bin, as indices into visible_meshlets.
+    pub fn binMeshlets(self: StaticGeometryCuller, bin: u32) []const u32 {
+        const range = self.bins[bin];
+        return self.binned_meshlets.items[range.offset .. range.offset + range.count];
+    }
+
+    pub fn cull(self: *StaticGeometryCuller, scene: CullingScene, view: CullingView) void {
+        std.debug.assert(scene.instances.len <= instances_max_count);
+        std.debug.assert(scene.bins_count <= bins_max_count);
+        self.scene = scene;
+        self.view = view;
+        for (&self.view_projection, 0..) |*row, i| {
+            row.* = view.view_projection[i * 4 ..][0..4].*;
+        }
+
+        const chunk_count = std.math.divCeil(usize, scene.instances.len, instances_per_chunk) catch unreachable;
+        while (self.chunks.items.len < chunk_count) {
+            self.chunks.append(self.allocator, .{}) catch unreachable;
+        }
+        const chunks = self.chunks.items[0..chunk_count];
+
+        self.runPhase(.cull_instances, chunk_count);
+
+        // Candidates past meshlets_max_count are dropped, like the GPU does.
+        self.instances_visible = 0;
+        self.candidate_meshlets_total = 0;
+        self.candidate_meshlets_count = 0;
+        for (chunks) |*chunk| {
+            const chunk_candidates: u32 = @intCast(chunk.candidates.items.len);
+            chunk.candidates_used = @min(chunk_candidates, meshlets_max_count - self.candidate_meshlets_count);
+            self.candidate_meshlets_total += chunk_candidates;
+            self.candidate_meshlets_count += chunk.candidates_used;
+            self.instances_visible += chunk.instances_visible;
+        }
+
+        self.runPhase(.cull_meshlets, chunk_count);
+
+        // Bins are laid out back to back. Within a bin every chunk gets the range after the
+        // chunks before it, which keeps the order fixed without any atomics.
+        var bin_totals = [_]u32{0} ** bins_max_count;
+        var visible_count: u32 = 0;
+        self.boxes_occluded = 0;
+        for (chunks) |*chunk| {
+            chunk.visible_offset = visible_count;
+            visible_count += @intCast(chunk.visible.items.len);
+            for (&bin_totals, chunk.bin_counts) |*total, count| {
+                total.* += count;
+            }
+            self.boxes_occluded += chunk.boxes_occluded;
+        }
+        var bin_offset: u32 = 0;
+        for (&self.bins, bin_totals) |*bin, total| {
+            bin.* = .{ .offset = bin_offset, .count = total };
+            bin_offset += total;
+        }
+        var bin_cursors: [bins_max_count]u32 = undefined;
+        for (&bin_cursors, self.bins) |*cursor, bin| {
+            cursor.* = bin.offset;
+        }
+        for (chunks) |*chunk| {
+            for (&chunk.bin_cursors, &bin_cursors, chunk.bin_counts) |*chunk_cursor, *cursor, count| {
+                chunk_cursor.* = cursor.*;
+                cursor.* += count;
+            }
+        }
+        self.visible_meshlets.resize(self.allocator, visible_count) catch unreachable;
+        self.binned_meshlets.resize(self.allocator, visible_count) catch unreachable;
+
+        self.runPhase(.write_bins, chunk_count);
+    }
+
+    fn runPhase(self: *StaticGeometryCuller, phase: Phase, chunk_count: usize) void {
+        self.phase = phase;
+        self.next_chunk.store(0, .monotonic);
+        if (self.workers != null and chunk_count > 1) {
+            // The calling thread works through chunks too, so one helper fewer is enough.
+            var wait_group: std.Thread.WaitGroup = .{};
+            for (0..@min(self.worker_count, chunk_count - 1)) |_| {
+                self.workers.?.spawnWg(&wait_group, workChunks, .{ self, chunk_count });
+            }
+            self.workChunks(chunk_count);
+            self.workers.?.waitAndWork(&wait_group);
+        } else {
+            self.workChunks(chunk_count);
+        }
+    }
+
+    fn workChunks(self: *StaticGeometryCuller, chunk_count: usize) void {
+        while (true) {
+            const chunk_index = self.next_chunk.fetchAdd(1, .monotonic);
+            if (chunk_index >= chunk_count) {
+                return;
+            }
+            const chunk = &self.chunks.items[chunk_index];
+            switch (self.phase) {
+                .cull_instances => self.cullInstances(chunk, chunk_index * instances_per_chunk),
+                .cull_meshlets => self.cullMeshlets(chunk),
+                .write_bins => self.writeBins(chunk),
+            }
+        }
+    }
+
+    fn cullInstances(self: *StaticGeometryCuller, chunk: *Chunk, first_instance: usize) void {
+        chunk.candidates.clearRetainingCapacity();
+        chunk.instances_visible = 0;
+        chunk.boxes_occluded = 0;
+
+        const last_instance = @min(first_instance + instances_per_chunk, self.scene.instances.len);
+        for (self.scene.instances[first_instance..last_instance], first_instance..) |*instance, instance_index| {
+            if (instance.flags.destroyed == 1) {
+                continue;
+            }
+
+            const world = loadWorld(instance.world);
+            const world_view_projection = mulMat(world, self.view_projection);
+            const bounds = frustumCull(instance.bounds_origin, instance.bounds_extents, world_view_projection);
+            if (!bounds.visible) {
+                continue;
+            }
+            if (isOccluded(self.view.hi_z_mips, bounds)) {
+                chunk.boxes_occluded += 1;
+                continue;
+            }
+            chunk.instances_visible += 1;
+
+            const renderable_items = self.scene.renderable_items[instance.renderable_item_id..][0..instance.renderable_item_count];
+            for (renderable_items) |*renderable_item| {
+                // Distance based LoD selection, the screen percentages hold distances for now.
+                const center = transformPoint(renderable_item.local_bounds_origin, world);
+                const camera_position = self.view.camera_position;
+                const to_camera = center - Vec4{ camera_position[0], camera_position[1], camera_position[2], center[3] };
+                const distance = @max(0.01, @sqrt(@reduce(.Add, to_camera * to_camera)));
+                if (distance < renderable_item.screen_percentage_min or distance > renderable_item.screen_percentage_max) {
+                    continue;
+                }
+                if (!frustumCull(renderable_item.local_bounds_origin, renderable_item.local_bounds_extents, world_view_projection).visible) {
+                    continue;
+                }
+
+                const meshlet_count = self.scene.meshes[renderable_item.mesh_index].meshlet_bounds.len;
+                const candidates = chunk.candidates.addManyAsSlice(self.allocator, meshlet_count) catch unreachable;
+                for (candidates, 0..) |*candidate, meshlet_index| {
+                    candidate.* = .{
+                        .instance_id = @intCast(instance_index),
+                        .mesh_index = renderable_item.mesh_index,
+                        .material_index = renderable_item.material_index,
+                        .meshlet_index = @intCast(meshlet_index),
+                    };
+                }
+            }
+        }
+    }
+
+    fn cullMeshlets(self: *StaticGeometryCuller, chunk: *Chunk) void {
+        chunk.visible.clearRetainingCapacity();
+        chunk.bin_counts = [_]u32{0} ** bins_max_count;
+
+        // Candidates come grouped by instance, only redo the matrix when it changes.
+        var instance_id: u32 = std.math.maxInt(u32);
+        var world_view_projection: Mat = undefined;
+        for (chunk.candidates.items[0..chunk.candidates_used]) |candidate| {
+            if (candidate.instance_id != instance_id) {
+                instance_id = candidate.instance_id;
+                world_view_projection = mulMat(loadWorld(self.scene.instances[instance_id].world), self.view_projection);
+            }
+
+            const meshlet_bounds = self.scene.meshes[candidate.mesh_index].meshlet_bounds[candidate.meshlet_index];
+            const bounds = frustumCull(meshlet_bounds.local_center, meshlet_bounds.local_extents, world_view_projection);
+            if (!bounds.visible) {
+                continue;
+            }
+            if (isOccluded(self.view.hi_z_mips, bounds)) {
+                chunk.boxes_occluded += 1;
+                continue;
+            }
+
+            chunk.visible.append(self.allocator, candidate) catch unreachable;
+            const bin = self.scene.material_bins[candidate.material_index];
+            std.debug.assert(bin < self.scene.bins_count);
+            chunk.bin_counts[bin] += 1;
+        }
+    }
+
+    fn writeBins(self: *StaticGeometryCuller, chunk: *Chunk) void {
+        @memcpy(self.visible_meshlets.items[chunk.visible_offset..][0..chunk.visible.items.len], chunk.visible.items);
+        for (chunk.visible.items, chunk.visible_offset..) |candidate, visible_index| {
+            const cursor = &chunk.bin_cursors[self.scene.material_bins[candidate.material_index]];
+            self.binned_meshlets.items[cursor.*] = @intCast(visible_index);
+            cursor.* += 1;
+        }
+    }
+};
+
+// The GPU copy of the world matrix is transposed.
+fn loadWorld(world: [16]f32) Mat {
+    var result: Mat = undefined;
+    for (&result, 0..) |*row, i| {
+        row.* = .{ world[i], world[4 + i], world[8 + i], world[12 + i] };
+    }
+    return result;
+}
+
+fn mulMat(a: Mat, b: Mat) Mat {
+    var result: Mat = undefined;
+    for (&result, a) |*row, a_row| {
+        row.* = @as(Vec4, @splat(a_row[0])) * b[0] +
+            @as(Vec4, @splat(a_row[1])) * b[1] +
+            @as(Vec4, @splat(a_row[2])) * b[2] +
+            @as(Vec4, @splat(a_row[3])) * b[3];
+    }
+    return result;
+}
+
+fn transformPoint(point: [3]f32, m: Mat) Vec4 {
+    return @as(Vec4, @splat(point[0])) * m[0] +
+        @as(Vec4, @splat(point[1])) * m[1] +
+        @as(Vec4, @splat(point[2])) * m[2] +
+        m[3];
+}
+
+const Corners = @Vector(8, f32);
+const corner_x: Corners = .{ 0, 1, 0, 1, 0, 1, 0, 1 };
+const corner_y: Corners = .{ 0, 0, 1, 1, 0, 0, 1, 1 };
+const corner_z: Corners = .{ 0, 0, 0, 0, 1, 1, 1, 1 };
+
+// FrustumCull from math.hlsli, with the eight corners of the box in the lanes of a vector.
+fn frustumCull(center: [3]f32, extents: [3]f32, m: Mat) ClipBounds {
+    const local_x = @as(Corners, @splat(center[0] - extents[0])) + corner_x * @as(Corners, @splat(extents[0] * 2));
+    const local_y = @as(Corners, @splat(center[1] - extents[1])) + corner_y * @as(Corners, @splat(extents[1] * 2));
+    const local_z = @as(Corners, @splat(center[2] - extents[2])) + corner_z * @as(Corners, @splat(extents[2] * 2));
+
+    var clip: [4]Corners = undefined;
+    for (&clip, 0..) |*component, i| {
+        component.* = local_x * @as(Corners, @splat(m[0][i])) +
+            local_y * @as(Corners, @splat(m[1][i])) +
+            local_z * @as(Corners, @splat(m[2][i])) +
+            @as(Corners, @splat(m[3][i]));
+    }
+    const min_w = @reduce(.Min, clip[3]);
+    const max_w = @reduce(.Max, clip[3]);
+
+    // Plane inequalities, all corners outside the same side plane.
+    const outside = @reduce(.Min, clip[0] - clip[3]) > 0 or
+        @reduce(.Min, -clip[0] - clip[3]) > 0 or
+        @reduce(.Min, clip[1] - clip[3]) > 0 or
+        @reduce(.Min, -clip[1] - clip[3]) > 0;
+
+    var result: ClipBounds = undefined;
+    for (0..3) |i| {
+        const ndc = clip[i] / clip[3];
+        result.rect_min[i] = @min(@reduce(.Min, ndc), 1);
+        result.rect_max[i] = @max(@reduce(.Max, ndc), -1);
+    }
+    result.visible = result.rect_max[2] > 0;
+
+    if (min_w <= 0 and max_w > 0) {
+        result.rect_min = .{ -1, -1, -1 };
+        result.rect_max = .{ 1, 1, 1 };
+        result.visible = true;
+    } else {
+        result.visible = result.visible and max_w > 0;
+    }
+    result.visible = result.visible and !outside;
+    return result;
+}
+
+// Reversed Z, so the box is hidden when its nearest depth is smaller than the farthest depth of
+// everything drawn over its screen rect. Reads the level where the rect covers about 2x2 texels.
+fn isOccluded(mips: []const HiZMip, bounds: ClipBounds) bool {
+    if (mips.len == 0) {
+        return false;
+    }
+
+    // NDC y points up, texture rows go down.
+    const uv_min = [2]f32{ bounds.rect_min[0] * 0.5 + 0.5, 0.5 - bounds.rect_max[1] * 0.5 };
+    const uv_max = [2]f32{ bounds.rect_max[0] * 0.5 + 0.5, 0.5 - bounds.rect_min[1] * 0.5 };
+    const texels_x = (uv_max[0] - uv_min[0]) * @as(f32, @floatFromInt(mips[0].width));
+    const texels_y = (uv_max[1] - uv_min[1]) * @as(f32, @floatFromInt(mips[0].height));
+    const level: usize = @min(@as(usize, @intFromFloat(@ceil(@log2(@max(texels_x, texels_y, 1))))), mips.len - 1);
+    const mip = mips[level];
+
+    const x_min = texelCoord(uv_min[0], mip.width);
+    const x_max = texelCoord(uv_max[0], mip.width);
+    const y_min = texelCoord(uv_min[1], mip.height);
+    const y_max = texelCoord(uv_max[1], mip.height);
+    var farthest: f32 = 1;
+    for (y_min..y_max + 1) |y| {
+        for (mip.depths[y * mip.width + x_min .. y * mip.width + x_max + 1]) |depth| {
+            farthest = @min(farthest, depth);
+        }
+    }
+    return bounds.rect_max[2] < farthest;
+}
+
+fn texelCoord(uv: f32, size: u32) usize {
+    const size_f: f32 = @floatFromInt(size);
+    return @intFromFloat(std.math.clamp(uv * size_f, 0, size_f - 1));
+}
+
+fn testTranslation(x: f32, y: f32, z: f32) [16]f32 {
+    // Transposed, the way the pass uploads it.
+    return .{ 1, 0, 0, x, 0, 1, 0, y, 0, 0, 1, z, 0, 0, 0, 1 };
+}
+
+fn testInstance(x: f32, y: f32, z: f32, renderable_item_id: u32, renderable_item_count: u32) GpuInstance {
+    var instance = std.mem.zeroes(GpuInstance);
+    instance.world = testTranslation(x, y, z);
+    instance.bounds_extents = .{ 1, 1, 1 };
+    instance.renderable_item_id = renderable_item_id;
+    instance.renderable_item_count = renderable_item_count;
+    return instance;
+}
+
+test "static_geometry_culling" {
+    // Camera at the origin looking down +z, reversed Z like zm.perspectiveFovLh(fov, aspect, far, near).
+    const near = 0.1;
+    const far = 1000.0;
+    const h = 1.0 / @tan(@as(f32, 0.5));
+    const r = near / (near - far);
+    const view = CullingView{
+        .view_projection = .{ h, 0, 0, 0, 0, h, 0, 0, 0, 0, r, 1, 0, 0, -r * far, 0 },
+        .camera_position = .{ 0, 0, 0 },
+    };
+
+    const meshlet_bounds = [_]geometry.MeshletBounds{
+        .{ .local_center = .{ 0, 0, 0 }, .local_extents = .{ 0.5, 0.5, 0.5 } },
+        .{ .local_center = .{ 0.5, 0, 0 }, .local_extents = .{ 0.5, 0.5, 0.5 } },
+        .{ .local_center = .{ 500, 0, 0 }, .local_extents = .{ 0.5, 0.5, 0.5 } },
+    };
+    const meshes = [_]CullingMesh{
+        .{ .meshlet_bounds = &meshlet_bounds },
+        .{ .meshlet_bounds = meshlet_bounds[0..1] },
+    };
+    const renderable_items = [_]GpuRenderableItem{
+        .{ .local_bounds_origin = .{ 0, 0, 0 }, .screen_percentage_min = 0, .local_bounds_extents = .{ 1, 1, 1 }, .screen_percentage_max = 50, .mesh_index = 0, .material_index = 0, ._pad = .{ 0, 0 } },
+        .{ .local_bounds_origin = .{ 0, 0, 0 }, .screen_percentage_min = 50, .local_bounds_extents = .{ 1, 1, 1 }, .screen_percentage_max = 1000, .mesh_index = 1, .material_index = 0, ._pad = .{ 0, 0 } },
+        .{ .local_bounds_origin = .{ 0, 0, 0 }, .screen_percentage_min = 0, .local_bounds_extents = .{ 1, 1, 1 }, .screen_percentage_max = 1000, .mesh_index = 0, .material_index = 1, ._pad = .{ 0, 0 } },
+    };
+    var instances = [_]GpuInstance{
+        testInstance(0, 0, 10, 0, 2), // LoD 0, two of its three meshlets are in view
+        testInstance(0, 0, -10, 2, 1), // Behind the camera
+        testInstance(1000, 0, 10, 2, 1), // Off to the side
+        testInstance(2, 0, 20, 2, 1), // Other bin
+        testInstance(0, 0, 30, 2, 1), // Destroyed
+    };
+    instances[4].flags.destroyed = 1;
+    const scene = CullingScene{
+        .instances = &instances,
+        .renderable_items = &renderable_items,
+        .meshes = &meshes,
+        .material_bins = &.{ 0, 1 },
+        .bins_count = 2,
+    };
+
+    var pool: std.Thread.Pool = undefined;
+    try pool.init(.{ .allocator = std.testing.allocator, .n_jobs = 2 });
+    defer pool.deinit();
+    for ([_]?*std.Thread.Pool{ null, &pool }) |workers| {
+        const culler = StaticGeometryCuller.create(std.testing.allocator, workers);
+        defer culler.destroy();
+        culler.cull(scene, view);
+
+        try expect(culler.instances_visible == 2);
+        try expect(culler.candidate_meshlets_count == 6);
+        try expect(culler.visible_meshlets.items.len == 4);
+        try expect(culler.visible_meshlets.items[0].instance_id == 0);
+        try expect(culler.visible_meshlets.items[1].meshlet_index == 1);
+        try expect(culler.visible_meshlets.items[2].instance_id == 3);
+        try expect(std.mem.eql(u32, culler.binMeshlets(0), &.{ 0, 1 }));
+        try expect(std.mem.eql(u32, culler.binMeshlets(1), &.{ 2, 3 }));
+
+        // Something right in front of the camera covers the whole screen.
+        const depths = [_]f32{0.5} ** 16;
+        const hi_z_mips = [_]HiZMip{.{ .width = 4, .height = 4, .depths = &depths }};
+        var occluded_view = view;
+        occluded_view.hi_z_mips = &hi_z_mips;
+        culler.cull(scene, occluded_view);
+        try expect(culler.instances_visible == 0);
+        try expect(culler.boxes_occluded == 2);
+        try expect(culler.visible_meshlets.items.len == 0);
+    }
+}
@@ -0,0 +1,603 @@
+const std = @import("std");
+const expect = std.testing.expect;
+
+// The terrain quad tree and picking which of its nodes to draw each frame.
+//
+// The world is covered by LOD3 sectors, each the root of a tree down to LOD0. Nodes near the
+// camera are replaced by their children once those are loaded, everything else is drawn as is.
+// On top of that selection, nodes are culled against the side planes of the view frustum and
+// against a horizon built from the lowest heights of the LOD3 and LOD2 nodes: a node is hidden
+// when, in every direction it covers, terrain closer to the camera rises above the highest
+// line of sight to it. Both use the node's height range from its heightmap, nodes without one
+// are never culled.
+//
+// Sectors are independent, so they're split among threads in chunks. Every sector writes to its
+// own fixed size lists and the results are put together in sector order, the same on any number
+// of threads.
+
+pub const invalid_index = std.math.maxInt(u32);
+pub const nodes_per_sector = 1 + 4 + 16 + 64; // A LOD3 sector and all its children down to LOD0
+
+pub const QuadTreeNode = struct {
+    center: [2]f32,
+    size: [2]f32,
+    child_indices: [4]u32,
+    mesh_lod: u32,
+    patch_index: [2]u32,
+    // Height range of the node's heightmap, valid once loaded.
+    height_min: f32 = 0,
+    height_max: f32 = 0,
+    loaded: bool = false,
+
+    pub inline fn containsPoint(self: *const QuadTreeNode, point: [2]f32) bool {
+        return (point[0] > (self.center[0] - self.size[0]) and
+            point[0] < (self.center[0] + self.size[0]) and
+            point[1] > (self.center[1] - self.size[1]) and
+            point[1] < (self.center[1] + self.size[1]));
+    }
+
+    pub inline fn nearPoint(self: *const QuadTreeNode, point: [2]f32, range: f32) bool {
+        const half_size = self.size[0] / 2;
+        const circle_distance_x = @abs(point[0] - self.center[0]);
+        const circle_distance_y = @abs(point[1] - self.center[1]);
+
+        if (circle_distance_x > (half_size + range)) {
+            return false;
+        }
+        if (circle_distance_y > (half_size + range)) {
+            return false;
+        }
+
+        if (circle_distance_x <= (half_size)) {
+            return true;
+        }
+        if (circle_distance_y <= (half_size)) {
+            return true;
+        }
+
+        const corner_distance_sq = (circle_distance_x - half_size) * (circle_distance_x - half_size) +
+            (circle_distance_y - half_size) * (circle_distance_y - half_size);
+
+        return (corner_distance_sq <= (range * range));
+    }
+
+    pub inline fn isLoaded(self: *const QuadTreeNode) bool {
+        return self.loaded;
+    }
+
+    pub fn containedInsideChildren(self: *const QuadTreeNode, point: [2]f32, range: f32, nodes: []const QuadTreeNode) bool {
+        if (!self.nearPoint(point, range)) {
+            return false;
+        }
+
+        for (self.child_indices) |child_index| {
+            if (child_index == invalid_index) {
+                return false;
+            }
+
+            if (nodes[child_index].nearPoint(point, range)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    pub fn areChildrenLoaded(self: *const QuadTreeNode, nodes: []const QuadTreeNode) bool {
+        if (!self.isLoaded()) {
+            return false;
+        }
+
+        for (self.child_indices) |child_index| {
+            if (child_index == invalid_index) {
+                return false;
+            }
+
+            if (!nodes[child_index].isLoaded()) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+
+pub fn divideQuadTreeNode(
+    nodes: *std.ArrayList(QuadTreeNode),
+    node: *QuadTreeNode,
+) void {
+    if (node.mesh_lod == 0) {
+        return;
+    }
+
+    var child_index: u32 = 0;
+    while (child_index < 4) : (child_index += 1) {
+        const center_x = if (child_index % 2 == 0) node.center[0] - node.size[0] * 0.5 else node.center[0] + node.size[0] * 0.5;
+        const center_y = if (child_index < 2) node.center[1] + node.size[1] * 0.5 else node.center[1] - node.size[1] * 0.5;
+        const patch_index_x: u32 = if (child_index % 2 == 0) 0 else 1;
+        const patch_index_y: u32 = if (child_index < 2) 1 else 0;
+
+        const child_node = QuadTreeNode{
+            .center = [2]f32{ center_x, center_y },
+            .size = [2]f32{ node.size[0] * 0.5, node.size[1] * 0.5 },
+            .child_indices = [4]u32{ invalid_index, invalid_index, invalid_index, invalid_index },
+            .mesh_lod = node.mesh_lod - 1,
+            .patch_index = [2]u32{ node.patch_index[0] * 2 + patch_index_x, node.patch_index[1] * 2 + patch_index_y },
+        };
+
+        node.child_indices[child_index] = @as(u32, @intCast(nodes.items.len));
+        nodes.appendAssumeCapacity(child_node);
+
+        std.debug.assert(node.child_indices[child_index] < nodes.items.len);
+        divideQuadTreeNode(nodes, &nodes.items[node.child_indices[child_index]]);
+    }
+}
+
+pub const CullingView = struct {
+    // Left, right, top and bottom, normalized, like renderer_types.Frustum.
+    frustum_planes: [4][4]f32,
+    camera_position: [3]f32,
+    frustum_culling: bool = true,
+    horizon_culling: bool = true,
+};
+
+// Side planes of a row-major view projection matrix that transforms row vectors, like
+// zm.storeMat of the renderer's view_projection.
+pub fn frustumPlanes(view_projection: [16]f32) [4][4]f32 {
+    const m = view_projection;
+    var planes: [4][4]f32 = undefined;
+    for (0..4) |i| {
+        planes[0][i] = m[i * 4 + 3] + m[i * 4 + 0];
+        planes[1][i] = m[i * 4 + 3] - m[i * 4 + 0];
+        planes[2][i] = m[i * 4 + 3] - m[i * 4 + 1];
+        planes[3][i] = m[i * 4 + 3] + m[i * 4 + 1];
+    }
+    for (&planes) |*plane| {
+        const length = @sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        for (plane) |*value| {
+            value.* /= length;
+        }
+    }
+    return planes;
+}
+
+pub const TerrainQuadSelector = struct {
+    const sectors_per_chunk = 16;
+    const horizon_bins_count = 1024;
+    const bin_angle = std.math.tau / @as(f32, horizon_bins_count);
+    // Heightmaps of low LODs skip the samples in between, the terrain drawn there can dip a bit
+    // below their minimum.
+    const occluder_height_margin = 2.0;
+
+    const SectorQuads = struct {
+        render: std.BoundedArray(u32, nodes_per_sector) = .{},
+        visible: std.BoundedArray(u32, nodes_per_sector) = .{},
+        load: std.BoundedArray(u32, nodes_per_sector) = .{},
+        frustum_culled: u32 = 0,
+        horizon_culled: u32 = 0,
+    };
+
+    // Terrain at least this high covers all of bin up to distance. Within a bin they're sorted
+    // by distance and slope holds the highest slope up to there.
+    const Occluder = struct {
+        bin: u32,
+        distance: f32,
+        slope: f32,
+    };
+
+    // What a node covers seen from above the camera: a range of directions, continuous across
+    // -pi, and how near and far it is. Lines of sight enter it through the edges facing the
+    // camera, never further away than distance_entry_max.
+    const Footprint = struct {
+        angle_min: f32,
+        angle_max: f32,
+        distance_min: f32,
+        distance_max: f32,
+        distance_entry_max: f32,
+    };
+
+    allocator: std.mem.Allocator,
+    workers: ?*std.Thread.Pool = null,
+    worker_count: u32 = 0,
+    next_chunk: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+    sectors: []SectorQuads = &.{},
+    nodes: []const QuadTreeNode = &.{},
+    view: CullingView = undefined,
+    range: f32 = 0,
+    occluders: std.ArrayListUnmanaged(Occluder) = .{},
+    bin_starts: [horizon_bins_count + 1]u32 = [_]u32{0} ** (horizon_bins_count + 1),
+
+    // Results of the last select, in sector order.
+    quads_to_render: std.ArrayListUnmanaged(u32) = .{}, // Everything the LoD selection picked
+    quads_visible: std.ArrayListUnmanaged(u32) = .{}, // What's left of those after culling
+    quads_to_load: std.ArrayListUnmanaged(u32) = .{},
+    frustum_culled_count: u32 = 0,
+    horizon_culled_count: u32 = 0,
+
+    // Borrows workers, the job system's frame pool in the game. Without workers everything
+    // runs on the calling thread.
+    pub fn create(allocator: std.mem.Allocator, workers: ?*std.Thread.Pool) *TerrainQuadSelector {
+        const self = allocator.create(TerrainQuadSelector) catch unreachable;
+        self.* = .{ .allocator = allocator, .workers = workers };
+        if (workers) |pool| {
+            self.worker_count = @intCast(pool.threads.len);
+        }
+        return self;
+    }
+
+    pub fn destroy(self: *TerrainQuadSelector) void {
+        self.allocator.free(self.sectors);
+        self.occluders.deinit(self.allocator);
+        self.quads_to_render.deinit(self.allocator);
+        self.quads_visible.deinit(self.allocator);
+        self.quads_to_load.deinit(self.allocator);
+        self.allocator.destroy(self);
+    }
+
+    // nodes starts with the sectors_count LOD3 sectors.
+    pub fn select(self: *TerrainQuadSelector, nodes: []const QuadTreeNode, sectors_count: u32, view: CullingView, range: f32) void {
+        self.nodes = nodes;
+        self.view = view;
+        self.range = range;
+        if (self.sectors.len < sectors_count) {
+            self.allocator.free(self.sectors);
+            self.sectors = self.allocator.alloc(SectorQuads, sectors_count) catch unreachable;
+        }
+
+        if (view.horizon_culling) {
+            self.buildHorizon(sectors_count);
+        }
+
+        const chunk_count = std.math.divCeil(usize, sectors_count, sectors_per_chunk) catch unreachable;
+        self.next_chunk.store(0, .monotonic);
+        if (self.workers != null and chunk_count > 1) {
+            // The calling thread works through chunks too, so one helper fewer is enough.
+            var wait_group: std.Thread.WaitGroup = .{};
+            for (0..@min(self.worker_count, chunk_count - 1)) |_| {
+                self.workers.?.spawnWg(&wait_group, workChunks, .{ self, sectors_count });
+            }
+            self.workChunks(sectors_count);
+            self.workers.?.waitAndWork(&wait_group);
+        } else {
+            self.workChunks(sectors_count);
+        }
+
+        self.quads_to_render.clearRetainingCapacity();
+        self.quads_visible.clearRetainingCapacity();
+        self.quads_to_load.clearRetainingCapacity();
+        self.frustum_culled_count = 0;
+        self.horizon_culled_count = 0;
+        for (self.sectors[0..sectors_count]) |*sector| {
+            self.quads_to_render.appendSlice(self.allocator, sector.render.constSlice()) catch unreachable;
+            self.quads_visible.appendSlice(self.allocator, sector.visible.constSlice()) catch unreachable;
+            self.quads_to_load.appendSlice(self.allocator, sector.load.constSlice()) catch unreachable;
+            self.frustum_culled_count += sector.frustum_culled;
+            self.horizon_culled_count += sector.horizon_culled;
+        }
+    }
+
+    fn workChunks(self: *TerrainQuadSelector, sectors_count: u32) void {
+        while (true) {
+            const chunk_index = self.next_chunk.fetchAdd(1, .monotonic);
+            const first_sector = chunk_index * sectors_per_chunk;
+            if (first_sector >= sectors_count) {
+                return;
+            }
+            const last_sector = @min(first_sector + sectors_per_chunk, sectors_count);
+            for (first_sector..last_sector) |sector_index| {
+                const sector = &self.sectors[sector_index];
+                sector.* = .{};
+                self.collectQuads(sector, @intCast(sector_index));
+            }
+        }
+    }
+
+    // Walks a sector and picks the nodes to render, the highest detail around the camera whose
+    // children are loaded. Nodes that are needed but missing go into the load list.
+    fn collectQuads(self: *TerrainQuadSelector, sector: *SectorQuads, node_index: u32) void {
+        std.debug.assert(node_index != invalid_index);
+        const nodes = self.nodes;
+        const node = &nodes[node_index];
+        const position = [2]f32{ self.view.camera_position[0], self.view.camera_position[2] };
+        const range = self.range;
+
+        if (node.mesh_lod == 0) {
+            return;
+        }
+
+        if (node.containedInsideChildren(position, range, nodes) and node.areChildrenLoaded(nodes)) {
+            for (node.child_indices) |node_child_index| {
+                const child_node = &nodes[node_child_index];
+                if (child_node.nearPoint(position, range)) {
+                    if (child_node.mesh_lod == 1 and child_node.areChildrenLoaded(nodes)) {
+                        for (child_node.child_indices) |grandchild_index| {
+                            self.addQuad(sector, grandchild_index);
+                        }
+                    } else if (child_node.mesh_lod == 1) {
+                        self.addQuad(sector, node_child_index);
+                        sector.load.appendSliceAssumeCapacity(child_node.child_indices[0..4]);
+                    } else {
+                        self.collectQuads(sector, node_child_index);
+                    }
+                } else {
+                    self.addQuad(sector, node_child_index);
+                }
+            }
+        } else if (node.containedInsideChildren(position, range, nodes)) {
+            self.addQuad(sector, node_index);
+            sector.load.appendSliceAssumeCapacity(node.child_indices[0..4]);
+        } else {
+            if (node.isLoaded()) {
+                self.addQuad(sector, node_index);
+            } else {
+                sector.load.appendAssumeCapacity(node_index);
+            }
+        }
+    }
+
+    fn addQuad(self: *TerrainQuadSelector, sector: *SectorQuads, node_index: u32) void {
+        sector.render.appendAssumeCapacity(node_index);
+
+        const node = &self.nodes[node_index];
+        if (node.isLoaded()) {
+            if (self.view.frustum_culling and !self.isInFrustum(node)) {
+                sector.frustum_culled += 1;
+                return;
+            }
+            if (self.view.horizon_culling and self.isBelowHorizon(node)) {
+                sector.horizon_culled += 1;
+                return;
+            }
+        }
+        sector.visible.appendAssumeCapacity(node_index);
+    }
+
+    fn isInFrustum(self: *const TerrainQuadSelector, node: *const QuadTreeNode) bool {
+        const box_min = [3]f32{ node.center[0] - node.size[0], node.height_min, node.center[1] - node.size[1] };
+        const box_max = [3]f32{ node.center[0] + node.size[0], node.height_max, node.center[1] + node.size[1] };
+        for (self.view.frustum_planes) |plane| {
+            // The corner furthest along the plane normal.
+            var distance = plane[3];
+            for (0..3) |axis| {
+                const corner = if (plane[axis] > 0) box_max[axis] else box_min[axis];
+                distance += plane[axis] * corner;
+            }
+            if (distance < 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    fn isBelowHorizon(self: *const TerrainQuadSelector, node: *const QuadTreeNode) bool {
+        const footprint = self.getFootprint(node) orelse return false;
+        const eye_height = self.view.camera_position[1];
+        // The steepest line of sight to any point of the node.
+        const rise = node.height_max - eye_height;
+        const run = if (rise >= 0) footprint.distance_min else footprint.distance_max;
+        const slope = rise / run;
+
+        var bin = binIndex(footprint.angle_min);
+        const bin_last = binIndex(footprint.angle_max);
+        while (bin <= bin_last) : (bin += 1) {
+            const bin_occluders = self.occluders.items[self.bin_starts[wrapBin(bin)]..self.bin_starts[wrapBin(bin) + 1]];
+            // Only terrain that's entirely in front of the node counts.
+            var low: usize = 0;
+            var high: usize = bin_occluders.len;
+            while (low < high) {
+                const mid = (low + high) / 2;
+                if (bin_occluders[mid].distance <= footprint.distance_min) {
+                    low = mid + 1;
+                } else {
+                    high = mid;
+                }
+            }
+            if (low == 0 or bin_occluders[low - 1].slope <= slope) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    fn buildHorizon(self: *TerrainQuadSelector, sectors_count: u32) void {
+        self.occluders.clearRetainingCapacity();
+        for (self.nodes[0..sectors_count]) |*sector| {
+            self.addOccluder(sector);
+            for (sector.child_indices) |child_index| {
+                if (child_index != invalid_index) {
+                    self.addOccluder(&self.nodes[child_index]);
+                }
+            }
+        }
+
+        std.mem.sort(Occluder, self.occluders.items, {}, occludersSorter);
+        var bin_start: u32 = 0;
+        for (0..horizon_bins_count) |bin| {
+            self.bin_starts[bin] = bin_start;
+            var slope_max = -std.math.inf(f32);
+            while (bin_start < self.occluders.items.len and self.occluders.items[bin_start].bin == bin) : (bin_start += 1) {
+                slope_max = @max(slope_max, self.occluders.items[bin_start].slope);
+                self.occluders.items[bin_start].slope = slope_max;
+            }
+        }
+        self.bin_starts[horizon_bins_count] = bin_start;
+    }
+
+    // Blocks the bins the node covers entirely. Any line of sight through one of them enters the
+    // node between distance_min and distance_entry_max, and stays over it up to at least
+    // distance_min.
+    fn addOccluder(self: *TerrainQuadSelector, node: *const QuadTreeNode) void {
+        if (!node.isLoaded()) {
+            return;
+        }
+        const footprint = self.getFootprint(node) orelse return;
+        const rise = node.height_min - occluder_height_margin - self.view.camera_position[1];
+        const run = if (rise >= 0) footprint.distance_entry_max else footprint.distance_min;
+        const slope = rise / run;
+
+        var bin: i32 = @intFromFloat(@ceil((footprint.angle_min + std.math.pi) / bin_angle));
+        const bin_end: i32 = @intFromFloat(@floor((footprint.angle_max + std.math.pi) / bin_angle));
+        while (bin < bin_end) : (bin += 1) {
+            self.occluders.append(self.allocator, .{
+                .bin = wrapBin(bin),
+                .distance = footprint.distance_entry_max,
+                .slope = slope,
+            }) catch unreachable;
+        }
+    }
+
+    fn getFootprint(self: *const TerrainQuadSelector, node: *const QuadTreeNode) ?Footprint {
+        const camera_x = self.view.camera_position[0];
+        const camera_z = self.view.camera_position[2];
+        const min_x = node.center[0] - node.size[0] - camera_x;
+        const max_x = node.center[0] + node.size[0] - camera_x;
+        const min_z = node.center[1] - node.size[1] - camera_z;
+        const max_z = node.center[1] + node.size[1] - camera_z;
+
+        const near_x = @max(min_x, 0, -max_x);
+        const near_z = @max(min_z, 0, -max_z);
+        const distance_min = @sqrt(near_x * near_x + near_z * near_z);
+        if (distance_min < 1) {
+            return null; // The camera is above it
+        }
+        const far_x = @max(-min_x, max_x);
+        const far_z = @max(-min_z, max_z);
+
+        // Camera outside the square, so its corners are less than pi apart around the center.
+        const center_angle = std.math.atan2(node.center[1] - camera_z, node.center[0] - camera_x);
+        var angle_min = std.math.inf(f32);
+        var angle_max = -std.math.inf(f32);
+        for ([_][2]f32{ .{ min_x, min_z }, .{ max_x, min_z }, .{ min_x, max_z }, .{ max_x, max_z } }) |corner| {
+            var angle = std.math.atan2(corner[1], corner[0]) - center_angle;
+            if (angle > std.math.pi) {
+                angle -= std.math.tau;
+            } else if (angle < -std.math.pi) {
+                angle += std.math.tau;
+            }
+            angle_min = @min(angle_min, angle);
+            angle_max = @max(angle_max, angle);
+        }
+
+        // Corners of the edges facing the camera.
+        var distance_entry_max: f32 = 0;
+        if (min_x > 0 or max_x < 0) {
+            const edge_x = if (min_x > 0) min_x else max_x;
+            distance_entry_max = @max(distance_entry_max, @sqrt(edge_x * edge_x + far_z * far_z));
+        }
+        if (min_z > 0 or max_z < 0) {
+            const edge_z = if (min_z > 0) min_z else max_z;
+            distance_entry_max = @max(distance_entry_max, @sqrt(edge_z * edge_z + far_x * far_x));
+        }
+
+        return .{
+            .angle_min = center_angle + angle_min,
+            .angle_max = center_angle + angle_max,
+            .distance_min = distance_min,
+            .distance_max = @sqrt(far_x * far_x + far_z * far_z),
+            .distance_entry_max = distance_entry_max,
+        };
+    }
+
+    fn binIndex(angle: f32) i32 {
+        return @intFromFloat(@floor((angle + std.math.pi) / bin_angle));
+    }
+
+    fn wrapBin(bin: i32) u32 {
+        return @intCast(@mod(bin, horizon_bins_count));
+    }
+
+    fn occludersSorter(_: void, a: Occluder, b: Occluder) bool {
+        if (a.bin != b.bin) {
+            return a.bin < b.bin;
+        }
+        return a.distance < b.distance;
+    }
+};
+
+// A row of count sectors along x, every node loaded with heights 0 to 10.
+fn testSectors(nodes: *std.ArrayList(QuadTreeNode), count: u32) void {
+    for (0..count) |i| {
+        nodes.appendAssumeCapacity(.{
+            .center = .{ @as(f32, @floatFromInt(i)) * 512 + 256, 256 },
+            .size = .{ 256, 256 },
+            .child_indices = .{ invalid_index, invalid_index, invalid_index, invalid_index },
+            .mesh_lod = 3,
+            .patch_index = .{ @intCast(i), 0 },
+        });
+    }
+    for (0..count) |i| {
+        divideQuadTreeNode(nodes, &nodes.items[i]);
+    }
+    for (nodes.items) |*node| {
+        node.height_max = 10;
+        node.loaded = true;
+    }
+}
+
+fn containsQuad(quads: []const u32, quad: u32) bool {
+    return std.mem.indexOfScalar(u32, quads, quad) != null;
+}
+
+test "terrain_quad_tree" {
+    var nodes = try std.ArrayList(QuadTreeNode).initCapacity(std.testing.allocator, 5 * nodes_per_sector);
+    defer nodes.deinit();
+    testSectors(&nodes, 5);
+
+    // Camera south of the middle sector looking north (+z), reversed Z projection. The two outer
+    // sectors are outside the view.
+    const h = 1.0 / @tan(@as(f32, 0.5));
+    const r = 0.1 / (0.1 - 5000.0);
+    const camera = [3]f32{ 1280, 5, -10 };
+    const view_projection = [16]f32{
+        h,              0,              0,                          0,
+        0,              h,              0,                          0,
+        0,              0,              r,                          1,
+        -camera[0] * h, -camera[1] * h, -camera[2] * r - r * 5000.0, -camera[2],
+    };
+    var view = CullingView{
+        .frustum_planes = frustumPlanes(view_projection),
+        .camera_position = camera,
+        .horizon_culling = false,
+    };
+
+    var pool: std.Thread.Pool = undefined;
+    try pool.init(.{ .allocator = std.testing.allocator, .n_jobs = 2 });
+    defer pool.deinit();
+    for ([_]?*std.Thread.Pool{ null, &pool }) |workers| {
+        const selector = TerrainQuadSelector.create(std.testing.allocator, workers);
+        defer selector.destroy();
+
+        // Far from everything, each sector is a single quad.
+        selector.select(nodes.items, 5, view, 50);
+        try expect(std.mem.eql(u32, selector.quads_to_render.items, &.{ 0, 1, 2, 3, 4 }));
+        try expect(std.mem.eql(u32, selector.quads_visible.items, &.{ 1, 2, 3 }));
+        try expect(selector.frustum_culled_count == 2);
+        try expect(selector.quads_to_load.items.len == 0);
+    }
+
+    // Standing in the first sector with a plateau in the second one, the sectors behind it are
+    // below its edge.
+    for (nodes.items[5 + (nodes_per_sector - 1) ..][0 .. nodes_per_sector - 1]) |*node| {
+        node.height_min = 100;
+        node.height_max = 120;
+    }
+    nodes.items[1].height_min = 100;
+    nodes.items[1].height_max = 120;
+    view.camera_position = .{ 100, 5, 256 };
+    view.frustum_culling = false;
+    view.horizon_culling = true;
+
+    const selector = TerrainQuadSelector.create(std.testing.allocator, null);
+    defer selector.destroy();
+    selector.select(nodes.items, 5, view, 50);
+    try expect(selector.horizon_culled_count == 3);
+    try expect(containsQuad(selector.quads_visible.items, 1));
+    try expect(!containsQuad(selector.quads_visible.items, 2));
+    try expect(!containsQuad(selector.quads_visible.items, 4));
+    try expect(selector.quads_visible.items.len + 3 == selector.quads_to_render.items.len);
+
+    // Looking over it from above, nothing is hidden.
+    view.camera_position[1] = 500;
+    selector.select(nodes.items, 5, view, 50);
+    try expect(selector.horizon_culled_count == 0);
+}
@@ -4,6 +4,7 @@ const zm = @import("zmath");
 const fd = @import("../config/flecs_data.zig");
 const renderer = @import("renderer.zig");
 const geometry = @import("geometry.zig");
+const RangeAllocator = @import("../core/range_allocator.zig").RangeAllocator;
 
 pub const InvalidResourceIndex = std.math.maxInt(u32);
 
@@ -97,8 +98,10 @@ pub const UpdateDesc = struct {
     ocean_tiles: *std.ArrayList(OceanTile) = undefined,
     // static_entities: *std.ArrayList(RenderableEntity) = undefined,
     added_static_entities: std.ArrayList(RenderableEntity) = undefined,
-    removed_static_entities: std.ArrayList(RenderableEntityId) = undefined,
-    dynamic_entities: *std.ArrayList(DynamicEntity) = undefined,
+    removed_static_instances: std.ArrayList(RangeAllocator.Allocation) = undefined,
+    added_dynamic_entities: std.ArrayList(DynamicEntity) = undefined,
+    moved_dynamic_instances: std.ArrayList(DynamicInstanceTransform) = undefined,
+    removed_dynamic_instances: std.ArrayList(u32) = undefined,
     ui_images: *std.ArrayList(UiImage) = undefined,
     ui_texts: *std.ArrayList(UiText) = undefined,
 };
@@ -134,9 +137,8 @@ pub const OceanTile = struct {
     scale: f32 = 0,
 };
 
-pub const RenderableEntityId = u64;
 pub const RenderableEntity = struct {
-    entity_id: RenderableEntityId,
+    instance_index: u32,
     renderable_id: IdLocal,
     world: zm.Mat,
     // Debug
@@ -144,13 +146,17 @@ pub const RenderableEntity = struct {
 };
 
 pub const DynamicEntity = struct {
+    instance_slot: u32,
     world: zm.Mat = undefined,
-    position: [3]f32 = undefined,
-    scale: f32 = 0,
     lod_count: u32 = 0,
     lods: [geometry.mesh_lod_max_count]Lod = undefined,
 };
 
+pub const DynamicInstanceTransform = struct {
+    instance_slot: u32,
+    world: zm.Mat,
+};
+
 pub const Lod = struct {
     mesh_handle: renderer.LegacyMeshHandle,
     materials: [geometry.sub_mesh_max_count]IdLocal.HashType,
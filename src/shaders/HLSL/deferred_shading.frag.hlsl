@@ -6,6 +6,10 @@
 #include "math.hlsli"
 #include "SH.hlsli"
 
+// NOTE: Keep in sync with light_clustering.zig
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
 #define TILED_CULLING_BLOCKSIZE 16
 
 RES(SamplerState, g_linear_repeat_sampler, UPDATE_FREQ_NONE, s0, binding = 1);
@@ -43,11 +47,18 @@ cbuffer cbFrame : register(b0, UPDATE_FREQ_PER_FRAME)
     uint _pad0;
     float3 g_fog_color;
     float g_fog_density;
+    float g_cluster_depth_scale;
+    float g_cluster_depth_bias;
+    uint g_gpu_tiled_light_culling;
+    float _pad1;
 };
 
 StructuredBuffer<GpuLight> lights : register(t8, UPDATE_FREQ_PER_FRAME);
 StructuredBuffer<uint> lightIndexList : register(t9, UPDATE_FREQ_PER_FRAME);
-Texture2D<uint2> lightGrid : register(t10, UPDATE_FREQ_PER_FRAME);
+StructuredBuffer<uint2> lightGrid : register(t10, UPDATE_FREQ_PER_FRAME);
+// Written by light_cull.comp when the GPU tiled light culling is enabled instead of the CPU clusters.
+StructuredBuffer<uint> tiledLightIndexList : register(t11, UPDATE_FREQ_PER_FRAME);
+Texture2D<uint2> tiledLightGrid : register(t12, UPDATE_FREQ_PER_FRAME);
 
 STRUCT(VsOut)
 {
@@ -228,20 +239,38 @@ float4 PS_MAIN(VsOut Input) : SV_TARGET0
     surfaceInfo.metallic = pbrSample.b;
     surfaceInfo.reflectance = pbrSample.a;
 
-    float3 Lo = float3(0.0f, 0.0f, 0.0f);
+    // The sun and the moon light every pixel, the culled lists only hold point lights.
+    float3 Lo = ShadeLight(sun, surfaceInfo, attenuation);
+    Lo += ShadeLight(moon, surfaceInfo, attenuation);
 
-    uint2 positionSS = uint2(Input.UV * g_screen_params.xy);
-    uint2 tileIndex = uint2(floor(positionSS / TILED_CULLING_BLOCKSIZE));
-
-    uint2 lightGridSample = lightGrid[tileIndex].xy;
-    uint startOffset = lightGridSample.x;
-    uint lightCount = lightGridSample.y;
+    if (g_gpu_tiled_light_culling != 0)
+    {
+        uint2 positionSS = uint2(Input.UV * g_screen_params.xy);
+        uint2 lightGridSample = tiledLightGrid[positionSS / TILED_CULLING_BLOCKSIZE].xy;
 
-    [loop] for (uint i = 0; i < lightCount; ++i)
+        [loop] for (uint i = 0; i < lightGridSample.y; ++i)
+        {
+            GpuLight light = lights[tiledLightIndexList[lightGridSample.x + i]];
+            Lo += ShadeLight(light, surfaceInfo, attenuation);
+        }
+    }
+    else
     {
-        uint lightIndex = lightIndexList[startOffset + i];
-        GpuLight light = lights[lightIndex];
-        Lo += ShadeLight(light, surfaceInfo, attenuation);
+        uint2 tileIndex = min(uint2(Input.UV * float2(CLUSTER_TILES_X, CLUSTER_TILES_Y)), uint2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+        float slice = floor(log2(max(linearDepth, 1e-4f)) * g_cluster_depth_scale + g_cluster_depth_bias);
+        uint sliceIndex = uint(clamp(slice, 0.0f, CLUSTER_SLICES - 1.0f));
+        uint clusterIndex = (sliceIndex * CLUSTER_TILES_Y + tileIndex.y) * CLUSTER_TILES_X + tileIndex.x;
+
+        uint2 lightGridSample = lightGrid[clusterIndex];
+        uint startOffset = lightGridSample.x;
+        uint lightCount = lightGridSample.y;
+
+        [loop] for (uint i = 0; i < lightCount; ++i)
+        {
+            uint lightIndex = lightIndexList[startOffset + i];
+            GpuLight light = lights[lightIndex];
+            Lo += ShadeLight(light, surfaceInfo, attenuation);
+        }
     }
 
     Lo += CalculateAmbientLight(N, baseColor.rgb, 1.5f);
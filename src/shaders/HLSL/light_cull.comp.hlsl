@@ -149,12 +149,9 @@ float4 ScreenToView(float4 screen)
 
     for (uint i = input.groupIndex; i < g_DispatchParams.lightsCount; i += TILED_CULLING_BLOCKSIZE * TILED_CULLING_BLOCKSIZE)
     {
+        // The sun and the moon are shaded for every pixel, only point lights go into the tiles.
         GpuLight light = g_Lights[i];
-        if (light.light_type == 0)
-        {
-            AppendLight(i);
-        }
-        else if (light.light_type == 1)
+        if (light.light_type == 1)
         {
             float3 positionVS = mul(g_DispatchParams.view, float4(light.position.xyz, 1)).xyz;
             Sphere sphere = {positionVS.xyz, light.radius * light.radius};
@@ -50,6 +50,7 @@ pub const SystemState = struct {
     comp_query_loader: ecsu.Query,
     loaders: [1]WorldLoaderData = .{.{}},
     requester_id: world_patch_manager.RequesterId,
+    region_subscription: world_patch_manager.RegionSubscriptionId,
     patches: std.ArrayList(Patch),
     indices: [indices_per_patch]IndexType,
     nav_ctx: Recast.rcContext = undefined,
@@ -90,6 +91,14 @@ pub fn create(name: IdLocal, ctx: SystemCtx) !*SystemState {
     const status_nm = nav_mesh.*.init__Overload2(&navmesh_params);
     assert(DetourStatus.dtStatusSucceed(status_nm));
 
+    const requester_id = ctx.world_patch_mgr.registerRequester(IdLocal.init("navmesh"));
+    const region_subscription = ctx.world_patch_mgr.subscribeRegion(.{
+        .requester_id = requester_id,
+        .patch_type_id = ctx.world_patch_mgr.getPatchTypeId(IdLocal.init("heightmap")),
+        .radius = 256,
+        .lod_mask = 1 << 0,
+    });
+
     var system = allocator.create(SystemState) catch unreachable;
     const sys = ecsu_world.newWrappedRunSystem(name.toCString(), ecs.OnUpdate, fd.NOCOMP, update, .{ .ctx = system });
     system.* = .{
@@ -98,7 +107,8 @@ pub fn create(name: IdLocal, ctx: SystemCtx) !*SystemState {
         .world_patch_mgr = ctx.world_patch_mgr,
         .sys = sys,
         .comp_query_loader = comp_query_loader,
-        .requester_id = ctx.world_patch_mgr.registerRequester(IdLocal.init("navmesh")),
+        .requester_id = requester_id,
+        .region_subscription = region_subscription,
         .patches = std.ArrayList(Patch).initCapacity(allocator, 16 * 16) catch unreachable,
         .indices = undefined,
         .nav_ctx = nav_ctx,
@@ -131,10 +141,6 @@ fn updateLoaders(system: *SystemState) void {
         transform: *fd.Transform,
     });
 
-    var arena_state = std.heap.ArenaAllocator.init(system.allocator);
-    defer arena_state.deinit();
-    const arena = arena_state.allocator();
-
     while (entity_iter.next()) |comps| {
         const loader_comp = comps.WorldLoader;
         if (!loader_comp.navmesh) {
@@ -158,60 +164,20 @@ fn updateLoaders(system: *SystemState) void {
             continue;
         }
 
-        var lookups_old = std.ArrayList(world_patch_manager.PatchLookup).initCapacity(arena, 1024) catch unreachable;
-        var lookups_new = std.ArrayList(world_patch_manager.PatchLookup).initCapacity(arena, 1024) catch unreachable;
+        const delta = system.world_patch_mgr.updateRegionSubscription(system.region_subscription, pos_new[0], pos_new[2]);
 
-        const area_old = world_patch_manager.RequestRectangle{
-            .x = loader.pos_old[0] - 256,
-            .z = loader.pos_old[2] - 256,
-            .width = 512,
-            .height = 512,
-        };
+        for (delta.exited) |lookup| {
+            for (system.patches.items, 0..) |*patch, i| {
+                if (patch.lookup.eql(lookup)) {
+                    // TOOD: cleanup
 
-        const area_new = world_patch_manager.RequestRectangle{
-            .x = pos_new[0] - 256,
-            .z = pos_new[2] - 256,
-            .width = 512,
-            .height = 512,
-        };
-
-        const patch_type_id = system.world_patch_mgr.getPatchTypeId(IdLocal.init("heightmap"));
-        world_patch_manager.WorldPatchManager.getLookupsFromRectangle(patch_type_id, area_old, 0, &lookups_old);
-        world_patch_manager.WorldPatchManager.getLookupsFromRectangle(patch_type_id, area_new, 0, &lookups_new);
-
-        var i_old: u32 = 0;
-        blk: while (i_old < lookups_old.items.len) {
-            var i_new: u32 = 0;
-            while (i_new < lookups_new.items.len) {
-                if (lookups_old.items[i_old].eql(lookups_new.items[i_new])) {
-                    _ = lookups_old.swapRemove(i_old);
-                    _ = lookups_new.swapRemove(i_new);
-                    continue :blk;
+                    _ = system.patches.swapRemove(i);
+                    break;
                 }
-                i_new += 1;
             }
-            i_old += 1;
         }
 
-        // HACK
-        if (loader.pos_old[0] != -100000) {
-            system.world_patch_mgr.removeLoadRequestFromLookups(system.requester_id, lookups_old.items);
-
-            for (lookups_old.items) |lookup| {
-                for (system.patches.items, 0..) |*patch, i| {
-                    if (patch.lookup.eql(lookup)) {
-                        // TOOD: cleanup
-
-                        _ = system.patches.swapRemove(i);
-                        break;
-                    }
-                }
-            }
-        }
-
-        system.world_patch_mgr.addLoadRequestFromLookups(system.requester_id, lookups_new.items, .medium);
-
-        for (lookups_new.items) |lookup| {
+        for (delta.entered) |lookup| {
             var neighbors = .{lookup} ** 8;
             neighbors[0].patch_x -= 1; // row below
             neighbors[0].patch_z -= 1;
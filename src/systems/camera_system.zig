@@ -161,6 +161,7 @@ fn updateTransformHierarchy(it: *ecs.iter_t) callconv(.C) void {
 
     // TODO: Break into two or more loops for less iffing.
 
+    var any_moved = false;
     for (positions, rotations, scales, transforms, 0..) |pos, rot, scale, *transform, i| {
         const z_scale_matrix = zm.scaling(scale.x, scale.y, scale.z);
         const z_rot_matrix = zm.matFromQuat(rot.asZM());
@@ -192,7 +193,19 @@ fn updateTransformHierarchy(it: *ecs.iter_t) callconv(.C) void {
         //         zm.storeArr3(vel.elems(), (pos_curr - pos_prev) / dt4);
         //     }
         // }
-        zm.storeMat43(&transform.matrix, z_world_matrix);
+        var matrix: [12]f32 = undefined;
+        zm.storeMat43(&matrix, z_world_matrix);
+        if (!std.mem.eql(f32, &matrix, &transform.matrix)) {
+            transform.matrix = matrix;
+            any_moved = true;
+        }
+    }
+
+    // NOTE: Positions are often written through get_mut without modified(), so every table is
+    // recomputed. Skipping the unchanged ones keeps them from being flagged as changed, which is
+    // what lets the renderer's iter_changed query skip entities that stood still.
+    if (!any_moved) {
+        ecs.iter_skip(it);
     }
 }
 
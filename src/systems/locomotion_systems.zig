@@ -9,6 +9,10 @@ const fd = @import("../config/flecs_data.zig");
 const input = @import("../input.zig");
 const config = @import("../config/config.zig");
 const context = @import("../core/context.zig");
+const world_patch_manager = @import("../worldpatch/world_patch_manager.zig");
+const terrain_height_query = @import("../worldpatch/terrain_height_query.zig");
+const TerrainHeightQuery = terrain_height_query.TerrainHeightQuery;
+const TerrainHeightResult = terrain_height_query.TerrainHeightResult;
 
 pub const SystemCreateCtx = struct {
     pub usingnamespace context.CONTEXTIFY(@This());
@@ -17,6 +21,7 @@ pub const SystemCreateCtx = struct {
     input_frame_data: *input.FrameData,
     physics_world: *zphy.PhysicsSystem,
     physics_world_low: *zphy.PhysicsSystem,
+    world_patch_mgr: *world_patch_manager.WorldPatchManager,
 };
 
 const SystemUpdateContext = struct {
@@ -25,13 +30,18 @@ const SystemUpdateContext = struct {
     input_frame_data: *input.FrameData,
     physics_world: *zphy.PhysicsSystem,
     physics_world_low: *zphy.PhysicsSystem,
-    state: struct {},
+    world_patch_mgr: *world_patch_manager.WorldPatchManager,
+    state: struct {
+        terrain_height_query: TerrainHeightQuery,
+    },
 };
 
 pub fn create(create_ctx: SystemCreateCtx) void {
     const update_ctx = create_ctx.arena_system_lifetime.create(SystemUpdateContext) catch unreachable;
     update_ctx.* = SystemUpdateContext.view(create_ctx);
-    update_ctx.*.state = .{};
+    update_ctx.*.state = .{
+        .terrain_height_query = TerrainHeightQuery.create(create_ctx.world_patch_mgr),
+    };
 
     _ = ecsu.registerSystem(create_ctx.ecsu_world.world, "moveForward", moveForward, update_ctx, &[_]ecs.term_t{
         .{ .id = ecs.id(fd.Locomotion), .inout = .In },
@@ -75,6 +85,44 @@ fn moveForward(it: *ecs.iter_t) callconv(.C) void {
     }
 }
 
+const snap_batch_size = 64;
+
+const Ground = struct {
+    height: f32,
+    normal: [3]f32,
+};
+
+// For when there's no terrain resident under pos, there might still be something static to stand on.
+fn raycastGround(ctx: *SystemUpdateContext, pos: *const fd.Position) ?Ground {
+    const ray_dir = [_]f32{ 0, -1000, 0, 0 };
+    const ray_origin = [_]f32{ pos.x, pos.y + 200, pos.z, 0 };
+    const ray = zphy.RRayCast{
+        .origin = ray_origin,
+        .direction = ray_dir,
+    };
+    const cast_ray_args: zphy.NarrowPhaseQuery.CastRayArgs = .{
+        .broad_phase_layer_filter = @ptrCast(&config.physics.NonMovingBroadPhaseLayerFilter{}),
+    };
+
+    var ray_physics_world = ctx.physics_world;
+    var query = ray_physics_world.getNarrowPhaseQuery();
+    var result = query.castRay(ray, cast_ray_args);
+    if (!result.has_hit) {
+        ray_physics_world = ctx.physics_world_low;
+        query = ctx.physics_world_low.getNarrowPhaseQuery();
+        result = query.castRay(ray, cast_ray_args);
+    }
+    if (!result.has_hit) {
+        return null;
+    }
+
+    const body_hit_opt = zphy.tryGetBody(ray_physics_world.getBodiesUnsafe(), result.hit.body_id);
+    return .{
+        .height = ray_origin[1] + ray_dir[1] * result.hit.fraction,
+        .normal = if (body_hit_opt) |body_hit| body_hit.getWorldSpaceSurfaceNormal(result.hit.sub_shape_id, ray.getPointOnRay(result.hit.fraction)) else .{ 0, 1, 0 },
+    };
+}
+
 fn snapToTerrain(it: *ecs.iter_t) callconv(.C) void {
     const ctx: *SystemUpdateContext = @alignCast(@ptrCast(it.ctx.?));
 
@@ -84,65 +132,61 @@ fn snapToTerrain(it: *ecs.iter_t) callconv(.C) void {
 
     const slerp_factor: f32 = 0.01;
     const up_z = zm.f32x4(0, 1, 0, 0);
-    const ray_dir = [_]f32{ 0, -1000, 0, 0 };
 
     const environment_info = ctx.ecsu_world.getSingletonMut(fd.EnvironmentInfo).?;
-    const bodies_all_sim = ctx.physics_world.getBodiesUnsafe();
-    const bodies_all_low = ctx.physics_world_low.getBodiesUnsafe();
 
-    const cast_ray_args: zphy.NarrowPhaseQuery.CastRayArgs = .{
-        .broad_phase_layer_filter = @ptrCast(&config.physics.NonMovingBroadPhaseLayerFilter{}),
-    };
+    var batch_start: usize = 0;
+    while (batch_start < locomotions.len) : (batch_start += snap_batch_size) {
+        const batch_end = @min(batch_start + snap_batch_size, locomotions.len);
 
-    for (locomotions, positions, rotations) |*locomotion, *pos, *rot| {
-        if (!locomotion.snap_to_terrain) {
-            continue;
-        }
-        if (!locomotion.enabled) {
-            continue;
+        var query_positions: [snap_batch_size][2]f32 = undefined;
+        var query_indices: [snap_batch_size]usize = undefined;
+        var query_count: usize = 0;
+        for (batch_start..batch_end) |i| {
+            if (!locomotions[i].snap_to_terrain) {
+                continue;
+            }
+            if (!locomotions[i].enabled) {
+                continue;
+            }
+            query_positions[query_count] = .{ positions[i].x, positions[i].z };
+            query_indices[query_count] = i;
+            query_count += 1;
         }
 
-        const ray_origin = [_]f32{ pos.x, pos.y + 200, pos.z, 0 };
-        const ray = zphy.RRayCast{
-            .origin = ray_origin,
-            .direction = ray_dir,
-        };
-
-        var ray_physics_world = ctx.physics_world;
-        var ray_bodies_all = bodies_all_sim;
-        var query = ray_physics_world.getNarrowPhaseQuery();
-        var result = query.castRay(ray, cast_ray_args);
-        if (!result.has_hit) {
-            ray_physics_world = ctx.physics_world_low;
-            ray_bodies_all = bodies_all_low;
-            query = ctx.physics_world_low.getNarrowPhaseQuery();
-            result = query.castRay(ray, cast_ray_args);
-        }
+        var terrain_results: [snap_batch_size]TerrainHeightResult = undefined;
+        ctx.state.terrain_height_query.queryBatch(query_positions[0..query_count], terrain_results[0..query_count]);
+
+        for (query_indices[0..query_count], terrain_results[0..query_count]) |i, terrain_result| {
+            const locomotion = &locomotions[i];
+            const pos = &positions[i];
+            const rot = &rotations[i];
+
+            // Same window as the ray this replaced, from 200 m above down to 800 m below.
+            // NOTE: The terrain heightfields are the only static bodies, so where the heightmap is
+            // resident it gives what the ray would hit. Static colliders on top of the terrain
+            // would need a raycast here too.
+            const is_terrain_hit = terrain_result.hit and terrain_result.height < pos.y + 200 and terrain_result.height > pos.y - 800;
+            const ground = blk: {
+                if (is_terrain_hit) {
+                    break :blk Ground{ .height = terrain_result.height, .normal = terrain_result.normal };
+                }
+                break :blk raycastGround(ctx, pos) orelse continue;
+            };
 
-        if (result.has_hit and locomotion.affected_by_gravity) {
-            const dist = result.hit.fraction * ray_dir[1] * -1;
-            if (dist > 200.1 or locomotion.speed_y > 0) {
-                result.has_hit = false;
-            } else {
+            if (locomotion.affected_by_gravity) {
+                if (pos.y - ground.height > 0.1 or locomotion.speed_y > 0) {
+                    continue;
+                }
                 environment_info.playFootstep(pos.elems().*, 3);
                 locomotion.affected_by_gravity = false;
             }
-        }
-
-        if (result.has_hit) {
-            pos.y = ray_origin[1] + ray_dir[1] * result.hit.fraction + 0.1;
 
-            const body_hit_opt = zphy.tryGetBody(ray_bodies_all, result.hit.body_id);
+            pos.y = ground.height + 0.1;
 
             const rot_slope_z = blk: {
-                if (body_hit_opt == null) {
-                    break :blk zm.quatFromAxisAngle(up_z, 0);
-                }
-
-                const body_hit = body_hit_opt.?;
-                const hit_normal = body_hit.getWorldSpaceSurfaceNormal(result.hit.sub_shape_id, ray.getPointOnRay(result.hit.fraction));
-                const hit_normal_z = zm.loadArr3(hit_normal);
-                if (hit_normal[1] < 0.99) { // TODO: Find a good value, this was just arbitrarily picked :)
+                const hit_normal_z = zm.loadArr3(ground.normal);
+                if (ground.normal[1] < 0.99) { // TODO: Find a good value, this was just arbitrarily picked :)
                     const rot_axis_z = zm.cross3(up_z, hit_normal_z);
                     const dot = zm.dot3(up_z, hit_normal_z)[0];
                     const rot_angle = std.math.acos(dot);
@@ -155,21 +199,9 @@ fn snapToTerrain(it: *ecs.iter_t) callconv(.C) void {
             const rot_curr_z = rot.asZM();
             const rot_new_z = zm.slerp(rot_curr_z, rot_slope_z, slerp_factor); // TODO SmoothDamp
             const rot_new_normalized_z = zm.normalize4(rot_new_z);
-
-            // var rot: [4]f32 = undefined;
             zm.storeArr4(rot.elems(), rot_new_normalized_z);
-            // pos.y =
 
             // NOTE: Should this use MoveKinematic?
-            // body_interface.setPositionRotationAndVelocity(
-            //     body.body_id,
-            //     pos.elems().*,
-            //     rot,
-            //     zero_vec3,
-            //     zero_vec3,
-            // );
-        } else {
-            // body_interface.setPosition(body.body_id, pos.elems().*, .dont_activate);
         }
     }
 }
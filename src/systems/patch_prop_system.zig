@@ -7,6 +7,7 @@ const fd = @import("../config/flecs_data.zig");
 const fr = @import("../config/flecs_relation.zig");
 const IdLocal = @import("../core/core.zig").IdLocal;
 const world_patch_manager = @import("../worldpatch/world_patch_manager.zig");
+const patch_types = @import("../worldpatch/patch_types.zig");
 const tides_math = @import("../core/math.zig");
 const PrefabManager = @import("../prefab_manager.zig").PrefabManager;
 const ztracy = @import("ztracy");
@@ -47,6 +48,7 @@ const SystemUpdateContext = struct {
         patches: std.ArrayList(Patch),
         loaders: [1]WorldLoaderData = .{.{}},
         requester_id: world_patch_manager.RequesterId,
+        region_subscription: world_patch_manager.RegionSubscriptionId,
         // comp_query_loader: ecsu.Query,
         tree_prefab: ecsu.Entity,
         cube_prefab: ecsu.Entity,
@@ -59,8 +61,15 @@ pub fn create(create_ctx: SystemCreateCtx) void {
 
     const update_ctx = create_ctx.arena_system_lifetime.create(SystemUpdateContext) catch unreachable;
     update_ctx.* = SystemUpdateContext.view(create_ctx);
+    const requester_id = create_ctx.world_patch_mgr.registerRequester(IdLocal.init("props"));
     update_ctx.*.state = .{
-        .requester_id = create_ctx.world_patch_mgr.registerRequester(IdLocal.init("props")),
+        .requester_id = requester_id,
+        .region_subscription = create_ctx.world_patch_mgr.subscribeRegion(.{
+            .requester_id = requester_id,
+            .patch_type_id = create_ctx.world_patch_mgr.getPatchTypeId(IdLocal.init("props")),
+            .radius = 4 * 1024,
+            .lod_mask = 1 << 1,
+        }),
         .patches = std.ArrayList(Patch).initCapacity(create_ctx.heap_allocator, 4 * 4 * 32 * 32) catch unreachable,
         .tree_prefab = tree_prefab,
         .cube_prefab = cube_prefab,
@@ -113,10 +122,6 @@ fn patchPropUpdateLoaders(it: *ecs.iter_t) callconv(.C) void {
     const world_loaders = ecs.field(it, fd.WorldLoader, 0).?;
     const transforms = ecs.field(it, fd.Transform, 1).?;
 
-    var arena_state = std.heap.ArenaAllocator.init(system.arena_system_update);
-    defer arena_state.deinit();
-    const arena = arena_state.allocator();
-
     for (world_loaders, transforms, it.entities()) |loader_comp, transform, ent| {
         if (!loader_comp.props) {
             continue;
@@ -143,70 +148,25 @@ fn patchPropUpdateLoaders(it: *ecs.iter_t) callconv(.C) void {
             }
         }
 
-        const patch_type_id = system.world_patch_mgr.getPatchTypeId(IdLocal.init("props"));
-        var lookups_old = std.ArrayList(world_patch_manager.PatchLookup).initCapacity(arena, 8 * 16 * 1024) catch unreachable;
-        var lookups_new = std.ArrayList(world_patch_manager.PatchLookup).initCapacity(arena, 8 * 16 * 1024) catch unreachable;
-
-        const lod = 1;
-        const radius = 4 * 1024;
-        if (loader.pos_old) |pos_old| {
-            const area_old = world_patch_manager.RequestRectangle{
-                .x = pos_old[0] - radius,
-                .z = pos_old[2] - radius,
-                .width = radius * 2,
-                .height = radius * 2,
-            };
-
-            world_patch_manager.WorldPatchManager.getLookupsFromRectangle(patch_type_id, area_old, lod, &lookups_old);
-        }
-
-        const area_new = world_patch_manager.RequestRectangle{
-            .x = pos_new[0] - radius,
-            .z = pos_new[2] - radius,
-            .width = radius * 2,
-            .height = radius * 2,
-        };
-
-        world_patch_manager.WorldPatchManager.getLookupsFromRectangle(patch_type_id, area_new, lod, &lookups_new);
-
-        var i_old: u32 = 0;
-        blk: while (i_old < lookups_old.items.len) {
-            var i_new: u32 = 0;
-            while (i_new < lookups_new.items.len) {
-                if (lookups_old.items[i_old].eql(lookups_new.items[i_new])) {
-                    _ = lookups_old.swapRemove(i_old);
-                    _ = lookups_new.swapRemove(i_new);
-                    continue :blk;
-                }
-                i_new += 1;
-            }
-            i_old += 1;
-        }
-
-        // HACK
-        if (loader.pos_old != null) {
-            system.world_patch_mgr.removeLoadRequestFromLookups(system.state.requester_id, lookups_old.items);
-
-            for (lookups_old.items) |lookup| {
-                for (system.state.patches.items, 0..) |*patch, i| {
-                    if (patch.lookup.eql(lookup)) {
-                        // TODO: Batch delete
-                        for (patch.entities.items) |patch_ent| {
-                            system.ecsu_world.delete(patch_ent);
-                        }
-
-                        patch.entities.deinit();
-                        _ = system.state.patches.swapRemove(i);
-                        break;
+        loader.pos_old = pos_new;
+        const delta = system.world_patch_mgr.updateRegionSubscription(system.state.region_subscription, pos_new[0], pos_new[2]);
+
+        for (delta.exited) |lookup| {
+            for (system.state.patches.items, 0..) |*patch, i| {
+                if (patch.lookup.eql(lookup)) {
+                    // TODO: Batch delete
+                    for (patch.entities.items) |patch_ent| {
+                        system.ecsu_world.delete(patch_ent);
                     }
+
+                    patch.entities.deinit();
+                    _ = system.state.patches.swapRemove(i);
+                    break;
                 }
             }
         }
-        loader.pos_old = pos_new;
-
-        system.world_patch_mgr.addLoadRequestFromLookups(system.state.requester_id, lookups_new.items, .medium);
 
-        for (lookups_new.items) |lookup| {
+        for (delta.entered) |lookup| {
             system.state.patches.appendAssumeCapacity(.{
                 .lookup = lookup,
                 .lod = 1,
@@ -228,31 +188,26 @@ fn patchPropUpdatePatches(it: *ecs.iter_t) callconv(.C) void {
             continue;
         }
 
-        const Prop = struct {
-            id: IdLocal,
-            pos: [3]f32,
-            rot: f32,
-        };
-
-        const patch_info = system.world_patch_mgr.tryGetPatch(patch.lookup, []Prop);
-        if (patch_info.status != .not_loaded) {
+        const patch_info = system.world_patch_mgr.tryGetPatch(patch.lookup, patch_types.Props);
+        if (patch_info.status != .not_loaded and patch_info.status != .loading) {
             patch.loaded = true;
             if (patch_info.status == .loaded_empty or patch_info.status == .nonexistent) {
                 break;
             }
-            const data = patch_info.data_opt.?;
+            const props = patch_info.data_opt.?;
 
             const tree_id = IdLocal.init("tree");
             const wall_id = IdLocal.init("wall");
             const city_id = IdLocal.init("city");
-            var rand1 = std.Random.DefaultPrng.init(data.len);
+            var rand1 = std.Random.DefaultPrng.init(props.count);
             var rand = rand1.random();
-            for (data.*) |prop| {
-                const prop_pos = fd.Position.init(prop.pos[0], prop.pos[1], prop.pos[2]);
-                const prop_scale: f32 = 0.15 + rand.float(f32) * 1.25;
+            for (0..props.count) |prop_index| {
+                const prop_type_hash = props.typeHash(prop_index);
+                const prop_pos = fd.Position.init(props.pos_x[prop_index], props.pos_y[prop_index], props.pos_z[prop_index]);
+                const prop_scale: f32 = props.scale[prop_index];
                 const prop_rot = fd.Rotation.initFromEuler(
                     rand.float(f32) * 0.1,
-                    prop.rot + std.math.pi * 0.5,
+                    props.rot[prop_index] + std.math.pi * 0.5,
                     rand.float(f32) * 0.1,
                 );
 
@@ -265,14 +220,14 @@ fn patchPropUpdatePatches(it: *ecs.iter_t) callconv(.C) void {
                 zm.storeMat43(prop_transform.matrix[0..], z_prop_srt_matrix);
                 prop_transform.updateInverseMatrix();
 
-                if (prop.id.hash == tree_id.hash) {
+                if (prop_type_hash == tree_id.hash) {
                     var fir_tree_ent = system.prefab_mgr.instantiatePrefab(system.ecsu_world, system.state.tree_prefab);
                     fir_tree_ent.set(prop_transform);
                     fir_tree_ent.set(prop_pos);
                     fir_tree_ent.set(prop_rot);
                     fir_tree_ent.set(fd.Scale.createScalar(prop_scale));
                     patch.entities.append(fir_tree_ent.id) catch unreachable;
-                } else if (prop.id.hash == wall_id.hash) {
+                } else if (prop_type_hash == wall_id.hash) {
                     // var wall_ent = system.prefab_mgr.instantiatePrefab(system.ecsu_world, system.state.cube_prefab);
                     // wall_ent.set(prop_transform);
                     // wall_ent.set(prop_pos);
@@ -282,7 +237,7 @@ fn patchPropUpdatePatches(it: *ecs.iter_t) callconv(.C) void {
                 } else {
                     var prop_ent = system.ecsu_world.newEntity();
                     prop_ent.set(prop_transform);
-                    if (prop.id.hash == city_id.hash) {
+                    if (prop_type_hash == city_id.hash) {
                         // var light_ent = system.ecsu_world.newEntity();
                         // light_ent.set(fd.Transform.initFromPosition(.{ .x = prop.pos[0], .y = prop.pos[1] + 2 + 10, .z = prop.pos[2] }));
                         // light_ent.set(fd.Light{ .radiance = .{ .r = 4, .g = 2, .b = 1 }, .range = 100 });
@@ -0,0 +1,161 @@
+const std = @import("std");
+const assert = std.debug.assert;
+const zphy = @import("zphysics");
+const ztracy = @import("ztracy");
+
+const config = @import("../config/config.zig");
+const MpscQueue = @import("../core/mpsc_queue.zig").MpscQueue;
+const patch_types = @import("../worldpatch/patch_types.zig");
+const world_patch_manager = @import("../worldpatch/world_patch_manager.zig");
+
+// Creates the Jolt heightfield shapes for terrain patches on worker threads. HeightFieldShape
+// creation is the expensive part of streaming in collision (it quantizes the samples and builds
+// the min/max block hierarchy), so the main thread only copies the samples in and turns the
+// finished shapes into bodies, see addBodies.
+//
+// The samples are copied when enqueueing, the heightmap can be unloaded right away.
+
+pub const ShapeBuildResult = struct {
+    lookup: world_patch_manager.PatchLookup,
+    shape: *zphy.Shape,
+};
+
+const ShapeBuildJob = struct {
+    lookup: world_patch_manager.PatchLookup,
+    scale: f32,
+    samples: [config.patch_samples]f32,
+};
+
+const ShapeBuildResultQueue = MpscQueue(ShapeBuildResult);
+
+pub const HeightfieldShapeBuilder = struct {
+    pub const max_shapes_in_flight = 64; // must be a power of two, it sizes the result queue
+
+    allocator: std.mem.Allocator,
+    workers: *std.Thread.Pool, // borrowed, the job system's background pool in the game
+    results: ShapeBuildResultQueue,
+    shapes_in_flight: u32 = 0,
+    shapes_built_total: u64 = 0,
+
+    pub fn create(allocator: std.mem.Allocator, workers: *std.Thread.Pool) *HeightfieldShapeBuilder {
+        const self = allocator.create(HeightfieldShapeBuilder) catch unreachable;
+        self.* = .{
+            .allocator = allocator,
+            .workers = workers,
+            .results = ShapeBuildResultQueue.create(allocator, max_shapes_in_flight),
+        };
+        return self;
+    }
+
+    // Waits for the shapes in flight and releases them. The pool outlives the builder.
+    pub fn destroy(self: *HeightfieldShapeBuilder) void {
+        while (self.shapes_in_flight > 0) {
+            const result = self.popResult() orelse {
+                std.Thread.yield() catch {};
+                continue;
+            };
+            result.shape.release();
+        }
+        self.results.destroy();
+        self.allocator.destroy(self);
+    }
+
+    pub fn isFull(self: HeightfieldShapeBuilder) bool {
+        return self.shapes_in_flight == max_shapes_in_flight;
+    }
+
+    // Returns false when enough shapes are already in flight, try again next frame.
+    pub fn enqueue(self: *HeightfieldShapeBuilder, lookup: world_patch_manager.PatchLookup, heightmap: *const patch_types.Heightmap, scale: f32) bool {
+        if (self.isFull()) {
+            return false;
+        }
+        self.shapes_in_flight += 1;
+        self.workers.spawn(buildShapeJob, .{ self, ShapeBuildJob{
+            .lookup = lookup,
+            .scale = scale,
+            .samples = heightmap.heightmap,
+        } }) catch unreachable;
+        return true;
+    }
+
+    // The caller owns the shape.
+    pub fn popResult(self: *HeightfieldShapeBuilder) ?ShapeBuildResult {
+        const result = self.results.pop() orelse return null;
+        self.shapes_in_flight -= 1;
+        self.shapes_built_total += 1;
+        return result;
+    }
+
+    fn buildShapeJob(self: *HeightfieldShapeBuilder, job: ShapeBuildJob) void {
+        const trazy_zone = ztracy.ZoneNC(@src(), "Heightfield shape build", 0x00_00_00_ff);
+        defer trazy_zone.End();
+
+        var shape_settings = zphy.HeightFieldShapeSettings.create(&job.samples, config.patch_resolution) catch unreachable;
+        defer shape_settings.release();
+        shape_settings.setScale(.{ job.scale, 1, job.scale });
+        const shape = shape_settings.createShape() catch unreachable;
+
+        // Can't fail, the number of shapes in flight is capped to the queue capacity.
+        const pushed = self.results.push(.{ .lookup = job.lookup, .shape = shape });
+        assert(pushed);
+    }
+};
+
+// Decides when to rebuild the broadphase tree. Bodies added one at a time go into Jolt's
+// quadtree incrementally and are found fine, the tree just gets less efficient to query.
+// Rebuilding it walks every body, so it's done once a streaming burst has settled, or when
+// enough bodies piled up during a long one.
+pub const BroadPhaseOptimizePolicy = struct {
+    max_bodies_between_optimizes: u32,
+    bodies_since_optimize: u32 = 0,
+    optimizes_total: u64 = 0,
+
+    pub fn onBodiesAdded(self: *BroadPhaseOptimizePolicy, count: u32) void {
+        self.bodies_since_optimize += count;
+    }
+
+    // Call once per frame after adding bodies. is_streaming tells whether more are coming.
+    pub fn update(self: *BroadPhaseOptimizePolicy, physics_world: *zphy.PhysicsSystem, is_streaming: bool) void {
+        if (self.bodies_since_optimize == 0) {
+            return;
+        }
+        if (is_streaming and self.bodies_since_optimize < self.max_bodies_between_optimizes) {
+            return;
+        }
+
+        const trazy_zone = ztracy.ZoneNC(@src(), "optimizeBroadPhase", 0x00_00_00_ff);
+        defer trazy_zone.End();
+        physics_world.optimizeBroadPhase();
+        self.bodies_since_optimize = 0;
+        self.optimizes_total += 1;
+    }
+};
+
+// Creates static bodies for finished shapes and adds them as one batch. The bodies are
+// created first and then added back to back without activation, static terrain never
+// needs to be woken up.
+pub fn addBodies(
+    physics_world: *zphy.PhysicsSystem,
+    results: []const ShapeBuildResult,
+    body_ids_out: []zphy.BodyId,
+) void {
+    const trazy_zone = ztracy.ZoneNC(@src(), "Add heightfield bodies", 0x00_00_00_ff);
+    defer trazy_zone.End();
+
+    const body_interface = physics_world.getBodyInterfaceMut();
+    for (results, body_ids_out[0..results.len]) |result, *body_id| {
+        const world_pos = result.lookup.getWorldPos();
+        const body = body_interface.createBody(.{
+            .position = .{ @as(f32, @floatFromInt(world_pos.world_x)), 0, @as(f32, @floatFromInt(world_pos.world_z)), 1.0 },
+            .rotation = .{ 0.0, 0.0, 0.0, 1.0 },
+            .shape = result.shape,
+            .motion_type = .static,
+            .object_layer = config.physics.object_layers.non_moving,
+            .user_data = 0,
+        }) catch unreachable;
+        body_id.* = body.id;
+    }
+    for (body_ids_out[0..results.len]) |body_id| {
+        body_interface.addBody(body_id, .dont_activate);
+    }
+}
@@ -13,8 +13,12 @@ const tides_math = @import("../core/math.zig");
 const config = @import("../config/config.zig");
 const util = @import("../util.zig");
 const EventManager = @import("../core/event_manager.zig").EventManager;
+const JobSystem = @import("../core/job_system.zig").JobSystem;
 const context = @import("../core/context.zig");
 const patch_types = @import("../worldpatch/patch_types.zig");
+const physics_heightfield_builder = @import("physics_heightfield_builder.zig");
+const HeightfieldShapeBuilder = physics_heightfield_builder.HeightfieldShapeBuilder;
+const BroadPhaseOptimizePolicy = physics_heightfield_builder.BroadPhaseOptimizePolicy;
 
 const patch_side_vertex_count = config.patch_resolution;
 const vertices_per_patch: u32 = patch_side_vertex_count * patch_side_vertex_count;
@@ -161,6 +165,7 @@ const Patch = struct {
     body_opt: ?zphy.BodyId = null,
     shape_opt: ?*zphy.Shape = null,
     lookup: world_patch_manager.PatchLookup,
+    shape_status: enum { waiting, building, built } = .waiting,
 };
 
 const IndexType = u32;
@@ -172,6 +177,7 @@ pub const SystemCreateCtx = struct {
     heap_allocator: std.mem.Allocator,
     ecsu_world: ecsu.World,
     event_mgr: *EventManager,
+    jobs: *JobSystem,
     physics_world: *zphy.PhysicsSystem,
     physics_world_low: *zphy.PhysicsSystem,
     world_patch_mgr: *world_patch_manager.WorldPatchManager,
@@ -191,7 +197,10 @@ const SystemUpdateContext = struct {
         frame_contacts: std.ArrayList(config.events.CollisionContact) = undefined,
         loaders: [2]WorldLoaderData = .{ .{}, .{} },
         requester_id: world_patch_manager.RequesterId = undefined,
+        region_subscription: world_patch_manager.RegionSubscriptionId = undefined,
         patches: std.ArrayList(Patch) = undefined,
+        shape_builder: *HeightfieldShapeBuilder = undefined,
+        broad_phase_policy: BroadPhaseOptimizePolicy = undefined,
         is_low: bool,
     },
 };
@@ -211,9 +220,20 @@ pub fn create(create_ctx: SystemCreateCtx) void {
 
     const update_ctx = create_ctx.arena_system_lifetime.create(SystemUpdateContext) catch unreachable;
     update_ctx.* = SystemUpdateContext.view(create_ctx);
+    const heightmap_patch_type_id = world_patch_mgr.getPatchTypeId(IdLocal.init("heightmap"));
+    const requester_id = world_patch_mgr.registerRequester(IdLocal.init("physics"));
     update_ctx.*.state = .{
-        .requester_id = world_patch_mgr.registerRequester(IdLocal.init("physics")),
+        .requester_id = requester_id,
+        .region_subscription = world_patch_mgr.subscribeRegion(.{
+            .requester_id = requester_id,
+            .patch_type_id = heightmap_patch_type_id,
+            .prio = .high,
+            .radius = 512,
+            .lod_mask = 1 << 0,
+        }),
         .patches = std.ArrayList(Patch).initCapacity(arena_system_lifetime, 256 * 256) catch unreachable,
+        .shape_builder = HeightfieldShapeBuilder.create(create_ctx.heap_allocator, create_ctx.jobs.background),
+        .broad_phase_policy = .{ .max_bodies_between_optimizes = 16 },
         .contact_listener = undefined,
         .frame_contacts = std.ArrayList(config.events.CollisionContact).initCapacity(arena_system_lifetime, 8192) catch unreachable,
         .is_low = false,
@@ -297,9 +317,20 @@ pub fn create(create_ctx: SystemCreateCtx) void {
     // Low physics
     const update_ctx_low = create_ctx.arena_system_lifetime.create(SystemUpdateContext) catch unreachable;
     update_ctx_low.* = SystemUpdateContext.view(create_ctx);
+    const requester_id_low = world_patch_mgr.registerRequester(IdLocal.init("physics_low"));
     update_ctx_low.*.state = .{
-        .requester_id = world_patch_mgr.registerRequester(IdLocal.init("physics_low")),
+        .requester_id = requester_id_low,
+        .region_subscription = world_patch_mgr.subscribeRegion(.{
+            .requester_id = requester_id_low,
+            .patch_type_id = heightmap_patch_type_id,
+            .prio = .high,
+            .radius = 8 * 1024,
+            .lod_mask = 1 << config.lowest_lod,
+        }),
         .patches = std.ArrayList(Patch).initCapacity(arena_system_lifetime, 64 * 64) catch unreachable,
+        // The low world streams in a few thousand patches at once when the game starts.
+        .shape_builder = HeightfieldShapeBuilder.create(create_ctx.heap_allocator, create_ctx.jobs.background),
+        .broad_phase_policy = .{ .max_bodies_between_optimizes = 512 },
         .is_low = true,
     };
 
@@ -347,6 +378,7 @@ pub fn create(create_ctx: SystemCreateCtx) void {
 
 pub fn destroy(ctx_opaque: ?*anyopaque) callconv(.C) void {
     const ctx: *SystemUpdateContext = @ptrCast(@alignCast(ctx_opaque));
+    ctx.state.shape_builder.destroy();
 
     const query = ecs.query_init(ctx.ecsu_world.world, &.{
         .terms = [_]ecs.term_t{
@@ -446,9 +478,6 @@ fn updateLoaders(it: *ecs.iter_t) callconv(.C) void {
 
     const physics_world = if (ctx.state.is_low) ctx.physics_world_low else ctx.physics_world;
     const body_interface = physics_world.getBodyInterfaceMut();
-    var arena_state = std.heap.ArenaAllocator.init(ctx.arena_system_update);
-    defer arena_state.deinit();
-    const arena = arena_state.allocator();
 
     for (world_loaders, positions, it.entities()) |loader_comp, position, ent| {
         if (!loader_comp.physics) {
@@ -476,65 +505,23 @@ fn updateLoaders(it: *ecs.iter_t) callconv(.C) void {
             continue;
         }
 
-        var lookups_old = std.ArrayList(world_patch_manager.PatchLookup).initCapacity(arena, 1024) catch unreachable;
-        var lookups_new = std.ArrayList(world_patch_manager.PatchLookup).initCapacity(arena, 1024) catch unreachable;
+        const delta = ctx.world_patch_mgr.updateRegionSubscription(ctx.state.region_subscription, pos_new[0], pos_new[2]);
 
-        const area_width: f32 = if (ctx.state.is_low) (16 * 1024) else 1024;
-        const area_old = world_patch_manager.RequestRectangle{
-            .x = loader.pos_old[0] - area_width / 2,
-            .z = loader.pos_old[2] - area_width / 2,
-            .width = area_width,
-            .height = area_width,
-        };
-
-        const area_new = world_patch_manager.RequestRectangle{
-            .x = pos_new[0] - area_width / 2,
-            .z = pos_new[2] - area_width / 2,
-            .width = area_width,
-            .height = area_width,
-        };
-
-        const patch_lod: world_patch_manager.LoD = if (ctx.state.is_low) config.lowest_lod else 0;
-        const patch_type_id = ctx.world_patch_mgr.getPatchTypeId(IdLocal.init("heightmap"));
-        world_patch_manager.WorldPatchManager.getLookupsFromRectangle(patch_type_id, area_old, patch_lod, &lookups_old);
-        world_patch_manager.WorldPatchManager.getLookupsFromRectangle(patch_type_id, area_new, patch_lod, &lookups_new);
-
-        var i_old: u32 = 0;
-        blk: while (i_old < lookups_old.items.len) {
-            var i_new: u32 = 0;
-            while (i_new < lookups_new.items.len) {
-                if (lookups_old.items[i_old].eql(lookups_new.items[i_new])) {
-                    _ = lookups_old.swapRemove(i_old);
-                    _ = lookups_new.swapRemove(i_new);
-                    continue :blk;
-                }
-                i_new += 1;
-            }
-            i_old += 1;
-        }
-
-        // HACK
-        if (loader.pos_old[0] != -100000) {
-            ctx.world_patch_mgr.removeLoadRequestFromLookups(ctx.state.requester_id, lookups_old.items);
-
-            for (lookups_old.items) |lookup| {
-                for (ctx.state.patches.items, 0..) |*patch, i| {
-                    if (patch.lookup.eql(lookup)) {
-                        if (patch.body_opt != null) {
-                            body_interface.removeAndDestroyBody(patch.body_opt.?);
-                            patch.shape_opt.?.release();
-                        }
-
-                        _ = ctx.state.patches.swapRemove(i);
-                        break;
+        for (delta.exited) |lookup| {
+            for (ctx.state.patches.items, 0..) |*patch, i| {
+                if (patch.lookup.eql(lookup)) {
+                    if (patch.body_opt != null) {
+                        body_interface.removeAndDestroyBody(patch.body_opt.?);
+                        patch.shape_opt.?.release();
                     }
+
+                    _ = ctx.state.patches.swapRemove(i);
+                    break;
                 }
             }
         }
 
-        ctx.world_patch_mgr.addLoadRequestFromLookups(ctx.state.requester_id, lookups_new.items, .high);
-
-        for (lookups_new.items) |lookup| {
+        for (delta.entered) |lookup| {
             ctx.state.patches.appendAssumeCapacity(.{
                 .lookup = lookup,
             });
@@ -549,9 +536,41 @@ fn updatePatches(it: *ecs.iter_t) callconv(.C) void {
     const tracy_zone = ztracy.ZoneNC(@src(), if (ctx.state.is_low) "updatePatchesLow" else "updatePatches", 0x00_00_00_ff);
     defer tracy_zone.End();
 
+    const physics_world = if (ctx.state.is_low) ctx.physics_world_low else ctx.physics_world;
+    const shape_builder = ctx.state.shape_builder;
+
+    // Turn the finished shapes into bodies, all of them in one batch.
+    var finished: [HeightfieldShapeBuilder.max_shapes_in_flight]physics_heightfield_builder.ShapeBuildResult = undefined;
+    var finished_patches: [HeightfieldShapeBuilder.max_shapes_in_flight]*Patch = undefined;
+    var finished_count: u32 = 0;
+    while (shape_builder.popResult()) |result| {
+        const patch = findBuildingPatch(ctx.state.patches.items, result.lookup) orelse {
+            // Left the region while building.
+            result.shape.release();
+            continue;
+        };
+        finished[finished_count] = result;
+        finished_patches[finished_count] = patch;
+        finished_count += 1;
+    }
+
+    if (finished_count > 0) {
+        var body_ids: [HeightfieldShapeBuilder.max_shapes_in_flight]zphy.BodyId = undefined;
+        physics_heightfield_builder.addBodies(physics_world, finished[0..finished_count], &body_ids);
+        for (finished[0..finished_count], finished_patches[0..finished_count], body_ids[0..finished_count]) |result, patch, body_id| {
+            patch.shape_opt = result.shape;
+            patch.body_opt = body_id;
+            patch.shape_status = .built;
+        }
+        ctx.state.broad_phase_policy.onBodiesAdded(finished_count);
+    }
+
+    // Hand loaded patches to the workers, as many as they'll take.
+    const lod_scale: f32 = if (ctx.state.is_low) config.largest_patch_width else config.patch_size;
+    const scale: f32 = (lod_scale) / config.patch_size;
+    var is_waiting = false;
     for (ctx.state.patches.items) |*patch| {
-        if (patch.body_opt) |body| {
-            _ = body;
+        if (patch.shape_status != .waiting) {
             continue;
         }
 
@@ -563,56 +582,29 @@ fn updatePatches(it: *ecs.iter_t) callconv(.C) void {
             continue;
         }
 
-        const patch_info = ctx.world_patch_mgr.tryGetPatch(patch.lookup, patch_types.Heightmap);
+        is_waiting = true;
+        if (shape_builder.isFull()) {
+            break;
+        }
 
+        const patch_info = ctx.world_patch_mgr.tryGetPatch(patch.lookup, patch_types.Heightmap);
         if (patch_info.data_opt) |data| {
-            const tracy_zone2 = ztracy.ZoneNC(@src(), "patch", 0x00_00_00_ff);
-            defer tracy_zone2.End();
-            const world_pos = patch.lookup.getWorldPos();
-
-            //  TODO: Use mesh (why though?)
-            const height_field_size = config.patch_resolution;
-            var samples: [height_field_size * height_field_size]f32 = undefined;
-
-            const width = @as(u32, @intCast(config.patch_resolution));
-            for (0..width) |z| {
-                for (0..width) |x| {
-                    const index = @as(u32, @intCast(x + z * config.patch_resolution));
-                    const height = data.heightmap[index];
-                    const sample = &samples[x + z * width];
-                    sample.* = height;
-                }
-            }
+            const enqueued = shape_builder.enqueue(patch.lookup, data, scale);
+            std.debug.assert(enqueued);
+            patch.shape_status = .building;
+        }
+    }
 
-            const lod_scale: f32 = if (ctx.state.is_low) config.largest_patch_width else config.patch_size;
-            const scale: f32 = (lod_scale) / config.patch_size;
-            var shape_settings = zphy.HeightFieldShapeSettings.create(&samples, height_field_size) catch unreachable;
-            shape_settings.setScale(.{ scale, 1, scale });
-            defer shape_settings.release();
-            const shape = shape_settings.createShape() catch unreachable;
-
-            const physics_world = if (ctx.state.is_low) ctx.physics_world_low else ctx.physics_world;
-            const body_interface = physics_world.getBodyInterfaceMut();
-            const body_id = body_interface.createAndAddBody(.{
-                .position = .{ @as(f32, @floatFromInt(world_pos.world_x)), 0, @as(f32, @floatFromInt(world_pos.world_z)), 1.0 },
-                .rotation = .{ 0.0, 0.0, 0.0, 1.0 },
-                .shape = shape,
-                .motion_type = .static,
-                .object_layer = object_layers.non_moving,
-                .user_data = 0,
-            }, .activate) catch unreachable;
-
-            physics_world.optimizeBroadPhase();
-
-            patch.shape_opt = shape;
-            patch.body_opt = body_id;
+    ctx.state.broad_phase_policy.update(physics_world, is_waiting or shape_builder.shapes_in_flight > 0);
+}
 
-            if (!ctx.state.is_low) {
-                // Only one per frame
-                break;
-            }
+fn findBuildingPatch(patches: []Patch, lookup: world_patch_manager.PatchLookup) ?*Patch {
+    for (patches) |*patch| {
+        if (patch.shape_status == .building and patch.lookup.eql(lookup)) {
+            return patch;
         }
     }
+    return null;
 }
 
 //  ██████╗ █████╗ ██╗     ██╗     ██████╗  █████╗  ██████╗██╗  ██╗███████╗
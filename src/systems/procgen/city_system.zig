@@ -108,7 +108,9 @@ pub fn createEntities(allocator: std.mem.Allocator, ecsu_world: ecsu.World, asse
     const desc: ecs.script_eval_desc_t = .{ .vars = vars };
 
     // Cities from cities.txt
-    const cities_data = asset_mgr.loadAssetBlocking(IdLocal.init("content/systems/cities.txt"), .instant_blocking);
+    const cities_id = IdLocal.init("content/systems/cities.txt");
+    const cities_data = asset_mgr.loadAssetBlocking(cities_id, .instant_blocking);
+    defer asset_mgr.releaseAsset(cities_id);
 
     var buf_reader = std.io.fixedBufferStream(cities_data);
     var in_stream = buf_reader.reader();
@@ -144,8 +146,10 @@ pub fn createEntities(allocator: std.mem.Allocator, ecsu_world: ecsu.World, asse
             var buf2: [256]u8 = undefined;
             const filepath = std.fmt.bufPrintZ(&buf2, "content/settlements/{s}.flecs", .{settlement_name}) catch unreachable;
 
-            const script_code = asset_mgr.loadAssetBlocking(IdLocal.init(filepath), .instant_blocking);
+            const script_id = IdLocal.init(filepath);
+            const script_code = asset_mgr.loadAssetBlocking(script_id, .instant_blocking);
             const script = ecs.script_parse(ecsu_world.world, "settlement", @ptrCast(script_code), null).?;
+            asset_mgr.releaseAsset(script_id);
             const res = ecs.script_eval(script, &desc);
             std.debug.assert(res == 0);
 
@@ -10,6 +10,7 @@ const im3d = @import("im3d");
 const input = @import("../input.zig");
 const PrefabManager = @import("../prefab_manager.zig").PrefabManager;
 const PSOManager = @import("../renderer/pso.zig").PSOManager;
+const RangeAllocator = @import("../core/range_allocator.zig").RangeAllocator;
 const renderer = @import("../renderer/renderer.zig");
 const renderer_types = @import("../renderer/types.zig");
 const zforge = @import("zforge");
@@ -55,7 +56,6 @@ pub const SystemUpdateContext = struct {
         // static_entities: std.ArrayList(renderer_types.RenderableEntity),
 
         query_dynamic_entities: *ecs.query_t,
-        dynamic_entities: std.ArrayList(renderer_types.DynamicEntity),
 
         query_ui_images: *ecs.query_t,
         ui_images: std.ArrayList(renderer_types.UiImage),
@@ -66,9 +66,16 @@ pub const SystemUpdateContext = struct {
         query_scripts: *ecs.query_t,
 
         added_static_entities: std.ArrayList(renderer_types.RenderableEntity) = undefined,
-        removed_static_entities: std.ArrayList(renderer_types.RenderableEntityId) = undefined,
+        removed_static_instances: std.ArrayList(RangeAllocator.Allocation) = undefined,
+        added_dynamic_entities: std.ArrayList(renderer_types.DynamicEntity) = undefined,
+        removed_dynamic_instances: std.ArrayList(u32) = undefined,
+        // Slots whose StaticInstance or DynamicInstance set is still deferred, so a second OnSet
+        // or an OnRemove in the same frame finds them.
+        pending_static_instances: std.AutoHashMap(ecs.entity_t, RangeAllocator.Allocation) = undefined,
+        pending_dynamic_instances: std.AutoHashMap(ecs.entity_t, u32) = undefined,
 
         monitor_ent: ecs.entity_t = undefined,
+        dynamic_monitor_ent: ecs.entity_t = undefined,
     },
 };
 
@@ -101,13 +108,14 @@ pub fn create(create_ctx: SystemCreateCtx) void {
         } ++ ecs.array(ecs.term_t, ecs.FLECS_TERM_COUNT_MAX - 2),
     }) catch unreachable;
 
+    // Cached, for change detection.
     const query_dynamic_entities = ecs.query_init(ecsu_world.world, &.{
         .entity = ecs.new_entity(ecsu_world.world, "query_dynamic_entities"),
         .terms = [_]ecs.term_t{
-            .{ .id = ecs.id(fd.LodGroup), .inout = .In },
             .{ .id = ecs.id(fd.Transform), .inout = .In },
-            .{ .id = ecs.id(fd.Scale), .inout = .In },
-        } ++ ecs.array(ecs.term_t, ecs.FLECS_TERM_COUNT_MAX - 3),
+            .{ .id = ecs.id(fd.DynamicInstance), .inout = .In },
+        } ++ ecs.array(ecs.term_t, ecs.FLECS_TERM_COUNT_MAX - 2),
+        .cache_kind = .Auto,
     }) catch unreachable;
 
     const query_ui_images = ecs.query_init(ecsu_world.world, &.{
@@ -143,13 +151,16 @@ pub fn create(create_ctx: SystemCreateCtx) void {
         .query_static_entities = query_static_entities,
         // .static_entities = std.ArrayList(renderer_types.RenderableEntity).init(pass_allocator),
         .query_dynamic_entities = query_dynamic_entities,
-        .dynamic_entities = std.ArrayList(renderer_types.DynamicEntity).init(pass_allocator),
         .query_ui_images = query_ui_images,
         .query_ui_texts = query_ui_texts,
         .ui_images = std.ArrayList(renderer_types.UiImage).init(pass_allocator),
         .ui_texts = std.ArrayList(renderer_types.UiText).init(pass_allocator),
         .added_static_entities = std.ArrayList(renderer_types.RenderableEntity).init(pass_allocator),
-        .removed_static_entities = std.ArrayList(renderer_types.RenderableEntityId).init(pass_allocator),
+        .removed_static_instances = std.ArrayList(RangeAllocator.Allocation).init(pass_allocator),
+        .added_dynamic_entities = std.ArrayList(renderer_types.DynamicEntity).init(pass_allocator),
+        .removed_dynamic_instances = std.ArrayList(u32).init(pass_allocator),
+        .pending_static_instances = std.AutoHashMap(ecs.entity_t, RangeAllocator.Allocation).init(pass_allocator),
+        .pending_dynamic_instances = std.AutoHashMap(ecs.entity_t, u32).init(pass_allocator),
     };
 
     const observer_desc: ecs.observer_desc_t = .{
@@ -166,6 +177,18 @@ pub fn create(create_ctx: SystemCreateCtx) void {
     };
     update_ctx.*.state.monitor_ent = ecs.observer_init(ecsu_world.world, &observer_desc);
 
+    const dynamic_observer_desc: ecs.observer_desc_t = .{
+        .query = .{
+            .terms = [_]ecs.term_t{
+                .{ .id = ecs.id(fd.LodGroup), .inout = .In },
+            } ++ ecs.array(ecs.term_t, ecs.FLECS_TERM_COUNT_MAX - 1),
+        },
+        .events = [_]ecs.entity_t{ ecs.OnSet, ecs.OnRemove, 0, 0, 0, 0, 0, 0 },
+        .callback = onMonitorLodGroup,
+        .ctx = update_ctx,
+    };
+    update_ctx.*.state.dynamic_monitor_ent = ecs.observer_init(ecsu_world.world, &dynamic_observer_desc);
+
     {
         var system_desc = ecs.system_desc_t{};
         system_desc.callback = preUpdate;
@@ -196,9 +219,12 @@ pub fn destroy(ctx: ?*anyopaque) callconv(.C) void {
     const system: *SystemUpdateContext = @ptrCast(@alignCast(ctx));
 
     system.ecsu_world.delete(system.state.monitor_ent);
+    system.ecsu_world.delete(system.state.dynamic_monitor_ent);
 
     system.state.point_lights.deinit();
     system.state.ocean_tiles.deinit();
+    system.state.pending_static_instances.deinit();
+    system.state.pending_dynamic_instances.deinit();
     // system.state.static_entities.deinit();
 }
 
@@ -397,39 +423,45 @@ fn postUpdate(it: *ecs.iter_t) callconv(.C) void {
 
     // Find all static entity changes
     update_desc.added_static_entities = std.ArrayList(renderer_types.RenderableEntity).initCapacity(system.arena_system_update, system.state.added_static_entities.items.len) catch unreachable;
-    update_desc.removed_static_entities = std.ArrayList(renderer_types.RenderableEntityId).initCapacity(system.arena_system_update, system.state.removed_static_entities.items.len) catch unreachable;
+    update_desc.removed_static_instances = std.ArrayList(RangeAllocator.Allocation).initCapacity(system.arena_system_update, system.state.removed_static_instances.items.len) catch unreachable;
     update_desc.added_static_entities.appendSliceAssumeCapacity(system.state.added_static_entities.items);
-    update_desc.removed_static_entities.appendSliceAssumeCapacity(system.state.removed_static_entities.items);
+    update_desc.removed_static_instances.appendSliceAssumeCapacity(system.state.removed_static_instances.items);
     system.state.added_static_entities.clearRetainingCapacity();
-    system.state.removed_static_entities.clearRetainingCapacity();
-
-    // Find all dynamic entities
+    system.state.removed_static_instances.clearRetainingCapacity();
+    system.state.pending_static_instances.clearRetainingCapacity();
+
+    // Find all dynamic entity changes
+    update_desc.added_dynamic_entities = std.ArrayList(renderer_types.DynamicEntity).initCapacity(system.arena_system_update, system.state.added_dynamic_entities.items.len) catch unreachable;
+    update_desc.removed_dynamic_instances = std.ArrayList(u32).initCapacity(system.arena_system_update, system.state.removed_dynamic_instances.items.len) catch unreachable;
+    update_desc.added_dynamic_entities.appendSliceAssumeCapacity(system.state.added_dynamic_entities.items);
+    update_desc.removed_dynamic_instances.appendSliceAssumeCapacity(system.state.removed_dynamic_instances.items);
+    system.state.added_dynamic_entities.clearRetainingCapacity();
+    system.state.removed_dynamic_instances.clearRetainingCapacity();
+    system.state.pending_dynamic_instances.clearRetainingCapacity();
+
+    // Only tables where the transform hierarchy moved something since last frame are sent again.
+    // The renderer skips the instances in them that didn't actually move.
     {
-        system.state.dynamic_entities.clearRetainingCapacity();
+        update_desc.moved_dynamic_instances = std.ArrayList(renderer_types.DynamicInstanceTransform).init(system.arena_system_update);
 
         var iter = ecs.query_iter(system.ecsu_world.world, system.state.query_dynamic_entities);
         while (ecs.query_next(&iter)) {
-            const lod_groups = ecs.field(&iter, fd.LodGroup, 0).?;
-            const transforms = ecs.field(&iter, fd.Transform, 1).?;
-            const scales = ecs.field(&iter, fd.Scale, 2).?;
+            if (!ecs.iter_changed(&iter)) {
+                continue;
+            }
 
-            for (lod_groups, transforms, scales) |*lod_group_component, transform, scale| {
+            const transforms = ecs.field(&iter, fd.Transform, 0).?;
+            const dynamic_instances = ecs.field(&iter, fd.DynamicInstance, 1).?;
+            for (transforms, dynamic_instances) |transform, dynamic_instance| {
                 var world: [16]f32 = undefined;
                 storeMat44(transform.matrix[0..], world[0..]);
 
-                var dynamic_entity = renderer_types.DynamicEntity{
+                update_desc.moved_dynamic_instances.append(.{
+                    .instance_slot = dynamic_instance.slot,
                     .world = zm.loadMat(world[0..]),
-                    .position = transform.getPos00(),
-                    .lod_count = lod_group_component.lod_count,
-                    .scale = @max(scale.x, @max(scale.y, scale.z)),
-                };
-                @memcpy(&dynamic_entity.lods, &lod_group_component.lods);
-
-                system.state.dynamic_entities.append(dynamic_entity) catch unreachable;
+                }) catch unreachable;
             }
         }
-
-        update_desc.dynamic_entities = &system.state.dynamic_entities;
     }
 
     // Find all UI Images
@@ -536,8 +568,23 @@ fn onMonitorRenderable(it: *ecs.iter_t) callconv(.C) void {
             var world: [16]f32 = undefined;
             storeMat44(transform.matrix[0..], world[0..]);
 
+            // Setting it again only updates the instance in place.
+            const slot = blk: {
+                if (ecs.has_id(it.world, entity, ecs.id(fd.StaticInstance))) {
+                    break :blk ecs.get(it.world, entity, fd.StaticInstance).?.slot;
+                }
+                if (ctx.state.pending_static_instances.get(entity)) |pending_slot| {
+                    break :blk pending_slot;
+                }
+
+                const new_slot = ctx.renderer.static_geometry_pass.allocateInstance();
+                ctx.state.pending_static_instances.put(entity, new_slot) catch unreachable;
+                _ = ecs.set(it.world, entity, fd.StaticInstance, .{ .slot = new_slot });
+                break :blk new_slot;
+            };
+
             const renderable_entity: renderer_types.RenderableEntity = .{
-                .entity_id = entity,
+                .instance_index = slot.offset,
                 .renderable_id = renderable.id,
                 .world = zm.loadMat(&world),
                 .draw_bounds = renderable.draw_bounds,
@@ -546,7 +593,66 @@ fn onMonitorRenderable(it: *ecs.iter_t) callconv(.C) void {
         }
     } else if (it.event == ecs.OnRemove) {
         for (it.entities()) |entity| {
-            ctx.state.removed_static_entities.append(entity) catch unreachable;
+            if (ecs.get(it.world, entity, fd.StaticInstance)) |static_instance| {
+                ctx.state.removed_static_instances.append(static_instance.slot) catch unreachable;
+                ecs.remove(it.world, entity, fd.StaticInstance);
+            } else if (ctx.state.pending_static_instances.fetchRemove(entity)) |pending| {
+                ctx.state.removed_static_instances.append(pending.value) catch unreachable;
+                ecs.remove(it.world, entity, fd.StaticInstance);
+            }
+        }
+    }
+}
+
+fn onMonitorLodGroup(it: *ecs.iter_t) callconv(.C) void {
+    const tracy_zone = ztracy.ZoneNC(@src(), "onMonitorLodGroup", 0x00_00_00_ff);
+    defer tracy_zone.End();
+    const ctx: *SystemUpdateContext = @alignCast(@ptrCast(it.ctx.?));
+
+    // NOTE: LodGroups usually come from a prefab, so they're read per entity.
+    if (it.event == ecs.OnSet) {
+        for (it.entities()) |entity| {
+            const lod_group = ecs.get(it.world, entity, fd.LodGroup).?;
+
+            // Setting it again only swaps the instance's model.
+            const slot = blk: {
+                if (ecs.has_id(it.world, entity, ecs.id(fd.DynamicInstance))) {
+                    break :blk ecs.get(it.world, entity, fd.DynamicInstance).?.slot;
+                }
+                if (ctx.state.pending_dynamic_instances.get(entity)) |pending_slot| {
+                    break :blk pending_slot;
+                }
+
+                const new_slot = ctx.renderer.dynamic_geometry_pass.allocateInstance();
+                ctx.state.pending_dynamic_instances.put(entity, new_slot) catch unreachable;
+                _ = ecs.set(it.world, entity, fd.DynamicInstance, .{ .slot = new_slot });
+                break :blk new_slot;
+            };
+
+            var world: [16]f32 = undefined;
+            if (ecs.get(it.world, entity, fd.Transform)) |transform| {
+                storeMat44(transform.matrix[0..], world[0..]);
+            } else {
+                zm.storeMat(&world, zm.identity());
+            }
+
+            var dynamic_entity = renderer_types.DynamicEntity{
+                .instance_slot = slot,
+                .world = zm.loadMat(&world),
+                .lod_count = lod_group.lod_count,
+            };
+            @memcpy(&dynamic_entity.lods, &lod_group.lods);
+            ctx.state.added_dynamic_entities.append(dynamic_entity) catch unreachable;
+        }
+    } else if (it.event == ecs.OnRemove) {
+        for (it.entities()) |entity| {
+            if (ecs.get(it.world, entity, fd.DynamicInstance)) |dynamic_instance| {
+                ctx.state.removed_dynamic_instances.append(dynamic_instance.slot) catch unreachable;
+                ecs.remove(it.world, entity, fd.DynamicInstance);
+            } else if (ctx.state.pending_dynamic_instances.fetchRemove(entity)) |pending| {
+                ctx.state.removed_dynamic_instances.append(pending.value) catch unreachable;
+                ecs.remove(it.world, entity, fd.DynamicInstance);
+            }
         }
     }
 }
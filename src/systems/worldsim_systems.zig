@@ -15,28 +15,67 @@ const input = @import("../input.zig");
 // const config = @import("../config/config.zig");
 // const renderer = @import("../renderer/renderer.zig");
 const context = @import("../core/context.zig");
+const SpatialHashGrid = @import("../core/spatial_hash_grid.zig").SpatialHashGrid;
 
 pub const SystemCreateCtx = struct {
     pub usingnamespace context.CONTEXTIFY(@This());
     arena_system_lifetime: std.mem.Allocator,
     ecsu_world: ecsu.World,
     input_frame_data: *input.FrameData,
+    enemy_grid: *SpatialHashGrid(ecs.entity_t),
 };
 
 const SystemUpdateContext = struct {
     pub usingnamespace context.CONTEXTIFY(@This());
     ecsu_world: ecsu.World,
     input_frame_data: *input.FrameData,
+    enemy_grid: *SpatialHashGrid(ecs.entity_t),
     state: struct {
         //     switch_pressed: bool = false,
         //     active_index: u32 = 1,
+        query_enemies: *ecs.query_t,
     },
 };
 
 pub fn create(create_ctx: SystemCreateCtx) void {
     const update_ctx = create_ctx.arena_system_lifetime.create(SystemUpdateContext) catch unreachable;
     update_ctx.* = SystemUpdateContext.view(create_ctx);
-    update_ctx.*.state = .{};
+    const query_enemies = ecs.query_init(create_ctx.ecsu_world.world, &.{
+        .entity = ecs.new_entity(create_ctx.ecsu_world.world, "query_enemies"),
+        .terms = [_]ecs.term_t{
+            .{ .id = ecs.id(fd.SettlementEnemy), .inout = .InOutNone },
+            .{ .id = ecs.id(fd.Position), .inout = .In },
+        } ++ ecs.array(ecs.term_t, ecs.FLECS_TERM_COUNT_MAX - 2),
+        .cache_kind = .Auto,
+    }) catch unreachable;
+    update_ctx.*.state = .{ .query_enemies = query_enemies };
+
+    // Keeps the shared enemy grid up to date. In PreUpdate so that the OnUpdate systems reading
+    // it, like the fps camera's slime count, see this frame's enemies.
+    {
+        var system_desc = ecs.system_desc_t{};
+        system_desc.callback = updateEnemyGrid;
+        system_desc.ctx = update_ctx;
+        _ = ecs.SYSTEM(
+            create_ctx.ecsu_world.world,
+            "updateEnemyGrid",
+            ecs.PreUpdate,
+            &system_desc,
+        );
+    }
+
+    const observer_desc: ecs.observer_desc_t = .{
+        .query = .{
+            .terms = [_]ecs.term_t{
+                .{ .id = ecs.id(fd.SettlementEnemy), .inout = .InOutNone },
+                .{ .id = ecs.id(fd.Position), .inout = .In },
+            } ++ ecs.array(ecs.term_t, ecs.FLECS_TERM_COUNT_MAX - 2),
+        },
+        .events = [_]ecs.entity_t{ ecs.OnRemove, 0, 0, 0, 0, 0, 0, 0 },
+        .callback = onRemoveEnemy,
+        .ctx = update_ctx,
+    };
+    _ = ecs.observer_init(create_ctx.ecsu_world.world, &observer_desc);
 
     _ = ecsu.registerSystem(create_ctx.ecsu_world.world, "settlementGrowth", settlementGrowth, update_ctx, &[_]ecs.term_t{
         .{ .id = ecs.id(fd.Script), .inout = .In },
@@ -45,6 +84,31 @@ pub fn create(create_ctx: SystemCreateCtx) void {
     });
 }
 
+// Only tables whose positions were written to since last frame are visited, and the grid only
+// touches its cells for the enemies that left theirs.
+fn updateEnemyGrid(it: *ecs.iter_t) callconv(.C) void {
+    const ctx: *SystemUpdateContext = @alignCast(@ptrCast(it.ctx.?));
+    var iter = ecs.query_iter(ctx.ecsu_world.world, ctx.state.query_enemies);
+    while (ecs.query_next(&iter)) {
+        if (!ecs.iter_changed(&iter)) {
+            continue;
+        }
+
+        const positions = ecs.field(&iter, fd.Position, 1).?;
+        for (positions, iter.entities()) |position, ent| {
+            ctx.enemy_grid.insertOrUpdate(ent, position.x, position.z);
+        }
+    }
+}
+
+// Observer callback, enemies that die or stop being enemies.
+fn onRemoveEnemy(it: *ecs.iter_t) callconv(.C) void {
+    const ctx: *SystemUpdateContext = @alignCast(@ptrCast(it.ctx.?));
+    for (it.entities()) |ent| {
+        _ = ctx.enemy_grid.remove(ent);
+    }
+}
+
 fn settlementGrowth(it: *ecs.iter_t) callconv(.C) void {
     const ctx: *SystemUpdateContext = @alignCast(@ptrCast(it.ctx.?));
     const environment_info = ctx.ecsu_world.getSingletonMut(fd.EnvironmentInfo).?;
@@ -56,21 +120,7 @@ fn settlementGrowth(it: *ecs.iter_t) callconv(.C) void {
     const DIST_TO_ENEMY = 15000;
 
     for (scripts, settlements, positions) |script, *settlement, position| {
-        const z_position = position.asZM();
-        var it_inner = ecs.each(ctx.ecsu_world.world, fd.SettlementEnemy);
-        const has_nearby_enemy: bool = blk: {
-            while (ecs.each_next(&it_inner)) {
-                for (it_inner.entities()) |ent_enemy| {
-                    const position_enemy = ecs.get(ctx.ecsu_world.world, ent_enemy, fd.Position).?;
-                    const z_position_enemy = position_enemy.asZM();
-
-                    if (zm.lengthSq3(z_position - z_position_enemy)[0] < DIST_TO_ENEMY * DIST_TO_ENEMY) {
-                        break :blk true;
-                    }
-                }
-            }
-            break :blk false;
-        };
+        const has_nearby_enemy = ctx.enemy_grid.anyWithinRadius(position.x, position.z, DIST_TO_ENEMY);
 
         if (has_nearby_enemy and settlement.level >= 30) {
             settlement.safety = environment_info.world_time + 100;
@@ -0,0 +1,293 @@
+const std = @import("std");
+const mapped_file = @import("mapped_file");
+
+// ██████╗  █████╗  ██████╗██╗  ██╗
+// ██╔══██╗██╔══██╗██╔════╝██║ ██╔╝
+// ██████╔╝███████║██║     █████╔╝
+// ██╔═══╝ ██╔══██║██║     ██╔═██╗
+// ██║     ██║  ██║╚██████╗██║  ██╗
+// ╚═╝     ╚═╝  ╚═╝ ╚═════╝╚═╝  ╚═╝
+
+// One archive per patch type and LoD, e.g. content/patch/heightmap/lod0/heightmap.patchpack
+//
+// [PatchArchiveHeader]
+// [PatchArchiveEntry] * entry_count, sorted by key()
+// payloads, each one the same bytes the loose patch file would contain
+//
+// Payloads start on a payload_alignment boundary, those of a page or more on a page boundary.
+// Small patches are packed so a page holds several of them instead of mostly padding.
+//
+// NOTE: Only imports std and mapped_file, the simulator builds this file as its own module to
+// write archives.
+
+pub const archive_magic = "TPAK".*;
+pub const archive_version = 1;
+pub const archive_page_size = 4096;
+pub const payload_alignment = 16;
+
+pub const PatchArchiveHeader = extern struct {
+    magic: [4]u8 = archive_magic,
+    version: u32 = archive_version,
+    entry_count: u32,
+    page_size: u32 = archive_page_size,
+};
+
+pub const PatchArchiveEntry = extern struct {
+    patch_x: u16,
+    patch_z: u16,
+    size: u32,
+    offset: u64,
+
+    pub fn key(self: PatchArchiveEntry) u32 {
+        return makeKey(self.patch_x, self.patch_z);
+    }
+
+    fn lessThan(_: void, lhs: PatchArchiveEntry, rhs: PatchArchiveEntry) bool {
+        return lhs.key() < rhs.key();
+    }
+};
+
+// Row major so that neighbouring patches on the same row end up next to each other on disk.
+fn makeKey(patch_x: u32, patch_z: u32) u32 {
+    return (patch_z << 16) | patch_x;
+}
+
+fn payloadAlignment(size: u64) u64 {
+    return if (size >= archive_page_size) archive_page_size else payload_alignment;
+}
+
+pub fn getArchivePath(buf: []u8, patch_type_name: []const u8, lod: u32) [:0]const u8 {
+    return std.fmt.bufPrintZ(buf, "content/patch/{s}/lod{}/{s}.patchpack", .{ patch_type_name, lod, patch_type_name }) catch unreachable;
+}
+
+// ██████╗ ███████╗ █████╗ ██████╗ ███████╗██████╗
+// ██╔══██╗██╔════╝██╔══██╗██╔══██╗██╔════╝██╔══██╗
+// ██████╔╝█████╗  ███████║██║  ██║█████╗  ██████╔╝
+// ██╔══██╗██╔══╝  ██╔══██║██║  ██║██╔══╝  ██╔══██╗
+// ██║  ██║███████╗██║  ██║██████╔╝███████╗██║  ██║
+// ╚═╝  ╚═╝╚══════╝╚═╝  ╚═╝╚═════╝ ╚══════╝╚═╝  ╚═╝
+
+// Read-only memory mapped archive. find() hands out slices straight into the mapping,
+// so they stay valid until close() and must not be freed. Safe to use from several threads.
+// open() validates the whole index, a truncated or corrupt archive is rejected rather than read.
+pub const PatchArchive = struct {
+    mapping: []align(std.heap.page_size_min) const u8,
+    entries: []const PatchArchiveEntry,
+
+    pub fn open(path: []const u8) ?PatchArchive {
+        const file = std.fs.cwd().openFile(path, .{ .mode = .read_only }) catch return null;
+        defer file.close();
+
+        const file_size = file.getEndPos() catch return null;
+        if (file_size < @sizeOf(PatchArchiveHeader)) {
+            return null;
+        }
+
+        const mapping = mapped_file.mapFile(file, file_size) orelse return null;
+        const entries = validate(mapping) orelse {
+            std.log.warn("Ignoring invalid patch archive {s}", .{path});
+            mapped_file.unmapFile(mapping);
+            return null;
+        };
+        return PatchArchive{
+            .mapping = mapping,
+            .entries = entries,
+        };
+    }
+
+    fn validate(mapping: []align(std.heap.page_size_min) const u8) ?[]const PatchArchiveEntry {
+        if (mapping.len < @sizeOf(PatchArchiveHeader)) {
+            return null;
+        }
+        const header = std.mem.bytesToValue(PatchArchiveHeader, mapping[0..@sizeOf(PatchArchiveHeader)]);
+        if (!std.mem.eql(u8, &header.magic, &archive_magic) or header.version != archive_version) {
+            return null;
+        }
+
+        const entries_end = @sizeOf(PatchArchiveHeader) + @as(u64, header.entry_count) * @sizeOf(PatchArchiveEntry);
+        if (entries_end > mapping.len) {
+            return null;
+        }
+
+        const entries: []const PatchArchiveEntry = @alignCast(std.mem.bytesAsSlice(PatchArchiveEntry, mapping[@sizeOf(PatchArchiveHeader)..entries_end]));
+        for (entries, 0..) |entry, i_entry| {
+            // NOTE: Compared without adding offset and size, they come from the file and may overflow
+            if (entry.offset < entries_end or entry.offset > mapping.len or entry.size > mapping.len - entry.offset) {
+                return null;
+            }
+            if (entry.offset % payload_alignment != 0) {
+                return null; // Loaders cast payloads to aligned slices
+            }
+            if (i_entry > 0 and entries[i_entry - 1].key() >= entry.key()) {
+                return null; // find() relies on the order
+            }
+        }
+        return entries;
+    }
+
+    pub fn close(self: *PatchArchive) void {
+        mapped_file.unmapFile(self.mapping);
+        self.* = undefined;
+    }
+
+    pub fn find(self: PatchArchive, patch_x: u32, patch_z: u32) ?[]const u8 {
+        const key = makeKey(patch_x, patch_z);
+        var low: usize = 0;
+        var high: usize = self.entries.len;
+        while (low < high) {
+            const mid = low + (high - low) / 2;
+            const mid_key = self.entries[mid].key();
+            if (mid_key == key) {
+                // Bounds were checked by open()
+                const entry = self.entries[mid];
+                return self.mapping[@intCast(entry.offset)..@intCast(entry.offset + entry.size)];
+            }
+            if (mid_key < key) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return null;
+    }
+};
+
+// ██╗    ██╗██████╗ ██╗████████╗███████╗██████╗
+// ██║    ██║██╔══██╗██║╚══██╔══╝██╔════╝██╔══██╗
+// ██║ █╗ ██║██████╔╝██║   ██║   █████╗  ██████╔╝
+// ██║███╗██║██╔══██╗██║   ██║   ██╔══╝  ██╔══██╗
+// ╚███╔███╔╝██║  ██║██║   ██║   ███████╗██║  ██║
+//  ╚══╝╚══╝ ╚═╝  ╚═╝╚═╝   ╚═╝   ╚══════╝╚═╝  ╚═╝
+
+// Collects patch payloads in any order and writes them out as one sorted archive.
+pub const PatchArchiveWriter = struct {
+    allocator: std.mem.Allocator,
+    entries: std.ArrayList(PatchArchiveEntry),
+    payloads: std.ArrayList(u8),
+
+    pub fn create(allocator: std.mem.Allocator) PatchArchiveWriter {
+        return .{
+            .allocator = allocator,
+            .entries = std.ArrayList(PatchArchiveEntry).init(allocator),
+            .payloads = std.ArrayList(u8).init(allocator),
+        };
+    }
+
+    pub fn destroy(self: *PatchArchiveWriter) void {
+        self.entries.deinit();
+        self.payloads.deinit();
+    }
+
+    pub fn addPatch(self: *PatchArchiveWriter, patch_x: u32, patch_z: u32, payload: []const u8) void {
+        // Offset is relative to the payload blob until write() lays out the file.
+        self.entries.append(.{
+            .patch_x = @intCast(patch_x),
+            .patch_z = @intCast(patch_z),
+            .size = @intCast(payload.len),
+            .offset = self.payloads.items.len,
+        }) catch unreachable;
+        self.payloads.appendSlice(payload) catch unreachable;
+    }
+
+    pub fn write(self: *PatchArchiveWriter, path: []const u8) !void {
+        std.mem.sort(PatchArchiveEntry, self.entries.items, {}, PatchArchiveEntry.lessThan);
+
+        const file = try std.fs.cwd().createFile(path, .{});
+        defer file.close();
+        var buffered_writer = std.io.bufferedWriter(file.writer());
+        const writer = buffered_writer.writer();
+
+        const header = PatchArchiveHeader{ .entry_count = @intCast(self.entries.items.len) };
+        try writer.writeStruct(header);
+
+        const index_end = @sizeOf(PatchArchiveHeader) + self.entries.items.len * @sizeOf(PatchArchiveEntry);
+        var file_offset: u64 = index_end;
+        for (self.entries.items) |entry| {
+            var file_entry = entry;
+            file_entry.offset = std.mem.alignForward(u64, file_offset, payloadAlignment(entry.size));
+            try writer.writeStruct(file_entry);
+            file_offset = file_entry.offset + entry.size;
+        }
+
+        var written: u64 = index_end;
+        for (self.entries.items) |entry| {
+            const aligned = std.mem.alignForward(u64, written, payloadAlignment(entry.size));
+            try writer.writeByteNTimes(0, aligned - written);
+            try writer.writeAll(self.payloads.items[entry.offset .. entry.offset + entry.size]);
+            written = aligned + entry.size;
+        }
+
+        try buffered_writer.flush();
+    }
+};
+
+test "patch_archive" {
+    var tmp_dir = std.testing.tmpDir(.{});
+    defer tmp_dir.cleanup();
+
+    var path_buf: [std.fs.max_path_bytes]u8 = undefined;
+    const dir_path = try tmp_dir.dir.realpath(".", &path_buf);
+    var archive_path_buf: [std.fs.max_path_bytes]u8 = undefined;
+    const archive_path = try std.fmt.bufPrint(&archive_path_buf, "{s}/test.patchpack", .{dir_path});
+
+    var writer = PatchArchiveWriter.create(std.testing.allocator);
+    defer writer.destroy();
+    writer.addPatch(3, 1, "three one");
+    writer.addPatch(0, 0, "origin");
+    writer.addPatch(1, 3, "one three");
+    const big_payload = [_]u8{7} ** (archive_page_size + 1);
+    writer.addPatch(2, 2, &big_payload);
+    try writer.write(archive_path);
+
+    var archive = PatchArchive.open(archive_path).?;
+    defer archive.close();
+    try std.testing.expectEqualStrings("origin", archive.find(0, 0).?);
+    try std.testing.expectEqualStrings("three one", archive.find(3, 1).?);
+    try std.testing.expectEqualStrings("one three", archive.find(1, 3).?);
+    try std.testing.expectEqualSlices(u8, &big_payload, archive.find(2, 2).?);
+    try std.testing.expect(archive.find(1, 1) == null);
+    try std.testing.expect(@intFromPtr(archive.find(3, 1).?.ptr) % payload_alignment == 0);
+    try std.testing.expect(@intFromPtr(archive.find(2, 2).?.ptr) % archive_page_size == 0);
+
+    // The small payloads share the first page with the index
+    try std.testing.expect(@intFromPtr(archive.find(1, 3).?.ptr) - @intFromPtr(archive.mapping.ptr) < archive_page_size);
+}
+
+test "patch_archive rejects corrupt archives" {
+    var tmp_dir = std.testing.tmpDir(.{});
+    defer tmp_dir.cleanup();
+
+    var path_buf: [std.fs.max_path_bytes]u8 = undefined;
+    const dir_path = try tmp_dir.dir.realpath(".", &path_buf);
+    var archive_path_buf: [std.fs.max_path_bytes]u8 = undefined;
+    const archive_path = try std.fmt.bufPrint(&archive_path_buf, "{s}/corrupt.patchpack", .{dir_path});
+
+    // Entry count that overflows u32 math
+    {
+        const file = try tmp_dir.dir.createFile("corrupt.patchpack", .{});
+        defer file.close();
+        try file.writer().writeStruct(PatchArchiveHeader{ .entry_count = std.math.maxInt(u32) });
+    }
+    try std.testing.expect(PatchArchive.open(archive_path) == null);
+
+    // Entry pointing past the end of the file
+    {
+        const file = try tmp_dir.dir.createFile("corrupt.patchpack", .{});
+        defer file.close();
+        try file.writer().writeStruct(PatchArchiveHeader{ .entry_count = 1 });
+        try file.writer().writeStruct(PatchArchiveEntry{ .patch_x = 0, .patch_z = 0, .size = 64, .offset = std.math.maxInt(u64) - 16 });
+    }
+    try std.testing.expect(PatchArchive.open(archive_path) == null);
+
+    // Truncated payload
+    {
+        var writer = PatchArchiveWriter.create(std.testing.allocator);
+        defer writer.destroy();
+        writer.addPatch(0, 0, "origin");
+        try writer.write(archive_path);
+        const file = try tmp_dir.dir.openFile("corrupt.patchpack", .{ .mode = .read_write });
+        defer file.close();
+        try file.setEndPos(try file.getEndPos() - 1);
+    }
+    try std.testing.expect(PatchArchive.open(archive_path) == null);
+}
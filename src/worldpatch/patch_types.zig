@@ -6,10 +6,40 @@ const config = @import("../config/config.zig");
 const IdLocal = @import("../core/core.zig").IdLocal;
 const util = @import("../util.zig");
 
+const patch_archive = @import("patch_archive.zig");
+const props_format = @import("props_format.zig");
 const world_patch_manager = @import("world_patch_manager.zig");
 const PatchLookup = world_patch_manager.PatchLookup;
 
+// Packed per-LoD archives, when present they're used instead of the loose patch files.
+const PatchArchives = [config.lowest_lod + 1]?patch_archive.PatchArchive;
+var heightmap_archives: PatchArchives = .{null} ** (config.lowest_lod + 1);
+var props_archives: PatchArchives = .{null} ** (config.lowest_lod + 1);
+
+fn openPatchArchives(archives: *PatchArchives, patch_type_name: []const u8) void {
+    for (archives, 0..) |*archive, lod| {
+        var path_buf: [256]u8 = undefined;
+        const path = patch_archive.getArchivePath(&path_buf, patch_type_name, @intCast(lod));
+        archive.* = patch_archive.PatchArchive.open(path);
+        if (archive.* == null) {
+            std.log.info("No {s} archive for LoD {}, using loose files", .{ patch_type_name, lod });
+        }
+    }
+}
+
+fn closePatchArchivesOfType(archives: *PatchArchives) void {
+    for (archives) |*archive_opt| {
+        if (archive_opt.*) |*archive| {
+            archive.close();
+        }
+        archive_opt.* = null;
+    }
+}
+
 pub fn registerPatchTypes(world_patch_mgr: *world_patch_manager.WorldPatchManager) void {
+    openPatchArchives(&heightmap_archives, "heightmap");
+    openPatchArchives(&props_archives, "props");
+
     _ = world_patch_mgr.registerPatchType(.{
         .id = config.patch_type_heightmap,
         // .dependenciesFn = heightmapDependencies,
@@ -22,6 +52,12 @@ pub fn registerPatchTypes(world_patch_mgr: *world_patch_manager.WorldPatchManage
     });
 }
 
+// Must be called after the WorldPatchManager has been destroyed, its workers may be reading from the archives.
+pub fn closePatchArchives() void {
+    closePatchArchivesOfType(&heightmap_archives);
+    closePatchArchivesOfType(&props_archives);
+}
+
 // ██╗  ██╗███████╗██╗ ██████╗ ██╗  ██╗████████╗███╗   ███╗ █████╗ ██████╗
 // ██║  ██║██╔════╝██║██╔════╝ ██║  ██║╚══██╔══╝████╗ ████║██╔══██╗██╔══██╗
 // ███████║█████╗  ██║██║  ███╗███████║   ██║   ██╔████╔██║███████║██████╔╝
@@ -57,20 +93,34 @@ fn heightmapDependencies(
 
 fn heightmapLoad(patch: *world_patch_manager.Patch, ctx: world_patch_manager.PatchTypeContext) void {
     // if (patch.lookup.lod > 1) {
-    var heightmap_namebuf: [256]u8 = undefined;
-    const heightmap_path = std.fmt.bufPrintZ(
-        heightmap_namebuf[0..heightmap_namebuf.len],
-        "content/patch/heightmap/lod{}/heightmap_x{}_z{}.heightmap",
-        .{
-            patch.lookup.lod,
-            patch.patch_x,
-            patch.patch_z,
-        },
-    ) catch unreachable;
-
-    const heightmap_asset_id = IdLocal.init(heightmap_path);
-    const heightmap_data = ctx.asset_mgr.loadAssetBlocking(heightmap_asset_id, .instant_blocking);
-    const header = util.castBytes(config.HeightmapHeader, heightmap_data);
+    var loose_asset_id: ?IdLocal = null;
+    defer if (loose_asset_id) |asset_id| ctx.asset_mgr.releaseAsset(asset_id);
+    const heightmap_data: []const u8 = blk: {
+        if (heightmap_archives[patch.lookup.lod]) |archive| {
+            // Zero-copy, straight out of the mapped archive.
+            break :blk archive.find(patch.patch_x, patch.patch_z) orelse {
+                // The simulator skips completely flat patches.
+                patch.status = .nonexistent;
+                return;
+            };
+        }
+
+        var heightmap_namebuf: [256]u8 = undefined;
+        const heightmap_path = std.fmt.bufPrintZ(
+            heightmap_namebuf[0..heightmap_namebuf.len],
+            "content/patch/heightmap/lod{}/heightmap_x{}_z{}.heightmap",
+            .{
+                patch.lookup.lod,
+                patch.patch_x,
+                patch.patch_z,
+            },
+        ) catch unreachable;
+
+        const heightmap_asset_id = IdLocal.init(heightmap_path);
+        loose_asset_id = heightmap_asset_id;
+        break :blk ctx.asset_mgr.loadAssetBlocking(heightmap_asset_id, .soft_within_frames);
+    };
+    const header = std.mem.bytesToValue(config.HeightmapHeader, heightmap_data[0..@sizeOf(config.HeightmapHeader)]);
     // const version = header.version;
     // _ = version;
     // const bitdepth = header.bitdepth;
@@ -188,21 +238,34 @@ fn heightmapLoad(patch: *world_patch_manager.Patch, ctx: world_patch_manager.Pat
 // ██║     ██║  ██║╚██████╔╝██║     ███████║
 // ╚═╝     ╚═╝  ╚═╝ ╚═════╝ ╚═╝     ╚══════╝
 
-pub const Prop = struct {
-    id: IdLocal,
-    pos: [3]f32,
-    rot: f32,
-};
-
-pub const Props = struct {
-    list: []Prop,
-};
+pub const Props = props_format.Props;
 
 fn propsLoad(patch: *world_patch_manager.Patch, ctx: world_patch_manager.PatchTypeContext) void {
+    if (props_archives[patch.lookup.lod]) |archive| {
+        // Decoded straight out of the mapped archive.
+        const props_data = archive.find(patch.patch_x, patch.patch_z) orelse {
+            // The simulator skips patches without props.
+            patch.status = .nonexistent;
+            return;
+        };
+        const props = props_format.decodeBinary(ctx.allocator, props_data) catch {
+            std.log.warn("Ignoring invalid props patch {}", .{patch.lookup});
+            patch.status = .nonexistent;
+            return;
+        };
+        if (props.count == 0) {
+            props_format.freeProps(ctx.allocator, props);
+            patch.status = .loaded_empty;
+            return;
+        }
+        patch.data = props.asBytes();
+        return;
+    }
+
     var props_namebuf: [256]u8 = undefined;
-    const props_path = std.fmt.bufPrintZ(
+    const props_binary_path = std.fmt.bufPrintZ(
         props_namebuf[0..props_namebuf.len],
-        "content/patch/props/lod{}/props_x{}_z{}.txt",
+        "content/patch/props/lod{}/props_x{}_z{}.props",
         .{
             patch.lookup.lod,
             patch.lookup.patch_x,
@@ -210,54 +273,44 @@ fn propsLoad(patch: *world_patch_manager.Patch, ctx: world_patch_manager.PatchTy
         },
     ) catch unreachable;
 
-    const props_asset_id = IdLocal.init(props_path);
-    if (!ctx.asset_mgr.doesAssetExist(props_asset_id)) {
+    const props_binary_id = IdLocal.init(props_binary_path);
+    const is_binary = ctx.asset_mgr.doesAssetExist(props_binary_id);
+    const props_asset_id = if (is_binary) props_binary_id else blk: {
+        // Fall back to the old CSV files until the content has been regenerated.
+        const props_csv_path = std.fmt.bufPrintZ(
+            props_namebuf[0..props_namebuf.len],
+            "content/patch/props/lod{}/props_x{}_z{}.txt",
+            .{
+                patch.lookup.lod,
+                patch.lookup.patch_x,
+                patch.lookup.patch_z,
+            },
+        ) catch unreachable;
+        break :blk IdLocal.init(props_csv_path);
+    };
+
+    if (!is_binary and !ctx.asset_mgr.doesAssetExist(props_asset_id)) {
         patch.status = .nonexistent;
         return;
     }
 
-    const props_data = ctx.asset_mgr.loadAssetBlocking(props_asset_id, .instant_blocking);
+    const props_data = ctx.asset_mgr.loadAssetBlocking(props_asset_id, .soft_within_seconds);
+    defer ctx.asset_mgr.releaseAsset(props_asset_id);
     if (props_data.len == 0) {
         patch.status = .loaded_empty;
         return;
     }
 
-    var props = std.ArrayList(Prop).initCapacity(ctx.allocator, props_data.len / 30) catch unreachable;
-    var buf_reader = std.io.fixedBufferStream(props_data);
-    var in_stream = buf_reader.reader();
-    var buf: [1024]u8 = undefined;
-    while (in_stream.readUntilDelimiterOrEof(&buf, '\n') catch unreachable) |line| {
-        var comma_curr: usize = 0;
-        var comma_next: usize = std.mem.indexOfScalar(u8, line, ","[0]).?;
-        const name = line[comma_curr..comma_next];
-
-        comma_curr = comma_next + 1;
-        comma_next = comma_curr + std.mem.indexOfScalar(u8, line[comma_curr..], ","[0]).?;
-        const pos_x = std.fmt.parseFloat(f32, line[comma_curr..comma_next]) catch unreachable;
-
-        comma_curr = comma_next + 1;
-        comma_next = comma_curr + std.mem.indexOfScalar(u8, line[comma_curr..], ","[0]).?;
-        const pos_y = std.fmt.parseFloat(f32, line[comma_curr..comma_next]) catch unreachable;
-
-        comma_curr = comma_next + 1;
-        comma_next = comma_curr + std.mem.indexOfScalar(u8, line[comma_curr..], ","[0]).?;
-        const pos_z = std.fmt.parseFloat(f32, line[comma_curr..comma_next]) catch unreachable;
-
-        comma_curr = comma_next + 1;
-        const rot_y = std.fmt.parseFloat(f32, line[comma_curr..]) catch unreachable;
-
-        const prop = Prop{
-            .id = IdLocal.init(name),
-            .pos = .{ pos_x, pos_y, pos_z },
-            .rot = rot_y,
-        };
-        props.appendAssumeCapacity(prop);
+    const props = if (!is_binary) props_format.decodeCsv(ctx.allocator, props_data) else props_format.decodeBinary(ctx.allocator, props_data) catch {
+        std.log.warn("Ignoring invalid props patch {s}", .{props_binary_path});
+        patch.status = .nonexistent;
+        return;
+    };
+    if (props.count == 0) {
+        props_format.freeProps(ctx.allocator, props);
+        patch.status = .loaded_empty;
+        return;
     }
 
-    var data = ctx.allocator.alignedAlloc(u8, 64, @sizeOf(Props) + @sizeOf(Prop) * props.items.len) catch unreachable;
-    var props_instance = std.mem.bytesAsValue(Props, data[0..@sizeOf(Props)]);
-    const proplist = std.mem.bytesAsSlice(Prop, data[@sizeOf(Props)..]);
-    props_instance.list = proplist;
-    @memcpy(proplist, props.items);
-    patch.data = std.mem.asBytes(props_instance);
+    patch.data = props.asBytes();
 }
@@ -0,0 +1,414 @@
+const std = @import("std");
+
+// ██████╗ ██████╗  ██████╗ ██████╗ ███████╗
+// ██╔══██╗██╔══██╗██╔═══██╗██╔══██╗██╔════╝
+// ██████╔╝██████╔╝██║   ██║██████╔╝███████╗
+// ██╔═══╝ ██╔══██╗██║   ██║██╔═══╝ ╚════██║
+// ██║     ██║  ██║╚██████╔╝██║     ███████║
+// ╚═╝     ╚═╝  ╚═╝ ╚═════╝ ╚═╝     ╚══════╝
+
+// Binary props patch, content/patch/props/lod{}/props_x{}_z{}.props
+//
+// [PropsHeader]
+// [PropsTypeEntry] * type_count
+// type_index: [prop_count]u8, padded to 4 bytes
+// pos_x, pos_y, pos_z, rot, scale: [prop_count]f32 each, or [prop_count]u16 when quantized,
+// each column padded to 4 bytes. Quantized positions are relative to pos_min..pos_max,
+// rotation covers 0..tau and scale 0..scale_max.
+//
+// NOTE: Only imports std, the simulator builds this file as its own module to write patches.
+
+pub const props_magic = "TPRP".*;
+pub const props_version = 1;
+pub const props_flag_quantized: u16 = 1 << 0;
+pub const max_prop_types = 256;
+
+pub const PropsHeader = extern struct {
+    magic: [4]u8 = props_magic,
+    version: u16 = props_version,
+    flags: u16,
+    prop_count: u32,
+    type_count: u32,
+    pos_min: [3]f32,
+    pos_max: [3]f32,
+    scale_max: f32,
+    _padding: u32 = 0,
+};
+
+pub const PropsTypeEntry = extern struct {
+    hash: u64, // Same as IdLocal.init(name).hash
+    name: [24]u8, // Zero padded, for debugging
+};
+
+pub fn hashTypeName(name: []const u8) u64 {
+    return std.hash.Wyhash.hash(0, name);
+}
+
+// Decoded, resident form. Lives in a single allocation starting with this struct,
+// which is what the props patch's data points at.
+pub const Props = struct {
+    count: u32,
+    type_hashes: []u64,
+    type_index: []u8,
+    pos_x: []f32,
+    pos_y: []f32,
+    pos_z: []f32,
+    rot: []f32,
+    scale: []f32,
+
+    pub fn typeHash(self: Props, prop_index: usize) u64 {
+        return self.type_hashes[self.type_index[prop_index]];
+    }
+
+    pub fn asBytes(self: *Props) []u8 {
+        const bytes: [*]u8 = @ptrCast(self);
+        return bytes[0..residentSize(self.count, @intCast(self.type_hashes.len))];
+    }
+};
+
+pub const props_alignment = 64;
+
+pub fn residentSize(prop_count: u32, type_count: u32) usize {
+    return @sizeOf(Props) + type_count * @sizeOf(u64) + prop_count * (5 * @sizeOf(f32) + @sizeOf(u8));
+}
+
+fn takeSlice(comptime T: type, data: []u8, offset: *usize, count: usize) []T {
+    const bytes = data[offset.*..][0 .. count * @sizeOf(T)];
+    offset.* += bytes.len;
+    return @alignCast(std.mem.bytesAsSlice(T, bytes));
+}
+
+pub fn allocProps(allocator: std.mem.Allocator, prop_count: u32, type_count: u32) *Props {
+    const data = allocator.alignedAlloc(u8, props_alignment, residentSize(prop_count, type_count)) catch unreachable;
+    const props: *Props = @ptrCast(data.ptr);
+    var offset: usize = @sizeOf(Props);
+    props.count = prop_count;
+    props.type_hashes = takeSlice(u64, data, &offset, type_count);
+    props.pos_x = takeSlice(f32, data, &offset, prop_count);
+    props.pos_y = takeSlice(f32, data, &offset, prop_count);
+    props.pos_z = takeSlice(f32, data, &offset, prop_count);
+    props.rot = takeSlice(f32, data, &offset, prop_count);
+    props.scale = takeSlice(f32, data, &offset, prop_count);
+    props.type_index = takeSlice(u8, data, &offset, prop_count);
+    std.debug.assert(offset == data.len);
+    return props;
+}
+
+pub fn freeProps(allocator: std.mem.Allocator, props: *Props) void {
+    const data: []align(props_alignment) u8 = @alignCast(props.asBytes());
+    allocator.free(data);
+}
+
+// ██████╗ ███████╗ ██████╗ ██████╗ ██████╗ ███████╗
+// ██╔══██╗██╔════╝██╔════╝██╔═══██╗██╔══██╗██╔════╝
+// ██║  ██║█████╗  ██║     ██║   ██║██║  ██║█████╗
+// ██║  ██║██╔══╝  ██║     ██║   ██║██║  ██║██╔══╝
+// ██████╔╝███████╗╚██████╗╚██████╔╝██████╔╝███████╗
+// ╚═════╝ ╚══════╝ ╚═════╝ ╚═════╝ ╚═════╝ ╚══════╝
+
+pub const DecodeError = error{InvalidProps};
+
+fn readColumn(comptime T: type, data: []const u8, offset: *usize, count: usize) DecodeError![]align(1) const T {
+    const size = count * @sizeOf(T);
+    if (offset.* > data.len or size > data.len - offset.*) {
+        return error.InvalidProps;
+    }
+    const bytes = data[offset.*..][0..size];
+    offset.* = std.mem.alignForward(usize, offset.* + size, 4);
+    return std.mem.bytesAsSlice(T, bytes);
+}
+
+fn dequantize(value: u16, min: f32, max: f32) f32 {
+    const t = @as(f32, @floatFromInt(value)) / std.math.maxInt(u16);
+    return min + (max - min) * t;
+}
+
+// Patches come from disk, so every column is bounds checked before it's read.
+pub fn decodeBinary(allocator: std.mem.Allocator, data: []const u8) DecodeError!*Props {
+    if (data.len < @sizeOf(PropsHeader)) {
+        return error.InvalidProps;
+    }
+    const header = std.mem.bytesToValue(PropsHeader, data[0..@sizeOf(PropsHeader)]);
+    if (!std.mem.eql(u8, &header.magic, &props_magic) or header.version != props_version or header.type_count > max_prop_types) {
+        return error.InvalidProps;
+    }
+
+    var offset: usize = @sizeOf(PropsHeader);
+    const type_entries = try readColumn(PropsTypeEntry, data, &offset, header.type_count);
+    const type_indices = try readColumn(u8, data, &offset, header.prop_count);
+    for (type_indices) |type_index| {
+        if (type_index >= header.type_count) {
+            return error.InvalidProps;
+        }
+    }
+
+    // Check the value columns before allocating, the counts come straight from the file.
+    const value_size: usize = if (header.flags & props_flag_quantized != 0) @sizeOf(u16) else @sizeOf(f32);
+    if (offset > data.len or 5 * std.mem.alignForward(usize, header.prop_count * value_size, 4) > data.len - offset) {
+        return error.InvalidProps;
+    }
+
+    const props = allocProps(allocator, header.prop_count, header.type_count);
+    errdefer freeProps(allocator, props);
+    for (type_entries, props.type_hashes) |type_entry, *type_hash| {
+        type_hash.* = type_entry.hash;
+    }
+    @memcpy(props.type_index, type_indices);
+
+    if (header.flags & props_flag_quantized != 0) {
+        const columns = [_]struct { out: []f32, min: f32, max: f32 }{
+            .{ .out = props.pos_x, .min = header.pos_min[0], .max = header.pos_max[0] },
+            .{ .out = props.pos_y, .min = header.pos_min[1], .max = header.pos_max[1] },
+            .{ .out = props.pos_z, .min = header.pos_min[2], .max = header.pos_max[2] },
+            .{ .out = props.rot, .min = 0, .max = std.math.tau },
+            .{ .out = props.scale, .min = 0, .max = header.scale_max },
+        };
+        for (columns) |column| {
+            const quantized = try readColumn(u16, data, &offset, header.prop_count);
+            for (column.out, quantized) |*value, value_quantized| {
+                value.* = dequantize(value_quantized, column.min, column.max);
+            }
+        }
+    } else {
+        for ([_][]f32{ props.pos_x, props.pos_y, props.pos_z, props.rot, props.scale }) |column| {
+            @memcpy(column, try readColumn(f32, data, &offset, header.prop_count));
+        }
+    }
+
+    return props;
+}
+
+// Legacy "name,x,y,z,rot" lines. Has no scale column, so scales are randomized like the
+// prop system used to do at spawn time.
+pub fn decodeCsv(allocator: std.mem.Allocator, data: []const u8) *Props {
+    var prop_count: u32 = 0;
+    var line_iter = std.mem.tokenizeScalar(u8, data, '\n');
+    while (line_iter.next()) |_| {
+        prop_count += 1;
+    }
+
+    var type_hashes: [max_prop_types]u64 = undefined;
+    var type_count: u32 = 0;
+
+    // Parse straight into a max-types sized block, then shrink the type table below.
+    const scratch = allocProps(allocator, prop_count, max_prop_types);
+    defer freeProps(allocator, scratch);
+
+    var rand_state = std.Random.DefaultPrng.init(prop_count);
+    const rand = rand_state.random();
+
+    var prop_index: usize = 0;
+    line_iter.reset();
+    while (line_iter.next()) |line| : (prop_index += 1) {
+        var field_iter = std.mem.splitScalar(u8, line, ',');
+        const name_hash = hashTypeName(field_iter.next().?);
+        const type_index = blk: {
+            for (type_hashes[0..type_count], 0..) |type_hash, i| {
+                if (type_hash == name_hash) {
+                    break :blk i;
+                }
+            }
+            type_hashes[type_count] = name_hash;
+            type_count += 1;
+            break :blk type_count - 1;
+        };
+
+        scratch.type_index[prop_index] = @intCast(type_index);
+        scratch.pos_x[prop_index] = std.fmt.parseFloat(f32, field_iter.next().?) catch unreachable;
+        scratch.pos_y[prop_index] = std.fmt.parseFloat(f32, field_iter.next().?) catch unreachable;
+        scratch.pos_z[prop_index] = std.fmt.parseFloat(f32, field_iter.next().?) catch unreachable;
+        scratch.rot[prop_index] = std.fmt.parseFloat(f32, std.mem.trimRight(u8, field_iter.next().?, "\r")) catch unreachable;
+        scratch.scale[prop_index] = 0.15 + rand.float(f32) * 1.25;
+    }
+
+    const props = allocProps(allocator, prop_count, type_count);
+    @memcpy(props.type_hashes, type_hashes[0..type_count]);
+    @memcpy(props.type_index, scratch.type_index);
+    @memcpy(props.pos_x, scratch.pos_x);
+    @memcpy(props.pos_y, scratch.pos_y);
+    @memcpy(props.pos_z, scratch.pos_z);
+    @memcpy(props.rot, scratch.rot);
+    @memcpy(props.scale, scratch.scale);
+    return props;
+}
+
+// ███████╗███╗   ██╗ ██████╗ ██████╗ ██████╗ ███████╗
+// ██╔════╝████╗  ██║██╔════╝██╔═══██╗██╔══██╗██╔════╝
+// █████╗  ██╔██╗ ██║██║     ██║   ██║██║  ██║█████╗
+// ██╔══╝  ██║╚██╗██║██║     ██║   ██║██║  ██║██╔══╝
+// ███████╗██║ ╚████║╚██████╗╚██████╔╝██████╔╝███████╗
+// ╚══════╝╚═╝  ╚═══╝ ╚═════╝ ╚═════╝ ╚═════╝ ╚══════╝
+
+pub const PropInput = struct {
+    type_name: []const u8,
+    pos: [3]f32,
+    rot: f32,
+    scale: f32,
+};
+
+fn quantize(value: f32, min: f32, max: f32) u16 {
+    if (max <= min) {
+        return 0;
+    }
+    const t = std.math.clamp((value - min) / (max - min), 0, 1);
+    return @intFromFloat(@round(t * std.math.maxInt(u16)));
+}
+
+fn writePadding(writer: anytype, written: usize) !void {
+    try writer.writeByteNTimes(0, std.mem.alignForward(usize, written, 4) - written);
+}
+
+pub fn encode(props: []const PropInput, quantized: bool, writer: anytype) !void {
+    var type_entries: [max_prop_types]PropsTypeEntry = undefined;
+    var type_count: u32 = 0;
+    var pos_min: [3]f32 = .{ std.math.floatMax(f32), std.math.floatMax(f32), std.math.floatMax(f32) };
+    var pos_max: [3]f32 = .{ -std.math.floatMax(f32), -std.math.floatMax(f32), -std.math.floatMax(f32) };
+    var scale_max: f32 = 0;
+    for (props) |prop| {
+        for (0..3) |axis| {
+            pos_min[axis] = @min(pos_min[axis], prop.pos[axis]);
+            pos_max[axis] = @max(pos_max[axis], prop.pos[axis]);
+        }
+        scale_max = @max(scale_max, prop.scale);
+
+        const hash = hashTypeName(prop.type_name);
+        for (type_entries[0..type_count]) |type_entry| {
+            if (type_entry.hash == hash) {
+                break;
+            }
+        } else {
+            // type_index is stored as a u8
+            if (type_count == max_prop_types) {
+                return error.TooManyPropTypes;
+            }
+            var type_entry = PropsTypeEntry{ .hash = hash, .name = .{0} ** 24 };
+            const name_len = @min(prop.type_name.len, type_entry.name.len);
+            @memcpy(type_entry.name[0..name_len], prop.type_name[0..name_len]);
+            type_entries[type_count] = type_entry;
+            type_count += 1;
+        }
+    }
+
+    if (props.len == 0) {
+        pos_min = .{ 0, 0, 0 };
+        pos_max = .{ 0, 0, 0 };
+    }
+
+    try writer.writeStruct(PropsHeader{
+        .flags = if (quantized) props_flag_quantized else 0,
+        .prop_count = @intCast(props.len),
+        .type_count = type_count,
+        .pos_min = pos_min,
+        .pos_max = pos_max,
+        .scale_max = scale_max,
+    });
+    for (type_entries[0..type_count]) |type_entry| {
+        try writer.writeStruct(type_entry);
+    }
+
+    for (props) |prop| {
+        const hash = hashTypeName(prop.type_name);
+        for (type_entries[0..type_count], 0..) |type_entry, type_index| {
+            if (type_entry.hash == hash) {
+                try writer.writeByte(@intCast(type_index));
+                break;
+            }
+        }
+    }
+    try writePadding(writer, props.len);
+
+    const Column = enum { pos_x, pos_y, pos_z, rot, scale };
+    const ColumnValue = struct { value: f32, min: f32, max: f32 };
+    inline for (std.meta.fields(Column)) |column_field| {
+        const column: Column = @enumFromInt(column_field.value);
+        for (props) |prop| {
+            const column_value: ColumnValue = switch (column) {
+                .pos_x => .{ .value = prop.pos[0], .min = pos_min[0], .max = pos_max[0] },
+                .pos_y => .{ .value = prop.pos[1], .min = pos_min[1], .max = pos_max[1] },
+                .pos_z => .{ .value = prop.pos[2], .min = pos_min[2], .max = pos_max[2] },
+                .rot => .{ .value = std.math.mod(f32, prop.rot, std.math.tau) catch 0, .min = 0, .max = std.math.tau },
+                .scale => .{ .value = prop.scale, .min = 0, .max = scale_max },
+            };
+            if (quantized) {
+                try writer.writeInt(u16, quantize(column_value.value, column_value.min, column_value.max), .little);
+            } else {
+                try writer.writeInt(u32, @bitCast(column_value.value), .little);
+            }
+        }
+        if (quantized) {
+            try writePadding(writer, props.len * @sizeOf(u16));
+        }
+    }
+}
+
+test "props_format" {
+    const input = [_]PropInput{
+        .{ .type_name = "tree", .pos = .{ 100, 50, 200 }, .rot = 1, .scale = 0.5 },
+        .{ .type_name = "city", .pos = .{ 120, 60, 210 }, .rot = 2, .scale = 1 },
+        .{ .type_name = "tree", .pos = .{ 127, 55, 255 }, .rot = 3, .scale = 1.25 },
+    };
+
+    inline for (.{ false, true }) |quantized| {
+        var encoded = std.ArrayList(u8).init(std.testing.allocator);
+        defer encoded.deinit();
+        try encode(&input, quantized, encoded.writer());
+
+        const props = try decodeBinary(std.testing.allocator, encoded.items);
+        defer freeProps(std.testing.allocator, props);
+
+        const tolerance: f32 = if (quantized) 0.01 else 0;
+        try std.testing.expect(props.count == input.len);
+        try std.testing.expect(props.type_hashes.len == 2);
+        for (input, 0..) |prop, i| {
+            try std.testing.expect(props.typeHash(i) == hashTypeName(prop.type_name));
+            try std.testing.expectApproxEqAbs(prop.pos[0], props.pos_x[i], tolerance);
+            try std.testing.expectApproxEqAbs(prop.pos[1], props.pos_y[i], tolerance);
+            try std.testing.expectApproxEqAbs(prop.pos[2], props.pos_z[i], tolerance);
+            try std.testing.expectApproxEqAbs(prop.rot, props.rot[i], tolerance);
+            try std.testing.expectApproxEqAbs(prop.scale, props.scale[i], tolerance);
+        }
+    }
+
+    const csv_props = decodeCsv(std.testing.allocator, "tree,1.5,2.5,3.5,0.25\ncity,4,5,6,1\n");
+    defer freeProps(std.testing.allocator, csv_props);
+    try std.testing.expect(csv_props.count == 2);
+    try std.testing.expect(csv_props.typeHash(0) == hashTypeName("tree"));
+    try std.testing.expect(csv_props.pos_z[1] == 6);
+}
+
+test "props_format rejects corrupt patches" {
+    const input = [_]PropInput{
+        .{ .type_name = "tree", .pos = .{ 100, 50, 200 }, .rot = 1, .scale = 0.5 },
+        .{ .type_name = "city", .pos = .{ 120, 60, 210 }, .rot = 2, .scale = 1 },
+    };
+
+    var encoded = std.ArrayList(u8).init(std.testing.allocator);
+    defer encoded.deinit();
+    try encode(&input, true, encoded.writer());
+
+    // Truncated header and truncated last column
+    try std.testing.expectError(error.InvalidProps, decodeBinary(std.testing.allocator, encoded.items[0 .. @sizeOf(PropsHeader) - 1]));
+    try std.testing.expectError(error.InvalidProps, decodeBinary(std.testing.allocator, encoded.items[0 .. encoded.items.len - 6]));
+
+    // Prop count that runs past the end of the data
+    var header = std.mem.bytesToValue(PropsHeader, encoded.items[0..@sizeOf(PropsHeader)]);
+    header.prop_count = std.math.maxInt(u32);
+    @memcpy(encoded.items[0..@sizeOf(PropsHeader)], std.mem.asBytes(&header));
+    try std.testing.expectError(error.InvalidProps, decodeBinary(std.testing.allocator, encoded.items));
+
+    // Type index past the type table
+    header.prop_count = input.len;
+    @memcpy(encoded.items[0..@sizeOf(PropsHeader)], std.mem.asBytes(&header));
+    encoded.items[@sizeOf(PropsHeader) + 2 * @sizeOf(PropsTypeEntry)] = 2;
+    try std.testing.expectError(error.InvalidProps, decodeBinary(std.testing.allocator, encoded.items));
+
+    // More types than type_index can address
+    var names: [max_prop_types + 1][8]u8 = undefined;
+    var many_types: [max_prop_types + 1]PropInput = undefined;
+    for (&names, &many_types, 0..) |*name, *prop, i| {
+        const name_slice = try std.fmt.bufPrint(name, "p{}", .{i});
+        prop.* = .{ .type_name = name_slice, .pos = .{ 0, 0, 0 }, .rot = 0, .scale = 1 };
+    }
+    encoded.clearRetainingCapacity();
+    try std.testing.expectError(error.TooManyPropTypes, encode(&many_types, false, encoded.writer()));
+}
@@ -0,0 +1,176 @@
+const std = @import("std");
+const ztracy = @import("ztracy");
+
+const config = @import("../config/config.zig");
+const patch_types = @import("patch_types.zig");
+const world_patch_manager = @import("world_patch_manager.zig");
+
+// Terrain height and normal at arbitrary world xz positions, read straight from the heightmap
+// patches WorldPatchManager has resident instead of raycasting the physics worlds. Each query
+// bilinearly samples the finest LoD that's loaded at its position, the same surface the
+// physics heightfields are built from.
+//
+// Queries are done in batches, lanes of a SIMD vector at a time. Finding the patch and fetching
+// the four corner heights is per query, the interpolation and normals run on the whole lane.
+// Raycasts are still needed for anything that isn't terrain.
+//
+// NOTE: The heightmap pointers are only looked up for the duration of a call, so it's fine for
+// patches to unload between calls.
+
+pub const TerrainHeightResult = struct {
+    height: f32 = 0,
+    normal: [3]f32 = .{ 0, 1, 0 },
+    lod: world_patch_manager.LoD = 0,
+    hit: bool = false, // False where no heightmap is resident
+};
+
+const lane_count = std.simd.suggestVectorLength(f32) orelse 8;
+const Lanes = @Vector(lane_count, f32);
+
+// Direct mapped, consecutive queries are mostly in the same few patches.
+const patch_cache_size = 16;
+
+const PatchCacheEntry = struct {
+    lookup: world_patch_manager.PatchLookup = .{ .patch_x = std.math.maxInt(u16), .patch_z = 0, .lod = 0, .patch_type_id = 0 },
+    heightmap_opt: ?*const patch_types.Heightmap = null,
+};
+
+pub const TerrainHeightQuery = struct {
+    world_patch_mgr: *world_patch_manager.WorldPatchManager,
+    heightmap_patch_type_id: world_patch_manager.PatchTypeId,
+    queries_total: u64 = 0,
+    misses_total: u64 = 0,
+
+    pub fn create(world_patch_mgr: *world_patch_manager.WorldPatchManager) TerrainHeightQuery {
+        return .{
+            .world_patch_mgr = world_patch_mgr,
+            .heightmap_patch_type_id = world_patch_mgr.getPatchTypeId(config.patch_type_heightmap),
+        };
+    }
+
+    pub fn query(self: *TerrainHeightQuery, world_x: f32, world_z: f32) TerrainHeightResult {
+        var result: [1]TerrainHeightResult = undefined;
+        self.queryBatch(&.{.{ world_x, world_z }}, &result);
+        return result[0];
+    }
+
+    // positions are world xz, results must be at least as long.
+    pub fn queryBatch(self: *TerrainHeightQuery, positions: []const [2]f32, results: []TerrainHeightResult) void {
+        const trazy_zone = ztracy.ZoneNC(@src(), "TerrainHeightQuery", 0x00_00_00_ff);
+        defer trazy_zone.End();
+        std.debug.assert(results.len >= positions.len);
+
+        var patch_cache = [_]PatchCacheEntry{.{}} ** patch_cache_size;
+        var batch_start: usize = 0;
+        while (batch_start < positions.len) : (batch_start += lane_count) {
+            const batch_count = @min(lane_count, positions.len - batch_start);
+
+            var h00: Lanes = @splat(0);
+            var h10: Lanes = @splat(0);
+            var h01: Lanes = @splat(0);
+            var h11: Lanes = @splat(0);
+            var frac_x: Lanes = @splat(0);
+            var frac_z: Lanes = @splat(0);
+            var spacing: Lanes = @splat(1);
+            for (0..batch_count) |lane| {
+                const position = positions[batch_start + lane];
+                const result = &results[batch_start + lane];
+                result.* = .{};
+                const sample = self.findFinestPatch(&patch_cache, position[0], position[1]) orelse continue;
+                const heights = &sample.heightmap.heightmap;
+                const index = sample.cell_x + sample.cell_z * config.patch_resolution;
+                h00[lane] = heights[index];
+                h10[lane] = heights[index + 1];
+                h01[lane] = heights[index + config.patch_resolution];
+                h11[lane] = heights[index + config.patch_resolution + 1];
+                frac_x[lane] = sample.frac_x;
+                frac_z[lane] = sample.frac_z;
+                spacing[lane] = sample.spacing;
+                result.lod = sample.lod;
+                result.hit = true;
+            }
+
+            const lanes = sampleLanes(h00, h10, h01, h11, frac_x, frac_z, spacing);
+            for (0..batch_count) |lane| {
+                const result = &results[batch_start + lane];
+                if (!result.hit) {
+                    self.misses_total += 1;
+                    continue;
+                }
+                result.height = lanes.height[lane];
+                result.normal = .{ lanes.normal_x[lane], lanes.normal_y[lane], lanes.normal_z[lane] };
+            }
+        }
+        self.queries_total += positions.len;
+    }
+
+    const PatchSample = struct {
+        heightmap: *const patch_types.Heightmap,
+        lod: world_patch_manager.LoD,
+        cell_x: u32,
+        cell_z: u32,
+        frac_x: f32,
+        frac_z: f32,
+        spacing: f32,
+    };
+
+    fn findFinestPatch(self: *TerrainHeightQuery, patch_cache: *[patch_cache_size]PatchCacheEntry, world_x: f32, world_z: f32) ?PatchSample {
+        if (!(world_x >= 0 and world_z >= 0 and world_x < config.world_size_x and world_z < config.world_size_z)) {
+            return null;
+        }
+
+        for (0..config.lowest_lod + 1) |lod_index| {
+            const lod: world_patch_manager.LoD = @intCast(lod_index);
+            const lookup = world_patch_manager.WorldPatchManager.getLookup(world_x, world_z, lod, self.heightmap_patch_type_id);
+            const cache_entry = &patch_cache[(lookup.patch_x *% 31 +% lookup.patch_z *% 17 +% lod) % patch_cache_size];
+            if (!cache_entry.lookup.eql(lookup)) {
+                cache_entry.* = .{
+                    .lookup = lookup,
+                    .heightmap_opt = self.world_patch_mgr.tryGetPatch(lookup, patch_types.Heightmap).data_opt,
+                };
+            }
+            const heightmap = cache_entry.heightmap_opt orelse continue;
+
+            const world_pos = lookup.getWorldPos();
+            const spacing: f32 = @floatFromInt(std.math.pow(u32, 2, lod));
+            const local_x = (world_x - @as(f32, @floatFromInt(world_pos.world_x))) / spacing;
+            const local_z = (world_z - @as(f32, @floatFromInt(world_pos.world_z))) / spacing;
+            const max_cell: f32 = config.patch_resolution - 2;
+            const cell_x = std.math.clamp(@floor(local_x), 0, max_cell);
+            const cell_z = std.math.clamp(@floor(local_z), 0, max_cell);
+            return .{
+                .heightmap = heightmap,
+                .lod = lod,
+                .cell_x = @intFromFloat(cell_x),
+                .cell_z = @intFromFloat(cell_z),
+                .frac_x = local_x - cell_x,
+                .frac_z = local_z - cell_z,
+                .spacing = spacing,
+            };
+        }
+        return null;
+    }
+};
+
+// Bilinear height plus the normal of the bilinear surface at the sample point.
+fn sampleLanes(h00: Lanes, h10: Lanes, h01: Lanes, h11: Lanes, frac_x: Lanes, frac_z: Lanes, spacing: Lanes) struct {
+    height: Lanes,
+    normal_x: Lanes,
+    normal_y: Lanes,
+    normal_z: Lanes,
+} {
+    const one: Lanes = @splat(1);
+    const bottom = h00 + (h10 - h00) * frac_x;
+    const top = h01 + (h11 - h01) * frac_x;
+    const height = bottom + (top - bottom) * frac_z;
+
+    const slope_x = ((h10 - h00) * (one - frac_z) + (h11 - h01) * frac_z) / spacing;
+    const slope_z = (top - bottom) / spacing;
+    const inv_length = one / @sqrt(slope_x * slope_x + one + slope_z * slope_z);
+    return .{
+        .height = height,
+        .normal_x = -slope_x * inv_length,
+        .normal_y = inv_length,
+        .normal_z = -slope_z * inv_length,
+    };
+}
@@ -3,6 +3,7 @@ const std = @import("std");
 const Pool = @import("zpool").Pool;
 const IdLocal = @import("../core/core.zig").IdLocal;
 const BucketQueue = @import("../core/bucket_queue.zig").BucketQueue;
+const MpscQueue = @import("../core/mpsc_queue.zig").MpscQueue;
 const AssetManager = @import("../core/asset_manager.zig").AssetManager;
 const util = @import("../util.zig");
 const config = @import("../config/config.zig");
@@ -21,6 +22,7 @@ const max_patch_int = std.meta.Int(.unsigned, max_patch_int_bits);
 
 const max_requesters = 8;
 const max_patch_types = 8;
+const max_patches_in_flight = 64; // must be a power of two, it sizes the completion queue
 pub const Priority = enum {
     come_on_do_it_do_it_come_on_do_it_now,
     high,
@@ -85,6 +87,7 @@ pub const PatchLookup = struct {
 
 pub const PatchStatus = enum {
     not_loaded,
+    loading, // Popped from the queue and handed to a worker thread
     loaded,
     loaded_empty,
     nonexistent,
@@ -196,6 +199,26 @@ pub const PatchPool = Pool(16, 16, void, struct {
 pub const PatchHandle = PatchPool.Handle;
 pub const PatchQueue = BucketQueue(PatchHandle, Priority);
 
+const PatchLoadJob = struct {
+    patch_handle: PatchHandle,
+    patch: Patch, // Worker-owned copy, the pooled patch is only touched on the main thread
+};
+
+const PatchLoadResult = struct {
+    patch_handle: PatchHandle,
+    lookup: PatchLookup,
+    status: PatchStatus,
+    data: ?[]u8,
+};
+
+const PatchLoadResultQueue = MpscQueue(PatchLoadResult);
+
+const DependencyStatus = enum {
+    ready,
+    loading,
+    queued,
+};
+
 pub const RequestRectangle = struct {
     x: f32,
     z: f32,
@@ -203,6 +226,42 @@ pub const RequestRectangle = struct {
     height: f32,
 };
 
+// Half open range of patch coordinates at one LoD.
+const PatchRect = struct {
+    x_begin: u16 = 0,
+    z_begin: u16 = 0,
+    x_end: u16 = 0,
+    z_end: u16 = 0,
+
+    fn eql(self: PatchRect, other: PatchRect) bool {
+        return std.meta.eql(self, other);
+    }
+};
+
+pub const RegionSubscriptionId = u16;
+
+pub const RegionSubscriptionDesc = struct {
+    requester_id: RequesterId,
+    patch_type_id: PatchTypeId,
+    prio: Priority = .medium,
+    radius: f32, // Half the side of the square around the center
+    lod_mask: u16, // Bit per LoD to request
+    scale_radius_by_lod: bool = false, // Doubles the radius per LoD so every LoD covers as many patches
+};
+
+const RegionSubscription = struct {
+    desc: RegionSubscriptionDesc,
+    rects: [config.lowest_lod + 1]PatchRect = .{PatchRect{}} ** (config.lowest_lod + 1),
+    entered: std.ArrayList(PatchLookup),
+    exited: std.ArrayList(PatchLookup),
+};
+
+// Only valid until the next update of the same subscription.
+pub const RegionDelta = struct {
+    entered: []const PatchLookup,
+    exited: []const PatchLookup,
+};
+
 pub const PatchType = struct {
     id: IdLocal,
     dependenciesFn: ?*const fn (PatchLookup, *[max_dependencies]PatchLookup, PatchTypeContext) []PatchLookup = null,
@@ -220,9 +279,9 @@ fn debugServerHandle(data: []const u8, allocator: std.mem.Allocator, ctx: *anyop
     var world_patch_mgr = @as(*WorldPatchManager, @ptrCast(@alignCast(ctx)));
 
     const buckets = .{
-        .bucket0 = world_patch_mgr.bucket_queue.buckets[0].items.len,
-        .bucket1 = world_patch_mgr.bucket_queue.buckets[1].items.len,
-        .bucket2 = world_patch_mgr.bucket_queue.buckets[2].items.len,
+        .bucket0 = world_patch_mgr.bucket_queue.buckets[0].live_count,
+        .bucket1 = world_patch_mgr.bucket_queue.buckets[1].live_count,
+        .bucket2 = world_patch_mgr.bucket_queue.buckets[2].live_count,
         .current_highest_prio = world_patch_mgr.bucket_queue.current_highest_prio,
     };
 
@@ -253,6 +312,8 @@ fn debugServerHandle(data: []const u8, allocator: std.mem.Allocator, ctx: *anyop
         .lods = lods,
         .lods_loaded = lods_loaded,
         .lods_queued = lods_queued,
+        .region_patches_entered_total = world_patch_mgr.region_patches_entered_total,
+        .region_patches_exited_total = world_patch_mgr.region_patches_exited_total,
     };
 
     var string = std.ArrayList(u8).init(allocator);
@@ -277,6 +338,14 @@ pub const WorldPatchManager = struct {
     bucket_queue: PatchQueue = undefined,
     asset_mgr: *AssetManager = undefined,
     debug_server: debug_server.DebugServer = undefined,
+    workers: ?*std.Thread.Pool = null,
+    load_results: PatchLoadResultQueue = undefined,
+    load_wait_group: std.Thread.WaitGroup = .{},
+    patches_in_flight: u32 = 0,
+    patches_loaded_total: u64 = 0,
+    region_subscriptions: std.ArrayList(RegionSubscription) = undefined,
+    region_patches_entered_total: u64 = 0,
+    region_patches_exited_total: u64 = 0,
 
     pub fn create(allocator: std.mem.Allocator, asset_mgr: *AssetManager) *WorldPatchManager {
         var res = allocator.create(WorldPatchManager) catch unreachable;
@@ -289,6 +358,8 @@ pub const WorldPatchManager = struct {
             .bucket_queue = PatchQueue.create(allocator, [_]u32{ 16 * 8192, 16 * 8192, 16 * 8192, 16 * 8192 }), // temporarily low for testing
             .asset_mgr = asset_mgr,
             .debug_server = debug_server.DebugServer.create(1234, allocator),
+            .load_results = PatchLoadResultQueue.create(allocator, max_patches_in_flight),
+            .region_subscriptions = std.ArrayList(RegionSubscription).init(allocator),
         };
 
         res.debug_server.registerHandler(IdLocal.init("wpm"), debugServerHandle, res);
@@ -300,9 +371,35 @@ pub const WorldPatchManager = struct {
 
     pub fn destroy(self: *WorldPatchManager) void {
         self.debug_server.stop();
+        if (self.workers) |workers| {
+            // The pool is borrowed and outlives us, so wait for our own loads to come back.
+            workers.waitAndWork(&self.load_wait_group);
+            while (self.load_results.pop()) |result| {
+                self.patches_in_flight -= 1;
+                self.integrateLoadResult(result);
+            }
+            std.debug.assert(self.patches_in_flight == 0);
+            self.workers = null;
+        }
+        for (self.region_subscriptions.items) |*subscription| {
+            subscription.entered.deinit();
+            subscription.exited.deinit();
+        }
+        self.region_subscriptions.deinit();
+        self.load_results.destroy();
         self.patch_pool.deinit();
     }
 
+    // Switches patch loading over to a borrowed worker pool, the job system's background pool
+    // in the game. Once set, tickBudgeted hands loads off to the workers and only integrates
+    // finished patches on the calling thread. The pool must outlive the manager.
+    // NOTE: loadFns run on the workers, so they must only touch the patch they're given,
+    // the (thread-safe) allocator and the asset manager.
+    pub fn useWorkers(self: *WorldPatchManager, workers: *std.Thread.Pool) void {
+        std.debug.assert(self.workers == null);
+        self.workers = workers;
+    }
+
     pub fn registerRequester(self: *WorldPatchManager, id: IdLocal) RequesterId {
         const requester_id = @as(u8, @intCast(self.requesters.items.len));
         self.requesters.appendAssumeCapacity(id);
@@ -347,8 +444,7 @@ pub const WorldPatchManager = struct {
         };
     }
 
-    pub fn getLookupsFromRectangle(patch_type_id: PatchTypeId, area: RequestRectangle, lod: LoD, out_lookups: *std.ArrayList(PatchLookup)) void {
-
+    fn getPatchRect(area: RequestRectangle, lod: LoD) PatchRect {
         // NOTE(Anders) HACK!
         const patch_lod_end = lod_3_patches_side * std.math.pow(u16, 2, config.lowest_lod - lod);
 
@@ -357,15 +453,47 @@ pub const WorldPatchManager = struct {
         const patch_z_begin_i = @as(i32, @intFromFloat(@divFloor(area.z, world_stride)));
         const patch_x_end_i = @as(i32, @intFromFloat(@ceil((area.x + area.width) / world_stride)));
         const patch_z_end_i = @as(i32, @intFromFloat(@ceil((area.z + area.height) / world_stride)));
-        const patch_x_begin = @as(u16, @intCast(std.math.clamp(patch_x_begin_i, 0, patch_lod_end)));
-        const patch_z_begin = @as(u16, @intCast(std.math.clamp(patch_z_begin_i, 0, patch_lod_end)));
-        const patch_x_end = @as(u16, @intCast(std.math.clamp(patch_x_end_i, 0, patch_lod_end)));
-        const patch_z_end = @as(u16, @intCast(std.math.clamp(patch_z_end_i, 0, patch_lod_end)));
-
-        var patch_z = patch_z_begin;
-        while (patch_z < patch_z_end) : (patch_z += 1) {
-            var patch_x = patch_x_begin;
-            while (patch_x < patch_x_end) : (patch_x += 1) {
+        return .{
+            .x_begin = @as(u16, @intCast(std.math.clamp(patch_x_begin_i, 0, patch_lod_end))),
+            .z_begin = @as(u16, @intCast(std.math.clamp(patch_z_begin_i, 0, patch_lod_end))),
+            .x_end = @as(u16, @intCast(std.math.clamp(patch_x_end_i, 0, patch_lod_end))),
+            .z_end = @as(u16, @intCast(std.math.clamp(patch_z_end_i, 0, patch_lod_end))),
+        };
+    }
+
+    fn appendLookupsInRow(patch_type_id: PatchTypeId, lod: LoD, patch_z: u16, patch_x_begin: u16, patch_x_end: u16, out_lookups: *std.ArrayList(PatchLookup)) void {
+        var patch_x = patch_x_begin;
+        while (patch_x < patch_x_end) : (patch_x += 1) {
+            out_lookups.append(.{
+                .patch_x = patch_x,
+                .patch_z = patch_z,
+                .lod = lod,
+                .patch_type_id = patch_type_id,
+            }) catch unreachable;
+        }
+    }
+
+    // Appends the patches in rect that aren't in rect_other. Only walks the rows of rect,
+    // so a small move costs about the perimeter rather than the area.
+    fn appendRectDifference(patch_type_id: PatchTypeId, lod: LoD, rect: PatchRect, rect_other: PatchRect, out_lookups: *std.ArrayList(PatchLookup)) void {
+        const other_is_empty = rect_other.x_begin >= rect_other.x_end or rect_other.z_begin >= rect_other.z_end;
+        var patch_z = rect.z_begin;
+        while (patch_z < rect.z_end) : (patch_z += 1) {
+            if (other_is_empty or patch_z < rect_other.z_begin or patch_z >= rect_other.z_end) {
+                appendLookupsInRow(patch_type_id, lod, patch_z, rect.x_begin, rect.x_end, out_lookups);
+            } else {
+                appendLookupsInRow(patch_type_id, lod, patch_z, rect.x_begin, @min(rect.x_end, rect_other.x_begin), out_lookups);
+                appendLookupsInRow(patch_type_id, lod, patch_z, @max(rect.x_begin, rect_other.x_end), rect.x_end, out_lookups);
+            }
+        }
+    }
+
+    pub fn getLookupsFromRectangle(patch_type_id: PatchTypeId, area: RequestRectangle, lod: LoD, out_lookups: *std.ArrayList(PatchLookup)) void {
+        const rect = getPatchRect(area, lod);
+        var patch_z = rect.z_begin;
+        while (patch_z < rect.z_end) : (patch_z += 1) {
+            var patch_x = rect.x_begin;
+            while (patch_x < rect.x_end) : (patch_x += 1) {
                 const patch_lookup = PatchLookup{
                     .patch_x = patch_x,
                     .patch_z = patch_z,
@@ -377,6 +505,77 @@ pub const WorldPatchManager = struct {
         }
     }
 
+    // A square region that follows a center point and keeps the patches inside it requested.
+    // NOTE: Subscriptions sharing a requester must not overlap, each patch only counts a requester once.
+    pub fn subscribeRegion(self: *WorldPatchManager, desc: RegionSubscriptionDesc) RegionSubscriptionId {
+        const subscription_id: RegionSubscriptionId = @intCast(self.region_subscriptions.items.len);
+        self.region_subscriptions.append(.{
+            .desc = desc,
+            .entered = std.ArrayList(PatchLookup).init(self.allocator),
+            .exited = std.ArrayList(PatchLookup).init(self.allocator),
+        }) catch unreachable;
+        return subscription_id;
+    }
+
+    // Moves the region, adds and removes the load requests for the patches that entered
+    // or left it and returns those. Nothing happens until the center crosses a patch edge.
+    pub fn updateRegionSubscription(self: *WorldPatchManager, subscription_id: RegionSubscriptionId, center_x: f32, center_z: f32) RegionDelta {
+        const subscription = &self.region_subscriptions.items[subscription_id];
+        const desc = subscription.desc;
+        subscription.entered.clearRetainingCapacity();
+        subscription.exited.clearRetainingCapacity();
+
+        for (&subscription.rects, 0..) |*rect_old, lod_index| {
+            if (desc.lod_mask & (@as(u16, 1) << @intCast(lod_index)) == 0) {
+                continue;
+            }
+
+            const lod: LoD = @intCast(lod_index);
+            const radius = if (desc.scale_radius_by_lod) desc.radius * std.math.pow(f32, 2.0, @floatFromInt(lod)) else desc.radius;
+            const area = RequestRectangle{
+                .x = center_x - radius,
+                .z = center_z - radius,
+                .width = radius * 2,
+                .height = radius * 2,
+            };
+            const rect_new = getPatchRect(area, lod);
+            if (rect_new.eql(rect_old.*)) {
+                continue;
+            }
+
+            appendRectDifference(desc.patch_type_id, lod, rect_old.*, rect_new, &subscription.exited);
+            appendRectDifference(desc.patch_type_id, lod, rect_new, rect_old.*, &subscription.entered);
+            rect_old.* = rect_new;
+        }
+
+        if (subscription.exited.items.len > 0) {
+            self.removeLoadRequestFromLookups(desc.requester_id, subscription.exited.items);
+        }
+        if (subscription.entered.items.len > 0) {
+            self.addLoadRequestFromLookups(desc.requester_id, subscription.entered.items, desc.prio);
+        }
+        self.region_patches_entered_total += subscription.entered.items.len;
+        self.region_patches_exited_total += subscription.exited.items.len;
+
+        return .{
+            .entered = subscription.entered.items,
+            .exited = subscription.exited.items,
+        };
+    }
+
+    // Drops every load request the subscription holds. Updating it again picks up where it left off.
+    pub fn releaseRegionSubscription(self: *WorldPatchManager, subscription_id: RegionSubscriptionId) void {
+        const subscription = &self.region_subscriptions.items[subscription_id];
+        subscription.exited.clearRetainingCapacity();
+        for (&subscription.rects, 0..) |*rect, lod_index| {
+            appendRectDifference(subscription.desc.patch_type_id, @intCast(lod_index), rect.*, .{}, &subscription.exited);
+            rect.* = .{};
+        }
+        self.removeLoadRequestFromLookups(subscription.desc.requester_id, subscription.exited.items);
+        self.region_patches_exited_total += subscription.exited.items.len;
+        subscription.exited.clearRetainingCapacity();
+    }
+
     fn updateDependencyPrioritiesRecursively(self: *WorldPatchManager, patch: *Patch, dependency_ctx: PatchTypeContext) void {
         const patch_type = self.patch_types.items[patch.lookup.patch_type_id];
         if (patch_type.dependenciesFn) |dependenciesFn| {
@@ -391,7 +590,7 @@ pub const WorldPatchManager = struct {
                 if (dependency_is_same_or_lower_prio) {
                     const prio_old = dependency_patch.highest_prio;
                     dependency_patch.highest_prio = patch.highest_prio;
-                    if (dependency_patch.data == null) {
+                    if (dependency_patch.status == .not_loaded) {
                         // This dependency hasn't been loaded yet
                         self.bucket_queue.updateElems(util.sliceOfInstanceConst(PatchHandle, &dependency_patch_handle), prio_old, dependency_patch.highest_prio);
                         self.updateDependencyPrioritiesRecursively(dependency_patch, dependency_ctx);
@@ -515,72 +714,187 @@ pub const WorldPatchManager = struct {
         if (self.bucket_queue.popElems(util.sliceOfInstance(PatchHandle, &patch_handle)) > 0) {
             var patch = self.patch_pool.getColumnPtrAssumeLive(patch_handle, .patch);
             const patch_type = self.patch_types.items[patch.patch_type_id];
-            const ctx = PatchTypeContext{
-                .allocator = self.allocator,
-                .asset_mgr = self.asset_mgr,
-                .world_patch_mgr = self,
-            };
             if (DEBUG_LOGGING) std.log.debug("WPM: Loading {}, Pr{}", .{ patch.lookup, @intFromEnum(patch.highest_prio) });
-            patch_type.loadFn(patch, ctx);
+            patch_type.loadFn(patch, self.patchTypeContext());
             if (patch.data != null) {
                 patch.status = .loaded;
             }
             std.debug.assert(patch.status != .not_loaded);
+            self.patches_loaded_total += 1;
 
-            // Unload any dependency patches
-            if (patch_type.dependenciesFn) |dependenciesFn| {
-                const dependency_ctx = PatchTypeContext{
-                    .allocator = self.allocator,
-                    .asset_mgr = self.asset_mgr,
-                    .world_patch_mgr = self,
-                };
+            self.releaseDependencies(patch.lookup);
+        }
+    }
 
-                var dependency_list: [max_dependencies]PatchLookup = undefined;
-                const dependency_slice = dependenciesFn(patch.lookup, &dependency_list, dependency_ctx);
-                for (dependency_slice) |dependency_lookup| {
-                    const dependency_patch_handle = self.handle_map_by_lookup.get(dependency_lookup).?;
-                    const dependency_patch: *Patch = self.patch_pool.getColumnPtrAssumeLive(dependency_patch_handle, .patch);
-                    dependency_patch.removeRequester(dependency_requester_id);
-                    if (!dependency_patch.hasRequests()) {
-                        if (DEBUG_LOGGING) std.log.debug("WPM: Unloading {} dependent={}", .{ dependency_patch.lookup, patch.lookup });
-                        self.unloadPatch(dependency_patch_handle, dependency_patch);
-                    }
+    // Spends at most roughly budget_ms on the calling thread.
+    // Without workers this loads patches synchronously, one at a time, until the budget runs out.
+    // With workers it integrates finished loads, then tops up the workers from the queue.
+    pub fn tickBudgeted(self: *WorldPatchManager, budget_ms: f64) void {
+        const trazy_zone = ztracy.ZoneNC(@src(), "WorldPatchManager budgeted", 0x00_00_00_ff);
+        defer trazy_zone.End();
+
+        var timer = std.time.Timer.start() catch unreachable;
+        const budget_ns: u64 = @intFromFloat(budget_ms * std.time.ns_per_ms);
+
+        if (self.workers == null) {
+            while (self.bucket_queue.peek()) {
+                self.tickOne();
+                if (timer.read() >= budget_ns) {
+                    break;
                 }
             }
+            return;
         }
+
+        // Integrate first, so that dependencies finishing this frame unblock their dependents below.
+        while (timer.read() < budget_ns) {
+            const result = self.load_results.pop() orelse break;
+            self.patches_in_flight -= 1;
+            self.integrateLoadResult(result);
+        }
+
+        self.dispatchLoads();
     }
 
-    fn unloadPatch(self: *WorldPatchManager, patch_handle: PatchHandle, patch: *Patch) void {
-        if (DEBUG_LOGGING) std.log.debug("WPM: Unloading {}", .{patch.lookup});
+    pub fn isIdle(self: *WorldPatchManager) bool {
+        return !self.bucket_queue.peek() and self.patches_in_flight == 0;
+    }
+
+    fn patchTypeContext(self: *WorldPatchManager) PatchTypeContext {
+        return .{
+            .allocator = self.allocator,
+            .asset_mgr = self.asset_mgr,
+            .world_patch_mgr = self,
+        };
+    }
+
+    fn dependencyStatus(self: *WorldPatchManager, patch: *Patch) DependencyStatus {
+        const patch_type = self.patch_types.items[patch.patch_type_id];
+        const dependenciesFn = patch_type.dependenciesFn orelse return .ready;
+
+        var dependency_list: [max_dependencies]PatchLookup = undefined;
+        const dependency_slice = dependenciesFn(patch.lookup, &dependency_list, self.patchTypeContext());
+        var status: DependencyStatus = .ready;
+        for (dependency_slice) |dependency_lookup| {
+            const dependency_patch_handle = self.handle_map_by_lookup.get(dependency_lookup).?;
+            const dependency_patch: *Patch = self.patch_pool.getColumnPtrAssumeLive(dependency_patch_handle, .patch);
+            switch (dependency_patch.status) {
+                .not_loaded => return .queued,
+                .loading => status = .loading,
+                else => {},
+            }
+        }
+        return status;
+    }
+
+    fn dispatchLoads(self: *WorldPatchManager) void {
+        const workers = self.workers.?;
+
+        // Bounded, since patches waiting on dependencies are rotated to the bottom of their bucket.
+        var attempts: u32 = 0;
+        while (self.patches_in_flight < max_patches_in_flight and attempts < max_patches_in_flight * 2) : (attempts += 1) {
+            var patch_handle: PatchHandle = PatchHandle.nil;
+            if (self.bucket_queue.popElems(util.sliceOfInstance(PatchHandle, &patch_handle)) == 0) {
+                break;
+            }
+
+            const patch = self.patch_pool.getColumnPtrAssumeLive(patch_handle, .patch);
+            switch (self.dependencyStatus(patch)) {
+                .ready => {},
+                .loading, .queued => {
+                    // Let the rest of the bucket through while the dependency is waiting or on the workers.
+                    self.bucket_queue.pushElemsToBottomOfBucket(util.sliceOfInstanceConst(PatchHandle, &patch_handle), patch.highest_prio);
+                    continue;
+                },
+            }
+
+            if (DEBUG_LOGGING) std.log.debug("WPM: Dispatching {}, Pr{}", .{ patch.lookup, @intFromEnum(patch.highest_prio) });
+            patch.status = .loading;
+            self.patches_in_flight += 1;
+
+            var job = PatchLoadJob{
+                .patch_handle = patch_handle,
+                .patch = patch.*,
+            };
+            job.patch.status = .not_loaded;
+            workers.spawnWg(&self.load_wait_group, loadPatchJob, .{ self, job });
+        }
+    }
+
+    fn loadPatchJob(self: *WorldPatchManager, job: PatchLoadJob) void {
+        const trazy_zone = ztracy.ZoneNC(@src(), "WorldPatchManager worker load", 0x00_00_00_ff);
+        defer trazy_zone.End();
+
+        var patch = job.patch;
+        const patch_type = self.patch_types.items[patch.patch_type_id];
+        patch_type.loadFn(&patch, self.patchTypeContext());
         if (patch.data != null) {
-            self.allocator.free(patch.data.?);
-            patch.data = null;
-        } else {
-            if (patch.status == .not_loaded) {
-                self.bucket_queue.removeElems(util.sliceOfInstanceConst(PatchHandle, &patch_handle));
+            patch.status = .loaded;
+        }
+        std.debug.assert(patch.status != .not_loaded);
+
+        // Can't fail, the number of jobs in flight is capped to the queue capacity.
+        const pushed = self.load_results.push(.{
+            .patch_handle = job.patch_handle,
+            .lookup = patch.lookup,
+            .status = patch.status,
+            .data = patch.data,
+        });
+        std.debug.assert(pushed);
+    }
+
+    fn integrateLoadResult(self: *WorldPatchManager, result: PatchLoadResult) void {
+        if (!self.patch_pool.isLiveHandle(result.patch_handle)) {
+            // Unloaded while a worker was busy with it, nobody wants the data anymore.
+            // The worker is done with the dependencies now, so they can finally go too.
+            if (DEBUG_LOGGING) std.log.debug("WPM: Discarding {}", .{result.lookup});
+            if (result.data) |data| {
+                self.allocator.free(data);
             }
+            self.releaseDependencies(result.lookup);
+            return;
+        }
 
-            // Unload any dependency patches
-            const patch_type = self.patch_types.items[patch.patch_type_id];
-            if (patch_type.dependenciesFn) |dependenciesFn| {
-                const dependency_ctx = PatchTypeContext{
-                    .allocator = self.allocator,
-                    .asset_mgr = self.asset_mgr,
-                    .world_patch_mgr = self,
-                };
+        const patch: *Patch = self.patch_pool.getColumnPtrAssumeLive(result.patch_handle, .patch);
+        std.debug.assert(patch.lookup.eql(result.lookup));
+        std.debug.assert(patch.status == .loading);
+        patch.status = result.status;
+        patch.data = result.data;
+        self.patches_loaded_total += 1;
 
-                var dependency_list: [max_dependencies]PatchLookup = undefined;
-                const dependency_slice = dependenciesFn(patch.lookup, &dependency_list, dependency_ctx);
-                for (dependency_slice) |dependency_lookup| {
-                    const dependency_patch_handle = self.handle_map_by_lookup.get(dependency_lookup).?;
-                    const dependency_patch: *Patch = self.patch_pool.getColumnPtrAssumeLive(dependency_patch_handle, .patch);
-                    dependency_patch.removeRequester(dependency_requester_id);
-                    if (!dependency_patch.hasRequests()) {
-                        self.unloadPatch(dependency_patch_handle, dependency_patch);
-                    }
+        self.releaseDependencies(patch.lookup);
+    }
+
+    fn releaseDependencies(self: *WorldPatchManager, lookup: PatchLookup) void {
+        const patch_type = self.patch_types.items[lookup.patch_type_id];
+        if (patch_type.dependenciesFn) |dependenciesFn| {
+            var dependency_list: [max_dependencies]PatchLookup = undefined;
+            const dependency_slice = dependenciesFn(lookup, &dependency_list, self.patchTypeContext());
+            for (dependency_slice) |dependency_lookup| {
+                const dependency_patch_handle = self.handle_map_by_lookup.get(dependency_lookup).?;
+                const dependency_patch: *Patch = self.patch_pool.getColumnPtrAssumeLive(dependency_patch_handle, .patch);
+                dependency_patch.removeRequester(dependency_requester_id);
+                if (!dependency_patch.hasRequests()) {
+                    if (DEBUG_LOGGING) std.log.debug("WPM: Unloading {} dependent={}", .{ dependency_patch.lookup, lookup });
+                    self.unloadPatch(dependency_patch_handle, dependency_patch);
                 }
             }
         }
+    }
+
+    fn unloadPatch(self: *WorldPatchManager, patch_handle: PatchHandle, patch: *Patch) void {
+        if (DEBUG_LOGGING) std.log.debug("WPM: Unloading {}", .{patch.lookup});
+        if (patch.data != null) {
+            self.allocator.free(patch.data.?);
+            patch.data = null;
+        } else if (patch.status == .not_loaded) {
+            self.bucket_queue.removeElems(util.sliceOfInstanceConst(PatchHandle, &patch_handle));
+
+            // Unload any dependency patches. Finished patches have already released theirs.
+            self.releaseDependencies(patch.lookup);
+        }
+        // NOTE: A .loading patch keeps its dependencies, the worker may still be reading them.
+        // integrateLoadResult discards the result and releases them, since the handle won't be live anymore.
 
         self.patch_pool.removeAssumeLive(patch_handle);
         _ = self.handle_map_by_lookup.remove(patch.lookup);
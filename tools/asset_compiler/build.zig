@@ -1,6 +1,9 @@
 const std = @import("std");
 const Builder = std.build.Builder;
 
+const stb_path = "../../external/The-Forge/Common_3/Utilities/ThirdParty/OpenSource/Nothings";
+const ispc_texcomp_path = "../../external/The-Forge/Common_3/Tools/ThirdParty/OpenSource/ISPCTextureCompressor/ispc_texcomp";
+
 pub fn build(b: *std.Build) void {
     const target = b.standardTargetOptions(.{});
     const optimize = b.standardOptimizeOption(.{});
@@ -18,6 +21,54 @@ pub fn build(b: *std.Build) void {
         .imports = &.{},
     }));
 
+    const abi = (std.zig.system.resolveTargetQuery(target.query) catch unreachable).abi;
+    exe.linkLibC();
+    if (abi != .msvc) {
+        exe.linkLibCpp();
+    }
+
+    // stb_image and stb_image_resize
+    exe.addIncludePath(b.path(stb_path));
+    exe.addCSourceFiles(.{
+        .files = &.{"src/single_header_wrapper.cpp"},
+        .flags = &.{"-O2"},
+    });
+
+    // ispc_texcomp, the kernels need the ISPC compiler: https://ispc.github.io/
+    // NOTE: Without it the build still works, texture_compiler.zig then falls back to texconv.exe
+    // like before ispc_texcomp. -Dispc points at a compiler that isn't on the PATH.
+    const ispc = b.option([]const u8, "ispc", "Path to the ISPC compiler") orelse (b.findProgram(&.{"ispc"}, &.{}) catch null);
+    const ispc_target = b.option([]const u8, "ispc-target", "ISPC target the texture kernels are compiled for") orelse switch (target.result.cpu.arch) {
+        .aarch64 => "neon-i32x4",
+        else => "sse4-i32x4",
+    };
+    const options = b.addOptions();
+    exe.root_module.addOptions("build_options", options);
+    options.addOption(bool, "ispc_texcomp", ispc != null);
+    if (ispc) |ispc_path| {
+        const ispc_arch = switch (target.result.cpu.arch) {
+            .aarch64 => "aarch64",
+            else => "x86-64",
+        };
+        const ispc_cmd = b.addSystemCommand(&.{ ispc_path, "-O2", "--opt=fast-math", "--pic" });
+        ispc_cmd.addArg(b.fmt("--arch={s}", .{ispc_arch}));
+        ispc_cmd.addArg(b.fmt("--target={s}", .{ispc_target}));
+        ispc_cmd.addFileArg(b.path(ispc_texcomp_path ++ "/kernel.ispc"));
+        ispc_cmd.addArg("-o");
+        const kernel_object = ispc_cmd.addOutputFileArg("kernel_ispc.o");
+        ispc_cmd.addArg("-h");
+        const kernel_header = ispc_cmd.addOutputFileArg("kernel_ispc.h");
+
+        exe.addObjectFile(kernel_object);
+        exe.addIncludePath(kernel_header.dirname());
+        exe.addCSourceFiles(.{
+            .files = &.{ispc_texcomp_path ++ "/ispc_texcomp.cpp"},
+            .flags = &.{"-O2"},
+        });
+    } else {
+        std.log.warn("ispc not found, textures will be compressed with texconv.exe", .{});
+    }
+
     b.installArtifact(exe);
 
     const run_cmd = b.addRunArtifact(exe);
@@ -27,4 +78,15 @@ pub fn build(b: *std.Build) void {
 
     const run_step = b.step("run", "Run the app");
     run_step.dependOn(&run_cmd.step);
+
+    // Times full rebuilds of the repo's content.
+    const bench_cmd = b.addRunArtifact(exe);
+    bench_cmd.setCwd(b.path("."));
+    bench_cmd.addArgs(&.{ "--benchmark", "--content", "../../content" });
+    if (b.args) |args| {
+        bench_cmd.addArgs(args);
+    }
+
+    const bench_step = b.step("bench", "Benchmark a full texture rebuild");
+    bench_step.dependOn(&bench_cmd.step);
 }
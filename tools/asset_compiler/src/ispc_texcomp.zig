@@ -0,0 +1,37 @@
+// Bindings for The-Forge's vendored ISPCTextureCompressor. ispc_texcomp.h is C++ only (extern "C"
+// blocks) so it can't go through @cImport, these mirror its declarations.
+
+pub const RgbaSurface = extern struct {
+    ptr: [*]u8,
+    width: i32,
+    height: i32,
+    stride: i32, // In bytes
+};
+
+pub const Bc7EncSettings = extern struct {
+    mode_selection: [4]bool,
+    refine_iterations: [8]c_int,
+
+    skip_mode2: bool,
+    fast_skip_treshold_mode1: c_int,
+    fast_skip_treshold_mode3: c_int,
+    fast_skip_treshold_mode7: c_int,
+
+    mode45_channel0: c_int,
+    refine_iterations_channel: c_int,
+
+    channels: c_int,
+};
+
+pub extern fn GetProfile_fast(settings: *Bc7EncSettings) void;
+pub extern fn GetProfile_basic(settings: *Bc7EncSettings) void;
+pub extern fn GetProfile_alpha_fast(settings: *Bc7EncSettings) void;
+pub extern fn GetProfile_alpha_basic(settings: *Bc7EncSettings) void;
+
+// Surfaces are a multiple of 4 pixels in both directions. BC1/BC3/BC7 read RGBA8, BC4 R8 and BC5
+// RG8. Blocks are written in raster order, 8 bytes each for BC1/BC4 and 16 for the rest.
+pub extern fn CompressBlocksBC1(src: *const RgbaSurface, dst: [*]u8) void;
+pub extern fn CompressBlocksBC3(src: *const RgbaSurface, dst: [*]u8) void;
+pub extern fn CompressBlocksBC4(src: *const RgbaSurface, dst: [*]u8) void;
+pub extern fn CompressBlocksBC5(src: *const RgbaSurface, dst: [*]u8) void;
+pub extern fn CompressBlocksBC7(src: *const RgbaSurface, dst: [*]u8, settings: *Bc7EncSettings) void;
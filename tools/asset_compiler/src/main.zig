@@ -1,27 +1,16 @@
 const std = @import("std");
 const args = @import("args");
 
-const TextureFormat = enum {
-    BC1_UNORM,
-    BC1_UNORM_SRGB,
-    BC3_UNORM,
-    BC4_UNORM,
-    BC5_UNORM,
-    BC7_UNORM,
-    BC7_UNORM_SRGB,
-};
+const texture_compiler = @import("texture_compiler.zig");
+const TextureFormat = texture_compiler.TextureFormat;
+const TextureInfoV1 = texture_compiler.TextureInfoV1;
 
-const TextureInfoV1 = struct {
-    destination_path: []const u8,
-    source_path: []const u8,
-    dep_path: []const u8,
-    format: TextureFormat,
-    width: ?u32,
-    height: ?u32,
-    mip_count: ?u32,
-    srgb: ?bool,
-    invert_y: ?bool,
-};
+// NOTE: std.fs.cwd() is tools/binaries/asset_compiler/
+const content_path = "../../../content";
+const default_output_path = "../../../zig-out/bin/content";
+const benchmark_output_path = ".bench_tmp/asset_compiler";
+const cache_file_name = ".texture_cache";
+const synthetic_texture_count = 32;
 
 pub fn main() !void {
     const parsed_args = args.parseForCurrentProcess(struct {
@@ -29,11 +18,17 @@ pub fn main() !void {
         output: []const u8 = "",
         dep: []const u8 = "",
         @"generate-metadata": bool = false,
+        all: bool = false, // Compile every .texture in --content into --output
+        content: []const u8 = content_path,
+        jobs: ?u32 = null, // Worker threads besides the main one
+        @"no-cache": bool = false,
+        benchmark: bool = false,
 
         pub const shorthands = .{
             .i = "input",
             .o = "output",
             .d = "dep",
+            .j = "jobs",
         };
     }, std.heap.page_allocator, .print) catch unreachable;
     defer parsed_args.deinit();
@@ -48,15 +43,37 @@ pub fn main() !void {
         return;
     }
 
-    var file = try std.fs.openFileAbsolute(parsed_args.options.input, .{});
+    const cpu_count: u32 = @intCast(std.Thread.getCpuCount() catch 1);
+
+    if (parsed_args.options.benchmark) {
+        try benchmarkContentBuild(arena, parsed_args.options.content, parsed_args.options.jobs orelse cpu_count - 1);
+        return;
+    }
+
+    if (parsed_args.options.all) {
+        const output_path = if (parsed_args.options.output.len > 0) parsed_args.options.output else default_output_path;
+        const requests = try collectContentTextures(arena, parsed_args.options.content, output_path);
+        try compileTextures(arena, requests, parsed_args.options.jobs orelse cpu_count - 1, if (parsed_args.options.@"no-cache") null else output_path);
+        return;
+    }
+
+    // AssetCooker runs one command per processor, if they all try to use all the processors, it
+    // ends up a lot slower! Single textures stay on this thread unless asked otherwise.
+    var texture_info = try parseTextureInfo(arena, parsed_args.options.input);
+    texture_info.destination_path = try arena.dupe(u8, parsed_args.options.output);
+    texture_info.dep_path = try arena.dupe(u8, parsed_args.options.dep);
+
+    try executeTextureConversionV1(&texture_info, arena, parsed_args.options.jobs orelse 0);
+}
+
+fn parseTextureInfo(arena: std.mem.Allocator, path: []const u8) !TextureInfoV1 {
+    var file = try std.fs.cwd().openFile(path, .{});
     defer file.close();
 
     var buf_reader = std.io.bufferedReader(file.reader());
     var in_stream = buf_reader.reader();
 
     var texture_info = std.mem.zeroes(TextureInfoV1);
-    texture_info.destination_path = try arena.dupe(u8, parsed_args.options.output);
-    texture_info.dep_path = try arena.dupe(u8, parsed_args.options.dep);
 
     var buffer: [1024]u8 = undefined;
     while (try in_stream.readUntilDelimiterOrEof(&buffer, '\n')) |line| {
@@ -139,127 +156,207 @@ pub fn main() !void {
         }
     }
 
-    try executeTextureConversionV1(&texture_info, arena);
+    return texture_info;
+}
+
+fn hashFile(path: []const u8) !u64 {
+    var file = try std.fs.cwd().openFile(path, .{});
+    defer file.close();
+
+    var hasher = std.hash.XxHash3.init(0);
+    var buffer: [4096]u8 = undefined;
+    while (true) {
+        const read = try file.read(&buffer);
+        if (read == 0) {
+            break;
+        }
+        hasher.update(buffer[0..read]);
+    }
+    return hasher.final();
 }
 
-fn executeTextureConversionV1(desc: *TextureInfoV1, arena: std.mem.Allocator) !void {
-    // Build texconv.exe process argument list
-    // =======================================
-    var argv = std.ArrayList([]const u8).init(arena);
+// texconv's naming: the source's lowercased file name with a .dds extension, in the output folder.
+fn ddsPath(arena: std.mem.Allocator, output_dir: []const u8, source_path: []const u8) ![]const u8 {
+    const basename = std.fs.path.basename(source_path);
+    const stem = basename[0 .. basename.len - std.fs.path.extension(basename).len];
+    const file_name = try std.fmt.allocPrint(arena, "{s}.dds", .{stem});
+    _ = std.ascii.lowerString(file_name, file_name);
+    return std.fs.path.join(arena, &.{ output_dir, file_name });
+}
 
-    // Executable path
-    // NOTE: std.fs.cwd() is tools/binaries/asset_compiler/
+fn executeTextureConversionV1(desc: *TextureInfoV1, arena: std.mem.Allocator, worker_count: u32) !void {
     const cwd_absolute = try std.fs.cwd().realpathAlloc(arena, ".");
-    var texconv_path_buffer: [1024]u8 = undefined;
-    const textcov_absolute_path = try std.fmt.bufPrint(&texconv_path_buffer, "{s}/../texconv/texconv.exe", .{cwd_absolute});
-    try argv.append(textcov_absolute_path);
-
-    // Override existing output file
-    try argv.append("-y");
-
-    // Force lowercase out file name
-    try argv.append("-l");
-
-    // Do not display texconv.exe logo
-    try argv.append("-nologo");
-
-    // Use a single processor
-    // AssetCooker is running one command per processor, if they all try to use all the processors, it ends up a lot slower!
-    try argv.append("-singleproc");
-
-    // Compress alpha separately
-    try argv.append("-sepalpha");
-
-    // Generate DX10 headers
-    try argv.append("-dx10");
-
-    // Specify the output image format
-    try argv.append("-f");
-    switch (desc.format) {
-        .BC1_UNORM => {
-            try argv.append("BC1_UNORM");
-        },
-        .BC1_UNORM_SRGB => {
-            try argv.append("BC1_UNORM_SRGB");
-        },
-        .BC3_UNORM => {
-            try argv.append("BC3_UNORM");
-        },
-        .BC4_UNORM => {
-            try argv.append("BC4_UNORM");
-        },
-        .BC5_UNORM => {
-            try argv.append("BC5_UNORM");
-        },
-        .BC7_UNORM => {
-            try argv.append("BC7_UNORM");
-        },
-        .BC7_UNORM_SRGB => {
-            try argv.append("BC7_UNORM_SRGB");
-        },
-    }
+    var source_path_buffer: [1024]u8 = undefined;
+    const source_absolute_path = try std.fmt.bufPrint(&source_path_buffer, "{s}/../../../content/{s}", .{cwd_absolute, desc.source_path});
 
-    // Optional: Specify the output image width
-    if (desc.width) |width| {
-        try argv.append("-w");
-        var buf: [8]u8 = undefined;
-        try argv.append(try std.fmt.bufPrint(&buf, "{d}", .{width}));
+    var requests = [_]texture_compiler.Request{.{
+        .name = desc.source_path,
+        .source_path = source_absolute_path,
+        .output_path = try ddsPath(arena, desc.destination_path, desc.source_path),
+        .info = desc.*,
+    }};
+    const compiler = texture_compiler.TextureCompiler.create(std.heap.c_allocator, worker_count);
+    defer compiler.destroy();
+    compiler.compile(&requests, null);
+
+    // Write the .dep file
+    {
+        var file = try std.fs.cwd().createFile(desc.dep_path, .{});
+        defer file.close();
+
+        // Add the source image as input
+        try file.writeAll("INPUT: ");
+        try file.writeAll(source_absolute_path);
     }
 
-    // Optional: Specify the output image height
-    if (desc.height) |height| {
-        try argv.append("-h");
-        var buf: [8]u8 = undefined;
-        try argv.append(try std.fmt.bufPrint(&buf, "{d}", .{height}));
+    if (requests[0].result == .failed) {
+        return error.TextureConversionFailed;
     }
+}
+
+// Every .texture under content, writing to the same layout compile_textures.py installs into.
+fn collectContentTextures(arena: std.mem.Allocator, content_dir_path: []const u8, output_path: []const u8) ![]texture_compiler.Request {
+    var content_dir = try std.fs.cwd().openDir(content_dir_path, .{.iterate = true, .no_follow = true});
+    defer content_dir.close();
+    var walker = try content_dir.walk(arena);
+    defer walker.deinit();
 
-    // Optional: Specify a desired mip map count
-    if (desc.mip_count) |mip_count| {
-        if (mip_count > 0) {
-            try argv.append("-m");
-            var buf: [8]u8 = undefined;
-            try argv.append(try std.fmt.bufPrint(&buf, "{d}", .{mip_count}));
+    var requests = std.ArrayList(texture_compiler.Request).init(arena);
+    while (try walker.next()) |entry| {
+        if (entry.kind != .file or !std.mem.eql(u8, std.fs.path.extension(entry.basename), ".texture")) {
+            continue;
         }
+
+        const metadata_path = try std.fs.path.join(arena, &.{ content_dir_path, entry.path });
+        const info = try parseTextureInfo(arena, metadata_path);
+        const source_dir = std.fs.path.dirname(info.source_path) orelse "";
+        try requests.append(.{
+            .name = try arena.dupe(u8, entry.path),
+            .source_path = try std.fs.path.join(arena, &.{ content_dir_path, info.source_path }),
+            .output_path = try ddsPath(arena, try std.fs.path.join(arena, &.{ output_path, source_dir }), info.source_path),
+            .info = info,
+            .metadata_hash = try hashFile(metadata_path),
+        });
     }
+    return requests.items;
+}
 
-    // Optional: Specify the sRGB (input & output) flag
-    if (desc.srgb) |srgb| {
-        if (srgb) {
-            try argv.append("-srgb");
-        }
+fn compileTextures(arena: std.mem.Allocator, requests: []texture_compiler.Request, worker_count: u32, cache_dir: ?[]const u8) !void {
+    var cache: ?texture_compiler.Cache = null;
+    defer if (cache) |*loaded| loaded.deinit();
+    var cache_path: []const u8 = "";
+    if (cache_dir) |dir| {
+        cache_path = try std.fs.path.join(arena, &.{ dir, cache_file_name });
+        cache = texture_compiler.Cache.load(std.heap.c_allocator, cache_path);
     }
 
-    // Optional: Specify the Invert Y flag
-    if (desc.invert_y) |invert_y| {
-        if (invert_y) {
-            try argv.append("-inverty");
-        }
+    const compiler = texture_compiler.TextureCompiler.create(std.heap.c_allocator, worker_count);
+    defer compiler.destroy();
+
+    var timer = try std.time.Timer.start();
+    compiler.compile(requests, if (cache) |*loaded| loaded else null);
+    const elapsed_ns = timer.read();
+
+    const summary = summarize(requests);
+    std.log.info("{} textures: {} compiled, {} up to date, {} failed in {d:.2} s", .{
+        requests.len,
+        summary.compiled,
+        summary.skipped,
+        summary.failed,
+        @as(f64, @floatFromInt(elapsed_ns)) / std.time.ns_per_s,
+    });
+
+    if (cache) |*loaded| {
+        loaded.update(requests);
+        try loaded.save(cache_path);
+    }
+
+    if (summary.failed > 0) {
+        return error.TextureConversionFailed;
     }
+}
 
-    // Specify the destination image folder path
-    try argv.append("-o");
-    try argv.append(desc.destination_path);
+const Summary = struct {
+    compiled: u32 = 0,
+    skipped: u32 = 0,
+    failed: u32 = 0,
+    pixels: u64 = 0,
+};
 
-    // Specify the source image file path
-    var source_path_buffer: [1024]u8 = undefined;
-    const source_absolute_path = try std.fmt.bufPrint(&source_path_buffer, "{s}/../../../content/{s}", .{cwd_absolute, desc.source_path});
-    try argv.append(source_absolute_path);
+fn summarize(requests: []const texture_compiler.Request) Summary {
+    var summary = Summary{};
+    for (requests) |request| {
+        switch (request.result) {
+            .compiled => summary.compiled += 1,
+            .skipped => summary.skipped += 1,
+            .failed => summary.failed += 1,
+        }
+        summary.pixels += request.pixels;
+    }
+    return summary;
+}
 
-    var cmd = std.process.Child.init(@ptrCast(argv.items), std.heap.page_allocator);
-    try cmd.spawn();
+// Full content rebuilds on one thread and on every core, then a rebuild where the cache skips
+// everything. Uses generated images when there's no content to compile. Outputs go to
+// .bench_tmp, the installed textures are left alone.
+fn benchmarkContentBuild(arena: std.mem.Allocator, content_dir_path: []const u8, worker_count: u32) !void {
+    const content_requests = collectContentTextures(arena, content_dir_path, benchmark_output_path) catch &.{};
+    var requests = content_requests;
+    if (requests.len == 0) {
+        const formats = [_]TextureFormat{ .BC1_UNORM_SRGB, .BC5_UNORM, .BC1_UNORM, .BC4_UNORM, .BC7_UNORM_SRGB, .BC3_UNORM };
+        const synthetic_requests = try arena.alloc(texture_compiler.Request, synthetic_texture_count);
+        for (synthetic_requests, 0..) |*request, i| {
+            var info = std.mem.zeroes(TextureInfoV1);
+            info.format = formats[i % formats.len];
+            request.* = .{
+                .name = try std.fmt.allocPrint(arena, "synthetic_{}", .{i}),
+                .source_path = null,
+                .synthetic_seed = @intCast(i),
+                .output_path = try std.fmt.allocPrint(arena, "{s}/synthetic_{}.dds", .{ benchmark_output_path, i }),
+                .info = info,
+            };
+        }
+        requests = synthetic_requests;
+    }
+    defer std.fs.cwd().deleteTree(benchmark_output_path) catch {};
 
-    // Write the .dep file
-    {
-        var file = try std.fs.cwd().createFile(desc.dep_path, .{});
-        defer file.close();
+    std.debug.print("{} {s} textures\n", .{ requests.len, if (content_requests.len > 0) "content" else "generated" });
+    try benchmarkBuild(requests, "1 thread, cold", 0, false);
+    if (worker_count > 0) {
+        try benchmarkBuild(requests, "all threads, cold", worker_count, false);
+    }
+    try benchmarkBuild(requests, "all threads, cached", worker_count, true);
+}
 
-        // Add the source image as input
-        try file.writeAll("INPUT: ");
-        try file.writeAll(source_absolute_path);
+fn benchmarkBuild(requests: []texture_compiler.Request, name: []const u8, worker_count: u32, use_cache: bool) !void {
+    var cache = texture_compiler.Cache.init(std.heap.c_allocator);
+    defer cache.deinit();
+    if (use_cache) {
+        cache.update(requests);
+    }
+
+    for (requests) |*request| {
+        request.result = .failed;
+        request.pixels = 0;
     }
 
-    const term = try cmd.wait();
-    std.debug.assert(term == .Exited);
+    const compiler = texture_compiler.TextureCompiler.create(std.heap.c_allocator, worker_count);
+    defer compiler.destroy();
+
+    var timer = try std.time.Timer.start();
+    compiler.compile(requests, if (use_cache) &cache else null);
+    const seconds = @as(f64, @floatFromInt(timer.read())) / std.time.ns_per_s;
+
+    const summary = summarize(requests);
+    std.debug.print("{s: <22} {d: >8.3} s  {d: >7.1} textures/s  {d: >8.1} MPixel/s  {} compiled, {} cached, {} failed\n", .{
+        name,
+        seconds,
+        @as(f64, @floatFromInt(requests.len)) / seconds,
+        @as(f64, @floatFromInt(summary.pixels)) / 1_000_000.0 / seconds,
+        summary.compiled,
+        summary.skipped,
+        summary.failed,
+    });
 }
 
 fn generateMetadata(arena: std.mem.Allocator) !void {
@@ -0,0 +1,662 @@
+const std = @import("std");
+const build_options = @import("build_options");
+const ispc = @import("ispc_texcomp.zig");
+
+const c = @cImport({
+    @cInclude("stb_image.h");
+    @cInclude("stb_image_resize.h");
+});
+
+// Compiles textures in process: stb decodes the source and builds the mip chain, ispc_texcomp
+// encodes the blocks. Every texture is a job on the pool, and once its mips are ready every strip
+// of block rows becomes a job too, so a few big textures still keep every worker busy. The last
+// strip to finish writes the .dds.
+// NOTE: Builds without the ISPC compiler have no ispc_texcomp, every texture job runs texconv.exe
+// then, see runTexconv().
+
+// Part of every content hash, bump it when the output changes for the same inputs.
+const compiler_version: u64 = 1;
+const block_dimension = 4;
+// Block rows of one mip are split into jobs of roughly this many blocks.
+const blocks_per_job = 4096;
+const max_source_size = 512 * 1024 * 1024;
+// Relative to std.fs.cwd(), tools/binaries/asset_compiler/
+const texconv_path = "../texconv/texconv.exe";
+
+pub const TextureFormat = enum {
+    BC1_UNORM,
+    BC1_UNORM_SRGB,
+    BC3_UNORM,
+    BC4_UNORM,
+    BC5_UNORM,
+    BC7_UNORM,
+    BC7_UNORM_SRGB,
+};
+
+pub const TextureInfoV1 = struct {
+    destination_path: []const u8,
+    source_path: []const u8,
+    dep_path: []const u8,
+    format: TextureFormat,
+    width: ?u32,
+    height: ?u32,
+    mip_count: ?u32,
+    srgb: ?bool,
+    invert_y: ?bool,
+};
+
+pub const Result = enum {
+    failed,
+    compiled,
+    skipped, // Unchanged since the cached build
+};
+
+pub const Request = struct {
+    name: []const u8, // Cache key and log name
+    source_path: ?[]const u8, // Null for the benchmark's generated images
+    synthetic_seed: u32 = 0,
+    output_path: []const u8, // The .dds file
+    info: TextureInfoV1,
+    metadata_hash: u64 = 0, // Of the .texture file, so edited settings rebuild too
+
+    // Written by the texture's jobs, only read after TextureCompiler.compile returns.
+    result: Result = .failed,
+    content_hash: u64 = 0,
+    pixels: u64 = 0, // Encoded over all mips
+};
+
+// Maps request names to the content hash of their last successful build. Stored next to the
+// outputs, one "<hash> <name>" line per texture.
+pub const Cache = struct {
+    arena_state: std.heap.ArenaAllocator,
+    entries: std.StringHashMap(u64),
+
+    pub fn init(allocator: std.mem.Allocator) Cache {
+        return .{
+            .arena_state = std.heap.ArenaAllocator.init(allocator),
+            .entries = std.StringHashMap(u64).init(allocator),
+        };
+    }
+
+    // A missing or unreadable cache file is an empty cache.
+    pub fn load(allocator: std.mem.Allocator, path: []const u8) Cache {
+        var cache = Cache.init(allocator);
+        const arena = cache.arena_state.allocator();
+        const contents = std.fs.cwd().readFileAlloc(arena, path, std.math.maxInt(u32)) catch return cache;
+        var lines = std.mem.tokenizeScalar(u8, contents, '\n');
+        while (lines.next()) |line| {
+            const separator = std.mem.indexOfScalar(u8, line, ' ') orelse continue;
+            const hash = std.fmt.parseInt(u64, line[0..separator], 16) catch continue;
+            const name = std.mem.trimRight(u8, line[separator + 1 ..], "\r");
+            cache.entries.put(name, hash) catch unreachable;
+        }
+        return cache;
+    }
+
+    pub fn deinit(self: *Cache) void {
+        self.entries.deinit();
+        self.arena_state.deinit();
+    }
+
+    pub fn isUpToDate(self: *const Cache, request: *const Request) bool {
+        const hash = self.entries.get(request.name) orelse return false;
+        if (hash != request.content_hash) {
+            return false;
+        }
+        std.fs.cwd().access(request.output_path, .{}) catch return false;
+        return true;
+    }
+
+    pub fn update(self: *Cache, requests: []const Request) void {
+        const arena = self.arena_state.allocator();
+        for (requests) |request| {
+            if (request.result == .failed) {
+                _ = self.entries.remove(request.name);
+            } else {
+                self.entries.put(arena.dupe(u8, request.name) catch unreachable, request.content_hash) catch unreachable;
+            }
+        }
+    }
+
+    pub fn save(self: *const Cache, path: []const u8) !void {
+        if (std.fs.path.dirname(path)) |dir| {
+            try std.fs.cwd().makePath(dir);
+        }
+        var file = try std.fs.cwd().createFile(path, .{});
+        defer file.close();
+
+        var buffered_writer = std.io.bufferedWriter(file.writer());
+        const writer = buffered_writer.writer();
+        var iterator = self.entries.iterator();
+        while (iterator.next()) |entry| {
+            try writer.print("{x:0>16} {s}\n", .{ entry.value_ptr.*, entry.key_ptr.* });
+        }
+        try buffered_writer.flush();
+    }
+};
+
+pub const TextureCompiler = struct {
+    allocator: std.mem.Allocator, // Shared by the jobs, has to be thread safe
+    workers: ?*std.Thread.Pool = null,
+    wait_group: std.Thread.WaitGroup = .{},
+    cache: ?*const Cache = null,
+
+    // worker_count threads on top of the one calling compile, which helps out.
+    pub fn create(allocator: std.mem.Allocator, worker_count: u32) *TextureCompiler {
+        const compiler = allocator.create(TextureCompiler) catch unreachable;
+        compiler.* = .{ .allocator = allocator };
+        if (worker_count > 0) {
+            const workers = allocator.create(std.Thread.Pool) catch unreachable;
+            workers.init(.{ .allocator = allocator, .n_jobs = worker_count }) catch unreachable;
+            compiler.workers = workers;
+        }
+        return compiler;
+    }
+
+    pub fn destroy(self: *TextureCompiler) void {
+        if (self.workers) |workers| {
+            workers.deinit();
+            self.allocator.destroy(workers);
+        }
+        self.allocator.destroy(self);
+    }
+
+    // Requests that are up to date in the cache are skipped. Blocks until every request is done.
+    pub fn compile(self: *TextureCompiler, requests: []Request, cache: ?*const Cache) void {
+        self.cache = cache;
+        for (requests) |*request| {
+            self.spawn(compileTexture, .{ self, request });
+        }
+        if (self.workers) |workers| {
+            workers.waitAndWork(&self.wait_group);
+        }
+        self.wait_group.reset();
+        self.cache = null;
+    }
+
+    fn spawn(self: *TextureCompiler, comptime func: anytype, args: anytype) void {
+        if (self.workers) |workers| {
+            workers.spawnWg(&self.wait_group, func, args);
+        } else {
+            @call(.auto, func, args);
+        }
+    }
+};
+
+const Mip = struct {
+    surface: ispc.RgbaSurface, // Padded to whole blocks and packed to the channels the format reads
+    pixels: []u8,
+    blocks_x: u32,
+    blocks_y: u32,
+    encoded_offset: usize,
+};
+
+// A texture between its mips being built and its last strip being encoded.
+const Texture = struct {
+    compiler: *TextureCompiler,
+    request: *Request,
+    width: u32,
+    height: u32,
+    mips: []Mip,
+    encoded: []u8,
+    bc7_settings: ispc.Bc7EncSettings,
+    pending_jobs: std.atomic.Value(u32),
+
+    fn destroy(self: *Texture) void {
+        const allocator = self.compiler.allocator;
+        for (self.mips) |mip| {
+            allocator.free(mip.pixels);
+        }
+        allocator.free(self.mips);
+        allocator.free(self.encoded);
+        allocator.destroy(self);
+    }
+};
+
+fn compileTexture(compiler: *TextureCompiler, request: *Request) void {
+    prepareTexture(compiler, request) catch |err| {
+        std.log.err("{s}: {s}", .{ request.name, @errorName(err) });
+        request.result = .failed;
+    };
+}
+
+fn prepareTexture(compiler: *TextureCompiler, request: *Request) !void {
+    const allocator = compiler.allocator;
+
+    var source_bytes: ?[]u8 = null;
+    defer if (source_bytes) |bytes| allocator.free(bytes);
+
+    var hasher = std.hash.XxHash3.init(compiler_version);
+    hasher.update(std.mem.asBytes(&request.metadata_hash));
+    // The two compressors don't write the same blocks
+    hasher.update(&[_]u8{@intFromBool(build_options.ispc_texcomp)});
+    if (request.source_path) |source_path| {
+        source_bytes = try std.fs.cwd().readFileAlloc(allocator, source_path, max_source_size);
+        hasher.update(source_bytes.?);
+    } else {
+        hasher.update(std.mem.asBytes(&request.synthetic_seed));
+    }
+    request.content_hash = hasher.final();
+
+    if (compiler.cache) |cache| {
+        if (cache.isUpToDate(request)) {
+            request.result = .skipped;
+            return;
+        }
+    }
+
+    if (build_options.ispc_texcomp) {
+        try buildTexture(compiler, request, source_bytes);
+    } else {
+        try runTexconv(allocator, request);
+        request.result = .compiled;
+    }
+}
+
+fn buildTexture(compiler: *TextureCompiler, request: *Request, source_bytes: ?[]const u8) !void {
+    const allocator = compiler.allocator;
+
+    var width: u32 = 0;
+    var height: u32 = 0;
+    var pixels = if (source_bytes) |bytes| try decodeImage(allocator, bytes, &width, &height) else generateImage(allocator, request.synthetic_seed, &width, &height);
+    defer allocator.free(pixels);
+
+    const info = request.info;
+    const srgb = info.srgb orelse (info.format == .BC1_UNORM_SRGB or info.format == .BC7_UNORM_SRGB);
+    const target_width = info.width orelse width;
+    const target_height = info.height orelse height;
+    if (target_width != width or target_height != height) {
+        const resized = try resizeImage(allocator, pixels, width, height, target_width, target_height, srgb);
+        allocator.free(pixels);
+        pixels = resized;
+        width = target_width;
+        height = target_height;
+    }
+
+    if (info.invert_y orelse false) {
+        var i: usize = 1;
+        while (i < pixels.len) : (i += 4) {
+            pixels[i] = 255 - pixels[i];
+        }
+    }
+
+    const full_mip_count = @as(u32, std.math.log2_int(u32, @max(width, height))) + 1;
+    const requested_mip_count = info.mip_count orelse 0;
+    const mip_count = if (requested_mip_count == 0) full_mip_count else @min(requested_mip_count, full_mip_count);
+
+    const mips = try allocator.alloc(Mip, mip_count);
+    var mips_built: usize = 0;
+    errdefer {
+        for (mips[0..mips_built]) |mip| {
+            allocator.free(mip.pixels);
+        }
+        allocator.free(mips);
+    }
+
+    // Each mip is filtered from the one above it, with the full chain of one texture on a single
+    // job. Parallelism comes from the other textures and the block encoding after.
+    var level_width = width;
+    var level_height = height;
+    var encoded_size: usize = 0;
+    for (mips, 0..) |*mip, level| {
+        if (level > 0) {
+            const next_width = @max(level_width / 2, 1);
+            const next_height = @max(level_height / 2, 1);
+            const next_pixels = try resizeImage(allocator, pixels, level_width, level_height, next_width, next_height, srgb);
+            allocator.free(pixels);
+            pixels = next_pixels;
+            level_width = next_width;
+            level_height = next_height;
+        }
+
+        mip.* = try packMip(allocator, pixels, level_width, level_height, info.format);
+        mip.encoded_offset = encoded_size;
+        encoded_size += @as(usize, mip.blocks_x) * mip.blocks_y * bytesPerBlock(info.format);
+        mips_built += 1;
+    }
+
+    const encoded = try allocator.alloc(u8, encoded_size);
+    errdefer allocator.free(encoded);
+
+    const texture = try allocator.create(Texture);
+    texture.* = .{
+        .compiler = compiler,
+        .request = request,
+        .width = width,
+        .height = height,
+        .mips = mips,
+        .encoded = encoded,
+        .bc7_settings = undefined,
+        .pending_jobs = std.atomic.Value(u32).init(0),
+    };
+    if (hasTranslucency(mips[0].pixels, channelCount(info.format))) {
+        ispc.GetProfile_alpha_fast(&texture.bc7_settings);
+    } else {
+        ispc.GetProfile_fast(&texture.bc7_settings);
+    }
+
+    var job_count: u32 = 0;
+    for (mips) |mip| {
+        job_count += std.math.divCeil(u32, mip.blocks_y, rowsPerJob(mip.blocks_x)) catch unreachable;
+    }
+    texture.pending_jobs.store(job_count, .release);
+
+    // NOTE: The last strip frees the texture and its mips, possibly before this loop is done, so
+    // nothing is read from them once the last job is out.
+    for (0..mip_count) |level| {
+        const blocks_x = mips[level].blocks_x;
+        const blocks_y = mips[level].blocks_y;
+        const rows_per_job = rowsPerJob(blocks_x);
+        var first_row: u32 = 0;
+        while (first_row < blocks_y) : (first_row += rows_per_job) {
+            compiler.spawn(encodeStrip, .{ texture, @as(u32, @intCast(level)), first_row, @min(rows_per_job, blocks_y - first_row) });
+        }
+    }
+}
+
+// The compressor from before ispc_texcomp, with the same arguments it was given then. Only runs
+// where texconv.exe does, and sees the source file rather than the decoded pixels.
+fn runTexconv(allocator: std.mem.Allocator, request: *Request) !void {
+    const source_path = request.source_path orelse return error.GeneratedImageNeedsIspc;
+    const info = request.info;
+    const output_dir = std.fs.path.dirname(request.output_path) orelse ".";
+    try std.fs.cwd().makePath(output_dir);
+
+    const texconv = try std.fs.cwd().realpathAlloc(allocator, texconv_path);
+    defer allocator.free(texconv);
+
+    var argv = std.ArrayList([]const u8).init(allocator);
+    defer argv.deinit();
+    var width_buffer: [16]u8 = undefined;
+    var height_buffer: [16]u8 = undefined;
+    var mip_count_buffer: [16]u8 = undefined;
+
+    // Lowercase output names, one processor per texture job and alpha compressed separately
+    try argv.appendSlice(&.{ texconv, "-y", "-l", "-nologo", "-singleproc", "-sepalpha", "-dx10" });
+    try argv.appendSlice(&.{ "-f", @tagName(info.format) });
+    if (info.width) |width| {
+        try argv.appendSlice(&.{ "-w", try std.fmt.bufPrint(&width_buffer, "{d}", .{width}) });
+    }
+    if (info.height) |height| {
+        try argv.appendSlice(&.{ "-h", try std.fmt.bufPrint(&height_buffer, "{d}", .{height}) });
+    }
+    if (info.mip_count) |mip_count| {
+        if (mip_count > 0) {
+            try argv.appendSlice(&.{ "-m", try std.fmt.bufPrint(&mip_count_buffer, "{d}", .{mip_count}) });
+        }
+    }
+    if (info.srgb orelse false) {
+        try argv.append("-srgb");
+    }
+    if (info.invert_y orelse false) {
+        try argv.append("-inverty");
+    }
+    try argv.appendSlice(&.{ "-o", output_dir, source_path });
+
+    var child = std.process.Child.init(argv.items, allocator);
+    const term = try child.spawnAndWait();
+    if (term != .Exited or term.Exited != 0) {
+        return error.TexconvFailed;
+    }
+}
+
+fn rowsPerJob(blocks_x: u32) u32 {
+    return @max(blocks_per_job / blocks_x, 1);
+}
+
+fn encodeStrip(texture: *Texture, level: u32, first_row: u32, row_count: u32) void {
+    const mip = texture.mips[level];
+    const format = texture.request.info.format;
+
+    var surface = mip.surface;
+    const row_bytes = @as(usize, @intCast(surface.stride)) * block_dimension;
+    surface.ptr = mip.surface.ptr + first_row * row_bytes;
+    surface.height = @intCast(row_count * block_dimension);
+    const destination = texture.encoded[mip.encoded_offset + @as(usize, first_row) * mip.blocks_x * bytesPerBlock(format) ..];
+
+    switch (format) {
+        .BC1_UNORM, .BC1_UNORM_SRGB => ispc.CompressBlocksBC1(&surface, destination.ptr),
+        .BC3_UNORM => ispc.CompressBlocksBC3(&surface, destination.ptr),
+        .BC4_UNORM => ispc.CompressBlocksBC4(&surface, destination.ptr),
+        .BC5_UNORM => ispc.CompressBlocksBC5(&surface, destination.ptr),
+        .BC7_UNORM, .BC7_UNORM_SRGB => {
+            var settings = texture.bc7_settings;
+            ispc.CompressBlocksBC7(&surface, destination.ptr, &settings);
+        },
+    }
+
+    if (texture.pending_jobs.fetchSub(1, .acq_rel) == 1) {
+        finishTexture(texture);
+    }
+}
+
+fn finishTexture(texture: *Texture) void {
+    const request = texture.request;
+    defer texture.destroy();
+
+    writeDds(texture) catch |err| {
+        std.log.err("{s}: can't write '{s}': {s}", .{ request.name, request.output_path, @errorName(err) });
+        request.result = .failed;
+        return;
+    };
+
+    var pixels: u64 = 0;
+    for (texture.mips) |mip| {
+        pixels += @as(u64, mip.blocks_x) * mip.blocks_y * block_dimension * block_dimension;
+    }
+    request.pixels = pixels;
+    request.result = .compiled;
+}
+
+fn decodeImage(allocator: std.mem.Allocator, bytes: []const u8, width: *u32, height: *u32) ![]u8 {
+    var image_width: c_int = 0;
+    var image_height: c_int = 0;
+    var channels: c_int = 0;
+    const decoded = c.stbi_load_from_memory(bytes.ptr, @intCast(bytes.len), &image_width, &image_height, &channels, 4) orelse {
+        std.log.err("stb_image: {s}", .{std.mem.span(c.stbi_failure_reason())});
+        return error.InvalidImage;
+    };
+    defer c.stbi_image_free(decoded);
+
+    width.* = @intCast(image_width);
+    height.* = @intCast(image_height);
+    const size = @as(usize, width.*) * height.* * 4;
+    const pixels = try allocator.alloc(u8, size);
+    @memcpy(pixels, decoded[0..size]);
+    return pixels;
+}
+
+// Tileable noise-ish patterns, detailed enough that the encoders do representative work.
+fn generateImage(allocator: std.mem.Allocator, seed: u32, width: *u32, height: *u32) []u8 {
+    const size = 1024;
+    width.* = size;
+    height.* = size;
+    const pixels = allocator.alloc(u8, size * size * 4) catch unreachable;
+    var rng = std.Random.DefaultPrng.init(seed);
+    const rand = rng.random();
+    const frequency_x = 2.0 + rand.float(f32) * 8.0;
+    const frequency_y = 2.0 + rand.float(f32) * 8.0;
+    for (0..size) |y| {
+        for (0..size) |x| {
+            const u = @as(f32, @floatFromInt(x)) / @as(f32, size) * std.math.tau;
+            const v = @as(f32, @floatFromInt(y)) / @as(f32, size) * std.math.tau;
+            const wave = @sin(u * frequency_x) * @cos(v * frequency_y);
+            const grain = rand.float(f32) * 0.2;
+            const pixel = pixels[(y * size + x) * 4 ..][0..4];
+            pixel[0] = @intFromFloat(std.math.clamp((wave * 0.4 + 0.5 + grain) * 255.0, 0.0, 255.0));
+            pixel[1] = @intFromFloat(std.math.clamp((@sin(u * 3.0 + wave) * 0.4 + 0.5) * 255.0, 0.0, 255.0));
+            pixel[2] = @intFromFloat(std.math.clamp((grain * 2.0 + 0.3) * 255.0, 0.0, 255.0));
+            pixel[3] = 255;
+        }
+    }
+    return pixels;
+}
+
+// Alpha is filtered separately from color like texconv's -sepalpha, flagging the pixels as
+// premultiplied keeps stb from weighting color by it.
+fn resizeImage(allocator: std.mem.Allocator, pixels: []const u8, width: u32, height: u32, new_width: u32, new_height: u32, srgb: bool) ![]u8 {
+    const resized = try allocator.alloc(u8, @as(usize, new_width) * new_height * 4);
+    errdefer allocator.free(resized);
+
+    const result = if (srgb)
+        c.stbir_resize_uint8_srgb(pixels.ptr, @intCast(width), @intCast(height), 0, resized.ptr, @intCast(new_width), @intCast(new_height), 0, 4, 3, c.STBIR_FLAG_ALPHA_PREMULTIPLIED)
+    else
+        c.stbir_resize_uint8(pixels.ptr, @intCast(width), @intCast(height), 0, resized.ptr, @intCast(new_width), @intCast(new_height), 0, 4);
+    if (result == 0) {
+        return error.ResizeFailed;
+    }
+    return resized;
+}
+
+// Picks the BC7 profile, only 4 channel mips have alpha.
+fn hasTranslucency(pixels: []const u8, channels: u32) bool {
+    if (channels != 4) {
+        return false;
+    }
+
+    var i: usize = 3;
+    while (i < pixels.len) : (i += 4) {
+        if (pixels[i] != 255) {
+            return true;
+        }
+    }
+    return false;
+}
+
+fn channelCount(format: TextureFormat) u32 {
+    return switch (format) {
+        .BC4_UNORM => 1,
+        .BC5_UNORM => 2,
+        else => 4,
+    };
+}
+
+fn bytesPerBlock(format: TextureFormat) u32 {
+    return switch (format) {
+        .BC1_UNORM, .BC1_UNORM_SRGB, .BC4_UNORM => 8,
+        else => 16,
+    };
+}
+
+// Pads the mip to whole blocks by repeating its last row and column, and keeps only the
+// channels the encoder reads.
+fn packMip(allocator: std.mem.Allocator, pixels: []const u8, width: u32, height: u32, format: TextureFormat) !Mip {
+    const channels = channelCount(format);
+    const blocks_x = std.math.divCeil(u32, width, block_dimension) catch unreachable;
+    const blocks_y = std.math.divCeil(u32, height, block_dimension) catch unreachable;
+    const padded_width = blocks_x * block_dimension;
+    const padded_height = blocks_y * block_dimension;
+    const stride = padded_width * channels;
+
+    const packed_pixels = try allocator.alloc(u8, @as(usize, stride) * padded_height);
+    for (0..padded_height) |y| {
+        const source_y = @min(y, height - 1);
+        for (0..padded_width) |x| {
+            const source_x = @min(x, width - 1);
+            const source = pixels[(@as(usize, source_y) * width + source_x) * 4 ..][0..4];
+            @memcpy(packed_pixels[y * stride + x * channels ..][0..channels], source[0..channels]);
+        }
+    }
+
+    return .{
+        .surface = .{ .ptr = packed_pixels.ptr, .width = @intCast(padded_width), .height = @intCast(padded_height), .stride = @intCast(stride) },
+        .pixels = packed_pixels,
+        .blocks_x = blocks_x,
+        .blocks_y = blocks_y,
+        .encoded_offset = 0,
+    };
+}
+
+// DDS
+// ===
+
+const dds_magic = "DDS ";
+const ddsd_caps = 0x1;
+const ddsd_height = 0x2;
+const ddsd_width = 0x4;
+const ddsd_pixelformat = 0x1000;
+const ddsd_mipmapcount = 0x20000;
+const ddsd_linearsize = 0x80000;
+const ddpf_fourcc = 0x4;
+const ddscaps_complex = 0x8;
+const ddscaps_texture = 0x1000;
+const ddscaps_mipmap = 0x400000;
+const d3d10_resource_dimension_texture2d = 3;
+
+const DdsPixelFormat = extern struct {
+    size: u32 = @sizeOf(DdsPixelFormat),
+    flags: u32 = ddpf_fourcc,
+    four_cc: [4]u8 = "DX10".*,
+    rgb_bit_count: u32 = 0,
+    r_bit_mask: u32 = 0,
+    g_bit_mask: u32 = 0,
+    b_bit_mask: u32 = 0,
+    a_bit_mask: u32 = 0,
+};
+
+const DdsHeader = extern struct {
+    size: u32 = @sizeOf(DdsHeader),
+    flags: u32 = ddsd_caps | ddsd_height | ddsd_width | ddsd_pixelformat | ddsd_mipmapcount | ddsd_linearsize,
+    height: u32,
+    width: u32,
+    pitch_or_linear_size: u32,
+    depth: u32 = 0,
+    mip_map_count: u32,
+    reserved1: [11]u32 = [_]u32{0} ** 11,
+    pixel_format: DdsPixelFormat = .{},
+    caps: u32,
+    caps2: u32 = 0,
+    caps3: u32 = 0,
+    caps4: u32 = 0,
+    reserved2: u32 = 0,
+};
+
+const DdsHeaderDx10 = extern struct {
+    dxgi_format: u32,
+    resource_dimension: u32 = d3d10_resource_dimension_texture2d,
+    misc_flag: u32 = 0,
+    array_size: u32 = 1,
+    misc_flags2: u32 = 0,
+};
+
+comptime {
+    std.debug.assert(@sizeOf(DdsHeader) == 124);
+    std.debug.assert(@sizeOf(DdsHeaderDx10) == 20);
+}
+
+fn dxgiFormat(format: TextureFormat) u32 {
+    return switch (format) {
+        .BC1_UNORM => 71,
+        .BC1_UNORM_SRGB => 72,
+        .BC3_UNORM => 77,
+        .BC4_UNORM => 80,
+        .BC5_UNORM => 83,
+        .BC7_UNORM => 98,
+        .BC7_UNORM_SRGB => 99,
+    };
+}
+
+fn writeDds(texture: *const Texture) !void {
+    const request = texture.request;
+    if (std.fs.path.dirname(request.output_path)) |dir| {
+        try std.fs.cwd().makePath(dir);
+    }
+
+    var file = try std.fs.cwd().createFile(request.output_path, .{});
+    defer file.close();
+
+    const top_mip = texture.mips[0];
+    const header = DdsHeader{
+        .height = texture.height,
+        .width = texture.width,
+        .pitch_or_linear_size = top_mip.blocks_x * top_mip.blocks_y * bytesPerBlock(request.info.format),
+        .mip_map_count = @intCast(texture.mips.len),
+        .caps = ddscaps_texture | if (texture.mips.len > 1) ddscaps_complex | ddscaps_mipmap else 0,
+    };
+    const header_dx10 = DdsHeaderDx10{ .dxgi_format = dxgiFormat(request.info.format) };
+
+    try file.writeAll(dds_magic);
+    try file.writeAll(std.mem.asBytes(&header));
+    try file.writeAll(std.mem.asBytes(&header_dx10));
+    try file.writeAll(texture.encoded);
+}
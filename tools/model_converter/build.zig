@@ -0,0 +1,98 @@
+const std = @import("std");
+
+const zstd_path = "../../external/The-Forge/Common_3/Utilities/ThirdParty/OpenSource/zstd";
+
+const meshoptimizer_sources = [_][]const u8{
+    "allocator.cpp",
+    "clusterizer.cpp",
+    "indexanalyzer.cpp",
+    "indexcodec.cpp",
+    "indexgenerator.cpp",
+    "overdrawoptimizer.cpp",
+    "partition.cpp",
+    "quantization.cpp",
+    "rasterizer.cpp",
+    "simplifier.cpp",
+    "spatialorder.cpp",
+    "stripifier.cpp",
+    "vcacheoptimizer.cpp",
+    "vertexcodec.cpp",
+    "vertexfilter.cpp",
+    "vfetchoptimizer.cpp",
+};
+
+// Only compression, the engine decodes with std.compress.zstd.
+pub const zstd_sources = [_][]const u8{
+    "common/debug.c",
+    "common/entropy_common.c",
+    "common/error_private.c",
+    "common/fse_decompress.c",
+    "common/pool.c",
+    "common/threading.c",
+    "common/xxhash.c",
+    "common/zstd_common.c",
+    "compress/fse_compress.c",
+    "compress/hist.c",
+    "compress/huf_compress.c",
+    "compress/zstd_compress.c",
+    "compress/zstd_compress_literals.c",
+    "compress/zstd_compress_sequences.c",
+    "compress/zstd_compress_superblock.c",
+    "compress/zstd_double_fast.c",
+    "compress/zstd_fast.c",
+    "compress/zstd_lazy.c",
+    "compress/zstd_ldm.c",
+    "compress/zstd_opt.c",
+    "compress/zstdmt_compress.c",
+};
+
+pub fn build(b: *std.Build) void {
+    const target = b.standardTargetOptions(.{});
+    const optimize = b.standardOptimizeOption(.{});
+
+    const exe = b.addExecutable(.{
+        .name = "ModelConverter",
+        .target = target,
+        .optimize = optimize,
+    });
+
+    exe.addIncludePath(b.path("external/meshoptimizer-0.24/src"));
+    exe.addIncludePath(b.path("external/meshoptimizer-0.24/extern"));
+    exe.addIncludePath(b.path("external/MikkTSpace"));
+    exe.addIncludePath(b.path(zstd_path));
+
+    exe.addCSourceFile(.{ .file = b.path("src/main.cpp"), .flags = &.{"-std=c++17"} });
+    exe.addCSourceFiles(.{
+        .root = b.path("external/meshoptimizer-0.24/src"),
+        .files = &meshoptimizer_sources,
+        .flags = &.{"-std=c++17"},
+    });
+    exe.addCSourceFile(.{ .file = b.path("external/MikkTSpace/mikktspace.c"), .flags = &.{} });
+    exe.addCSourceFiles(.{
+        .root = b.path(zstd_path),
+        .files = &zstd_sources,
+        .flags = &.{},
+    });
+    exe.linkLibC();
+    exe.linkLibCpp();
+
+    b.installArtifact(exe);
+
+    const run_cmd = b.addRunArtifact(exe);
+    if (b.args) |args| {
+        run_cmd.addArgs(args);
+    }
+
+    const run_step = b.step("run", "Run the app");
+    run_step.dependOn(&run_cmd.step);
+
+    // Converts generated meshes on one worker and on every core, or the files passed after --.
+    const bench_cmd = b.addRunArtifact(exe);
+    bench_cmd.addArgs(&.{ "--benchmark", "--lods", "4" });
+    if (b.args) |args| {
+        bench_cmd.addArgs(args);
+    }
+
+    const bench_step = b.step("bench", "Benchmark batch conversion and LoD generation");
+    bench_step.dependOn(&bench_cmd.step);
+}
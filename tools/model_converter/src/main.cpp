@@ -1,14 +1,31 @@
 #include <assert.h>
+#include <atomic>
+#include <chrono>
 #define CGLTF_IMPLEMENTATION
 #include <cgltf.h>
+#include <float.h>
 #include <meshoptimizer.h>
 #include <mikktspace.h>
+#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <zstd.h>
 
 static const int MESHLET_MAX_TRIANGLES = 124;
 static const int MESHLET_MAX_VERTICES = 64;
-static const char MESH_MAGIC[] = { 'T', 'i', 'd', 'e', 's', 'M', 'e', 's', 'h' };
+// TidesMesh v2, the layout is documented in src/renderer/mesh_format.zig. v1 files followed the
+// magic with a u64 mesh count that is never zero, the padding tells them apart.
+static const char MESH_MAGIC[] = { 'T', 'i', 'd', 'e', 's', 'M', 'e', 's', 'h', 0, 0, 0, 0, 0, 0, 0 };
+static const uint32_t MESH_VERSION = 2;
+static const uint64_t MESH_DATA_ALIGNMENT = 4096;
+static const uint64_t MESH_STREAM_ALIGNMENT = 16;
+static const int MESH_ZSTD_LEVEL = 19;
+// geometry.mesh_lod_max_count, LoDs are separate <name>_LOD<n>.mesh files the prefabs list.
+static const uint32_t MESH_LOD_MAX_COUNT = 4;
+static const size_t MAX_PATH_LENGTH = 1024;
 
 struct float2_t
 {
@@ -139,6 +156,77 @@ bool operator==(meshlet_bounds_t a, meshlet_bounds_t b)
 		a.local_extents == b.local_extents;
 }
 
+enum mesh_stream_e : uint32_t
+{
+	mesh_stream_indices,
+	mesh_stream_positions,
+	mesh_stream_texcoords,
+	mesh_stream_normals,
+	mesh_stream_tangents,
+	mesh_stream_meshlets,
+	mesh_stream_meshlet_bounds,
+	mesh_stream_meshlet_triangles,
+	mesh_stream_meshlet_vertices,
+	mesh_stream_count,
+};
+
+enum mesh_codec_e : uint32_t
+{
+	mesh_codec_none = 0,
+	mesh_codec_zstd = 1,
+};
+
+struct file_header_t
+{
+	char magic[16];
+	uint32_t version;
+	uint32_t mesh_count;
+	uint64_t data_offset;
+};
+
+struct stream_desc_t
+{
+	uint64_t offset;
+	uint32_t size;
+	uint32_t decoded_size;
+	uint32_t codec;
+	uint32_t padding;
+};
+
+struct mesh_header_t
+{
+	float3_t bounds_center;
+	float3_t bounds_extents;
+	uint32_t index_count;
+	uint32_t positions_count;
+	uint32_t texcoords_count;
+	uint32_t normals_count;
+	uint32_t tangents_count;
+	uint32_t meshlets_count;
+	uint32_t meshlet_triangles_count;
+	uint32_t meshlet_vertices_count;
+	uint32_t index_size;
+	uint32_t padding;
+	stream_desc_t streams[mesh_stream_count];
+};
+
+static_assert(sizeof(file_header_t) == 32, "file_header_t must match FileHeader in mesh_format.zig");
+static_assert(sizeof(stream_desc_t) == 24, "stream_desc_t must match StreamDesc in mesh_format.zig");
+static_assert(sizeof(mesh_header_t) == 280, "mesh_header_t must match MeshHeader in mesh_format.zig");
+
+struct encoded_stream_t
+{
+	uint8_t* data;
+	size_t size;
+	size_t decoded_size;
+	mesh_codec_e codec;
+};
+
+uint64_t align_up(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
 template<typename T>
 struct fixed_array_t
 {
@@ -182,8 +270,7 @@ struct fixed_array_t
 		assert(data);
 		memset(data, 0, sizeof(T) * new_count);
 		size_t elements_to_copy = (new_count > count) ? count : new_count;
-		errno_t result = memcpy_s(data, sizeof(T) * new_count, old_data, sizeof(T) * elements_to_copy);
-		assert(result == 0);
+		memcpy(data, old_data, sizeof(T) * elements_to_copy);
 		free(old_data);
 		count = new_count;
 	}
@@ -284,458 +371,1170 @@ void mikkt_set_tspace_basic(const SMikkTSpaceContext* context, const float tange
 	vertex_tangent->w = sign;
 }
 
-struct command_line_arguments_t
+float sign_not_zero(float value)
 {
-	char* input_path;
-	char* output_path;
-	bool generate_meshlets;
-	// bool interleaved;
-	bool counter_clock_wise_winding;
-	bool test_output_file;
-};
+	return value >= 0.0f ? 1.0f : -1.0f;
+}
 
-int main(int argc, char** argv)
+// Maps a unit vector onto the octahedron and folds the lower half over the upper one.
+float2_t octahedral_encode(float3_t v)
 {
-	printf("Model Converter\n");
+	float length = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+	if (length == 0.0f)
+	{
+		return { 0.0f, 0.0f };
+	}
 
-	// Parsing arguments
-	command_line_arguments_t cl_arguments = {};
-	assert(argc > 1);
-	int32_t arg_cursor = 1;
-	while (arg_cursor < argc)
+	float x = v.x / length;
+	float y = v.y / length;
+	if (v.z >= 0.0f)
+	{
+		return { x, y };
+	}
+	return { (1.0f - fabsf(y)) * sign_not_zero(x), (1.0f - fabsf(x)) * sign_not_zero(y) };
+}
+
+uint16_t quantize_position_component(float value, float center, float extents)
+{
+	float range = extents * 2.0f;
+	float t = range > 0.0f ? (value - (center - extents)) / range : 0.0f;
+	return (uint16_t)meshopt_quantizeUnorm(t, 16);
+}
+
+void init_mesh_header(const mesh_data_t& mesh_data, mesh_header_t* header)
+{
+	float3_t min = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float3_t max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (size_t i = 0; i < mesh_data.positions_stream.count; ++i)
 	{
-		if (strcmp("--input", argv[arg_cursor]) == 0)
+		min = float3_min(min, mesh_data.positions_stream.data[i]);
+		max = float3_max(max, mesh_data.positions_stream.data[i]);
+	}
+
+	memset(header, 0, sizeof(mesh_header_t));
+	header->bounds_center = (max + min) / 2;
+	header->bounds_extents = (max - min) / 2;
+	header->index_count = (uint32_t)mesh_data.indices.count;
+	header->positions_count = (uint32_t)mesh_data.positions_stream.count;
+	header->texcoords_count = (uint32_t)mesh_data.texcoords_stream.count;
+	header->normals_count = (uint32_t)mesh_data.normals_stream.count;
+	header->tangents_count = (uint32_t)mesh_data.tangents_stream.count;
+	header->meshlets_count = (uint32_t)mesh_data.meshlets.count;
+	header->meshlet_triangles_count = (uint32_t)mesh_data.meshlet_triangles.count;
+	header->meshlet_vertices_count = (uint32_t)mesh_data.meshlet_vertices.count;
+	header->index_size = (uint32_t)(mesh_data.positions_stream.count <= 65536 ? sizeof(uint16_t) : sizeof(uint32_t));
+}
+
+void encode_indices(const fixed_array_t<uint32_t>& indices, uint32_t index_size, uint8_t* data)
+{
+	for (size_t i = 0; i < indices.count; ++i)
+	{
+		if (index_size == sizeof(uint16_t))
 		{
-			cl_arguments.input_path = argv[++arg_cursor];
-			arg_cursor++;
-			continue;
+			((uint16_t*)data)[i] = (uint16_t)indices.data[i];
 		}
-
-		if (strcmp("--output", argv[arg_cursor]) == 0)
+		else
 		{
-			cl_arguments.output_path = argv[++arg_cursor];
-			arg_cursor++;
-			continue;
+			((uint32_t*)data)[i] = indices.data[i];
 		}
+	}
+}
 
-		if (strcmp("--ccw", argv[arg_cursor]) == 0)
+// Quantizes a stream the way mesh_format.zig dequantizes it.
+encoded_stream_t encode_stream(const mesh_data_t& mesh_data, const mesh_header_t& header, mesh_stream_e stream)
+{
+	size_t element_size = 0;
+	size_t element_count = 0;
+	switch (stream)
+	{
+	case mesh_stream_indices: element_size = header.index_size; element_count = mesh_data.indices.count; break;
+	case mesh_stream_positions: element_size = sizeof(uint16_t) * 3; element_count = mesh_data.positions_stream.count; break;
+	case mesh_stream_texcoords: element_size = sizeof(uint16_t) * 2; element_count = mesh_data.texcoords_stream.count; break;
+	case mesh_stream_normals: element_size = sizeof(int16_t) * 2; element_count = mesh_data.normals_stream.count; break;
+	case mesh_stream_tangents: element_size = sizeof(uint32_t); element_count = mesh_data.tangents_stream.count; break;
+	case mesh_stream_meshlets: element_size = sizeof(meshlet_t); element_count = mesh_data.meshlets.count; break;
+	case mesh_stream_meshlet_bounds: element_size = sizeof(meshlet_bounds_t); element_count = mesh_data.meshlet_bounds.count; break;
+	case mesh_stream_meshlet_triangles: element_size = sizeof(meshlet_triangle_t); element_count = mesh_data.meshlet_triangles.count; break;
+	case mesh_stream_meshlet_vertices: element_size = header.index_size; element_count = mesh_data.meshlet_vertices.count; break;
+	default: assert(false); break;
+	}
+
+	encoded_stream_t encoded = {};
+	encoded.size = element_size * element_count;
+	encoded.decoded_size = encoded.size;
+	encoded.codec = mesh_codec_none;
+	encoded.data = (uint8_t*)malloc(encoded.size > 0 ? encoded.size : 1);
+	assert(encoded.data);
+
+	switch (stream)
+	{
+	case mesh_stream_indices:
+		encode_indices(mesh_data.indices, header.index_size, encoded.data);
+		break;
+	case mesh_stream_positions:
+		for (size_t i = 0; i < element_count; ++i)
 		{
-			cl_arguments.counter_clock_wise_winding = true;
-			arg_cursor++;
-			continue;
+			const float3_t p = mesh_data.positions_stream.data[i];
+			uint16_t* out = (uint16_t*)encoded.data + i * 3;
+			out[0] = quantize_position_component(p.x, header.bounds_center.x, header.bounds_extents.x);
+			out[1] = quantize_position_component(p.y, header.bounds_center.y, header.bounds_extents.y);
+			out[2] = quantize_position_component(p.z, header.bounds_center.z, header.bounds_extents.z);
 		}
-
-		if (strcmp("--test-output", argv[arg_cursor]) == 0)
+		break;
+	case mesh_stream_texcoords:
+		for (size_t i = 0; i < element_count; ++i)
 		{
-			cl_arguments.test_output_file = true;
-			arg_cursor++;
-			continue;
+			uint16_t* out = (uint16_t*)encoded.data + i * 2;
+			out[0] = meshopt_quantizeHalf(mesh_data.texcoords_stream.data[i].x);
+			out[1] = meshopt_quantizeHalf(mesh_data.texcoords_stream.data[i].y);
+		}
+		break;
+	case mesh_stream_normals:
+		for (size_t i = 0; i < element_count; ++i)
+		{
+			const float2_t e = octahedral_encode(mesh_data.normals_stream.data[i]);
+			int16_t* out = (int16_t*)encoded.data + i * 2;
+			out[0] = (int16_t)meshopt_quantizeSnorm(e.x, 16);
+			out[1] = (int16_t)meshopt_quantizeSnorm(e.y, 16);
 		}
+		break;
+	case mesh_stream_tangents:
+		for (size_t i = 0; i < element_count; ++i)
+		{
+			// 16 bit x, 15 bit y and the bitangent sign in the top bit, QuantizedTangent in mesh_format.zig.
+			const float4_t t = mesh_data.tangents_stream.data[i];
+			const float2_t e = octahedral_encode({ t.x, t.y, t.z });
+			uint32_t x = (uint16_t)(int16_t)meshopt_quantizeSnorm(e.x, 16);
+			uint32_t y = (uint32_t)meshopt_quantizeSnorm(e.y, 15) & 0x7fff;
+			((uint32_t*)encoded.data)[i] = x | (y << 16) | (t.w < 0.0f ? 0x80000000u : 0u);
+		}
+		break;
+	case mesh_stream_meshlets:
+		memcpy(encoded.data, mesh_data.meshlets.data, encoded.size);
+		break;
+	case mesh_stream_meshlet_bounds:
+		memcpy(encoded.data, mesh_data.meshlet_bounds.data, encoded.size);
+		break;
+	case mesh_stream_meshlet_triangles:
+		memcpy(encoded.data, mesh_data.meshlet_triangles.data, encoded.size);
+		break;
+	case mesh_stream_meshlet_vertices:
+		encode_indices(mesh_data.meshlet_vertices, header.index_size, encoded.data);
+		break;
+	default:
+		break;
 	}
 
-	assert(arg_cursor == argc);
+	return encoded;
+}
 
-	printf("Input File: '%s'\n", cl_arguments.input_path);
-	printf("Output File: '%s'\n", cl_arguments.output_path);
-	printf("Winding: '%s'\n", cl_arguments.counter_clock_wise_winding ? "CCW" : "CW");
-	printf("Test Output File: '%s'\n", cl_arguments.test_output_file ? "Yes" : "No");
+// Keeps the zstd frame only when it is smaller, the loader dequantizes uncompressed streams
+// straight out of the mapped file.
+encoded_stream_t compress_stream(encoded_stream_t stream)
+{
+	if (stream.size == 0)
+	{
+		return stream;
+	}
+
+	size_t bound = ZSTD_compressBound(stream.size);
+	uint8_t* compressed = (uint8_t*)malloc(bound);
+	assert(compressed);
+	size_t compressed_size = ZSTD_compress(compressed, bound, stream.data, stream.size, MESH_ZSTD_LEVEL);
+	if (ZSTD_isError(compressed_size) || compressed_size >= stream.size)
+	{
+		free(compressed);
+		return stream;
+	}
 
-	cgltf_options options{};
-	cgltf_data* gltf_data = nullptr;
-	cgltf_result result = cgltf_parse_file(&options, cl_arguments.input_path, &gltf_data);
-	assert(result == cgltf_result_success);
-	result = cgltf_load_buffers(&options, gltf_data, cl_arguments.input_path);
-	assert(result == cgltf_result_success);
+	free(stream.data);
+	stream.data = compressed;
+	stream.size = compressed_size;
+	stream.codec = mesh_codec_zstd;
+	return stream;
+}
 
-	uint32_t mesh_count = 0;
-	for (uint32_t i = 0; i < gltf_data->meshes_count; ++i)
+void write_padding(FILE* file, uint64_t size)
+{
+	static const uint8_t zeroes[MESH_DATA_ALIGNMENT] = {};
+	assert(size <= MESH_DATA_ALIGNMENT);
+	if (size > 0)
 	{
-		mesh_count += (uint32_t)gltf_data->meshes[i].primitives_count;
+		fwrite(zeroes, (size_t)size, 1, file);
 	}
+}
 
-	fixed_array_t<mesh_data_t> mesh_datas;
-	mesh_datas.init(mesh_count);
-	fixed_array_t<uint32_t> mesh_indices;
-	mesh_indices.init(mesh_count);
+int seek_file(FILE* file, uint64_t offset)
+{
+#if defined(_WIN32)
+	return _fseeki64(file, (int64_t)offset, SEEK_SET);
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
 
-	uint32_t mesh_index = 0;
+template<typename T>
+void release_array(fixed_array_t<T>* array)
+{
+	if (array->data)
+	{
+		array->deinit();
+	}
+}
 
-	int index_map[3];
-	if (cl_arguments.counter_clock_wise_winding)
+template<typename T>
+void copy_array(const fixed_array_t<T>& source, fixed_array_t<T>* destination)
+{
+	if (source.data == nullptr)
 	{
-		memcpy(&index_map[0], &counter_clock_wise_index_map[0], 3 * sizeof(int));
+		return;
 	}
-	else
+
+	destination->init(source.count);
+	memcpy(destination->data, source.data, sizeof(T) * source.count);
+}
+
+template<typename T>
+void trim_array(fixed_array_t<T>* array, size_t count)
+{
+	if (array->data && count > 0)
 	{
-		memcpy(&index_map[0], &clock_wise_index_map[0], 3 * sizeof(int));
+		array->resize(count);
 	}
+}
+
+void free_mesh_data(mesh_data_t* mesh_data)
+{
+	release_array(&mesh_data->indices);
+	release_array(&mesh_data->positions_stream);
+	release_array(&mesh_data->normals_stream);
+	release_array(&mesh_data->tangents_stream);
+	release_array(&mesh_data->texcoords_stream);
+	release_array(&mesh_data->meshlets);
+	release_array(&mesh_data->meshlet_bounds);
+	release_array(&mesh_data->meshlet_triangles);
+	release_array(&mesh_data->meshlet_vertices);
+}
 
-	for (uint32_t mi = 0; mi < gltf_data->meshes_count; ++mi)
+// Runs fn(i) for every i below count, spread over worker_count threads including the calling one.
+template<typename F>
+void parallel_for(uint32_t worker_count, size_t count, const F& fn)
+{
+	std::atomic<size_t> next_index(0);
+	auto work = [&]()
 	{
-		const cgltf_mesh& mesh = gltf_data->meshes[mi];
-		for (uint32_t pi = 0; pi < mesh.primitives_count; ++pi)
+		for (size_t i = next_index.fetch_add(1); i < count; i = next_index.fetch_add(1))
 		{
-			const cgltf_primitive& primitive = mesh.primitives[pi];
-			mesh_data_t& mesh_data = mesh_datas.data[mesh_index++];
+			fn(i);
+		}
+	};
+
+	size_t thread_count = worker_count > 1 ? worker_count - 1 : 0;
+	thread_count = thread_count < count ? thread_count : (count > 0 ? count - 1 : 0);
+	std::thread* threads = thread_count > 0 ? new std::thread[thread_count] : nullptr;
+	for (size_t i = 0; i < thread_count; ++i)
+	{
+		threads[i] = std::thread(work);
+	}
+
+	work();
+
+	for (size_t i = 0; i < thread_count; ++i)
+	{
+		threads[i].join();
+	}
+	delete[] threads;
+}
 
-			mesh_data.indices.init(primitive.indices->count);
+struct command_line_arguments_t
+{
+	const char* batch_path;
+	bool counter_clock_wise_winding;
+	bool test_output_file;
+	bool benchmark;
+	uint32_t lod_count;
+	float lod_error;
+	uint32_t worker_count;
+};
 
-			for (size_t i = 0; i < primitive.indices->count; i += 3)
+// One glTF file and the LoD files it's converted into.
+struct conversion_t
+{
+	char input_path[MAX_PATH_LENGTH];
+	char output_path[MAX_PATH_LENGTH];
+	cgltf_data* gltf_data;
+	uint32_t first_primitive;
+	uint32_t primitive_count;
+	uint32_t lod_count;
+	size_t decoded_bytes[MESH_LOD_MAX_COUNT];
+	size_t stored_bytes[MESH_LOD_MAX_COUNT];
+};
+
+struct primitive_t
+{
+	const cgltf_primitive* gltf_primitive; // Null for the benchmark's synthetic meshes
+	uint32_t synthetic_seed;
+	mesh_data_t source; // Has tangents but isn't optimized, every LoD is simplified from it
+	mesh_data_t lods[MESH_LOD_MAX_COUNT];
+	float lod_errors[MESH_LOD_MAX_COUNT]; // Relative to the mesh's extents
+	bool lod_built[MESH_LOD_MAX_COUNT];
+	bool lod_sloppy[MESH_LOD_MAX_COUNT];
+};
+
+void read_primitive(const cgltf_primitive& primitive, const int index_map[3], mesh_data_t* mesh_data)
+{
+	mesh_data->indices.init(primitive.indices->count);
+
+	for (size_t i = 0; i < primitive.indices->count; i += 3)
+	{
+		mesh_data->indices.data[i + 0] = (uint32_t)cgltf_accessor_read_index(primitive.indices, i + index_map[0]);
+		mesh_data->indices.data[i + 1] = (uint32_t)cgltf_accessor_read_index(primitive.indices, i + index_map[2]);
+		mesh_data->indices.data[i + 2] = (uint32_t)cgltf_accessor_read_index(primitive.indices, i + index_map[1]);
+	}
+
+	for (size_t attr_index = 0; attr_index < primitive.attributes_count; ++attr_index)
+	{
+		const cgltf_attribute& attribute = primitive.attributes[attr_index];
+		if (attribute.type == cgltf_attribute_type_position)
+		{
+			mesh_data->positions_stream.init(attribute.data->count);
+			size_t unpacked_count = cgltf_accessor_unpack_floats(attribute.data, &mesh_data->positions_stream.data[0].x, attribute.data->count * 3);
+			assert(unpacked_count > 0);
+		}
+		else if (attribute.type == cgltf_attribute_type_normal)
+		{
+			mesh_data->normals_stream.init(attribute.data->count);
+			size_t unpacked_count = cgltf_accessor_unpack_floats(attribute.data, &mesh_data->normals_stream.data[0].x, attribute.data->count * 3);
+			assert(unpacked_count > 0);
+		}
+		else if (attribute.type == cgltf_attribute_type_texcoord && attribute.index == 0) // TODO: Add support for multiple TEXCOORD
+		{
+			mesh_data->texcoords_stream.init(attribute.data->count);
+			size_t unpacked_count = cgltf_accessor_unpack_floats(attribute.data, &mesh_data->texcoords_stream.data[0].x, attribute.data->count * 2);
+			assert(unpacked_count > 0);
+		}
+	}
+}
+
+uint32_t next_random(uint32_t* state)
+{
+	*state = *state * 1664525u + 1013904223u;
+	return *state;
+}
+
+float random_float(uint32_t* state)
+{
+	return (float)(next_random(state) >> 8) / 16777216.0f;
+}
+
+// Stand-ins for content when benchmarking without input files: rolling ground meshes that
+// simplify well, and clouds of foliage cards that need the sloppy fallback.
+void generate_synthetic_primitive(uint32_t seed, mesh_data_t* mesh_data)
+{
+	if (seed % 3 != 2)
+	{
+		const uint32_t side = 48 + (seed % 4) * 32;
+		const uint32_t vertex_side = side + 1;
+		const float size = 10.0f;
+		const float phase = (float)seed;
+		auto height = [&](float x, float z) { return sinf(x * 0.6f + phase) * cosf(z * 0.5f) * 0.8f; };
+
+		mesh_data->positions_stream.init(vertex_side * vertex_side);
+		mesh_data->normals_stream.init(vertex_side * vertex_side);
+		mesh_data->texcoords_stream.init(vertex_side * vertex_side);
+		for (uint32_t z = 0; z < vertex_side; ++z)
+		{
+			for (uint32_t x = 0; x < vertex_side; ++x)
 			{
-				mesh_data.indices.data[i + 0] = (uint32_t)cgltf_accessor_read_index(primitive.indices, i + index_map[0]);
-				mesh_data.indices.data[i + 1] = (uint32_t)cgltf_accessor_read_index(primitive.indices, i + index_map[2]);
-				mesh_data.indices.data[i + 2] = (uint32_t)cgltf_accessor_read_index(primitive.indices, i + index_map[1]);
+				const uint32_t vertex = z * vertex_side + x;
+				const float u = (float)x / (float)side;
+				const float v = (float)z / (float)side;
+				const float px = u * size;
+				const float pz = v * size;
+				const float dx = height(px + 0.01f, pz) - height(px - 0.01f, pz);
+				const float dz = height(px, pz + 0.01f) - height(px, pz - 0.01f);
+				const float length = sqrtf(dx * dx + 0.02f * 0.02f + dz * dz);
+				mesh_data->positions_stream.data[vertex] = { px, height(px, pz), pz };
+				mesh_data->normals_stream.data[vertex] = { -dx / length, 0.02f / length, -dz / length };
+				mesh_data->texcoords_stream.data[vertex] = { u, v };
 			}
+		}
 
-			for (size_t attr_index = 0; attr_index < primitive.attributes_count; ++attr_index)
+		mesh_data->indices.init(side * side * 6);
+		uint32_t* index = mesh_data->indices.data;
+		for (uint32_t z = 0; z < side; ++z)
+		{
+			for (uint32_t x = 0; x < side; ++x)
 			{
-				const cgltf_attribute& attribute = primitive.attributes[attr_index];
-				if (attribute.type == cgltf_attribute_type_position)
-				{
-					mesh_data.positions_stream.init(attribute.data->count);
-					size_t unpacked_count = cgltf_accessor_unpack_floats(attribute.data, &mesh_data.positions_stream.data[0].x, attribute.data->count * 3);
-					assert(unpacked_count > 0);
-				}
-				else if (attribute.type == cgltf_attribute_type_normal)
-				{
-					mesh_data.normals_stream.init(attribute.data->count);
-					size_t unpacked_count = cgltf_accessor_unpack_floats(attribute.data, &mesh_data.normals_stream.data[0].x, attribute.data->count * 3);
-					assert(unpacked_count > 0);
-				}
-				else if (attribute.type == cgltf_attribute_type_texcoord && attribute.index == 0) // TODO: Add support for multiple TEXCOORD
-				{
-					mesh_data.texcoords_stream.init(attribute.data->count);
-					size_t unpacked_count = cgltf_accessor_unpack_floats(attribute.data, &mesh_data.texcoords_stream.data[0].x, attribute.data->count * 2);
-					assert(unpacked_count > 0);
-				}
+				const uint32_t corner = z * vertex_side + x;
+				*index++ = corner;
+				*index++ = corner + vertex_side;
+				*index++ = corner + 1;
+				*index++ = corner + 1;
+				*index++ = corner + vertex_side;
+				*index++ = corner + vertex_side + 1;
 			}
+		}
+		return;
+	}
 
-			// Generate MikkTSpace Tangents
-			{
-				mesh_data.tangents_stream.init(mesh_data.positions_stream.count);
+	const uint32_t card_count = 1024 + (seed % 4) * 256;
+	const float card_size = 0.3f;
+	uint32_t random_state = seed;
+	mesh_data->positions_stream.init(card_count * 4);
+	mesh_data->normals_stream.init(card_count * 4);
+	mesh_data->texcoords_stream.init(card_count * 4);
+	mesh_data->indices.init(card_count * 6);
+	for (uint32_t card = 0; card < card_count; ++card)
+	{
+		const float3_t center = { random_float(&random_state) * 4.0f - 2.0f, random_float(&random_state) * 4.0f, random_float(&random_state) * 4.0f - 2.0f };
+		const float angle = random_float(&random_state) * 6.2831853f;
+		const float3_t right = { cosf(angle) * card_size, 0.0f, sinf(angle) * card_size };
+		const float3_t up = { 0.0f, card_size, 0.0f };
+		const float3_t normal = { -sinf(angle), 0.0f, cosf(angle) };
+
+		const uint32_t first_vertex = card * 4;
+		mesh_data->positions_stream.data[first_vertex + 0] = center - right - up;
+		mesh_data->positions_stream.data[first_vertex + 1] = center + right - up;
+		mesh_data->positions_stream.data[first_vertex + 2] = center - right + up;
+		mesh_data->positions_stream.data[first_vertex + 3] = center + right + up;
+		mesh_data->texcoords_stream.data[first_vertex + 0] = { 0.0f, 1.0f };
+		mesh_data->texcoords_stream.data[first_vertex + 1] = { 1.0f, 1.0f };
+		mesh_data->texcoords_stream.data[first_vertex + 2] = { 0.0f, 0.0f };
+		mesh_data->texcoords_stream.data[first_vertex + 3] = { 1.0f, 0.0f };
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			mesh_data->normals_stream.data[first_vertex + i] = normal;
+		}
 
-				SMikkTSpaceInterface mikkt_interface{};
-				mikkt_interface.m_getNumFaces = mikkt_get_num_faces;
-				mikkt_interface.m_getNumVerticesOfFace = mikkt_get_num_vertices_of_face;
-				mikkt_interface.m_getPosition = mikkt_get_position;
-				mikkt_interface.m_getNormal = mikkt_get_normal;
-				mikkt_interface.m_getTexCoord = mikkt_get_tex_coord;
-				mikkt_interface.m_setTSpaceBasic = mikkt_set_tspace_basic;
+		uint32_t* index = mesh_data->indices.data + card * 6;
+		index[0] = first_vertex + 0;
+		index[1] = first_vertex + 2;
+		index[2] = first_vertex + 1;
+		index[3] = first_vertex + 1;
+		index[4] = first_vertex + 2;
+		index[5] = first_vertex + 3;
+	}
+}
 
-				geometry_contenxt_t geom_context{};
-				geom_context.mesh_data = &mesh_datas.data[mesh_index - 1];
+void generate_tangents(mesh_data_t* mesh_data)
+{
+	mesh_data->tangents_stream.init(mesh_data->positions_stream.count);
 
-				SMikkTSpaceContext mikkt_context{};
-				mikkt_context.m_pUserData = (void*)&geom_context;
-				mikkt_context.m_pInterface = &mikkt_interface;
+	SMikkTSpaceInterface mikkt_interface{};
+	mikkt_interface.m_getNumFaces = mikkt_get_num_faces;
+	mikkt_interface.m_getNumVerticesOfFace = mikkt_get_num_vertices_of_face;
+	mikkt_interface.m_getPosition = mikkt_get_position;
+	mikkt_interface.m_getNormal = mikkt_get_normal;
+	mikkt_interface.m_getTexCoord = mikkt_get_tex_coord;
+	mikkt_interface.m_setTSpaceBasic = mikkt_set_tspace_basic;
 
-				genTangSpaceDefault(&mikkt_context);
-			}
+	geometry_contenxt_t geom_context{};
+	geom_context.mesh_data = mesh_data;
 
-			// Optimizations
-			meshopt_optimizeVertexCache(mesh_data.indices.data, mesh_data.indices.data, mesh_data.indices.count, mesh_data.positions_stream.count);
-			meshopt_optimizeOverdraw(mesh_data.indices.data, mesh_data.indices.data, mesh_data.indices.count, &mesh_data.positions_stream.data[0].x, mesh_data.positions_stream.count, sizeof(float3_t), 1.05f);
-
-			fixed_array_t<uint32_t> remap;
-			remap.init(mesh_data.positions_stream.count);
-			meshopt_optimizeVertexFetchRemap(&remap.data[0], mesh_data.indices.data, mesh_data.indices.count, mesh_data.positions_stream.count);
-			meshopt_remapIndexBuffer(mesh_data.indices.data, mesh_data.indices.data, mesh_data.indices.count, &remap.data[0]);
-			meshopt_remapVertexBuffer(mesh_data.positions_stream.data, mesh_data.positions_stream.data, mesh_data.positions_stream.count, sizeof(float3_t), &remap.data[0]);
-			meshopt_remapVertexBuffer(mesh_data.normals_stream.data, mesh_data.normals_stream.data, mesh_data.normals_stream.count, sizeof(float3_t), &remap.data[0]);
-			meshopt_remapVertexBuffer(mesh_data.tangents_stream.data, mesh_data.tangents_stream.data, mesh_data.tangents_stream.count, sizeof(float4_t), &remap.data[0]);
-			meshopt_remapVertexBuffer(mesh_data.texcoords_stream.data, mesh_data.texcoords_stream.data, mesh_data.texcoords_stream.count, sizeof(float2_t), &remap.data[0]);
-			remap.deinit();
-
-			// Meshlet generation
-			{
-				const size_t max_vertices = 64;
-				const size_t max_triangles = 124;
-				const size_t max_meshlets = meshopt_buildMeshletsBound(mesh_data.indices.count, max_vertices, max_triangles);
+	SMikkTSpaceContext mikkt_context{};
+	mikkt_context.m_pUserData = (void*)&geom_context;
+	mikkt_context.m_pInterface = &mikkt_interface;
 
-				mesh_data.meshlets.init(max_meshlets);
-				mesh_data.meshlet_vertices.init(max_meshlets * max_vertices);
+	genTangSpaceDefault(&mikkt_context);
+}
 
-				fixed_array_t<unsigned char> meshlet_triangles;
-				meshlet_triangles.init(max_meshlets * max_triangles * 3);
-				fixed_array_t<meshopt_Meshlet> meshlets;
-				meshlets.init(max_meshlets);
+// Each LoD aims for half the triangles of the one before it and may move the surface twice as
+// far. meshopt errors are relative to the mesh's extents.
+bool simplify_lod(const mesh_data_t& source, uint32_t lod, float lod_error, mesh_data_t* mesh_data, float* result_error, bool* sloppy)
+{
+	assert(lod > 0);
+	const size_t target_index_count = (source.indices.count >> lod) / 3 * 3;
+	const float target_error = lod_error * (float)(1u << (lod - 1));
+	if (target_index_count == 0)
+	{
+		return false;
+	}
 
-				size_t meshlet_count = meshopt_buildMeshlets(meshlets.data, mesh_data.meshlet_vertices.data, meshlet_triangles.data,
-					mesh_data.indices.data, mesh_data.indices.count, &mesh_data.positions_stream.data[0].x, mesh_data.positions_stream.count, sizeof(float3_t), max_vertices, max_triangles, 0);
+	fixed_array_t<uint32_t> indices;
+	indices.init(source.indices.count);
+	float error = 0.0f;
+	size_t index_count = meshopt_simplify(indices.data, source.indices.data, source.indices.count,
+		&source.positions_stream.data[0].x, source.positions_stream.count, sizeof(float3_t), target_index_count, target_error, 0, &error);
 
-				// Trimming
-				meshopt_Meshlet& last = meshlets.data[meshlet_count - 1];
-				meshlet_triangles.resize(last.triangle_offset + ((last.triangle_count * 3 + 3) & ~3));
-				meshlets.resize(meshlet_count);
+	// Foliage cards and other disconnected pieces have no edges to collapse, cluster them instead.
+	if (index_count > target_index_count + target_index_count / 2)
+	{
+		index_count = meshopt_simplifySloppy(indices.data, source.indices.data, source.indices.count,
+			&source.positions_stream.data[0].x, source.positions_stream.count, sizeof(float3_t), target_index_count, target_error, &error);
+		*sloppy = true;
+	}
 
-				mesh_data.meshlets.resize(meshlet_count);
-				mesh_data.meshlet_vertices.resize(last.vertex_offset + last.vertex_count);
-				mesh_data.meshlet_bounds.init(meshlet_count);
-				mesh_data.meshlet_triangles.init(meshlet_triangles.count / 3);
+	if (index_count == 0)
+	{
+		indices.deinit();
+		return false;
+	}
 
-				uint32_t triangle_offset = 0;
-				for (size_t i = 0; i < meshlet_count; ++i)
-				{
-					const meshopt_Meshlet& meshlet = meshlets.data[i];
-					float3_t min = { FLT_MAX, FLT_MAX, FLT_MAX };
-					float3_t max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
-					for (uint32_t k = 0; k < meshlet.triangle_count * 3; ++k)
-					{
-						uint32_t idx = mesh_data.meshlet_vertices.data[meshlet.vertex_offset + meshlet_triangles.data[meshlet.triangle_offset + k]];
-						const float3_t p = mesh_data.positions_stream.data[idx];
-						max = float3_max(max, p);
-						min = float3_min(min, p);
-					}
-					meshlet_bounds_t& out_bounds = mesh_data.meshlet_bounds.data[i];
-					out_bounds.local_center = (max + min) / 2;
-					out_bounds.local_extents = (max - min) / 2;
-
-					// Encode triangles and get rid of 4 bytes padding
-					unsigned char* source_triangles = meshlet_triangles.data + meshlet.triangle_offset;
-					meshopt_optimizeMeshlet(&mesh_data.meshlet_vertices.data[meshlet.vertex_offset], source_triangles, meshlet.triangle_count, meshlet.vertex_count);
-
-					for (uint32_t tri_idx = 0; tri_idx < meshlet.triangle_count; ++tri_idx)
-					{
-						meshlet_triangle_t& tri = mesh_data.meshlet_triangles.data[tri_idx + triangle_offset];
-						tri.v0 = *source_triangles++;
-						tri.v1 = *source_triangles++;
-						tri.v2 = *source_triangles++;
-					}
-
-					meshlet_t& out_meshlet = mesh_data.meshlets.data[i];
-					out_meshlet.triangle_count = meshlet.triangle_count;
-					out_meshlet.triangle_offset = triangle_offset;
-					out_meshlet.vertex_count = meshlet.vertex_count;
-					out_meshlet.vertex_offset = meshlet.vertex_offset;
-					triangle_offset += meshlet.triangle_count;
-				}
+	indices.resize(index_count);
+	mesh_data->indices = indices;
+	copy_array(source.positions_stream, &mesh_data->positions_stream);
+	copy_array(source.normals_stream, &mesh_data->normals_stream);
+	copy_array(source.tangents_stream, &mesh_data->tangents_stream);
+	copy_array(source.texcoords_stream, &mesh_data->texcoords_stream);
+	*result_error = error;
+	return true;
+}
 
-				mesh_data.meshlet_triangles.resize(triangle_offset);
+void optimize_mesh(mesh_data_t* mesh_data)
+{
+	meshopt_optimizeVertexCache(mesh_data->indices.data, mesh_data->indices.data, mesh_data->indices.count, mesh_data->positions_stream.count);
+	meshopt_optimizeOverdraw(mesh_data->indices.data, mesh_data->indices.data, mesh_data->indices.count, &mesh_data->positions_stream.data[0].x, mesh_data->positions_stream.count, sizeof(float3_t), 1.05f);
+
+	fixed_array_t<uint32_t> remap;
+	remap.init(mesh_data->positions_stream.count);
+	size_t vertex_count = meshopt_optimizeVertexFetchRemap(&remap.data[0], mesh_data->indices.data, mesh_data->indices.count, mesh_data->positions_stream.count);
+	meshopt_remapIndexBuffer(mesh_data->indices.data, mesh_data->indices.data, mesh_data->indices.count, &remap.data[0]);
+	meshopt_remapVertexBuffer(mesh_data->positions_stream.data, mesh_data->positions_stream.data, mesh_data->positions_stream.count, sizeof(float3_t), &remap.data[0]);
+	meshopt_remapVertexBuffer(mesh_data->normals_stream.data, mesh_data->normals_stream.data, mesh_data->normals_stream.count, sizeof(float3_t), &remap.data[0]);
+	meshopt_remapVertexBuffer(mesh_data->tangents_stream.data, mesh_data->tangents_stream.data, mesh_data->tangents_stream.count, sizeof(float4_t), &remap.data[0]);
+	meshopt_remapVertexBuffer(mesh_data->texcoords_stream.data, mesh_data->texcoords_stream.data, mesh_data->texcoords_stream.count, sizeof(float2_t), &remap.data[0]);
+	remap.deinit();
+
+	// Simplified LoDs only reference some of the source vertices, the rest ended up at the back.
+	trim_array(&mesh_data->positions_stream, vertex_count);
+	trim_array(&mesh_data->normals_stream, vertex_count);
+	trim_array(&mesh_data->tangents_stream, vertex_count);
+	trim_array(&mesh_data->texcoords_stream, vertex_count);
+}
 
-				meshlets.deinit();
-				meshlet_triangles.deinit();
-			}
+void build_meshlets(mesh_data_t* mesh_data)
+{
+	const size_t max_vertices = MESHLET_MAX_VERTICES;
+	const size_t max_triangles = MESHLET_MAX_TRIANGLES;
+	const size_t max_meshlets = meshopt_buildMeshletsBound(mesh_data->indices.count, max_vertices, max_triangles);
+
+	mesh_data->meshlets.init(max_meshlets);
+	mesh_data->meshlet_vertices.init(max_meshlets * max_vertices);
+
+	fixed_array_t<unsigned char> meshlet_triangles;
+	meshlet_triangles.init(max_meshlets * max_triangles * 3);
+	fixed_array_t<meshopt_Meshlet> meshlets;
+	meshlets.init(max_meshlets);
+
+	size_t meshlet_count = meshopt_buildMeshlets(meshlets.data, mesh_data->meshlet_vertices.data, meshlet_triangles.data,
+		mesh_data->indices.data, mesh_data->indices.count, &mesh_data->positions_stream.data[0].x, mesh_data->positions_stream.count, sizeof(float3_t), max_vertices, max_triangles, 0);
+
+	// Trimming
+	meshopt_Meshlet& last = meshlets.data[meshlet_count - 1];
+	meshlet_triangles.resize(last.triangle_offset + ((last.triangle_count * 3 + 3) & ~3));
+	meshlets.resize(meshlet_count);
+
+	mesh_data->meshlets.resize(meshlet_count);
+	mesh_data->meshlet_vertices.resize(last.vertex_offset + last.vertex_count);
+	mesh_data->meshlet_bounds.init(meshlet_count);
+	mesh_data->meshlet_triangles.init(meshlet_triangles.count / 3);
+
+	uint32_t triangle_offset = 0;
+	for (size_t i = 0; i < meshlet_count; ++i)
+	{
+		const meshopt_Meshlet& meshlet = meshlets.data[i];
+		float3_t min = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float3_t max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t k = 0; k < meshlet.triangle_count * 3; ++k)
+		{
+			uint32_t idx = mesh_data->meshlet_vertices.data[meshlet.vertex_offset + meshlet_triangles.data[meshlet.triangle_offset + k]];
+			const float3_t p = mesh_data->positions_stream.data[idx];
+			max = float3_max(max, p);
+			min = float3_min(min, p);
+		}
+		meshlet_bounds_t& out_bounds = mesh_data->meshlet_bounds.data[i];
+		out_bounds.local_center = (max + min) / 2;
+		out_bounds.local_extents = (max - min) / 2;
+
+		// Encode triangles and get rid of 4 bytes padding
+		unsigned char* source_triangles = meshlet_triangles.data + meshlet.triangle_offset;
+		meshopt_optimizeMeshlet(&mesh_data->meshlet_vertices.data[meshlet.vertex_offset], source_triangles, meshlet.triangle_count, meshlet.vertex_count);
+
+		for (uint32_t tri_idx = 0; tri_idx < meshlet.triangle_count; ++tri_idx)
+		{
+			meshlet_triangle_t& tri = mesh_data->meshlet_triangles.data[tri_idx + triangle_offset];
+			tri.v0 = *source_triangles++;
+			tri.v1 = *source_triangles++;
+			tri.v2 = *source_triangles++;
 		}
+
+		meshlet_t& out_meshlet = mesh_data->meshlets.data[i];
+		out_meshlet.triangle_count = meshlet.triangle_count;
+		out_meshlet.triangle_offset = triangle_offset;
+		out_meshlet.vertex_count = meshlet.vertex_count;
+		out_meshlet.vertex_offset = meshlet.vertex_offset;
+		triangle_offset += meshlet.triangle_count;
 	}
 
-	// Write mesh data to file
+	mesh_data->meshlet_triangles.resize(triangle_offset);
+
+	meshlets.deinit();
+	meshlet_triangles.deinit();
+}
+
+// Reads or generates every primitive, then builds all their LoDs. Each LoD of each primitive is
+// its own job so one big primitive doesn't leave the other workers idle.
+void convert_primitives(fixed_array_t<primitive_t>* primitives, const int index_map[3], uint32_t lod_count, float lod_error, uint32_t worker_count)
+{
+	parallel_for(worker_count, primitives->count, [&](size_t i)
 	{
-		FILE* file = nullptr;
-		errno_t file_result = fopen_s(&file, cl_arguments.output_path, "wb");
-		assert(file_result == 0);
+		primitive_t& primitive = primitives->data[i];
+		if (primitive.gltf_primitive)
+		{
+			read_primitive(*primitive.gltf_primitive, index_map, &primitive.source);
+		}
+		else
+		{
+			generate_synthetic_primitive(primitive.synthetic_seed, &primitive.source);
+		}
+		generate_tangents(&primitive.source);
+	});
 
-		// Write magic
-		fwrite(MESH_MAGIC, sizeof(MESH_MAGIC), 1, file);
+	parallel_for(worker_count, primitives->count * lod_count, [&](size_t job)
+	{
+		primitive_t& primitive = primitives->data[job / lod_count];
+		const uint32_t lod = (uint32_t)(job % lod_count);
+		mesh_data_t& mesh_data = primitive.lods[lod];
+		if (lod == 0)
+		{
+			copy_array(primitive.source.indices, &mesh_data.indices);
+			copy_array(primitive.source.positions_stream, &mesh_data.positions_stream);
+			copy_array(primitive.source.normals_stream, &mesh_data.normals_stream);
+			copy_array(primitive.source.tangents_stream, &mesh_data.tangents_stream);
+			copy_array(primitive.source.texcoords_stream, &mesh_data.texcoords_stream);
+		}
+		else if (!simplify_lod(primitive.source, lod, lod_error, &mesh_data, &primitive.lod_errors[lod], &primitive.lod_sloppy[lod]))
+		{
+			return;
+		}
+
+		optimize_mesh(&mesh_data);
+		build_meshlets(&mesh_data);
+		primitive.lod_built[lod] = true;
+	});
+}
 
-		// Write mesh count
-		fwrite((void*)&mesh_datas.count, sizeof(mesh_datas.count), 1, file);
-		// Write meshes
-		for (uint32_t i = 0; i < mesh_datas.count; ++i)
+void free_primitives(fixed_array_t<primitive_t>* primitives)
+{
+	for (size_t i = 0; i < primitives->count; ++i)
+	{
+		primitive_t& primitive = primitives->data[i];
+		free_mesh_data(&primitive.source);
+		for (uint32_t lod = 0; lod < MESH_LOD_MAX_COUNT; ++lod)
 		{
-			mesh_data_t& mesh_data = mesh_datas.data[i];
+			free_mesh_data(&primitive.lods[lod]);
+			primitive.lod_built[lod] = false;
+			primitive.lod_sloppy[lod] = false;
+			primitive.lod_errors[lod] = 0.0f;
+		}
+	}
+}
 
-			// Write counters
-			fwrite((void*)&mesh_data.indices.count, sizeof(mesh_data.indices.count), 1, file);
-			fwrite((void*)&mesh_data.positions_stream.count, sizeof(mesh_data.positions_stream.count), 1, file);
-			fwrite((void*)&mesh_data.texcoords_stream.count, sizeof(mesh_data.texcoords_stream.count), 1, file);
-			fwrite((void*)&mesh_data.normals_stream.count, sizeof(mesh_data.normals_stream.count), 1, file);
-			fwrite((void*)&mesh_data.tangents_stream.count, sizeof(mesh_data.tangents_stream.count), 1, file);
-			fwrite((void*)&mesh_data.meshlets.count, sizeof(mesh_data.meshlets.count), 1, file);
-			fwrite((void*)&mesh_data.meshlet_bounds.count, sizeof(mesh_data.meshlet_bounds.count), 1, file);
-			fwrite((void*)&mesh_data.meshlet_triangles.count, sizeof(mesh_data.meshlet_triangles.count), 1, file);
-			fwrite((void*)&mesh_data.meshlet_vertices.count, sizeof(mesh_data.meshlet_vertices.count), 1, file);
+// A file gets as many LoDs as all of its primitives have, each noticeably smaller than the last.
+uint32_t resolve_lod_count(const primitive_t* primitives, uint32_t primitive_count, uint32_t lod_count)
+{
+	for (uint32_t lod = 1; lod < lod_count; ++lod)
+	{
+		for (uint32_t i = 0; i < primitive_count; ++i)
+		{
+			const primitive_t& primitive = primitives[i];
+			if (!primitive.lod_built[lod] || primitive.lods[lod].indices.count * 10 > primitive.lods[lod - 1].indices.count * 9)
+			{
+				return lod;
+			}
+		}
+	}
+	return lod_count;
+}
 
-			// Write data
-			fwrite((void*)&mesh_data.indices.data[0], sizeof(mesh_data.indices.data[0]) * mesh_data.indices.count, 1, file);
-			fwrite((void*)&mesh_data.positions_stream.data[0], sizeof(mesh_data.positions_stream.data[0]) * mesh_data.positions_stream.count, 1, file);
-			fwrite((void*)&mesh_data.texcoords_stream.data[0], sizeof(mesh_data.texcoords_stream.data[0]) * mesh_data.texcoords_stream.count, 1, file);
-			fwrite((void*)&mesh_data.normals_stream.data[0], sizeof(mesh_data.normals_stream.data[0]) * mesh_data.normals_stream.count, 1, file);
-			fwrite((void*)&mesh_data.tangents_stream.data[0], sizeof(mesh_data.tangents_stream.data[0]) * mesh_data.tangents_stream.count, 1, file);
-			fwrite((void*)&mesh_data.meshlets.data[0], sizeof(mesh_data.meshlets.data[0])* mesh_data.meshlets.count, 1, file);
-			fwrite((void*)&mesh_data.meshlet_bounds.data[0], sizeof(mesh_data.meshlet_bounds.data[0])* mesh_data.meshlet_bounds.count, 1, file);
-			fwrite((void*)&mesh_data.meshlet_triangles.data[0], sizeof(mesh_data.meshlet_triangles.data[0])* mesh_data.meshlet_triangles.count, 1, file);
-			fwrite((void*)&mesh_data.meshlet_vertices.data[0], sizeof(mesh_data.meshlet_vertices.data[0])* mesh_data.meshlet_vertices.count, 1, file);
+// content/.../beech_tree_04_LOD0.mesh becomes beech_tree_04_LOD1.mesh, other names get the
+// suffix in front of the extension.
+void lod_output_path(const char* output_path, uint32_t lod, char* path)
+{
+	if (lod == 0)
+	{
+		snprintf(path, MAX_PATH_LENGTH, "%s", output_path);
+		return;
+	}
+
+	size_t stem_length = strlen(output_path);
+	const char* extension = strrchr(output_path, '.');
+	const char* separator = strrchr(output_path, '/');
+	const char* windows_separator = strrchr(output_path, '\\');
+	if (extension && extension > separator && extension > windows_separator)
+	{
+		stem_length = (size_t)(extension - output_path);
+	}
+	else
+	{
+		extension = "";
+	}
+
+	if (stem_length >= 5 && strncmp(output_path + stem_length - 5, "_LOD0", 5) == 0)
+	{
+		stem_length -= 5;
+	}
+	snprintf(path, MAX_PATH_LENGTH, "%.*s_LOD%u%s", (int)stem_length, output_path, lod, extension);
+}
+
+bool write_mesh_file(const char* path, const mesh_data_t* const* meshes, uint32_t mesh_count, bool test_output_file, size_t* decoded_bytes, size_t* stored_bytes)
+{
+	mesh_header_t* mesh_headers = (mesh_header_t*)calloc(mesh_count, sizeof(mesh_header_t));
+	assert(mesh_headers);
+	encoded_stream_t* encoded_streams = (encoded_stream_t*)calloc(mesh_count * mesh_stream_count, sizeof(encoded_stream_t));
+	assert(encoded_streams);
+
+	const uint64_t data_offset = align_up(sizeof(file_header_t) + sizeof(mesh_header_t) * mesh_count, MESH_DATA_ALIGNMENT);
+	uint64_t offset = data_offset;
+	*decoded_bytes = 0;
+	*stored_bytes = 0;
+	for (uint32_t i = 0; i < mesh_count; ++i)
+	{
+		mesh_header_t& header = mesh_headers[i];
+		init_mesh_header(*meshes[i], &header);
+		for (uint32_t stream = 0; stream < mesh_stream_count; ++stream)
+		{
+			encoded_stream_t& encoded = encoded_streams[i * mesh_stream_count + stream];
+			encoded = compress_stream(encode_stream(*meshes[i], header, (mesh_stream_e)stream));
+
+			offset = align_up(offset, MESH_STREAM_ALIGNMENT);
+			stream_desc_t& desc = header.streams[stream];
+			desc.offset = offset;
+			desc.size = (uint32_t)encoded.size;
+			desc.decoded_size = (uint32_t)encoded.decoded_size;
+			desc.codec = encoded.codec;
+			offset += encoded.size;
+			*decoded_bytes += encoded.decoded_size;
+			*stored_bytes += encoded.size;
+		}
+	}
+
+	bool success = false;
+	FILE* file = fopen(path, "wb");
+	if (file)
+	{
+		file_header_t file_header = {};
+		memcpy(file_header.magic, MESH_MAGIC, sizeof(MESH_MAGIC));
+		file_header.version = MESH_VERSION;
+		file_header.mesh_count = mesh_count;
+		file_header.data_offset = data_offset;
+		fwrite(&file_header, sizeof(file_header), 1, file);
+		fwrite(mesh_headers, sizeof(mesh_header_t), mesh_count, file);
+
+		uint64_t written = sizeof(file_header_t) + sizeof(mesh_header_t) * mesh_count;
+		for (uint32_t i = 0; i < mesh_count; ++i)
+		{
+			for (uint32_t stream = 0; stream < mesh_stream_count; ++stream)
+			{
+				const stream_desc_t& desc = mesh_headers[i].streams[stream];
+				write_padding(file, desc.offset - written);
+				fwrite(encoded_streams[i * mesh_stream_count + stream].data, desc.size, 1, file);
+				written = desc.offset + desc.size;
+			}
 		}
+		success = ferror(file) == 0;
 		fclose(file);
 		file = nullptr;
 	}
 
 	// Read to test
-	if (cl_arguments.test_output_file)
+	if (success && test_output_file)
 	{
-		FILE* file = nullptr;
-		errno_t file_result = fopen_s(&file, cl_arguments.output_path, "rb");
-		assert(file_result == 0);
-		
-		char magic[16];
-		fread(&magic, sizeof(MESH_MAGIC), 1, file);
-
-		size_t mesh_count = 0;
-		fread(&mesh_count, sizeof(mesh_count), 1, file);
-		assert(mesh_count == mesh_datas.count);
-		for (uint32_t i = 0; i < mesh_datas.count; ++i)
-		{
-			mesh_data_t& mesh_data = mesh_datas.data[i];
-			// Read counters
-			size_t index_count = 0;
-			fread(&index_count, sizeof(index_count), 1, file);
-			assert(index_count == mesh_data.indices.count);
-			size_t positions_count = 0;
-			fread(&positions_count, sizeof(positions_count), 1, file);
-			assert(positions_count == mesh_data.positions_stream.count);
-			size_t texcoords_count = 0;
-			fread(&texcoords_count, sizeof(texcoords_count), 1, file);
-			assert(texcoords_count == mesh_data.texcoords_stream.count);
-			size_t normals_count = 0;
-			fread(&normals_count, sizeof(normals_count), 1, file);
-			assert(normals_count == mesh_data.normals_stream.count);
-			size_t tangents_count = 0;
-			fread(&tangents_count, sizeof(tangents_count), 1, file);
-			assert(tangents_count == mesh_data.tangents_stream.count);
-			size_t meshlets_count = 0;
-			fread(&meshlets_count, sizeof(meshlets_count), 1, file);
-			assert(meshlets_count == mesh_data.meshlets.count);
-			size_t meshlet_bounds_count = 0;
-			fread(&meshlet_bounds_count, sizeof(meshlet_bounds_count), 1, file);
-			assert(meshlet_bounds_count == mesh_data.meshlet_bounds.count);
-			size_t meshlet_triangles_count = 0;
-			fread(&meshlet_triangles_count, sizeof(meshlet_triangles_count), 1, file);
-			assert(meshlet_triangles_count == mesh_data.meshlet_triangles.count);
-			size_t meshlet_vertices_count = 0;
-			fread(&meshlet_vertices_count, sizeof(meshlet_vertices_count), 1, file);
-			assert(meshlet_vertices_count == mesh_data.meshlet_vertices.count);
-			// Read data
+		file = fopen(path, "rb");
+		assert(file);
+
+		file_header_t file_header = {};
+		size_t read_count = fread(&file_header, sizeof(file_header), 1, file);
+		assert(read_count == 1);
+		assert(memcmp(file_header.magic, MESH_MAGIC, sizeof(MESH_MAGIC)) == 0);
+		assert(file_header.version == MESH_VERSION);
+		assert(file_header.mesh_count == mesh_count);
+		assert(file_header.data_offset % MESH_DATA_ALIGNMENT == 0);
+
+		for (uint32_t i = 0; i < mesh_count; ++i)
+		{
+			mesh_header_t header = {};
+			read_count = fread(&header, sizeof(header), 1, file);
+			assert(read_count == 1);
+			assert(memcmp(&header, &mesh_headers[i], sizeof(header)) == 0);
+		}
+
+		for (uint32_t i = 0; i < mesh_count; ++i)
+		{
+			for (uint32_t stream = 0; stream < mesh_stream_count; ++stream)
 			{
-				size_t size = sizeof(uint32_t) * mesh_data.indices.count;
-				uint32_t* indices = (uint32_t*)malloc(size);
-				assert(indices);
-				fread((void*)indices, size, 1, file);
-				for (uint32_t ii = 0; ii < mesh_data.indices.count; ++ii)
+				const stream_desc_t& desc = mesh_headers[i].streams[stream];
+				assert(desc.offset % MESH_STREAM_ALIGNMENT == 0);
+				if (desc.size == 0)
 				{
-					assert(indices[ii] == mesh_data.indices.data[ii]);
+					continue;
 				}
-				free(indices);
-				indices = nullptr;
+
+				uint8_t* data = (uint8_t*)malloc(desc.size);
+				assert(data);
+				seek_file(file, desc.offset);
+				read_count = fread(data, desc.size, 1, file);
+				assert(read_count == 1);
+				assert(memcmp(data, encoded_streams[i * mesh_stream_count + stream].data, desc.size) == 0);
+				free(data);
+				data = nullptr;
 			}
+		}
+		(void)read_count;
+
+		fclose(file);
+		file = nullptr;
+	}
+
+	for (uint32_t i = 0; i < mesh_count * mesh_stream_count; ++i)
+	{
+		free(encoded_streams[i].data);
+	}
+	free(encoded_streams);
+	free(mesh_headers);
+	return success;
+}
+
+// Batch lists have one "<input.gltf> <output.mesh>" pair per line, lines starting with # are
+// skipped. Only counts the pairs when conversions is null.
+size_t read_batch_list(const char* path, conversion_t* conversions)
+{
+	FILE* file = fopen(path, "r");
+	if (file == nullptr)
+	{
+		printf("Can't open batch list '%s'\n", path);
+		return 0;
+	}
+
+	char line[MAX_PATH_LENGTH * 2 + 2];
+	char input_path[MAX_PATH_LENGTH];
+	char output_path[MAX_PATH_LENGTH];
+	size_t count = 0;
+	while (fgets(line, sizeof(line), file))
+	{
+		if (sscanf(line, "%1023s %1023s", input_path, output_path) != 2 || input_path[0] == '#')
+		{
+			continue;
+		}
+
+		if (conversions)
+		{
+			snprintf(conversions[count].input_path, MAX_PATH_LENGTH, "%s", input_path);
+			snprintf(conversions[count].output_path, MAX_PATH_LENGTH, "%s", output_path);
+		}
+		count++;
+	}
+
+	fclose(file);
+	return count;
+}
+
+size_t count_triangles(const fixed_array_t<primitive_t>& primitives, uint32_t lod)
+{
+	size_t triangles = 0;
+	for (size_t i = 0; i < primitives.count; ++i)
+	{
+		triangles += primitives.data[i].lods[lod].indices.count / 3;
+	}
+	return triangles;
+}
+
+void print_lod_report(const fixed_array_t<primitive_t>& primitives, uint32_t lod_count)
+{
+	for (uint32_t lod = 1; lod < lod_count; ++lod)
+	{
+		size_t triangles = 0;
+		size_t base_triangles = 0;
+		uint32_t built_count = 0;
+		uint32_t sloppy_count = 0;
+		float max_error = 0.0f;
+		for (size_t i = 0; i < primitives.count; ++i)
+		{
+			const primitive_t& primitive = primitives.data[i];
+			if (!primitive.lod_built[lod])
 			{
-				size_t size = sizeof(float3_t) * mesh_data.positions_stream.count;
-				float3_t* positions = (float3_t*)malloc(size);
-				assert(positions);
-				fread((void*)positions, size, 1, file);
-				for (uint32_t ii = 0; ii < mesh_data.positions_stream.count; ++ii)
-				{
-					assert(positions[ii] == mesh_data.positions_stream.data[ii]);
-				}
-				free(positions);
-				positions = nullptr;
-			}	
-			{
-				size_t size = sizeof(float2_t) * mesh_data.texcoords_stream.count;
-				float2_t* texcoords = (float2_t*)malloc(size);
-				assert(texcoords);
-				fread((void*)texcoords, size, 1, file);
-				for (uint32_t ii = 0; ii < mesh_data.texcoords_stream.count; ++ii)
-				{
-					assert(texcoords[ii] == mesh_data.texcoords_stream.data[ii]);
-				}
-				free(texcoords);
-				texcoords = nullptr;
+				continue;
 			}
+
+			triangles += primitive.lods[lod].indices.count / 3;
+			base_triangles += primitive.lods[0].indices.count / 3;
+			built_count++;
+			sloppy_count += primitive.lod_sloppy[lod] ? 1 : 0;
+			max_error = primitive.lod_errors[lod] > max_error ? primitive.lod_errors[lod] : max_error;
+		}
+
+		printf("LOD%u: %u/%zu primitives (%u sloppy), %zu triangles, %.1f%% of their LOD0, error at most %.2f%% of the extents\n",
+			lod, built_count, primitives.count, sloppy_count, triangles, base_triangles > 0 ? 100.0 * (double)triangles / (double)base_triangles : 0.0, max_error * 100.0f);
+	}
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void print_throughput(const char* name, double seconds, size_t file_count, size_t primitive_count, size_t triangle_count)
+{
+	printf("%-12s %8.3f s  %8.1f files/s  %8.1f primitives/s  %10.0f triangles/s\n", name, seconds,
+		(double)file_count / seconds, (double)primitive_count / seconds, (double)triangle_count / seconds);
+}
+
+void print_usage()
+{
+	printf("Usage: model_converter [--input <file.gltf> --output <file.mesh>]... [--batch <list>] [--ccw] [--test-output]\n");
+	printf("                       [--lods <1-%u>] [--lod-error <relative error>] [--jobs <count>] [--benchmark]\n", MESH_LOD_MAX_COUNT);
+}
+
+int main(int argc, char** argv)
+{
+	printf("Model Converter\n");
+
+	// Parsing arguments
+	command_line_arguments_t cl_arguments = {};
+	cl_arguments.lod_count = 1;
+	cl_arguments.lod_error = 0.01f;
+	cl_arguments.worker_count = std::thread::hardware_concurrency();
+	fixed_array_t<const char*> input_paths;
+	input_paths.init(argc);
+	fixed_array_t<const char*> output_paths;
+	output_paths.init(argc);
+	size_t input_count = 0;
+	size_t output_count = 0;
+
+	int32_t arg_cursor = 1;
+	while (arg_cursor < argc)
+	{
+		const char* argument = argv[arg_cursor];
+		const bool has_value = arg_cursor + 1 < argc;
+		if (strcmp("--input", argument) == 0 && has_value)
+		{
+			input_paths.data[input_count++] = argv[++arg_cursor];
+		}
+		else if (strcmp("--output", argument) == 0 && has_value)
+		{
+			output_paths.data[output_count++] = argv[++arg_cursor];
+		}
+		else if (strcmp("--batch", argument) == 0 && has_value)
+		{
+			cl_arguments.batch_path = argv[++arg_cursor];
+		}
+		else if (strcmp("--lods", argument) == 0 && has_value)
+		{
+			cl_arguments.lod_count = (uint32_t)atoi(argv[++arg_cursor]);
+		}
+		else if (strcmp("--lod-error", argument) == 0 && has_value)
+		{
+			cl_arguments.lod_error = (float)atof(argv[++arg_cursor]);
+		}
+		else if (strcmp("--jobs", argument) == 0 && has_value)
+		{
+			cl_arguments.worker_count = (uint32_t)atoi(argv[++arg_cursor]);
+		}
+		else if (strcmp("--ccw", argument) == 0)
+		{
+			cl_arguments.counter_clock_wise_winding = true;
+		}
+		else if (strcmp("--test-output", argument) == 0)
+		{
+			cl_arguments.test_output_file = true;
+		}
+		else if (strcmp("--benchmark", argument) == 0)
+		{
+			cl_arguments.benchmark = true;
+		}
+		else
+		{
+			printf("Unknown argument '%s'\n", argument);
+			print_usage();
+			return 1;
+		}
+		arg_cursor++;
+	}
+
+	const size_t batch_count = cl_arguments.batch_path ? read_batch_list(cl_arguments.batch_path, nullptr) : 0;
+	if (input_count != output_count || (input_count + batch_count == 0 && !cl_arguments.benchmark))
+	{
+		print_usage();
+		return 1;
+	}
+
+	cl_arguments.lod_count = cl_arguments.lod_count < 1 ? 1 : (cl_arguments.lod_count > MESH_LOD_MAX_COUNT ? MESH_LOD_MAX_COUNT : cl_arguments.lod_count);
+	cl_arguments.worker_count = cl_arguments.worker_count < 1 ? 1 : cl_arguments.worker_count;
+
+	printf("Files: %zu\n", input_count + batch_count);
+	printf("Winding: '%s'\n", cl_arguments.counter_clock_wise_winding ? "CCW" : "CW");
+	printf("Test Output File: '%s'\n", cl_arguments.test_output_file ? "Yes" : "No");
+	printf("LoDs: %u, error %.3f\n", cl_arguments.lod_count, cl_arguments.lod_error);
+	printf("Workers: %u\n", cl_arguments.worker_count);
+
+	int index_map[3];
+	if (cl_arguments.counter_clock_wise_winding)
+	{
+		memcpy(&index_map[0], &counter_clock_wise_index_map[0], 3 * sizeof(int));
+	}
+	else
+	{
+		memcpy(&index_map[0], &clock_wise_index_map[0], 3 * sizeof(int));
+	}
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	fixed_array_t<conversion_t> conversions;
+	conversions.init(input_count + batch_count > 0 ? input_count + batch_count : 1);
+	conversions.count = input_count + batch_count;
+	for (size_t i = 0; i < input_count; ++i)
+	{
+		snprintf(conversions.data[i].input_path, MAX_PATH_LENGTH, "%s", input_paths.data[i]);
+		snprintf(conversions.data[i].output_path, MAX_PATH_LENGTH, "%s", output_paths.data[i]);
+	}
+	if (batch_count > 0)
+	{
+		read_batch_list(cl_arguments.batch_path, conversions.data + input_count);
+	}
+	input_paths.deinit();
+	output_paths.deinit();
+
+	std::atomic<uint32_t> failed_count(0);
+	parallel_for(cl_arguments.worker_count, conversions.count, [&](size_t i)
+	{
+		conversion_t& conversion = conversions.data[i];
+		cgltf_options options{};
+		cgltf_result result = cgltf_parse_file(&options, conversion.input_path, &conversion.gltf_data);
+		if (result == cgltf_result_success)
+		{
+			result = cgltf_load_buffers(&options, conversion.gltf_data, conversion.input_path);
+		}
+
+		if (result != cgltf_result_success)
+		{
+			printf("Can't load '%s' (cgltf error %d)\n", conversion.input_path, (int)result);
+			cgltf_free(conversion.gltf_data);
+			conversion.gltf_data = nullptr;
+			failed_count++;
+		}
+	});
+
+	uint32_t primitive_count = 0;
+	for (size_t i = 0; i < conversions.count; ++i)
+	{
+		conversion_t& conversion = conversions.data[i];
+		conversion.first_primitive = primitive_count;
+		for (size_t mi = 0; conversion.gltf_data && mi < conversion.gltf_data->meshes_count; ++mi)
+		{
+			conversion.primitive_count += (uint32_t)conversion.gltf_data->meshes[mi].primitives_count;
+		}
+		primitive_count += conversion.primitive_count;
+	}
+
+	// Without files the benchmark converts generated meshes, and never writes anything.
+	const bool synthetic = conversions.count == 0;
+	const uint32_t synthetic_primitive_count = 48;
+	fixed_array_t<primitive_t> primitives;
+	primitives.init(synthetic ? synthetic_primitive_count : (primitive_count > 0 ? primitive_count : 1));
+	primitives.count = synthetic ? synthetic_primitive_count : primitive_count;
+	if (synthetic)
+	{
+		for (uint32_t i = 0; i < synthetic_primitive_count; ++i)
+		{
+			primitives.data[i].synthetic_seed = i;
+		}
+	}
+	for (size_t i = 0; i < conversions.count; ++i)
+	{
+		const conversion_t& conversion = conversions.data[i];
+		uint32_t primitive_index = conversion.first_primitive;
+		for (size_t mi = 0; conversion.gltf_data && mi < conversion.gltf_data->meshes_count; ++mi)
+		{
+			const cgltf_mesh& mesh = conversion.gltf_data->meshes[mi];
+			for (size_t pi = 0; pi < mesh.primitives_count; ++pi)
 			{
-				size_t size = sizeof(float3_t) * mesh_data.normals_stream.count;
-				float3_t* normals = (float3_t*)malloc(size);
-				assert(normals);
-				fread((void*)normals, size, 1, file);
-				for (uint32_t ii = 0; ii < mesh_data.normals_stream.count; ++ii)
-				{
-					assert(normals[ii] == mesh_data.normals_stream.data[ii]);
-				}
-				free(normals);
-				normals = nullptr;
+				primitives.data[primitive_index++].gltf_primitive = &mesh.primitives[pi];
 			}
+		}
+	}
+
+	if (cl_arguments.benchmark)
+	{
+		const uint32_t worker_counts[] = { 1, cl_arguments.worker_count };
+		for (uint32_t run = 0; run < 2; ++run)
+		{
+			if (run > 0 && worker_counts[run] == worker_counts[0])
 			{
-				size_t size = sizeof(float4_t) * mesh_data.tangents_stream.count;
-				float4_t* tangents = (float4_t*)malloc(size);
-				assert(tangents);
-				fread((void*)tangents, size, 1, file);
-				for (uint32_t ii = 0; ii < mesh_data.tangents_stream.count; ++ii)
-				{
-					assert(tangents[ii] == mesh_data.tangents_stream.data[ii]);
-				}
-				free(tangents);
-				tangents = nullptr;
+				break;
 			}
+
+			free_primitives(&primitives);
+			const std::chrono::steady_clock::time_point run_start = std::chrono::steady_clock::now();
+			convert_primitives(&primitives, index_map, cl_arguments.lod_count, cl_arguments.lod_error, worker_counts[run]);
+			const double seconds = seconds_since(run_start);
+
+			char name[32];
+			snprintf(name, sizeof(name), "%u thread%s", worker_counts[run], worker_counts[run] > 1 ? "s" : "");
+			print_throughput(name, seconds, conversions.count, primitives.count, count_triangles(primitives, 0));
+		}
+		print_lod_report(primitives, cl_arguments.lod_count);
+	}
+	else
+	{
+		convert_primitives(&primitives, index_map, cl_arguments.lod_count, cl_arguments.lod_error, cl_arguments.worker_count);
+
+		for (size_t i = 0; i < conversions.count; ++i)
+		{
+			conversion_t& conversion = conversions.data[i];
+			conversion.lod_count = conversion.gltf_data ? resolve_lod_count(primitives.data + conversion.first_primitive, conversion.primitive_count, cl_arguments.lod_count) : 0;
+		}
+
+		parallel_for(cl_arguments.worker_count, conversions.count * MESH_LOD_MAX_COUNT, [&](size_t job)
+		{
+			conversion_t& conversion = conversions.data[job / MESH_LOD_MAX_COUNT];
+			const uint32_t lod = (uint32_t)(job % MESH_LOD_MAX_COUNT);
+			if (lod >= conversion.lod_count)
 			{
-				size_t size = sizeof(meshlet_t) * mesh_data.meshlets.count;
-				meshlet_t* meshlets = (meshlet_t*)malloc(size);
-				assert(meshlets);
-				fread((void*)meshlets, size, 1, file);
-				for (uint32_t ii = 0; ii < mesh_data.meshlets.count; ++ii)
-				{
-					assert(meshlets[ii] == mesh_data.meshlets.data[ii]);
-				}
-				free(meshlets);
-				meshlets = nullptr;
+				return;
 			}
+
+			const mesh_data_t** meshes = (const mesh_data_t**)calloc(conversion.primitive_count > 0 ? conversion.primitive_count : 1, sizeof(mesh_data_t*));
+			assert(meshes);
+			for (uint32_t pi = 0; pi < conversion.primitive_count; ++pi)
 			{
-				size_t size = sizeof(meshlet_bounds_t) * mesh_data.meshlet_bounds.count;
-				meshlet_bounds_t* meshlet_bounds = (meshlet_bounds_t*)malloc(size);
-				assert(meshlet_bounds);
-				fread((void*)meshlet_bounds, size, 1, file);
-				for (uint32_t ii = 0; ii < mesh_data.meshlet_bounds.count; ++ii)
-				{
-					assert(meshlet_bounds[ii] == mesh_data.meshlet_bounds.data[ii]);
-				}
-				free(meshlet_bounds);
-				meshlet_bounds = nullptr;
+				meshes[pi] = &primitives.data[conversion.first_primitive + pi].lods[lod];
 			}
+
+			char path[MAX_PATH_LENGTH];
+			lod_output_path(conversion.output_path, lod, path);
+			if (!write_mesh_file(path, meshes, conversion.primitive_count, cl_arguments.test_output_file, &conversion.decoded_bytes[lod], &conversion.stored_bytes[lod]))
 			{
-				size_t size = sizeof(meshlet_triangle_t) * mesh_data.meshlet_triangles.count;
-				meshlet_triangle_t* meshlet_triangles = (meshlet_triangle_t*)malloc(size);
-				assert(meshlet_triangles);
-				fread((void*)meshlet_triangles, size, 1, file);
-				for (uint32_t ii = 0; ii < mesh_data.meshlet_triangles.count; ++ii)
-				{
-					assert(meshlet_triangles[ii] == mesh_data.meshlet_triangles.data[ii]);
-				}
-				free(meshlet_triangles);
-				meshlet_triangles = nullptr;
+				printf("Can't write '%s'\n", path);
+				failed_count++;
 			}
+			free(meshes);
+		});
+
+		const double seconds = seconds_since(start);
+		for (size_t i = 0; i < conversions.count; ++i)
+		{
+			const conversion_t& conversion = conversions.data[i];
+			for (uint32_t lod = 0; lod < conversion.lod_count; ++lod)
 			{
-				size_t size = sizeof(uint32_t) * mesh_data.meshlet_vertices.count;
-				uint32_t* meshlet_vertices = (uint32_t*)malloc(size);
-				assert(meshlet_vertices);
-				fread((void*)meshlet_vertices, size, 1, file);
-				for (uint32_t ii = 0; ii < mesh_data.meshlet_vertices.count; ++ii)
-				{
-					assert(meshlet_vertices[ii] == mesh_data.meshlet_vertices.data[ii]);
-				}
-				free(meshlet_vertices);
-				meshlet_vertices = nullptr;
+				char path[MAX_PATH_LENGTH];
+				lod_output_path(conversion.output_path, lod, path);
+				printf("'%s' -> '%s': %u meshes, %zu bytes quantized, %zu bytes stored\n", conversion.input_path, path,
+					conversion.primitive_count, conversion.decoded_bytes[lod], conversion.stored_bytes[lod]);
 			}
 		}
 
-		fclose(file);
-		file = nullptr;
+		print_throughput("Converted", seconds, conversions.count, primitives.count, count_triangles(primitives, 0));
+		print_lod_report(primitives, cl_arguments.lod_count);
 	}
 
-	for (uint32_t i = 0; i < mesh_datas.count; ++i)
+	free_primitives(&primitives);
+	primitives.deinit();
+	for (size_t i = 0; i < conversions.count; ++i)
 	{
-		mesh_data_t& mesh_data = mesh_datas.data[i];
-		mesh_data.indices.deinit();
-		mesh_data.positions_stream.deinit();
-		mesh_data.normals_stream.deinit();
-		mesh_data.tangents_stream.deinit();
-		mesh_data.texcoords_stream.deinit();
-		mesh_data.meshlets.deinit();
-		mesh_data.meshlet_bounds.deinit();
-		mesh_data.meshlet_triangles.deinit();
-		mesh_data.meshlet_vertices.deinit();
+		cgltf_free(conversions.data[i].gltf_data);
 	}
+	conversions.deinit();
 
-	mesh_datas.deinit();
-	mesh_indices.deinit();
-	cgltf_free(gltf_data);
-
-	return 0;	
+	return failed_count > 0 ? 1 : 0;
 }
\ No newline at end of file
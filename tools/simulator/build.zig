@@ -39,6 +39,24 @@ pub fn buildExe(b: *std.Build, target: std.Build.ResolvedTarget, optimize: std.b
         .imports = &.{},
     }));
 
+    // Patch formats shared with the game
+    const mapped_file = b.createModule(.{
+        .root_source_file = b.path("../../src/core/mapped_file.zig"),
+        .imports = &.{},
+    });
+    const patch_archive = b.createModule(.{
+        .root_source_file = b.path("../../src/worldpatch/patch_archive.zig"),
+        .imports = &.{
+            .{ .name = "mapped_file", .module = mapped_file },
+        },
+    });
+    exe.root_module.addImport("patch_archive", patch_archive);
+    const props_format = b.createModule(.{
+        .root_source_file = b.path("../../src/worldpatch/props_format.zig"),
+        .imports = &.{},
+    });
+    exe.root_module.addImport("props_format", props_format);
+
     // zigimg
     const zigimg = b.dependency("zigimg", .{
         .target = target,
@@ -86,6 +104,63 @@ pub fn buildExe(b: *std.Build, target: std.Build.ResolvedTarget, optimize: std.b
 
     const run_step = b.step("run", "Run the app");
     run_step.dependOn(&run_cmd.step);
+
+    // Per-kernel throughput of the CPU compute backend, 16384x16384 unless --benchmark-size is passed.
+    const bench_cmd = b.addRunArtifact(exe);
+    bench_cmd.addArg("--benchmark");
+    if (b.args) |args| {
+        bench_cmd.addArgs(args);
+    }
+
+    const bench_step = b.step("bench", "Benchmark the CPU compute kernels");
+    bench_step.dependOn(&bench_cmd.step);
+
+    // Opens the UI and compares every CPU compute kernel against ui.dll's D3D11 shaders.
+    const check_compute_cmd = b.addRunArtifact(exe);
+    check_compute_cmd.addArg("--check-compute");
+    if (b.args) |args| {
+        check_compute_cmd.addArgs(args);
+    }
+
+    const check_compute_step = b.step("check-compute", "Compare the CPU compute kernels against the D3D11 shaders");
+    check_compute_step.dependOn(&check_compute_cmd.step);
+
+    // Road pathfinding between 256 cities of a 16 km heightmap.
+    const bench_roads_cmd = b.addRunArtifact(exe);
+    bench_roads_cmd.addArgs(&.{ "--benchmark-roads", "256" });
+    if (b.args) |args| {
+        bench_roads_cmd.addArgs(args);
+    }
+
+    const bench_roads_step = b.step("bench-roads", "Benchmark the road pathfinder");
+    bench_roads_step.dependOn(&bench_roads_cmd.step);
+
+    // Tests of the sim modules that run without ui.dll.
+    const test_step = b.step("test", "Run the simulator tests");
+    const test_files = [_][]const u8{
+        "src/sim/compute.zig",
+        "src/sim/node_cache.zig",
+        "src/sim/tiled_image.zig",
+    };
+    for (test_files) |test_file| {
+        const tests = b.addTest(.{
+            .root_source_file = b.path(test_file),
+            .target = target,
+            .optimize = optimize,
+        });
+        tests.linkLibC();
+        tests.addIncludePath(b.path("src"));
+        tests.addIncludePath(b.path("src/sim"));
+        tests.addIncludePath(b.path("src/sim_cpp"));
+        tests.root_module.addImport("patch_archive", patch_archive);
+        tests.root_module.addImport("props_format", props_format);
+        tests.root_module.addImport("zigimg", zigimg.module("zigimg"));
+        tests.root_module.addImport("zmath", zmath.module("root"));
+        tests.root_module.addImport("znoise", znoise.module("root"));
+        tests.linkLibrary(znoise.artifact("FastNoiseLite"));
+        tests.root_module.addImport("zstbi", zstbi.module("root"));
+        test_step.dependOn(&b.addRunArtifact(tests).step);
+    }
 }
 
 pub fn buildCppNodesDll(b: *std.Build, target: std.Build.ResolvedTarget, optimize: std.builtin.OptimizeMode) void {
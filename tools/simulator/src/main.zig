@@ -4,6 +4,8 @@ const args = @import("args");
 const sim_api = @import("sim/api.zig");
 const Simulator = @import("sim/simulator.zig").Simulator;
 const compute = @import("sim/compute.zig");
+const compute_cpu = @import("sim/compute_cpu.zig");
+const pathfinding = @import("sim/nodes/pathfinding.zig");
 
 const c_ui = @cImport({
     @cInclude("main_cpp.h");
@@ -11,35 +13,102 @@ const c_ui = @cImport({
 
 pub fn main() void {
     const options = args.parseForCurrentProcess(struct {
-        generate: bool = false,
+        generate: bool = false, // Runs the graph headless, on the CPU backend
+        cpu: bool = false, // Compute nodes run on the CPU instead of ui.dll's D3D11 shaders
+        jobs: ?u32 = null, // CPU backend worker threads besides the main one
+        benchmark: bool = false, // Times every CPU compute kernel
+        @"benchmark-size": u32 = 16384,
+        @"benchmark-roads": ?u32 = null, // Times road pathfinding between this many cities
+        @"tile-cache-mb": u32 = 2048, // Parked image tiles kept in memory before spilling to disk
+        @"graph-jobs": ?u32 = null, // Graph nodes running at once, CPU backend only
+        @"cache-dir": ?[]const u8 = null, // Caches node outputs between runs
+        @"check-compute": bool = false, // Compares the CPU kernels against ui.dll's D3D11 shaders instead of simulating
         pub const shorthands = .{
             .g = "generate",
+            .j = "jobs",
         };
     }, std.heap.page_allocator, .print) catch unreachable;
     defer options.deinit();
 
-    const api = sim_api.getAPI();
-    var simulator = Simulator{};
+    const use_cpu = options.options.cpu or options.options.generate or options.options.benchmark or options.options.@"benchmark-roads" != null;
+    if (use_cpu) {
+        const cpu_count: u32 = @intCast(std.Thread.getCpuCount() catch 1);
+        compute_cpu.init(std.heap.c_allocator, options.options.jobs orelse cpu_count - 1);
+        compute.compute_fn = &compute_cpu.dispatch;
+    }
+    const check_compute = options.options.@"check-compute";
+    if (check_compute and !use_cpu) {
+        const cpu_count: u32 = @intCast(std.Thread.getCpuCount() catch 1);
+        compute_cpu.init(std.heap.c_allocator, options.options.jobs orelse cpu_count - 1);
+    }
+    defer compute_cpu.deinit();
+
+    if (options.options.benchmark) {
+        compute_cpu.benchmark(options.options.@"benchmark-size");
+        return;
+    }
+    if (options.options.@"benchmark-roads") |city_count| {
+        pathfinding.benchmark(options.options.@"benchmark-size", city_count);
+        return;
+    }
+
+    var api = sim_api.getAPI();
+    var simulator = Simulator{
+        .tile_cache_budget_mb = options.options.@"tile-cache-mb",
+        // NOTE: ui.dll's D3D11 compute runs on one immediate context
+        .graph_jobs = if (use_cpu) options.options.@"graph-jobs" orelse 4 else 1,
+        .cache_dir = options.options.@"cache-dir",
+    };
     simulator.init();
     defer simulator.deinit();
     sim_api.simulator = &simulator;
 
+    if (use_cpu) {
+        simulator.ctx.compute_fn = compute.compute_fn;
+    }
+
     if (options.options.generate) {
-        //
+        simulator.simulate();
+        simulator.wait();
     } else {
         var dll_ui = std.DynLib.open("ui.dll") catch unreachable;
         const dll_ui_runUI = dll_ui.lookup(c_ui.PFN_runUI, "runUI").?.?;
-        const dll_ui_compute = dll_ui.lookup(c_ui.PFN_compute, "compute").?.?;
-        simulator.ctx.compute_fn = @ptrCast(dll_ui_compute);
-        compute.compute_fn = simulator.ctx.compute_fn;
+        if (!use_cpu or check_compute) {
+            const dll_ui_compute = dll_ui.lookup(c_ui.PFN_compute, "compute").?.?;
+            simulator.ctx.compute_fn = @ptrCast(dll_ui_compute);
+            compute.compute_fn = simulator.ctx.compute_fn;
+        }
+        if (check_compute) {
+            api.simulate = checkCompute;
+        }
 
         dll_ui_runUI(@ptrCast(&api));
+        if (check_compute_thread) |thread| {
+            thread.join();
+        }
 
         std.log.debug("{any}", .{dll_ui});
         std.log.debug("{any}", .{dll_ui_runUI});
     }
 }
 
+var check_compute_thread: ?std.Thread = null;
+
+// Stands in for simulate with --check-compute. ui.dll runs compute jobs from its frame loop, so
+// the check runs on its own thread like a simulation would.
+fn checkCompute() callconv(.C) void {
+    if (check_compute_thread != null) {
+        return;
+    }
+    check_compute_thread = std.Thread.spawn(.{}, struct {
+        fn run() void {
+            if (!compute_cpu.check(compute.compute_fn)) {
+                std.log.err("CPU compute kernels differ from the D3D11 shaders", .{});
+            }
+        }
+    }.run, .{}) catch unreachable;
+}
+
 // pub const std_options = .{
 //     // Set the log level to info
 //     .log_level = .info,
@@ -2,6 +2,8 @@ const std = @import("std");
 const types = @import("types.zig");
 const graph = @import("graph.zig");
 const nodes = @import("nodes/nodes.zig");
+const compute_cpu = @import("compute_cpu.zig");
+const tiled_image = @import("tiled_image.zig");
 
 pub var compute_fn: graph.fn_compute = undefined;
 var id: i32 = 0;
@@ -145,13 +147,16 @@ pub fn upsample_blur(image_in: *types.ImageF32, image_out: *types.ImageF32) void
     compute_f32_1(.upsample_bilinear, image_in, image_out, settings);
 }
 
+// Downsample passes the output size, upsample the input size.
+pub const ResampleSettings = extern struct {
+    buffer_width: u32,
+    buffer_height: u32,
+    op: graph.ComputeOperatorId,
+    padding: f32 = undefined,
+};
+
 pub fn downsample(image_in: *types.ImageF32, scratch_image: *types.ImageF32, image_out: *types.ImageF32, op: graph.ComputeOperatorId) void {
-    const settings: extern struct {
-        buffer_width: u32,
-        buffer_height: u32,
-        op: graph.ComputeOperatorId,
-        padding: f32 = undefined,
-    } = .{
+    const settings = ResampleSettings{
         .buffer_width = @intCast(image_in.size.width / 2),
         .buffer_height = @intCast(image_in.size.height / 2),
         .op = op,
@@ -171,12 +176,7 @@ pub fn downsample(image_in: *types.ImageF32, scratch_image: *types.ImageF32, ima
 }
 
 pub fn upsample(image_in: *types.ImageF32, scratch_image: *types.ImageF32, image_out: *types.ImageF32, op: graph.ComputeOperatorId) void {
-    const settings: extern struct {
-        buffer_width: u32,
-        buffer_height: u32,
-        op: graph.ComputeOperatorId,
-        padding: f32 = undefined,
-    } = .{
+    const settings = ResampleSettings{
         .buffer_width = @intCast(image_in.size.width),
         .buffer_height = @intCast(image_in.size.height),
         .op = op,
@@ -190,7 +190,7 @@ pub fn upsample(image_in: *types.ImageF32, scratch_image: *types.ImageF32, image
     image_out.swap(scratch_image);
 }
 
-const BlurSettings = struct {
+pub const BlurSettings = extern struct {
     buffer_width: u32,
     buffer_height: u32,
     sigma: f32 = 256.0,
@@ -205,7 +205,7 @@ pub fn blur(image_in: *types.ImageF32, scratch: *types.ImageF32, image_out: *typ
     compute_f32_1(.gaussian_blur_vertical, scratch, image_out, settings);
 }
 
-const RemapSettings = extern struct {
+pub const RemapSettings = extern struct {
     from_min: f32,
     from_max: f32,
     to_min: f32,
@@ -229,7 +229,7 @@ pub fn remap(image_in: *types.ImageF32, image_out: *types.ImageF32, to_min: f32,
     image_in.swap(image_out);
 }
 
-const SquareSettings = extern struct {
+pub const SquareSettings = extern struct {
     width: u32,
     height: u32,
     _padding: [2]f32 = undefined,
@@ -245,7 +245,7 @@ pub fn square(image_in: *types.ImageF32, scratch: *types.ImageF32) void {
     image_in.swap(scratch);
 }
 
-const MathSettings = extern struct {
+pub const MathSettings = extern struct {
     width: u32,
     height: u32,
     _padding: [2]f32 = undefined,
@@ -289,7 +289,45 @@ pub fn math_multiply(image_in0: *types.ImageF32, image_in1: *types.ImageF32, ima
     nodes.math.rerangify(image_out);
 }
 
-const TerraceSettings = extern struct {
+// math_add or math_multiply over images_in into image_out, for the math nodes reading images
+// parked in tiles. With accumulate image_out is the first input. The CPU backend reads the tiles
+// in place, ui.dll needs flat buffers so there each input is acquired for its dispatch only.
+pub fn math_tiled(
+    op: compute_cpu.MathOp,
+    images_in: []const *types.ImageF32,
+    tiles_in: []const *tiled_image.TiledImage(f32),
+    image_out: *types.ImageF32,
+    scratch: *types.ImageF32,
+    accumulate: bool,
+) void {
+    if (compute_fn == &compute_cpu.dispatch) {
+        compute_cpu.mathTiles(op, tiles_in, image_out, accumulate);
+        nodes.math.rerangify(image_out);
+        return;
+    }
+
+    const capacity = image_out.size.area();
+    const mathOp = switch (op) {
+        .add => &math_add,
+        .multiply => &math_multiply,
+    };
+    var first_input: usize = 0;
+    if (!accumulate) {
+        tiled_image.acquire(f32, images_in[0], tiles_in[0], capacity);
+        tiled_image.acquire(f32, images_in[1], tiles_in[1], capacity);
+        mathOp(images_in[0], images_in[1], image_out, scratch);
+        tiled_image.park(f32, images_in[0], tiles_in[0]);
+        tiled_image.park(f32, images_in[1], tiles_in[1]);
+        first_input = 2;
+    }
+    for (images_in[first_input..], tiles_in[first_input..]) |image_in, tiles| {
+        tiled_image.acquire(f32, image_in, tiles, capacity);
+        mathOp(image_in, image_out, image_out, scratch);
+        tiled_image.park(f32, image_in, tiles);
+    }
+}
+
+pub const TerraceSettings = extern struct {
     width: u32,
     height: u32,
     gradient_max: f32,
@@ -324,7 +362,7 @@ pub fn terrace(gradient_in: *types.ImageF32, height_in: *types.ImageF32, height_
     types.saveImageF32(gradient_out_img, "terrace_score", false);
 }
 
-const RemapData = struct {
+pub const RemapData = extern struct {
     width: u32,
     height: u32,
     curve_keys_count: u32,
@@ -357,7 +395,7 @@ pub fn remapCurve(image_in: *types.ImageF32, curve: []const types.Vec2, image_ou
     );
 }
 
-const GatherPointsSettings = extern struct {
+pub const GatherPointsSettings = extern struct {
     width: u32,
     height: u32,
     world_width: f32,
@@ -405,3 +443,8 @@ pub fn gatherPoints(image_in: *types.ImageF32, world_width: f32, world_height: f
 
     compute_fn(&compute_info);
 }
+
+test {
+    // NOTE: A test root can't import outside its directory, the node tests are reached from here.
+    _ = nodes.pathfinding;
+}
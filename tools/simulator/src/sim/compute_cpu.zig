@@ -0,0 +1,1437 @@
+const std = @import("std");
+const znoise = @import("znoise");
+
+const compute = @import("compute.zig");
+const graph = @import("graph.zig");
+const tiled_image = @import("tiled_image.zig");
+const types = @import("types.zig");
+
+// CPU implementation of the compute shaders in ui/d3d11/shaders, for running the simulator without
+// ui.dll. Each kernel follows its HLSL version step by step so results only differ by float
+// rounding. Images are split in bands of rows over a thread pool and every band is walked with
+// @Vector spans, with a 1-wide span for the tail of a row.
+
+const lanes = std.simd.suggestVectorLength(f32) orelse 4;
+const rows_per_band = 16;
+const blur_strip_width = 256; // Columns per cache block of the vertical blur
+
+var workers: ?*std.Thread.Pool = null;
+var worker_count: u32 = 0;
+var workers_allocator: std.mem.Allocator = undefined;
+
+// With worker_count 0 every kernel runs on the calling thread.
+pub fn init(allocator: std.mem.Allocator, count: u32) void {
+    std.debug.assert(workers == null);
+    if (count > 0) {
+        const pool = allocator.create(std.Thread.Pool) catch unreachable;
+        pool.init(.{ .allocator = allocator, .n_jobs = count }) catch unreachable;
+        workers = pool;
+        worker_count = count;
+        workers_allocator = allocator;
+    }
+}
+
+pub fn deinit() void {
+    if (workers) |pool| {
+        pool.deinit();
+        workers_allocator.destroy(pool);
+    }
+    workers = null;
+    worker_count = 0;
+}
+
+// Drop-in replacement for ui.dll's compute().
+pub fn dispatch(compute_info: ?*graph.ComputeInfo) callconv(.C) void {
+    const info = compute_info.?;
+    switch (info.compute_id) {
+        .remap => remap(info),
+        .square => square(info),
+        .gradient => gradient(info),
+        .fbm => fbm(info),
+        .upsample_blur => upsampleBlur(info),
+        .upsample_bilinear => upsampleBilinear(info),
+        .upsample => upsample(info),
+        .downsample => downsample(info),
+        .terrace => terrace(info),
+        .multiply => math(info, .multiply),
+        .add => math(info, .add),
+        .gaussian_blur_horizontal => gaussianBlur(info, .horizontal),
+        .gaussian_blur_vertical => gaussianBlur(info, .vertical),
+        .remap_curve_linear => remapCurve(info),
+        .gather_points => gatherPoints(info),
+        .reduce => reduce(info),
+    }
+}
+
+// ██╗  ██╗███████╗██╗     ██████╗ ███████╗██████╗ ███████╗
+// ██║  ██║██╔════╝██║     ██╔══██╗██╔════╝██╔══██╗██╔════╝
+// ███████║█████╗  ██║     ██████╔╝█████╗  ██████╔╝███████╗
+// ██╔══██║██╔══╝  ██║     ██╔═══╝ ██╔══╝  ██╔══██╗╚════██║
+// ██║  ██║███████╗███████╗██║     ███████╗██║  ██║███████║
+// ╚═╝  ╚═╝╚══════╝╚══════╝╚═╝     ╚══════╝╚═╝  ╚═╝╚══════╝
+
+fn Vec(comptime n: usize) type {
+    return @Vector(n, f32);
+}
+
+inline fn splat(comptime n: usize, value: f32) Vec(n) {
+    return @splat(value);
+}
+
+inline fn load(comptime n: usize, pixels: []const f32, index: usize) Vec(n) {
+    return pixels[index..][0..n].*;
+}
+
+inline fn store(comptime n: usize, pixels: []f32, index: usize, value: Vec(n)) void {
+    pixels[index..][0..n].* = value;
+}
+
+inline fn saturate(comptime n: usize, value: Vec(n)) Vec(n) {
+    return @min(@max(value, splat(n, 0)), splat(n, 1));
+}
+
+inline fn lerp(comptime n: usize, a: Vec(n), b: Vec(n), t: f32) Vec(n) {
+    return a + (b - a) * splat(n, t);
+}
+
+inline fn columns(comptime n: usize, x: usize) Vec(n) {
+    return @floatFromInt(std.simd.iota(u32, n) + @as(@Vector(n, u32), @splat(@intCast(x))));
+}
+
+fn bufferF32(buffer: graph.ComputeBuffer) []f32 {
+    const pixels: [*]f32 = @ptrCast(@alignCast(buffer.data));
+    return pixels[0 .. @as(usize, buffer.width) * buffer.height];
+}
+
+fn settingsAs(comptime T: type, info: *const graph.ComputeInfo) T {
+    std.debug.assert(info.data_size >= @sizeOf(T));
+    return std.mem.bytesToValue(T, info.data[0..@sizeOf(T)]);
+}
+
+// Calls kernel.span(n, ...) over [begin, end) with full vectors, then one element at a time.
+fn spans(kernel: anytype, begin: usize, end: usize, extra: anytype) void {
+    var index = begin;
+    while (index + lanes <= end) : (index += lanes) {
+        @call(.auto, @TypeOf(kernel.*).span, .{ kernel, lanes, index } ++ extra);
+    }
+    while (index < end) : (index += 1) {
+        @call(.auto, @TypeOf(kernel.*).span, .{ kernel, 1, index } ++ extra);
+    }
+}
+
+// Runs bandFn over [0, row_count) in bands of band_rows. The calling thread takes bands too.
+pub fn forEachBand(row_count: usize, band_rows: usize, context: anytype, comptime bandFn: fn (@TypeOf(context), usize, usize) void) void {
+    const Context = @TypeOf(context);
+    const Bands = struct {
+        context: Context,
+        row_count: usize,
+        band_rows: usize,
+        next_band: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+
+        fn work(self: *@This()) void {
+            while (true) {
+                const row_begin = self.next_band.fetchAdd(1, .monotonic) * self.band_rows;
+                if (row_begin >= self.row_count) {
+                    return;
+                }
+                bandFn(self.context, row_begin, @min(row_begin + self.band_rows, self.row_count));
+            }
+        }
+    };
+
+    var bands = Bands{ .context = context, .row_count = row_count, .band_rows = band_rows };
+    const band_count = std.math.divCeil(usize, row_count, band_rows) catch unreachable;
+    if (workers != null and band_count > 1) {
+        var wait_group: std.Thread.WaitGroup = .{};
+        for (0..@min(worker_count, band_count - 1)) |_| {
+            workers.?.spawnWg(&wait_group, Bands.work, .{&bands});
+        }
+        bands.work();
+        workers.?.waitAndWork(&wait_group);
+    } else {
+        bands.work();
+    }
+}
+
+pub const TileVisit = enum {
+    all,
+    stored, // Skips tiles that were never written
+};
+
+// Runs tileFn on the tiles of image with every row of tiles as a band. A tile stays pinned in the
+// tile cache while tileFn runs, written tells the cache it has to be spilled again.
+pub fn forEachTile(
+    comptime T: type,
+    image: *tiled_image.TiledImage(T),
+    visit: TileVisit,
+    written: bool,
+    context: anytype,
+    comptime tileFn: fn (@TypeOf(context), tiled_image.TileView(T)) void,
+) void {
+    const Context = @TypeOf(context);
+    const TileRows = struct {
+        image: *tiled_image.TiledImage(T),
+        visit: TileVisit,
+        written: bool,
+        context: Context,
+
+        fn band(self: *const @This(), tile_row_begin: usize, tile_row_end: usize) void {
+            for (tile_row_begin..tile_row_end) |tile_y| {
+                for (0..self.image.tiles_x) |tile_x| {
+                    if (self.visit == .stored and !self.image.isStored(tile_x, tile_y)) {
+                        continue;
+                    }
+                    const view = self.image.acquireTile(tile_x, tile_y);
+                    tileFn(self.context, view);
+                    self.image.releaseTile(view, self.written);
+                }
+            }
+        }
+    };
+
+    const tile_rows = TileRows{ .image = image, .visit = visit, .written = written, .context = context };
+    forEachBand(image.tiles_y, 1, &tile_rows, TileRows.band);
+}
+
+// ██╗  ██╗███████╗██████╗ ███╗   ██╗███████╗██╗     ███████╗
+// ██║ ██╔╝██╔════╝██╔══██╗████╗  ██║██╔════╝██║     ██╔════╝
+// █████╔╝ █████╗  ██████╔╝██╔██╗ ██║█████╗  ██║     ███████╗
+// ██╔═██╗ ██╔══╝  ██╔══██╗██║╚██╗██║██╔══╝  ██║     ╚════██║
+// ██║  ██╗███████╗██║  ██║██║ ╚████║███████╗███████╗███████║
+// ╚═╝  ╚═╝╚══════╝╚═╝  ╚═╝╚═╝  ╚═══╝╚══════╝╚══════╝╚══════╝
+
+// Remap.hlsl
+const RemapKernel = struct {
+    input: []const f32,
+    output: []f32,
+    width: usize,
+    settings: compute.RemapSettings,
+
+    fn band(self: *const RemapKernel, row_begin: usize, row_end: usize) void {
+        spans(self, row_begin * self.width, row_end * self.width, .{});
+    }
+
+    fn span(self: *const RemapKernel, comptime n: usize, index: usize) void {
+        const s = self.settings;
+        const value = load(n, self.input, index);
+        const remapped = splat(n, s.to_min) + (value - splat(n, s.from_min)) * splat(n, s.to_max - s.to_min) / splat(n, s.from_max - s.from_min);
+        store(n, self.output, index, @min(@max(remapped, splat(n, s.to_min)), splat(n, s.to_max)));
+    }
+};
+
+fn remap(info: *const graph.ComputeInfo) void {
+    const kernel = RemapKernel{
+        .input = bufferF32(info.in_buffers[0]),
+        .output = bufferF32(info.out_buffers[0]),
+        .width = info.in_buffers[0].width,
+        .settings = settingsAs(compute.RemapSettings, info),
+    };
+    forEachBand(info.in_buffers[0].height, rows_per_band, &kernel, RemapKernel.band);
+}
+
+// Square.hlsl
+const SquareKernel = struct {
+    input: []const f32,
+    output: []f32,
+    width: usize,
+
+    fn band(self: *const SquareKernel, row_begin: usize, row_end: usize) void {
+        spans(self, row_begin * self.width, row_end * self.width, .{});
+    }
+
+    fn span(self: *const SquareKernel, comptime n: usize, index: usize) void {
+        const value = load(n, self.input, index);
+        store(n, self.output, index, value * value);
+    }
+};
+
+fn square(info: *const graph.ComputeInfo) void {
+    const kernel = SquareKernel{
+        .input = bufferF32(info.in_buffers[0]),
+        .output = bufferF32(info.out_buffers[0]),
+        .width = info.in_buffers[0].width,
+    };
+    forEachBand(info.in_buffers[0].height, rows_per_band, &kernel, SquareKernel.band);
+}
+
+// add.hlsl and multiply.hlsl
+pub const MathOp = enum { add, multiply };
+
+const MathKernel = struct {
+    input0: []const f32,
+    input1: []const f32,
+    output: []f32,
+    width: usize,
+    op: MathOp,
+
+    fn band(self: *const MathKernel, row_begin: usize, row_end: usize) void {
+        spans(self, row_begin * self.width, row_end * self.width, .{});
+    }
+
+    fn span(self: *const MathKernel, comptime n: usize, index: usize) void {
+        const value0 = load(n, self.input0, index);
+        const value1 = load(n, self.input1, index);
+        store(n, self.output, index, switch (self.op) {
+            .add => value0 + value1,
+            .multiply => value0 * value1,
+        });
+    }
+};
+
+fn math(info: *const graph.ComputeInfo, op: MathOp) void {
+    const kernel = MathKernel{
+        .input0 = bufferF32(info.in_buffers[0]),
+        .input1 = bufferF32(info.in_buffers[1]),
+        .output = bufferF32(info.out_buffers[0]),
+        .width = info.in_buffers[0].width,
+        .op = op,
+    };
+    forEachBand(info.in_buffers[0].height, rows_per_band, &kernel, MathKernel.band);
+}
+
+pub const max_math_tiles_inputs = 8;
+
+// MathKernel folded over inputs parked in tiles, into a flat output. Every band is a row of
+// tiles and only the input tiles it works on are pinned, the inputs are never flat.
+const MathTilesKernel = struct {
+    inputs: []const *tiled_image.TiledImage(f32),
+    output: *types.ImageF32,
+    op: MathOp,
+    accumulate: bool,
+
+    fn band(self: *const MathTilesKernel, tile_row_begin: usize, tile_row_end: usize) void {
+        const input_count = self.inputs.len;
+        var views: [max_math_tiles_inputs]tiled_image.TileView(f32) = undefined;
+        for (tile_row_begin..tile_row_end) |tile_y| {
+            for (0..self.inputs[0].tiles_x) |tile_x| {
+                for (self.inputs, views[0..input_count]) |input, *view| {
+                    view.* = input.acquireTile(tile_x, tile_y);
+                }
+
+                const rect = views[0].rect;
+                const width = rect.size().width;
+                for (0..rect.size().height) |y| {
+                    const output_row = self.output.pixels[(rect.bottom + y) * self.output.size.width + rect.left ..][0..width];
+                    var kernel = MathKernel{ .input0 = undefined, .input1 = output_row, .output = output_row, .width = width, .op = self.op };
+                    var first_input: usize = 0;
+                    if (!self.accumulate) {
+                        kernel.input0 = views[0].row(y);
+                        kernel.input1 = views[1].row(y);
+                        spans(&kernel, 0, width, .{});
+                        kernel.input1 = output_row;
+                        first_input = 2;
+                    }
+                    for (views[first_input..input_count]) |view| {
+                        kernel.input0 = view.row(y);
+                        spans(&kernel, 0, width, .{});
+                    }
+                }
+
+                for (self.inputs, views[0..input_count]) |input, view| {
+                    input.releaseTile(view, false);
+                }
+            }
+        }
+    }
+};
+
+// output = inputs[0] op inputs[1] op ..., or output op inputs[0] op ... with accumulate, in the
+// same order as chained math dispatches so the results match them exactly.
+pub fn mathTiles(op: MathOp, inputs: []const *tiled_image.TiledImage(f32), output: *types.ImageF32, accumulate: bool) void {
+    std.debug.assert(inputs.len >= @as(usize, if (accumulate) 1 else 2) and inputs.len <= max_math_tiles_inputs);
+    for (inputs) |input| {
+        std.debug.assert(input.size.eql(output.size));
+    }
+    const kernel = MathTilesKernel{ .inputs = inputs, .output = output, .op = op, .accumulate = accumulate };
+    forEachBand(inputs[0].tiles_y, 1, &kernel, MathTilesKernel.band);
+}
+
+// gradient.hlsl, Sobel filter with a zeroed border.
+const GradientKernel = struct {
+    input: []const f32,
+    output: []f32,
+    width: usize,
+    height: usize,
+    height_ratio: f32,
+
+    fn band(self: *const GradientKernel, row_begin: usize, row_end: usize) void {
+        const width = self.width;
+        for (row_begin..row_end) |y| {
+            const row = y * width;
+            if (y == 0 or y + 1 >= self.height or width < 3) {
+                @memset(self.output[row .. row + width], 0);
+                continue;
+            }
+
+            self.output[row] = 0;
+            self.output[row + width - 1] = 0;
+            spans(self, row + 1, row + width - 1, .{});
+        }
+    }
+
+    fn span(self: *const GradientKernel, comptime n: usize, index: usize) void {
+        const top = index - self.width;
+        const bottom = index + self.width;
+        const tl = load(n, self.input, top - 1);
+        const t = load(n, self.input, top);
+        const tr = load(n, self.input, top + 1);
+        const l = load(n, self.input, index - 1);
+        const r = load(n, self.input, index + 1);
+        const bl = load(n, self.input, bottom - 1);
+        const b = load(n, self.input, bottom);
+        const br = load(n, self.input, bottom + 1);
+
+        const ratio = splat(n, self.height_ratio);
+        const two = splat(n, 2);
+        const sum_x = ((tr - tl) + two * (r - l) + (br - bl)) * ratio;
+        const sum_y = ((bl + two * b + br) - (tl + two * t + tr)) * ratio;
+        store(n, self.output, index, @sqrt(sum_x * sum_x + sum_y * sum_y));
+    }
+};
+
+fn gradient(info: *const graph.ComputeInfo) void {
+    const settings = settingsAs(compute.GradientData, info);
+    const kernel = GradientKernel{
+        .input = bufferF32(info.in_buffers[0]),
+        .output = bufferF32(info.out_buffers[0]),
+        .width = info.in_buffers[0].width,
+        .height = info.in_buffers[0].height,
+        .height_ratio = settings.g_height_ratio,
+    };
+    forEachBand(kernel.height, rows_per_band, &kernel, GradientKernel.band);
+}
+
+// fbm.hlsl. FastNoiseLite.hlsl is a port of the C library znoise wraps, so this one goes pixel by
+// pixel through znoise rather than @Vector spans.
+const FbmKernel = struct {
+    output: []f32,
+    width: usize,
+    noise: znoise.FnlGenerator,
+    scale: f32,
+
+    fn band(self: *const FbmKernel, row_begin: usize, row_end: usize) void {
+        for (row_begin..row_end) |y| {
+            const y_sample = @as(f32, @floatFromInt(y)) * self.scale;
+            const row = self.output[y * self.width ..][0..self.width];
+            for (row, 0..) |*pixel, x| {
+                const x_sample = @as(f32, @floatFromInt(x)) * self.scale;
+                pixel.* = std.math.clamp(self.noise.noise2(x_sample, y_sample) * 0.5 + 0.5, 0, 1);
+            }
+        }
+    }
+};
+
+fn fbm(info: *const graph.ComputeInfo) void {
+    const settings = settingsAs(compute.GenerateFBMSettings, info);
+    const kernel = FbmKernel{
+        .output = bufferF32(info.out_buffers[0]),
+        .width = info.out_buffers[0].width,
+        .noise = .{
+            .seed = settings.seed,
+            .fractal_type = .fbm,
+            .frequency = settings.frequency,
+            .octaves = @intCast(settings.octaves),
+        },
+        .scale = settings.scale,
+    };
+    forEachBand(info.out_buffers[0].height, rows_per_band, &kernel, FbmKernel.band);
+}
+
+// Output rows for input pixel (x, y) of the 2x upsamples.
+fn write2x2(output: []f32, out_width: usize, x: usize, y: usize, value: f32) void {
+    const index = x * 2 + y * 2 * out_width;
+    output[index] = value;
+    output[index + 1] = value;
+    output[index + out_width] = value;
+    output[index + out_width + 1] = value;
+}
+
+// upsample_bilinear.hlsl, border pixels are copied.
+const UpsampleBilinearKernel = struct {
+    input: []const f32,
+    output: []f32,
+    width: usize,
+    height: usize,
+
+    fn band(self: *const UpsampleBilinearKernel, row_begin: usize, row_end: usize) void {
+        const width = self.width;
+        const out_width = width * 2;
+        for (row_begin..row_end) |y| {
+            const row = y * width;
+            if (y <= 1 or y + 2 >= self.height or width < 5) {
+                for (0..width) |x| {
+                    write2x2(self.output, out_width, x, y, self.input[row + x]);
+                }
+                continue;
+            }
+
+            for ([_]usize{ 0, 1, width - 2, width - 1 }) |x| {
+                write2x2(self.output, out_width, x, y, self.input[row + x]);
+            }
+            spans(self, 2, width - 2, .{y});
+        }
+    }
+
+    fn span(self: *const UpsampleBilinearKernel, comptime n: usize, x: usize, y: usize) void {
+        const index = x + y * self.width;
+        const tl = load(n, self.input, index);
+        const tr = load(n, self.input, index + 1);
+        const bl = load(n, self.input, index + self.width);
+        const br = load(n, self.input, index + self.width + 1);
+
+        const top_quarter = lerp(n, tl, tr, 0.25);
+        const top_three_quarters = lerp(n, tl, tr, 0.75);
+        const bottom_quarter = lerp(n, bl, br, 0.25);
+        const bottom_three_quarters = lerp(n, bl, br, 0.75);
+
+        const out_width = self.width * 2;
+        const out_index = x * 2 + y * 2 * out_width;
+        store(2 * n, self.output, out_index, std.simd.interlace(.{
+            lerp(n, top_quarter, bottom_quarter, 0.25),
+            lerp(n, top_three_quarters, bottom_three_quarters, 0.25),
+        }));
+        store(2 * n, self.output, out_index + out_width, std.simd.interlace(.{
+            lerp(n, top_quarter, bottom_quarter, 0.75),
+            lerp(n, top_three_quarters, bottom_three_quarters, 0.75),
+        }));
+    }
+};
+
+fn upsampleBilinear(info: *const graph.ComputeInfo) void {
+    const kernel = UpsampleBilinearKernel{
+        .input = bufferF32(info.in_buffers[0]),
+        .output = bufferF32(info.out_buffers[0]),
+        .width = info.in_buffers[0].width,
+        .height = info.in_buffers[0].height,
+    };
+    forEachBand(kernel.height, rows_per_band, &kernel, UpsampleBilinearKernel.band);
+}
+
+// upsample_blur.hlsl, 5x5 gaussian with a zeroed border. The kernel isn't separable.
+const gaussian_kernel_5 = [5][5]f32{
+    .{ 1, 4, 7, 4, 1 },
+    .{ 4, 16, 26, 16, 4 },
+    .{ 7, 26, 41, 26, 7 },
+    .{ 4, 16, 26, 16, 4 },
+    .{ 1, 4, 7, 4, 1 },
+};
+
+const UpsampleBlurKernel = struct {
+    input: []const f32,
+    output: []f32,
+    width: usize,
+    height: usize,
+
+    fn band(self: *const UpsampleBlurKernel, row_begin: usize, row_end: usize) void {
+        const width = self.width;
+        const out_width = width * 2;
+        for (row_begin..row_end) |y| {
+            if (y <= 1 or y + 2 >= self.height or width < 5) {
+                @memset(self.output[y * 2 * out_width ..][0 .. out_width * 2], 0);
+                continue;
+            }
+
+            for ([_]usize{ 0, 1, width - 2, width - 1 }) |x| {
+                write2x2(self.output, out_width, x, y, 0);
+            }
+            spans(self, 2, width - 2, .{y});
+        }
+    }
+
+    fn span(self: *const UpsampleBlurKernel, comptime n: usize, x: usize, y: usize) void {
+        const corner = (x - 2) + (y - 2) * self.width;
+        var sum = splat(n, 0);
+        inline for (0..5) |ky| {
+            inline for (0..5) |kx| {
+                sum += splat(n, gaussian_kernel_5[ky][kx]) * load(n, self.input, corner + kx + ky * self.width);
+            }
+        }
+        sum *= splat(n, 1.0 / 273.0);
+
+        const out_width = self.width * 2;
+        const out_index = x * 2 + y * 2 * out_width;
+        const doubled = std.simd.interlace(.{ sum, sum });
+        store(2 * n, self.output, out_index, doubled);
+        store(2 * n, self.output, out_index + out_width, doubled);
+    }
+};
+
+fn upsampleBlur(info: *const graph.ComputeInfo) void {
+    const kernel = UpsampleBlurKernel{
+        .input = bufferF32(info.in_buffers[0]),
+        .output = bufferF32(info.out_buffers[0]),
+        .width = info.in_buffers[0].width,
+        .height = info.in_buffers[0].height,
+    };
+    forEachBand(kernel.height, rows_per_band, &kernel, UpsampleBlurKernel.band);
+}
+
+// upsample.hlsl
+const UpsampleKernel = struct {
+    input: []const f32,
+    output: []f32,
+    width: usize,
+    op: graph.ComputeOperatorId,
+
+    fn band(self: *const UpsampleKernel, row_begin: usize, row_end: usize) void {
+        for (row_begin..row_end) |y| {
+            spans(self, 0, self.width, .{y});
+        }
+    }
+
+    fn span(self: *const UpsampleKernel, comptime n: usize, x: usize, y: usize) void {
+        const value = load(n, self.input, x + y * self.width);
+        const zero = splat(n, 0);
+        const out_width = self.width * 2;
+        const out_index = x * 2 + y * 2 * out_width;
+        switch (self.op) {
+            .nearest => {
+                const doubled = std.simd.interlace(.{ value, value });
+                store(2 * n, self.output, out_index, doubled);
+                store(2 * n, self.output, out_index + out_width, doubled);
+            },
+            .first => {
+                store(2 * n, self.output, out_index, std.simd.interlace(.{ value, zero }));
+                store(2 * n, self.output, out_index + out_width, splat(2 * n, 0));
+            },
+            // NOTE: The shader leaves the output untouched, which reads back as zeroes
+            else => {
+                store(2 * n, self.output, out_index, splat(2 * n, 0));
+                store(2 * n, self.output, out_index + out_width, splat(2 * n, 0));
+            },
+        }
+    }
+};
+
+fn upsample(info: *const graph.ComputeInfo) void {
+    const settings = settingsAs(compute.ResampleSettings, info);
+    const kernel = UpsampleKernel{
+        .input = bufferF32(info.in_buffers[0]),
+        .output = bufferF32(info.out_buffers[0]),
+        .width = info.in_buffers[0].width,
+        .op = settings.op,
+    };
+    forEachBand(info.in_buffers[0].height, rows_per_band, &kernel, UpsampleKernel.band);
+}
+
+// downsample_op.hlsl
+const DownsampleKernel = struct {
+    input: []const f32,
+    output: []f32,
+    out_width: usize,
+    op: graph.ComputeOperatorId,
+
+    fn band(self: *const DownsampleKernel, row_begin: usize, row_end: usize) void {
+        for (row_begin..row_end) |y| {
+            spans(self, 0, self.out_width, .{y});
+        }
+    }
+
+    fn span(self: *const DownsampleKernel, comptime n: usize, x: usize, y: usize) void {
+        const in_width = self.out_width * 2;
+        const in_index = x * 2 + y * 2 * in_width;
+        const top = std.simd.deinterlace(2, load(2 * n, self.input, in_index));
+        const bottom = std.simd.deinterlace(2, load(2 * n, self.input, in_index + in_width));
+        const tl = top[0];
+        const tr = top[1];
+        const bl = bottom[0];
+        const br = bottom[1];
+
+        store(n, self.output, x + y * self.out_width, switch (self.op) {
+            .min => @min(@min(tl, tr), @min(bl, br)),
+            .max => @max(@max(tl, tr), @max(bl, br)),
+            .average => (tl + tr + bl + br) * splat(n, 0.25),
+            .sum => tl + tr + bl + br,
+            else => @floatFromInt((std.simd.iota(u32, n) + @as(@Vector(n, u32), @splat(@intCast(x)))) % @as(@Vector(n, u32), @splat(2))),
+        });
+    }
+};
+
+fn downsample(info: *const graph.ComputeInfo) void {
+    const settings = settingsAs(compute.ResampleSettings, info);
+    const kernel = DownsampleKernel{
+        .input = bufferF32(info.in_buffers[0]),
+        .output = bufferF32(info.out_buffers[0]),
+        .out_width = info.out_buffers[0].width,
+        .op = settings.op,
+    };
+    forEachBand(info.out_buffers[0].height, rows_per_band, &kernel, DownsampleKernel.band);
+}
+
+// terrace.hlsl. Every pixel searches a 35x35 neighbourhood, lanes share the same tap offsets so
+// a span of pixels walks the taps together and keeps the best one per lane.
+const terrace_steps = 35;
+const terrace_steps_half = terrace_steps / 2;
+const terrace_range = terrace_steps; // step_dist is 1
+const terrace_border = terrace_range + 2; // Pixels closer than this to an edge are copied
+
+const TerraceTap = struct {
+    offset: isize,
+    distance_score: f32,
+};
+
+const TerraceKernel = struct {
+    gradient_in: []const f32,
+    height_in: []const f32,
+    height_out: []f32,
+    gradient_out: []f32,
+    width: usize,
+    height: usize,
+    taps: []const TerraceTap,
+
+    fn band(self: *const TerraceKernel, row_begin: usize, row_end: usize) void {
+        const width = self.width;
+        for (row_begin..row_end) |y| {
+            const row = y * width;
+            @memcpy(self.gradient_out[row..][0..width], self.gradient_in[row..][0..width]);
+
+            if (y < terrace_border or y + terrace_border >= self.height or width <= terrace_border * 2) {
+                @memcpy(self.height_out[row..][0..width], self.height_in[row..][0..width]);
+                continue;
+            }
+
+            @memcpy(self.height_out[row..][0..terrace_border], self.height_in[row..][0..terrace_border]);
+            @memcpy(self.height_out[row + width - terrace_border ..][0..terrace_border], self.height_in[row + width - terrace_border ..][0..terrace_border]);
+            spans(self, terrace_border, width - terrace_border, .{y});
+
+            // NOTE: Debug stripes the shader writes into the score output
+            if (40 + terrace_border < width) {
+                self.gradient_out[row + 40] = 0;
+            }
+            if (41 + terrace_border < width) {
+                self.gradient_out[row + 41] = 1;
+            }
+        }
+    }
+
+    fn span(self: *const TerraceKernel, comptime n: usize, x: usize, y: usize) void {
+        const index = x + y * self.width;
+        const curr_height = load(n, self.height_in, index);
+        const curr_gradient = saturate(n, splat(n, -0.2) + splat(n, 14 * 30) * load(n, self.gradient_in, index));
+        const no_lanes: @Vector(n, bool) = @splat(false);
+
+        var best_score = splat(n, 0);
+        var best_height = curr_height;
+        for (self.taps) |tap| {
+            const sample = index +% @as(usize, @bitCast(tap.offset));
+            const height_sample = load(n, self.height_in, sample);
+            const gradient_sample = splat(n, 30) * load(n, self.gradient_in, sample);
+            const gradient_score = saturate(n, splat(n, 1) - gradient_sample * gradient_sample);
+            const score = lerp(n, gradient_score * splat(n, tap.distance_score), gradient_score, 0.995);
+
+            const better = @select(bool, height_sample >= curr_height, score > best_score, no_lanes);
+            best_score = @select(f32, better, score, best_score);
+            best_height = @select(f32, better, height_sample, best_height);
+        }
+
+        const x_sample = columns(n, x);
+        const y_sample = splat(n, @floatFromInt(y));
+        var varying_score = saturate(n, splat(n, 0.4) * @sin(x_sample * splat(n, 0.0057) + y_sample * splat(n, 0.005)) +
+            splat(n, 0.4) * @cos(x_sample * splat(n, 0.0011) + y_sample * splat(n, 0.0131)));
+        varying_score = saturate(n, varying_score - splat(n, 0.1));
+
+        var final_score = best_score * curr_gradient * curr_gradient * varying_score;
+        final_score = saturate(n, final_score * final_score * splat(n, 3));
+        store(n, self.height_out, index, curr_height + (best_height - curr_height) * final_score);
+        store(n, self.gradient_out, index, final_score);
+    }
+};
+
+fn terrace(info: *const graph.ComputeInfo) void {
+    const width = info.in_buffers[0].width;
+
+    var taps: [terrace_steps * terrace_steps - 1]TerraceTap = undefined;
+    var tap_count: usize = 0;
+    for (0..terrace_steps) |y| {
+        for (0..terrace_steps) |x| {
+            if (x == terrace_steps_half and y == terrace_steps_half) {
+                continue;
+            }
+
+            const dist_x = @as(f32, @floatFromInt(x)) - terrace_steps_half;
+            const dist_y = @as(f32, @floatFromInt(y)) - terrace_steps_half;
+            const distance = @sqrt(dist_x * dist_x + dist_y * dist_y);
+            const offset_x = @as(isize, @intCast(x)) - terrace_steps_half;
+            const offset_y = @as(isize, @intCast(y)) - terrace_steps_half;
+            taps[tap_count] = .{
+                .offset = offset_x + offset_y * @as(isize, @intCast(width)),
+                .distance_score = std.math.clamp(1 - distance / @as(f32, terrace_range), 0, 1),
+            };
+            tap_count += 1;
+        }
+    }
+
+    const kernel = TerraceKernel{
+        .gradient_in = bufferF32(info.in_buffers[0]),
+        .height_in = bufferF32(info.in_buffers[1]),
+        .height_out = bufferF32(info.out_buffers[0]),
+        .gradient_out = bufferF32(info.out_buffers[1]),
+        .width = width,
+        .height = info.in_buffers[0].height,
+        .taps = &taps,
+    };
+    forEachBand(kernel.height, rows_per_band, &kernel, TerraceKernel.band);
+}
+
+// gaussian_blur.hlsl. The taps are the same for every pixel so they're integrated once per
+// dispatch. Horizontal passes pad each row with its clamped edges, vertical passes work on strips
+// of blur_strip_width columns so the rows under the kernel stay in cache.
+const BlurDirection = enum { horizontal, vertical };
+
+fn erf(value: f32) f32 {
+    const sign: f32 = if (value >= 0) 1 else -1;
+    const x = @abs(value);
+
+    // A&S formula 7.1.26
+    const a1: f32 = 0.254829592;
+    const a2: f32 = -0.284496736;
+    const a3: f32 = 1.421413741;
+    const a4: f32 = -1.453152027;
+    const a5: f32 = 1.061405429;
+    const p: f32 = 0.3275911;
+
+    const t = 1.0 / (1.0 + p * x);
+    const y = 1.0 - (((((a5 * t + a4) * t) + a3) * t + a2) * t + a1) * t * @exp(-x * x);
+    return sign * y;
+}
+
+fn integrateGaussian(x: f32, sigma: f32) f32 {
+    const sqrt_half = @sqrt(@as(f32, 0.5));
+    const p1 = erf((x - 0.5) / sigma * sqrt_half);
+    const p2 = erf((x + 0.5) / sigma * sqrt_half);
+    return (p2 - p1) / 2.0;
+}
+
+const BlurKernel = struct {
+    input: []const f32,
+    output: []f32,
+    width: usize,
+    height: usize,
+    weights: []const f32,
+    weight_sum: f32,
+
+    fn radius(self: *const BlurKernel) usize {
+        return self.weights.len / 2;
+    }
+
+    fn bandHorizontal(self: *const BlurKernel, row_begin: usize, row_end: usize) void {
+        const width = self.width;
+        const pad = self.radius();
+        const padded = std.heap.c_allocator.alloc(f32, width + pad * 2) catch unreachable;
+        defer std.heap.c_allocator.free(padded);
+
+        for (row_begin..row_end) |y| {
+            const row = self.input[y * width ..][0..width];
+            @memset(padded[0..pad], row[0]);
+            @memcpy(padded[pad..][0..width], row);
+            @memset(padded[pad + width ..], row[width - 1]);
+            spans(self, y * width, (y + 1) * width, .{ padded, y * width });
+        }
+    }
+
+    fn span(self: *const BlurKernel, comptime n: usize, index: usize, padded: []const f32, row: usize) void {
+        const x = index - row;
+        var output = splat(n, 0);
+        for (self.weights, 0..) |weight, tap| {
+            output += load(n, padded, x + tap) * splat(n, weight);
+        }
+        store(n, self.output, index, output / splat(n, self.weight_sum));
+    }
+
+    fn bandVertical(self: *const BlurKernel, row_begin: usize, row_end: usize) void {
+        const width = self.width;
+        const pad = self.radius();
+        var output: [blur_strip_width]f32 = undefined;
+
+        var strip_begin: usize = 0;
+        while (strip_begin < width) : (strip_begin += blur_strip_width) {
+            const strip_width = @min(blur_strip_width, width - strip_begin);
+            const strip = output[0..strip_width];
+            for (row_begin..row_end) |y| {
+                @memset(strip, 0);
+                for (self.weights, 0..) |weight, tap| {
+                    const read_y = std.math.clamp(@as(isize, @intCast(y + tap)) - @as(isize, @intCast(pad)), 0, @as(isize, @intCast(self.height - 1)));
+                    const source = self.input[@as(usize, @intCast(read_y)) * width + strip_begin ..][0..strip_width];
+                    accumulate(strip, source, weight);
+                }
+
+                const destination = self.output[y * width + strip_begin ..][0..strip_width];
+                var x: usize = 0;
+                while (x + lanes <= strip_width) : (x += lanes) {
+                    store(lanes, destination, x, load(lanes, strip, x) / splat(lanes, self.weight_sum));
+                }
+                while (x < strip_width) : (x += 1) {
+                    destination[x] = strip[x] / self.weight_sum;
+                }
+            }
+        }
+    }
+
+    fn accumulate(output: []f32, source: []const f32, weight: f32) void {
+        var x: usize = 0;
+        while (x + lanes <= output.len) : (x += lanes) {
+            store(lanes, output, x, load(lanes, output, x) + load(lanes, source, x) * splat(lanes, weight));
+        }
+        while (x < output.len) : (x += 1) {
+            output[x] += source[x] * weight;
+        }
+    }
+};
+
+fn gaussianBlur(info: *const graph.ComputeInfo, direction: BlurDirection) void {
+    const settings = settingsAs(compute.BlurSettings, info);
+    const radius: usize = @intFromFloat(@ceil(@sqrt(-2.0 * settings.sigma * settings.sigma * @log(1.0 - settings.support))));
+
+    const weights = std.heap.c_allocator.alloc(f32, radius * 2 + 1) catch unreachable;
+    defer std.heap.c_allocator.free(weights);
+    var weight_sum: f32 = 0;
+    for (weights, 0..) |*weight, tap| {
+        weight.* = integrateGaussian(@as(f32, @floatFromInt(tap)) - @as(f32, @floatFromInt(radius)), settings.sigma);
+        weight_sum += weight.*;
+    }
+
+    const kernel = BlurKernel{
+        .input = bufferF32(info.in_buffers[0]),
+        .output = bufferF32(info.out_buffers[0]),
+        .width = info.in_buffers[0].width,
+        .height = info.in_buffers[0].height,
+        .weights = weights,
+        .weight_sum = weight_sum,
+    };
+    if (kernel.width == 0 or kernel.height == 0) {
+        return;
+    }
+
+    switch (direction) {
+        .horizontal => forEachBand(kernel.height, rows_per_band, &kernel, BlurKernel.bandHorizontal),
+        .vertical => forEachBand(kernel.height, rows_per_band, &kernel, BlurKernel.bandVertical),
+    }
+}
+
+// remap_curve.hlsl. Lanes walk the curve segments together, the first segment containing a
+// lane's value wins like the shader's early return.
+const RemapCurveKernel = struct {
+    input: []const f32,
+    output: []f32,
+    width: usize,
+    curve: []const f32, // x0, y0, x1, y1, ...
+
+    fn band(self: *const RemapCurveKernel, row_begin: usize, row_end: usize) void {
+        spans(self, row_begin * self.width, row_end * self.width, .{});
+    }
+
+    fn span(self: *const RemapCurveKernel, comptime n: usize, index: usize) void {
+        const curve = self.curve;
+        const keys_count = curve.len / 2;
+        const no_lanes: @Vector(n, bool) = @splat(false);
+        const all_lanes: @Vector(n, bool) = @splat(true);
+        const value = load(n, self.input, index);
+
+        var found = value < splat(n, curve[0]);
+        var result = @select(f32, found, splat(n, curve[1]), splat(n, curve[(keys_count - 1) * 2 + 1]));
+        for (0..keys_count - 1) |i_key| {
+            if (@reduce(.And, found)) {
+                break;
+            }
+
+            const curve_x0 = curve[i_key * 2 + 0];
+            const curve_y0 = curve[i_key * 2 + 1];
+            const curve_x1 = curve[i_key * 2 + 2];
+            const curve_y1 = curve[i_key * 2 + 3];
+            const inside = @select(bool, value >= splat(n, curve_x0), value < splat(n, curve_x1), no_lanes);
+            const take = @select(bool, found, no_lanes, inside);
+            const t = (value - splat(n, curve_x0)) / splat(n, curve_x1 - curve_x0);
+            result = @select(f32, take, splat(n, curve_y0) + (splat(n, curve_y1) - splat(n, curve_y0)) * t, result);
+            found = @select(bool, take, all_lanes, found);
+        }
+
+        store(n, self.output, index, result);
+    }
+};
+
+fn remapCurve(info: *const graph.ComputeInfo) void {
+    const settings = settingsAs(compute.RemapData, info);
+    std.debug.assert(settings.curve_keys_count >= 2);
+    const kernel = RemapCurveKernel{
+        .input = bufferF32(info.in_buffers[0]),
+        .output = bufferF32(info.out_buffers[0]),
+        .width = info.in_buffers[0].width,
+        .curve = bufferF32(info.in_buffers[1])[0 .. settings.curve_keys_count * 2],
+    };
+    forEachBand(info.in_buffers[0].height, rows_per_band, &kernel, RemapCurveKernel.band);
+}
+
+// gather_points.hlsl. Bands count their points first and then write them from their prefix
+// offset, so points come out in scanline order instead of the GPU's arbitrary one.
+const GatherPointsKernel = struct {
+    input: []const f32,
+    points: [][2]f32,
+    band_points: []usize,
+    width: usize,
+    height: usize,
+    settings: compute.GatherPointsSettings,
+
+    fn bandCount(self: *const GatherPointsKernel, row_begin: usize, row_end: usize) void {
+        const threshold = splat(lanes, self.settings.threshold);
+        const ones: @Vector(lanes, u32) = @splat(1);
+        const zeroes: @Vector(lanes, u32) = @splat(0);
+        const pixels = self.input[row_begin * self.width .. row_end * self.width];
+
+        var counts = zeroes;
+        var count: usize = 0;
+        var index: usize = 0;
+        while (index + lanes <= pixels.len) : (index += lanes) {
+            counts += @select(u32, load(lanes, pixels, index) >= threshold, ones, zeroes);
+        }
+        while (index < pixels.len) : (index += 1) {
+            count += @intFromBool(pixels[index] >= self.settings.threshold);
+        }
+        self.band_points[row_begin / rows_per_band] = count + @reduce(.Add, counts);
+    }
+
+    fn bandWrite(self: *const GatherPointsKernel, row_begin: usize, row_end: usize) void {
+        const s = self.settings;
+        var point_index = self.band_points[row_begin / rows_per_band];
+        for (row_begin..row_end) |y| {
+            for (self.input[y * self.width ..][0..self.width], 0..) |value, x| {
+                if (value >= s.threshold) {
+                    if (point_index < self.points.len) {
+                        self.points[point_index] = .{
+                            (@as(f32, @floatFromInt(x)) / @as(f32, @floatFromInt(self.width))) * s.world_width,
+                            (@as(f32, @floatFromInt(y)) / @as(f32, @floatFromInt(self.height))) * s.world_height,
+                        };
+                    }
+                    point_index += 1;
+                }
+            }
+        }
+    }
+};
+
+fn gatherPoints(info: *const graph.ComputeInfo) void {
+    const points_buffer = info.out_buffers[0];
+    const points_ptr: [*][2]f32 = @ptrCast(@alignCast(points_buffer.data));
+    const counter: *u32 = @ptrCast(@alignCast(info.out_buffers[1].data));
+    const height: usize = info.in_buffers[0].height;
+
+    const band_count = std.math.divCeil(usize, height, rows_per_band) catch unreachable;
+    const band_points = std.heap.c_allocator.alloc(usize, band_count) catch unreachable;
+    defer std.heap.c_allocator.free(band_points);
+
+    const kernel = GatherPointsKernel{
+        .input = bufferF32(info.in_buffers[0]),
+        .points = points_ptr[0 .. @as(usize, points_buffer.width) * points_buffer.height],
+        .band_points = band_points,
+        .width = info.in_buffers[0].width,
+        .height = height,
+        .settings = settingsAs(compute.GatherPointsSettings, info),
+    };
+    forEachBand(height, rows_per_band, &kernel, GatherPointsKernel.bandCount);
+
+    // Counts to offsets
+    var point_count: usize = 0;
+    for (band_points) |*band_point| {
+        const count = band_point.*;
+        band_point.* = point_count;
+        point_count += count;
+    }
+    forEachBand(height, rows_per_band, &kernel, GatherPointsKernel.bandWrite);
+
+    // NOTE: D3D drops writes past the end of the points buffer but keeps counting, clamp so
+    // callers can iterate the points with the counter.
+    counter.* = @intCast(@min(point_count, kernel.points.len));
+}
+
+// parallel_reduce.hlsl, min or max of the whole input into the first output pixel.
+const ReduceKernel = struct {
+    input: []const f32,
+    band_results: []f32,
+    width: usize,
+    op: graph.ComputeOperatorId,
+
+    fn band(self: *const ReduceKernel, row_begin: usize, row_end: usize) void {
+        const pixels = self.input[row_begin * self.width .. row_end * self.width];
+        var result_lanes = splat(lanes, pixels[0]);
+        var result = pixels[0];
+        var index: usize = 0;
+        if (self.op == .min) {
+            while (index + lanes <= pixels.len) : (index += lanes) {
+                result_lanes = @min(result_lanes, load(lanes, pixels, index));
+            }
+            while (index < pixels.len) : (index += 1) {
+                result = @min(result, pixels[index]);
+            }
+            result = @min(result, @reduce(.Min, result_lanes));
+        } else {
+            while (index + lanes <= pixels.len) : (index += lanes) {
+                result_lanes = @max(result_lanes, load(lanes, pixels, index));
+            }
+            while (index < pixels.len) : (index += 1) {
+                result = @max(result, pixels[index]);
+            }
+            result = @max(result, @reduce(.Max, result_lanes));
+        }
+        self.band_results[row_begin / rows_per_band] = result;
+    }
+};
+
+fn reduce(info: *const graph.ComputeInfo) void {
+    const height: usize = info.in_buffers[0].height;
+    if (height == 0 or info.in_buffers[0].width == 0) {
+        return;
+    }
+
+    const band_results = std.heap.c_allocator.alloc(f32, std.math.divCeil(usize, height, rows_per_band) catch unreachable) catch unreachable;
+    defer std.heap.c_allocator.free(band_results);
+
+    const kernel = ReduceKernel{
+        .input = bufferF32(info.in_buffers[0]),
+        .band_results = band_results,
+        .width = info.in_buffers[0].width,
+        .op = if (info.compute_operator_id == .min) .min else .max,
+    };
+    forEachBand(height, rows_per_band, &kernel, ReduceKernel.band);
+
+    var result = band_results[0];
+    for (band_results[1..]) |band_result| {
+        result = if (kernel.op == .min) @min(result, band_result) else @max(result, band_result);
+    }
+    bufferF32(info.out_buffers[0])[0] = result;
+}
+
+// ██████╗ ███████╗███╗   ██╗ ██████╗██╗  ██╗
+// ██╔══██╗██╔════╝████╗  ██║██╔════╝██║  ██║
+// ██████╔╝█████╗  ██╔██╗ ██║██║     ███████║
+// ██╔══██╗██╔══╝  ██║╚██╗██║██║     ██╔══██║
+// ██████╔╝███████╗██║ ╚████║╚██████╗██║  ██║
+// ╚═════╝ ╚══════╝╚═╝  ╚═══╝ ╚═════╝╚═╝  ╚═╝
+
+fn reportKernel(name: []const u8, pixel_count: u64, timer: *std.time.Timer) void {
+    const elapsed_ns = timer.lap();
+    const elapsed_ms = @as(f64, @floatFromInt(elapsed_ns)) / std.time.ns_per_ms;
+    const megapixels = @as(f64, @floatFromInt(pixel_count)) / 1_000_000.0;
+    std.log.info("{s:<26} {d:>10.1} ms {d:>10.1} Mpix/s", .{ name, elapsed_ms, megapixels / (elapsed_ms / std.time.ms_per_s) });
+}
+
+// Times every kernel once on size x size images through compute.zig, like the graph nodes call
+// them. Throughput is counted in output pixels. Needs 4 images of size^2 floats (4 GiB at 16384).
+pub fn benchmark(size: u64) void {
+    std.debug.assert(compute.compute_fn == &dispatch);
+    const allocator = std.heap.c_allocator;
+
+    var images: [4]types.ImageF32 = undefined;
+    for (&images) |*image| {
+        image.* = types.ImageF32.square(size);
+        image.pixels = allocator.alloc(f32, image.size.area()) catch unreachable;
+        image.zeroClear(); // Fault the pages in outside of the timings
+    }
+    defer {
+        for (images) |image| {
+            allocator.free(image.pixels);
+        }
+    }
+
+    var points = types.ImageVec2.square(1024);
+    points.pixels = allocator.alloc([2]f32, points.size.area()) catch unreachable;
+    defer allocator.free(points.pixels);
+    var counter = types.ImageU32.square(1);
+    counter.pixels = allocator.alloc(u32, 1) catch unreachable;
+    defer allocator.free(counter.pixels);
+
+    const a = &images[0];
+    const b = &images[1];
+    const c = &images[2];
+    const d = &images[3];
+    var half = types.ImageF32.square(size / 2);
+    half.pixels = d.pixels[0..half.size.area()];
+
+    const area = a.size.area();
+    const width: u32 = @intCast(size);
+    std.log.info("CPU compute benchmark: {d}x{d}, {d} workers, {d}-wide f32 vectors", .{ size, size, worker_count, lanes });
+
+    var timer = std.time.Timer.start() catch unreachable;
+    compute.fbm(a, .{
+        .width = width,
+        .height = width,
+        .seed = 1,
+        .frequency = 0.0005,
+        .octaves = 8,
+        .scale = 1,
+        ._padding = .{ 0, 0 },
+    });
+    reportKernel("fbm", area, &timer);
+
+    compute.compute_f32_1(.remap, a, b, compute.RemapSettings{ .from_min = 0, .from_max = 1, .to_min = 0.1, .to_max = 0.9, .width = width, .height = width });
+    reportKernel("remap", area, &timer);
+
+    compute.compute_f32_1(.square, a, b, compute.SquareSettings{ .width = width, .height = width });
+    reportKernel("square", area, &timer);
+
+    var math_in = [_]*types.ImageF32{ a, b };
+    var math_out = [_]*types.ImageF32{c};
+    const math_settings = compute.MathSettings{ .width = width, .height = width };
+    compute.compute_f32_n(.add, math_in[0..], math_out[0..], math_settings);
+    reportKernel("add", area, &timer);
+    compute.compute_f32_n(.multiply, math_in[0..], math_out[0..], math_settings);
+    reportKernel("multiply", area, &timer);
+
+    compute.compute_reduce_f32_1(.reduce, .min, a, c);
+    reportKernel("reduce min", area, &timer);
+    compute.compute_reduce_f32_1(.reduce, .max, a, c);
+    reportKernel("reduce max", area, &timer);
+
+    const downsample_settings = compute.ResampleSettings{ .buffer_width = width / 2, .buffer_height = width / 2, .op = .average };
+    compute.compute_f32_1(.downsample, a, &half, downsample_settings);
+    reportKernel("downsample average", half.size.area(), &timer);
+
+    const upsample_settings = compute.ResampleSettings{ .buffer_width = width / 2, .buffer_height = width / 2, .op = .nearest };
+    compute.compute_f32_1(.upsample, &half, b, upsample_settings);
+    reportKernel("upsample nearest", area, &timer);
+    compute.compute_f32_1(.upsample_bilinear, &half, b, upsample_settings);
+    reportKernel("upsample bilinear", area, &timer);
+    compute.compute_f32_1(.upsample_blur, &half, b, upsample_settings);
+    reportKernel("upsample blur", area, &timer);
+
+    const blur_settings = compute.BlurSettings{ .buffer_width = width, .buffer_height = width };
+    compute.compute_f32_1(.gaussian_blur_horizontal, a, b, blur_settings);
+    reportKernel("gaussian blur horizontal", area, &timer);
+    compute.compute_f32_1(.gaussian_blur_vertical, b, c, blur_settings);
+    reportKernel("gaussian blur vertical", area, &timer);
+
+    const curve = [_]f32{ 0, 0, 0.3, 0.1, 0.6, 0.7, 1, 1 };
+    var curve_image = types.ImageF32{ .size = .{ .width = curve.len, .height = 1 } };
+    curve_image.pixels = allocator.dupe(f32, &curve) catch unreachable;
+    defer allocator.free(curve_image.pixels);
+    var curve_in = [_]*types.ImageF32{ a, &curve_image };
+    var curve_out = [_]*types.ImageF32{b};
+    compute.compute_f32_n(.remap_curve_linear, curve_in[0..], curve_out[0..], compute.RemapData{ .width = width, .height = width, .curve_keys_count = curve.len / 2 });
+    reportKernel("remap curve linear", area, &timer);
+
+    compute.compute_f32_1(.gradient, a, b, compute.GradientData{ .g_buffer_width = width, .g_buffer_height = width, .g_height_ratio = 1 });
+    reportKernel("gradient", area, &timer);
+
+    var terrace_in = [_]*types.ImageF32{ b, a };
+    var terrace_out = [_]*types.ImageF32{ c, d };
+    compute.compute_f32_n(.terrace, terrace_in[0..], terrace_out[0..], compute.TerraceSettings{ .width = width, .height = width, .gradient_max = 1 });
+    reportKernel("terrace", area, &timer);
+
+    compute.gatherPoints(a, 1000, 1000, 0.75, &points, &counter);
+    reportKernel("gather points", area, &timer);
+}
+
+//  ██████╗██╗  ██╗███████╗ ██████╗██╗  ██╗
+// ██╔════╝██║  ██║██╔════╝██╔════╝██║ ██╔╝
+// ██║     ███████║█████╗  ██║     █████╔╝
+// ██║     ██╔══██║██╔══╝  ██║     ██╔═██╗
+// ╚██████╗██║  ██║███████╗╚██████╗██║  ██╗
+//  ╚═════╝╚═╝  ╚═╝╚══════╝ ╚═════╝╚═╝  ╚═╝
+
+const check_size = 256;
+
+// Kernels compared by check, in the order runCheckKernels writes their outputs. Tolerances are
+// absolute, the inputs are in [0, 1].
+const CheckKernel = struct {
+    name: []const u8,
+    tolerance: f32,
+    compared_pixels: ?usize = null, // The whole output by default
+};
+
+const check_kernels = [_]CheckKernel{
+    .{ .name = "fbm", .tolerance = 1e-3 },
+    .{ .name = "remap", .tolerance = 1e-5 },
+    .{ .name = "square", .tolerance = 1e-5 },
+    .{ .name = "add", .tolerance = 1e-5 },
+    .{ .name = "multiply", .tolerance = 1e-5 },
+    .{ .name = "reduce min", .tolerance = 0, .compared_pixels = 1 },
+    .{ .name = "reduce max", .tolerance = 0, .compared_pixels = 1 },
+    .{ .name = "downsample average", .tolerance = 1e-5 },
+    .{ .name = "upsample nearest", .tolerance = 0 },
+    .{ .name = "upsample bilinear", .tolerance = 1e-4 },
+    .{ .name = "upsample blur", .tolerance = 1e-4 },
+    .{ .name = "gaussian blur horizontal", .tolerance = 1e-4 },
+    .{ .name = "gaussian blur vertical", .tolerance = 1e-4 },
+    .{ .name = "remap curve linear", .tolerance = 1e-5 },
+    .{ .name = "gradient", .tolerance = 1e-4 },
+    .{ .name = "terrace height", .tolerance = 1e-4 },
+    .{ .name = "terrace score", .tolerance = 1e-4 },
+};
+
+const CheckInputs = struct {
+    a: types.ImageF32,
+    b: types.ImageF32,
+    half: types.ImageF32,
+    curve: types.ImageF32,
+};
+
+const CheckOutputs = struct {
+    images: [check_kernels.len]types.ImageF32,
+    points: types.ImageVec2,
+    counter: types.ImageU32,
+
+    fn init(allocator: std.mem.Allocator) CheckOutputs {
+        var self: CheckOutputs = undefined;
+        for (&self.images) |*image| {
+            image.* = types.ImageF32.square(check_size);
+            image.pixels = allocator.alloc(f32, image.size.area()) catch unreachable;
+            @memset(image.pixels, 0);
+        }
+        // Room for every pixel, so neither backend drops points.
+        self.points = types.ImageVec2.square(check_size);
+        self.points.pixels = allocator.alloc([2]f32, self.points.size.area()) catch unreachable;
+        self.counter = types.ImageU32.square(1);
+        self.counter.pixels = allocator.alloc(u32, 1) catch unreachable;
+        return self;
+    }
+
+    fn deinit(self: *CheckOutputs, allocator: std.mem.Allocator) void {
+        for (self.images) |image| {
+            allocator.free(image.pixels);
+        }
+        allocator.free(self.points.pixels);
+        allocator.free(self.counter.pixels);
+    }
+};
+
+// Smooth and in [0, 1], so no backend's kernel sits on a discontinuity.
+fn checkPixel(x: usize, y: usize, phase: f32) f32 {
+    const fx: f32 = @floatFromInt(x);
+    const fy: f32 = @floatFromInt(y);
+    return 0.5 + 0.25 * @sin(fx * 0.05 + phase) + 0.25 * @cos(fy * 0.07 - phase);
+}
+
+fn checkImage(allocator: std.mem.Allocator, size: u64, phase: f32) types.ImageF32 {
+    var image = types.ImageF32.square(size);
+    image.pixels = allocator.alloc(f32, image.size.area()) catch unreachable;
+    for (0..size) |y| {
+        for (0..size) |x| {
+            image.pixels[y * size + x] = checkPixel(x, y, phase);
+        }
+    }
+    return image;
+}
+
+// Runs every kernel of check_kernels through compute.compute_fn on inputs, each one on its own
+// inputs so a mismatch points at a single kernel.
+fn runCheckKernels(inputs: *CheckInputs, outputs: *CheckOutputs) void {
+    const width: u32 = check_size;
+    const half_width: u32 = check_size / 2;
+    const out = &outputs.images;
+
+    compute.fbm(&out[0], .{
+        .width = width,
+        .height = width,
+        .seed = 1,
+        .frequency = 0.01,
+        .octaves = 4,
+        .scale = 1,
+        ._padding = .{ 0, 0 },
+    });
+    compute.compute_f32_1(.remap, &inputs.a, &out[1], compute.RemapSettings{ .from_min = 0, .from_max = 1, .to_min = 0.1, .to_max = 0.9, .width = width, .height = width });
+    compute.compute_f32_1(.square, &inputs.a, &out[2], compute.SquareSettings{ .width = width, .height = width });
+
+    var math_in = [_]*types.ImageF32{ &inputs.a, &inputs.b };
+    var add_out = [_]*types.ImageF32{&out[3]};
+    var multiply_out = [_]*types.ImageF32{&out[4]};
+    const math_settings = compute.MathSettings{ .width = width, .height = width };
+    compute.compute_f32_n(.add, math_in[0..], add_out[0..], math_settings);
+    compute.compute_f32_n(.multiply, math_in[0..], multiply_out[0..], math_settings);
+
+    compute.compute_reduce_f32_1(.reduce, .min, &inputs.a, &out[5]);
+    compute.compute_reduce_f32_1(.reduce, .max, &inputs.a, &out[6]);
+
+    out[7].size = inputs.half.size;
+    compute.compute_f32_1(.downsample, &inputs.a, &out[7], compute.ResampleSettings{ .buffer_width = half_width, .buffer_height = half_width, .op = .average });
+    const upsample_settings = compute.ResampleSettings{ .buffer_width = half_width, .buffer_height = half_width, .op = .nearest };
+    compute.compute_f32_1(.upsample, &inputs.half, &out[8], upsample_settings);
+    compute.compute_f32_1(.upsample_bilinear, &inputs.half, &out[9], upsample_settings);
+    compute.compute_f32_1(.upsample_blur, &inputs.half, &out[10], upsample_settings);
+
+    const blur_settings = compute.BlurSettings{ .buffer_width = width, .buffer_height = width };
+    compute.compute_f32_1(.gaussian_blur_horizontal, &inputs.a, &out[11], blur_settings);
+    compute.compute_f32_1(.gaussian_blur_vertical, &inputs.a, &out[12], blur_settings);
+
+    var curve_in = [_]*types.ImageF32{ &inputs.a, &inputs.curve };
+    var curve_out = [_]*types.ImageF32{&out[13]};
+    const curve_keys_count: u32 = @intCast(inputs.curve.size.width / 2);
+    compute.compute_f32_n(.remap_curve_linear, curve_in[0..], curve_out[0..], compute.RemapData{ .width = width, .height = width, .curve_keys_count = curve_keys_count });
+
+    compute.compute_f32_1(.gradient, &inputs.a, &out[14], compute.GradientData{ .g_buffer_width = width, .g_buffer_height = width, .g_height_ratio = 1 });
+
+    var terrace_in = [_]*types.ImageF32{ &inputs.b, &inputs.a };
+    var terrace_out = [_]*types.ImageF32{ &out[15], &out[16] };
+    compute.compute_f32_n(.terrace, terrace_in[0..], terrace_out[0..], compute.TerraceSettings{ .width = width, .height = width, .gradient_max = 1 });
+
+    compute.gatherPoints(&inputs.a, 1000, 1000, 0.75, &outputs.points, &outputs.counter);
+}
+
+fn lessThanPoint(_: void, a: [2]f32, b: [2]f32) bool {
+    return a[1] < b[1] or (a[1] == b[1] and a[0] < b[0]);
+}
+
+// Runs every kernel on small images through reference_fn, ui.dll's D3D11 compute, and through
+// this backend, and logs the largest difference of each. Returns false if any is past its
+// tolerance. Run with --check-compute.
+pub fn check(reference_fn: graph.fn_compute) bool {
+    const allocator = std.heap.c_allocator;
+    const curve = [_]f32{ 0, 0, 0.3, 0.1, 0.6, 0.7, 1, 1 };
+    var inputs = CheckInputs{
+        .a = checkImage(allocator, check_size, 0),
+        .b = checkImage(allocator, check_size, 1),
+        .half = checkImage(allocator, check_size / 2, 2),
+        .curve = .{ .size = .{ .width = curve.len, .height = 1 } },
+    };
+    inputs.curve.pixels = allocator.dupe(f32, &curve) catch unreachable;
+    defer {
+        allocator.free(inputs.a.pixels);
+        allocator.free(inputs.b.pixels);
+        allocator.free(inputs.half.pixels);
+        allocator.free(inputs.curve.pixels);
+    }
+
+    var reference = CheckOutputs.init(allocator);
+    defer reference.deinit(allocator);
+    var cpu = CheckOutputs.init(allocator);
+    defer cpu.deinit(allocator);
+
+    const compute_fn = compute.compute_fn;
+    defer compute.compute_fn = compute_fn;
+    compute.compute_fn = reference_fn;
+    runCheckKernels(&inputs, &reference);
+    compute.compute_fn = &dispatch;
+    runCheckKernels(&inputs, &cpu);
+
+    std.log.info("CPU compute check: {d}x{d}, {d} workers", .{ check_size, check_size, worker_count });
+    var passed = true;
+    for (check_kernels, reference.images, cpu.images) |kernel, reference_image, cpu_image| {
+        const pixel_count = kernel.compared_pixels orelse reference_image.size.area();
+        var max_error: f32 = 0;
+        var failed_pixels: usize = 0;
+        for (reference_image.pixels[0..pixel_count], cpu_image.pixels[0..pixel_count]) |expected, actual| {
+            const pixel_error = @abs(expected - actual);
+            // NOTE: Negated so NaNs fail too
+            if (!(pixel_error <= kernel.tolerance)) {
+                failed_pixels += 1;
+            }
+            max_error = @max(max_error, pixel_error);
+        }
+        passed = passed and failed_pixels == 0;
+        std.log.info("{s:<26} max error {e:>10.3} {s}", .{ kernel.name, max_error, if (failed_pixels == 0) "ok" else "FAILED" });
+    }
+
+    // The GPU appends points in whatever order its threads get to them.
+    const point_count = reference.counter.pixels[0];
+    var points_match = point_count == cpu.counter.pixels[0];
+    if (points_match) {
+        const reference_points = reference.points.pixels[0..point_count];
+        const cpu_points = cpu.points.pixels[0..point_count];
+        std.mem.sort([2]f32, reference_points, {}, lessThanPoint);
+        std.mem.sort([2]f32, cpu_points, {}, lessThanPoint);
+        for (reference_points, cpu_points) |expected, actual| {
+            points_match = points_match and expected[0] == actual[0] and expected[1] == actual[1];
+        }
+    }
+    passed = passed and points_match;
+    std.log.info("{s:<26} {d} points {s}", .{ "gather points", point_count, if (points_match) "ok" else "FAILED" });
+
+    return passed;
+}
@@ -69,7 +69,25 @@ pub const Context = struct {
     next_nodes: std.BoundedArray(fn_node2, 16) = .{},
     resources: std.StringHashMap(*anyopaque) = undefined,
     previews: std.StringHashMap(Preview) = undefined,
+    previews_mutex: std.Thread.Mutex = .{},
     compute_fn: fn_compute = undefined,
+
+    // Nodes run concurrently and the UI reads previews while they do.
+    pub fn putPreview(self: *Context, key: []const u8, preview: Preview) void {
+        self.previews_mutex.lock();
+        defer self.previews_mutex.unlock();
+        self.previews.putAssumeCapacity(key, preview);
+    }
+};
+
+// A node of a generated graph's dependency DAG. Nodes come in the order the graph's next chains
+// would run them, dependencies are the previous nodes touching the same variables.
+pub const DagNode = struct {
+    name: []const u8,
+    function: fn_node,
+    dependencies: []const u16,
+    cache_key: u64, // Hash of the node, the variables it reads and its dependencies' keys
+    cacheable: bool, // Only touches images and has no side effects
 };
 
 pub const Graph = struct {
@@ -58,7 +58,7 @@ fn writePreview(writer: anytype, image_name: []const u8, node_name: []const u8)
 
     writeLine(writer, "    types.image_preview_f32({s}, &preview_image_{s});", .{ image_name, node_name });
     writeLine(writer, "    const preview_key_{s} = \"{s}.image\";", .{ node_name, node_name });
-    writeLine(writer, "    ctx.previews.putAssumeCapacity(preview_key_{s}, .{{ .data = preview_image_{s}.asBytes() }});", .{ node_name, node_name });
+    writeLine(writer, "    ctx.putPreview(preview_key_{s}, .{{ .data = preview_image_{s}.asBytes() }});", .{ node_name, node_name });
 }
 
 fn writePreviewIndexed(writer: anytype, image_name: []const u8, node_name: []const u8, index: usize) void {
@@ -67,7 +67,372 @@ fn writePreviewIndexed(writer: anytype, image_name: []const u8, node_name: []con
 
     writeLine(writer, "    // types.image_preview_f32({s}, &preview_image_{s});", .{ image_name, node_name });
     writeLine(writer, "    // const preview_key_{s}_{d} = \"{s}.image\";", .{ node_name, index, node_name });
-    writeLine(writer, "    // ctx.previews.putAssumeCapacity(preview_key_{s}_{d}, .{{ .data = preview_image_{s}.asBytes() }});", .{ node_name, index, node_name });
+    writeLine(writer, "    // ctx.putPreview(preview_key_{s}_{d}, .{{ .data = preview_image_{s}.asBytes() }});", .{ node_name, index, node_name });
+}
+
+// ██████╗ ███████╗███████╗██╗██████╗ ███████╗███╗   ██╗ ██████╗██╗   ██╗
+// ██╔══██╗██╔════╝██╔════╝██║██╔══██╗██╔════╝████╗  ██║██╔════╝╚██╗ ██╔╝
+// ██████╔╝█████╗  ███████╗██║██║  ██║█████╗  ██╔██╗ ██║██║      ╚████╔╝
+// ██╔══██╗██╔══╝  ╚════██║██║██║  ██║██╔══╝  ██║╚██╗██║██║       ╚██╔╝
+// ██║  ██║███████╗███████║██║██████╔╝███████╗██║ ╚████║╚██████╗   ██║
+// ╚═╝  ╚═╝╚══════╝╚══════╝╚═╝╚═════╝ ╚══════╝╚═╝  ╚═══╝ ╚═════╝   ╚═╝
+
+const GraphVar = struct {
+    name: []const u8,
+    kind: u64,
+    is_const: bool,
+    size: []const u8 = "", // Images only
+    declaration: TextRange,
+};
+
+const TextRange = struct {
+    begin: usize,
+    end: usize,
+};
+
+fn imageElementType(kind: u64) ?[]const u8 {
+    return switch (kind) {
+        kind_ImageF32 => "f32",
+        kind_ImageU32 => "u32",
+        kind_ImageVec2 => "[2]f32",
+        else => null,
+    };
+}
+
+// Variables nodes write to, the others are settings.
+fn isNodeData(graph_var: GraphVar) bool {
+    return !graph_var.is_const and switch (graph_var.kind) {
+        kind_ImageF32, kind_ImageU32, kind_ImageVec2 => true,
+        kind_PatchDataPts2d, kind_PointList2D, kind_PointList3D, kind_PointListU32, kind_Voronoi => true,
+        else => false,
+    };
+}
+
+// Math nodes read the inputs besides their output tile by tile, see compute.math_tiled. With the
+// output as the first input it's accumulated into, as a later input the node stays flat.
+fn mathTiledInputs(j_node: json5.Value) ?[]const json5.Value {
+    if (hash(j_node.Object.get("kind").?.String) != kind_math) {
+        return null;
+    }
+    const inputs = j_node.Object.get("inputs").?.Array.items;
+    const output = j_node.Object.get("output").?.String;
+    for (inputs[1..]) |input| {
+        if (std.mem.eql(u8, input.String, output)) {
+            return null;
+        }
+    }
+    return if (std.mem.eql(u8, inputs[0].String, output)) inputs[1..] else inputs;
+}
+
+fn findVar(graph_vars: []const GraphVar, name: []const u8) ?usize {
+    for (graph_vars, 0..) |graph_var, i_var| {
+        if (std.mem.eql(u8, graph_var.name, name)) {
+            return i_var;
+        }
+    }
+    return null;
+}
+
+fn findNode(j_nodes: json5.Value, name: []const u8) ?usize {
+    for (j_nodes.Array.items, 0..) |j_node, i_node| {
+        if (std.mem.eql(u8, j_node.Object.get("name").?.String, name)) {
+            return i_node;
+        }
+    }
+    return null;
+}
+
+fn isIdentifierChar(char: u8) bool {
+    return std.ascii.isAlphanumeric(char) or char == '_';
+}
+
+fn usesIdentifier(text: []const u8, identifier: []const u8) bool {
+    var index: usize = 0;
+    while (std.mem.indexOfPos(u8, text, index, identifier)) |found| {
+        const end = found + identifier.len;
+        const starts_word = found == 0 or !isIdentifierChar(text[found - 1]);
+        const ends_word = end == text.len or !isIdentifierChar(text[end]);
+        if (starts_word and ends_word) {
+            return true;
+        }
+        index = end;
+    }
+    return false;
+}
+
+// Node order is static: every node pushes its next nodes to the front of the queue, so it is
+// replayed here from the graph. This order is kept for the DAG, running it on one thread gives
+// the same node order as the next chains did.
+//
+// Residency: only the images of running nodes are in memory. Before a node its images are
+// acquired unless the previous node kept them flat, after it they are released past their last
+// consumer or parked in tiles unless the next node uses them flat too. Math node inputs are read
+// from the tiles, they're only parked.
+//
+// DAG: a node depends on the previous node touching each variable it writes or reads, so nodes
+// sharing data keep their order and the rest may run concurrently. Cacheable nodes get a key
+// hashing their code, the settings they read and their dependencies' keys.
+fn writeSchedule(gpa: std.mem.Allocator, text: []const u8, j_nodes: json5.Value, graph_vars: []const GraphVar, node_bodies: []const TextRange, constants: TextRange) []u8 {
+    const node_count = node_bodies.len;
+    const var_count = graph_vars.len;
+
+    var order = std.ArrayList(usize).init(gpa);
+    defer order.deinit();
+    var pending = std.ArrayList(usize).init(gpa);
+    defer pending.deinit();
+    pending.append(findNode(j_nodes, "start").?) catch unreachable;
+    while (pending.items.len > 0) {
+        const i_node = pending.orderedRemove(0);
+        order.append(i_node) catch unreachable;
+        const next = j_nodes.Array.items[i_node].Object.get("next") orelse continue;
+        switch (next) {
+            .String => pending.insert(0, findNode(j_nodes, next.String).?) catch unreachable,
+            .Array => {
+                for (next.Array.items, 0..) |item, item_i| {
+                    pending.insert(item_i, findNode(j_nodes, item.String).?) catch unreachable;
+                }
+            },
+            else => {},
+        }
+    }
+    const dag_count = order.items.len;
+    // NOTE: exit is called by the simulator once the DAG is done
+    if (findNode(j_nodes, "exit")) |i_exit| {
+        order.append(i_exit) catch unreachable;
+    }
+
+    const uses = gpa.alloc(bool, node_count * var_count) catch unreachable;
+    defer gpa.free(uses);
+    for (node_bodies, 0..) |body, i_node| {
+        for (graph_vars, 0..) |graph_var, i_var| {
+            uses[i_node * var_count + i_var] = usesIdentifier(text[body.begin..body.end], graph_var.name);
+        }
+    }
+
+    const tiled_reads = gpa.alloc(bool, node_count * var_count) catch unreachable;
+    defer gpa.free(tiled_reads);
+    @memset(tiled_reads, false);
+    for (j_nodes.Array.items, 0..) |j_node, i_node| {
+        const inputs = mathTiledInputs(j_node) orelse continue;
+        for (inputs) |input| {
+            tiled_reads[i_node * var_count + findVar(graph_vars, input.String).?] = true;
+        }
+    }
+    const flat_uses = gpa.alloc(bool, node_count * var_count) catch unreachable;
+    defer gpa.free(flat_uses);
+    for (flat_uses, uses, tiled_reads) |*flat_use, used, tiled_read| {
+        flat_use.* = used and !tiled_read;
+    }
+
+    const prologues = gpa.alloc(std.ArrayList(u8), node_count) catch unreachable;
+    defer gpa.free(prologues);
+    const epilogues = gpa.alloc(std.ArrayList(u8), node_count) catch unreachable;
+    defer gpa.free(epilogues);
+    for (prologues, epilogues) |*prologue, *epilogue| {
+        prologue.* = std.ArrayList(u8).init(gpa);
+        epilogue.* = std.ArrayList(u8).init(gpa);
+    }
+    defer {
+        for (prologues, epilogues) |prologue, epilogue| {
+            prologue.deinit();
+            epilogue.deinit();
+        }
+    }
+
+    // Residency
+    for (graph_vars, 0..) |graph_var, i_var| {
+        const element_type = imageElementType(graph_var.kind) orelse continue;
+        const name = graph_var.name;
+
+        var last_use: ?usize = null;
+        for (order.items, 0..) |i_node, i_order| {
+            if (uses[i_node * var_count + i_var]) {
+                last_use = i_order;
+            }
+        }
+
+        for (order.items, 0..) |i_node, i_order| {
+            if (!uses[i_node * var_count + i_var]) {
+                continue;
+            }
+
+            if (tiled_reads[i_node * var_count + i_var]) {
+                writeLine(prologues[i_node].writer(), "    tiled_image.toTiles({s}, &{s}, &{s}_tiles);", .{ element_type, name, name });
+                if (i_order == last_use.?) {
+                    writeLine(epilogues[i_node].writer(), "    tiled_image.release({s}, &{s}, &{s}_tiles);", .{ element_type, name, name });
+                }
+                continue;
+            }
+
+            const used_before = i_order > 0 and flat_uses[order.items[i_order - 1] * var_count + i_var];
+            const used_after = i_order + 1 < order.items.len and flat_uses[order.items[i_order + 1] * var_count + i_var];
+            if (!used_before) {
+                const size = graph_var.size;
+                writeLine(prologues[i_node].writer(), "    tiled_image.acquire({s}, &{s}, &{s}_tiles, {s}.width * {s}.height);", .{ element_type, name, name, size, size });
+            }
+            if (i_order == last_use.?) {
+                writeLine(epilogues[i_node].writer(), "    tiled_image.release({s}, &{s}, &{s}_tiles);", .{ element_type, name, name });
+            } else if (!used_after) {
+                writeLine(epilogues[i_node].writer(), "    tiled_image.park({s}, &{s}, &{s}_tiles);", .{ element_type, name, name });
+            }
+        }
+    }
+
+    // DAG
+    const dependencies = gpa.alloc(std.ArrayList(u16), dag_count) catch unreachable;
+    defer gpa.free(dependencies);
+    const cache_keys = gpa.alloc(u64, dag_count) catch unreachable;
+    defer gpa.free(cache_keys);
+    const cacheable = gpa.alloc(bool, dag_count) catch unreachable;
+    defer gpa.free(cacheable);
+    const dag_index = gpa.alloc(?usize, node_count) catch unreachable;
+    defer gpa.free(dag_index);
+    @memset(dag_index, null);
+    const read_vars = gpa.alloc(bool, var_count) catch unreachable;
+    defer gpa.free(read_vars);
+    defer {
+        for (dependencies) |node_dependencies| {
+            node_dependencies.deinit();
+        }
+    }
+
+    for (order.items[0..dag_count], 0..) |i_node, i_dag| {
+        dag_index[i_node] = i_dag;
+        const node_uses = uses[i_node * var_count ..][0..var_count];
+
+        dependencies[i_dag] = std.ArrayList(u16).init(gpa);
+        for (graph_vars, node_uses, 0..) |graph_var, used, i_var| {
+            if (!used or !isNodeData(graph_var)) {
+                continue;
+            }
+            var i_previous = i_dag;
+            const i_dependency = while (i_previous > 0) {
+                i_previous -= 1;
+                if (uses[order.items[i_previous] * var_count + i_var]) {
+                    break i_previous;
+                }
+            } else continue;
+            if (std.mem.indexOfScalar(u16, dependencies[i_dag].items, @intCast(i_dependency)) == null) {
+                dependencies[i_dag].append(@intCast(i_dependency)) catch unreachable;
+            }
+        }
+        // NOTE: start initializes the variables and preview images every node works on
+        if (i_dag > 0 and dependencies[i_dag].items.len == 0) {
+            dependencies[i_dag].append(0) catch unreachable;
+        }
+        std.mem.sort(u16, dependencies[i_dag].items, {}, std.sort.asc(u16));
+
+        const kind = hash(j_nodes.Array.items[i_node].Object.get("kind").?.String);
+        const has_side_effects = kind == kind_write_heightmap or kind == kind_write_trees;
+        var has_images = false;
+        var has_other_data = false;
+        for (graph_vars, node_uses) |graph_var, used| {
+            if (used and isNodeData(graph_var)) {
+                if (imageElementType(graph_var.kind) != null) {
+                    has_images = true;
+                } else {
+                    has_other_data = true;
+                }
+            }
+        }
+        cacheable[i_dag] = has_images and !has_other_data and !has_side_effects;
+
+        // Settings reach the node through other variables' declarations too
+        @memcpy(read_vars, node_uses);
+        var changed = true;
+        while (changed) {
+            changed = false;
+            for (graph_vars, read_vars) |graph_var, read| {
+                if (!read) {
+                    continue;
+                }
+                const declaration = text[graph_var.declaration.begin..graph_var.declaration.end];
+                for (graph_vars, read_vars) |other_var, *other_read| {
+                    if (!other_read.* and usesIdentifier(declaration, other_var.name)) {
+                        other_read.* = true;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        var hasher = std.hash.Wyhash.init(0);
+        hasher.update(text[constants.begin..constants.end]);
+        hasher.update(text[node_bodies[i_node].begin..node_bodies[i_node].end]);
+        for (graph_vars, read_vars) |graph_var, read| {
+            if (read) {
+                hasher.update(text[graph_var.declaration.begin..graph_var.declaration.end]);
+            }
+        }
+        for (dependencies[i_dag].items) |i_dependency| {
+            hasher.update(std.mem.asBytes(&cache_keys[i_dependency]));
+        }
+        cache_keys[i_dag] = hasher.final();
+    }
+
+    var out = std.ArrayList(u8).init(gpa);
+    const writer = out.writer();
+    var text_index: usize = 0;
+    for (node_bodies, prologues, epilogues, 0..) |body, prologue, epilogue, i_node| {
+        out.appendSlice(text[text_index..body.begin]) catch unreachable;
+        if (prologue.items.len > 0) {
+            out.appendSlice(prologue.items) catch unreachable;
+            writeLine(writer, "", .{});
+        }
+
+        const i_dag = dag_index[i_node];
+        if (i_dag != null and cacheable[i_dag.?]) {
+            writeLine(writer, "    cache: {{", .{});
+            writeLine(writer, "        const cache_entries = [_]node_cache.Entry{{", .{});
+            for (graph_vars, 0..) |graph_var, i_var| {
+                const element_type = imageElementType(graph_var.kind) orelse continue;
+                if (tiled_reads[i_node * var_count + i_var]) {
+                    writeLine(writer, "            node_cache.tiledEntry({s}, &{s}, &{s}_tiles),", .{ element_type, graph_var.name, graph_var.name });
+                } else if (uses[i_node * var_count + i_var]) {
+                    writeLine(writer, "            node_cache.entry({s}, &{s}),", .{ element_type, graph_var.name });
+                }
+            }
+            writeLine(writer, "        }};", .{});
+            writeLine(writer, "        if (!node_cache.begin({d}, &cache_entries)) {{", .{i_dag.?});
+            writeLine(writer, "            break :cache;", .{});
+            writeLine(writer, "        }}", .{});
+            writeLine(writer, "", .{});
+            var lines = std.mem.splitScalar(u8, text[body.begin..body.end], '\n');
+            while (lines.next()) |line| {
+                if (line.len > 0) {
+                    writeLine(writer, "    {s}", .{line});
+                } else if (lines.peek() != null) {
+                    writeLine(writer, "", .{});
+                }
+            }
+            writeLine(writer, "", .{});
+            writeLine(writer, "        node_cache.end({d}, &cache_entries);", .{i_dag.?});
+            writeLine(writer, "    }}", .{});
+        } else {
+            out.appendSlice(text[body.begin..body.end]) catch unreachable;
+        }
+
+        if (epilogue.items.len > 0) {
+            writeLine(writer, "", .{});
+            out.appendSlice(epilogue.items) catch unreachable;
+        }
+        text_index = body.end;
+    }
+    out.appendSlice(text[text_index..]) catch unreachable;
+
+    writeLine(writer, "// ============ DAG ============", .{});
+    writeLine(writer, "pub const dag = [_]graph.DagNode{{", .{});
+    for (order.items[0..dag_count], dependencies, cache_keys, cacheable) |i_node, node_dependencies, cache_key, node_cacheable| {
+        const name = j_nodes.Array.items[i_node].Object.get("name").?.String;
+        write(writer, "    .{{ .name = \"{s}\", .function = {s}, .dependencies = &.{{", .{ name, name });
+        for (node_dependencies.items, 0..) |i_dependency, i| {
+            write(writer, "{s}{d}", .{ if (i == 0) " " else ", ", i_dependency });
+        }
+        writeLine(writer, "{s}}}, .cache_key = 0x{x:0>16}, .cacheable = {} }},", .{ if (node_dependencies.items.len > 0) " " else "", cache_key, node_cacheable });
+    }
+    writeLine(writer, "}};", .{});
+
+    return out.toOwnedSlice() catch unreachable;
 }
 
 // GEN
@@ -109,6 +474,8 @@ pub fn generateFile(simgraph_path: []const u8, zig_path: []const u8) void {
     writeLine(writer, "const nodes = @import(\"nodes/nodes.zig\");", .{});
     writeLine(writer, "const types = @import(\"types.zig\");", .{});
     writeLine(writer, "const compute = @import(\"compute.zig\");", .{});
+    writeLine(writer, "const tiled_image = @import(\"tiled_image.zig\");", .{});
+    writeLine(writer, "const node_cache = @import(\"node_cache.zig\");", .{});
     writeLine(writer, "", .{});
     writeLine(writer, "const c_cpp_nodes = @cImport({{", .{});
     writeLine(writer, "    @cInclude(\"world_generator.h\");", .{});
@@ -117,6 +484,7 @@ pub fn generateFile(simgraph_path: []const u8, zig_path: []const u8) void {
     // constants
     writeLine(writer, "", .{});
     writeLine(writer, "// ============ CONSTANTS ============", .{});
+    const constants_begin = out.items.len;
     // writeLine(writer, "const DRY_RUN = {};", .{j_settings.Object.get("dry_run").?.Bool});
     writeLine(writer, "const DRY_RUN = {};", .{is_debug});
     writeLine(writer, "const kilometers = if (DRY_RUN) 2 else 16;", .{});
@@ -124,7 +492,12 @@ pub fn generateFile(simgraph_path: []const u8, zig_path: []const u8) void {
     writeLine(writer, "const preview_size_big = preview_size * 2;", .{});
     writeLine(writer, "pub const node_count = {any};", .{j_nodes.Array.items.len + 1});
 
+    const constants = TextRange{ .begin = constants_begin, .end = out.items.len };
+
     // vars
+    var graph_vars = std.ArrayList(GraphVar).init(gpa);
+    defer graph_vars.deinit();
+
     writeLine(writer, "", .{});
     writeLine(writer, "// ============ VARS ============", .{});
     for (j_vars.Array.items) |j_var| {
@@ -158,6 +531,7 @@ pub fn generateFile(simgraph_path: []const u8, zig_path: []const u8) void {
             else => unreachable,
         };
 
+        const declaration_begin = out.items.len;
         write(writer, "{s} {s}: {s} = ", .{ if (is_const) "const" else "var", name, kind_type });
 
         switch (hash(kind)) {
@@ -180,14 +554,17 @@ pub fn generateFile(simgraph_path: []const u8, zig_path: []const u8) void {
             kind_ImageF32 => {
                 const size = j_var.Object.get("size").?.String;
                 writeLine(writer, "types.ImageF32.square({s}.width);", .{size});
+                writeLine(writer, "var {s}_tiles: tiled_image.TiledImage(f32) = .{{}};", .{name});
             },
             kind_ImageU32 => {
                 const size = j_var.Object.get("size").?.String;
                 writeLine(writer, "types.ImageU32.square({s}.width);", .{size});
+                writeLine(writer, "var {s}_tiles: tiled_image.TiledImage(u32) = .{{}};", .{name});
             },
             kind_ImageVec2 => {
                 const size = j_var.Object.get("size").?.String;
                 writeLine(writer, "types.ImageVec2.square({s}.width);", .{size});
+                writeLine(writer, "var {s}_tiles: tiled_image.TiledImage([2]f32) = .{{}};", .{name});
             },
             kind_Size2D => {
                 const j_width = j_var.Object.get("width").?;
@@ -224,6 +601,14 @@ pub fn generateFile(simgraph_path: []const u8, zig_path: []const u8) void {
                 writeLine(writer, "undefined;", .{});
             },
         }
+
+        graph_vars.append(.{
+            .name = name,
+            .kind = hash(kind),
+            .is_const = is_const,
+            .size = if (imageElementType(hash(kind)) != null) j_var.Object.get("size").?.String else "",
+            .declaration = .{ .begin = declaration_begin, .end = out.items.len },
+        }) catch unreachable;
     }
 
     // nodes
@@ -237,6 +622,9 @@ pub fn generateFile(simgraph_path: []const u8, zig_path: []const u8) void {
     }
 
     // nodes: functions
+    var node_bodies = std.ArrayList(TextRange).init(gpa);
+    defer node_bodies.deinit();
+
     writeLine(writer, "", .{});
     writeLine(writer, "// ============ NODES ============", .{});
     for (j_nodes.Array.items) |j_node| {
@@ -258,18 +646,7 @@ pub fn generateFile(simgraph_path: []const u8, zig_path: []const u8) void {
                     const var_kind = j_var.Object.get("kind").?.String;
 
                     switch (hash(var_kind)) {
-                        kind_ImageF32 => {
-                            const size = j_var.Object.get("size").?.String;
-                            writeLine(writer, "    {s}.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, {s}.width * {s}.height) catch unreachable;", .{ var_name, size, size });
-                        },
-                        kind_ImageU32 => {
-                            const size = j_var.Object.get("size").?.String;
-                            writeLine(writer, "    {s}.pixels = std.heap.c_allocator.alignedAlloc(u32, 32 * 8, {s}.width * {s}.height) catch unreachable;", .{ var_name, size, size });
-                        },
-                        kind_ImageVec2 => {
-                            const size = j_var.Object.get("size").?.String;
-                            writeLine(writer, "    {s}.pixels = std.heap.c_allocator.alignedAlloc([2]f32, 32 * 8, {s}.width * {s}.height) catch unreachable;", .{ var_name, size, size });
-                        },
+                        // NOTE: Images are allocated by the first node using them, see writeSchedule()
                         kind_PointList2D => {
                             writeLine(writer, "    {s} = @TypeOf({s}).init(std.heap.c_allocator);", .{ var_name, var_name });
                         },
@@ -449,31 +826,45 @@ pub fn generateFile(simgraph_path: []const u8, zig_path: []const u8) void {
                 writeLine(writer, "", .{});
                 writeLine(writer, "    const preview_grid = cpp_nodes.generate_landscape_preview(&c_voronoi, preview_size, preview_size);", .{});
                 writeLine(writer, "    const preview_grid_key = \"{s}.image\";", .{name});
-                writeLine(writer, "    ctx.previews.putAssumeCapacity(preview_grid_key, .{{ .data = preview_grid[0 .. preview_size * preview_size] }});", .{});
+                writeLine(writer, "    ctx.putPreview(preview_grid_key, .{{ .data = preview_grid[0 .. preview_size * preview_size] }});", .{});
             },
             kind_math => {
                 const op = j_node.Object.get("op").?.String;
                 const inputs = j_node.Object.get("inputs").?.Array;
                 const output = j_node.Object.get("output").?.String;
 
-                // writeLine(writer, "    scratch_image.copy({s});", .{inputs.items[0].String});
-
-                writeLine(writer, "    compute.math_{s}( &{s}, &{s}, &{s}, &{s});", .{
-                    op,
-                    inputs.items[0].String,
-                    inputs.items[1].String,
-                    output,
-                    "scratch_image",
-                });
+                if (mathTiledInputs(j_node)) |tiled_inputs| {
+                    const accumulate = tiled_inputs.len < inputs.items.len;
+                    const padding = if (tiled_inputs.len > 1) " " else "";
+                    write(writer, "    compute.math_tiled(.{s}, &.{{{s}", .{ op, padding });
+                    for (tiled_inputs, 0..) |input, i| {
+                        write(writer, "{s}&{s}", .{ if (i == 0) "" else ", ", input.String });
+                    }
+                    write(writer, "{s}}}, &.{{{s}", .{ padding, padding });
+                    for (tiled_inputs, 0..) |input, i| {
+                        write(writer, "{s}&{s}_tiles", .{ if (i == 0) "" else ", ", input.String });
+                    }
+                    writeLine(writer, "{s}}}, &{s}, &scratch_image, {});", .{ padding, output, accumulate });
+                } else {
+                    // writeLine(writer, "    scratch_image.copy({s});", .{inputs.items[0].String});
 
-                for (2..inputs.items.len) |i| {
                     writeLine(writer, "    compute.math_{s}( &{s}, &{s}, &{s}, &{s});", .{
                         op,
-                        inputs.items[i].String,
-                        output,
+                        inputs.items[0].String,
+                        inputs.items[1].String,
                         output,
                         "scratch_image",
                     });
+
+                    for (2..inputs.items.len) |i| {
+                        writeLine(writer, "    compute.math_{s}( &{s}, &{s}, &{s}, &{s});", .{
+                            op,
+                            inputs.items[i].String,
+                            output,
+                            output,
+                            "scratch_image",
+                        });
+                    }
                 }
 
                 writePreview(writer, output, name);
@@ -597,7 +988,7 @@ pub fn generateFile(simgraph_path: []const u8, zig_path: []const u8) void {
                 writeLine(writer, "    }};", .{});
                 writeLine(writer, "    const preview_grid = cpp_nodes.generate_landscape_preview(&c_voronoi, preview_size, preview_size);", .{});
                 writeLine(writer, "    const preview_grid_key = \"{s}.image\";", .{name});
-                writeLine(writer, "    ctx.previews.putAssumeCapacity(preview_grid_key, .{{ .data = preview_grid[0 .. preview_size * preview_size] }});", .{});
+                writeLine(writer, "    ctx.putPreview(preview_grid_key, .{{ .data = preview_grid[0 .. preview_size * preview_size] }});", .{});
             },
             kind_water => {
                 const water = j_node.Object.get("water").?.String;
@@ -623,30 +1014,11 @@ pub fn generateFile(simgraph_path: []const u8, zig_path: []const u8) void {
             },
         }
 
-        // next
-        const next_opt = j_node.Object.get("next");
-        if (next_opt) |next| {
-            writeLine(writer, "", .{});
-            switch (next) {
-                .String => {
-                    writeLine(writer, "    ctx.next_nodes.insert(0, {s}) catch unreachable;", .{next.String});
-                },
-                .Array => {
-                    for (next.Array.items, 0..) |item, item_i| {
-                        writeLine(writer, "    ctx.next_nodes.insert({any}, {s}) catch unreachable;", .{ item_i, item.String });
-                    }
-                },
-                else => {},
-            }
-        } else {
-            // needs_ctx = false;
-            writeLine(writer, "", .{});
-            writeLine(writer, "    // Leaf node", .{});
-        }
-
+        // NOTE: next only orders the nodes now, the DAG emitted by writeSchedule() runs them
         if (!std.mem.containsAtLeast(u8, out.items[node_start_index..], 1, "ctx")) {
             writeLine(writer, "    _ = ctx; // autofix", .{});
         }
+        node_bodies.append(.{ .begin = node_start_index, .end = out.items.len }) catch unreachable;
         writeLine(writer, "}}", .{});
         writeLine(writer, "", .{});
     }
@@ -660,5 +1032,7 @@ pub fn generateFile(simgraph_path: []const u8, zig_path: []const u8) void {
     // const zig_formatted = zig_tree.render(gpa) catch unreachable;
 
     // writeFile(zig_formatted, zig_path);
-    writeFile(out.items, zig_path);
+    const out_scheduled = writeSchedule(gpa, out.items, j_nodes, graph_vars.items, node_bodies.items, constants);
+    defer gpa.free(out_scheduled);
+    writeFile(out_scheduled, zig_path);
 }
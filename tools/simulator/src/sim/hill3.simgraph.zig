@@ -5,6 +5,8 @@ const cpp_nodes = @import("../sim_cpp/cpp_nodes.zig");
 const nodes = @import("nodes/nodes.zig");
 const types = @import("types.zig");
 const compute = @import("compute.zig");
+const tiled_image = @import("tiled_image.zig");
+const node_cache = @import("node_cache.zig");
 
 const c_cpp_nodes = @cImport({
     @cInclude("world_generator.h");
@@ -36,7 +38,9 @@ var fbm_settings_trees: nodes.fbm.FbmSettings = nodes.fbm.FbmSettings{
     .scale = 0.5,
 };
 var voronoi_image: types.ImageF32 = types.ImageF32.square(world_settings.size.width);
+var voronoi_image_tiles: tiled_image.TiledImage(f32) = .{};
 var heightmap: types.ImageF32 = types.ImageF32.square(world_settings.size.width);
+var heightmap_tiles: tiled_image.TiledImage(f32) = .{};
 var fbm_settings_water: nodes.fbm.FbmSettings = nodes.fbm.FbmSettings{
     .seed = 1,
     .frequency = 0.00005,
@@ -66,26 +70,45 @@ var fbm_settings_mountains: nodes.fbm.FbmSettings = nodes.fbm.FbmSettings{
     .scale = 1,
 };
 var heightmap_water: types.ImageF32 = types.ImageF32.square(world_settings.size.width);
+var heightmap_water_tiles: tiled_image.TiledImage(f32) = .{};
 var heightmap_plains: types.ImageF32 = types.ImageF32.square(world_settings.size.width);
+var heightmap_plains_tiles: tiled_image.TiledImage(f32) = .{};
 var heightmap_hills: types.ImageF32 = types.ImageF32.square(world_settings.size.width);
+var heightmap_hills_tiles: tiled_image.TiledImage(f32) = .{};
 var heightmap_mountains: types.ImageF32 = types.ImageF32.square(world_settings.size.width);
+var heightmap_mountains_tiles: tiled_image.TiledImage(f32) = .{};
 var weight_water: types.ImageF32 = types.ImageF32.square(world_settings.size.width);
+var weight_water_tiles: tiled_image.TiledImage(f32) = .{};
 var weight_plains: types.ImageF32 = types.ImageF32.square(world_settings.size.width);
+var weight_plains_tiles: tiled_image.TiledImage(f32) = .{};
 var weight_shore: types.ImageF32 = types.ImageF32.square(world_settings.size.width);
+var weight_shore_tiles: tiled_image.TiledImage(f32) = .{};
 var weight_hills: types.ImageF32 = types.ImageF32.square(world_settings.size.width);
+var weight_hills_tiles: tiled_image.TiledImage(f32) = .{};
 var weight_mountains: types.ImageF32 = types.ImageF32.square(world_settings.size.width);
+var weight_mountains_tiles: tiled_image.TiledImage(f32) = .{};
 var heightmap2: types.ImageF32 = types.ImageF32.square(world_settings.size.width);
+var heightmap2_tiles: tiled_image.TiledImage(f32) = .{};
 var fbm_image: types.ImageF32 = types.ImageF32.square(world_settings.size.width);
+var fbm_image_tiles: tiled_image.TiledImage(f32) = .{};
 var fbm_trees_image: types.ImageF32 = types.ImageF32.square(world_settings.size.width);
+var fbm_trees_image_tiles: tiled_image.TiledImage(f32) = .{};
 var gradient_image: types.ImageF32 = types.ImageF32.square(world_settings.size.width);
+var gradient_image_tiles: tiled_image.TiledImage(f32) = .{};
 var scratch_image: types.ImageF32 = types.ImageF32.square(world_settings.size.width);
+var scratch_image_tiles: tiled_image.TiledImage(f32) = .{};
 var scratch_image2: types.ImageF32 = types.ImageF32.square(world_settings.size.width);
+var scratch_image2_tiles: tiled_image.TiledImage(f32) = .{};
 var water_image: types.ImageF32 = types.ImageF32.square(world_settings.size.width);
+var water_image_tiles: tiled_image.TiledImage(f32) = .{};
 var cities: std.ArrayList(types.Vec3) = undefined;
 var trees_points: types.PatchDataPts2d = undefined;
 var village_gradient: types.ImageF32 = types.ImageF32.square(world_settings.size.width);
+var village_gradient_tiles: tiled_image.TiledImage(f32) = .{};
 var village_points: types.ImageVec2 = types.ImageVec2.square(world_settings.size.width);
+var village_points_tiles: tiled_image.TiledImage([2]f32) = .{};
 var village_points_counter: types.ImageU32 = types.ImageU32.square(world_settings.size.width);
+var village_points_counter_tiles: tiled_image.TiledImage(u32) = .{};
 
 // ============ PREVIEW IMAGES ============
 var preview_image_start = types.ImageRGBA.square(preview_size);
@@ -144,28 +167,7 @@ pub fn start(ctx: *Context) void {
     // Initialize vars
     voronoi = std.heap.c_allocator.create(nodes.voronoi.Voronoi) catch unreachable;
     voronoi_points = @TypeOf(voronoi_points).init(std.heap.c_allocator);
-    voronoi_image.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
-    heightmap.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
-    heightmap_water.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
-    heightmap_plains.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
-    heightmap_hills.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
-    heightmap_mountains.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
-    weight_water.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
-    weight_plains.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
-    weight_shore.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
-    weight_hills.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
-    weight_mountains.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
-    heightmap2.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
-    fbm_image.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
-    fbm_trees_image.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
-    gradient_image.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
-    scratch_image.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
-    scratch_image2.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
-    water_image.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
     cities = @TypeOf(cities).initCapacity(std.heap.c_allocator, 1000) catch unreachable;
-    village_gradient.pixels = std.heap.c_allocator.alignedAlloc(f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
-    village_points.pixels = std.heap.c_allocator.alignedAlloc([2]f32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
-    village_points_counter.pixels = std.heap.c_allocator.alignedAlloc(u32, 32 * 8, world_settings.size.width * world_settings.size.height) catch unreachable;
 
     // Initialize preview images
     preview_image_start.pixels = std.heap.c_allocator.alloc(types.ColorRGBA, preview_size * preview_size) catch unreachable;
@@ -216,16 +218,13 @@ pub fn start(ctx: *Context) void {
     preview_image_multiply_village_gradient_shore.pixels = std.heap.c_allocator.alloc(types.ColorRGBA, preview_size * preview_size) catch unreachable;
     preview_image_village_output_points.pixels = std.heap.c_allocator.alloc(types.ColorRGBA, preview_size * preview_size) catch unreachable;
     preview_image_village_points_filter_proximity.pixels = std.heap.c_allocator.alloc(types.ColorRGBA, preview_size * preview_size) catch unreachable;
-
-    ctx.next_nodes.insert(0, main) catch unreachable;
+    _ = ctx; // autofix
 }
 
 pub fn exit(ctx: *Context) void {
     std.log.info("Node: exit [exit]", .{});
 
     // Unhandled node type: exit
-
-    // Leaf node
     _ = ctx; // autofix
 }
 
@@ -233,48 +232,27 @@ pub fn main(ctx: *Context) void {
     std.log.info("Node: main [sequence]", .{});
 
     // Sequence:
-
-    ctx.next_nodes.insert(0, main_generate_voronoi) catch unreachable;
-    ctx.next_nodes.insert(1, main_generate_heightmap) catch unreachable;
-    ctx.next_nodes.insert(2, generate_trees_fbm) catch unreachable;
-    ctx.next_nodes.insert(3, output_heightmap_to_file) catch unreachable;
-    ctx.next_nodes.insert(4, remap_village_gradient) catch unreachable;
-    ctx.next_nodes.insert(5, output_cities) catch unreachable;
+    _ = ctx; // autofix
 }
 
 pub fn main_generate_voronoi(ctx: *Context) void {
     std.log.info("Node: main_generate_voronoi [sequence]", .{});
 
     // Sequence:
-
-    ctx.next_nodes.insert(0, generate_poisson_for_voronoi) catch unreachable;
-    ctx.next_nodes.insert(1, generate_voronoi_map) catch unreachable;
-    ctx.next_nodes.insert(2, generate_landscape_from_image) catch unreachable;
-    ctx.next_nodes.insert(3, generate_image_from_voronoi) catch unreachable;
+    _ = ctx; // autofix
 }
 
 pub fn main_generate_heightmap(ctx: *Context) void {
     std.log.info("Node: main_generate_heightmap [sequence]", .{});
 
     // Sequence:
-
-    ctx.next_nodes.insert(0, generate_heightmap_water) catch unreachable;
-    ctx.next_nodes.insert(1, generate_heightmap_plains) catch unreachable;
-    ctx.next_nodes.insert(2, generate_voronoi_weight_shore) catch unreachable;
-    ctx.next_nodes.insert(3, generate_heightmap_hills) catch unreachable;
-    ctx.next_nodes.insert(4, generate_heightmap_mountains) catch unreachable;
-    ctx.next_nodes.insert(5, merge_heightmaps) catch unreachable;
-    ctx.next_nodes.insert(6, generate_heightmap_gradient) catch unreachable;
-    ctx.next_nodes.insert(7, generate_terrace) catch unreachable;
-    ctx.next_nodes.insert(8, generate_heightmap_gradient2) catch unreachable;
+    _ = ctx; // autofix
 }
 
 pub fn generate_poisson_for_voronoi(ctx: *Context) void {
     std.log.info("Node: generate_poisson_for_voronoi [poisson]", .{});
 
     nodes.poisson.generate_points(world_size, 50, 1, &voronoi_points);
-
-    // Leaf node
     _ = ctx; // autofix
 }
 
@@ -294,9 +272,7 @@ pub fn generate_voronoi_map(ctx: *Context) void {
     };
     const preview_grid = cpp_nodes.generate_landscape_preview(&c_voronoi, preview_size, preview_size);
     const preview_grid_key = "generate_voronoi_map.image";
-    ctx.previews.putAssumeCapacity(preview_grid_key, .{ .data = preview_grid[0 .. preview_size * preview_size] });
-
-    // Leaf node
+    ctx.putPreview(preview_grid_key, .{ .data = preview_grid[0 .. preview_size * preview_size] });
 }
 
 pub fn generate_landscape_from_image(ctx: *Context) void {
@@ -310,23 +286,21 @@ pub fn generate_landscape_from_image(ctx: *Context) void {
 
     const preview_grid = cpp_nodes.generate_landscape_preview(&c_voronoi, preview_size, preview_size);
     const preview_grid_key = "generate_landscape_from_image.image";
-    ctx.previews.putAssumeCapacity(preview_grid_key, .{ .data = preview_grid[0 .. preview_size * preview_size] });
-
-    // Leaf node
+    ctx.putPreview(preview_grid_key, .{ .data = preview_grid[0 .. preview_size * preview_size] });
 }
 
 pub fn generate_contours(ctx: *Context) void {
     std.log.info("Node: generate_contours [contours]", .{});
 
     nodes.voronoi.contours(voronoi);
-
-    // Leaf node
     _ = ctx; // autofix
 }
 
 pub fn generate_image_from_voronoi(ctx: *Context) void {
     std.log.info("Node: generate_image_from_voronoi [image_from_voronoi]", .{});
 
+    tiled_image.acquire(f32, &voronoi_image, &voronoi_image_tiles, world_settings.size.width * world_settings.size.height);
+
     var c_voronoi = c_cpp_nodes.Voronoi{
         .voronoi_grid = voronoi.diagram,
         .voronoi_cells = @ptrCast(voronoi.cells.items.ptr),
@@ -339,37 +313,52 @@ pub fn generate_image_from_voronoi(ctx: *Context) void {
     types.saveImageF32(voronoi_image, "generate_image_from_voronoi", false);
     types.image_preview_f32(voronoi_image, &preview_image_generate_image_from_voronoi);
     const preview_key_generate_image_from_voronoi = "generate_image_from_voronoi.image";
-    ctx.previews.putAssumeCapacity(preview_key_generate_image_from_voronoi, .{ .data = preview_image_generate_image_from_voronoi.asBytes() });
+    ctx.putPreview(preview_key_generate_image_from_voronoi, .{ .data = preview_image_generate_image_from_voronoi.asBytes() });
 
-    // Leaf node
+    tiled_image.park(f32, &voronoi_image, &voronoi_image_tiles);
 }
 
 pub fn generate_heightmap_water(ctx: *Context) void {
     std.log.info("Node: generate_heightmap_water [fbm]", .{});
 
-    const generate_fbm_settings = compute.GenerateFBMSettings{
-        .width = @intCast(heightmap_water.size.width),
-        .height = @intCast(heightmap_water.size.height),
-        .seed = fbm_settings_water.seed,
-        .frequency = fbm_settings_water.frequency,
-        .octaves = fbm_settings_water.octaves,
-        .scale = fbm_settings_water.scale,
-        ._padding = .{ 0, 0 },
-    };
-
-    compute.fbm(&heightmap_water, generate_fbm_settings);
-    compute.min(&heightmap_water, &scratch_image);
-    compute.max(&heightmap_water, &scratch_image);
-    nodes.math.rerangify(&heightmap_water);
+    tiled_image.acquire(f32, &heightmap_water, &heightmap_water_tiles, world_settings.size.width * world_settings.size.height);
+    tiled_image.acquire(f32, &scratch_image, &scratch_image_tiles, world_settings.size.width * world_settings.size.height);
 
-    compute.remap(&heightmap_water, &scratch_image, 0, 1);
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &heightmap_water),
+            node_cache.entry(f32, &scratch_image),
+        };
+        if (!node_cache.begin(8, &cache_entries)) {
+            break :cache;
+        }
 
-    types.saveImageF32(heightmap_water, "generate_heightmap_water", false);
-    types.image_preview_f32(heightmap_water, &preview_image_generate_heightmap_water);
-    const preview_key_generate_heightmap_water = "generate_heightmap_water.image";
-    ctx.previews.putAssumeCapacity(preview_key_generate_heightmap_water, .{ .data = preview_image_generate_heightmap_water.asBytes() });
+        const generate_fbm_settings = compute.GenerateFBMSettings{
+            .width = @intCast(heightmap_water.size.width),
+            .height = @intCast(heightmap_water.size.height),
+            .seed = fbm_settings_water.seed,
+            .frequency = fbm_settings_water.frequency,
+            .octaves = fbm_settings_water.octaves,
+            .scale = fbm_settings_water.scale,
+            ._padding = .{ 0, 0 },
+        };
+
+        compute.fbm(&heightmap_water, generate_fbm_settings);
+        compute.min(&heightmap_water, &scratch_image);
+        compute.max(&heightmap_water, &scratch_image);
+        nodes.math.rerangify(&heightmap_water);
+
+        compute.remap(&heightmap_water, &scratch_image, 0, 1);
+
+        types.saveImageF32(heightmap_water, "generate_heightmap_water", false);
+        types.image_preview_f32(heightmap_water, &preview_image_generate_heightmap_water);
+        const preview_key_generate_heightmap_water = "generate_heightmap_water.image";
+        ctx.putPreview(preview_key_generate_heightmap_water, .{ .data = preview_image_generate_heightmap_water.asBytes() });
+
+        node_cache.end(8, &cache_entries);
+    }
 
-    // Leaf node
+    tiled_image.park(f32, &heightmap_water, &heightmap_water_tiles);
 }
 
 pub fn generate_voronoi_weight_water(ctx: *Context) void {
@@ -386,9 +375,7 @@ pub fn generate_voronoi_weight_water(ctx: *Context) void {
     types.saveImageF32(weight_water, "generate_voronoi_weight_water", false);
     types.image_preview_f32(weight_water, &preview_image_generate_voronoi_weight_water);
     const preview_key_generate_voronoi_weight_water = "generate_voronoi_weight_water.image";
-    ctx.previews.putAssumeCapacity(preview_key_generate_voronoi_weight_water, .{ .data = preview_image_generate_voronoi_weight_water.asBytes() });
-
-    ctx.next_nodes.insert(0, blur_weight_water) catch unreachable;
+    ctx.putPreview(preview_key_generate_voronoi_weight_water, .{ .data = preview_image_generate_voronoi_weight_water.asBytes() });
 }
 
 pub fn blur_weight_water(ctx: *Context) void {
@@ -399,22 +386,18 @@ pub fn blur_weight_water(ctx: *Context) void {
     types.saveImageF32(weight_water, "blur_weight_water", false);
     types.image_preview_f32(weight_water, &preview_image_blur_weight_water);
     const preview_key_blur_weight_water = "blur_weight_water.image";
-    ctx.previews.putAssumeCapacity(preview_key_blur_weight_water, .{ .data = preview_image_blur_weight_water.asBytes() });
-
-    ctx.next_nodes.insert(0, remap_heightmap_water) catch unreachable;
+    ctx.putPreview(preview_key_blur_weight_water, .{ .data = preview_image_blur_weight_water.asBytes() });
 }
 
 pub fn multiply_heightmap_weight_water(ctx: *Context) void {
     std.log.info("Node: multiply_heightmap_weight_water [math]", .{});
 
-    compute.math_multiply( &heightmap_water, &weight_water, &heightmap_water, &scratch_image);
+    compute.math_tiled(.multiply, &.{&weight_water}, &.{&weight_water_tiles}, &heightmap_water, &scratch_image, true);
 
     types.saveImageF32(heightmap_water, "multiply_heightmap_weight_water", false);
     types.image_preview_f32(heightmap_water, &preview_image_multiply_heightmap_weight_water);
     const preview_key_multiply_heightmap_weight_water = "multiply_heightmap_weight_water.image";
-    ctx.previews.putAssumeCapacity(preview_key_multiply_heightmap_weight_water, .{ .data = preview_image_multiply_heightmap_weight_water.asBytes() });
-
-    // Leaf node
+    ctx.putPreview(preview_key_multiply_heightmap_weight_water, .{ .data = preview_image_multiply_heightmap_weight_water.asBytes() });
 }
 
 pub fn remap_heightmap_water(ctx: *Context) void {
@@ -425,395 +408,714 @@ pub fn remap_heightmap_water(ctx: *Context) void {
     types.saveImageF32(heightmap_water, "remap_heightmap_water", false);
     types.image_preview_f32(heightmap_water, &preview_image_remap_heightmap_water);
     const preview_key_remap_heightmap_water = "remap_heightmap_water.image";
-    ctx.previews.putAssumeCapacity(preview_key_remap_heightmap_water, .{ .data = preview_image_remap_heightmap_water.asBytes() });
-
-    ctx.next_nodes.insert(0, multiply_heightmap_weight_water) catch unreachable;
+    ctx.putPreview(preview_key_remap_heightmap_water, .{ .data = preview_image_remap_heightmap_water.asBytes() });
 }
 
 pub fn generate_heightmap_plains(ctx: *Context) void {
     std.log.info("Node: generate_heightmap_plains [fbm]", .{});
 
-    const generate_fbm_settings = compute.GenerateFBMSettings{
-        .width = @intCast(heightmap_plains.size.width),
-        .height = @intCast(heightmap_plains.size.height),
-        .seed = fbm_settings_plains.seed,
-        .frequency = fbm_settings_plains.frequency,
-        .octaves = fbm_settings_plains.octaves,
-        .scale = fbm_settings_plains.scale,
-        ._padding = .{ 0, 0 },
-    };
-
-    compute.fbm(&heightmap_plains, generate_fbm_settings);
-    compute.min(&heightmap_plains, &scratch_image);
-    compute.max(&heightmap_plains, &scratch_image);
-    nodes.math.rerangify(&heightmap_plains);
+    tiled_image.acquire(f32, &heightmap_plains, &heightmap_plains_tiles, world_settings.size.width * world_settings.size.height);
 
-    compute.remap(&heightmap_plains, &scratch_image, 0, 1);
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &heightmap_plains),
+            node_cache.entry(f32, &scratch_image),
+        };
+        if (!node_cache.begin(9, &cache_entries)) {
+            break :cache;
+        }
 
-    types.saveImageF32(heightmap_plains, "generate_heightmap_plains", false);
-    types.image_preview_f32(heightmap_plains, &preview_image_generate_heightmap_plains);
-    const preview_key_generate_heightmap_plains = "generate_heightmap_plains.image";
-    ctx.previews.putAssumeCapacity(preview_key_generate_heightmap_plains, .{ .data = preview_image_generate_heightmap_plains.asBytes() });
+        const generate_fbm_settings = compute.GenerateFBMSettings{
+            .width = @intCast(heightmap_plains.size.width),
+            .height = @intCast(heightmap_plains.size.height),
+            .seed = fbm_settings_plains.seed,
+            .frequency = fbm_settings_plains.frequency,
+            .octaves = fbm_settings_plains.octaves,
+            .scale = fbm_settings_plains.scale,
+            ._padding = .{ 0, 0 },
+        };
+
+        compute.fbm(&heightmap_plains, generate_fbm_settings);
+        compute.min(&heightmap_plains, &scratch_image);
+        compute.max(&heightmap_plains, &scratch_image);
+        nodes.math.rerangify(&heightmap_plains);
+
+        compute.remap(&heightmap_plains, &scratch_image, 0, 1);
+
+        types.saveImageF32(heightmap_plains, "generate_heightmap_plains", false);
+        types.image_preview_f32(heightmap_plains, &preview_image_generate_heightmap_plains);
+        const preview_key_generate_heightmap_plains = "generate_heightmap_plains.image";
+        ctx.putPreview(preview_key_generate_heightmap_plains, .{ .data = preview_image_generate_heightmap_plains.asBytes() });
+
+        node_cache.end(9, &cache_entries);
+    }
 
-    ctx.next_nodes.insert(0, generate_voronoi_weight_plains) catch unreachable;
+    tiled_image.park(f32, &heightmap_plains, &heightmap_plains_tiles);
+    tiled_image.park(f32, &scratch_image, &scratch_image_tiles);
 }
 
 pub fn generate_voronoi_weight_plains(ctx: *Context) void {
     std.log.info("Node: generate_voronoi_weight_plains [remap_curve]", .{});
 
-    const curve = [_]types.Vec2{
-        .{ .x = 0, .y = 0},
-        .{ .x = 1, .y = 0},
-        .{ .x = 2, .y = 1},
-        .{ .x = 3, .y = 1},
-        .{ .x = 4, .y = 0},
-    };
-    compute.remapCurve(&voronoi_image, &curve, &weight_plains);
+    tiled_image.acquire(f32, &voronoi_image, &voronoi_image_tiles, world_settings.size.width * world_settings.size.height);
+    tiled_image.acquire(f32, &weight_plains, &weight_plains_tiles, world_settings.size.width * world_settings.size.height);
 
-    types.saveImageF32(weight_plains, "generate_voronoi_weight_plains", false);
-    types.image_preview_f32(weight_plains, &preview_image_generate_voronoi_weight_plains);
-    const preview_key_generate_voronoi_weight_plains = "generate_voronoi_weight_plains.image";
-    ctx.previews.putAssumeCapacity(preview_key_generate_voronoi_weight_plains, .{ .data = preview_image_generate_voronoi_weight_plains.asBytes() });
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &voronoi_image),
+            node_cache.entry(f32, &weight_plains),
+        };
+        if (!node_cache.begin(10, &cache_entries)) {
+            break :cache;
+        }
+
+        const curve = [_]types.Vec2{
+            .{ .x = 0, .y = 0},
+            .{ .x = 1, .y = 0},
+            .{ .x = 2, .y = 1},
+            .{ .x = 3, .y = 1},
+            .{ .x = 4, .y = 0},
+        };
+        compute.remapCurve(&voronoi_image, &curve, &weight_plains);
+
+        types.saveImageF32(weight_plains, "generate_voronoi_weight_plains", false);
+        types.image_preview_f32(weight_plains, &preview_image_generate_voronoi_weight_plains);
+        const preview_key_generate_voronoi_weight_plains = "generate_voronoi_weight_plains.image";
+        ctx.putPreview(preview_key_generate_voronoi_weight_plains, .{ .data = preview_image_generate_voronoi_weight_plains.asBytes() });
+
+        node_cache.end(10, &cache_entries);
+    }
 
-    ctx.next_nodes.insert(0, blur_weight_plains) catch unreachable;
+    tiled_image.park(f32, &voronoi_image, &voronoi_image_tiles);
 }
 
 pub fn blur_weight_plains(ctx: *Context) void {
     std.log.info("Node: blur_weight_plains [blur]", .{});
 
-    compute.blur(&weight_plains, &scratch_image, &weight_plains);
+    tiled_image.acquire(f32, &scratch_image, &scratch_image_tiles, world_settings.size.width * world_settings.size.height);
 
-    types.saveImageF32(weight_plains, "blur_weight_plains", false);
-    types.image_preview_f32(weight_plains, &preview_image_blur_weight_plains);
-    const preview_key_blur_weight_plains = "blur_weight_plains.image";
-    ctx.previews.putAssumeCapacity(preview_key_blur_weight_plains, .{ .data = preview_image_blur_weight_plains.asBytes() });
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &weight_plains),
+            node_cache.entry(f32, &scratch_image),
+        };
+        if (!node_cache.begin(11, &cache_entries)) {
+            break :cache;
+        }
+
+        compute.blur(&weight_plains, &scratch_image, &weight_plains);
+
+        types.saveImageF32(weight_plains, "blur_weight_plains", false);
+        types.image_preview_f32(weight_plains, &preview_image_blur_weight_plains);
+        const preview_key_blur_weight_plains = "blur_weight_plains.image";
+        ctx.putPreview(preview_key_blur_weight_plains, .{ .data = preview_image_blur_weight_plains.asBytes() });
+
+        node_cache.end(11, &cache_entries);
+    }
 
-    ctx.next_nodes.insert(0, remap_heightmap_plains) catch unreachable;
+    tiled_image.park(f32, &weight_plains, &weight_plains_tiles);
 }
 
 pub fn multiply_heightmap_weight_plains(ctx: *Context) void {
     std.log.info("Node: multiply_heightmap_weight_plains [math]", .{});
 
-    compute.math_multiply( &heightmap_plains, &weight_plains, &heightmap_plains, &scratch_image);
+    tiled_image.toTiles(f32, &weight_plains, &weight_plains_tiles);
 
-    types.saveImageF32(heightmap_plains, "multiply_heightmap_weight_plains", false);
-    types.image_preview_f32(heightmap_plains, &preview_image_multiply_heightmap_weight_plains);
-    const preview_key_multiply_heightmap_weight_plains = "multiply_heightmap_weight_plains.image";
-    ctx.previews.putAssumeCapacity(preview_key_multiply_heightmap_weight_plains, .{ .data = preview_image_multiply_heightmap_weight_plains.asBytes() });
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &heightmap_plains),
+            node_cache.tiledEntry(f32, &weight_plains, &weight_plains_tiles),
+            node_cache.entry(f32, &scratch_image),
+        };
+        if (!node_cache.begin(13, &cache_entries)) {
+            break :cache;
+        }
+
+        compute.math_tiled(.multiply, &.{&weight_plains}, &.{&weight_plains_tiles}, &heightmap_plains, &scratch_image, true);
+
+        types.saveImageF32(heightmap_plains, "multiply_heightmap_weight_plains", false);
+        types.image_preview_f32(heightmap_plains, &preview_image_multiply_heightmap_weight_plains);
+        const preview_key_multiply_heightmap_weight_plains = "multiply_heightmap_weight_plains.image";
+        ctx.putPreview(preview_key_multiply_heightmap_weight_plains, .{ .data = preview_image_multiply_heightmap_weight_plains.asBytes() });
+
+        node_cache.end(13, &cache_entries);
+    }
 
-    // Leaf node
+    tiled_image.park(f32, &heightmap_plains, &heightmap_plains_tiles);
+    tiled_image.park(f32, &scratch_image, &scratch_image_tiles);
 }
 
 pub fn remap_heightmap_plains(ctx: *Context) void {
     std.log.info("Node: remap_heightmap_plains [remap]", .{});
 
-    compute.remap(&heightmap_plains, &scratch_image, 50, 150);
+    tiled_image.acquire(f32, &heightmap_plains, &heightmap_plains_tiles, world_settings.size.width * world_settings.size.height);
 
-    types.saveImageF32(heightmap_plains, "remap_heightmap_plains", false);
-    types.image_preview_f32(heightmap_plains, &preview_image_remap_heightmap_plains);
-    const preview_key_remap_heightmap_plains = "remap_heightmap_plains.image";
-    ctx.previews.putAssumeCapacity(preview_key_remap_heightmap_plains, .{ .data = preview_image_remap_heightmap_plains.asBytes() });
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &heightmap_plains),
+            node_cache.entry(f32, &scratch_image),
+        };
+        if (!node_cache.begin(12, &cache_entries)) {
+            break :cache;
+        }
+
+        compute.remap(&heightmap_plains, &scratch_image, 50, 150);
+
+        types.saveImageF32(heightmap_plains, "remap_heightmap_plains", false);
+        types.image_preview_f32(heightmap_plains, &preview_image_remap_heightmap_plains);
+        const preview_key_remap_heightmap_plains = "remap_heightmap_plains.image";
+        ctx.putPreview(preview_key_remap_heightmap_plains, .{ .data = preview_image_remap_heightmap_plains.asBytes() });
 
-    ctx.next_nodes.insert(0, multiply_heightmap_weight_plains) catch unreachable;
+        node_cache.end(12, &cache_entries);
+    }
 }
 
 pub fn generate_voronoi_weight_shore(ctx: *Context) void {
     std.log.info("Node: generate_voronoi_weight_shore [remap_curve]", .{});
 
-    const curve = [_]types.Vec2{
-        .{ .x = 0, .y = 0},
-        .{ .x = 1, .y = 0},
-        .{ .x = 2, .y = 1},
-        .{ .x = 3, .y = 0},
-        .{ .x = 4, .y = 0},
-    };
-    compute.remapCurve(&voronoi_image, &curve, &weight_shore);
+    tiled_image.acquire(f32, &voronoi_image, &voronoi_image_tiles, world_settings.size.width * world_settings.size.height);
+    tiled_image.acquire(f32, &weight_shore, &weight_shore_tiles, world_settings.size.width * world_settings.size.height);
 
-    types.saveImageF32(weight_shore, "generate_voronoi_weight_shore", false);
-    types.image_preview_f32(weight_shore, &preview_image_generate_voronoi_weight_shore);
-    const preview_key_generate_voronoi_weight_shore = "generate_voronoi_weight_shore.image";
-    ctx.previews.putAssumeCapacity(preview_key_generate_voronoi_weight_shore, .{ .data = preview_image_generate_voronoi_weight_shore.asBytes() });
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &voronoi_image),
+            node_cache.entry(f32, &weight_shore),
+        };
+        if (!node_cache.begin(14, &cache_entries)) {
+            break :cache;
+        }
+
+        const curve = [_]types.Vec2{
+            .{ .x = 0, .y = 0},
+            .{ .x = 1, .y = 0},
+            .{ .x = 2, .y = 1},
+            .{ .x = 3, .y = 0},
+            .{ .x = 4, .y = 0},
+        };
+        compute.remapCurve(&voronoi_image, &curve, &weight_shore);
+
+        types.saveImageF32(weight_shore, "generate_voronoi_weight_shore", false);
+        types.image_preview_f32(weight_shore, &preview_image_generate_voronoi_weight_shore);
+        const preview_key_generate_voronoi_weight_shore = "generate_voronoi_weight_shore.image";
+        ctx.putPreview(preview_key_generate_voronoi_weight_shore, .{ .data = preview_image_generate_voronoi_weight_shore.asBytes() });
+
+        node_cache.end(14, &cache_entries);
+    }
 
-    // Leaf node
+    tiled_image.park(f32, &voronoi_image, &voronoi_image_tiles);
+    tiled_image.park(f32, &weight_shore, &weight_shore_tiles);
 }
 
 pub fn generate_heightmap_hills(ctx: *Context) void {
     std.log.info("Node: generate_heightmap_hills [fbm]", .{});
 
-    const generate_fbm_settings = compute.GenerateFBMSettings{
-        .width = @intCast(heightmap_hills.size.width),
-        .height = @intCast(heightmap_hills.size.height),
-        .seed = fbm_settings_hills.seed,
-        .frequency = fbm_settings_hills.frequency,
-        .octaves = fbm_settings_hills.octaves,
-        .scale = fbm_settings_hills.scale,
-        ._padding = .{ 0, 0 },
-    };
-
-    compute.fbm(&heightmap_hills, generate_fbm_settings);
-    compute.min(&heightmap_hills, &scratch_image);
-    compute.max(&heightmap_hills, &scratch_image);
-    nodes.math.rerangify(&heightmap_hills);
+    tiled_image.acquire(f32, &heightmap_hills, &heightmap_hills_tiles, world_settings.size.width * world_settings.size.height);
+    tiled_image.acquire(f32, &scratch_image, &scratch_image_tiles, world_settings.size.width * world_settings.size.height);
 
-    compute.remap(&heightmap_hills, &scratch_image, 0, 1);
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &heightmap_hills),
+            node_cache.entry(f32, &scratch_image),
+        };
+        if (!node_cache.begin(15, &cache_entries)) {
+            break :cache;
+        }
 
-    types.saveImageF32(heightmap_hills, "generate_heightmap_hills", false);
-    types.image_preview_f32(heightmap_hills, &preview_image_generate_heightmap_hills);
-    const preview_key_generate_heightmap_hills = "generate_heightmap_hills.image";
-    ctx.previews.putAssumeCapacity(preview_key_generate_heightmap_hills, .{ .data = preview_image_generate_heightmap_hills.asBytes() });
+        const generate_fbm_settings = compute.GenerateFBMSettings{
+            .width = @intCast(heightmap_hills.size.width),
+            .height = @intCast(heightmap_hills.size.height),
+            .seed = fbm_settings_hills.seed,
+            .frequency = fbm_settings_hills.frequency,
+            .octaves = fbm_settings_hills.octaves,
+            .scale = fbm_settings_hills.scale,
+            ._padding = .{ 0, 0 },
+        };
+
+        compute.fbm(&heightmap_hills, generate_fbm_settings);
+        compute.min(&heightmap_hills, &scratch_image);
+        compute.max(&heightmap_hills, &scratch_image);
+        nodes.math.rerangify(&heightmap_hills);
+
+        compute.remap(&heightmap_hills, &scratch_image, 0, 1);
+
+        types.saveImageF32(heightmap_hills, "generate_heightmap_hills", false);
+        types.image_preview_f32(heightmap_hills, &preview_image_generate_heightmap_hills);
+        const preview_key_generate_heightmap_hills = "generate_heightmap_hills.image";
+        ctx.putPreview(preview_key_generate_heightmap_hills, .{ .data = preview_image_generate_heightmap_hills.asBytes() });
+
+        node_cache.end(15, &cache_entries);
+    }
 
-    ctx.next_nodes.insert(0, generate_voronoi_weight_hills) catch unreachable;
+    tiled_image.park(f32, &heightmap_hills, &heightmap_hills_tiles);
+    tiled_image.park(f32, &scratch_image, &scratch_image_tiles);
 }
 
 pub fn generate_voronoi_weight_hills(ctx: *Context) void {
     std.log.info("Node: generate_voronoi_weight_hills [remap_curve]", .{});
 
-    const curve = [_]types.Vec2{
-        .{ .x = 0, .y = 0},
-        .{ .x = 1, .y = 0},
-        .{ .x = 2, .y = 0},
-        .{ .x = 3, .y = 0},
-        .{ .x = 4, .y = 1},
-        .{ .x = 5, .y = 0},
-    };
-    compute.remapCurve(&voronoi_image, &curve, &weight_hills);
+    tiled_image.acquire(f32, &voronoi_image, &voronoi_image_tiles, world_settings.size.width * world_settings.size.height);
+    tiled_image.acquire(f32, &weight_hills, &weight_hills_tiles, world_settings.size.width * world_settings.size.height);
+
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &voronoi_image),
+            node_cache.entry(f32, &weight_hills),
+        };
+        if (!node_cache.begin(16, &cache_entries)) {
+            break :cache;
+        }
 
-    types.saveImageF32(weight_hills, "generate_voronoi_weight_hills", false);
-    types.image_preview_f32(weight_hills, &preview_image_generate_voronoi_weight_hills);
-    const preview_key_generate_voronoi_weight_hills = "generate_voronoi_weight_hills.image";
-    ctx.previews.putAssumeCapacity(preview_key_generate_voronoi_weight_hills, .{ .data = preview_image_generate_voronoi_weight_hills.asBytes() });
+        const curve = [_]types.Vec2{
+            .{ .x = 0, .y = 0},
+            .{ .x = 1, .y = 0},
+            .{ .x = 2, .y = 0},
+            .{ .x = 3, .y = 0},
+            .{ .x = 4, .y = 1},
+            .{ .x = 5, .y = 0},
+        };
+        compute.remapCurve(&voronoi_image, &curve, &weight_hills);
+
+        types.saveImageF32(weight_hills, "generate_voronoi_weight_hills", false);
+        types.image_preview_f32(weight_hills, &preview_image_generate_voronoi_weight_hills);
+        const preview_key_generate_voronoi_weight_hills = "generate_voronoi_weight_hills.image";
+        ctx.putPreview(preview_key_generate_voronoi_weight_hills, .{ .data = preview_image_generate_voronoi_weight_hills.asBytes() });
+
+        node_cache.end(16, &cache_entries);
+    }
 
-    ctx.next_nodes.insert(0, blur_weight_hills) catch unreachable;
+    tiled_image.park(f32, &voronoi_image, &voronoi_image_tiles);
 }
 
 pub fn blur_weight_hills(ctx: *Context) void {
     std.log.info("Node: blur_weight_hills [blur]", .{});
 
-    compute.blur(&weight_hills, &scratch_image, &weight_hills);
+    tiled_image.acquire(f32, &scratch_image, &scratch_image_tiles, world_settings.size.width * world_settings.size.height);
+
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &weight_hills),
+            node_cache.entry(f32, &scratch_image),
+        };
+        if (!node_cache.begin(17, &cache_entries)) {
+            break :cache;
+        }
+
+        compute.blur(&weight_hills, &scratch_image, &weight_hills);
 
-    types.saveImageF32(weight_hills, "blur_weight_hills", false);
-    types.image_preview_f32(weight_hills, &preview_image_blur_weight_hills);
-    const preview_key_blur_weight_hills = "blur_weight_hills.image";
-    ctx.previews.putAssumeCapacity(preview_key_blur_weight_hills, .{ .data = preview_image_blur_weight_hills.asBytes() });
+        types.saveImageF32(weight_hills, "blur_weight_hills", false);
+        types.image_preview_f32(weight_hills, &preview_image_blur_weight_hills);
+        const preview_key_blur_weight_hills = "blur_weight_hills.image";
+        ctx.putPreview(preview_key_blur_weight_hills, .{ .data = preview_image_blur_weight_hills.asBytes() });
 
-    ctx.next_nodes.insert(0, remap_heightmap_hills) catch unreachable;
+        node_cache.end(17, &cache_entries);
+    }
+
+    tiled_image.park(f32, &weight_hills, &weight_hills_tiles);
 }
 
 pub fn multiply_heightmap_weight_hills(ctx: *Context) void {
     std.log.info("Node: multiply_heightmap_weight_hills [math]", .{});
 
-    compute.math_multiply( &heightmap_hills, &weight_hills, &heightmap_hills, &scratch_image);
+    tiled_image.toTiles(f32, &weight_hills, &weight_hills_tiles);
+
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &heightmap_hills),
+            node_cache.tiledEntry(f32, &weight_hills, &weight_hills_tiles),
+            node_cache.entry(f32, &scratch_image),
+        };
+        if (!node_cache.begin(19, &cache_entries)) {
+            break :cache;
+        }
 
-    types.saveImageF32(heightmap_hills, "multiply_heightmap_weight_hills", false);
-    types.image_preview_f32(heightmap_hills, &preview_image_multiply_heightmap_weight_hills);
-    const preview_key_multiply_heightmap_weight_hills = "multiply_heightmap_weight_hills.image";
-    ctx.previews.putAssumeCapacity(preview_key_multiply_heightmap_weight_hills, .{ .data = preview_image_multiply_heightmap_weight_hills.asBytes() });
+        compute.math_tiled(.multiply, &.{&weight_hills}, &.{&weight_hills_tiles}, &heightmap_hills, &scratch_image, true);
 
-    // Leaf node
+        types.saveImageF32(heightmap_hills, "multiply_heightmap_weight_hills", false);
+        types.image_preview_f32(heightmap_hills, &preview_image_multiply_heightmap_weight_hills);
+        const preview_key_multiply_heightmap_weight_hills = "multiply_heightmap_weight_hills.image";
+        ctx.putPreview(preview_key_multiply_heightmap_weight_hills, .{ .data = preview_image_multiply_heightmap_weight_hills.asBytes() });
+
+        node_cache.end(19, &cache_entries);
+    }
+
+    tiled_image.park(f32, &heightmap_hills, &heightmap_hills_tiles);
+    tiled_image.release(f32, &weight_hills, &weight_hills_tiles);
 }
 
 pub fn remap_heightmap_hills(ctx: *Context) void {
     std.log.info("Node: remap_heightmap_hills [remap]", .{});
 
-    compute.remap(&heightmap_hills, &scratch_image, 150, 500);
+    tiled_image.acquire(f32, &heightmap_hills, &heightmap_hills_tiles, world_settings.size.width * world_settings.size.height);
+
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &heightmap_hills),
+            node_cache.entry(f32, &scratch_image),
+        };
+        if (!node_cache.begin(18, &cache_entries)) {
+            break :cache;
+        }
 
-    types.saveImageF32(heightmap_hills, "remap_heightmap_hills", false);
-    types.image_preview_f32(heightmap_hills, &preview_image_remap_heightmap_hills);
-    const preview_key_remap_heightmap_hills = "remap_heightmap_hills.image";
-    ctx.previews.putAssumeCapacity(preview_key_remap_heightmap_hills, .{ .data = preview_image_remap_heightmap_hills.asBytes() });
+        compute.remap(&heightmap_hills, &scratch_image, 150, 500);
 
-    ctx.next_nodes.insert(0, multiply_heightmap_weight_hills) catch unreachable;
+        types.saveImageF32(heightmap_hills, "remap_heightmap_hills", false);
+        types.image_preview_f32(heightmap_hills, &preview_image_remap_heightmap_hills);
+        const preview_key_remap_heightmap_hills = "remap_heightmap_hills.image";
+        ctx.putPreview(preview_key_remap_heightmap_hills, .{ .data = preview_image_remap_heightmap_hills.asBytes() });
+
+        node_cache.end(18, &cache_entries);
+    }
 }
 
 pub fn generate_heightmap_mountains(ctx: *Context) void {
     std.log.info("Node: generate_heightmap_mountains [fbm]", .{});
 
-    const generate_fbm_settings = compute.GenerateFBMSettings{
-        .width = @intCast(heightmap_mountains.size.width),
-        .height = @intCast(heightmap_mountains.size.height),
-        .seed = fbm_settings_mountains.seed,
-        .frequency = fbm_settings_mountains.frequency,
-        .octaves = fbm_settings_mountains.octaves,
-        .scale = fbm_settings_mountains.scale,
-        ._padding = .{ 0, 0 },
-    };
-
-    compute.fbm(&heightmap_mountains, generate_fbm_settings);
-    compute.min(&heightmap_mountains, &scratch_image);
-    compute.max(&heightmap_mountains, &scratch_image);
-    nodes.math.rerangify(&heightmap_mountains);
+    tiled_image.acquire(f32, &heightmap_mountains, &heightmap_mountains_tiles, world_settings.size.width * world_settings.size.height);
 
-    compute.remap(&heightmap_mountains, &scratch_image, 0, 1);
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &heightmap_mountains),
+            node_cache.entry(f32, &scratch_image),
+        };
+        if (!node_cache.begin(20, &cache_entries)) {
+            break :cache;
+        }
 
-    types.saveImageF32(heightmap_mountains, "generate_heightmap_mountains", false);
-    types.image_preview_f32(heightmap_mountains, &preview_image_generate_heightmap_mountains);
-    const preview_key_generate_heightmap_mountains = "generate_heightmap_mountains.image";
-    ctx.previews.putAssumeCapacity(preview_key_generate_heightmap_mountains, .{ .data = preview_image_generate_heightmap_mountains.asBytes() });
+        const generate_fbm_settings = compute.GenerateFBMSettings{
+            .width = @intCast(heightmap_mountains.size.width),
+            .height = @intCast(heightmap_mountains.size.height),
+            .seed = fbm_settings_mountains.seed,
+            .frequency = fbm_settings_mountains.frequency,
+            .octaves = fbm_settings_mountains.octaves,
+            .scale = fbm_settings_mountains.scale,
+            ._padding = .{ 0, 0 },
+        };
+
+        compute.fbm(&heightmap_mountains, generate_fbm_settings);
+        compute.min(&heightmap_mountains, &scratch_image);
+        compute.max(&heightmap_mountains, &scratch_image);
+        nodes.math.rerangify(&heightmap_mountains);
+
+        compute.remap(&heightmap_mountains, &scratch_image, 0, 1);
+
+        types.saveImageF32(heightmap_mountains, "generate_heightmap_mountains", false);
+        types.image_preview_f32(heightmap_mountains, &preview_image_generate_heightmap_mountains);
+        const preview_key_generate_heightmap_mountains = "generate_heightmap_mountains.image";
+        ctx.putPreview(preview_key_generate_heightmap_mountains, .{ .data = preview_image_generate_heightmap_mountains.asBytes() });
+
+        node_cache.end(20, &cache_entries);
+    }
 
-    ctx.next_nodes.insert(0, generate_voronoi_weight_mountains) catch unreachable;
+    tiled_image.park(f32, &heightmap_mountains, &heightmap_mountains_tiles);
+    tiled_image.park(f32, &scratch_image, &scratch_image_tiles);
 }
 
 pub fn generate_voronoi_weight_mountains(ctx: *Context) void {
     std.log.info("Node: generate_voronoi_weight_mountains [remap_curve]", .{});
 
-    const curve = [_]types.Vec2{
-        .{ .x = 0, .y = 0},
-        .{ .x = 1, .y = 0},
-        .{ .x = 2, .y = 0},
-        .{ .x = 3, .y = 0},
-        .{ .x = 4, .y = 0},
-        .{ .x = 5, .y = 1},
-    };
-    compute.remapCurve(&voronoi_image, &curve, &weight_mountains);
+    tiled_image.acquire(f32, &voronoi_image, &voronoi_image_tiles, world_settings.size.width * world_settings.size.height);
+    tiled_image.acquire(f32, &weight_mountains, &weight_mountains_tiles, world_settings.size.width * world_settings.size.height);
 
-    types.saveImageF32(weight_mountains, "generate_voronoi_weight_mountains", false);
-    types.image_preview_f32(weight_mountains, &preview_image_generate_voronoi_weight_mountains);
-    const preview_key_generate_voronoi_weight_mountains = "generate_voronoi_weight_mountains.image";
-    ctx.previews.putAssumeCapacity(preview_key_generate_voronoi_weight_mountains, .{ .data = preview_image_generate_voronoi_weight_mountains.asBytes() });
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &voronoi_image),
+            node_cache.entry(f32, &weight_mountains),
+        };
+        if (!node_cache.begin(21, &cache_entries)) {
+            break :cache;
+        }
 
-    ctx.next_nodes.insert(0, blur_weight_mountains) catch unreachable;
+        const curve = [_]types.Vec2{
+            .{ .x = 0, .y = 0},
+            .{ .x = 1, .y = 0},
+            .{ .x = 2, .y = 0},
+            .{ .x = 3, .y = 0},
+            .{ .x = 4, .y = 0},
+            .{ .x = 5, .y = 1},
+        };
+        compute.remapCurve(&voronoi_image, &curve, &weight_mountains);
+
+        types.saveImageF32(weight_mountains, "generate_voronoi_weight_mountains", false);
+        types.image_preview_f32(weight_mountains, &preview_image_generate_voronoi_weight_mountains);
+        const preview_key_generate_voronoi_weight_mountains = "generate_voronoi_weight_mountains.image";
+        ctx.putPreview(preview_key_generate_voronoi_weight_mountains, .{ .data = preview_image_generate_voronoi_weight_mountains.asBytes() });
+
+        node_cache.end(21, &cache_entries);
+    }
+
+    tiled_image.release(f32, &voronoi_image, &voronoi_image_tiles);
 }
 
 pub fn blur_weight_mountains(ctx: *Context) void {
     std.log.info("Node: blur_weight_mountains [blur]", .{});
 
-    compute.blur(&weight_mountains, &scratch_image, &weight_mountains);
+    tiled_image.acquire(f32, &scratch_image, &scratch_image_tiles, world_settings.size.width * world_settings.size.height);
+
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &weight_mountains),
+            node_cache.entry(f32, &scratch_image),
+        };
+        if (!node_cache.begin(22, &cache_entries)) {
+            break :cache;
+        }
 
-    types.saveImageF32(weight_mountains, "blur_weight_mountains", false);
-    types.image_preview_f32(weight_mountains, &preview_image_blur_weight_mountains);
-    const preview_key_blur_weight_mountains = "blur_weight_mountains.image";
-    ctx.previews.putAssumeCapacity(preview_key_blur_weight_mountains, .{ .data = preview_image_blur_weight_mountains.asBytes() });
+        compute.blur(&weight_mountains, &scratch_image, &weight_mountains);
 
-    ctx.next_nodes.insert(0, remap_heightmap_mountains) catch unreachable;
+        types.saveImageF32(weight_mountains, "blur_weight_mountains", false);
+        types.image_preview_f32(weight_mountains, &preview_image_blur_weight_mountains);
+        const preview_key_blur_weight_mountains = "blur_weight_mountains.image";
+        ctx.putPreview(preview_key_blur_weight_mountains, .{ .data = preview_image_blur_weight_mountains.asBytes() });
+
+        node_cache.end(22, &cache_entries);
+    }
+
+    tiled_image.park(f32, &weight_mountains, &weight_mountains_tiles);
 }
 
 pub fn multiply_heightmap_weight_mountains(ctx: *Context) void {
     std.log.info("Node: multiply_heightmap_weight_mountains [math]", .{});
 
-    compute.math_multiply( &heightmap_mountains, &weight_mountains, &heightmap_mountains, &scratch_image);
+    tiled_image.toTiles(f32, &weight_mountains, &weight_mountains_tiles);
+
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &heightmap_mountains),
+            node_cache.tiledEntry(f32, &weight_mountains, &weight_mountains_tiles),
+            node_cache.entry(f32, &scratch_image),
+        };
+        if (!node_cache.begin(24, &cache_entries)) {
+            break :cache;
+        }
+
+        compute.math_tiled(.multiply, &.{&weight_mountains}, &.{&weight_mountains_tiles}, &heightmap_mountains, &scratch_image, true);
+
+        types.saveImageF32(heightmap_mountains, "multiply_heightmap_weight_mountains", false);
+        types.image_preview_f32(heightmap_mountains, &preview_image_multiply_heightmap_weight_mountains);
+        const preview_key_multiply_heightmap_weight_mountains = "multiply_heightmap_weight_mountains.image";
+        ctx.putPreview(preview_key_multiply_heightmap_weight_mountains, .{ .data = preview_image_multiply_heightmap_weight_mountains.asBytes() });
 
-    types.saveImageF32(heightmap_mountains, "multiply_heightmap_weight_mountains", false);
-    types.image_preview_f32(heightmap_mountains, &preview_image_multiply_heightmap_weight_mountains);
-    const preview_key_multiply_heightmap_weight_mountains = "multiply_heightmap_weight_mountains.image";
-    ctx.previews.putAssumeCapacity(preview_key_multiply_heightmap_weight_mountains, .{ .data = preview_image_multiply_heightmap_weight_mountains.asBytes() });
+        node_cache.end(24, &cache_entries);
+    }
 
-    // Leaf node
+    tiled_image.park(f32, &heightmap_mountains, &heightmap_mountains_tiles);
+    tiled_image.release(f32, &weight_mountains, &weight_mountains_tiles);
 }
 
 pub fn remap_heightmap_mountains(ctx: *Context) void {
     std.log.info("Node: remap_heightmap_mountains [remap]", .{});
 
-    compute.remap(&heightmap_mountains, &scratch_image, 20, 1500);
+    tiled_image.acquire(f32, &heightmap_mountains, &heightmap_mountains_tiles, world_settings.size.width * world_settings.size.height);
+
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &heightmap_mountains),
+            node_cache.entry(f32, &scratch_image),
+        };
+        if (!node_cache.begin(23, &cache_entries)) {
+            break :cache;
+        }
 
-    types.saveImageF32(heightmap_mountains, "remap_heightmap_mountains", false);
-    types.image_preview_f32(heightmap_mountains, &preview_image_remap_heightmap_mountains);
-    const preview_key_remap_heightmap_mountains = "remap_heightmap_mountains.image";
-    ctx.previews.putAssumeCapacity(preview_key_remap_heightmap_mountains, .{ .data = preview_image_remap_heightmap_mountains.asBytes() });
+        compute.remap(&heightmap_mountains, &scratch_image, 20, 1500);
 
-    ctx.next_nodes.insert(0, multiply_heightmap_weight_mountains) catch unreachable;
+        types.saveImageF32(heightmap_mountains, "remap_heightmap_mountains", false);
+        types.image_preview_f32(heightmap_mountains, &preview_image_remap_heightmap_mountains);
+        const preview_key_remap_heightmap_mountains = "remap_heightmap_mountains.image";
+        ctx.putPreview(preview_key_remap_heightmap_mountains, .{ .data = preview_image_remap_heightmap_mountains.asBytes() });
+
+        node_cache.end(23, &cache_entries);
+    }
 }
 
 pub fn merge_heightmaps(ctx: *Context) void {
     std.log.info("Node: merge_heightmaps [math]", .{});
 
-    compute.math_add( &heightmap_water, &heightmap_plains, &heightmap, &scratch_image);
-    compute.math_add( &heightmap_hills, &heightmap, &heightmap, &scratch_image);
-    compute.math_add( &heightmap_mountains, &heightmap, &heightmap, &scratch_image);
+    tiled_image.acquire(f32, &heightmap, &heightmap_tiles, world_settings.size.width * world_settings.size.height);
+    tiled_image.toTiles(f32, &heightmap_water, &heightmap_water_tiles);
+    tiled_image.toTiles(f32, &heightmap_plains, &heightmap_plains_tiles);
+    tiled_image.toTiles(f32, &heightmap_hills, &heightmap_hills_tiles);
+    tiled_image.toTiles(f32, &heightmap_mountains, &heightmap_mountains_tiles);
+
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &heightmap),
+            node_cache.tiledEntry(f32, &heightmap_water, &heightmap_water_tiles),
+            node_cache.tiledEntry(f32, &heightmap_plains, &heightmap_plains_tiles),
+            node_cache.tiledEntry(f32, &heightmap_hills, &heightmap_hills_tiles),
+            node_cache.tiledEntry(f32, &heightmap_mountains, &heightmap_mountains_tiles),
+            node_cache.entry(f32, &scratch_image),
+        };
+        if (!node_cache.begin(25, &cache_entries)) {
+            break :cache;
+        }
+
+        compute.math_tiled(.add, &.{ &heightmap_water, &heightmap_plains, &heightmap_hills, &heightmap_mountains }, &.{ &heightmap_water_tiles, &heightmap_plains_tiles, &heightmap_hills_tiles, &heightmap_mountains_tiles }, &heightmap, &scratch_image, false);
+
+        types.saveImageF32(heightmap, "merge_heightmaps", false);
+        types.image_preview_f32(heightmap, &preview_image_merge_heightmaps);
+        const preview_key_merge_heightmaps = "merge_heightmaps.image";
+        ctx.putPreview(preview_key_merge_heightmaps, .{ .data = preview_image_merge_heightmaps.asBytes() });
 
-    types.saveImageF32(heightmap, "merge_heightmaps", false);
-    types.image_preview_f32(heightmap, &preview_image_merge_heightmaps);
-    const preview_key_merge_heightmaps = "merge_heightmaps.image";
-    ctx.previews.putAssumeCapacity(preview_key_merge_heightmaps, .{ .data = preview_image_merge_heightmaps.asBytes() });
+        node_cache.end(25, &cache_entries);
+    }
 
-    // Leaf node
+    tiled_image.release(f32, &heightmap_water, &heightmap_water_tiles);
+    tiled_image.release(f32, &heightmap_plains, &heightmap_plains_tiles);
+    tiled_image.release(f32, &heightmap_hills, &heightmap_hills_tiles);
+    tiled_image.release(f32, &heightmap_mountains, &heightmap_mountains_tiles);
+    tiled_image.park(f32, &scratch_image, &scratch_image_tiles);
 }
 
 pub fn generate_heightmap_gradient(ctx: *Context) void {
     std.log.info("Node: generate_heightmap_gradient [gradient]", .{});
 
-    nodes.gradient.gradient(heightmap, 1 / world_settings.terrain_height_max, &gradient_image);
+    tiled_image.acquire(f32, &gradient_image, &gradient_image_tiles, world_settings.size.width * world_settings.size.height);
+
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &heightmap),
+            node_cache.entry(f32, &gradient_image),
+        };
+        if (!node_cache.begin(26, &cache_entries)) {
+            break :cache;
+        }
 
-    types.saveImageF32(gradient_image, "generate_heightmap_gradient", false);
-    types.image_preview_f32(gradient_image, &preview_image_generate_heightmap_gradient);
-    const preview_key_generate_heightmap_gradient = "generate_heightmap_gradient.image";
-    ctx.previews.putAssumeCapacity(preview_key_generate_heightmap_gradient, .{ .data = preview_image_generate_heightmap_gradient.asBytes() });
+        nodes.gradient.gradient(heightmap, 1 / world_settings.terrain_height_max, &gradient_image);
 
-    // Leaf node
+        types.saveImageF32(gradient_image, "generate_heightmap_gradient", false);
+        types.image_preview_f32(gradient_image, &preview_image_generate_heightmap_gradient);
+        const preview_key_generate_heightmap_gradient = "generate_heightmap_gradient.image";
+        ctx.putPreview(preview_key_generate_heightmap_gradient, .{ .data = preview_image_generate_heightmap_gradient.asBytes() });
+
+        node_cache.end(26, &cache_entries);
+    }
 }
 
 pub fn generate_terrace(ctx: *Context) void {
     std.log.info("Node: generate_terrace [terrace]", .{});
 
-    heightmap2.copy(heightmap);
-    types.saveImageF32(gradient_image, "gradient_image_b4terrace", false);
-    types.saveImageF32(heightmap, "heightmap_b4terrace", false);
-    for (0..1) |_| {
+    tiled_image.acquire(f32, &heightmap2, &heightmap2_tiles, world_settings.size.width * world_settings.size.height);
+    tiled_image.acquire(f32, &scratch_image, &scratch_image_tiles, world_settings.size.width * world_settings.size.height);
+
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &heightmap),
+            node_cache.entry(f32, &heightmap2),
+            node_cache.entry(f32, &gradient_image),
+            node_cache.entry(f32, &scratch_image),
+        };
+        if (!node_cache.begin(27, &cache_entries)) {
+            break :cache;
+        }
+
+        heightmap2.copy(heightmap);
+        types.saveImageF32(gradient_image, "gradient_image_b4terrace", false);
+        types.saveImageF32(heightmap, "heightmap_b4terrace", false);
         for (0..1) |_| {
-            compute.terrace(&gradient_image, &heightmap, &scratch_image);
-            nodes.math.rerangify(&heightmap);
-            types.saveImageF32(heightmap, "heightmap", false);
+            for (0..1) |_| {
+                compute.terrace(&gradient_image, &heightmap, &scratch_image);
+                nodes.math.rerangify(&heightmap);
+                types.saveImageF32(heightmap, "heightmap", false);
+            }
         }
-    }
 
-    types.saveImageF32(heightmap, "generate_terrace", false);
-    types.image_preview_f32(heightmap, &preview_image_generate_terrace);
-    const preview_key_generate_terrace = "generate_terrace.image";
-    ctx.previews.putAssumeCapacity(preview_key_generate_terrace, .{ .data = preview_image_generate_terrace.asBytes() });
+        types.saveImageF32(heightmap, "generate_terrace", false);
+        types.image_preview_f32(heightmap, &preview_image_generate_terrace);
+        const preview_key_generate_terrace = "generate_terrace.image";
+        ctx.putPreview(preview_key_generate_terrace, .{ .data = preview_image_generate_terrace.asBytes() });
 
-    // Leaf node
+        node_cache.end(27, &cache_entries);
+    }
+
+    tiled_image.release(f32, &heightmap2, &heightmap2_tiles);
+    tiled_image.park(f32, &scratch_image, &scratch_image_tiles);
 }
 
 pub fn generate_heightmap_gradient2(ctx: *Context) void {
     std.log.info("Node: generate_heightmap_gradient2 [gradient]", .{});
 
-    nodes.gradient.gradient(heightmap, 1 / world_settings.terrain_height_max, &gradient_image);
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &heightmap),
+            node_cache.entry(f32, &gradient_image),
+        };
+        if (!node_cache.begin(28, &cache_entries)) {
+            break :cache;
+        }
+
+        nodes.gradient.gradient(heightmap, 1 / world_settings.terrain_height_max, &gradient_image);
+
+        types.saveImageF32(gradient_image, "generate_heightmap_gradient2", false);
+        types.image_preview_f32(gradient_image, &preview_image_generate_heightmap_gradient2);
+        const preview_key_generate_heightmap_gradient2 = "generate_heightmap_gradient2.image";
+        ctx.putPreview(preview_key_generate_heightmap_gradient2, .{ .data = preview_image_generate_heightmap_gradient2.asBytes() });
 
-    types.saveImageF32(gradient_image, "generate_heightmap_gradient2", false);
-    types.image_preview_f32(gradient_image, &preview_image_generate_heightmap_gradient2);
-    const preview_key_generate_heightmap_gradient2 = "generate_heightmap_gradient2.image";
-    ctx.previews.putAssumeCapacity(preview_key_generate_heightmap_gradient2, .{ .data = preview_image_generate_heightmap_gradient2.asBytes() });
+        node_cache.end(28, &cache_entries);
+    }
 
-    // Leaf node
+    tiled_image.park(f32, &heightmap, &heightmap_tiles);
+    tiled_image.park(f32, &gradient_image, &gradient_image_tiles);
 }
 
 pub fn output_cities(ctx: *Context) void {
     std.log.info("Node: output_cities [cities]", .{});
 
+    tiled_image.acquire(f32, &heightmap, &heightmap_tiles, world_settings.size.width * world_settings.size.height);
+    tiled_image.acquire(f32, &gradient_image, &gradient_image_tiles, world_settings.size.width * world_settings.size.height);
+
     if (!DRY_RUN) {
         const x = types.BackedListVec2.createFromImageVec2(&village_points, village_points_counter.pixels[0]);
         nodes.experiments.cities(world_settings, heightmap,gradient_image, &x, &cities);
     }
-
-    // Leaf node
     _ = ctx; // autofix
+
+    tiled_image.release(f32, &heightmap, &heightmap_tiles);
+    tiled_image.release(f32, &gradient_image, &gradient_image_tiles);
+    tiled_image.release([2]f32, &village_points, &village_points_tiles);
+    tiled_image.release(u32, &village_points_counter, &village_points_counter_tiles);
 }
 
 pub fn generate_trees_fbm(ctx: *Context) void {
     std.log.info("Node: generate_trees_fbm [fbm]", .{});
 
-    const generate_fbm_settings = compute.GenerateFBMSettings{
-        .width = @intCast(fbm_trees_image.size.width),
-        .height = @intCast(fbm_trees_image.size.height),
-        .seed = fbm_settings_trees.seed,
-        .frequency = fbm_settings_trees.frequency,
-        .octaves = fbm_settings_trees.octaves,
-        .scale = fbm_settings_trees.scale,
-        ._padding = .{ 0, 0 },
-    };
-
-    compute.fbm(&fbm_trees_image, generate_fbm_settings);
-    compute.min(&fbm_trees_image, &scratch_image);
-    compute.max(&fbm_trees_image, &scratch_image);
-    nodes.math.rerangify(&fbm_trees_image);
+    tiled_image.acquire(f32, &fbm_trees_image, &fbm_trees_image_tiles, world_settings.size.width * world_settings.size.height);
+    tiled_image.acquire(f32, &scratch_image, &scratch_image_tiles, world_settings.size.width * world_settings.size.height);
 
-    compute.remap(&fbm_trees_image, &scratch_image, 0, 1);
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &fbm_trees_image),
+            node_cache.entry(f32, &scratch_image),
+        };
+        if (!node_cache.begin(29, &cache_entries)) {
+            break :cache;
+        }
 
-    types.saveImageF32(fbm_trees_image, "generate_trees_fbm", false);
-    types.image_preview_f32(fbm_trees_image, &preview_image_generate_trees_fbm);
-    const preview_key_generate_trees_fbm = "generate_trees_fbm.image";
-    ctx.previews.putAssumeCapacity(preview_key_generate_trees_fbm, .{ .data = preview_image_generate_trees_fbm.asBytes() });
+        const generate_fbm_settings = compute.GenerateFBMSettings{
+            .width = @intCast(fbm_trees_image.size.width),
+            .height = @intCast(fbm_trees_image.size.height),
+            .seed = fbm_settings_trees.seed,
+            .frequency = fbm_settings_trees.frequency,
+            .octaves = fbm_settings_trees.octaves,
+            .scale = fbm_settings_trees.scale,
+            ._padding = .{ 0, 0 },
+        };
+
+        compute.fbm(&fbm_trees_image, generate_fbm_settings);
+        compute.min(&fbm_trees_image, &scratch_image);
+        compute.max(&fbm_trees_image, &scratch_image);
+        nodes.math.rerangify(&fbm_trees_image);
+
+        compute.remap(&fbm_trees_image, &scratch_image, 0, 1);
+
+        types.saveImageF32(fbm_trees_image, "generate_trees_fbm", false);
+        types.image_preview_f32(fbm_trees_image, &preview_image_generate_trees_fbm);
+        const preview_key_generate_trees_fbm = "generate_trees_fbm.image";
+        ctx.putPreview(preview_key_generate_trees_fbm, .{ .data = preview_image_generate_trees_fbm.asBytes() });
+
+        node_cache.end(29, &cache_entries);
+    }
 
-    ctx.next_nodes.insert(0, generate_trees_points) catch unreachable;
+    tiled_image.park(f32, &scratch_image, &scratch_image_tiles);
 }
 
 pub fn trees_square(ctx: *Context) void {
@@ -824,9 +1126,7 @@ pub fn trees_square(ctx: *Context) void {
     types.saveImageF32(fbm_trees_image, "trees_square", false);
     types.image_preview_f32(fbm_trees_image, &preview_image_trees_square);
     const preview_key_trees_square = "trees_square.image";
-    ctx.previews.putAssumeCapacity(preview_key_trees_square, .{ .data = preview_image_trees_square.asBytes() });
-
-    ctx.next_nodes.insert(0, generate_trees_points) catch unreachable;
+    ctx.putPreview(preview_key_trees_square, .{ .data = preview_image_trees_square.asBytes() });
 }
 
 pub fn generate_trees_points(ctx: *Context) void {
@@ -834,18 +1134,19 @@ pub fn generate_trees_points(ctx: *Context) void {
 
     trees_points = types.PatchDataPts2d.create(1, fbm_trees_image.size.width / 128, 100, std.heap.c_allocator);
     nodes.experiments.points_distribution_grid(fbm_trees_image, 0.5, .{ .cell_size = 16, .size = fbm_trees_image.size }, &trees_points);
+    _ = ctx; // autofix
 
-    ctx.next_nodes.insert(0, output_trees_to_file) catch unreachable;
+    tiled_image.release(f32, &fbm_trees_image, &fbm_trees_image_tiles);
 }
 
 pub fn output_trees_to_file(ctx: *Context) void {
     std.log.info("Node: output_trees_to_file [write_trees]", .{});
 
+    tiled_image.acquire(f32, &heightmap, &heightmap_tiles, world_settings.size.width * world_settings.size.height);
+
     if (!DRY_RUN) {
         nodes.experiments.write_trees(heightmap, trees_points);
     }
-
-    // Leaf node
     _ = ctx; // autofix
 }
 
@@ -855,111 +1156,250 @@ pub fn output_heightmap_to_file(ctx: *Context) void {
     if (!DRY_RUN) {
         nodes.heightmap_format.heightmap_format(world_settings, heightmap);
     }
-
-    // Leaf node
     _ = ctx; // autofix
+
+    tiled_image.park(f32, &heightmap, &heightmap_tiles);
 }
 
 pub fn remap_village_gradient(ctx: *Context) void {
     std.log.info("Node: remap_village_gradient [remap_curve]", .{});
 
-    const curve = [_]types.Vec2{
-        .{ .x = 0, .y = 1},
-        .{ .x = 0.0003, .y = 0},
-    };
-    compute.remapCurve(&gradient_image, &curve, &village_gradient);
+    tiled_image.acquire(f32, &gradient_image, &gradient_image_tiles, world_settings.size.width * world_settings.size.height);
+    tiled_image.acquire(f32, &village_gradient, &village_gradient_tiles, world_settings.size.width * world_settings.size.height);
 
-    types.saveImageF32(village_gradient, "remap_village_gradient", false);
-    types.image_preview_f32(village_gradient, &preview_image_remap_village_gradient);
-    const preview_key_remap_village_gradient = "remap_village_gradient.image";
-    ctx.previews.putAssumeCapacity(preview_key_remap_village_gradient, .{ .data = preview_image_remap_village_gradient.asBytes() });
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &gradient_image),
+            node_cache.entry(f32, &village_gradient),
+        };
+        if (!node_cache.begin(33, &cache_entries)) {
+            break :cache;
+        }
+
+        const curve = [_]types.Vec2{
+            .{ .x = 0, .y = 1},
+            .{ .x = 0.0003, .y = 0},
+        };
+        compute.remapCurve(&gradient_image, &curve, &village_gradient);
+
+        types.saveImageF32(village_gradient, "remap_village_gradient", false);
+        types.image_preview_f32(village_gradient, &preview_image_remap_village_gradient);
+        const preview_key_remap_village_gradient = "remap_village_gradient.image";
+        ctx.putPreview(preview_key_remap_village_gradient, .{ .data = preview_image_remap_village_gradient.asBytes() });
+
+        node_cache.end(33, &cache_entries);
+    }
 
-    ctx.next_nodes.insert(0, downsample_village_gradient) catch unreachable;
+    tiled_image.park(f32, &gradient_image, &gradient_image_tiles);
 }
 
 pub fn downsample_village_gradient(ctx: *Context) void {
     std.log.info("Node: downsample_village_gradient [downsample]", .{});
 
-    const orig_scratch_image_size = scratch_image.size;
-    compute.downsample(&village_gradient, &scratch_image, &village_gradient, .min);
-    compute.downsample(&village_gradient, &scratch_image, &village_gradient, .min);
-    compute.downsample(&village_gradient, &scratch_image, &village_gradient, .min);
-    compute.downsample(&village_gradient, &scratch_image, &village_gradient, .min);
-    scratch_image.size = orig_scratch_image_size;
+    tiled_image.acquire(f32, &scratch_image, &scratch_image_tiles, world_settings.size.width * world_settings.size.height);
 
-    types.saveImageF32(village_gradient, "downsample_village_gradient", false);
-    types.image_preview_f32(village_gradient, &preview_image_downsample_village_gradient);
-    const preview_key_downsample_village_gradient = "downsample_village_gradient.image";
-    ctx.previews.putAssumeCapacity(preview_key_downsample_village_gradient, .{ .data = preview_image_downsample_village_gradient.asBytes() });
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &scratch_image),
+            node_cache.entry(f32, &village_gradient),
+        };
+        if (!node_cache.begin(34, &cache_entries)) {
+            break :cache;
+        }
+
+        const orig_scratch_image_size = scratch_image.size;
+        compute.downsample(&village_gradient, &scratch_image, &village_gradient, .min);
+        compute.downsample(&village_gradient, &scratch_image, &village_gradient, .min);
+        compute.downsample(&village_gradient, &scratch_image, &village_gradient, .min);
+        compute.downsample(&village_gradient, &scratch_image, &village_gradient, .min);
+        scratch_image.size = orig_scratch_image_size;
+
+        types.saveImageF32(village_gradient, "downsample_village_gradient", false);
+        types.image_preview_f32(village_gradient, &preview_image_downsample_village_gradient);
+        const preview_key_downsample_village_gradient = "downsample_village_gradient.image";
+        ctx.putPreview(preview_key_downsample_village_gradient, .{ .data = preview_image_downsample_village_gradient.asBytes() });
 
-    ctx.next_nodes.insert(0, upsample_village_gradient) catch unreachable;
+        node_cache.end(34, &cache_entries);
+    }
 }
 
 pub fn upsample_village_gradient(ctx: *Context) void {
     std.log.info("Node: upsample_village_gradient [upsample]", .{});
 
-    const orig_scratch_image_size = scratch_image.size;
-    compute.upsample(&village_gradient, &scratch_image, &village_gradient, .first);
-    compute.upsample(&village_gradient, &scratch_image, &village_gradient, .first);
-    compute.upsample(&village_gradient, &scratch_image, &village_gradient, .first);
-    compute.upsample(&village_gradient, &scratch_image, &village_gradient, .first);
-    scratch_image.size = orig_scratch_image_size;
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &scratch_image),
+            node_cache.entry(f32, &village_gradient),
+        };
+        if (!node_cache.begin(35, &cache_entries)) {
+            break :cache;
+        }
+
+        const orig_scratch_image_size = scratch_image.size;
+        compute.upsample(&village_gradient, &scratch_image, &village_gradient, .first);
+        compute.upsample(&village_gradient, &scratch_image, &village_gradient, .first);
+        compute.upsample(&village_gradient, &scratch_image, &village_gradient, .first);
+        compute.upsample(&village_gradient, &scratch_image, &village_gradient, .first);
+        scratch_image.size = orig_scratch_image_size;
 
-    types.saveImageF32(village_gradient, "upsample_village_gradient", false);
-    types.image_preview_f32(village_gradient, &preview_image_upsample_village_gradient);
-    const preview_key_upsample_village_gradient = "upsample_village_gradient.image";
-    ctx.previews.putAssumeCapacity(preview_key_upsample_village_gradient, .{ .data = preview_image_upsample_village_gradient.asBytes() });
+        types.saveImageF32(village_gradient, "upsample_village_gradient", false);
+        types.image_preview_f32(village_gradient, &preview_image_upsample_village_gradient);
+        const preview_key_upsample_village_gradient = "upsample_village_gradient.image";
+        ctx.putPreview(preview_key_upsample_village_gradient, .{ .data = preview_image_upsample_village_gradient.asBytes() });
 
-    ctx.next_nodes.insert(0, multiply_village_gradient_plains) catch unreachable;
+        node_cache.end(35, &cache_entries);
+    }
 }
 
 pub fn multiply_village_gradient_plains(ctx: *Context) void {
     std.log.info("Node: multiply_village_gradient_plains [math]", .{});
 
-    compute.math_multiply( &village_gradient, &weight_plains, &village_gradient, &scratch_image);
+    tiled_image.toTiles(f32, &weight_plains, &weight_plains_tiles);
+
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.tiledEntry(f32, &weight_plains, &weight_plains_tiles),
+            node_cache.entry(f32, &scratch_image),
+            node_cache.entry(f32, &village_gradient),
+        };
+        if (!node_cache.begin(36, &cache_entries)) {
+            break :cache;
+        }
+
+        compute.math_tiled(.multiply, &.{&weight_plains}, &.{&weight_plains_tiles}, &village_gradient, &scratch_image, true);
 
-    types.saveImageF32(village_gradient, "multiply_village_gradient_plains", false);
-    types.image_preview_f32(village_gradient, &preview_image_multiply_village_gradient_plains);
-    const preview_key_multiply_village_gradient_plains = "multiply_village_gradient_plains.image";
-    ctx.previews.putAssumeCapacity(preview_key_multiply_village_gradient_plains, .{ .data = preview_image_multiply_village_gradient_plains.asBytes() });
+        types.saveImageF32(village_gradient, "multiply_village_gradient_plains", false);
+        types.image_preview_f32(village_gradient, &preview_image_multiply_village_gradient_plains);
+        const preview_key_multiply_village_gradient_plains = "multiply_village_gradient_plains.image";
+        ctx.putPreview(preview_key_multiply_village_gradient_plains, .{ .data = preview_image_multiply_village_gradient_plains.asBytes() });
 
-    ctx.next_nodes.insert(0, multiply_village_gradient_shore) catch unreachable;
+        node_cache.end(36, &cache_entries);
+    }
+
+    tiled_image.release(f32, &weight_plains, &weight_plains_tiles);
 }
 
 pub fn multiply_village_gradient_shore(ctx: *Context) void {
     std.log.info("Node: multiply_village_gradient_shore [math]", .{});
 
-    compute.math_multiply( &village_gradient, &weight_shore, &village_gradient, &scratch_image);
+    tiled_image.toTiles(f32, &weight_shore, &weight_shore_tiles);
+
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.tiledEntry(f32, &weight_shore, &weight_shore_tiles),
+            node_cache.entry(f32, &scratch_image),
+            node_cache.entry(f32, &village_gradient),
+        };
+        if (!node_cache.begin(37, &cache_entries)) {
+            break :cache;
+        }
 
-    types.saveImageF32(village_gradient, "multiply_village_gradient_shore", false);
-    types.image_preview_f32(village_gradient, &preview_image_multiply_village_gradient_shore);
-    const preview_key_multiply_village_gradient_shore = "multiply_village_gradient_shore.image";
-    ctx.previews.putAssumeCapacity(preview_key_multiply_village_gradient_shore, .{ .data = preview_image_multiply_village_gradient_shore.asBytes() });
+        compute.math_tiled(.multiply, &.{&weight_shore}, &.{&weight_shore_tiles}, &village_gradient, &scratch_image, true);
 
-    ctx.next_nodes.insert(0, village_output_points) catch unreachable;
+        types.saveImageF32(village_gradient, "multiply_village_gradient_shore", false);
+        types.image_preview_f32(village_gradient, &preview_image_multiply_village_gradient_shore);
+        const preview_key_multiply_village_gradient_shore = "multiply_village_gradient_shore.image";
+        ctx.putPreview(preview_key_multiply_village_gradient_shore, .{ .data = preview_image_multiply_village_gradient_shore.asBytes() });
+
+        node_cache.end(37, &cache_entries);
+    }
+
+    tiled_image.release(f32, &weight_shore, &weight_shore_tiles);
+    tiled_image.release(f32, &scratch_image, &scratch_image_tiles);
 }
 
 pub fn village_output_points(ctx: *Context) void {
     std.log.info("Node: village_output_points [gather_points]", .{});
 
-    compute.gatherPoints(&village_gradient, world_settings.size.width, world_settings.size.height, 0.01, &village_points, &village_points_counter);
-    std.log.info("LOL count:{d}", .{village_points_counter.pixels[0]});
-    std.log.info("LOL pt:{d},{d}", .{ village_points.pixels[0][0], village_points.pixels[0][1] } );
-    std.log.info("LOL pt:{d:.3},{d:.3}", .{ village_points.pixels[0][0], village_points.pixels[0][1] } );
+    tiled_image.acquire([2]f32, &village_points, &village_points_tiles, world_settings.size.width * world_settings.size.height);
+    tiled_image.acquire(u32, &village_points_counter, &village_points_counter_tiles, world_settings.size.width * world_settings.size.height);
+
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry(f32, &village_gradient),
+            node_cache.entry([2]f32, &village_points),
+            node_cache.entry(u32, &village_points_counter),
+        };
+        if (!node_cache.begin(38, &cache_entries)) {
+            break :cache;
+        }
+
+        compute.gatherPoints(&village_gradient, world_settings.size.width, world_settings.size.height, 0.01, &village_points, &village_points_counter);
+        std.log.info("LOL count:{d}", .{village_points_counter.pixels[0]});
+        std.log.info("LOL pt:{d},{d}", .{ village_points.pixels[0][0], village_points.pixels[0][1] } );
+        std.log.info("LOL pt:{d:.3},{d:.3}", .{ village_points.pixels[0][0], village_points.pixels[0][1] } );
+        _ = ctx; // autofix
+
+        node_cache.end(38, &cache_entries);
+    }
 
-    ctx.next_nodes.insert(0, village_points_filter_proximity) catch unreachable;
+    tiled_image.release(f32, &village_gradient, &village_gradient_tiles);
 }
 
 pub fn village_points_filter_proximity(ctx: *Context) void {
     std.log.info("Node: village_points_filter_proximity [points_filter_proximity]", .{});
 
-    var x = types.BackedListVec2.createFromImageVec2(&village_points, village_points_counter.pixels[0]);
-    std.log.info("points_filter_proximity count:{d}", .{x.count} );
-    nodes.points.points_filter_proximity_vec2(&x, &x, 7000);
-    village_points_counter.pixels[0] = x.count;
-    std.log.info("points_filter_proximity count:{d}", .{x.count} );
+    cache: {
+        const cache_entries = [_]node_cache.Entry{
+            node_cache.entry([2]f32, &village_points),
+            node_cache.entry(u32, &village_points_counter),
+        };
+        if (!node_cache.begin(39, &cache_entries)) {
+            break :cache;
+        }
 
-    // Leaf node
-    _ = ctx; // autofix
+        var x = types.BackedListVec2.createFromImageVec2(&village_points, village_points_counter.pixels[0]);
+        std.log.info("points_filter_proximity count:{d}", .{x.count} );
+        nodes.points.points_filter_proximity_vec2(&x, &x, 7000);
+        village_points_counter.pixels[0] = x.count;
+        std.log.info("points_filter_proximity count:{d}", .{x.count} );
+        _ = ctx; // autofix
+
+        node_cache.end(39, &cache_entries);
+    }
 }
 
+// ============ DAG ============
+pub const dag = [_]graph.DagNode{
+    .{ .name = "start", .function = start, .dependencies = &.{}, .cache_key = 0x0a2bc507bccabe5c, .cacheable = false },
+    .{ .name = "main", .function = main, .dependencies = &.{ 0 }, .cache_key = 0x0584052f7030f0f1, .cacheable = false },
+    .{ .name = "main_generate_voronoi", .function = main_generate_voronoi, .dependencies = &.{ 0 }, .cache_key = 0x0584052f7030f0f1, .cacheable = false },
+    .{ .name = "generate_poisson_for_voronoi", .function = generate_poisson_for_voronoi, .dependencies = &.{ 0 }, .cache_key = 0xd1df5b0daf43105d, .cacheable = false },
+    .{ .name = "generate_voronoi_map", .function = generate_voronoi_map, .dependencies = &.{ 0, 3 }, .cache_key = 0xe7957d14b687a7e5, .cacheable = false },
+    .{ .name = "generate_landscape_from_image", .function = generate_landscape_from_image, .dependencies = &.{ 4 }, .cache_key = 0xce1799da48e0e949, .cacheable = false },
+    .{ .name = "generate_image_from_voronoi", .function = generate_image_from_voronoi, .dependencies = &.{ 5 }, .cache_key = 0xf3f76d75d36f15ff, .cacheable = false },
+    .{ .name = "main_generate_heightmap", .function = main_generate_heightmap, .dependencies = &.{ 0 }, .cache_key = 0x0584052f7030f0f1, .cacheable = false },
+    .{ .name = "generate_heightmap_water", .function = generate_heightmap_water, .dependencies = &.{ 0 }, .cache_key = 0x069ea014eca17a56, .cacheable = true },
+    .{ .name = "generate_heightmap_plains", .function = generate_heightmap_plains, .dependencies = &.{ 8 }, .cache_key = 0x7976b179b689af91, .cacheable = true },
+    .{ .name = "generate_voronoi_weight_plains", .function = generate_voronoi_weight_plains, .dependencies = &.{ 6 }, .cache_key = 0x1a3166b70cdc9f23, .cacheable = true },
+    .{ .name = "blur_weight_plains", .function = blur_weight_plains, .dependencies = &.{ 9, 10 }, .cache_key = 0x64a61ff44129a2e7, .cacheable = true },
+    .{ .name = "remap_heightmap_plains", .function = remap_heightmap_plains, .dependencies = &.{ 9, 11 }, .cache_key = 0x76319064a4770017, .cacheable = true },
+    .{ .name = "multiply_heightmap_weight_plains", .function = multiply_heightmap_weight_plains, .dependencies = &.{ 11, 12 }, .cache_key = 0x7b4c667cdfc01781, .cacheable = true },
+    .{ .name = "generate_voronoi_weight_shore", .function = generate_voronoi_weight_shore, .dependencies = &.{ 10 }, .cache_key = 0x72eb9824e6e76058, .cacheable = true },
+    .{ .name = "generate_heightmap_hills", .function = generate_heightmap_hills, .dependencies = &.{ 13 }, .cache_key = 0x3ae54092fa55b179, .cacheable = true },
+    .{ .name = "generate_voronoi_weight_hills", .function = generate_voronoi_weight_hills, .dependencies = &.{ 14 }, .cache_key = 0xcbbff9da2356440d, .cacheable = true },
+    .{ .name = "blur_weight_hills", .function = blur_weight_hills, .dependencies = &.{ 15, 16 }, .cache_key = 0xacf152a5dc6c1e37, .cacheable = true },
+    .{ .name = "remap_heightmap_hills", .function = remap_heightmap_hills, .dependencies = &.{ 15, 17 }, .cache_key = 0x043aaf64c3873ed2, .cacheable = true },
+    .{ .name = "multiply_heightmap_weight_hills", .function = multiply_heightmap_weight_hills, .dependencies = &.{ 17, 18 }, .cache_key = 0x9f6db0afab6c2b9e, .cacheable = true },
+    .{ .name = "generate_heightmap_mountains", .function = generate_heightmap_mountains, .dependencies = &.{ 19 }, .cache_key = 0x8ec7f087536ffa97, .cacheable = true },
+    .{ .name = "generate_voronoi_weight_mountains", .function = generate_voronoi_weight_mountains, .dependencies = &.{ 16 }, .cache_key = 0xc9589cce2254efc6, .cacheable = true },
+    .{ .name = "blur_weight_mountains", .function = blur_weight_mountains, .dependencies = &.{ 20, 21 }, .cache_key = 0x2fa3b2fc062e5bb7, .cacheable = true },
+    .{ .name = "remap_heightmap_mountains", .function = remap_heightmap_mountains, .dependencies = &.{ 20, 22 }, .cache_key = 0x9f34b8ad9aad85cc, .cacheable = true },
+    .{ .name = "multiply_heightmap_weight_mountains", .function = multiply_heightmap_weight_mountains, .dependencies = &.{ 22, 23 }, .cache_key = 0x9f488d2d70ae5f6d, .cacheable = true },
+    .{ .name = "merge_heightmaps", .function = merge_heightmaps, .dependencies = &.{ 8, 13, 19, 24 }, .cache_key = 0x43ae3099df1911bc, .cacheable = true },
+    .{ .name = "generate_heightmap_gradient", .function = generate_heightmap_gradient, .dependencies = &.{ 25 }, .cache_key = 0x32f1938f6cbbc566, .cacheable = true },
+    .{ .name = "generate_terrace", .function = generate_terrace, .dependencies = &.{ 25, 26 }, .cache_key = 0x0cfe306b44ffac75, .cacheable = true },
+    .{ .name = "generate_heightmap_gradient2", .function = generate_heightmap_gradient2, .dependencies = &.{ 27 }, .cache_key = 0xe74919f45abb3035, .cacheable = true },
+    .{ .name = "generate_trees_fbm", .function = generate_trees_fbm, .dependencies = &.{ 27 }, .cache_key = 0xa921fda995c85007, .cacheable = true },
+    .{ .name = "generate_trees_points", .function = generate_trees_points, .dependencies = &.{ 29 }, .cache_key = 0x594adb78669f1ad0, .cacheable = false },
+    .{ .name = "output_trees_to_file", .function = output_trees_to_file, .dependencies = &.{ 28, 30 }, .cache_key = 0x64063122974a97c6, .cacheable = false },
+    .{ .name = "output_heightmap_to_file", .function = output_heightmap_to_file, .dependencies = &.{ 31 }, .cache_key = 0x0f5e3ba8a4b4c1c9, .cacheable = false },
+    .{ .name = "remap_village_gradient", .function = remap_village_gradient, .dependencies = &.{ 28 }, .cache_key = 0xf8728877f91414a7, .cacheable = true },
+    .{ .name = "downsample_village_gradient", .function = downsample_village_gradient, .dependencies = &.{ 29, 33 }, .cache_key = 0x4c47e621691f7e0e, .cacheable = true },
+    .{ .name = "upsample_village_gradient", .function = upsample_village_gradient, .dependencies = &.{ 34 }, .cache_key = 0x11ce3383e7bc8f88, .cacheable = true },
+    .{ .name = "multiply_village_gradient_plains", .function = multiply_village_gradient_plains, .dependencies = &.{ 13, 35 }, .cache_key = 0x6e7f62595752a7d3, .cacheable = true },
+    .{ .name = "multiply_village_gradient_shore", .function = multiply_village_gradient_shore, .dependencies = &.{ 14, 36 }, .cache_key = 0x5536130ebf44ca9b, .cacheable = true },
+    .{ .name = "village_output_points", .function = village_output_points, .dependencies = &.{ 37 }, .cache_key = 0x52a3e8e288840093, .cacheable = true },
+    .{ .name = "village_points_filter_proximity", .function = village_points_filter_proximity, .dependencies = &.{ 38 }, .cache_key = 0x462e5a68cc06bc2b, .cacheable = true },
+    .{ .name = "output_cities", .function = output_cities, .dependencies = &.{ 0, 32, 33, 39 }, .cache_key = 0x08528c26090623dc, .cacheable = false },
+};
@@ -0,0 +1,323 @@
+const std = @import("std");
+const builtin = @import("builtin");
+
+const graph = @import("graph.zig");
+const tiled_image = @import("tiled_image.zig");
+const types = @import("types.zig");
+
+// On-disk cache of node outputs. Once a cacheable node ran, the images it touched are written
+// under its cache key and the next simulation restores them instead of running it. Keys chain
+// through the DAG so tweaking a node only dirties it and the nodes depending on it.
+//
+// NOTE: The generated keys only hash the graph. The node implementations are covered by mixing a
+// hash of the simulator's binaries into every key, so a rebuild with changes misses the cache.
+
+pub const Action = enum {
+    run,
+    restore,
+    skip, // Cached and nothing that runs reads its images
+};
+
+// Type erased image for saving and loading.
+pub const Entry = struct {
+    image: *anyopaque,
+    tiles: ?*anyopaque = null, // For images the node reads parked in tiles
+    save: *const fn (cache_entry: Entry, file: std.fs.File) void,
+    load: *const fn (cache_entry: Entry, file: std.fs.File) void,
+};
+
+const EntryHeader = extern struct {
+    width: u64,
+    height: u64,
+    height_min: f32,
+    height_max: f32,
+};
+
+pub fn entry(comptime T: type, image: *types.Image(T)) Entry {
+    const Image = types.Image(T);
+    const Functions = struct {
+        fn save(cache_entry: Entry, file: std.fs.File) void {
+            const self: *Image = @ptrCast(@alignCast(cache_entry.image));
+            saveHeader(T, self, file);
+            file.writeAll(std.mem.sliceAsBytes(self.pixels[0..self.size.area()])) catch unreachable;
+        }
+
+        fn load(cache_entry: Entry, file: std.fs.File) void {
+            const self: *Image = @ptrCast(@alignCast(cache_entry.image));
+            loadHeader(T, self, file);
+            readAll(file, std.mem.sliceAsBytes(self.pixels[0..self.size.area()]));
+        }
+    };
+    return .{ .image = image, .save = Functions.save, .load = Functions.load };
+}
+
+// An image the node reads parked in tiles, saved tile by tile with a flag for the stored ones.
+pub fn tiledEntry(comptime T: type, image: *types.Image(T), tiles: *tiled_image.TiledImage(T)) Entry {
+    const Image = types.Image(T);
+    const Tiles = tiled_image.TiledImage(T);
+    const Functions = struct {
+        fn save(cache_entry: Entry, file: std.fs.File) void {
+            const self: *Image = @ptrCast(@alignCast(cache_entry.image));
+            const self_tiles: *Tiles = @ptrCast(@alignCast(cache_entry.tiles.?));
+            saveHeader(T, self, file);
+            for (0..self_tiles.tiles_y) |tile_y| {
+                for (0..self_tiles.tiles_x) |tile_x| {
+                    const stored = self_tiles.isStored(tile_x, tile_y);
+                    const stored_flag = [1]u8{@intFromBool(stored)};
+                    file.writeAll(&stored_flag) catch unreachable;
+                    if (!stored) {
+                        continue;
+                    }
+                    const view = self_tiles.acquireTile(tile_x, tile_y);
+                    defer self_tiles.releaseTile(view, false);
+                    for (0..view.rect.size().height) |y| {
+                        file.writeAll(std.mem.sliceAsBytes(view.row(y))) catch unreachable;
+                    }
+                }
+            }
+        }
+
+        fn load(cache_entry: Entry, file: std.fs.File) void {
+            const self: *Image = @ptrCast(@alignCast(cache_entry.image));
+            const self_tiles: *Tiles = @ptrCast(@alignCast(cache_entry.tiles.?));
+            loadHeader(T, self, file);
+            if (self_tiles.tiles != null) {
+                self_tiles.deinit();
+            }
+            self_tiles.init(tiled_image.cache.?, self.size);
+            for (0..self_tiles.tiles_y) |tile_y| {
+                for (0..self_tiles.tiles_x) |tile_x| {
+                    var stored: [1]u8 = undefined;
+                    readAll(file, &stored);
+                    if (stored[0] == 0) {
+                        continue;
+                    }
+                    const view = self_tiles.acquireTile(tile_x, tile_y);
+                    defer self_tiles.releaseTile(view, true);
+                    for (0..view.rect.size().height) |y| {
+                        readAll(file, std.mem.sliceAsBytes(view.row(y)));
+                    }
+                }
+            }
+        }
+    };
+    return .{ .image = image, .tiles = tiles, .save = Functions.save, .load = Functions.load };
+}
+
+fn saveHeader(comptime T: type, image: *const types.Image(T), file: std.fs.File) void {
+    const header = EntryHeader{
+        .width = image.size.width,
+        .height = image.size.height,
+        .height_min = image.height_min,
+        .height_max = image.height_max,
+    };
+    file.writeAll(std.mem.asBytes(&header)) catch unreachable;
+}
+
+fn loadHeader(comptime T: type, image: *types.Image(T), file: std.fs.File) void {
+    var header: EntryHeader = undefined;
+    readAll(file, std.mem.asBytes(&header));
+    image.size = .{ .width = header.width, .height = header.height };
+    image.height_min = header.height_min;
+    image.height_max = header.height_max;
+}
+
+fn readAll(file: std.fs.File, bytes: []u8) void {
+    const read = file.readAll(bytes) catch unreachable;
+    std.debug.assert(read == bytes.len);
+}
+
+// Loaded next to the executable, the compute shaders live in ui.dll.
+const build_libraries = [_][]const u8{
+    "ui.dll",
+    if (builtin.os.tag == .windows) "CppNodes.dll" else "libCppNodes.so",
+};
+
+var cache_dir: ?std.fs.Dir = null;
+var actions: std.ArrayList(Action) = undefined;
+var keys: std.ArrayList(u64) = undefined;
+var build_hash: u64 = 0;
+
+// Without a path every node runs.
+pub fn init(allocator: std.mem.Allocator, path: ?[]const u8) void {
+    actions = std.ArrayList(Action).init(allocator);
+    keys = std.ArrayList(u64).init(allocator);
+    if (path) |dir_path| {
+        std.fs.cwd().makePath(dir_path) catch unreachable;
+        cache_dir = std.fs.cwd().openDir(dir_path, .{}) catch unreachable;
+        build_hash = buildHash(allocator);
+    }
+}
+
+pub fn deinit() void {
+    if (cache_dir) |*dir| {
+        dir.close();
+    }
+    cache_dir = null;
+    actions.deinit();
+    keys.deinit();
+}
+
+// Hashes the executable and the libraries next to it that exist.
+fn buildHash(allocator: std.mem.Allocator) u64 {
+    var hasher = std.hash.Wyhash.init(0);
+    const exe_path = std.fs.selfExePathAlloc(allocator) catch unreachable;
+    defer allocator.free(exe_path);
+    hashFile(&hasher, exe_path);
+
+    const exe_dir = std.fs.path.dirname(exe_path).?;
+    for (build_libraries) |library| {
+        const library_path = std.fs.path.join(allocator, &.{ exe_dir, library }) catch unreachable;
+        defer allocator.free(library_path);
+        hashFile(&hasher, library_path);
+    }
+    return hasher.final();
+}
+
+fn hashFile(hasher: *std.hash.Wyhash, path: []const u8) void {
+    const file = std.fs.openFileAbsolute(path, .{}) catch return;
+    defer file.close();
+    var buf: [64 * 1024]u8 = undefined;
+    while (true) {
+        const read = file.read(&buf) catch unreachable;
+        if (read == 0) {
+            break;
+        }
+        hasher.update(buf[0..read]);
+    }
+}
+
+fn fileName(buf: []u8, key: u64, extension: []const u8) []const u8 {
+    return std.fmt.bufPrint(buf, "{x:0>16}.{s}", .{ key, extension }) catch unreachable;
+}
+
+// Decides what each node of dag does in the coming simulation. A cached node is only restored
+// when a node that runs depends on it, the others are skipped.
+pub fn plan(dag: []const graph.DagNode) void {
+    actions.resize(dag.len) catch unreachable;
+    keys.resize(dag.len) catch unreachable;
+    for (dag, actions.items, keys.items) |node, *action, *key| {
+        key.* = std.hash.Wyhash.hash(build_hash, std.mem.asBytes(&node.cache_key));
+        action.* = .run;
+        if (cache_dir != null and node.cacheable) {
+            var buf: [32]u8 = undefined;
+            if (cache_dir.?.access(fileName(&buf, key.*, "node"), .{})) |_| {
+                action.* = .skip;
+            } else |_| {}
+        }
+    }
+
+    for (dag, actions.items) |node, action| {
+        if (action != .run) {
+            continue;
+        }
+        for (node.dependencies) |i_dependency| {
+            if (actions.items[i_dependency] == .skip) {
+                actions.items[i_dependency] = .restore;
+            }
+        }
+    }
+
+    var counts = std.EnumArray(Action, usize).initFill(0);
+    for (actions.items) |action| {
+        counts.getPtr(action).* += 1;
+    }
+    std.log.info("Node cache: {d} to run, {d} to restore, {d} skipped", .{
+        counts.get(.run),
+        counts.get(.restore),
+        counts.get(.skip),
+    });
+}
+
+pub fn action(node_index: usize) Action {
+    return actions.items[node_index];
+}
+
+// Called by cacheable nodes before their body, which only runs when this returns true.
+pub fn begin(node_index: usize, entries: []const Entry) bool {
+    switch (actions.items[node_index]) {
+        .run => return true,
+        .skip => return false,
+        .restore => {
+            var buf: [32]u8 = undefined;
+            const file = cache_dir.?.openFile(fileName(&buf, keys.items[node_index], "node"), .{}) catch unreachable;
+            defer file.close();
+            for (entries) |cache_entry| {
+                cache_entry.load(cache_entry, file);
+            }
+            return false;
+        },
+    }
+}
+
+// Called by cacheable nodes after their body ran.
+pub fn end(node_index: usize, entries: []const Entry) void {
+    const dir = cache_dir orelse return;
+
+    // NOTE: Written aside and renamed so an interrupted run never leaves a truncated entry
+    var buf_tmp: [32]u8 = undefined;
+    var buf: [32]u8 = undefined;
+    const name_tmp = fileName(&buf_tmp, keys.items[node_index], "tmp");
+    const file = dir.createFile(name_tmp, .{}) catch unreachable;
+    for (entries) |cache_entry| {
+        cache_entry.save(cache_entry, file);
+    }
+    file.close();
+    dir.rename(name_tmp, fileName(&buf, keys.items[node_index], "node")) catch unreachable;
+}
+
+fn testNode(context: *graph.Context) void {
+    _ = context;
+}
+
+test "node_cache plan and restore" {
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const dir_path = try tmp.dir.realpathAlloc(std.testing.allocator, ".");
+    defer std.testing.allocator.free(dir_path);
+    init(std.testing.allocator, dir_path);
+    defer deinit();
+
+    const dag = [_]graph.DagNode{
+        .{ .name = "start", .function = testNode, .dependencies = &.{}, .cache_key = 1, .cacheable = false },
+        .{ .name = "a", .function = testNode, .dependencies = &.{0}, .cache_key = 2, .cacheable = true },
+        .{ .name = "b", .function = testNode, .dependencies = &.{1}, .cache_key = 3, .cacheable = true },
+        .{ .name = "c", .function = testNode, .dependencies = &.{2}, .cache_key = 4, .cacheable = false },
+    };
+
+    plan(&dag);
+    for (0..dag.len) |i_node| {
+        try std.testing.expectEqual(Action.run, action(i_node));
+    }
+
+    var pixels = [_]f32{ 1, 2, 3, 4 };
+    var image = types.ImageF32{ .size = .{ .width = 2, .height = 2 }, .height_min = 1, .height_max = 4, .pixels = &pixels };
+    const entries = [_]Entry{entry(f32, &image)};
+    for (1..3) |i_node| {
+        try std.testing.expect(begin(i_node, &entries));
+        end(i_node, &entries);
+    }
+
+    // Only the cached node that a running node depends on is read back.
+    plan(&dag);
+    try std.testing.expectEqual(Action.run, action(0));
+    try std.testing.expectEqual(Action.skip, action(1));
+    try std.testing.expectEqual(Action.restore, action(2));
+    try std.testing.expectEqual(Action.run, action(3));
+
+    @memset(&pixels, 0);
+    image.height_min = 0;
+    image.height_max = 1;
+    try std.testing.expect(!begin(1, &entries));
+    try std.testing.expect(!begin(2, &entries));
+    try std.testing.expectEqualSlices(f32, &.{ 1, 2, 3, 4 }, &pixels);
+    try std.testing.expectEqual(@as(f32, 1), image.height_min);
+    try std.testing.expectEqual(@as(f32, 4), image.height_max);
+
+    // Another build never restores what this one stored.
+    build_hash +%= 1;
+    plan(&dag);
+    for (0..dag.len) |i_node| {
+        try std.testing.expectEqual(Action.run, action(i_node));
+    }
+}
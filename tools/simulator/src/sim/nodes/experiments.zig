@@ -5,6 +5,9 @@ const grid = @import("../grid.zig");
 const zm = @import("zmath");
 const znoise = @import("znoise");
 const nodes = @import("nodes.zig");
+const pathfinding = @import("pathfinding.zig");
+const patch_archive = @import("patch_archive");
+const props_format = @import("props_format");
 
 const io = @import("../io.zig");
 const loadFile = io.loadFile;
@@ -81,168 +84,13 @@ pub fn writeVillageScript(props: *std.ArrayList(Prop), name: []const u8, rand: *
     _ = file.writeAll(output_file_data.items) catch unreachable;
 }
 
-const PathResult = struct {
-    pos: [2]f32,
-};
-
-const PathNode = struct {
-    pos: [2]f32,
-    angle: f32,
-    pub fn hash(self: PathNode) u64 {
-        const grid_size = 16;
-        const pos_x: u64 = @intFromFloat(self.pos[0] / grid_size);
-        const pos_z: u64 = @intFromFloat(self.pos[1] / grid_size);
-        const angle_to_segment: f32 = (1.0 / math.tau) * 8.0;
-        var self_angle_positive = self.angle;
-        while (self_angle_positive < 0) {
-            self_angle_positive += math.tau;
-        }
-        const angle: u64 = @intFromFloat(self_angle_positive * angle_to_segment);
-        return pos_x + pos_z * (16000 / grid_size) + angle * 10_000_000;
-    }
-    pub fn distManhattan(self: PathNode, pos: [2]f32) f32 {
-        return @abs(self.pos[0] - pos[0]) + @abs(self.pos[1] - pos[1]);
-    }
-    pub fn dist(self: PathNode, pos: [2]f32) f32 {
-        const x = self.pos[0] - pos[0];
-        const z = self.pos[1] - pos[1];
-        return @sqrt(x * x + z * z);
-    }
-};
-
-const AStarContext = struct {
-    allocator: std.mem.Allocator,
-    path: *std.ArrayList(PathNode),
-    heightmap: types.ImageF32,
-    gradient: types.ImageF32,
-};
-
-fn pathCostHeuristic(pos: [2]f32, target: [2]f32) f32 {
-    const x = pos[0] - target[0];
-    const z = pos[1] - target[1];
-    return @sqrt(x * x + z * z);
-}
-
-var lol: i32 = 0;
-var avg_dist: f32 = 0;
-
-fn doAStar(start: PathNode, target: PathNode, ctx: AStarContext) void {
-    var all_nodes = std.ArrayListUnmanaged(PathNode).initCapacity(ctx.allocator, 1024 * 1024 * 64) catch unreachable;
-    var came_from = std.ArrayListUnmanaged(u32).initCapacity(ctx.allocator, 1024 * 1024 * 64) catch unreachable;
-    came_from.appendNTimesAssumeCapacity(math.maxInt(u32), came_from.capacity);
-
-    var hash_to_index: std.AutoHashMapUnmanaged(u64, u32) = .empty;
-    defer hash_to_index.deinit(ctx.allocator);
-    hash_to_index.ensureTotalCapacity(ctx.allocator, 1024 * 1024 * 64) catch unreachable;
-
-    // gScore
-    var known_costs = std.ArrayListUnmanaged(f32).initCapacity(ctx.allocator, 1024 * 1024 * 64) catch unreachable;
-    known_costs.appendNTimesAssumeCapacity(math.floatMax(f32), known_costs.capacity);
-    // fScore
-    var open_costs = std.ArrayListUnmanaged(f32).initCapacity(ctx.allocator, 1024 * 1024 * 64) catch unreachable;
-    open_costs.appendNTimesAssumeCapacity(math.floatMax(f32), open_costs.capacity);
-
-    var open_set = std.ArrayListUnmanaged(u32).initCapacity(ctx.allocator, 1024 * 1024 * 64) catch unreachable;
-
-    all_nodes.appendAssumeCapacity(start);
-    hash_to_index.putAssumeCapacity(start.hash(), 0);
-    known_costs.items[0] = 0;
-    open_costs.items[0] = pathCostHeuristic(start.pos, target.pos);
-    open_set.appendAssumeCapacity(0);
-
-    while (open_set.items.len > 0) {
-        var best_cost = math.floatMax(f32);
-        var best_open_index: u64 = 0;
-        for (open_set.items, 0..) |opennode, i_node| {
-            if (open_costs.items[opennode] < best_cost) {
-                best_cost = open_costs.items[opennode];
-                best_open_index = i_node;
-            }
-        }
-
-        const best_index = open_set.items[best_open_index];
-        _ = open_set.swapRemove(best_open_index);
-
-        const node = all_nodes.items[best_index];
-        const dist = node.dist(target.pos);
-        if (dist < 100) {
-            std.log.info("Pathfinding close {d}", .{best_index});
-            var next = best_index;
-            while (next != std.math.maxInt(u32)) {
-                std.log.info("Pathfinding next {d}", .{next});
-                ctx.path.appendAssumeCapacity(all_nodes.items[next]);
-                next = came_from.items[next];
-            }
-            return;
-        }
-
-        lol += 1;
-        avg_dist += dist;
-        if (lol > 10000) {
-            avg_dist /= 10000;
-            lol = 0;
-            std.log.info("Pathfinding {d}/{d} cost:{d} pos:{d},{d} dist:{d} avg_dist:{d}", .{ best_index, all_nodes.items.len, best_cost, node.pos[0], node.pos[1], dist, avg_dist });
-            avg_dist = 0;
-        }
-        const cost_current = known_costs.items[best_index];
-
-        const dist_points = 50;
-        const angle_fwd = node.angle;
-        const pos_curr = node.pos;
-        const height = ctx.heightmap.getFromFloat(pos_curr[0], pos_curr[1]);
-        const angle_offset: f32 = math.degreesToRadians(20);
-        for (0..3) |i_angle| {
-            const angle_next = angle_fwd + (@as(f32, @floatFromInt(i_angle)) - 1) * angle_offset;
-            const dir_next = .{ math.cos(angle_next), math.sin(angle_next) };
-            const pos_next = .{ pos_curr[0] + dir_next[0] * dist_points, pos_curr[1] + dir_next[1] * dist_points };
-            const height_next = ctx.heightmap.getFromFloat(pos_next[0], pos_next[1]);
-
-            if (height_next < 50) {
-                continue;
-            }
-            if (height_next > 250) {
-                continue;
-            }
-
-            const cost_altitude = (height_next - 50) / (250 - 50);
-            const cost_height_diff = @min(1.0, @abs(height - height_next) * 0.1);
-
-            const cost = dist_points * (1 + 3 * cost_height_diff * cost_height_diff + 3 * cost_altitude * cost_altitude);
-            const tentative_cost = cost_current + cost;
-
-            const node_next: PathNode = .{
-                .pos = pos_next,
-                .angle = angle_next,
-            };
-            const hash_next = node_next.hash();
-
-            const index_next_opt = hash_to_index.get(hash_next);
-
-            if (index_next_opt) |index_next| {
-                const known_cost = known_costs.items[index_next];
-                if (known_cost <= tentative_cost) {
-                    // This node was already tested in a better way, don't re-test it
-                    continue;
-                }
-
-                // We've already tried this node but found a better approach to it
-                known_costs.items[index_next] = tentative_cost;
-            } else {
-                all_nodes.appendAssumeCapacity(node_next);
-                hash_to_index.putAssumeCapacity(hash_next, @intCast(all_nodes.items.len - 1));
-            }
-
-            const index_next = hash_to_index.get(hash_next).?;
-            came_from.items[index_next] = best_index;
-            known_costs.items[index_next] = tentative_cost;
-            open_costs.items[index_next] = tentative_cost + pathCostHeuristic(pos_next, target.pos);
-            open_set.appendAssumeCapacity(index_next);
-        }
-    }
+fn isSettlementHeight(height: f32) bool {
+    return height >= 60 and height <= 250; // hack for sea level and mountains
 }
 
 pub fn cities(world_settings: types.WorldSettings, heightmap: types.ImageF32, gradient: types.ImageF32, city_points: *const types.BackedListVec2, cities_out: *std.ArrayList([3]f32)) void {
     _ = world_settings; // autofix
+    _ = gradient;
 
     // var buf: [512 * 1024]u8 = undefined;
     // const template = loadTemplate("../../../content/flecs_script/templates/village_small_poor.template.flecs", buf);
@@ -282,6 +130,45 @@ pub fn cities(world_settings: types.WorldSettings, heightmap: types.ImageF32, gr
     const rand = prng.random();
     var props = std.ArrayList(Prop).initCapacity(std.heap.c_allocator, 1024 * 4) catch unreachable;
 
+    // Roads, every city to the next valid one. They are searched up front over the CPU workers.
+    const city_roads = std.heap.c_allocator.alloc(?usize, city_points.count) catch unreachable;
+    defer std.heap.c_allocator.free(city_roads);
+    @memset(city_roads, null);
+    var road_queries = std.ArrayList(pathfinding.Query).init(std.heap.c_allocator);
+    defer road_queries.deinit();
+    for (city_points.backed_slice[0..city_points.count], 0..) |pt, i_city| {
+        if (!isSettlementHeight(heightmap.get(@as(u32, @intFromFloat(pt[0])), @as(u32, @intFromFloat(pt[1]))))) {
+            continue;
+        }
+        for (city_points.backed_slice[i_city + 1 .. city_points.count]) |pt2| {
+            if (!isSettlementHeight(heightmap.get(@as(u32, @intFromFloat(pt2[0])), @as(u32, @intFromFloat(pt2[1]))))) {
+                continue;
+            }
+            city_roads[i_city] = road_queries.items.len;
+            road_queries.append(.{
+                .start = .{ .pos = .{ pt[0] + radius_palisades, pt[1] }, .angle = 0 },
+                .target = pt2,
+            }) catch unreachable;
+            break; // hack for having a reasonable amount of roads..
+        }
+    }
+
+    const road_paths = std.heap.c_allocator.alloc(std.ArrayList(pathfinding.PathNode), road_queries.items.len) catch unreachable;
+    defer std.heap.c_allocator.free(road_paths);
+    for (road_paths) |*path| {
+        path.* = std.ArrayList(pathfinding.PathNode).init(std.heap.c_allocator);
+    }
+    defer {
+        for (road_paths) |*path| {
+            path.deinit();
+        }
+    }
+
+    const pathfinder = pathfinding.Pathfinder.create(std.heap.c_allocator, heightmap, .{});
+    defer pathfinder.destroy();
+    const road_stats = pathfinder.findPaths(road_queries.items, road_paths);
+    std.log.info("Pathfinding done! {d}/{d} roads, {d} nodes expanded", .{ road_stats.found, road_queries.items.len, road_stats.expanded });
+
     var valid_settlement_i: u32 = 0;
     for (city_points.backed_slice[0..city_points.count], 0..) |pt, i_city| {
         props.clearRetainingCapacity();
@@ -363,36 +250,8 @@ pub fn cities(world_settings: types.WorldSettings, heightmap: types.ImageF32, gr
 
         // Roads
 
-        std.log.info("Pathfinding!", .{});
-        for (city_points.backed_slice[i_city + 1 .. city_points.count]) |pt2| {
-            const settlement_height2 = heightmap.get(@as(u32, @intFromFloat(pt2[0])), @as(u32, @intFromFloat(pt2[1])));
-            if (settlement_height2 < 60) {
-                continue; // hack for sea level
-            }
-            if (settlement_height2 > 250) {
-                continue; // hack for mountains
-            }
-
-            var path_nodes = std.ArrayList(PathNode).initCapacity(std.heap.c_allocator, 1024 * 1024) catch unreachable;
-            defer path_nodes.deinit();
-
-            std.log.info("Pathfinding...", .{});
-            const start_pos = .{
-                pt[0] + math.cos(0.0) * radius_palisades,
-                pt[1] + math.sin(0.0) * radius_palisades,
-            };
-            doAStar(
-                .{ .pos = start_pos, .angle = 0 },
-                .{ .pos = pt2, .angle = 0 },
-                .{
-                    .path = &path_nodes,
-                    .allocator = std.heap.c_allocator,
-                    .gradient = gradient,
-                    .heightmap = heightmap,
-                },
-            );
-            std.log.info("Pathfinding done! {d}", .{path_nodes.items.len});
-
+        if (city_roads[i_city]) |i_road| {
+            const path_nodes = road_paths[i_road];
             for (path_nodes.items, 0..) |node, node_index| {
                 // if (rand.float(f32) > 0.5) {
                 //     continue;
@@ -420,8 +279,6 @@ pub fn cities(world_settings: types.WorldSettings, heightmap: types.ImageF32, gr
                     });
                 }
             }
-
-            break; // hack for having a reasonable amount of roads..
         }
 
         cities_out.appendAssumeCapacity(.{ x, settlement_height, z });
@@ -508,11 +365,15 @@ pub fn write_trees(heightmap: types.ImageF32, points: types.PatchDataPts2d) void
 
     std.fs.cwd().makeDir(folderbufslice) catch {};
 
+    // All patches of this LoD also go into one packed archive that the game memory maps.
+    var archive = patch_archive.PatchArchiveWriter.create(std.heap.c_allocator);
+    defer archive.destroy();
+
     for (0..points.size.height) |patch_z| {
         for (0..points.size.width) |patch_x| {
             const namebufslice = std.fmt.bufPrintZ(
                 namebuf[0..namebuf.len],
-                "{s}/props_x{}_z{}.txt",
+                "{s}/props_x{}_z{}.props",
                 .{
                     folderbufslice,
                     patch_x,
@@ -526,8 +387,10 @@ pub fn write_trees(heightmap: types.ImageF32, points: types.PatchDataPts2d) void
                 continue;
             }
 
-            var output_file_data = std.ArrayList(u8).initCapacity(std.heap.c_allocator, props.len * 50) catch unreachable;
-            var writer = output_file_data.writer();
+            var patch_props = std.ArrayList(props_format.PropInput).initCapacity(std.heap.c_allocator, props.len) catch unreachable;
+            defer patch_props.deinit();
+            var output_file_data = std.ArrayList(u8).initCapacity(std.heap.c_allocator, props.len * 12) catch unreachable;
+            defer output_file_data.deinit();
 
             for (props) |prop| {
                 // city,1072.000,145.403,1152.000,43
@@ -540,14 +403,26 @@ pub fn write_trees(heightmap: types.ImageF32, points: types.PatchDataPts2d) void
                 }
 
                 const rot = rand.float(f32) * math.tau;
-                writer.print("tree,{d:.3},{d:.3},{d:.3},{}\n", .{ prop[0], height, prop[1], rot }) catch unreachable;
+                const scale = 0.15 + rand.float(f32) * 1.25;
+                patch_props.appendAssumeCapacity(.{ .type_name = "tree", .pos = .{ prop[0], height, prop[1] }, .rot = rot, .scale = scale });
             }
 
+            props_format.encode(patch_props.items, true, output_file_data.writer()) catch unreachable;
+
             const file = std.fs.cwd().createFile(namebufslice, .{ .read = true }) catch unreachable;
             defer file.close();
             _ = file.writeAll(output_file_data.items) catch unreachable;
+
+            archive.addPatch(@intCast(patch_x), @intCast(patch_z), output_file_data.items);
         }
     }
+
+    const archivebufslice = std.fmt.bufPrintZ(
+        namebuf[0..namebuf.len],
+        "{s}/props.patchpack",
+        .{folderbufslice},
+    ) catch unreachable;
+    archive.write(archivebufslice) catch unreachable;
 }
 
 // pub fn voronoi_to_water(voronoi_image: types.ImageRGBA, water_image: *types.ImageF32) void {
@@ -1,6 +1,7 @@
 const std = @import("std");
 const types = @import("../types.zig");
 const zm = @import("zmath");
+const patch_archive = @import("patch_archive");
 
 pub const FbmSettings = struct {
     octaves: u8,
@@ -39,6 +40,11 @@ pub fn heightmap_format(world_settings: types.WorldSettings, heightmap: types.Im
 
         const lod_patch_width = best_lod_width * std.math.pow(usize, 2, lod); // 64, 128, 256 , 512
         const lod_patch_count_per_side = world_settings.size.width / lod_patch_width;
+
+        // All patches of this LoD also go into one packed archive that the game memory maps.
+        var archive = patch_archive.PatchArchiveWriter.create(std.heap.c_allocator);
+        defer archive.destroy();
+
         for (0..lod_patch_count_per_side) |lod_patch_z| {
             for (0..lod_patch_count_per_side) |lod_patch_x| {
 
@@ -69,6 +75,7 @@ pub fn heightmap_format(world_settings: types.WorldSettings, heightmap: types.Im
                 const insides = (bitdepth / 8) * (patch_resolution - 2) * (patch_resolution - 2);
                 const total_bytes = header_bytes + edge_bytes + insides;
                 var output_blob = std.ArrayList(u8).initCapacity(std.heap.c_allocator, total_bytes) catch unreachable;
+                defer output_blob.deinit();
                 var writer = output_blob.writer();
 
                 // HEADER
@@ -165,8 +172,17 @@ pub fn heightmap_format(world_settings: types.WorldSettings, heightmap: types.Im
                 const file = std.fs.cwd().createFile(namebufslice, .{ .read = true }) catch unreachable;
                 defer file.close();
                 _ = file.writeAll(output_blob.items) catch unreachable;
+
+                archive.addPatch(@intCast(lod_patch_x), @intCast(lod_patch_z), output_blob.items);
             }
         }
+
+        const archivebufslice = std.fmt.bufPrintZ(
+            namebuf[0..namebuf.len],
+            "{s}/{s}.patchpack",
+            .{ folderbufslice, folder },
+        ) catch unreachable;
+        archive.write(archivebufslice) catch unreachable;
     }
 }
 
@@ -3,6 +3,7 @@ pub const fbm = @import("fbm.zig");
 pub const heightmap_format = @import("heightmap_format.zig");
 pub const gradient = @import("gradient.zig");
 pub const math = @import("math.zig");
+pub const pathfinding = @import("pathfinding.zig");
 pub const points = @import("points.zig");
 pub const poisson = @import("poisson.zig");
 pub const voronoi = @import("voronoi.zig");
@@ -0,0 +1,860 @@
+const std = @import("std");
+const math = std.math;
+
+const compute = @import("../compute.zig");
+const compute_cpu = @import("../compute_cpu.zig");
+const types = @import("../types.zig");
+
+// A* road search over a heightmap with one pixel per meter. Roads advance step_length meters at a
+// time and turn at most turn_angle per step. Search nodes are cell_size cells times heading_count
+// heading buckets, each keeping the continuous position and heading of its cheapest arrival.
+//
+// Every searcher owns flat node arrays covering the whole heightmap. Nodes are stamped with the
+// query generation instead of being cleared, so a query only touches the nodes it reaches. The
+// open set is a binary heap that nodes know their slot in, a cheaper arrival moves a queued node
+// in place instead of queuing it twice.
+//
+// The optional coarse pass first routes over coarse_cell_size cells and limits the fine search to
+// a corridor around that route. Cities that can't reach each other are rejected without flooding
+// the map.
+
+pub const PathNode = struct {
+    pos: [2]f32,
+    angle: f32,
+};
+
+pub const Query = struct {
+    start: PathNode,
+    target: [2]f32,
+};
+
+pub const Settings = struct {
+    cell_size: f32 = 16,
+    step_length: f32 = 50,
+    turn_angle: f32 = math.degreesToRadians(20),
+    arrival_distance: f32 = 100,
+    height_min: f32 = 50, // Sea level
+    height_max: f32 = 250, // Mountains
+    coarse_cell_size: u32 = 256, // 0 disables the coarse pass
+    corridor_radius: u32 = 2, // Coarse cells kept around the coarse route
+};
+
+pub const BatchStats = struct {
+    found: u32 = 0,
+    expanded: u64 = 0,
+};
+
+const heading_count = 8;
+const no_node = math.maxInt(u32);
+
+const FineNode = extern struct {
+    generation: u32,
+    slot: u32,
+    parent: u32,
+    cost: f32,
+    pos: [2]f32,
+    angle: f32,
+    _padding: u32 = 0,
+};
+
+const CoarseNode = extern struct {
+    generation: u32,
+    slot: u32,
+    parent: u32,
+    cost: f32,
+};
+
+fn distance(a: [2]f32, b: [2]f32) f32 {
+    const x = a[0] - b[0];
+    const z = a[1] - b[1];
+    return @sqrt(x * x + z * z);
+}
+
+// ██╗  ██╗███████╗ █████╗ ██████╗
+// ██║  ██║██╔════╝██╔══██╗██╔══██╗
+// ███████║█████╗  ███████║██████╔╝
+// ██╔══██║██╔══╝  ██╔══██║██╔═══╝
+// ██║  ██║███████╗██║  ██║██║
+// ╚═╝  ╚═╝╚══════╝╚═╝  ╚═╝╚═╝
+
+const OpenItem = struct {
+    priority: f32,
+    node: u32,
+};
+
+// Binary min-heap of node indices. The priority is kept next to the index so sifting never reads
+// the nodes, only their slot gets written.
+fn OpenHeap(comptime Node: type) type {
+    return struct {
+        const Self = @This();
+
+        items: std.ArrayList(OpenItem),
+
+        fn init(allocator: std.mem.Allocator) Self {
+            return .{ .items = std.ArrayList(OpenItem).init(allocator) };
+        }
+
+        fn deinit(self: *Self) void {
+            self.items.deinit();
+        }
+
+        fn clear(self: *Self) void {
+            self.items.clearRetainingCapacity();
+        }
+
+        fn isEmpty(self: Self) bool {
+            return self.items.items.len == 0;
+        }
+
+        // Queues the node, or moves it when it is already queued.
+        fn update(self: *Self, nodes: []Node, node: u32, priority: f32) void {
+            var slot = nodes[node].slot;
+            if (slot == no_node) {
+                slot = @intCast(self.items.items.len);
+                self.items.append(.{ .priority = priority, .node = node }) catch unreachable;
+            } else {
+                self.items.items[slot].priority = priority;
+            }
+            self.siftDown(nodes, self.siftUp(nodes, slot));
+        }
+
+        fn pop(self: *Self, nodes: []Node) u32 {
+            const top = self.items.items[0];
+            nodes[top.node].slot = no_node;
+            const last = self.items.pop().?;
+            if (self.items.items.len > 0) {
+                self.items.items[0] = last;
+                self.siftDown(nodes, 0);
+            }
+            return top.node;
+        }
+
+        fn siftUp(self: *Self, nodes: []Node, slot_start: u32) u32 {
+            const items = self.items.items;
+            const item = items[slot_start];
+            var slot = slot_start;
+            while (slot > 0) {
+                const parent = (slot - 1) / 2;
+                if (items[parent].priority <= item.priority) {
+                    break;
+                }
+                items[slot] = items[parent];
+                nodes[items[slot].node].slot = slot;
+                slot = parent;
+            }
+            items[slot] = item;
+            nodes[item.node].slot = slot;
+            return slot;
+        }
+
+        fn siftDown(self: *Self, nodes: []Node, slot_start: u32) void {
+            const items = self.items.items;
+            const item = items[slot_start];
+            var slot = slot_start;
+            while (true) {
+                var child = slot * 2 + 1;
+                if (child >= items.len) {
+                    break;
+                }
+                if (child + 1 < items.len and items[child + 1].priority < items[child].priority) {
+                    child += 1;
+                }
+                if (item.priority <= items[child].priority) {
+                    break;
+                }
+                items[slot] = items[child];
+                nodes[items[slot].node].slot = slot;
+                slot = child;
+            }
+            items[slot] = item;
+            nodes[item.node].slot = slot;
+        }
+    };
+}
+
+//  ██████╗ ██████╗  █████╗ ██████╗ ███████╗███████╗
+// ██╔════╝██╔═══██╗██╔══██╗██╔══██╗██╔════╝██╔════╝
+// ██║     ██║   ██║███████║██████╔╝███████╗█████╗
+// ██║     ██║   ██║██╔══██║██╔══██╗╚════██║██╔══╝
+// ╚██████╗╚██████╔╝██║  ██║██║  ██║███████║███████╗
+//  ╚═════╝ ╚═════╝ ╚═╝  ╚═╝╚═╝  ╚═╝╚══════╝╚══════╝
+
+// Cost per meter of crossing each coarse cell, infinite when no sample of it is passable.
+const CoarseGrid = struct {
+    cells_x: u32,
+    cells_y: u32,
+    cell_size: u32,
+    costs: []f32,
+
+    fn init(allocator: std.mem.Allocator, heightmap: types.ImageF32, settings: Settings) CoarseGrid {
+        const cell_size = settings.coarse_cell_size;
+        const cells_x: u32 = @intCast(std.math.divCeil(u64, heightmap.size.width, cell_size) catch unreachable);
+        const cells_y: u32 = @intCast(std.math.divCeil(u64, heightmap.size.height, cell_size) catch unreachable);
+        const self = CoarseGrid{
+            .cells_x = cells_x,
+            .cells_y = cells_y,
+            .cell_size = cell_size,
+            .costs = allocator.alloc(f32, @as(usize, cells_x) * cells_y) catch unreachable,
+        };
+
+        const Build = struct {
+            grid: *const CoarseGrid,
+            heightmap: types.ImageF32,
+            settings: Settings,
+
+            fn rows(build: *const @This(), row_begin: usize, row_end: usize) void {
+                const grid = build.grid;
+                const stride: u64 = @intFromFloat(build.settings.cell_size);
+                for (row_begin..row_end) |cell_y| {
+                    for (0..grid.cells_x) |cell_x| {
+                        var passable: u32 = 0;
+                        var cost_sum: f32 = 0;
+                        var y = cell_y * grid.cell_size;
+                        while (y < @min((cell_y + 1) * grid.cell_size, build.heightmap.size.height)) : (y += stride) {
+                            var x = cell_x * grid.cell_size;
+                            while (x < @min((cell_x + 1) * grid.cell_size, build.heightmap.size.width)) : (x += stride) {
+                                const height = build.heightmap.get(x, y);
+                                if (height < build.settings.height_min or height > build.settings.height_max) {
+                                    continue;
+                                }
+                                const cost_altitude = (height - build.settings.height_min) / (build.settings.height_max - build.settings.height_min);
+                                cost_sum += 1 + 3 * cost_altitude * cost_altitude;
+                                passable += 1;
+                            }
+                        }
+                        grid.costs[cell_x + cell_y * grid.cells_x] = if (passable == 0) math.inf(f32) else cost_sum / @as(f32, @floatFromInt(passable));
+                    }
+                }
+            }
+        };
+        const build = Build{ .grid = &self, .heightmap = heightmap, .settings = settings };
+        compute_cpu.forEachBand(cells_y, 1, &build, Build.rows);
+        return self;
+    }
+
+    fn deinit(self: *CoarseGrid, allocator: std.mem.Allocator) void {
+        allocator.free(self.costs);
+    }
+
+    fn cellIndex(self: CoarseGrid, pos: [2]f32) u32 {
+        const cell_x: u32 = @intFromFloat(pos[0] / @as(f32, @floatFromInt(self.cell_size)));
+        const cell_y: u32 = @intFromFloat(pos[1] / @as(f32, @floatFromInt(self.cell_size)));
+        return cell_x + cell_y * self.cells_x;
+    }
+};
+
+// ███████╗███████╗ █████╗ ██████╗  ██████╗██╗  ██╗
+// ██╔════╝██╔════╝██╔══██╗██╔══██╗██╔════╝██║  ██║
+// ███████╗█████╗  ███████║██████╔╝██║     ███████║
+// ╚════██║██╔══╝  ██╔══██║██╔══██╗██║     ██╔══██║
+// ███████║███████╗██║  ██║██║  ██║╚██████╗██║  ██║
+// ╚══════╝╚══════╝╚═╝  ╚═╝╚═╝  ╚═╝ ╚═════╝╚═╝  ╚═╝
+
+// Search state of one thread, reused by every query it runs.
+const Searcher = struct {
+    fine_nodes: []FineNode,
+    coarse_nodes: []CoarseNode,
+    corridor: []u32, // Generation of the last query whose corridor covers each coarse cell
+    fine_open: OpenHeap(FineNode),
+    coarse_open: OpenHeap(CoarseNode),
+    generation: u32 = 0,
+    expanded: u64 = 0,
+
+    // NOTE: The node arrays come zeroed from the page allocator and are never cleared, pages of
+    // the map that no query reaches are never faulted in.
+    fn create(allocator: std.mem.Allocator, fine_count: usize, coarse_count: usize) *Searcher {
+        const self = allocator.create(Searcher) catch unreachable;
+        self.* = .{
+            .fine_nodes = std.heap.page_allocator.alloc(FineNode, fine_count) catch unreachable,
+            .coarse_nodes = std.heap.page_allocator.alloc(CoarseNode, coarse_count) catch unreachable,
+            .corridor = std.heap.page_allocator.alloc(u32, coarse_count) catch unreachable,
+            .fine_open = OpenHeap(FineNode).init(allocator),
+            .coarse_open = OpenHeap(CoarseNode).init(allocator),
+        };
+        return self;
+    }
+
+    fn destroy(self: *Searcher, allocator: std.mem.Allocator) void {
+        std.heap.page_allocator.free(self.fine_nodes);
+        std.heap.page_allocator.free(self.coarse_nodes);
+        std.heap.page_allocator.free(self.corridor);
+        self.fine_open.deinit();
+        self.coarse_open.deinit();
+        allocator.destroy(self);
+    }
+
+    // Invalidates every node of the previous query.
+    fn nextGeneration(self: *Searcher) void {
+        if (self.generation == math.maxInt(u32)) {
+            for (self.fine_nodes) |*node| {
+                node.generation = 0;
+            }
+            for (self.coarse_nodes) |*node| {
+                node.generation = 0;
+            }
+            @memset(self.corridor, 0);
+            self.generation = 0;
+        }
+        self.generation += 1;
+        self.fine_open.clear();
+        self.coarse_open.clear();
+    }
+};
+
+// ██████╗  █████╗ ████████╗██╗  ██╗███████╗██╗███╗   ██╗██████╗ ███████╗██████╗
+// ██╔══██╗██╔══██╗╚══██╔══╝██║  ██║██╔════╝██║████╗  ██║██╔══██╗██╔════╝██╔══██╗
+// ██████╔╝███████║   ██║   ███████║█████╗  ██║██╔██╗ ██║██║  ██║█████╗  ██████╔╝
+// ██╔═══╝ ██╔══██║   ██║   ██╔══██║██╔══╝  ██║██║╚██╗██║██║  ██║██╔══╝  ██╔══██╗
+// ██║     ██║  ██║   ██║   ██║  ██║██║     ██║██║ ╚████║██████╔╝███████╗██║  ██║
+// ╚═╝     ╚═╝  ╚═╝   ╚═╝   ╚═╝  ╚═╝╚═╝     ╚═╝╚═╝  ╚═══╝╚═════╝ ╚══════╝╚═╝  ╚═╝
+
+pub const Pathfinder = struct {
+    allocator: std.mem.Allocator,
+    heightmap: types.ImageF32,
+    settings: Settings,
+    cells_x: u32,
+    cells_y: u32,
+    coarse: ?CoarseGrid,
+    idle_searchers: std.ArrayList(*Searcher),
+    idle_searchers_mutex: std.Thread.Mutex = .{},
+
+    pub fn create(allocator: std.mem.Allocator, heightmap: types.ImageF32, settings: Settings) *Pathfinder {
+        const self = allocator.create(Pathfinder) catch unreachable;
+        self.* = .{
+            .allocator = allocator,
+            .heightmap = heightmap,
+            .settings = settings,
+            .cells_x = @intFromFloat(@ceil(@as(f32, @floatFromInt(heightmap.size.width)) / settings.cell_size)),
+            .cells_y = @intFromFloat(@ceil(@as(f32, @floatFromInt(heightmap.size.height)) / settings.cell_size)),
+            .coarse = if (settings.coarse_cell_size > 0) CoarseGrid.init(allocator, heightmap, settings) else null,
+            .idle_searchers = std.ArrayList(*Searcher).init(allocator),
+        };
+        return self;
+    }
+
+    pub fn destroy(self: *Pathfinder) void {
+        for (self.idle_searchers.items) |searcher| {
+            searcher.destroy(self.allocator);
+        }
+        self.idle_searchers.deinit();
+        if (self.coarse) |*coarse| {
+            coarse.deinit(self.allocator);
+        }
+        self.allocator.destroy(self);
+    }
+
+    // Searches every query, spread over the CPU backend's workers. paths[i] receives the path of
+    // queries[i] from its target back to its start, or stays empty when there is none.
+    pub fn findPaths(self: *Pathfinder, queries: []const Query, paths: []std.ArrayList(PathNode)) BatchStats {
+        std.debug.assert(queries.len == paths.len);
+        const Batch = struct {
+            pathfinder: *Pathfinder,
+            queries: []const Query,
+            paths: []std.ArrayList(PathNode),
+            found: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+            expanded: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+
+            fn run(batch: *@This(), query_begin: usize, query_end: usize) void {
+                const searcher = batch.pathfinder.acquireSearcher();
+                defer batch.pathfinder.releaseSearcher(searcher);
+                for (query_begin..query_end) |i_query| {
+                    searcher.expanded = 0;
+                    if (batch.pathfinder.findPath(searcher, batch.queries[i_query], &batch.paths[i_query])) {
+                        _ = batch.found.fetchAdd(1, .monotonic);
+                    }
+                    _ = batch.expanded.fetchAdd(searcher.expanded, .monotonic);
+                }
+            }
+        };
+
+        var batch = Batch{ .pathfinder = self, .queries = queries, .paths = paths };
+        compute_cpu.forEachBand(queries.len, 1, &batch, Batch.run);
+        return .{ .found = batch.found.load(.monotonic), .expanded = batch.expanded.load(.monotonic) };
+    }
+
+    fn acquireSearcher(self: *Pathfinder) *Searcher {
+        self.idle_searchers_mutex.lock();
+        defer self.idle_searchers_mutex.unlock();
+        if (self.idle_searchers.pop()) |searcher| {
+            return searcher;
+        }
+        const fine_count = @as(usize, self.cells_x) * self.cells_y * heading_count;
+        const coarse_count = if (self.coarse) |coarse| coarse.costs.len else 0;
+        return Searcher.create(self.allocator, fine_count, coarse_count);
+    }
+
+    fn releaseSearcher(self: *Pathfinder, searcher: *Searcher) void {
+        self.idle_searchers_mutex.lock();
+        defer self.idle_searchers_mutex.unlock();
+        self.idle_searchers.append(searcher) catch unreachable;
+    }
+
+    fn isInside(self: Pathfinder, pos: [2]f32) bool {
+        return pos[0] >= 0 and pos[1] >= 0 and
+            pos[0] < @as(f32, @floatFromInt(self.heightmap.size.width)) and
+            pos[1] < @as(f32, @floatFromInt(self.heightmap.size.height));
+    }
+
+    fn fineIndex(self: Pathfinder, pos: [2]f32, angle: f32) u32 {
+        const cell_x: u32 = @intFromFloat(pos[0] / self.settings.cell_size);
+        const cell_y: u32 = @intFromFloat(pos[1] / self.settings.cell_size);
+        const heading_f = @mod(angle, math.tau) * (heading_count / math.tau);
+        const heading = @min(@as(u32, @intFromFloat(heading_f)), heading_count - 1);
+        return (cell_x + cell_y * self.cells_x) * heading_count + heading;
+    }
+
+    fn findPath(self: *Pathfinder, searcher: *Searcher, query: Query, path: *std.ArrayList(PathNode)) bool {
+        searcher.nextGeneration();
+        if (!self.isInside(query.start.pos) or !self.isInside(query.target)) {
+            return false;
+        }
+        if (self.coarse != null and !self.findCorridor(searcher, query)) {
+            return false;
+        }
+
+        const settings = self.settings;
+        const nodes = searcher.fine_nodes;
+        const generation = searcher.generation;
+
+        const start = self.fineIndex(query.start.pos, query.start.angle);
+        nodes[start] = .{
+            .generation = generation,
+            .slot = no_node,
+            .parent = no_node,
+            .cost = 0,
+            .pos = query.start.pos,
+            .angle = query.start.angle,
+        };
+        searcher.fine_open.update(nodes, start, distance(query.start.pos, query.target));
+
+        while (!searcher.fine_open.isEmpty()) {
+            const current = searcher.fine_open.pop(nodes);
+            const node = nodes[current];
+            if (distance(node.pos, query.target) < settings.arrival_distance) {
+                var next = current;
+                while (next != no_node) {
+                    path.append(.{ .pos = nodes[next].pos, .angle = nodes[next].angle }) catch unreachable;
+                    next = nodes[next].parent;
+                }
+                return true;
+            }
+            searcher.expanded += 1;
+
+            const height = self.heightmap.getFromFloat(node.pos[0], node.pos[1]);
+            for (0..3) |i_angle| {
+                const angle_next = node.angle + (@as(f32, @floatFromInt(i_angle)) - 1) * settings.turn_angle;
+                const pos_next = [2]f32{
+                    node.pos[0] + math.cos(angle_next) * settings.step_length,
+                    node.pos[1] + math.sin(angle_next) * settings.step_length,
+                };
+                if (!self.isInside(pos_next)) {
+                    continue;
+                }
+                const height_next = self.heightmap.getFromFloat(pos_next[0], pos_next[1]);
+                if (height_next < settings.height_min or height_next > settings.height_max) {
+                    continue;
+                }
+                if (self.coarse) |coarse| {
+                    if (searcher.corridor[coarse.cellIndex(pos_next)] != generation) {
+                        continue;
+                    }
+                }
+
+                const cost_altitude = (height_next - settings.height_min) / (settings.height_max - settings.height_min);
+                const cost_height_diff = @min(1.0, @abs(height - height_next) * 0.1);
+                const cost = settings.step_length * (1 + 3 * cost_height_diff * cost_height_diff + 3 * cost_altitude * cost_altitude);
+                const tentative_cost = node.cost + cost;
+
+                const index_next = self.fineIndex(pos_next, angle_next);
+                const node_next = &nodes[index_next];
+                if (node_next.generation != generation) {
+                    node_next.* = .{
+                        .generation = generation,
+                        .slot = no_node,
+                        .parent = no_node,
+                        .cost = math.inf(f32),
+                        .pos = pos_next,
+                        .angle = angle_next,
+                    };
+                }
+                if (node_next.cost <= tentative_cost) {
+                    // This node was already reached in a better way
+                    continue;
+                }
+
+                node_next.cost = tentative_cost;
+                node_next.parent = current;
+                node_next.pos = pos_next;
+                node_next.angle = angle_next;
+                searcher.fine_open.update(nodes, index_next, tentative_cost + distance(pos_next, query.target));
+            }
+        }
+        return false;
+    }
+
+    // Routes the query over the coarse grid and stamps the cells around the route as the
+    // corridor the fine search may enter. False when the coarse grid has no route.
+    fn findCorridor(self: *Pathfinder, searcher: *Searcher, query: Query) bool {
+        const coarse = self.coarse.?;
+        const nodes = searcher.coarse_nodes;
+        const generation = searcher.generation;
+        const cell_size: f32 = @floatFromInt(coarse.cell_size);
+
+        const start = coarse.cellIndex(query.start.pos);
+        const target = coarse.cellIndex(query.target);
+        const target_center = [2]f32{
+            (@as(f32, @floatFromInt(target % coarse.cells_x)) + 0.5) * cell_size,
+            (@as(f32, @floatFromInt(target / coarse.cells_x)) + 0.5) * cell_size,
+        };
+
+        nodes[start] = .{ .generation = generation, .slot = no_node, .parent = no_node, .cost = 0 };
+        searcher.coarse_open.update(nodes, start, 0);
+
+        while (!searcher.coarse_open.isEmpty()) {
+            const current = searcher.coarse_open.pop(nodes);
+            if (current == target) {
+                self.stampCorridor(searcher, target);
+                return true;
+            }
+
+            const cell_x: i64 = current % coarse.cells_x;
+            const cell_y: i64 = current / coarse.cells_x;
+            // NOTE: The start and target cells may hold the only passable samples of a city
+            const cost_current = if (current == start) 1 else coarse.costs[current];
+            for ([_]i64{ -1, 0, 1 }) |offset_y| {
+                for ([_]i64{ -1, 0, 1 }) |offset_x| {
+                    const next_x = cell_x + offset_x;
+                    const next_y = cell_y + offset_y;
+                    if ((offset_x == 0 and offset_y == 0) or next_x < 0 or next_y < 0 or next_x >= coarse.cells_x or next_y >= coarse.cells_y) {
+                        continue;
+                    }
+                    const next: u32 = @intCast(next_x + next_y * coarse.cells_x);
+                    const cost_next = if (next == target) 1 else coarse.costs[next];
+                    if (math.isInf(cost_next)) {
+                        continue;
+                    }
+
+                    const step: f32 = if (offset_x != 0 and offset_y != 0) math.sqrt2 else 1;
+                    const tentative_cost = nodes[current].cost + step * cell_size * (cost_current + cost_next) * 0.5;
+                    const node_next = &nodes[next];
+                    if (node_next.generation != generation) {
+                        node_next.* = .{ .generation = generation, .slot = no_node, .parent = no_node, .cost = math.inf(f32) };
+                    }
+                    if (node_next.cost <= tentative_cost) {
+                        continue;
+                    }
+
+                    node_next.cost = tentative_cost;
+                    node_next.parent = current;
+                    const center = [2]f32{
+                        (@as(f32, @floatFromInt(next_x)) + 0.5) * cell_size,
+                        (@as(f32, @floatFromInt(next_y)) + 0.5) * cell_size,
+                    };
+                    searcher.coarse_open.update(nodes, next, tentative_cost + distance(center, target_center));
+                }
+            }
+        }
+        return false;
+    }
+
+    fn stampCorridor(self: *Pathfinder, searcher: *Searcher, target: u32) void {
+        const coarse = self.coarse.?;
+        const radius = self.settings.corridor_radius;
+        var next = target;
+        while (next != no_node) : (next = searcher.coarse_nodes[next].parent) {
+            const cell_x = next % coarse.cells_x;
+            const cell_y = next / coarse.cells_x;
+            for (cell_y -| radius..@min(cell_y + radius + 1, coarse.cells_y)) |y| {
+                for (cell_x -| radius..@min(cell_x + radius + 1, coarse.cells_x)) |x| {
+                    searcher.corridor[x + y * coarse.cells_x] = searcher.generation;
+                }
+            }
+        }
+    }
+};
+
+// ██████╗ ███████╗███╗   ██╗ ██████╗██╗  ██╗
+// ██╔══██╗██╔════╝████╗  ██║██╔════╝██║  ██║
+// ██████╔╝█████╗  ██╔██╗ ██║██║     ███████║
+// ██╔══██╗██╔══╝  ██║╚██╗██║██║     ██╔══██║
+// ██████╔╝███████╗██║ ╚████║╚██████╗██║  ██║
+// ╚═════╝ ╚══════╝╚═╝  ╚═══╝ ╚═════╝╚═╝  ╚═╝
+
+// Connects city_count random cities of a size x size fbm heightmap to their two nearest
+// neighbours, with and without the coarse pass. size 16384 is a 16 km map.
+pub fn benchmark(size: u64, city_count: u32) void {
+    const allocator = std.heap.c_allocator;
+
+    var heightmap = types.ImageF32.square(size);
+    heightmap.pixels = allocator.alloc(f32, heightmap.size.area()) catch unreachable;
+    defer allocator.free(heightmap.pixels);
+    compute.fbm(&heightmap, .{
+        .width = @intCast(size),
+        .height = @intCast(size),
+        .seed = 1,
+        .frequency = 0.0002,
+        .octaves = 8,
+        .scale = 1,
+        ._padding = .{ 0, 0 },
+    });
+    heightmap.height_min = std.mem.min(f32, heightmap.pixels);
+    heightmap.height_max = std.mem.max(f32, heightmap.pixels);
+    heightmap.remap(0, 400);
+
+    var prng = std.Random.DefaultPrng.init(123);
+    const rand = prng.random();
+    var cities = std.ArrayList([2]f32).init(allocator);
+    defer cities.deinit();
+    const size_f: f32 = @floatFromInt(size);
+    var attempts: u32 = 0;
+    while (cities.items.len < city_count and attempts < city_count * 100) : (attempts += 1) {
+        const pos = [2]f32{ rand.float(f32) * size_f, rand.float(f32) * size_f };
+        const height = heightmap.getFromFloat(pos[0], pos[1]);
+        if (height >= 60 and height <= 250) {
+            cities.append(pos) catch unreachable;
+        }
+    }
+
+    var queries = std.ArrayList(Query).init(allocator);
+    defer queries.deinit();
+    for (cities.items, 0..) |city, i_city| {
+        var nearest = [2]usize{ i_city, i_city };
+        var nearest_dist = [2]f32{ math.inf(f32), math.inf(f32) };
+        for (cities.items, 0..) |other, i_other| {
+            const dist = distance(city, other);
+            if (i_other == i_city or dist >= nearest_dist[1]) {
+                continue;
+            }
+            if (dist < nearest_dist[0]) {
+                nearest = .{ i_other, nearest[0] };
+                nearest_dist = .{ dist, nearest_dist[0] };
+            } else {
+                nearest[1] = i_other;
+                nearest_dist[1] = dist;
+            }
+        }
+        for (nearest) |i_other| {
+            if (i_other != i_city) {
+                queries.append(.{ .start = .{ .pos = city, .angle = 0 }, .target = cities.items[i_other] }) catch unreachable;
+            }
+        }
+    }
+
+    const paths = allocator.alloc(std.ArrayList(PathNode), queries.items.len) catch unreachable;
+    defer allocator.free(paths);
+
+    std.log.info("Road pathfinding benchmark: {d}x{d}, {d} cities, {d} roads", .{ size, size, cities.items.len, queries.items.len });
+    for ([_]u32{ Settings{}.coarse_cell_size, 0 }) |coarse_cell_size| {
+        for (paths) |*path| {
+            path.* = std.ArrayList(PathNode).init(allocator);
+        }
+        defer {
+            for (paths) |*path| {
+                path.deinit();
+            }
+        }
+
+        var timer = std.time.Timer.start() catch unreachable;
+        const pathfinder = Pathfinder.create(allocator, heightmap, .{ .coarse_cell_size = coarse_cell_size });
+        defer pathfinder.destroy();
+        const setup_ns = timer.lap();
+        const stats = pathfinder.findPaths(queries.items, paths);
+        const search_ns = timer.lap();
+
+        const search_ms = @as(f64, @floatFromInt(search_ns)) / std.time.ns_per_ms;
+        std.log.info("coarse cells {d:>4}: {d}/{d} roads found, setup {d:.1} ms, search {d:.1} ms, {d:.2} ms/road, {d} nodes expanded", .{
+            coarse_cell_size,
+            stats.found,
+            queries.items.len,
+            @as(f64, @floatFromInt(setup_ns)) / std.time.ns_per_ms,
+            search_ms,
+            search_ms / @as(f64, @floatFromInt(@max(queries.items.len, 1))),
+            stats.expanded,
+        });
+    }
+}
+
+// ████████╗███████╗███████╗████████╗
+// ╚══██╔══╝██╔════╝██╔════╝╚══██╔══╝
+//    ██║   █████╗  ███████╗   ██║
+//    ██║   ██╔══╝  ╚════██║   ██║
+//    ██║   ███████╗███████║   ██║
+//    ╚═╝   ╚══════╝╚══════╝   ╚═╝
+
+// With quarter turns and steps of one cell from cell centers, every search node holds a single
+// lattice point and heading, so the search has to match a plain Dijkstra over that lattice.
+const test_size = 128;
+const test_step = 8;
+const test_lattice = test_size / test_step;
+const test_settings = Settings{
+    .cell_size = test_step,
+    .step_length = test_step,
+    .turn_angle = math.pi / 2.0,
+    .arrival_distance = 1,
+    .coarse_cell_size = 0,
+};
+
+// A wall with a gap on the right across the middle, a lake in the bottom left and bumpy slopes.
+// NOTE: Flat over each cell, positions a rounding error off the cell center sample the same height
+fn testHeight(x: usize, y: usize) f32 {
+    const cell_x = x / test_step;
+    const cell_y = y / test_step;
+    if (cell_y == 8 and cell_x < 12) {
+        return 300;
+    }
+    if (cell_x < 4 and cell_y < 3) {
+        return 20;
+    }
+    const bump: f32 = if ((cell_x + cell_y) % 3 == 0) 10 else 0;
+    return 60 + @as(f32, @floatFromInt(cell_x + 2 * cell_y)) * 2.4 + bump;
+}
+
+fn testHeightmap(pixels: *[test_size * test_size]f32) types.ImageF32 {
+    for (0..test_size) |y| {
+        for (0..test_size) |x| {
+            pixels[x + y * test_size] = testHeight(x, y);
+        }
+    }
+    return .{ .size = .{ .width = test_size, .height = test_size }, .pixels = pixels };
+}
+
+fn testPos(lattice_x: usize, lattice_y: usize) [2]f32 {
+    return .{
+        @floatFromInt(lattice_x * test_step + test_step / 2),
+        @floatFromInt(lattice_y * test_step + test_step / 2),
+    };
+}
+
+fn testStepCost(height: f32, height_next: f32) f32 {
+    const settings = test_settings;
+    const cost_altitude = (height_next - settings.height_min) / (settings.height_max - settings.height_min);
+    const cost_height_diff = @min(1.0, @abs(height - height_next) * 0.1);
+    return settings.step_length * (1 + 3 * cost_height_diff * cost_height_diff + 3 * cost_altitude * cost_altitude);
+}
+
+// Brute force Dijkstra over lattice points and the four headings, infinite when unreachable.
+fn testReferenceCost(heightmap: types.ImageF32, start: [2]usize, target: [2]usize) f32 {
+    const state_count = test_lattice * test_lattice * 4;
+    var costs = [_]f32{math.inf(f32)} ** state_count;
+    var done = [_]bool{false} ** state_count;
+    const offsets = [4][2]i64{ .{ 1, 0 }, .{ 0, 1 }, .{ -1, 0 }, .{ 0, -1 } };
+    costs[(start[0] + start[1] * test_lattice) * 4] = 0;
+
+    while (true) {
+        var current: ?usize = null;
+        for (costs, done, 0..) |cost, state_done, i_state| {
+            if (!state_done and !math.isInf(cost) and (current == null or cost < costs[current.?])) {
+                current = i_state;
+            }
+        }
+        const state = current orelse return math.inf(f32);
+        done[state] = true;
+
+        const point = state / 4;
+        const lattice_x = point % test_lattice;
+        const lattice_y = point / test_lattice;
+        if (lattice_x == target[0] and lattice_y == target[1]) {
+            return costs[state];
+        }
+
+        const pos = testPos(lattice_x, lattice_y);
+        const height = heightmap.getFromFloat(pos[0], pos[1]);
+        for ([_]usize{ 3, 0, 1 }) |turn| {
+            const heading = (state % 4 + turn) % 4;
+            const next_x = @as(i64, @intCast(lattice_x)) + offsets[heading][0];
+            const next_y = @as(i64, @intCast(lattice_y)) + offsets[heading][1];
+            if (next_x < 0 or next_y < 0 or next_x >= test_lattice or next_y >= test_lattice) {
+                continue;
+            }
+            const pos_next = testPos(@intCast(next_x), @intCast(next_y));
+            const height_next = heightmap.getFromFloat(pos_next[0], pos_next[1]);
+            if (height_next < test_settings.height_min or height_next > test_settings.height_max) {
+                continue;
+            }
+            const next: usize = @intCast((next_x + next_y * test_lattice) * 4 + @as(i64, @intCast(heading)));
+            costs[next] = @min(costs[next], costs[state] + testStepCost(height, height_next));
+        }
+    }
+}
+
+test "pathfinding matches brute force dijkstra" {
+    var pixels: [test_size * test_size]f32 = undefined;
+    const heightmap = testHeightmap(&pixels);
+
+    // Around the wall, along the slope and into the lake.
+    const cases = [_][2][2]usize{
+        .{ .{ 2, 4 }, .{ 3, 13 } },
+        .{ .{ 1, 5 }, .{ 14, 1 } },
+        .{ .{ 6, 6 }, .{ 1, 1 } },
+    };
+    var queries: [cases.len]Query = undefined;
+    var paths: [cases.len]std.ArrayList(PathNode) = undefined;
+    for (cases, &queries, &paths) |case, *query, *path| {
+        query.* = .{ .start = .{ .pos = testPos(case[0][0], case[0][1]), .angle = 0 }, .target = testPos(case[1][0], case[1][1]) };
+        path.* = std.ArrayList(PathNode).init(std.testing.allocator);
+    }
+    defer {
+        for (&paths) |*path| {
+            path.deinit();
+        }
+    }
+
+    const pathfinder = Pathfinder.create(std.testing.allocator, heightmap, test_settings);
+    defer pathfinder.destroy();
+    const stats = pathfinder.findPaths(&queries, &paths);
+    try std.testing.expectEqual(@as(u32, 2), stats.found);
+
+    for (cases, queries, paths) |case, query, path| {
+        const reference_cost = testReferenceCost(heightmap, case[0], case[1]);
+        if (math.isInf(reference_cost)) {
+            try std.testing.expectEqual(@as(usize, 0), path.items.len);
+            continue;
+        }
+
+        // Listed from the target back to the start.
+        try std.testing.expect(path.items.len > 1);
+        const first = path.items[path.items.len - 1];
+        try std.testing.expectEqual(query.start.pos, first.pos);
+        try std.testing.expectEqual(query.start.angle, first.angle);
+        try std.testing.expect(distance(path.items[0].pos, query.target) < test_settings.arrival_distance);
+
+        var cost: f32 = 0;
+        for (1..path.items.len) |i_node| {
+            const pos = path.items[i_node].pos;
+            const pos_next = path.items[i_node - 1].pos;
+            try std.testing.expectApproxEqAbs(test_settings.step_length, distance(pos, pos_next), 0.01);
+            cost += testStepCost(heightmap.getFromFloat(pos[0], pos[1]), heightmap.getFromFloat(pos_next[0], pos_next[1]));
+        }
+        try std.testing.expectApproxEqRel(reference_cost, cost, 0.0001);
+    }
+}
+
+test "pathfinding coarse corridor" {
+    var pixels: [test_size * test_size]f32 = undefined;
+    const heightmap = testHeightmap(&pixels);
+
+    // The corridor only narrows the search, the road can't get cheaper than the optimal one.
+    var settings = test_settings;
+    settings.coarse_cell_size = 32;
+    settings.corridor_radius = 1;
+    const pathfinder = Pathfinder.create(std.testing.allocator, heightmap, settings);
+    defer pathfinder.destroy();
+
+    const start = [2]usize{ 1, 5 };
+    const target = [2]usize{ 14, 1 };
+    const queries = [_]Query{.{ .start = .{ .pos = testPos(start[0], start[1]), .angle = 0 }, .target = testPos(target[0], target[1]) }};
+    var paths = [_]std.ArrayList(PathNode){std.ArrayList(PathNode).init(std.testing.allocator)};
+    defer paths[0].deinit();
+    try std.testing.expectEqual(@as(u32, 1), pathfinder.findPaths(&queries, &paths).found);
+
+    const path = paths[0].items;
+    try std.testing.expectEqual(queries[0].start.pos, path[path.len - 1].pos);
+    try std.testing.expect(distance(path[0].pos, queries[0].target) < settings.arrival_distance);
+    var cost: f32 = 0;
+    for (1..path.len) |i_node| {
+        const pos = path[i_node].pos;
+        const pos_next = path[i_node - 1].pos;
+        cost += testStepCost(heightmap.getFromFloat(pos[0], pos[1]), heightmap.getFromFloat(pos_next[0], pos_next[1]));
+    }
+    try std.testing.expect(cost >= testReferenceCost(heightmap, start, target) * 0.9999);
+}
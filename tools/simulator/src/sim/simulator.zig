@@ -1,4 +1,5 @@
 const std = @import("std");
+const builtin = @import("builtin");
 // const zjobs = @import("zjobs");
 
 // // const Jobs = zjobs.JobQueue(.{});
@@ -8,6 +9,10 @@ const graph = @import("graph.zig");
 const loaded_graph = @import("hill3.simgraph.zig");
 // const loaded_graph = @import("testgraph.zig");
 const graph_format = @import("graph_format.zig");
+const node_cache = @import("node_cache.zig");
+const tiled_image = @import("tiled_image.zig");
+
+const max_graph_jobs = 16;
 
 const SimulatorJob = struct {
     simulator: Simulator,
@@ -20,57 +25,182 @@ const RunSimulationArgs = struct {
     self: *Simulator,
 };
 
+const NodeTiming = struct {
+    begin_ms: i64 = 0,
+    end_ms: i64 = 0,
+    critical_ms: i64 = 0, // Longest chain of dependencies ending with this node
+    critical_parent: ?usize = null,
+};
+
+// Runs the generated graph's DAG. Workers take the ready node with the lowest index, so with one
+// worker nodes run in the graph's sequential order.
+const DagScheduler = struct {
+    simulator: *Simulator,
+    mutex: std.Thread.Mutex = .{},
+    condition: std.Thread.Condition = .{},
+    pending_dependencies: [loaded_graph.dag.len]usize = undefined,
+    ready: std.BoundedArray(usize, loaded_graph.dag.len) = .{},
+    done_count: usize = 0,
+    timings: [loaded_graph.dag.len]NodeTiming = [_]NodeTiming{.{}} ** loaded_graph.dag.len,
+    time_start: i64,
+
+    fn work(self: *DagScheduler) void {
+        const dag = &loaded_graph.dag;
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        while (true) {
+            while (self.ready.len == 0 and self.done_count < dag.len) {
+                self.condition.wait(&self.mutex);
+            }
+            if (self.done_count == dag.len) {
+                return;
+            }
+
+            const i_ready = std.mem.indexOfMin(usize, self.ready.slice());
+            const i_node = self.ready.orderedRemove(i_ready);
+            self.mutex.unlock();
+
+            const time_before = std.time.milliTimestamp();
+            dag[i_node].function(&self.simulator.ctx);
+            const time_after = std.time.milliTimestamp();
+
+            self.mutex.lock();
+            const timing = &self.timings[i_node];
+            timing.begin_ms = time_before - self.time_start;
+            timing.end_ms = time_after - self.time_start;
+            timing.critical_ms = time_after - time_before;
+            for (dag[i_node].dependencies) |i_dependency| {
+                const critical_ms = self.timings[i_dependency].critical_ms + time_after - time_before;
+                if (critical_ms > timing.critical_ms) {
+                    timing.critical_ms = critical_ms;
+                    timing.critical_parent = i_dependency;
+                }
+            }
+            std.log.info("Node: {s} ({s}): {d:>5} ms, Total: {d:>6.1} s, Peak RSS: {d:>6} MiB", .{
+                dag[i_node].name,
+                @tagName(node_cache.action(i_node)),
+                time_after - time_before,
+                @as(f32, @floatFromInt(timing.end_ms)) / std.time.ms_per_s,
+                peakRssMiB(),
+            });
+
+            self.done_count += 1;
+            for (dag, 0..) |node, i_dependent| {
+                if (std.mem.indexOfScalar(u16, node.dependencies, @intCast(i_node)) != null) {
+                    self.pending_dependencies[i_dependent] -= 1;
+                    if (self.pending_dependencies[i_dependent] == 0) {
+                        self.ready.appendAssumeCapacity(i_dependent);
+                    }
+                }
+            }
+            self.condition.broadcast();
+
+            self.simulator.mutex.lock();
+            self.simulator.progress.percent += 1.0 / @as(f32, @floatFromInt(dag.len));
+            self.simulator.mutex.unlock();
+        }
+    }
+
+    fn report(self: *DagScheduler, total_ms: i64) void {
+        const dag = &loaded_graph.dag;
+
+        var node_ms: i64 = 0;
+        var i_critical: usize = 0;
+        for (self.timings, 0..) |timing, i_node| {
+            node_ms += timing.end_ms - timing.begin_ms;
+            if (timing.critical_ms > self.timings[i_critical].critical_ms) {
+                i_critical = i_node;
+            }
+        }
+
+        std.log.info("Simulation: {d:.1} s, Nodes: {d:.1} s, Critical path: {d:.1} s, Parallelism: {d:.2}", .{
+            @as(f32, @floatFromInt(total_ms)) / std.time.ms_per_s,
+            @as(f32, @floatFromInt(node_ms)) / std.time.ms_per_s,
+            @as(f32, @floatFromInt(self.timings[i_critical].critical_ms)) / std.time.ms_per_s,
+            @as(f32, @floatFromInt(node_ms)) / @as(f32, @floatFromInt(@max(total_ms, 1))),
+        });
+
+        // NOTE: Listed from the last node back to start
+        var i_path: ?usize = i_critical;
+        while (i_path) |i_node| {
+            const timing = self.timings[i_node];
+            std.log.info("  Critical: {s}: {d:>5} ms", .{ dag[i_node].name, timing.end_ms - timing.begin_ms });
+            i_path = timing.critical_parent;
+        }
+    }
+};
+
 fn runSimulation(args: RunSimulationArgs) void {
-    var self = args.self;
+    const self = args.self;
 
     self.mutex.lock();
     self.progress.percent = 0;
     self.mutex.unlock();
 
-    const node_count = loaded_graph.node_count;
-    // const node_count = loaded_graph.getGraph().nodes.len;
-    var ctx = &self.ctx;
-
-    loaded_graph.start(ctx);
-
-    const time_start = std.time.milliTimestamp();
-    while (ctx.next_nodes.len > 0) {
-        const node_function = ctx.next_nodes.buffer[0];
-        // std.log.debug("simulate: {any}\n\n", .{node_function});
-        _ = ctx.next_nodes.orderedRemove(0);
-
-        const time_before = std.time.milliTimestamp();
-        node_function(ctx);
-        const time_after = std.time.milliTimestamp();
-        const node_duration = time_after - time_before;
-        const total_duration = time_after - time_start;
-        std.log.info("Node: {d:>5} ms, Total: {d:>6.1} s", .{
-            @as(f32, @floatFromInt(node_duration)) / 1,
-            @as(f32, @floatFromInt(total_duration)) / std.time.ms_per_s,
-        });
+    const ctx = &self.ctx;
+    const dag = &loaded_graph.dag;
+    node_cache.plan(dag);
 
-        self.mutex.lock();
-        self.progress.percent += 1.0 / @as(f32, @floatFromInt(node_count));
-        self.mutex.unlock();
+    var scheduler = DagScheduler{ .simulator = self, .time_start = std.time.milliTimestamp() };
+    for (dag, 0..) |node, i_node| {
+        scheduler.pending_dependencies[i_node] = node.dependencies.len;
+        if (node.dependencies.len == 0) {
+            scheduler.ready.appendAssumeCapacity(i_node);
+        }
+    }
+
+    var workers: [max_graph_jobs]std.Thread = undefined;
+    const worker_count = std.math.clamp(self.graph_jobs, 1, max_graph_jobs) - 1;
+    for (workers[0..worker_count]) |*worker| {
+        worker.* = std.Thread.spawn(.{}, DagScheduler.work, .{&scheduler}) catch unreachable;
+    }
+    scheduler.work();
+    for (workers[0..worker_count]) |worker| {
+        worker.join();
     }
 
     loaded_graph.exit(ctx);
 
+    scheduler.report(std.time.milliTimestamp() - scheduler.time_start);
+    const tile_cache = tiled_image.cache.?;
+    std.log.info("Peak RSS: {d} MiB, Tile cache peak: {d} MiB, Spilled: {d} MiB", .{
+        peakRssMiB(),
+        tile_cache.peak_resident_bytes / (1024 * 1024),
+        tile_cache.spilled_bytes / (1024 * 1024),
+    });
+
     self.mutex.lock();
     self.progress.percent = 1;
     self.thread = null;
     self.mutex.unlock();
 }
 
+// 0 where the OS doesn't report it through getrusage.
+fn peakRssMiB() u64 {
+    if (builtin.os.tag == .windows) {
+        return 0;
+    }
+    const usage = std.posix.getrusage(std.posix.rusage.SELF);
+    const max_rss: u64 = @intCast(usage.maxrss);
+    // NOTE: Bytes on macOS, KiB everywhere else
+    return if (builtin.os.tag.isDarwin()) max_rss / (1024 * 1024) else max_rss / 1024;
+}
+
 pub const Simulator = struct {
     mutex: std.Thread.Mutex = .{},
     progress: SimulatorProgress = .{},
     // // jobs: Jobs = .{},
     thread: ?std.Thread = null,
     ctx: graph.Context = undefined,
+    tile_cache_budget_mb: u32 = 2048,
+    graph_jobs: u32 = 1, // Nodes running at once, more than one needs a thread safe compute_fn
+    cache_dir: ?[]const u8 = null, // Node cache, disabled without one
 
     pub fn init(self: *Simulator) void {
         cpp_nodes.init();
+        node_cache.init(std.heap.c_allocator, self.cache_dir);
+        tiled_image.cache = tiled_image.TileCache.create(std.heap.c_allocator, @as(usize, self.tile_cache_budget_mb) * 1024 * 1024, "simulator_tiles.scratch");
         self.progress.percent = 0;
         // // self.jobs = Jobs.init();
 
@@ -87,6 +217,9 @@ pub const Simulator = struct {
 
     pub fn deinit(self: *Simulator) void {
         _ = self; // autofix
+        tiled_image.cache.?.destroy();
+        tiled_image.cache = null;
+        node_cache.deinit();
         cpp_nodes.deinit();
         // self.jobs.deinit();
     }
@@ -101,6 +234,16 @@ pub const Simulator = struct {
         self.thread = std.Thread.spawn(.{}, runSimulation, .{RunSimulationArgs{ .self = self }}) catch unreachable;
     }
 
+    // Blocks until the simulation started by simulate() is done.
+    pub fn wait(self: *Simulator) void {
+        self.mutex.lock();
+        const thread = self.thread;
+        self.mutex.unlock();
+        if (thread) |running| {
+            running.join();
+        }
+    }
+
     pub fn simulateSteps(self: *Simulator, steps: u32) void {
         _ = self; // autofix
         _ = steps; // autofix
@@ -123,6 +266,8 @@ pub const Simulator = struct {
         _ = image_height; // autofix
         self.mutex.lock();
         defer self.mutex.unlock();
+        self.ctx.previews_mutex.lock();
+        defer self.ctx.previews_mutex.unlock();
         if (!self.ctx.previews.contains(resource_name)) {
             return null;
         }
@@ -0,0 +1,517 @@
+const std = @import("std");
+const builtin = @import("builtin");
+
+const compute_cpu = @import("compute_cpu.zig");
+const types = @import("types.zig");
+
+// Out-of-core storage for the world sized graph images. A TiledImage splits an image in tiles of
+// tile_size^2 pixels that are only allocated once something is written to them. Resident tiles
+// are accounted by the TileCache and past its budget the least recently used unpinned ones are
+// written to a scratch file and freed, to be read back the next time they are pinned.
+//
+// Graph images are flat while the node using them runs, generated graphs park() them into tiles
+// between nodes and release() them after their last consumer, see graph_format.zig.
+
+pub const tile_size = 256;
+pub const max_element_size = 8;
+pub const image_alignment = 32 * 8;
+
+const spill_slot_bytes = tile_size * tile_size * max_element_size;
+const spill_segment_slots = 1024; // 512 MiB of scratch file per mapping
+const use_mmap = builtin.os.tag != .windows;
+
+const LruList = std.DoublyLinkedList(void);
+
+pub const Tile = struct {
+    data: ?[]align(64) u8 = null,
+    spill_slot: ?u32 = null,
+    dirty: bool = false, // data differs from the spill slot
+    pins: u32 = 0,
+    lru_node: LruList.Node = .{ .data = {} },
+};
+
+pub var cache: ?*TileCache = null;
+
+pub const TileCache = struct {
+    allocator: std.mem.Allocator,
+    mutex: std.Thread.Mutex = .{},
+    budget_bytes: usize,
+    resident_bytes: usize = 0,
+    peak_resident_bytes: usize = 0,
+    spilled_bytes: u64 = 0,
+    lru: LruList = .{},
+    scratch_path: []const u8,
+    scratch_file: std.fs.File,
+    segments: std.ArrayList([]align(std.heap.page_size_min) u8),
+    slot_count: u32 = 0,
+    free_slots: std.ArrayList(u32),
+
+    pub fn create(allocator: std.mem.Allocator, budget_bytes: usize, scratch_path: []const u8) *TileCache {
+        const self = allocator.create(TileCache) catch unreachable;
+        self.* = .{
+            .allocator = allocator,
+            .budget_bytes = budget_bytes,
+            .scratch_path = allocator.dupe(u8, scratch_path) catch unreachable,
+            .scratch_file = std.fs.cwd().createFile(scratch_path, .{ .read = true, .truncate = true }) catch unreachable,
+            .segments = std.ArrayList([]align(std.heap.page_size_min) u8).init(allocator),
+            .free_slots = std.ArrayList(u32).init(allocator),
+        };
+        return self;
+    }
+
+    pub fn destroy(self: *TileCache) void {
+        if (use_mmap) {
+            for (self.segments.items) |segment| {
+                std.posix.munmap(segment);
+            }
+        }
+        self.segments.deinit();
+        self.free_slots.deinit();
+        self.scratch_file.close();
+        std.fs.cwd().deleteFile(self.scratch_path) catch {};
+        self.allocator.free(self.scratch_path);
+        self.allocator.destroy(self);
+    }
+
+    // Returns the tile's bytes, allocated zeroed or read back from the scratch file. The tile
+    // can't be evicted until it's unpinned.
+    fn pin(self: *TileCache, tile: *Tile, byte_count: usize) []align(64) u8 {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        if (tile.pins == 0 and tile.data != null) {
+            self.lru.remove(&tile.lru_node);
+        }
+        tile.pins += 1;
+
+        if (tile.data == null) {
+            self.evictUntil(byte_count);
+            const data = self.allocator.alignedAlloc(u8, 64, byte_count) catch unreachable;
+            if (tile.spill_slot) |slot| {
+                self.readSlot(slot, data);
+            } else {
+                @memset(data, 0);
+            }
+            tile.data = data;
+            self.resident_bytes += byte_count;
+            self.peak_resident_bytes = @max(self.peak_resident_bytes, self.resident_bytes);
+        }
+        return tile.data.?;
+    }
+
+    fn unpin(self: *TileCache, tile: *Tile, written: bool) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        std.debug.assert(tile.pins > 0);
+        tile.dirty = tile.dirty or written;
+        tile.pins -= 1;
+        if (tile.pins == 0) {
+            self.lru.append(&tile.lru_node);
+            self.evictUntil(0);
+        }
+    }
+
+    fn drop(self: *TileCache, tile: *Tile) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        std.debug.assert(tile.pins == 0);
+        if (tile.data) |data| {
+            self.lru.remove(&tile.lru_node);
+            self.resident_bytes -= data.len;
+            self.allocator.free(data);
+        }
+        if (tile.spill_slot) |slot| {
+            self.free_slots.append(slot) catch unreachable;
+        }
+        tile.* = .{};
+    }
+
+    // Spills least recently used tiles until byte_count more fits in the budget.
+    fn evictUntil(self: *TileCache, byte_count: usize) void {
+        while (self.resident_bytes + byte_count > self.budget_bytes) {
+            const node = self.lru.popFirst() orelse return;
+            const tile: *Tile = @fieldParentPtr("lru_node", node);
+            const data = tile.data.?;
+            if (tile.dirty) {
+                const slot = tile.spill_slot orelse self.allocSlot();
+                self.writeSlot(slot, data);
+                tile.spill_slot = slot;
+                tile.dirty = false;
+                self.spilled_bytes += data.len;
+            }
+            self.resident_bytes -= data.len;
+            self.allocator.free(data);
+            tile.data = null;
+        }
+    }
+
+    fn allocSlot(self: *TileCache) u32 {
+        if (self.free_slots.pop()) |slot| {
+            return slot;
+        }
+
+        const slot = self.slot_count;
+        self.slot_count += 1;
+        // NOTE: No mapping on Windows, slots go through positional reads and writes there
+        if (use_mmap and slot % spill_segment_slots == 0) {
+            const segment_bytes = spill_segment_slots * spill_slot_bytes;
+            const file_bytes = (self.segments.items.len + 1) * segment_bytes;
+            self.scratch_file.setEndPos(file_bytes) catch unreachable;
+            const segment = std.posix.mmap(
+                null,
+                segment_bytes,
+                std.posix.PROT.READ | std.posix.PROT.WRITE,
+                .{ .TYPE = .SHARED },
+                self.scratch_file.handle,
+                file_bytes - segment_bytes,
+            ) catch unreachable;
+            self.segments.append(segment) catch unreachable;
+        }
+        return slot;
+    }
+
+    fn slotBytes(self: *TileCache, slot: u32, byte_count: usize) []align(std.heap.page_size_min) u8 {
+        const segment = self.segments.items[slot / spill_segment_slots];
+        const offset = (slot % spill_segment_slots) * spill_slot_bytes;
+        return @alignCast(segment[offset..][0..byte_count]);
+    }
+
+    fn writeSlot(self: *TileCache, slot: u32, data: []const u8) void {
+        if (use_mmap) {
+            const bytes = self.slotBytes(slot, data.len);
+            @memcpy(bytes, data);
+            // NOTE: Drops the pages from our working set, the page cache still writes them back
+            std.posix.madvise(bytes.ptr, bytes.len, std.posix.MADV.DONTNEED) catch {};
+        } else {
+            self.scratch_file.pwriteAll(data, @as(u64, slot) * spill_slot_bytes) catch unreachable;
+        }
+    }
+
+    fn readSlot(self: *TileCache, slot: u32, data: []u8) void {
+        if (use_mmap) {
+            const bytes = self.slotBytes(slot, data.len);
+            @memcpy(data, bytes);
+            std.posix.madvise(bytes.ptr, bytes.len, std.posix.MADV.DONTNEED) catch {};
+        } else {
+            const read = self.scratch_file.preadAll(data, @as(u64, slot) * spill_slot_bytes) catch unreachable;
+            std.debug.assert(read == data.len);
+        }
+    }
+};
+
+// A pinned tile. Rows are tile_size pixels apart, also for the clipped tiles on the right edge.
+pub fn TileView(comptime T: type) type {
+    return struct {
+        const Self = @This();
+
+        tile_index: usize,
+        rect: types.Rect,
+        pixels: []T,
+
+        pub fn row(self: Self, y: usize) []T {
+            return self.pixels[y * tile_size ..][0..self.rect.size().width];
+        }
+    };
+}
+
+pub fn TiledImage(comptime T: type) type {
+    comptime std.debug.assert(@sizeOf(T) <= max_element_size);
+
+    return struct {
+        const Self = @This();
+        const tile_byte_count = tile_size * tile_size * @sizeOf(T);
+
+        cache: *TileCache = undefined,
+        size: types.Size2D = .{ .width = 0, .height = 0 },
+        tiles_x: usize = 0,
+        tiles_y: usize = 0,
+        tiles: ?[]Tile = null,
+
+        pub fn init(self: *Self, tile_cache: *TileCache, size: types.Size2D) void {
+            std.debug.assert(self.tiles == null);
+            self.cache = tile_cache;
+            self.size = size;
+            self.tiles_x = std.math.divCeil(usize, size.width, tile_size) catch unreachable;
+            self.tiles_y = std.math.divCeil(usize, size.height, tile_size) catch unreachable;
+            const tiles = tile_cache.allocator.alloc(Tile, self.tiles_x * self.tiles_y) catch unreachable;
+            @memset(tiles, .{});
+            self.tiles = tiles;
+        }
+
+        pub fn deinit(self: *Self) void {
+            for (self.tiles.?) |*tile| {
+                self.cache.drop(tile);
+            }
+            self.cache.allocator.free(self.tiles.?);
+            self.* = .{};
+        }
+
+        pub fn tileRect(self: Self, tile_x: usize, tile_y: usize) types.Rect {
+            return .{
+                .left = tile_x * tile_size,
+                .right = @min((tile_x + 1) * tile_size, self.size.width),
+                .bottom = tile_y * tile_size,
+                .top = @min((tile_y + 1) * tile_size, self.size.height),
+            };
+        }
+
+        // False for tiles that were never written, they read as zeroes.
+        pub fn isStored(self: Self, tile_x: usize, tile_y: usize) bool {
+            const tile = self.tiles.?[tile_x + tile_y * self.tiles_x];
+            return tile.data != null or tile.spill_slot != null;
+        }
+
+        pub fn acquireTile(self: *Self, tile_x: usize, tile_y: usize) TileView(T) {
+            const tile_index = tile_x + tile_y * self.tiles_x;
+            const data = self.cache.pin(&self.tiles.?[tile_index], tile_byte_count);
+            return .{
+                .tile_index = tile_index,
+                .rect = self.tileRect(tile_x, tile_y),
+                .pixels = std.mem.bytesAsSlice(T, data),
+            };
+        }
+
+        pub fn releaseTile(self: *Self, view: TileView(T), written: bool) void {
+            self.cache.unpin(&self.tiles.?[view.tile_index], written);
+        }
+    };
+}
+
+// ██████╗ ███████╗███████╗██╗██████╗ ███████╗███╗   ██╗ ██████╗██╗   ██╗
+// ██╔══██╗██╔════╝██╔════╝██║██╔══██╗██╔════╝████╗  ██║██╔════╝╚██╗ ██╔╝
+// ██████╔╝█████╗  ███████╗██║██║  ██║█████╗  ██╔██╗ ██║██║      ╚████╔╝
+// ██╔══██╗██╔══╝  ╚════██║██║██║  ██║██╔══╝  ██║╚██╗██║██║       ╚██╔╝
+// ██║  ██║███████╗███████║██║██████╔╝███████╗██║ ╚████║╚██████╗   ██║
+// ╚═╝  ╚═╝╚══════╝╚══════╝╚═╝╚═════╝ ╚══════╝╚═╝  ╚═══╝ ╚═════╝   ╚═╝
+
+// Makes image flat for the node about to use it. capacity is the pixel count the graph declared
+// for it, its size may have been shrunk since. Fresh pages read as zeroes so only the stored
+// tiles of a parked image are copied back.
+pub fn acquire(comptime T: type, image: *types.Image(T), tiles: *TiledImage(T), capacity: usize) void {
+    const pixels = std.heap.page_allocator.alignedAlloc(T, image_alignment, capacity) catch unreachable;
+    image.pixels = pixels;
+    if (tiles.tiles != null) {
+        std.debug.assert(tiles.size.eql(image.size));
+        compute_cpu.forEachTile(T, tiles, .stored, false, image, Residency(T).unparkTile);
+        tiles.deinit();
+    }
+}
+
+// Moves image into tiles until the next node using it, all-zero tiles aren't stored.
+pub fn park(comptime T: type, image: *types.Image(T), tiles: *TiledImage(T)) void {
+    tiles.init(cache.?, image.size);
+    const parking = Residency(T){ .image = image, .tiles = tiles };
+    compute_cpu.forEachBand(tiles.tiles_y, 1, &parking, Residency(T).parkTileRow);
+    freePixels(T, image);
+}
+
+// For nodes that read image tile by tile, parks it unless it already is. An image nothing wrote
+// yet gets empty tiles, they read as zeroes.
+pub fn toTiles(comptime T: type, image: *types.Image(T), tiles: *TiledImage(T)) void {
+    if (tiles.tiles != null) {
+        std.debug.assert(image.pixels.len == 0);
+        return;
+    }
+    if (image.pixels.len > 0) {
+        park(T, image, tiles);
+    } else {
+        tiles.init(cache.?, image.size);
+    }
+}
+
+// After the image's last consumer.
+pub fn release(comptime T: type, image: *types.Image(T), tiles: *TiledImage(T)) void {
+    freePixels(T, image);
+    if (tiles.tiles != null) {
+        tiles.deinit();
+    }
+}
+
+fn freePixels(comptime T: type, image: *types.Image(T)) void {
+    if (image.pixels.len > 0) {
+        const pixels: []align(image_alignment) T = @alignCast(image.pixels);
+        std.heap.page_allocator.free(pixels);
+        image.pixels = image.pixels[0..0];
+    }
+}
+
+fn Residency(comptime T: type) type {
+    return struct {
+        const Self = @This();
+
+        image: *const types.Image(T),
+        tiles: *TiledImage(T),
+
+        fn imageRow(image: *const types.Image(T), rect: types.Rect, y: usize) []T {
+            return image.pixels[(rect.bottom + y) * image.size.width + rect.left ..][0..rect.size().width];
+        }
+
+        fn parkTileRow(self: *const Self, tile_row_begin: usize, tile_row_end: usize) void {
+            for (tile_row_begin..tile_row_end) |tile_y| {
+                for (0..self.tiles.tiles_x) |tile_x| {
+                    const rect = self.tiles.tileRect(tile_x, tile_y);
+                    const is_zero = for (0..rect.size().height) |y| {
+                        const row = std.mem.sliceAsBytes(imageRow(self.image, rect, y));
+                        if (!std.mem.allEqual(u8, row, 0)) {
+                            break false;
+                        }
+                    } else true;
+                    if (is_zero) {
+                        continue;
+                    }
+
+                    const view = self.tiles.acquireTile(tile_x, tile_y);
+                    for (0..rect.size().height) |y| {
+                        @memcpy(view.row(y), imageRow(self.image, rect, y));
+                    }
+                    self.tiles.releaseTile(view, true);
+                }
+            }
+        }
+
+        fn unparkTile(image: *types.Image(T), view: TileView(T)) void {
+            for (0..view.rect.size().height) |y| {
+                @memcpy(imageRow(image, view.rect, y), view.row(y));
+            }
+        }
+    };
+}
+
+fn createTestCache(tmp: *std.testing.TmpDir, budget_bytes: usize) !*TileCache {
+    const dir_path = try tmp.dir.realpathAlloc(std.testing.allocator, ".");
+    defer std.testing.allocator.free(dir_path);
+    const scratch_path = try std.fs.path.join(std.testing.allocator, &.{ dir_path, "tiles.scratch" });
+    defer std.testing.allocator.free(scratch_path);
+    return TileCache.create(std.testing.allocator, budget_bytes, scratch_path);
+}
+
+fn testPixel(x: usize, y: usize) f32 {
+    return @floatFromInt(1 + x + y * 1000);
+}
+
+test "tiled_image tile addressing" {
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const tile_cache = try createTestCache(&tmp, 64 * 1024 * 1024);
+    defer tile_cache.destroy();
+
+    // Clipped on the right and at the top.
+    var tiles: TiledImage(f32) = .{};
+    tiles.init(tile_cache, .{ .width = tile_size * 2 + 88, .height = tile_size + 44 });
+    defer tiles.deinit();
+    try std.testing.expectEqual(@as(usize, 3), tiles.tiles_x);
+    try std.testing.expectEqual(@as(usize, 2), tiles.tiles_y);
+
+    const edge = tiles.tileRect(2, 1);
+    try std.testing.expectEqual(@as(u64, tile_size * 2), edge.left);
+    try std.testing.expectEqual(@as(u64, tile_size * 2 + 88), edge.right);
+    try std.testing.expectEqual(@as(u64, tile_size), edge.bottom);
+    try std.testing.expectEqual(@as(u64, tile_size + 44), edge.top);
+    try std.testing.expect(tiles.tileRect(0, 0).size().eql(.{ .width = tile_size, .height = tile_size }));
+
+    try std.testing.expect(!tiles.isStored(2, 1));
+    const view = tiles.acquireTile(2, 1);
+    try std.testing.expectEqual(@as(usize, 2 + 1 * 3), view.tile_index);
+    try std.testing.expectEqual(@as(usize, 88), view.row(0).len);
+    try std.testing.expect(std.mem.allEqual(f32, view.pixels, 0));
+    for (0..view.rect.size().height) |y| {
+        for (view.row(y), 0..) |*pixel, x| {
+            pixel.* = testPixel(view.rect.left + x, view.rect.bottom + y);
+        }
+    }
+    tiles.releaseTile(view, true);
+    try std.testing.expect(tiles.isStored(2, 1));
+    try std.testing.expect(!tiles.isStored(1, 1));
+
+    const again = tiles.acquireTile(2, 1);
+    defer tiles.releaseTile(again, false);
+    try std.testing.expectEqual(testPixel(tile_size * 2 + 87, tile_size + 43), again.row(43)[87]);
+}
+
+test "tiled_image park and acquire" {
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    // Room for two tiles, parking the rest spills them to the scratch file.
+    const tile_cache = try createTestCache(&tmp, 2 * tile_size * tile_size * @sizeOf(f32));
+    defer tile_cache.destroy();
+    cache = tile_cache;
+    defer cache = null;
+
+    const size = types.Size2D{ .width = tile_size * 3 + 10, .height = tile_size * 2 + 20 };
+    var image = types.ImageF32{ .size = size };
+    var tiles: TiledImage(f32) = .{};
+    acquire(f32, &image, &tiles, size.area());
+    // Only the top edge row of tiles and the right edge column aren't zero.
+    for (0..size.height) |y| {
+        for (0..size.width) |x| {
+            const is_edge = x >= tile_size * 3 or y >= tile_size * 2;
+            image.pixels[y * size.width + x] = if (is_edge) testPixel(x, y) else 0;
+        }
+    }
+
+    park(f32, &image, &tiles);
+    try std.testing.expectEqual(@as(usize, 0), image.pixels.len);
+    for (0..tiles.tiles_y) |tile_y| {
+        for (0..tiles.tiles_x) |tile_x| {
+            try std.testing.expectEqual(tile_x == 3 or tile_y == 2, tiles.isStored(tile_x, tile_y));
+        }
+    }
+    try std.testing.expect(tile_cache.spilled_bytes > 0);
+    try std.testing.expect(tile_cache.resident_bytes <= tile_cache.budget_bytes);
+
+    toTiles(f32, &image, &tiles);
+    acquire(f32, &image, &tiles, size.area());
+    try std.testing.expect(tiles.tiles == null);
+    for (0..size.height) |y| {
+        for (0..size.width) |x| {
+            const is_edge = x >= tile_size * 3 or y >= tile_size * 2;
+            try std.testing.expectEqual(if (is_edge) testPixel(x, y) else 0, image.pixels[y * size.width + x]);
+        }
+    }
+    release(f32, &image, &tiles);
+    try std.testing.expectEqual(@as(usize, 0), tile_cache.resident_bytes);
+}
+
+test "tiled_image math tiles" {
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const tile_cache = try createTestCache(&tmp, 64 * 1024 * 1024);
+    defer tile_cache.destroy();
+    cache = tile_cache;
+    defer cache = null;
+
+    const size = types.Size2D{ .width = tile_size + 30, .height = tile_size + 7 };
+    var images: [3]types.ImageF32 = undefined;
+    var tiles = [_]TiledImage(f32){ .{}, .{}, .{} };
+    for (&images, &tiles, 0..) |*image, *image_tiles, i| {
+        image.* = .{ .size = size };
+        acquire(f32, image, image_tiles, size.area());
+        for (image.pixels, 0..) |*pixel, pixel_index| {
+            pixel.* = @floatFromInt(pixel_index % 97 + i);
+        }
+        park(f32, image, image_tiles);
+    }
+
+    var output = types.ImageF32{ .size = size };
+    var output_tiles: TiledImage(f32) = .{};
+    acquire(f32, &output, &output_tiles, size.area());
+    defer release(f32, &output, &output_tiles);
+
+    const inputs = [_]*TiledImage(f32){ &tiles[0], &tiles[1], &tiles[2] };
+    compute_cpu.mathTiles(.add, &inputs, &output, false);
+    for (output.pixels, 0..) |pixel, pixel_index| {
+        const value: f32 = @floatFromInt(pixel_index % 97);
+        try std.testing.expectEqual(value * 3 + 3, pixel);
+    }
+    compute_cpu.mathTiles(.multiply, inputs[1..2], &output, true);
+    for (output.pixels, 0..) |pixel, pixel_index| {
+        const value: f32 = @floatFromInt(pixel_index % 97);
+        try std.testing.expectEqual((value * 3 + 3) * (value + 1), pixel);
+    }
+
+    for (&images, &tiles) |*image, *image_tiles| {
+        release(f32, image, image_tiles);
+    }
+}
@@ -55,7 +55,7 @@ pub fn Image(ElemType: type) type {
         size: Size2D,
         height_min: f32 = 0,
         height_max: f32 = 1,
-        pixels: []ElemType = undefined,
+        pixels: []ElemType = &.{}, // Empty while the image is parked in tiles or not acquired yet
 
         pub fn zeroClear(self: *Self) void {
             @memset(self.pixels, 0);
@@ -1,4 +1,5 @@
 const std = @import("std");
+const builtin = @import("builtin");
 
 const c_cpp_nodes = @cImport({
     @cInclude("world_generator.h");
@@ -29,9 +30,11 @@ pub var generate_landscape_from_image: fn_generate_landscape_from_image = undefi
 pub var generate_landscape_preview: fn_generate_landscape_preview = undefined;
 pub var voronoi_to_imagef32: fn_voronoi_to_imagef32 = undefined;
 
+const dll_cpp_nodes_name = if (builtin.os.tag == .windows) "CppNodes.dll" else "libCppNodes.so";
+
 var dll_cpp_nodes: std.DynLib = undefined;
 pub fn init() void {
-    dll_cpp_nodes = std.DynLib.open("CppNodes.dll") catch unreachable;
+    dll_cpp_nodes = std.DynLib.open(dll_cpp_nodes_name) catch unreachable;
     generate_landscape_from_image = dll_cpp_nodes.lookup(c_cpp_nodes.PFN_generate_landscape_from_image, "generate_landscape_from_image").?.?;
     generate_landscape_preview = dll_cpp_nodes.lookup(c_cpp_nodes.PFN_generate_landscape_preview, "generate_landscape_preview").?.?;
     voronoi_to_imagef32 = dll_cpp_nodes.lookup(c_cpp_nodes.PFN_voronoi_to_imagef32, "voronoi_to_imagef32").?.?;